@@ -0,0 +1,209 @@
+/*
+ _____    _ _            ___
+|_   _| _(_) |_ ___ _ _ / __|___ _ _ ___
+  | || '_| |  _/ _ \ ' \ (__/ _ \ '_/ -_)
+  |_||_| |_|\__\___/_||_\___\___/_| \___|
+
+Copyright  2024, Michel Gerritse
+All rights reserved.
+
+This source code is available under the BSD-3-Clause license.
+See LICENSE.txt in the root directory of this source tree.
+
+*/
+#include <algorithm>
+
+#include "AudioFileSink.h"
+
+AudioFileSink::AudioFileSink(size_t BlockFrames) :
+	m_Format(AudioFormat::AUDIO_FMT_S16),
+	m_Channels(0),
+	m_BlockFrames(std::max<size_t>(BlockFrames, 1)),
+	m_BlockSamples(0),
+	m_Block{},
+	m_Fill(0),
+	m_Pending(false),
+	m_Exit(false)
+{
+}
+
+AudioFileSink::~AudioFileSink()
+{
+	Close();
+}
+
+bool AudioFileSink::Open(const std::filesystem::path& FileName, const AUDIO_OUTPUT_DESC& Desc, FileType Type)
+{
+	Close();
+
+	if ((Desc.Channels == 0) || (Desc.SampleFormat > AudioFormat::AUDIO_FMT_F32)) return false;
+
+	if (Type == FileType::Flac) m_Writer = std::make_unique<FlacWriter>();
+	else m_Writer = std::make_unique<WavWriter>();
+
+	if (!m_Writer->Open(FileName, Desc.SampleRate, Desc.Channels, Desc.SampleFormat))
+	{
+		m_Writer.reset();
+		return false;
+	}
+
+	m_Format = Desc.SampleFormat;
+	m_Channels = Desc.Channels;
+	m_BlockSamples = m_BlockFrames * m_Channels;
+
+	for (auto& Block : m_Block)
+	{
+		Block.Data.resize(m_BlockSamples * Audio::SizeOf((AudioFormat)m_Format));
+		Block.Count = 0;
+	}
+
+	m_Fill = 0;
+	m_Pending = false;
+	m_Exit = false;
+
+	m_Thread = std::thread(&AudioFileSink::WriterThread, this);
+
+	return true;
+}
+
+bool AudioFileSink::Close()
+{
+	if (m_Writer == nullptr) return false;
+
+	/* Hand over the partial block, then let the writer thread finish */
+	if (m_Block[m_Fill].Count != 0) Submit();
+
+	{
+		std::lock_guard<std::mutex> Lock(m_Mutex);
+		m_Exit = true;
+	}
+
+	m_Signal.notify_all();
+	m_Thread.join();
+
+	bool Result = m_Writer->Close();
+
+	m_Writer.reset();
+
+	/* Release the blocks */
+	for (auto& Block : m_Block)
+	{
+		std::vector<uint8_t>().swap(Block.Data);
+		Block.Count = 0;
+	}
+
+	return Result;
+}
+
+void AudioFileSink::WriteSampleS16(int16_t Sample)
+{
+	Append(&Sample, 1);
+}
+
+void AudioFileSink::WriteSampleS32(int32_t Sample)
+{
+	Append(&Sample, 1);
+}
+
+void AudioFileSink::WriteSampleF32(float Sample)
+{
+	Append(&Sample, 1);
+}
+
+void AudioFileSink::WriteSamplesS16(const int16_t* Samples, size_t Count)
+{
+	Append(Samples, Count);
+}
+
+void AudioFileSink::WriteSamplesS32(const int32_t* Samples, size_t Count)
+{
+	Append(Samples, Count);
+}
+
+void AudioFileSink::WriteSamplesF32(const float* Samples, size_t Count)
+{
+	Append(Samples, Count);
+}
+
+template<typename T>
+void AudioFileSink::Append(const T* Samples, size_t Count)
+{
+	/* Samples written before Open or after Close are dropped */
+	if (m_Writer == nullptr) return;
+
+	switch (m_Format)
+	{
+	case AudioFormat::AUDIO_FMT_S32: AppendAs<int32_t>(Samples, Count); break;
+	case AudioFormat::AUDIO_FMT_F32: AppendAs<float>(Samples, Count); break;
+	default: AppendAs<int16_t>(Samples, Count); break;
+	}
+}
+
+template<typename F, typename T>
+void AudioFileSink::AppendAs(const T* Samples, size_t Count)
+{
+	while (Count != 0)
+	{
+		block_t& Block = m_Block[m_Fill];
+
+		size_t Size = std::min(Count, m_BlockSamples - Block.Count);
+		F* Out = reinterpret_cast<F*>(Block.Data.data()) + Block.Count;
+
+		for (size_t i = 0; i < Size; i++) Out[i] = Audio::ConvertSample<F>(Samples[i]);
+
+		Block.Count += Size;
+		Samples += Size;
+		Count -= Size;
+
+		if (Block.Count == m_BlockSamples) Submit();
+	}
+}
+
+void AudioFileSink::Submit()
+{
+	{
+		/* Wait until the previous block is written */
+		std::unique_lock<std::mutex> Lock(m_Mutex);
+		m_Signal.wait(Lock, [this] { return !m_Pending; });
+
+		m_Pending = true;
+		m_Fill ^= 1;
+	}
+
+	m_Signal.notify_all();
+}
+
+void AudioFileSink::WriteBlock(const block_t& Block)
+{
+	size_t Frames = Block.Count / m_Channels;
+
+	switch (m_Format)
+	{
+	case AudioFormat::AUDIO_FMT_S32: m_Writer->Write(reinterpret_cast<const int32_t*>(Block.Data.data()), Frames); break;
+	case AudioFormat::AUDIO_FMT_F32: m_Writer->Write(reinterpret_cast<const float*>(Block.Data.data()), Frames); break;
+	default: m_Writer->Write(reinterpret_cast<const int16_t*>(Block.Data.data()), Frames); break;
+	}
+}
+
+void AudioFileSink::WriterThread()
+{
+	std::unique_lock<std::mutex> Lock(m_Mutex);
+
+	while (true)
+	{
+		m_Signal.wait(Lock, [this] { return m_Pending || m_Exit; });
+
+		/* Pending blocks are written before exiting */
+		if (!m_Pending) break;
+
+		block_t& Block = m_Block[m_Fill ^ 1];
+
+		Lock.unlock();
+		WriteBlock(Block);
+		Block.Count = 0;
+		Lock.lock();
+
+		m_Pending = false;
+		m_Signal.notify_all();
+	}
+}
\ No newline at end of file
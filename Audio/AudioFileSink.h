@@ -0,0 +1,98 @@
+/*
+ _____    _ _            ___
+|_   _| _(_) |_ ___ _ _ / __|___ _ _ ___
+  | || '_| |  _/ _ \ ' \ (__/ _ \ '_/ -_)
+  |_||_| |_|\__\___/_||_\___\___/_| \___|
+
+Copyright  2024, Michel Gerritse
+All rights reserved.
+
+This source code is available under the BSD-3-Clause license.
+See LICENSE.txt in the root directory of this source tree.
+
+*/
+#ifndef _AUDIO_FILE_SINK_H_
+#define _AUDIO_FILE_SINK_H_
+
+#include <condition_variable>
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "../Interfaces/ISoundDevice.h"
+#include "AudioFileWriter.h"
+
+/* Audio buffer that streams a device output to a WAV or FLAC file
+   Samples are gathered in two large blocks, while the device fills one block the other one is
+   written (and for FLAC encoded) by a background thread, so memory use stays constant no matter
+   how long the render is. Samples are stored in the format of the device output (see Open),
+   samples of another format are converted */
+class AudioFileSink : public IAudioBuffer
+{
+public:
+	enum class FileType
+	{
+		Wav,
+		Flac
+	};
+
+	/* Block size in frames, two blocks are in use */
+	static constexpr size_t DefaultBlockFrames = 65536;
+
+	AudioFileSink(size_t BlockFrames = DefaultBlockFrames);
+	~AudioFileSink();
+
+	AudioFileSink(const AudioFileSink&) = delete;
+	AudioFileSink& operator=(const AudioFileSink&) = delete;
+
+	/* Create the file, sample rate, sample format and channel count are taken from the output description
+	   WAV: 16-bit PCM (S16), 32-bit PCM (S32) or 32-bit float (F32)
+	   FLAC: 16-bit (S16) or 24-bit (S32 and F32), mono or stereo only */
+	bool	Open(const std::filesystem::path& FileName, const AUDIO_OUTPUT_DESC& Desc, FileType Type = FileType::Wav);
+
+	/* Write the remaining samples and complete the file, returns false if the file could not be written */
+	bool	Close();
+
+	/* IAudioBuffer */
+	void	WriteSampleS16(int16_t Sample);
+	void	WriteSampleS32(int32_t Sample);
+	void	WriteSampleF32(float Sample);
+	void	WriteSamplesS16(const int16_t* Samples, size_t Count);
+	void	WriteSamplesS32(const int32_t* Samples, size_t Count);
+	void	WriteSamplesF32(const float* Samples, size_t Count);
+
+private:
+	struct block_t
+	{
+		std::vector<uint8_t>	Data;	/* Samples in the file format */
+		size_t					Count;	/* Samples (frames x channels) */
+	};
+
+	template<typename T>
+	void	Append(const T* Samples, size_t Count);
+	template<typename F, typename T>
+	void	AppendAs(const T* Samples, size_t Count);
+	void	Submit();
+	void	WriteBlock(const block_t& Block);
+	void	WriterThread();
+
+	std::unique_ptr<AudioFileWriter>	m_Writer;
+	uint32_t							m_Format;
+	uint32_t							m_Channels;
+	size_t								m_BlockFrames;
+	size_t								m_BlockSamples;
+
+	block_t								m_Block[2];
+	uint32_t							m_Fill;		/* Block filled by the device */
+
+	std::thread							m_Thread;
+	std::mutex							m_Mutex;
+	std::condition_variable				m_Signal;
+	bool								m_Pending;	/* The other block is waiting or being written, protected by m_Mutex */
+	bool								m_Exit;		/* Protected by m_Mutex */
+};
+
+#endif // !_AUDIO_FILE_SINK_H_
\ No newline at end of file
@@ -0,0 +1,732 @@
+/*
+ _____    _ _            ___
+|_   _| _(_) |_ ___ _ _ / __|___ _ _ ___
+  | || '_| |  _/ _ \ ' \ (__/ _ \ '_/ -_)
+  |_||_| |_|\__\___/_||_\___\___/_| \___|
+
+Copyright  2024, Michel Gerritse
+All rights reserved.
+
+This source code is available under the BSD-3-Clause license.
+See LICENSE.txt in the root directory of this source tree.
+
+*/
+#include <algorithm>
+#include <array>
+#include <bit>
+
+#include "AudioFileWriter.h"
+
+/*
+	FLAC encoder
+
+	A small subset of the format that still compresses well:
+	- 16-bit or 24-bit mono or stereo samples, fixed block size of 4096 frames
+	- Stereo: independent, left/side, right/side or mid/side, whichever is smallest
+	- Subframes: constant, verbatim or fixed predictor (order 0 - 4)
+	- Rice coded residual, the partition order (0 - 8) is chosen per subframe
+	- No MD5 signature (all zero, which means "unknown")
+*/
+
+namespace
+{
+	constexpr uint32_t MaxPartitionOrder = 8;
+
+	/* Zigzag mapping of the signed residual */
+	inline uint32_t Fold(int32_t Value)
+	{
+		return ((uint32_t)Value << 1) ^ (uint32_t)(Value >> 31);
+	}
+
+	/* Rice parameter for a partition (estimated from the mean) */
+	inline uint32_t RiceParameter(uint64_t Sum, uint32_t Count)
+	{
+		uint64_t Mean = (Count != 0) ? Sum / Count : 0;
+
+		return std::min<uint32_t>((Mean != 0) ? std::bit_width(Mean) - 1 : 0, 30);
+	}
+
+	inline uint64_t RiceBits(uint64_t Sum, uint32_t Count, uint32_t Parameter)
+	{
+		return (uint64_t)Count * (Parameter + 1) + (Sum >> Parameter);
+	}
+
+	uint8_t Crc8(const uint8_t* Data, size_t Size)
+	{
+		uint8_t Crc = 0;
+
+		for (size_t i = 0; i < Size; i++)
+		{
+			Crc ^= Data[i];
+
+			for (uint32_t b = 0; b < 8; b++) Crc = (Crc & 0x80) ? (uint8_t)((Crc << 1) ^ 0x07) : (uint8_t)(Crc << 1);
+		}
+
+		return Crc;
+	}
+
+	uint16_t Crc16(const uint8_t* Data, size_t Size)
+	{
+		static const auto Table = []
+		{
+			std::array<uint16_t, 256> Table{};
+
+			for (uint32_t i = 0; i < 256; i++)
+			{
+				uint16_t Crc = (uint16_t)(i << 8);
+
+				for (uint32_t b = 0; b < 8; b++) Crc = (Crc & 0x8000) ? (uint16_t)((Crc << 1) ^ 0x8005) : (uint16_t)(Crc << 1);
+
+				Table[i] = Crc;
+			}
+
+			return Table;
+		}();
+
+		uint16_t Crc = 0;
+
+		for (size_t i = 0; i < Size; i++) Crc = (uint16_t)((Crc << 8) ^ Table[(Crc >> 8) ^ Data[i]]);
+
+		return Crc;
+	}
+}
+
+BufferedWriter::BufferedWriter(size_t BufferSize) :
+	m_Buffer(BufferSize),
+	m_Pos(0),
+	m_FileOffset(0),
+	m_Failed(false)
+{
+}
+
+BufferedWriter::~BufferedWriter()
+{
+	Close();
+}
+
+bool BufferedWriter::Open(const std::filesystem::path& FileName)
+{
+	Close();
+
+	m_File.open(FileName, std::ios::binary | std::ios::trunc);
+
+	m_Pos = 0;
+	m_FileOffset = 0;
+	m_Failed = !m_File.is_open();
+
+	return !m_Failed;
+}
+
+bool BufferedWriter::Close()
+{
+	if (!m_File.is_open()) return !m_Failed;
+
+	Flush();
+
+	m_File.close();
+	if (m_File.fail()) m_Failed = true;
+
+	return !m_Failed;
+}
+
+void BufferedWriter::Write16(uint16_t Value)
+{
+	uint8_t Data[2] = { (uint8_t)Value, (uint8_t)(Value >> 8) };
+
+	Write(Data, 2);
+}
+
+void BufferedWriter::Write32(uint32_t Value)
+{
+	uint8_t Data[4] = { (uint8_t)Value, (uint8_t)(Value >> 8), (uint8_t)(Value >> 16), (uint8_t)(Value >> 24) };
+
+	Write(Data, 4);
+}
+
+bool BufferedWriter::Seek(uint64_t Offset)
+{
+	Flush();
+
+	m_File.seekp((std::streamoff)Offset);
+	if (m_File.fail()) m_Failed = true;
+
+	m_FileOffset = Offset;
+
+	return !m_Failed;
+}
+
+uint64_t BufferedWriter::Tell() const
+{
+	return m_FileOffset + m_Pos;
+}
+
+bool BufferedWriter::Failed() const
+{
+	return m_Failed;
+}
+
+void BufferedWriter::Flush(const void* Data, size_t Size)
+{
+	if (m_Pos != 0)
+	{
+		m_File.write((const char*)m_Buffer.data(), m_Pos);
+
+		m_FileOffset += m_Pos;
+		m_Pos = 0;
+	}
+
+	if (Size >= m_Buffer.size())
+	{
+		/* Larger than the buffer, write it directly */
+		m_File.write((const char*)Data, Size);
+		m_FileOffset += Size;
+	}
+	else if (Size != 0)
+	{
+		memcpy(m_Buffer.data(), Data, Size);
+		m_Pos = Size;
+	}
+
+	if (m_File.fail()) m_Failed = true;
+}
+
+WavWriter::WavWriter() :
+	m_Channels(0),
+	m_Format(AudioFormat::AUDIO_FMT_S16),
+	m_DataSize(0),
+	m_DataOffset(0),
+	m_FactOffset(0)
+{
+}
+
+bool WavWriter::Open(const std::filesystem::path& FileName, uint32_t SampleRate, uint32_t Channels, uint32_t Format)
+{
+	if ((Channels == 0) || (Format > AudioFormat::AUDIO_FMT_F32)) return false;
+
+	if (!m_File.Open(FileName)) return false;
+
+	uint32_t SampleSize = Audio::SizeOf((AudioFormat)Format);
+	bool Float = (Format == AudioFormat::AUDIO_FMT_F32);
+
+	m_Channels = Channels;
+	m_Format = Format;
+	m_DataSize = 0;
+
+	/* The chunk sizes are set by Close */
+	m_File.Write("RIFF", 4);
+	m_File.Write32(0);
+	m_File.Write("WAVE", 4);
+
+	m_File.Write("fmt ", 4);
+	m_File.Write32(Float ? 18 : 16);
+	m_File.Write16(Float ? 3 : 1); /* IEEE float or PCM */
+	m_File.Write16((uint16_t)Channels);
+	m_File.Write32(SampleRate);
+	m_File.Write32(SampleRate * Channels * SampleSize);
+	m_File.Write16((uint16_t)(Channels * SampleSize));
+	m_File.Write16((uint16_t)(SampleSize * 8));
+
+	if (Float)
+	{
+		/* No extension, the fact chunk (frame count) is required for non-PCM data */
+		m_File.Write16(0);
+
+		m_File.Write("fact", 4);
+		m_File.Write32(4);
+		m_FactOffset = m_File.Tell();
+		m_File.Write32(0);
+	}
+
+	m_File.Write("data", 4);
+	m_DataOffset = m_File.Tell();
+	m_File.Write32(0);
+
+	return !m_File.Failed();
+}
+
+void WavWriter::Write(const int16_t* Samples, size_t Frames)
+{
+	WriteSamples(Samples, Frames);
+}
+
+void WavWriter::Write(const int32_t* Samples, size_t Frames)
+{
+	WriteSamples(Samples, Frames);
+}
+
+void WavWriter::Write(const float* Samples, size_t Frames)
+{
+	WriteSamples(Samples, Frames);
+}
+
+template<typename T>
+void WavWriter::WriteSamples(const T* Samples, size_t Frames)
+{
+	size_t Count = Frames * m_Channels;
+
+	switch (m_Format)
+	{
+	case AudioFormat::AUDIO_FMT_S32: WriteConverted<int32_t>(Samples, Count); break;
+	case AudioFormat::AUDIO_FMT_F32: WriteConverted<float>(Samples, Count); break;
+	default: WriteConverted<int16_t>(Samples, Count); break;
+	}
+
+	m_DataSize += Count * Audio::SizeOf((AudioFormat)m_Format);
+}
+
+template<typename F, typename T>
+void WavWriter::WriteConverted(const T* Samples, size_t Count)
+{
+	if constexpr (std::is_same_v<F, T> && (std::endian::native == std::endian::little))
+	{
+		/* Same format, written as is */
+		m_File.Write(Samples, Count * sizeof(T));
+	}
+	else
+	{
+		F Block[1024];
+
+		while (Count != 0)
+		{
+			size_t Size = std::min<size_t>(Count, std::size(Block));
+
+			for (size_t i = 0; i < Size; i++) Block[i] = Audio::ConvertSample<F>(Samples[i]);
+
+			if constexpr (std::endian::native == std::endian::little)
+			{
+				m_File.Write(Block, Size * sizeof(F));
+			}
+			else
+			{
+				for (size_t i = 0; i < Size; i++)
+				{
+					if constexpr (sizeof(F) == 2) m_File.Write16(std::bit_cast<uint16_t>(Block[i]));
+					else m_File.Write32(std::bit_cast<uint32_t>(Block[i]));
+				}
+			}
+
+			Samples += Size;
+			Count -= Size;
+		}
+	}
+}
+
+bool WavWriter::Close()
+{
+	uint32_t SampleSize = Audio::SizeOf((AudioFormat)m_Format);
+
+	/* RIFF sizes are 32-bit, larger files are clipped */
+	uint32_t DataSize = (uint32_t)std::min<uint64_t>(m_DataSize, 0xFFFFFFFF - m_DataOffset);
+
+	m_File.Seek(4);
+	m_File.Write32(DataSize + (uint32_t)m_DataOffset - 4);
+	m_File.Seek(m_DataOffset);
+	m_File.Write32(DataSize);
+
+	if (m_Format == AudioFormat::AUDIO_FMT_F32)
+	{
+		m_File.Seek(m_FactOffset);
+		m_File.Write32(DataSize / (SampleSize * m_Channels));
+	}
+
+	return m_File.Close();
+}
+
+void FlacWriter::BitWriter::Clear()
+{
+	Data.clear();
+
+	m_Accumulator = 0;
+	m_Bits = 0;
+}
+
+void FlacWriter::BitWriter::Write(uint32_t Value, uint32_t Bits)
+{
+	if (Bits == 0) return;
+
+	m_Accumulator = (m_Accumulator << Bits) | (Value & (uint32_t)((1ull << Bits) - 1));
+	m_Bits += Bits;
+
+	while (m_Bits >= 8)
+	{
+		m_Bits -= 8;
+		Data.push_back((uint8_t)(m_Accumulator >> m_Bits));
+	}
+}
+
+void FlacWriter::BitWriter::WriteRice(int32_t Value, uint32_t Parameter)
+{
+	uint32_t Folded = Fold(Value);
+	uint32_t Quotient = Folded >> Parameter;
+
+	/* Unary quotient (zeros + stop bit) */
+	for (; Quotient >= 31; Quotient -= 31) Write(0, 31);
+
+	Write(1, Quotient + 1);
+	Write(Folded, Parameter);
+}
+
+void FlacWriter::BitWriter::Align()
+{
+	if (m_Bits != 0) Write(0, 8 - m_Bits);
+}
+
+FlacWriter::FlacWriter() :
+	m_SampleRate(0),
+	m_Channels(0),
+	m_SampleBits(16),
+	m_TotalFrames(0),
+	m_FrameNumber(0),
+	m_MinFrameSize(0),
+	m_MaxFrameSize(0),
+	m_BlockFrames(0)
+{
+}
+
+bool FlacWriter::Open(const std::filesystem::path& FileName, uint32_t SampleRate, uint32_t Channels, uint32_t Format)
+{
+	if ((Channels == 0) || (Channels > 2) || (SampleRate == 0) || (SampleRate > 655350)) return false;
+	if (Format > AudioFormat::AUDIO_FMT_F32) return false;
+
+	if (!m_File.Open(FileName)) return false;
+
+	m_SampleRate = SampleRate;
+	m_Channels = Channels;
+	m_SampleBits = (Format == AudioFormat::AUDIO_FMT_S16) ? 16 : 24;
+	m_TotalFrames = 0;
+	m_FrameNumber = 0;
+	m_MinFrameSize = UINT32_MAX;
+	m_MaxFrameSize = 0;
+	m_BlockFrames = 0;
+
+	for (auto& Block : m_Block) Block.resize(BlockSize);
+	m_Residual.resize(BlockSize);
+
+	/* Stream marker + STREAMINFO (last metadata block), the frame sizes and total are set by Close */
+	uint8_t Header[42] = { 'f', 'L', 'a', 'C', 0x80, 0x00, 0x00, 0x22 };
+
+	Header[8] = BlockSize >> 8;
+	Header[9] = BlockSize & 0xFF;
+	Header[10] = BlockSize >> 8;
+	Header[11] = BlockSize & 0xFF;
+
+	m_File.Write(Header, sizeof(Header));
+
+	return !m_File.Failed();
+}
+
+void FlacWriter::Write(const int16_t* Samples, size_t Frames)
+{
+	WriteSamples(Samples, Frames);
+}
+
+void FlacWriter::Write(const int32_t* Samples, size_t Frames)
+{
+	WriteSamples(Samples, Frames);
+}
+
+void FlacWriter::Write(const float* Samples, size_t Frames)
+{
+	WriteSamples(Samples, Frames);
+}
+
+template<typename T>
+void FlacWriter::WriteSamples(const T* Samples, size_t Frames)
+{
+	while (Frames != 0)
+	{
+		size_t Count = std::min<size_t>(Frames, BlockSize - m_BlockFrames);
+
+		for (uint32_t Channel = 0; Channel < m_Channels; Channel++)
+		{
+			int32_t* Block = m_Block[Channel].data() + m_BlockFrames;
+
+			if (m_SampleBits == 16)
+			{
+				for (size_t i = 0; i < Count; i++) Block[i] = Audio::ConvertSample<int16_t>(Samples[(i * m_Channels) + Channel]);
+			}
+			else
+			{
+				for (size_t i = 0; i < Count; i++) Block[i] = Audio::ConvertSample<int32_t>(Samples[(i * m_Channels) + Channel]) >> 8;
+			}
+		}
+
+		Samples += Count * m_Channels;
+		Frames -= Count;
+		m_BlockFrames += (uint32_t)Count;
+
+		if (m_BlockFrames == BlockSize) EncodeFrame(BlockSize);
+	}
+}
+
+bool FlacWriter::Close()
+{
+	if (m_BlockFrames != 0) EncodeFrame(m_BlockFrames);
+
+	if (m_MaxFrameSize == 0) m_MinFrameSize = 0;
+
+	/* STREAMINFO: min / max frame size, sample rate, channels, bits per sample, total frames */
+	uint8_t Info[14];
+	uint64_t Packed = ((uint64_t)m_SampleRate << 44) | ((uint64_t)(m_Channels - 1) << 41) | ((uint64_t)(m_SampleBits - 1) << 36) | (m_TotalFrames & 0xFFFFFFFFFull);
+
+	Info[0] = (uint8_t)(m_MinFrameSize >> 16);
+	Info[1] = (uint8_t)(m_MinFrameSize >> 8);
+	Info[2] = (uint8_t)m_MinFrameSize;
+	Info[3] = (uint8_t)(m_MaxFrameSize >> 16);
+	Info[4] = (uint8_t)(m_MaxFrameSize >> 8);
+	Info[5] = (uint8_t)m_MaxFrameSize;
+
+	for (uint32_t i = 0; i < 8; i++) Info[6 + i] = (uint8_t)(Packed >> (56 - (i * 8)));
+
+	m_File.Seek(12);
+	m_File.Write(Info, sizeof(Info));
+
+	return m_File.Close();
+}
+
+void FlacWriter::EncodeFrame(uint32_t Frames)
+{
+	/* Channel assignment */
+	uint32_t Assignment = m_Channels - 1;
+	const int32_t* Signal[2] = { m_Block[0].data(), m_Block[1].data() };
+	uint32_t SampleBits[2] = { m_SampleBits, m_SampleBits };
+	subframe_t Subframe[2];
+
+	if (m_Channels == 2)
+	{
+		int32_t* Mid = m_Block[2].data();
+		int32_t* Side = m_Block[3].data();
+
+		for (uint32_t i = 0; i < Frames; i++)
+		{
+			Mid[i] = (Signal[0][i] + Signal[1][i]) >> 1;
+			Side[i] = Signal[0][i] - Signal[1][i];
+		}
+
+		subframe_t Left = AnalyzeSubframe(Signal[0], Frames, m_SampleBits);
+		subframe_t Right = AnalyzeSubframe(Signal[1], Frames, m_SampleBits);
+		subframe_t M = AnalyzeSubframe(Mid, Frames, m_SampleBits);
+		subframe_t S = AnalyzeSubframe(Side, Frames, m_SampleBits + 1);
+
+		uint64_t Independent = Left.Bits + Right.Bits;
+		uint64_t LeftSide = Left.Bits + S.Bits;
+		uint64_t RightSide = Right.Bits + S.Bits;
+		uint64_t MidSide = M.Bits + S.Bits;
+		uint64_t Best = std::min({ Independent, LeftSide, RightSide, MidSide });
+
+		if (Best == Independent)
+		{
+			Subframe[0] = Left;
+			Subframe[1] = Right;
+		}
+		else if (Best == LeftSide)
+		{
+			Assignment = 8;
+			Signal[1] = Side;
+			SampleBits[1] = m_SampleBits + 1;
+			Subframe[0] = Left;
+			Subframe[1] = S;
+		}
+		else if (Best == RightSide)
+		{
+			Assignment = 9;
+			Signal[0] = Side;
+			SampleBits[0] = m_SampleBits + 1;
+			Subframe[0] = S;
+			Subframe[1] = Right;
+		}
+		else
+		{
+			Assignment = 10;
+			Signal[0] = Mid;
+			Signal[1] = Side;
+			SampleBits[1] = m_SampleBits + 1;
+			Subframe[0] = M;
+			Subframe[1] = S;
+		}
+	}
+	else
+	{
+		Subframe[0] = AnalyzeSubframe(Signal[0], Frames, m_SampleBits);
+	}
+
+	/* Frame header */
+	m_Frame.Clear();
+	m_Frame.Write(0x3FFE, 14);	/* Sync code */
+	m_Frame.Write(0, 1);		/* Reserved */
+	m_Frame.Write(0, 1);		/* Fixed block size */
+	m_Frame.Write((Frames == BlockSize) ? 12 : 7, 4); /* 4096 or 16-bit size at the end of the header */
+	m_Frame.Write(0, 4);		/* Sample rate from STREAMINFO */
+	m_Frame.Write(Assignment, 4);
+	m_Frame.Write((m_SampleBits == 16) ? 4 : 6, 3); /* 16 or 24 bits per sample */
+	m_Frame.Write(0, 1);		/* Reserved */
+
+	/* Frame number, UTF-8 style coding */
+	uint64_t Number = m_FrameNumber++;
+
+	if (Number < 0x80)
+	{
+		m_Frame.Write((uint32_t)Number, 8);
+	}
+	else
+	{
+		uint32_t Bytes = 2;
+		while ((Bytes < 7) && (Number >= (1ull << (5 * Bytes + 1)))) Bytes++;
+
+		m_Frame.Write(((0xFF00 >> Bytes) & 0xFF) | (uint32_t)(Number >> (6 * (Bytes - 1))), 8);
+
+		for (uint32_t i = Bytes - 1; i > 0; i--) m_Frame.Write(0x80 | (uint32_t)((Number >> (6 * (i - 1))) & 0x3F), 8);
+	}
+
+	if (Frames != BlockSize) m_Frame.Write(Frames - 1, 16);
+
+	m_Frame.Write(Crc8(m_Frame.Data.data(), m_Frame.Data.size()), 8);
+
+	/* Subframes */
+	for (uint32_t Channel = 0; Channel < m_Channels; Channel++) WriteSubframe(Signal[Channel], Frames, SampleBits[Channel], Subframe[Channel]);
+
+	/* Frame footer */
+	m_Frame.Align();
+	m_Frame.Write(Crc16(m_Frame.Data.data(), m_Frame.Data.size()), 16);
+
+	m_File.Write(m_Frame.Data.data(), m_Frame.Data.size());
+
+	uint32_t Size = (uint32_t)m_Frame.Data.size();
+
+	m_MinFrameSize = std::min(m_MinFrameSize, Size);
+	m_MaxFrameSize = std::max(m_MaxFrameSize, Size);
+	m_TotalFrames += Frames;
+	m_BlockFrames = 0;
+}
+
+FlacWriter::subframe_t FlacWriter::AnalyzeSubframe(const int32_t* Signal, uint32_t Frames, uint32_t SampleBits)
+{
+	subframe_t Best = { 0, 0, 8 + (uint64_t)SampleBits, true, false };
+
+	if (std::all_of(Signal + 1, Signal + Frames, [&](int32_t Sample) { return Sample == Signal[0]; })) return Best;
+
+	Best.Constant = false;
+	Best.Verbatim = true;
+	Best.Bits = 8 + (uint64_t)SampleBits * Frames;
+
+	for (uint32_t Order = 0; (Order <= 4) && (Order < Frames); Order++)
+	{
+		ComputeResidual(Signal, Frames, Order);
+
+		/* Partition sums at the highest order, merged for the lower orders */
+		uint32_t MaxOrder = 0;
+		while ((MaxOrder < MaxPartitionOrder) && ((Frames % (2u << MaxOrder)) == 0) && ((Frames >> (MaxOrder + 1)) > Order)) MaxOrder++;
+
+		uint64_t Sums[1 << MaxPartitionOrder] = {};
+		uint32_t Partitions = 1u << MaxOrder;
+		uint32_t Size = Frames >> MaxOrder;
+
+		for (uint32_t p = 0; p < Partitions; p++)
+		{
+			for (uint32_t i = std::max(p * Size, Order); i < (p + 1) * Size; i++) Sums[p] += Fold(m_Residual[i]);
+		}
+
+		for (int32_t PartitionOrder = MaxOrder; PartitionOrder >= 0; PartitionOrder--)
+		{
+			uint32_t Count = 1u << PartitionOrder;
+			uint64_t Bits = 8 + (uint64_t)Order * SampleBits + 6;
+
+			for (uint32_t p = 0; p < Count; p++)
+			{
+				uint32_t Samples = (Frames >> PartitionOrder) - ((p == 0) ? Order : 0);
+				uint32_t Parameter = RiceParameter(Sums[p], Samples);
+
+				Bits += 5 + RiceBits(Sums[p], Samples, Parameter);
+			}
+
+			if (Bits < Best.Bits) Best = { Order, (uint32_t)PartitionOrder, Bits, false, false };
+
+			/* Merge pairs for the next (lower) partition order */
+			for (uint32_t p = 0; p < (Count >> 1); p++) Sums[p] = Sums[2 * p] + Sums[(2 * p) + 1];
+		}
+	}
+
+	return Best;
+}
+
+void FlacWriter::WriteSubframe(const int32_t* Signal, uint32_t Frames, uint32_t SampleBits, const subframe_t& Subframe)
+{
+	if (Subframe.Constant)
+	{
+		m_Frame.Write(0x00, 8);
+		m_Frame.Write((uint32_t)Signal[0], SampleBits);
+		return;
+	}
+
+	if (Subframe.Verbatim)
+	{
+		m_Frame.Write(0x02, 8);
+		for (uint32_t i = 0; i < Frames; i++) m_Frame.Write((uint32_t)Signal[i], SampleBits);
+		return;
+	}
+
+	/* Fixed predictor, zero padding bit + type (001xxx) + no wasted bits */
+	m_Frame.Write((0x08 | Subframe.Order) << 1, 8);
+
+	for (uint32_t i = 0; i < Subframe.Order; i++) m_Frame.Write((uint32_t)Signal[i], SampleBits);
+
+	ComputeResidual(Signal, Frames, Subframe.Order);
+
+	uint32_t Partitions = 1u << Subframe.Partitions;
+	uint32_t Size = Frames >> Subframe.Partitions;
+	uint32_t Parameters[1 << MaxPartitionOrder];
+	uint32_t MaxParameter = 0;
+
+	for (uint32_t p = 0; p < Partitions; p++)
+	{
+		uint32_t Start = (p == 0) ? Subframe.Order : 0;
+		uint64_t Sum = 0;
+
+		for (uint32_t i = (p * Size) + Start; i < (p + 1) * Size; i++) Sum += Fold(m_Residual[i]);
+
+		Parameters[p] = RiceParameter(Sum, Size - Start);
+		MaxParameter = std::max(MaxParameter, Parameters[p]);
+	}
+
+	/* Rice coding with 4-bit parameters, 5-bit parameters if needed */
+	uint32_t ParameterBits = (MaxParameter > 14) ? 5 : 4;
+
+	m_Frame.Write((ParameterBits == 5) ? 1 : 0, 2);
+	m_Frame.Write(Subframe.Partitions, 4);
+
+	for (uint32_t p = 0; p < Partitions; p++)
+	{
+		m_Frame.Write(Parameters[p], ParameterBits);
+
+		for (uint32_t i = (p * Size) + ((p == 0) ? Subframe.Order : 0); i < (p + 1) * Size; i++) m_Frame.WriteRice(m_Residual[i], Parameters[p]);
+	}
+}
+
+void FlacWriter::ComputeResidual(const int32_t* Signal, uint32_t Frames, uint32_t Order)
+{
+	int32_t* Residual = m_Residual.data();
+	const int32_t* x = Signal;
+
+	switch (Order)
+	{
+	case 0:
+		for (uint32_t i = 0; i < Frames; i++) Residual[i] = x[i];
+		break;
+
+	case 1:
+		for (uint32_t i = 1; i < Frames; i++) Residual[i] = x[i] - x[i - 1];
+		break;
+
+	case 2:
+		for (uint32_t i = 2; i < Frames; i++) Residual[i] = x[i] - 2 * x[i - 1] + x[i - 2];
+		break;
+
+	case 3:
+		for (uint32_t i = 3; i < Frames; i++) Residual[i] = x[i] - 3 * x[i - 1] + 3 * x[i - 2] - x[i - 3];
+		break;
+
+	default:
+		for (uint32_t i = 4; i < Frames; i++) Residual[i] = x[i] - 4 * x[i - 1] + 6 * x[i - 2] - 4 * x[i - 3] + x[i - 4];
+		break;
+	}
+}
\ No newline at end of file
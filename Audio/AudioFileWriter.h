@@ -0,0 +1,178 @@
+/*
+ _____    _ _            ___
+|_   _| _(_) |_ ___ _ _ / __|___ _ _ ___
+  | || '_| |  _/ _ \ ' \ (__/ _ \ '_/ -_)
+  |_||_| |_|\__\___/_||_\___\___/_| \___|
+
+Copyright  2024, Michel Gerritse
+All rights reserved.
+
+This source code is available under the BSD-3-Clause license.
+See LICENSE.txt in the root directory of this source tree.
+
+*/
+#ifndef _AUDIO_FILE_WRITER_H_
+#define _AUDIO_FILE_WRITER_H_
+
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <vector>
+
+#include "Sample.h"
+
+/* Sequential file output through a large buffer
+   Seeking (to patch headers) flushes the buffer first */
+class BufferedWriter
+{
+public:
+	static constexpr size_t DefaultSize = 4 << 20;
+
+	BufferedWriter(size_t BufferSize = DefaultSize);
+	~BufferedWriter();
+
+	BufferedWriter(const BufferedWriter&) = delete;
+	BufferedWriter& operator=(const BufferedWriter&) = delete;
+
+	bool		Open(const std::filesystem::path& FileName);
+
+	/* Returns false if any write failed */
+	bool		Close();
+
+	inline void	Write(const void* Data, size_t Size)
+	{
+		if ((m_Buffer.size() - m_Pos) < Size) Flush(Data, Size);
+		else
+		{
+			memcpy(m_Buffer.data() + m_Pos, Data, Size);
+			m_Pos += Size;
+		}
+	}
+
+	/* Little endian values */
+	void		Write16(uint16_t Value);
+	void		Write32(uint32_t Value);
+
+	bool		Seek(uint64_t Offset);
+	uint64_t	Tell() const;
+
+	bool		Failed() const;
+
+private:
+	void		Flush(const void* Data = nullptr, size_t Size = 0);
+
+	std::ofstream			m_File;
+	std::vector<uint8_t>	m_Buffer;
+	size_t					m_Pos;
+	uint64_t				m_FileOffset;	/* File offset of the buffer */
+	bool					m_Failed;
+};
+
+/* Interleaved PCM audio file
+   Samples are stored in the format passed to Open (see AudioFormat), samples of another format are converted */
+class AudioFileWriter
+{
+public:
+	virtual ~AudioFileWriter() = default;
+
+	virtual bool	Open(const std::filesystem::path& FileName, uint32_t SampleRate, uint32_t Channels, uint32_t Format = AudioFormat::AUDIO_FMT_S16) = 0;
+	virtual void	Write(const int16_t* Samples, size_t Frames) = 0;
+	virtual void	Write(const int32_t* Samples, size_t Frames) = 0;
+	virtual void	Write(const float* Samples, size_t Frames) = 0;
+
+	/* Completes the headers, returns false if any write failed */
+	virtual bool	Close() = 0;
+};
+
+/* RIFF WAVE: 16-bit PCM (S16), 32-bit PCM (S32) or 32-bit float (F32) */
+class WavWriter : public AudioFileWriter
+{
+public:
+	WavWriter();
+
+	bool	Open(const std::filesystem::path& FileName, uint32_t SampleRate, uint32_t Channels, uint32_t Format = AudioFormat::AUDIO_FMT_S16);
+	void	Write(const int16_t* Samples, size_t Frames);
+	void	Write(const int32_t* Samples, size_t Frames);
+	void	Write(const float* Samples, size_t Frames);
+	bool	Close();
+
+private:
+	template<typename T>
+	void	WriteSamples(const T* Samples, size_t Frames);
+	template<typename F, typename T>
+	void	WriteConverted(const T* Samples, size_t Count);
+
+	BufferedWriter	m_File;
+	uint32_t		m_Channels;
+	uint32_t		m_Format;
+	uint64_t		m_DataSize;
+	uint64_t		m_DataOffset;	/* File offset of the data chunk size */
+	uint64_t		m_FactOffset;	/* File offset of the fact chunk frame count (F32 only) */
+};
+
+/* FLAC (lossless), mono or stereo, fixed block size
+   16-bit samples (S16) or 24-bit samples (S32 and F32, the lower 8 bits of S32 samples are dropped) */
+class FlacWriter : public AudioFileWriter
+{
+public:
+	static constexpr uint32_t BlockSize = 4096;
+
+	FlacWriter();
+
+	bool	Open(const std::filesystem::path& FileName, uint32_t SampleRate, uint32_t Channels, uint32_t Format = AudioFormat::AUDIO_FMT_S16);
+	void	Write(const int16_t* Samples, size_t Frames);
+	void	Write(const int32_t* Samples, size_t Frames);
+	void	Write(const float* Samples, size_t Frames);
+	bool	Close();
+
+private:
+	/* Bit packer for a single frame, MSB first */
+	class BitWriter
+	{
+	public:
+		void		Clear();
+		void		Write(uint32_t Value, uint32_t Bits);
+		void		WriteRice(int32_t Value, uint32_t Parameter);
+		void		Align();
+
+		std::vector<uint8_t>	Data;
+
+	private:
+		uint64_t	m_Accumulator = 0;
+		uint32_t	m_Bits = 0;
+	};
+
+	/* Subframe candidate: fixed predictor + partitioned Rice residual */
+	struct subframe_t
+	{
+		uint32_t	Order;			/* Fixed predictor order (0 - 4) */
+		uint32_t	Partitions;		/* Partition order */
+		uint64_t	Bits;			/* Encoded size */
+		bool		Constant;
+		bool		Verbatim;
+	};
+
+	template<typename T>
+	void		WriteSamples(const T* Samples, size_t Frames);
+	void		EncodeFrame(uint32_t Frames);
+	subframe_t	AnalyzeSubframe(const int32_t* Signal, uint32_t Frames, uint32_t SampleBits);
+	void		WriteSubframe(const int32_t* Signal, uint32_t Frames, uint32_t SampleBits, const subframe_t& Subframe);
+	void		ComputeResidual(const int32_t* Signal, uint32_t Frames, uint32_t Order);
+
+	BufferedWriter			m_File;
+	uint32_t				m_SampleRate;
+	uint32_t				m_Channels;
+	uint32_t				m_SampleBits;	/* 16 or 24 */
+	uint64_t				m_TotalFrames;
+	uint64_t				m_FrameNumber;
+	uint32_t				m_MinFrameSize;
+	uint32_t				m_MaxFrameSize;
+
+	std::vector<int32_t>	m_Block[4];		/* Channel 0, 1, mid, side */
+	uint32_t				m_BlockFrames;
+	std::vector<int32_t>	m_Residual;
+	BitWriter				m_Frame;
+};
+
+#endif // !_AUDIO_FILE_WRITER_H_
\ No newline at end of file
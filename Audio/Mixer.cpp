@@ -0,0 +1,241 @@
+/*
+ _____    _ _            ___
+|_   _| _(_) |_ ___ _ _ / __|___ _ _ ___
+  | || '_| |  _/ _ \ ' \ (__/ _ \ '_/ -_)
+  |_||_| |_|\__\___/_||_\___\___/_| \___|
+
+Copyright  2024, Michel Gerritse
+All rights reserved.
+
+This source code is available under the BSD-3-Clause license.
+See LICENSE.txt in the root directory of this source tree.
+
+*/
+#include "Mixer.h"
+#include "Resampler.h"
+#include "Sample.h"
+
+/*
+	Multi-device mixer
+
+	The mixer owns a list of sound devices (not the devices themselves) and renders
+	them between sync points (each Render call):
+
+	1. Every device is updated for the amount of clock cycles matching the requested
+	   number of frames. Devices are rendered concurrently on the worker pool.
+	2. Each device output is resampled to the mixer rate and converted to stereo.
+	3. All outputs are summed into the final interleaved stereo mix.
+
+	A device is only ever touched by one thread at a time, and never outside of Render.
+*/
+
+/* Captures the samples of a single device output (converted to F32) */
+class CaptureBuffer : public IAudioBuffer
+{
+public:
+	std::vector<float> Samples;
+
+	void WriteSampleS16(int16_t Sample) { Samples.push_back(Audio::ConvertSample<float>(Sample)); }
+	void WriteSampleS32(int32_t Sample) { Samples.push_back(Audio::ConvertSample<float>(Sample)); }
+	void WriteSampleF32(float Sample) { Samples.push_back(Sample); }
+
+	void WriteSamplesS16(const int16_t* pSamples, size_t Count)
+	{
+		for (size_t i = 0; i < Count; i++) Samples.push_back(Audio::ConvertSample<float>(pSamples[i]));
+	}
+
+	void WriteSamplesS32(const int32_t* pSamples, size_t Count)
+	{
+		for (size_t i = 0; i < Count; i++) Samples.push_back(Audio::ConvertSample<float>(pSamples[i]));
+	}
+
+	void WriteSamplesF32(const float* pSamples, size_t Count)
+	{
+		Samples.insert(Samples.end(), pSamples, pSamples + Count);
+	}
+};
+
+/* Sends the samples of a device output to the resampler and to a tap */
+class TapBuffer : public IAudioBuffer
+{
+public:
+	IAudioBuffer* Output = nullptr;
+	IAudioBuffer* Tap = nullptr;
+
+	void WriteSampleS16(int16_t Sample) { Tap->WriteSampleS16(Sample); Output->WriteSampleS16(Sample); }
+	void WriteSampleS32(int32_t Sample) { Tap->WriteSampleS32(Sample); Output->WriteSampleS32(Sample); }
+	void WriteSampleF32(float Sample) { Tap->WriteSampleF32(Sample); Output->WriteSampleF32(Sample); }
+
+	void WriteSamplesS16(const int16_t* Samples, size_t Count) { Tap->WriteSamplesS16(Samples, Count); Output->WriteSamplesS16(Samples, Count); }
+	void WriteSamplesS32(const int32_t* Samples, size_t Count) { Tap->WriteSamplesS32(Samples, Count); Output->WriteSamplesS32(Samples, Count); }
+	void WriteSamplesF32(const float* Samples, size_t Count) { Tap->WriteSamplesF32(Samples, Count); Output->WriteSamplesF32(Samples, Count); }
+};
+
+struct Mixer::output_t
+{
+	AUDIO_OUTPUT_DESC			Desc;
+	std::unique_ptr<Resampler>	Converter;	/* Native rate -> mixer rate */
+	CaptureBuffer				Capture;	/* Resampled frames, not yet mixed */
+	TapBuffer					Tap;		/* Only used with a tap */
+
+	float						GainL;
+	float						GainR;
+};
+
+struct Mixer::device_t
+{
+	ISoundDevice*						Device;
+	std::vector<output_t>				Outputs;
+	std::vector<IAudioBuffer*>			Buffers;
+	std::vector<float>					Mix;		/* Device mix (stereo, mixer rate) */
+	uint64_t							ClockRemainder;
+};
+
+Mixer::Mixer(uint32_t SampleRate, uint32_t Threads, ResamplerQuality Quality) :
+	m_SampleRate(SampleRate),
+	m_Quality(Quality),
+	m_Pool(Threads)
+{
+}
+
+Mixer::~Mixer() = default;
+
+uint32_t Mixer::AddDevice(ISoundDevice* Device, float Gain)
+{
+	auto pDevice = std::make_unique<device_t>();
+
+	pDevice->Device = Device;
+	pDevice->ClockRemainder = 0;
+
+	AUDIO_OUTPUT_DESC Desc;
+
+	for (uint32_t OutputNr = 0; Device->EnumAudioOutputs(OutputNr, Desc); OutputNr++)
+	{
+		auto& Output = pDevice->Outputs.emplace_back();
+
+		Output.Desc = Desc;
+		Output.Desc.Channels = std::max(Desc.Channels, 1u);
+		Output.GainL = Gain;
+		Output.GainR = Gain;
+
+		/* Absorb the +/- 1 frame jitter between device and mixer rate */
+		Output.Capture.Samples.assign(Output.Desc.Channels * 2, 0.0f);
+	}
+
+	/* Output buffer pointers are stable from here on */
+	for (auto& Output : pDevice->Outputs)
+	{
+		Output.Converter = std::make_unique<Resampler>(Output.Desc.SampleRate, Output.Desc.Channels, m_SampleRate, &Output.Capture, m_Quality);
+		pDevice->Buffers.push_back(Output.Converter.get());
+	}
+
+	m_Devices.push_back(std::move(pDevice));
+
+	return (uint32_t)m_Devices.size() - 1;
+}
+
+void Mixer::RemoveDevices()
+{
+	m_Devices.clear();
+}
+
+void Mixer::SetOutputGain(uint32_t DeviceNr, uint32_t OutputNr, float Gain, float Pan)
+{
+	if (DeviceNr >= m_Devices.size()) return;
+	if (OutputNr >= m_Devices[DeviceNr]->Outputs.size()) return;
+
+	auto& Output = m_Devices[DeviceNr]->Outputs[OutputNr];
+
+	/* Linear panning law */
+	Pan = std::clamp(Pan, -1.0f, 1.0f);
+
+	Output.GainL = Gain * std::min(1.0f, 1.0f - Pan);
+	Output.GainR = Gain * std::min(1.0f, 1.0f + Pan);
+}
+
+void Mixer::SetOutputTap(uint32_t DeviceNr, uint32_t OutputNr, IAudioBuffer* Tap)
+{
+	if (DeviceNr >= m_Devices.size()) return;
+	if (OutputNr >= m_Devices[DeviceNr]->Outputs.size()) return;
+
+	auto& Device = *m_Devices[DeviceNr];
+	auto& Output = Device.Outputs[OutputNr];
+
+	Output.Tap.Output = Output.Converter.get();
+	Output.Tap.Tap = Tap;
+
+	Device.Buffers[OutputNr] = (Tap != nullptr) ? &Output.Tap : (IAudioBuffer*)Output.Converter.get();
+}
+
+uint32_t Mixer::GetSampleRate() const
+{
+	return m_SampleRate;
+}
+
+uint32_t Mixer::GetDeviceCount() const
+{
+	return (uint32_t)m_Devices.size();
+}
+
+void Mixer::Render(float* Out, size_t Frames)
+{
+	/* Render and resample all devices in parallel */
+	m_Pool.Run(m_Devices.size(), [&](size_t DeviceNr)
+	{
+		RenderDevice(*m_Devices[DeviceNr], Frames);
+	});
+
+	/* Mix */
+	std::fill(Out, Out + (Frames * 2), 0.0f);
+
+	for (auto& Device : m_Devices)
+	{
+		const float* Mix = Device->Mix.data();
+
+		for (size_t i = 0; i < Frames * 2; i++) Out[i] += Mix[i];
+	}
+}
+
+void Mixer::Render(IAudioBuffer* Out, size_t Frames)
+{
+	m_MixBuffer.resize(Frames * 2);
+
+	Render(m_MixBuffer.data(), Frames);
+
+	Out->WriteSamplesF32(m_MixBuffer.data(), Frames * 2);
+}
+
+void Mixer::RenderDevice(device_t& Device, size_t Frames)
+{
+	/* Clock cycles for this time slice (the remainder is carried over) */
+	uint64_t Cycles = ((uint64_t)Device.Device->GetClockSpeed() * Frames) + Device.ClockRemainder;
+	Device.ClockRemainder = Cycles % m_SampleRate;
+
+	/* Render and resample (the resamplers write into the capture buffers) */
+	Device.Device->Update((uint32_t)(Cycles / m_SampleRate), Device.Buffers);
+
+	/* Mix the device outputs */
+	Device.Mix.assign(Frames * 2, 0.0f);
+
+	for (auto& Output : Device.Outputs)
+	{
+		auto& Samples = Output.Capture.Samples;
+		uint32_t Channels = Output.Desc.Channels;
+		uint32_t Right = (Channels > 1) ? 1 : 0; /* Mono outputs go to both sides */
+
+		size_t Count = std::min(Frames, Samples.size() / Channels);
+		float* Mix = Device.Mix.data();
+
+		for (size_t i = 0; i < Count; i++)
+		{
+			Mix[i * 2 + 0] += Samples[i * Channels] * Output.GainL;
+			Mix[i * 2 + 1] += Samples[i * Channels + Right] * Output.GainR;
+		}
+
+		/* Keep the frames that did not fit this slice. Output rates are rounded
+		   down to whole Hz, so drop the backlog if it ever builds up */
+		if ((Samples.size() / Channels) > (Count + 64)) Count = (Samples.size() / Channels) - 2;
+
+		Samples.erase(Samples.begin(), Samples.begin() + (Count * Channels));
+	}
+}
\ No newline at end of file
@@ -0,0 +1,62 @@
+/*
+ _____    _ _            ___
+|_   _| _(_) |_ ___ _ _ / __|___ _ _ ___
+  | || '_| |  _/ _ \ ' \ (__/ _ \ '_/ -_)
+  |_||_| |_|\__\___/_||_\___\___/_| \___|
+
+Copyright  2024, Michel Gerritse
+All rights reserved.
+
+This source code is available under the BSD-3-Clause license.
+See LICENSE.txt in the root directory of this source tree.
+
+*/
+#ifndef _AUDIO_MIXER_H_
+#define _AUDIO_MIXER_H_
+
+#include "../Interfaces/ISoundDevice.h"
+#include "Resampler.h"
+#include "WorkerPool.h"
+
+/* Multi-device mixer */
+class Mixer
+{
+public:
+	/* Threads = number of worker threads used for rendering (0 = render on the calling thread) */
+	Mixer(uint32_t SampleRate, uint32_t Threads = 0, ResamplerQuality Quality = ResamplerQuality::Medium);
+	~Mixer();
+
+	Mixer(const Mixer&) = delete;
+	Mixer& operator=(const Mixer&) = delete;
+
+	/* Add a device, all of its audio outputs are mixed. Returns the device number */
+	uint32_t	AddDevice(ISoundDevice* Device, float Gain = 1.0f);
+	void		RemoveDevices();
+
+	/* Per output volume and panning (-1.0 = left, 0.0 = center, +1.0 = right) */
+	void		SetOutputGain(uint32_t DeviceNr, uint32_t OutputNr, float Gain, float Pan = 0.0f);
+
+	/* Tap is sent a copy of the native device output (before resampling), nullptr removes the tap */
+	void		SetOutputTap(uint32_t DeviceNr, uint32_t OutputNr, IAudioBuffer* Tap);
+
+	uint32_t	GetSampleRate() const;
+	uint32_t	GetDeviceCount() const;
+
+	/* Render all devices and mix them into interleaved stereo frames */
+	void		Render(float* Out, size_t Frames);
+	void		Render(IAudioBuffer* Out, size_t Frames);
+
+private:
+	struct output_t;
+	struct device_t;
+
+	void		RenderDevice(device_t& Device, size_t Frames);
+
+	uint32_t								m_SampleRate;
+	ResamplerQuality						m_Quality;
+	WorkerPool								m_Pool;
+	std::vector<std::unique_ptr<device_t>>	m_Devices;
+	std::vector<float>						m_MixBuffer;
+};
+
+#endif // !_AUDIO_MIXER_H_
\ No newline at end of file
@@ -0,0 +1,469 @@
+/*
+ _____    _ _            ___
+|_   _| _(_) |_ ___ _ _ / __|___ _ _ ___
+  | || '_| |  _/ _ \ ' \ (__/ _ \ '_/ -_)
+  |_||_| |_|\__\___/_||_\___\___/_| \___|
+
+Copyright  2024, Michel Gerritse
+All rights reserved.
+
+This source code is available under the BSD-3-Clause license.
+See LICENSE.txt in the root directory of this source tree.
+
+*/
+#include <cmath>
+#include <map>
+#include <mutex>
+#include <numbers>
+#include <tuple>
+#include "Resampler.h"
+#include "Sample.h"
+#include "../Core/Cpu.h"
+
+#if TC_CPU_X86
+#include <immintrin.h>
+#elif TC_CPU_NEON
+#include <arm_neon.h>
+#endif
+
+/*
+	Polyphase FIR resampler
+
+	Sits between ISoundDevice::Update() and a host audio buffer: the device writes
+	samples at its native rate, the resampler writes F32 (or S16/S32) samples at the
+	requested output rate to the host buffer.
+
+	- Kaiser windowed sinc filter, 256 phases
+	- Coefficients are linearly interpolated between adjacent phases
+	- Filters are built once per rate pair and quality and shared (also between threads)
+	- Cutoff is lowered when downsampling (anti-aliasing)
+	- The filter history is primed with silence, so no input is held back and
+	  the only latency is the group delay of the filter (half its length)
+	- Dot products use AVX2, SSE2 or NEON when the host CPU supports them (selected at run time)
+*/
+
+/* Filter presets */
+struct preset_t
+{
+	uint32_t	Taps;
+	double		Beta;		/* Kaiser window beta */
+	double		Rolloff;	/* Cutoff relative to the (lowest) Nyquist frequency */
+};
+
+static const preset_t Presets[] =
+{
+	{  8, 5.0, 0.80 },	/* Low */
+	{ 16, 7.0, 0.87 },	/* Medium */
+	{ 32, 8.5, 0.92 },	/* High */
+	{ 64, 10.0, 0.95 }	/* Best */
+};
+
+/* Zeroth order modified Bessel function of the first kind */
+static double BesselI0(double x)
+{
+	double Sum = 1.0;
+	double Term = 1.0;
+
+	for (int k = 1; k < 32; k++)
+	{
+		Term *= (x / (2.0 * k)) * (x / (2.0 * k));
+		Sum += Term;
+	}
+
+	return Sum;
+}
+
+/* Out[i] = C0[i] + (C1[i] - C0[i]) * Frac */
+static void InterpolateScalar(float* Out, const float* C0, const float* C1, float Frac, uint32_t Count)
+{
+	for (uint32_t i = 0; i < Count; i++) Out[i] = C0[i] + (C1[i] - C0[i]) * Frac;
+}
+
+/* Sum of X[i] * C[i] */
+static float DotProductScalar(const float* X, const float* C, uint32_t Count)
+{
+	float Sum = 0.0f;
+
+	for (uint32_t i = 0; i < Count; i++) Sum += X[i] * C[i];
+
+	return Sum;
+}
+
+#if TC_CPU_X86
+static void InterpolateSSE2(float* Out, const float* C0, const float* C1, float Frac, uint32_t Count)
+{
+	uint32_t i = 0;
+	__m128 F = _mm_set1_ps(Frac);
+
+	for (; i + 4 <= Count; i += 4)
+	{
+		__m128 A = _mm_loadu_ps(C0 + i);
+		__m128 B = _mm_loadu_ps(C1 + i);
+		_mm_storeu_ps(Out + i, _mm_add_ps(A, _mm_mul_ps(_mm_sub_ps(B, A), F)));
+	}
+
+	InterpolateScalar(Out + i, C0 + i, C1 + i, Frac, Count - i);
+}
+
+static float DotProductSSE2(const float* X, const float* C, uint32_t Count)
+{
+	uint32_t i = 0;
+	__m128 Acc = _mm_setzero_ps();
+
+	for (; i + 4 <= Count; i += 4)
+	{
+		Acc = _mm_add_ps(Acc, _mm_mul_ps(_mm_loadu_ps(X + i), _mm_loadu_ps(C + i)));
+	}
+
+	Acc = _mm_add_ps(Acc, _mm_movehl_ps(Acc, Acc));
+	Acc = _mm_add_ss(Acc, _mm_shuffle_ps(Acc, Acc, 1));
+
+	return _mm_cvtss_f32(Acc) + DotProductScalar(X + i, C + i, Count - i);
+}
+
+TC_TARGET_AVX2 static void InterpolateAVX2(float* Out, const float* C0, const float* C1, float Frac, uint32_t Count)
+{
+	uint32_t i = 0;
+	__m256 F = _mm256_set1_ps(Frac);
+
+	for (; i + 8 <= Count; i += 8)
+	{
+		__m256 A = _mm256_loadu_ps(C0 + i);
+		__m256 B = _mm256_loadu_ps(C1 + i);
+		_mm256_storeu_ps(Out + i, _mm256_add_ps(A, _mm256_mul_ps(_mm256_sub_ps(B, A), F)));
+	}
+
+	InterpolateScalar(Out + i, C0 + i, C1 + i, Frac, Count - i);
+}
+
+TC_TARGET_AVX2 static float DotProductAVX2(const float* X, const float* C, uint32_t Count)
+{
+	uint32_t i = 0;
+	__m256 Acc = _mm256_setzero_ps();
+
+	for (; i + 8 <= Count; i += 8)
+	{
+		Acc = _mm256_add_ps(Acc, _mm256_mul_ps(_mm256_loadu_ps(X + i), _mm256_loadu_ps(C + i)));
+	}
+
+	__m128 Acc4 = _mm_add_ps(_mm256_castps256_ps128(Acc), _mm256_extractf128_ps(Acc, 1));
+	Acc4 = _mm_add_ps(Acc4, _mm_movehl_ps(Acc4, Acc4));
+	Acc4 = _mm_add_ss(Acc4, _mm_shuffle_ps(Acc4, Acc4, 1));
+
+	return _mm_cvtss_f32(Acc4) + DotProductScalar(X + i, C + i, Count - i);
+}
+#elif TC_CPU_NEON
+static void InterpolateNEON(float* Out, const float* C0, const float* C1, float Frac, uint32_t Count)
+{
+	uint32_t i = 0;
+	float32x4_t F = vdupq_n_f32(Frac);
+
+	for (; i + 4 <= Count; i += 4)
+	{
+		float32x4_t A = vld1q_f32(C0 + i);
+		float32x4_t B = vld1q_f32(C1 + i);
+		vst1q_f32(Out + i, vmlaq_f32(A, vsubq_f32(B, A), F));
+	}
+
+	InterpolateScalar(Out + i, C0 + i, C1 + i, Frac, Count - i);
+}
+
+static float DotProductNEON(const float* X, const float* C, uint32_t Count)
+{
+	uint32_t i = 0;
+	float32x4_t Acc = vdupq_n_f32(0.0f);
+
+	for (; i + 4 <= Count; i += 4)
+	{
+		Acc = vmlaq_f32(Acc, vld1q_f32(X + i), vld1q_f32(C + i));
+	}
+
+	float32x2_t Acc2 = vadd_f32(vget_low_f32(Acc), vget_high_f32(Acc));
+
+	return vget_lane_f32(vpadd_f32(Acc2, Acc2), 0) + DotProductScalar(X + i, C + i, Count - i);
+}
+#endif
+
+Resampler::Resampler(ISoundDevice* Device, uint32_t OutputNr, uint32_t OutRate, IAudioBuffer* OutBuffer, ResamplerQuality Quality, AudioFormat OutFormat) :
+	m_InRate(0),
+	m_OutRate(OutRate),
+	m_Channels(1),
+	m_OutFormat(OutFormat),
+	m_OutBuffer(OutBuffer)
+{
+	AUDIO_OUTPUT_DESC Desc;
+
+	if (Device->EnumAudioOutputs(OutputNr, Desc))
+	{
+		m_InRate = Desc.SampleRate;
+		m_Channels = Desc.Channels;
+	}
+
+	Initialize(Quality);
+}
+
+Resampler::Resampler(uint32_t InRate, uint32_t Channels, uint32_t OutRate, IAudioBuffer* OutBuffer, ResamplerQuality Quality, AudioFormat OutFormat) :
+	m_InRate(InRate),
+	m_OutRate(OutRate),
+	m_Channels(Channels),
+	m_OutFormat(OutFormat),
+	m_OutBuffer(OutBuffer)
+{
+	Initialize(Quality);
+}
+
+void Resampler::Initialize(ResamplerQuality Quality)
+{
+	m_InRate = std::max(m_InRate, 1u);
+	m_OutRate = std::max(m_OutRate, 1u);
+	m_Channels = std::max(m_Channels, 1u);
+
+	m_Step = ((uint64_t)m_InRate << 32) / m_OutRate;
+	m_Taps = (m_InRate == m_OutRate) ? 1 : Presets[std::min((uint32_t)Quality, 3u)].Taps;
+
+	m_Filter = GetFilter(m_InRate, m_OutRate, Quality);
+	m_Coefficients = m_Filter->data();
+
+	m_Kernel.resize(m_Taps);
+	m_History.resize(m_Channels);
+
+	/* Select the kernels for the host CPU */
+	auto Interpolators = TC::CpuKernels<interpolate_t>(InterpolateScalar);
+	auto DotProducts = TC::CpuKernels<dot_product_t>(DotProductScalar);
+#if TC_CPU_X86
+	Interpolators.Add(TC::CpuTier::SSE2, InterpolateSSE2).Add(TC::CpuTier::AVX2, InterpolateAVX2);
+	DotProducts.Add(TC::CpuTier::SSE2, DotProductSSE2).Add(TC::CpuTier::AVX2, DotProductAVX2);
+#elif TC_CPU_NEON
+	Interpolators.Add(TC::CpuTier::NEON, InterpolateNEON);
+	DotProducts.Add(TC::CpuTier::NEON, DotProductNEON);
+#endif
+	m_Interpolate = Interpolators.Select();
+	m_DotProduct = DotProducts.Select();
+
+	Reset();
+}
+
+Resampler::filter_ptr Resampler::GetFilter(uint32_t InRate, uint32_t OutRate, ResamplerQuality Quality)
+{
+	/* Filters are built once per rate pair and quality, and shared by all threads */
+	static std::mutex Mutex;
+	static std::map<std::tuple<uint32_t, uint32_t, uint32_t>, filter_ptr> Filters;
+
+	auto Key = std::make_tuple(InRate, OutRate, (InRate == OutRate) ? 0 : std::min((uint32_t)Quality, 3u));
+
+	std::lock_guard<std::mutex> Lock(Mutex);
+
+	auto& Filter = Filters[Key];
+	if (!Filter) Filter = BuildFilter(InRate, OutRate, Quality);
+
+	return Filter;
+}
+
+Resampler::filter_ptr Resampler::BuildFilter(uint32_t InRate, uint32_t OutRate, ResamplerQuality Quality)
+{
+	if (InRate == OutRate)
+	{
+		/* Pass through (single unity tap) */
+		return std::make_shared<const std::vector<float>>(Phases + 1, 1.0f);
+	}
+
+	const preset_t& Preset = Presets[std::min((uint32_t)Quality, 3u)];
+
+	uint32_t Taps = Preset.Taps;
+	std::vector<float> Coefficients((Phases + 1) * Taps);
+
+	/* Cutoff frequency (relative to the input rate) */
+	double Cutoff = 0.5 * Preset.Rolloff * std::min(1.0, (double)OutRate / InRate);
+	double Center = (Taps / 2) - 1;
+	double HalfLength = Taps / 2.0;
+
+	for (uint32_t p = 0; p <= Phases; p++)
+	{
+		float* Phase = &Coefficients[p * Taps];
+		double Sum = 0.0;
+
+		for (uint32_t k = 0; k < Taps; k++)
+		{
+			double t = k - Center - ((double)p / Phases);
+			double x = t / HalfLength;
+			double Window = (std::abs(x) < 1.0) ? BesselI0(Preset.Beta * std::sqrt(1.0 - x * x)) / BesselI0(Preset.Beta) : 0.0;
+			double Sinc = (t == 0.0) ? 1.0 : std::sin(std::numbers::pi * 2.0 * Cutoff * t) / (std::numbers::pi * 2.0 * Cutoff * t);
+
+			Phase[k] = (float)(2.0 * Cutoff * Sinc * Window);
+			Sum += Phase[k];
+		}
+
+		/* Unity gain at DC for every phase */
+		for (uint32_t k = 0; k < Taps; k++) Phase[k] = (float)(Phase[k] / Sum);
+	}
+
+	return std::make_shared<const std::vector<float>>(std::move(Coefficients));
+}
+
+void Resampler::Reset()
+{
+	m_Position = 0;
+	m_FramePos = 0;
+
+	/* Prime the history with silence */
+	for (auto& History : m_History)
+	{
+		History.assign(m_Taps - 1, 0.0f);
+	}
+
+	m_Output.clear();
+}
+
+void Resampler::SetOutputBuffer(IAudioBuffer* OutBuffer)
+{
+	m_OutBuffer = OutBuffer;
+}
+
+uint32_t Resampler::GetInputRate() const
+{
+	return m_InRate;
+}
+
+uint32_t Resampler::GetOutputRate() const
+{
+	return m_OutRate;
+}
+
+uint32_t Resampler::GetChannels() const
+{
+	return m_Channels;
+}
+
+uint32_t Resampler::GetLatency() const
+{
+	return m_Taps / 2;
+}
+
+void Resampler::WriteSampleS16(int16_t Sample)
+{
+	Push(Audio::ConvertSample<float>(Sample));
+}
+
+void Resampler::WriteSampleS32(int32_t Sample)
+{
+	Push(Audio::ConvertSample<float>(Sample));
+}
+
+void Resampler::WriteSampleF32(float Sample)
+{
+	Push(Sample);
+}
+
+void Resampler::WriteSamplesS16(const int16_t* Samples, size_t Count)
+{
+	for (size_t i = 0; i < Count; i++)
+	{
+		m_History[m_FramePos].push_back(Audio::ConvertSample<float>(Samples[i]));
+		if (++m_FramePos == m_Channels) m_FramePos = 0;
+	}
+
+	Process();
+}
+
+void Resampler::WriteSamplesS32(const int32_t* Samples, size_t Count)
+{
+	for (size_t i = 0; i < Count; i++)
+	{
+		m_History[m_FramePos].push_back(Audio::ConvertSample<float>(Samples[i]));
+		if (++m_FramePos == m_Channels) m_FramePos = 0;
+	}
+
+	Process();
+}
+
+void Resampler::WriteSamplesF32(const float* Samples, size_t Count)
+{
+	for (size_t i = 0; i < Count; i++)
+	{
+		m_History[m_FramePos].push_back(Samples[i]);
+		if (++m_FramePos == m_Channels) m_FramePos = 0;
+	}
+
+	Process();
+}
+
+void Resampler::Push(float Sample)
+{
+	m_History[m_FramePos].push_back(Sample);
+
+	if (++m_FramePos == m_Channels)
+	{
+		m_FramePos = 0;
+
+		/* Process in chunks when fed per sample */
+		if (m_History[0].size() >= (m_Taps + 256)) Process();
+	}
+}
+
+void Resampler::Process()
+{
+	/* Only complete frames are available */
+	size_t Frames = m_History[m_Channels - 1].size();
+
+	while (true)
+	{
+		size_t Index = (size_t)(m_Position >> 32);
+
+		if ((Index + m_Taps) > Frames) break;
+
+		/* Select and interpolate the filter phase */
+		uint32_t Frac = (uint32_t)m_Position;
+		uint32_t Phase = Frac >> (32 - PhaseBits);
+		float Blend = (Frac & ((1u << (32 - PhaseBits)) - 1)) * (1.0f / (1u << (32 - PhaseBits)));
+
+		const float* C0 = &m_Coefficients[Phase * m_Taps];
+		m_Interpolate(m_Kernel.data(), C0, C0 + m_Taps, Blend, m_Taps);
+
+		for (auto& History : m_History)
+		{
+			m_Output.push_back(m_DotProduct(&History[Index], m_Kernel.data(), m_Taps));
+		}
+
+		m_Position += m_Step;
+	}
+
+	/* Drop consumed input frames */
+	size_t Consumed = std::min((size_t)(m_Position >> 32), Frames);
+
+	for (auto& History : m_History)
+	{
+		History.erase(History.begin(), History.begin() + Consumed);
+	}
+
+	m_Position -= (uint64_t)Consumed << 32;
+
+	Flush();
+}
+
+void Resampler::Flush()
+{
+	if (m_Output.empty() || (m_OutBuffer == nullptr)) return;
+
+	switch (m_OutFormat)
+	{
+	case AudioFormat::AUDIO_FMT_S16:
+	{
+		AudioBlock<int16_t> Block(m_OutBuffer);
+		for (auto Sample : m_Output) Block.Write(Audio::ConvertSample<int16_t>(Sample));
+		break;
+	}
+
+	case AudioFormat::AUDIO_FMT_S32:
+	{
+		AudioBlock<int32_t> Block(m_OutBuffer);
+		for (auto Sample : m_Output) Block.Write(Audio::ConvertSample<int32_t>(Sample));
+		break;
+	}
+
+	default:
+		m_OutBuffer->WriteSamplesF32(m_Output.data(), m_Output.size());
+		break;
+	}
+
+	m_Output.clear();
+}
\ No newline at end of file
@@ -0,0 +1,99 @@
+/*
+ _____    _ _            ___
+|_   _| _(_) |_ ___ _ _ / __|___ _ _ ___
+  | || '_| |  _/ _ \ ' \ (__/ _ \ '_/ -_)
+  |_||_| |_|\__\___/_||_\___\___/_| \___|
+
+Copyright  2024, Michel Gerritse
+All rights reserved.
+
+This source code is available under the BSD-3-Clause license.
+See LICENSE.txt in the root directory of this source tree.
+
+*/
+#ifndef _AUDIO_RESAMPLER_H_
+#define _AUDIO_RESAMPLER_H_
+
+#include "../Interfaces/ISoundDevice.h"
+
+/* Resampler quality presets (filter length vs. latency) */
+enum class ResamplerQuality : uint32_t
+{
+	Low = 0,	/*  8 taps, ~4 input samples latency */
+	Medium,		/* 16 taps, ~8 input samples latency */
+	High,		/* 32 taps, ~16 input samples latency */
+	Best		/* 64 taps, ~32 input samples latency */
+};
+
+/* Polyphase FIR resampler */
+class Resampler : public IAudioBuffer
+{
+public:
+	/* Input rate and channel count are taken from the device output */
+	Resampler(ISoundDevice* Device, uint32_t OutputNr, uint32_t OutRate, IAudioBuffer* OutBuffer,
+		ResamplerQuality Quality = ResamplerQuality::Medium, AudioFormat OutFormat = AudioFormat::AUDIO_FMT_F32);
+
+	Resampler(uint32_t InRate, uint32_t Channels, uint32_t OutRate, IAudioBuffer* OutBuffer,
+		ResamplerQuality Quality = ResamplerQuality::Medium, AudioFormat OutFormat = AudioFormat::AUDIO_FMT_F32);
+
+	~Resampler() = default;
+
+	Resampler(const Resampler&) = delete;
+	Resampler& operator=(const Resampler&) = delete;
+
+	/* IAudioBuffer methods (device side) */
+	void		WriteSampleS16(int16_t Sample);
+	void		WriteSampleS32(int32_t Sample);
+	void		WriteSampleF32(float Sample);
+	void		WriteSamplesS16(const int16_t* Samples, size_t Count);
+	void		WriteSamplesS32(const int32_t* Samples, size_t Count);
+	void		WriteSamplesF32(const float* Samples, size_t Count);
+
+	/* Clear the filter history */
+	void		Reset();
+
+	void		SetOutputBuffer(IAudioBuffer* OutBuffer);
+
+	uint32_t	GetInputRate() const;
+	uint32_t	GetOutputRate() const;
+	uint32_t	GetChannels() const;
+	uint32_t	GetLatency() const; /* In input frames */
+
+private:
+	void		Initialize(ResamplerQuality Quality);
+
+	using filter_ptr = std::shared_ptr<const std::vector<float>>;
+	using interpolate_t = void (*)(float* Out, const float* C0, const float* C1, float Frac, uint32_t Count);
+	using dot_product_t = float (*)(const float* X, const float* C, uint32_t Count);
+
+	static filter_ptr	GetFilter(uint32_t InRate, uint32_t OutRate, ResamplerQuality Quality);
+	static filter_ptr	BuildFilter(uint32_t InRate, uint32_t OutRate, ResamplerQuality Quality);
+
+	void		Push(float Sample);
+	void		Process();
+	void		Flush();
+
+	static constexpr uint32_t PhaseBits = 8;
+	static constexpr uint32_t Phases = 1 << PhaseBits;
+
+	uint32_t					m_InRate;
+	uint32_t					m_OutRate;
+	uint32_t					m_Channels;
+	uint32_t					m_Taps;
+	AudioFormat					m_OutFormat;
+	IAudioBuffer*				m_OutBuffer;
+
+	uint64_t					m_Step;			/* Input frames per output frame (32.32) */
+	uint64_t					m_Position;		/* Position within the history (32.32) */
+
+	filter_ptr					m_Filter;		/* Shared by all resamplers with the same rates / quality */
+	const float*				m_Coefficients;	/* (Phases + 1) x Taps */
+	std::vector<float>			m_Kernel;		/* Interpolated coefficients */
+	interpolate_t				m_Interpolate;	/* Kernels selected for the host CPU */
+	dot_product_t				m_DotProduct;
+	std::vector<std::vector<float>>	m_History;	/* Per channel input history */
+	std::vector<float>			m_Output;		/* Interleaved output block */
+	uint32_t					m_FramePos;		/* Channel of the next input sample */
+};
+
+#endif // !_AUDIO_RESAMPLER_H_
\ No newline at end of file
@@ -0,0 +1,212 @@
+/*
+ _____    _ _            ___
+|_   _| _(_) |_ ___ _ _ / __|___ _ _ ___
+  | || '_| |  _/ _ \ ' \ (__/ _ \ '_/ -_)
+  |_||_| |_|\__\___/_||_\___\___/_| \___|
+
+Copyright  2024, Michel Gerritse
+All rights reserved.
+
+This source code is available under the BSD-3-Clause license.
+See LICENSE.txt in the root directory of this source tree.
+
+*/
+#ifndef _AUDIO_RING_BUFFER_H_
+#define _AUDIO_RING_BUFFER_H_
+
+#include <atomic>
+#include <bit>
+#include <cstring>
+#include <vector>
+
+#include "../Interfaces/ISoundDevice.h"
+#include "Sample.h"
+
+/*
+	Lock-free audio ring buffer
+
+	Reference IAudioBuffer implementation for hosts that render on a worker thread
+	and pull audio from an (OS) audio callback thread.
+
+	- Single producer (the thread calling ISoundDevice::Update)
+	- Single consumer (the thread calling Read)
+	- Samples are converted to T on write (int16_t, int32_t or float)
+	- Samples are stored interleaved, overruns drop complete frames
+	- Underruns are padded with silence
+
+	Neither side ever blocks or takes a lock. The read and write positions are
+	free running counters, each owned by one side and published with release semantics.
+*/
+template<typename T>
+class AudioRingBuffer : public IAudioBuffer
+{
+public:
+	/* Capacity is rounded up to a power of 2 (in samples) */
+	AudioRingBuffer(size_t Frames, uint32_t Channels) :
+		m_Channels(std::max(Channels, 1u)),
+		m_Capacity(std::bit_ceil(std::max<size_t>(Frames, 1) * m_Channels)),
+		m_Mask(m_Capacity - 1),
+		m_Buffer(m_Capacity),
+		m_ReadPos(0),
+		m_WritePos(0),
+		m_Underruns(0),
+		m_Overruns(0),
+		m_FramePos(0),
+		m_DropFrame(false)
+	{
+	}
+
+	/* Size the buffer for a given latency budget of a sound device output */
+	AudioRingBuffer(const AUDIO_OUTPUT_DESC& Desc, uint32_t LatencyMs) :
+		AudioRingBuffer(((size_t)Desc.SampleRate * LatencyMs) / 1000, Desc.Channels)
+	{
+	}
+
+	~AudioRingBuffer() = default;
+
+	AudioRingBuffer(const AudioRingBuffer&) = delete;
+	AudioRingBuffer& operator=(const AudioRingBuffer&) = delete;
+
+	/* IAudioBuffer methods (producer) */
+	void WriteSampleS16(int16_t Sample) { Push(Audio::ConvertSample<T>(Sample)); }
+	void WriteSampleS32(int32_t Sample) { Push(Audio::ConvertSample<T>(Sample)); }
+	void WriteSampleF32(float Sample) { Push(Audio::ConvertSample<T>(Sample)); }
+
+	void WriteSamplesS16(const int16_t* Samples, size_t Count) { PushBlock(Samples, Count); }
+	void WriteSamplesS32(const int32_t* Samples, size_t Count) { PushBlock(Samples, Count); }
+	void WriteSamplesF32(const float* Samples, size_t Count) { PushBlock(Samples, Count); }
+
+	/* Read interleaved frames (consumer)
+	   Missing frames are filled with silence, returns the number of frames actually read */
+	size_t Read(T* Out, size_t Frames)
+	{
+		size_t ReadPos = m_ReadPos.load(std::memory_order_relaxed);
+		size_t WritePos = m_WritePos.load(std::memory_order_acquire);
+
+		size_t Available = (WritePos - ReadPos) / m_Channels;
+		size_t Count = std::min(Available, Frames) * m_Channels;
+
+		/* Copy samples (in at most 2 parts) */
+		size_t Index = ReadPos & m_Mask;
+		size_t Part = std::min(Count, m_Capacity - Index);
+
+		memcpy(Out, &m_Buffer[Index], Part * sizeof(T));
+		memcpy(Out + Part, &m_Buffer[0], (Count - Part) * sizeof(T));
+
+		m_ReadPos.store(ReadPos + Count, std::memory_order_release);
+
+		if (Count < Frames * m_Channels)
+		{
+			/* Buffer underrun */
+			std::fill(Out + Count, Out + (Frames * m_Channels), (T)0);
+			m_Underruns.fetch_add(Frames - (Count / m_Channels), std::memory_order_relaxed);
+		}
+
+		return Count / m_Channels;
+	}
+
+	/* Discard all buffered frames (consumer) */
+	void Flush()
+	{
+		size_t WritePos = m_WritePos.load(std::memory_order_acquire);
+		size_t ReadPos = m_ReadPos.load(std::memory_order_relaxed);
+
+		/* Keep a partially written frame intact */
+		ReadPos += ((WritePos - ReadPos) / m_Channels) * m_Channels;
+
+		m_ReadPos.store(ReadPos, std::memory_order_release);
+	}
+
+	/* Buffer status (safe from either side) */
+	size_t GetFramesAvailable() const
+	{
+		return (m_WritePos.load(std::memory_order_acquire) - m_ReadPos.load(std::memory_order_acquire)) / m_Channels;
+	}
+
+	size_t GetCapacity() const { return m_Capacity / m_Channels; } /* In frames */
+	uint32_t GetChannels() const { return m_Channels; }
+
+	/* Underruns are counted in missing frames, overruns in dropped frames */
+	uint64_t GetUnderrunCount() const { return m_Underruns.load(std::memory_order_relaxed); }
+	uint64_t GetOverrunCount() const { return m_Overruns.load(std::memory_order_relaxed); }
+
+	void ResetCounters()
+	{
+		m_Underruns.store(0, std::memory_order_relaxed);
+		m_Overruns.store(0, std::memory_order_relaxed);
+	}
+
+private:
+	inline size_t GetFreeSpace(size_t WritePos) const
+	{
+		return m_Capacity - (WritePos - m_ReadPos.load(std::memory_order_acquire));
+	}
+
+	inline void Push(T Sample)
+	{
+		size_t WritePos = m_WritePos.load(std::memory_order_relaxed);
+
+		/* Whole frames only: the decision to drop is made on the first sample of a frame */
+		if (m_FramePos == 0)
+		{
+			m_DropFrame = GetFreeSpace(WritePos) < m_Channels;
+
+			if (m_DropFrame) m_Overruns.fetch_add(1, std::memory_order_relaxed);
+		}
+
+		if (++m_FramePos == m_Channels) m_FramePos = 0;
+
+		if (m_DropFrame) return;
+
+		m_Buffer[WritePos & m_Mask] = Sample;
+		m_WritePos.store(WritePos + 1, std::memory_order_release);
+	}
+
+	template<typename S>
+	void PushBlock(const S* Samples, size_t Count)
+	{
+		/* Complete a partially written frame first */
+		while ((m_FramePos != 0) && (Count != 0))
+		{
+			Push(Audio::ConvertSample<T>(*Samples++));
+			Count--;
+		}
+
+		size_t WritePos = m_WritePos.load(std::memory_order_relaxed);
+		size_t Frames = Count / m_Channels;
+		size_t Fit = std::min(Frames, GetFreeSpace(WritePos) / m_Channels);
+
+		if (Fit < Frames) m_Overruns.fetch_add(Frames - Fit, std::memory_order_relaxed);
+
+		for (size_t i = 0; i < Fit * m_Channels; i++)
+		{
+			m_Buffer[(WritePos + i) & m_Mask] = Audio::ConvertSample<T>(Samples[i]);
+		}
+
+		m_WritePos.store(WritePos + (Fit * m_Channels), std::memory_order_release);
+
+		/* Trailing partial frame */
+		for (size_t i = Frames * m_Channels; i < Count; i++)
+		{
+			Push(Audio::ConvertSample<T>(Samples[i]));
+		}
+	}
+
+	const uint32_t			m_Channels;
+	const size_t			m_Capacity;	/* In samples */
+	const size_t			m_Mask;
+	std::vector<T>			m_Buffer;
+
+	/* Consumer and producer positions live on separate cache lines */
+	alignas(64) std::atomic<size_t>		m_ReadPos;
+	alignas(64) std::atomic<size_t>		m_WritePos;
+
+	alignas(64) std::atomic<uint64_t>	m_Underruns;
+	std::atomic<uint64_t>				m_Overruns;
+
+	/* Producer-only state */
+	uint32_t	m_FramePos;
+	bool		m_DropFrame;
+};
+
+#endif // !_AUDIO_RING_BUFFER_H_
\ No newline at end of file
@@ -0,0 +1,70 @@
+/*
+ _____    _ _            ___
+|_   _| _(_) |_ ___ _ _ / __|___ _ _ ___
+  | || '_| |  _/ _ \ ' \ (__/ _ \ '_/ -_)
+  |_||_| |_|\__\___/_||_\___\___/_| \___|
+
+Copyright  2024, Michel Gerritse
+All rights reserved.
+
+This source code is available under the BSD-3-Clause license.
+See LICENSE.txt in the root directory of this source tree.
+
+*/
+#ifndef _AUDIO_SAMPLE_H_
+#define _AUDIO_SAMPLE_H_
+
+#include <algorithm>
+#include <cstdint>
+#include <type_traits>
+
+#include "../Interfaces/IAudioBuffer.h"
+
+namespace Audio
+{
+	/* Sample type to audio format mapping */
+	template<typename T>
+	constexpr AudioFormat FormatOf()
+	{
+		static_assert(std::is_same_v<T, int16_t> || std::is_same_v<T, int32_t> || std::is_same_v<T, float>, "Unsupported sample type");
+
+		if constexpr (std::is_same_v<T, int16_t>) return AudioFormat::AUDIO_FMT_S16;
+		else if constexpr (std::is_same_v<T, int32_t>) return AudioFormat::AUDIO_FMT_S32;
+		else return AudioFormat::AUDIO_FMT_F32;
+	}
+
+	/* Sample size in bytes for a given audio format */
+	constexpr uint32_t SizeOf(AudioFormat Format)
+	{
+		return (Format == AudioFormat::AUDIO_FMT_S16) ? 2 : 4;
+	}
+
+	/* Convert a 16-bit signed sample */
+	template<typename T>
+	constexpr T ConvertSample(int16_t Sample)
+	{
+		if constexpr (std::is_same_v<T, int16_t>) return Sample;
+		else if constexpr (std::is_same_v<T, int32_t>) return (int32_t)Sample * 65536;
+		else return Sample * (1.0f / 32768.0f);
+	}
+
+	/* Convert a 32-bit signed sample */
+	template<typename T>
+	constexpr T ConvertSample(int32_t Sample)
+	{
+		if constexpr (std::is_same_v<T, int16_t>) return Sample >> 16;
+		else if constexpr (std::is_same_v<T, int32_t>) return Sample;
+		else return Sample * (1.0f / 2147483648.0f);
+	}
+
+	/* Convert a 32-bit floating point sample (clipped to -1.0 : +1.0) */
+	template<typename T>
+	constexpr T ConvertSample(float Sample)
+	{
+		if constexpr (std::is_same_v<T, int16_t>) return (int16_t)std::clamp(Sample * 32768.0f, -32768.0f, 32767.0f);
+		else if constexpr (std::is_same_v<T, int32_t>) return (int32_t)std::clamp((double)Sample * 2147483648.0, -2147483648.0, 2147483647.0);
+		else return Sample;
+	}
+}
+
+#endif // !_AUDIO_SAMPLE_H_
\ No newline at end of file
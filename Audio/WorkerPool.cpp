@@ -0,0 +1,123 @@
+/*
+ _____    _ _            ___
+|_   _| _(_) |_ ___ _ _ / __|___ _ _ ___
+  | || '_| |  _/ _ \ ' \ (__/ _ \ '_/ -_)
+  |_||_| |_|\__\___/_||_\___\___/_| \___|
+
+Copyright  2024, Michel Gerritse
+All rights reserved.
+
+This source code is available under the BSD-3-Clause license.
+See LICENSE.txt in the root directory of this source tree.
+
+*/
+#include "WorkerPool.h"
+
+WorkerPool::WorkerPool(uint32_t Threads) :
+	m_Job(nullptr),
+	m_JobCount(0),
+	m_NextJob(0),
+	m_Completed(0),
+	m_Active(0),
+	m_Generation(0),
+	m_Exit(false)
+{
+	for (uint32_t i = 0; i < Threads; i++)
+	{
+		m_Threads.emplace_back(&WorkerPool::WorkerThread, this);
+	}
+}
+
+WorkerPool::~WorkerPool()
+{
+	{
+		std::lock_guard<std::mutex> Lock(m_Mutex);
+		m_Exit = true;
+	}
+
+	m_Start.notify_all();
+
+	for (auto& Thread : m_Threads) Thread.join();
+}
+
+void WorkerPool::Run(size_t Jobs, const std::function<void(size_t)>& Job)
+{
+	if (Jobs == 0) return;
+
+	if (m_Threads.empty() || (Jobs == 1))
+	{
+		/* Nothing to fork */
+		for (size_t i = 0; i < Jobs; i++) Job(i);
+		return;
+	}
+
+	{
+		std::lock_guard<std::mutex> Lock(m_Mutex);
+
+		m_Job = &Job;
+		m_JobCount = Jobs;
+		m_NextJob.store(0);
+		m_Completed = 0;
+		m_Generation++;
+	}
+
+	m_Start.notify_all();
+
+	/* The calling thread takes jobs as well */
+	RunJobs();
+
+	/* Wait for all jobs and for all workers to leave the job loop */
+	std::unique_lock<std::mutex> Lock(m_Mutex);
+	m_Done.wait(Lock, [this] { return (m_Completed == m_JobCount) && (m_Active == 0); });
+
+	m_Job = nullptr;
+}
+
+uint32_t WorkerPool::GetThreadCount() const
+{
+	return (uint32_t)m_Threads.size();
+}
+
+void WorkerPool::WorkerThread()
+{
+	uint64_t Generation = 0;
+
+	while (true)
+	{
+		{
+			std::unique_lock<std::mutex> Lock(m_Mutex);
+			m_Start.wait(Lock, [&] { return m_Exit || (m_Generation != Generation); });
+
+			if (m_Exit) return;
+
+			Generation = m_Generation;
+			m_Active++;
+		}
+
+		RunJobs();
+
+		{
+			std::lock_guard<std::mutex> Lock(m_Mutex);
+			if (--m_Active == 0) m_Done.notify_all();
+		}
+	}
+}
+
+void WorkerPool::RunJobs()
+{
+	size_t Done = 0;
+	size_t JobNr;
+
+	while ((JobNr = m_NextJob.fetch_add(1)) < m_JobCount)
+	{
+		(*m_Job)(JobNr);
+		Done++;
+	}
+
+	if (Done != 0)
+	{
+		std::lock_guard<std::mutex> Lock(m_Mutex);
+
+		m_Completed += Done;
+	}
+}
\ No newline at end of file
@@ -0,0 +1,59 @@
+/*
+ _____    _ _            ___
+|_   _| _(_) |_ ___ _ _ / __|___ _ _ ___
+  | || '_| |  _/ _ \ ' \ (__/ _ \ '_/ -_)
+  |_||_| |_|\__\___/_||_\___\___/_| \___|
+
+Copyright  2024, Michel Gerritse
+All rights reserved.
+
+This source code is available under the BSD-3-Clause license.
+See LICENSE.txt in the root directory of this source tree.
+
+*/
+#ifndef _WORKER_POOL_H_
+#define _WORKER_POOL_H_
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/* Small fork-join worker pool */
+class WorkerPool
+{
+public:
+	/* Threads = number of worker threads (the calling thread always helps out) */
+	WorkerPool(uint32_t Threads);
+	~WorkerPool();
+
+	WorkerPool(const WorkerPool&) = delete;
+	WorkerPool& operator=(const WorkerPool&) = delete;
+
+	/* Run Job(0) ... Job(Jobs - 1) and wait until all jobs are completed */
+	void		Run(size_t Jobs, const std::function<void(size_t)>& Job);
+
+	uint32_t	GetThreadCount() const;
+
+private:
+	void		WorkerThread();
+	void		RunJobs();
+
+	std::vector<std::thread>			m_Threads;
+	std::mutex							m_Mutex;
+	std::condition_variable				m_Start;
+	std::condition_variable				m_Done;
+
+	const std::function<void(size_t)>*	m_Job;
+	size_t								m_JobCount;
+	std::atomic<size_t>					m_NextJob;
+	size_t								m_Completed;	/* Protected by m_Mutex */
+	uint32_t							m_Active;		/* Workers inside the job loop, protected by m_Mutex */
+	uint64_t							m_Generation;	/* Protected by m_Mutex */
+	bool								m_Exit;			/* Protected by m_Mutex */
+};
+
+#endif // !_WORKER_POOL_H_
\ No newline at end of file
@@ -0,0 +1,219 @@
+/*
+ _____    _ _            ___
+|_   _| _(_) |_ ___ _ _ / __|___ _ _ ___
+  | || '_| |  _/ _ \ ' \ (__/ _ \ '_/ -_)
+  |_||_| |_|\__\___/_||_\___\___/_| \___|
+
+Copyright  2024, Michel Gerritse
+All rights reserved.
+
+This source code is available under the BSD-3-Clause license.
+See LICENSE.txt in the root directory of this source tree.
+
+*/
+#ifndef _TRITON_CORE_BAND_LIMITED_H_
+#define _TRITON_CORE_BAND_LIMITED_H_
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+#include "../Interfaces/IAudioBuffer.h"
+
+/// <summary>TritonCore API version 1</summary>
+namespace TritonCore_v1
+{
+	/// <summary>Band-limited step synthesis of a piecewise constant signal.</summary>
+	/// <remarks>
+	/// Square wave style generators (tone, noise, envelope steps) produce a signal that only
+	/// changes at discrete ticks. Instead of outputting a sample per tick, every level change is
+	/// inserted as a band-limited step into the output at the requested sample rate. This makes
+	/// the output alias free and no resampling pass is needed afterwards.
+	/// The output is delayed by Taps / 2 output samples.
+	/// </remarks>
+	class BandLimitedSynth
+	{
+	public:
+		static constexpr uint32_t Taps = 16;		/* Step kernel length (output samples) */
+		static constexpr uint32_t PhaseBits = 6;	/* Sub-sample resolution of a step */
+		static constexpr uint32_t Phases = 1 << PhaseBits;
+		static constexpr uint32_t Shift = 15;		/* Kernel precision */
+
+		BandLimitedSynth() :
+			m_InRate(0),
+			m_OutRate(0),
+			m_Step(0)
+		{
+			Clear();
+		}
+
+		/// <summary>Set the tick rate of the generator and the output rate, an output rate of 0 bypasses the synthesis.</summary>
+		void SetRates(uint32_t InRate, uint32_t OutRate)
+		{
+			if ((InRate == m_InRate) && (OutRate == m_OutRate)) return;
+
+			m_InRate = InRate;
+			m_OutRate = OutRate;
+			m_Step = ((OutRate != 0) && (InRate != 0)) ? (((uint64_t)OutRate << 32) / InRate) : 0;
+
+			Clear();
+		}
+
+		/// <summary>Change the tick rate of the generator (eg. after a clock or prescaler change).</summary>
+		inline void SetInputRate(uint32_t InRate)
+		{
+			SetRates(InRate, m_OutRate);
+		}
+
+		/// <summary>Returns the output sample rate, the tick rate when bypassed.</summary>
+		inline uint32_t GetSampleRate(uint32_t InRate) const
+		{
+			return (m_OutRate != 0) ? m_OutRate : InRate;
+		}
+
+		/// <summary>Forget the output history.</summary>
+		void Clear()
+		{
+			m_Time = 0;
+			m_Level = 0;
+			m_Sum = 0;
+			m_Buffer.assign(BufferSize + Taps, 0);
+		}
+
+		/// <summary>Returns true if the output is synthesized at the output rate.</summary>
+		inline bool IsEnabled() const
+		{
+			return m_Step != 0;
+		}
+
+		/// <summary>Output the level of the next tick.</summary>
+		template<typename T>
+		inline void Write(int32_t Level, AudioBlock<T>& Block)
+		{
+			if (m_Step == 0)
+			{
+				/* Bypassed, output at the tick rate */
+				Block.Write((T)Level);
+				return;
+			}
+
+			if (Level != m_Level)
+			{
+				AddStep(Level - m_Level);
+				m_Level = Level;
+			}
+
+			m_Time += m_Step;
+
+			if ((m_Time >> 32) >= BufferSize) Flush(Block);
+		}
+
+		/// <summary>Output all completed output samples, call at the end of an update.</summary>
+		template<typename T>
+		void Flush(AudioBlock<T>& Block)
+		{
+			if (m_Step == 0) return;
+
+			/* Steps are only inserted at or after the current time, the samples before are final */
+			uint32_t Samples = (uint32_t)(m_Time >> 32);
+
+			for (uint32_t i = 0; i < Samples; i++)
+			{
+				m_Sum += m_Buffer[i];
+
+				int64_t Out = m_Sum >> Shift;
+
+				if constexpr (std::is_same_v<T, int16_t>) Out = std::clamp<int64_t>(Out, INT16_MIN, INT16_MAX);
+
+				Block.Write((T)Out);
+			}
+
+			/* Move the pending kernel tails to the front */
+			std::copy(m_Buffer.begin() + Samples, m_Buffer.begin() + Samples + Taps, m_Buffer.begin());
+			std::fill(m_Buffer.begin() + Taps, m_Buffer.begin() + Samples + Taps, 0);
+
+			m_Time -= (uint64_t)Samples << 32;
+		}
+
+	private:
+		static constexpr uint32_t BufferSize = 256; /* Output samples per flush */
+
+		using kernel_t = std::vector<int32_t>; /* Phases x Taps */
+
+		/* Windowed sinc impulse per sub-sample phase, integrating the impulses gives the band-limited step */
+		static const kernel_t& GetKernel()
+		{
+			static const kernel_t Kernel = []
+			{
+				const double Pi = 3.14159265358979323846;
+				const double Cutoff = 0.90; /* Relative to the output Nyquist frequency */
+
+				kernel_t Table(Phases * Taps);
+
+				for (uint32_t Phase = 0; Phase < Phases; Phase++)
+				{
+					double Coeff[Taps];
+					double Sum = 0.0;
+
+					for (uint32_t Tap = 0; Tap < Taps; Tap++)
+					{
+						/* Distance to the step (output samples) */
+						double x = (double)Tap - (Taps / 2) + 1 - ((double)Phase / Phases);
+						double Sinc = (x == 0.0) ? 1.0 : std::sin(Pi * Cutoff * x) / (Pi * Cutoff * x);
+
+						/* Blackman window */
+						double w = (x + (Taps / 2)) / Taps;
+						double Window = 0.42 - (0.5 * std::cos(2.0 * Pi * w)) + (0.08 * std::cos(4.0 * Pi * w));
+
+						Coeff[Tap] = Sinc * std::max(Window, 0.0);
+						Sum += Coeff[Tap];
+					}
+
+					/* Normalize, each phase sums up to exactly 1 << Shift so a step settles at its exact level */
+					int32_t Total = 0;
+					uint32_t Center = 0;
+
+					for (uint32_t Tap = 0; Tap < Taps; Tap++)
+					{
+						int32_t c = (int32_t)std::lround((Coeff[Tap] / Sum) * (1 << Shift));
+
+						Table[(Phase * Taps) + Tap] = c;
+						Total += c;
+
+						if (c > Table[(Phase * Taps) + Center]) Center = Tap;
+					}
+
+					Table[(Phase * Taps) + Center] += (1 << Shift) - Total;
+				}
+
+				return Table;
+			}();
+
+			return Kernel;
+		}
+
+		inline void AddStep(int32_t Delta)
+		{
+			static const kernel_t& Kernel = GetKernel();
+
+			uint32_t Offset = (uint32_t)(m_Time >> 32);
+			uint32_t Phase = (uint32_t)(m_Time >> (32 - PhaseBits)) & (Phases - 1);
+
+			const int32_t* pKernel = &Kernel[Phase * Taps];
+			int64_t* pBuffer = &m_Buffer[Offset];
+
+			for (uint32_t Tap = 0; Tap < Taps; Tap++) pBuffer[Tap] += (int64_t)Delta * pKernel[Tap];
+		}
+
+		uint32_t				m_InRate;	/* Tick rate */
+		uint32_t				m_OutRate;	/* Output sample rate */
+		uint64_t				m_Step;		/* Output samples per tick (32.32) */
+		uint64_t				m_Time;		/* Output time within the buffer (32.32) */
+		int32_t					m_Level;	/* Current input level */
+		int64_t					m_Sum;		/* Output integrator */
+		std::vector<int64_t>	m_Buffer;	/* Pending step kernels */
+	};
+}
+
+#endif // !_TRITON_CORE_BAND_LIMITED_H_
\ No newline at end of file
@@ -0,0 +1,198 @@
+/*
+ _____    _ _            ___
+|_   _| _(_) |_ ___ _ _ / __|___ _ _ ___
+  | || '_| |  _/ _ \ ' \ (__/ _ \ '_/ -_)
+  |_||_| |_|\__\___/_||_\___\___/_| \___|
+
+Copyright  2024, Michel Gerritse
+All rights reserved.
+
+This source code is available under the BSD-3-Clause license.
+See LICENSE.txt in the root directory of this source tree.
+
+*/
+#ifndef _TRITON_CORE_CPU_H_
+#define _TRITON_CORE_CPU_H_
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+#include <intrin.h>
+#define TC_CPU_X86 1
+#elif (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+#define TC_CPU_X86 1
+#else
+#define TC_CPU_X86 0
+#endif
+
+#if defined(__ARM_NEON) || defined(_M_ARM64)
+#define TC_CPU_NEON 1
+#else
+#define TC_CPU_NEON 0
+#endif
+
+/* Functions using intrinsics of an instruction set that is not enabled for the whole build.
+   MSVC does not need them, its intrinsics are always available */
+#if TC_CPU_X86 && (defined(__GNUC__) || defined(__clang__))
+#define TC_TARGET_SSE41 __attribute__((target("sse4.1")))
+#define TC_TARGET_AVX2 __attribute__((target("avx2")))
+#define TC_TARGET_AVX512 __attribute__((target("avx512f,avx512bw")))
+#else
+#define TC_TARGET_SSE41
+#define TC_TARGET_AVX2
+#define TC_TARGET_AVX512
+#endif
+
+/// <summary>TritonCore API version 1</summary>
+namespace TritonCore_v1
+{
+	/// <summary>Instruction set extensions of the host CPU.</summary>
+	struct CpuFeatures
+	{
+		bool	SSE2;	/* SSE2 */
+		bool	SSE41;	/* SSE4.1 */
+		bool	AVX2;	/* AVX2 (including OS support for the YMM registers) */
+		bool	AVX512;	/* AVX-512 F and BW (including OS support for the ZMM registers) */
+		bool	NEON;	/* ARM Advanced SIMD */
+	};
+
+	/// <summary>Kernel implementation tiers, ordered from the least to the most preferred.</summary>
+	enum class CpuTier : uint32_t
+	{
+		Scalar = 0,
+		SSE2,
+		SSE41,
+		AVX2,
+		AVX512,
+		NEON,
+		Count
+	};
+
+	namespace Detail
+	{
+		inline std::atomic<bool> ForceScalar = false;
+
+		inline const CpuFeatures& DetectCpuFeatures()
+		{
+			static const CpuFeatures Features = []
+			{
+				CpuFeatures Result = {};
+
+#if TC_CPU_X86 && defined(_MSC_VER)
+				int Regs[4];
+
+				__cpuid(Regs, 0);
+				int MaxLeaf = Regs[0];
+
+				__cpuid(Regs, 1);
+				Result.SSE2 = (Regs[3] & (1 << 26)) != 0;
+				Result.SSE41 = (Regs[2] & (1 << 19)) != 0;
+
+				/* AVX2 and AVX-512 require OSXSAVE and the OS saving the XMM/YMM (and ZMM) state */
+				bool OsXSave = ((Regs[2] & (1 << 27)) != 0) && ((Regs[2] & (1 << 28)) != 0);
+				unsigned long long XCR0 = OsXSave ? _xgetbv(0) : 0;
+
+				if (MaxLeaf >= 7)
+				{
+					__cpuidex(Regs, 7, 0);
+					Result.AVX2 = ((XCR0 & 0x06) == 0x06) && ((Regs[1] & (1 << 5)) != 0);
+					Result.AVX512 = ((XCR0 & 0xE6) == 0xE6) && ((Regs[1] & (1 << 16)) != 0) && ((Regs[1] & (1 << 30)) != 0);
+				}
+#elif TC_CPU_X86
+				/* Note: the GCC / clang builtins include the OS support checks */
+				__builtin_cpu_init();
+
+				Result.SSE2 = __builtin_cpu_supports("sse2");
+				Result.SSE41 = __builtin_cpu_supports("sse4.1");
+				Result.AVX2 = __builtin_cpu_supports("avx2");
+				Result.AVX512 = __builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512bw");
+#elif TC_CPU_NEON
+				Result.NEON = true;
+#endif
+				return Result;
+			}();
+
+			return Features;
+		}
+	}
+
+	/// <summary>Force scalar kernels, eg. to compare the kernel tiers in a test.</summary>
+	/// <remarks>
+	/// Devices select their kernels when they are created, the override applies to devices
+	/// (and resamplers) created afterwards.
+	/// </remarks>
+	/// <param name="Enable">True to report no instruction set extensions.</param>
+	inline void ForceScalar(bool Enable)
+	{
+		Detail::ForceScalar = Enable;
+	}
+
+	/// <summary>Get the instruction set extensions of the host CPU.</summary>
+	/// <returns>The detected features (none when scalar kernels are forced), the detection only runs once.</returns>
+	inline const CpuFeatures& GetCpuFeatures()
+	{
+		static const CpuFeatures None = {};
+
+		return Detail::ForceScalar ? None : Detail::DetectCpuFeatures();
+	}
+
+	/// <summary>Test if the host CPU supports a kernel tier.</summary>
+	inline bool IsSupported(CpuTier Tier)
+	{
+		auto& Features = GetCpuFeatures();
+
+		switch (Tier)
+		{
+		case CpuTier::Scalar:	return true;
+		case CpuTier::SSE2:		return Features.SSE2;
+		case CpuTier::SSE41:	return Features.SSE41;
+		case CpuTier::AVX2:		return Features.AVX2;
+		case CpuTier::AVX512:	return Features.AVX512;
+		case CpuTier::NEON:		return Features.NEON;
+		default:				return false;
+		}
+	}
+
+	/// <summary>Implementations of a kernel per tier, the most preferred supported tier is selected.</summary>
+	/// <remarks>
+	/// Kernels of the tiers that are not compiled in (eg. AVX2 on ARM) are simply not added.
+	/// Example:
+	///   m_Mix = TC::CpuKernels(MixScalar).Add(TC::CpuTier::SSE2, MixSSE2).Select();
+	/// </remarks>
+	template<typename F>
+	class CpuKernels
+	{
+	public:
+		/// <param name="Scalar">The scalar kernel, it is used when no other tier is supported.</param>
+		constexpr CpuKernels(F Scalar) :
+			m_Kernel{}
+		{
+			m_Kernel[0] = Scalar;
+		}
+
+		/// <summary>Add the kernel of a tier.</summary>
+		constexpr CpuKernels& Add(CpuTier Tier, F Kernel)
+		{
+			m_Kernel[(size_t)Tier] = Kernel;
+			return *this;
+		}
+
+		/// <summary>Select the kernel of the most preferred tier that is supported by the host CPU.</summary>
+		F Select() const
+		{
+			for (size_t Tier = (size_t)CpuTier::Count - 1; Tier > 0; Tier--)
+			{
+				if ((m_Kernel[Tier] != nullptr) && IsSupported((CpuTier)Tier)) return m_Kernel[Tier];
+			}
+
+			return m_Kernel[0];
+		}
+
+	private:
+		F m_Kernel[(size_t)CpuTier::Count];
+	};
+}
+
+#endif // !_TRITON_CORE_CPU_H_
\ No newline at end of file
@@ -0,0 +1,253 @@
+/*
+ _____    _ _            ___
+|_   _| _(_) |_ ___ _ _ / __|___ _ _ ___
+  | || '_| |  _/ _ \ ' \ (__/ _ \ '_/ -_)
+  |_||_| |_|\__\___/_||_\___\___/_| \___|
+
+Copyright  2024, Michel Gerritse
+All rights reserved.
+
+This source code is available under the BSD-3-Clause license.
+See LICENSE.txt in the root directory of this source tree.
+
+*/
+#ifndef _TRITON_CORE_DEVICE_POOL_H_
+#define _TRITON_CORE_DEVICE_POOL_H_
+
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <type_traits>
+#include <vector>
+
+#include "../Interfaces/ISoundDevice.h"
+#include "../Interfaces/IMemoryAccess.h"
+
+/// <summary>TritonCore API version 1</summary>
+namespace TritonCore_v1
+{
+	/// <summary>Pool of initialized device instances of one type and configuration.</summary>
+	/// <remarks>
+	/// Constructing a device allocates and clears its memories, which is expensive for the sample
+	/// based devices (eg. YMF278B, YMW258F with its LDSP). Returned instances are kept instead: they
+	/// get an InitialClear reset, which only touches the register state, and the device writes to
+	/// their memories are reverted (see IMemoryAccess::RevertMemory). A pooled instance therefore
+	/// still holds the uploaded ROM image, which is identified by a host defined tag (eg. a hash of
+	/// the image, 0 = none). Acquiring with the same tag hands out such an instance as is, any other
+	/// instance gets a power-on reset first. Instances returned without a tag are power-on reset
+	/// right away, their memory contents are unknown.
+	/// Host settings (eg. an IRQ callback or the clock speed) are not reset, configure them in the
+	/// factory or set them again after acquiring.
+	/// The pool has to outlive the devices handed out. All methods are thread-safe, a device itself
+	/// is owned by the thread that acquired it.
+	/// Example:
+	///   TC::DevicePool<YMF278B> Pool([] { return std::make_unique<YMF278B>(); });
+	///   auto Device = Pool.Acquire(RomTag);
+	///   if (Device.GetRomTag() != RomTag) { ...upload the ROM...; Device.SetRomTag(RomTag); }
+	/// </remarks>
+	template<typename T>
+	class DevicePool
+	{
+	public:
+		using Factory = std::function<std::unique_ptr<T>()>;
+
+		/// <summary>A device handed out by the pool, it is returned to the pool when destroyed.</summary>
+		class Lease
+		{
+		public:
+			Lease() :
+				m_Pool(nullptr),
+				m_Device(nullptr),
+				m_RomTag(0)
+			{
+			}
+
+			Lease(Lease&& Other) noexcept :
+				m_Pool(Other.m_Pool),
+				m_Device(Other.m_Device),
+				m_RomTag(Other.m_RomTag)
+			{
+				Other.m_Device = nullptr;
+			}
+
+			Lease& operator=(Lease&& Other) noexcept
+			{
+				if (this != &Other)
+				{
+					Release();
+
+					m_Pool = Other.m_Pool;
+					m_Device = Other.m_Device;
+					m_RomTag = Other.m_RomTag;
+
+					Other.m_Device = nullptr;
+				}
+
+				return *this;
+			}
+
+			Lease(const Lease&) = delete;
+			Lease& operator=(const Lease&) = delete;
+
+			~Lease()
+			{
+				Release();
+			}
+
+			T* Get() const
+			{
+				return m_Device;
+			}
+
+			T* operator->() const
+			{
+				return m_Device;
+			}
+
+			explicit operator bool() const
+			{
+				return m_Device != nullptr;
+			}
+
+			/// <summary>Tag of the ROM image held by the device (0 = none, upload it).</summary>
+			uint64_t GetRomTag() const
+			{
+				return m_RomTag;
+			}
+
+			/// <summary>Set after uploading (or attaching) the ROM image identified by Tag.</summary>
+			/// <remarks>An attached host buffer has to stay valid while the device is pooled.</remarks>
+			void SetRomTag(uint64_t Tag)
+			{
+				m_RomTag = Tag;
+			}
+
+			/// <summary>Return the device to the pool.</summary>
+			void Release()
+			{
+				if (m_Device == nullptr) return;
+
+				m_Pool->Return(m_Device, m_RomTag);
+				m_Device = nullptr;
+			}
+
+		private:
+			friend class DevicePool;
+
+			Lease(DevicePool* Pool, T* Device, uint64_t RomTag) :
+				m_Pool(Pool),
+				m_Device(Device),
+				m_RomTag(RomTag)
+			{
+			}
+
+			DevicePool*	m_Pool;
+			T*			m_Device;
+			uint64_t	m_RomTag;
+		};
+
+		/// <param name="Create">Creates a new instance, with the configuration shared by all pooled instances.</param>
+		/// <param name="MaxIdle">Number of idle instances kept, instances returned to a full pool are destroyed.</param>
+		DevicePool(Factory Create, size_t MaxIdle = 4) :
+			m_Create(std::move(Create)),
+			m_MaxIdle(MaxIdle)
+		{
+		}
+
+		DevicePool(const DevicePool&) = delete;
+		DevicePool& operator=(const DevicePool&) = delete;
+
+		/// <summary>Hand out a device for a ROM image, it is ready to play (reset, clock speed unchanged).</summary>
+		/// <param name="RomTag">Tag of the ROM image the host is going to use (0 = none).</param>
+		Lease Acquire(uint64_t RomTag = 0)
+		{
+			std::unique_ptr<T> Device;
+			uint64_t Tag = 0;
+
+			{
+				std::lock_guard<std::mutex> Lock(m_Mutex);
+
+				/* Prefer an instance holding the same ROM image, then the one returned last */
+				auto Match = m_Idle.end();
+
+				for (auto Entry = m_Idle.begin(); Entry != m_Idle.end(); ++Entry)
+				{
+					if ((RomTag != 0) && (Entry->RomTag == RomTag)) { Match = Entry; break; }
+					Match = Entry;
+				}
+
+				if (Match != m_Idle.end())
+				{
+					Device = std::move(Match->Device);
+					Tag = Match->RomTag;
+					m_Idle.erase(Match);
+				}
+			}
+
+			if (Device == nullptr)
+			{
+				/* A new instance is power-on reset by its constructor */
+				Device = m_Create();
+			}
+			else if ((Tag != RomTag) && (Tag != 0))
+			{
+				/* Drop the memory contents of the previous ROM image */
+				Device->Reset(ResetType::PowerOnDefaults);
+				Tag = 0;
+			}
+
+			return Lease(this, Device.release(), Tag);
+		}
+
+		/// <summary>Number of idle instances.</summary>
+		size_t GetIdleCount()
+		{
+			std::lock_guard<std::mutex> Lock(m_Mutex);
+
+			return m_Idle.size();
+		}
+
+		/// <summary>Destroy all idle instances.</summary>
+		void Clear()
+		{
+			std::vector<entry_t> Idle;
+
+			{
+				std::lock_guard<std::mutex> Lock(m_Mutex);
+				Idle.swap(m_Idle);
+			}
+		}
+
+	private:
+		struct entry_t
+		{
+			std::unique_ptr<T>	Device;
+			uint64_t			RomTag;
+		};
+
+		void Return(T* Pointer, uint64_t RomTag)
+		{
+			std::unique_ptr<T> Device(Pointer);
+
+			if constexpr (std::is_base_of_v<IMemoryAccess, T>)
+			{
+				/* The image is only known if the device writes can be undone */
+				if ((RomTag != 0) && !Device->RevertMemory()) RomTag = 0;
+			}
+
+			/* Warm reset keeping the ROM image, or a full one */
+			Device->Reset((RomTag != 0) ? ResetType::InitialClear : ResetType::PowerOnDefaults);
+
+			std::lock_guard<std::mutex> Lock(m_Mutex);
+
+			if (m_Idle.size() < m_MaxIdle) m_Idle.push_back({ std::move(Device), RomTag });
+		}
+
+		Factory					m_Create;
+		size_t					m_MaxIdle;
+		std::mutex				m_Mutex;
+		std::vector<entry_t>	m_Idle;		/* Ordered by return time */
+	};
+}
+
+#endif // !_TRITON_CORE_DEVICE_POOL_H_
\ No newline at end of file
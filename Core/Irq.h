@@ -0,0 +1,70 @@
+/*
+ _____    _ _            ___
+|_   _| _(_) |_ ___ _ _ / __|___ _ _ ___
+  | || '_| |  _/ _ \ ' \ (__/ _ \ '_/ -_)
+  |_||_| |_|\__\___/_||_\___\___/_| \___|
+
+Copyright  2024, Michel Gerritse
+All rights reserved.
+
+This source code is available under the BSD-3-Clause license.
+See LICENSE.txt in the root directory of this source tree.
+
+*/
+#ifndef _TRITON_CORE_IRQ_H_
+#define _TRITON_CORE_IRQ_H_
+
+#include <functional>
+
+/// <summary>TritonCore API version 1</summary>
+namespace TritonCore_v1
+{
+	/// <summary>Called when the interrupt output of a device changes (see ISoundDevice::SetIrqCallback).</summary>
+	/// <param name="Asserted">The interrupt output is active.</param>
+	using IrqCallback = std::function<void(bool Asserted)>;
+
+	/// <summary>Interrupt output of a device.</summary>
+	/// <remarks>
+	/// The device reports the state of its interrupt output after every update or register write,
+	/// the callback is only called when the state changes. The callback is called at the end of the
+	/// Update or Write call in which the output changed, a host that needs the exact clock cycle
+	/// updates the device up to the next event (see ISoundDevice::GetCyclesToNextEvent).
+	/// The callback is a host setting, it is not part of the device state.
+	/// </remarks>
+	class IrqLine
+	{
+	public:
+		IrqLine() :
+			m_Asserted(false)
+		{
+		}
+
+		/// <summary>Set the callback, an empty callback disables it.</summary>
+		void SetCallback(IrqCallback Callback)
+		{
+			m_Callback = std::move(Callback);
+		}
+
+		/// <summary>Report the state of the interrupt output.</summary>
+		inline void Set(bool Asserted)
+		{
+			if (Asserted == m_Asserted) return;
+
+			m_Asserted = Asserted;
+
+			if (m_Callback) m_Callback(Asserted);
+		}
+
+		/// <summary>The interrupt output is active.</summary>
+		inline bool IsAsserted() const
+		{
+			return m_Asserted;
+		}
+
+	private:
+		IrqCallback	m_Callback;
+		bool		m_Asserted;
+	};
+}
+
+#endif // !_TRITON_CORE_IRQ_H_
@@ -0,0 +1,171 @@
+/*
+ _____    _ _            ___
+|_   _| _(_) |_ ___ _ _ / __|___ _ _ ___
+  | || '_| |  _/ _ \ ' \ (__/ _ \ '_/ -_)
+  |_||_| |_|\__\___/_||_\___\___/_| \___|
+
+Copyright  2024, Michel Gerritse
+All rights reserved.
+
+This source code is available under the BSD-3-Clause license.
+See LICENSE.txt in the root directory of this source tree.
+
+*/
+#ifndef _TRITON_CORE_MEMORY_MAP_H_
+#define _TRITON_CORE_MEMORY_MAP_H_
+
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+/// <summary>TritonCore API version 1</summary>
+namespace TritonCore_v1
+{
+	/// <summary>Page table of a CPU address space.</summary>
+	/// <remarks>
+	/// Every page either points directly at host memory (RAM / ROM) or forwards the access
+	/// to a pair of handlers (I/O, sound chips, ...). Unmapped pages read as open bus and
+	/// ignore writes. A memory access is a table lookup, the address decoding is done once
+	/// when the map is built.
+	/// </remarks>
+	class MemoryMap
+	{
+	public:
+		using read_t = std::function<uint8_t(uint32_t Address)>;
+		using write_t = std::function<void(uint32_t Address, uint8_t Data)>;
+
+		/// <param name="AddressBits">Size of the address space.</param>
+		/// <param name="PageBits">Size of a page.</param>
+		MemoryMap(uint32_t AddressBits, uint32_t PageBits) :
+			m_PageBits(PageBits),
+			m_PageMask((1u << PageBits) - 1),
+			m_AddressMask((1u << AddressBits) - 1),
+			m_OpenBus(0xFF),
+			m_Pages(1ull << (AddressBits - PageBits))
+		{
+			Clear();
+		}
+
+		/// <summary>Unmap all pages.</summary>
+		void Clear()
+		{
+			for (auto& Page : m_Pages) Page = {};
+
+			m_Handlers.clear();
+		}
+
+		/// <summary>Value read from unmapped pages.</summary>
+		void SetOpenBus(uint8_t Data)
+		{
+			m_OpenBus = Data;
+		}
+
+		/// <summary>Map host memory, Start and Size must be page aligned.</summary>
+		/// <param name="Writable">False for ROM, writes are ignored.</param>
+		void MapMemory(uint32_t Start, uint32_t Size, uint8_t* Data, bool Writable)
+		{
+			for (uint32_t Offset = 0; Offset < Size; Offset += m_PageMask + 1)
+			{
+				Page& Page = PageOf(Start + Offset);
+
+				Page.Read = Data + Offset;
+				Page.Write = Writable ? (Data + Offset) : nullptr;
+				Page.Handler = 0;
+			}
+		}
+
+		/// <summary>Map read / write handlers, Start and Size must be page aligned.</summary>
+		/// <remarks>The handlers receive the full (masked) address. An empty handler reads as open bus / ignores writes.</remarks>
+		void MapHandler(uint32_t Start, uint32_t Size, read_t Read, write_t Write)
+		{
+			m_Handlers.push_back({ std::move(Read), std::move(Write) });
+
+			for (uint32_t Offset = 0; Offset < Size; Offset += m_PageMask + 1)
+			{
+				Page& Page = PageOf(Start + Offset);
+
+				Page.Read = nullptr;
+				Page.Write = nullptr;
+				Page.Handler = (uint32_t)m_Handlers.size();
+			}
+		}
+
+		/// <summary>Unmap pages, Start and Size must be page aligned.</summary>
+		void Unmap(uint32_t Start, uint32_t Size)
+		{
+			for (uint32_t Offset = 0; Offset < Size; Offset += m_PageMask + 1) PageOf(Start + Offset) = {};
+		}
+
+		/// <summary>Copy the pages of another map with the same layout.</summary>
+		void Assign(const MemoryMap& Other)
+		{
+			m_Pages = Other.m_Pages;
+			m_Handlers = Other.m_Handlers;
+		}
+
+		inline uint8_t Read8(uint32_t Address) const
+		{
+			const Page& Page = PageOf(Address);
+
+			if (Page.Read != nullptr) return Page.Read[Address & m_PageMask];
+			if (Page.Handler != 0) return ReadHandler(Page.Handler, Address & m_AddressMask);
+
+			return m_OpenBus;
+		}
+
+		inline void Write8(uint32_t Address, uint8_t Data)
+		{
+			const Page& Page = PageOf(Address);
+
+			if (Page.Write != nullptr) Page.Write[Address & m_PageMask] = Data;
+			else if (Page.Handler != 0) WriteHandler(Page.Handler, Address & m_AddressMask, Data);
+		}
+
+	private:
+		struct Page
+		{
+			uint8_t*	Read;		/* Host memory (read) */
+			uint8_t*	Write;		/* Host memory (write), null for ROM */
+			uint32_t	Handler;	/* Handler index + 1, 0 = none */
+		};
+
+		struct Handler
+		{
+			read_t		Read;
+			write_t		Write;
+		};
+
+		uint32_t			m_PageBits;
+		uint32_t			m_PageMask;
+		uint32_t			m_AddressMask;
+		uint8_t				m_OpenBus;
+		std::vector<Page>	m_Pages;
+		std::vector<Handler>	m_Handlers;
+
+		inline Page& PageOf(uint32_t Address)
+		{
+			return m_Pages[(Address & m_AddressMask) >> m_PageBits];
+		}
+
+		inline const Page& PageOf(uint32_t Address) const
+		{
+			return m_Pages[(Address & m_AddressMask) >> m_PageBits];
+		}
+
+		uint8_t ReadHandler(uint32_t Index, uint32_t Address) const
+		{
+			const read_t& Read = m_Handlers[Index - 1].Read;
+
+			return Read ? Read(Address) : m_OpenBus;
+		}
+
+		void WriteHandler(uint32_t Index, uint32_t Address, uint8_t Data)
+		{
+			const write_t& Write = m_Handlers[Index - 1].Write;
+
+			if (Write) Write(Address, Data);
+		}
+	};
+}
+
+#endif // !_TRITON_CORE_MEMORY_MAP_H_
@@ -0,0 +1,438 @@
+/*
+ _____    _ _            ___
+|_   _| _(_) |_ ___ _ _ / __|___ _ _ ___
+  | || '_| |  _/ _ \ ' \ (__/ _ \ '_/ -_)
+  |_||_| |_|\__\___/_||_\___\___/_| \___|
+
+Copyright  2024, Michel Gerritse
+All rights reserved.
+
+This source code is available under the BSD-3-Clause license.
+See LICENSE.txt in the root directory of this source tree.
+
+*/
+#ifndef _TRITON_CORE_ROM_CACHE_H_
+#define _TRITON_CORE_ROM_CACHE_H_
+
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+#if defined(_WIN32)
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include "StateHash.h"
+#include "../Interfaces/IMemoryAccess.h"
+
+/// <summary>TritonCore API version 1</summary>
+namespace TritonCore_v1
+{
+	/// <summary>Read-only ROM image, shared by all devices and hosts using the same content.</summary>
+	/// <remarks>
+	/// The image is either a read-only file mapping or a private heap copy. Mapped pages come from the
+	/// page cache of the OS, every process mapping the same ROM file shares the physical memory.
+	/// </remarks>
+	class RomImage
+	{
+	public:
+		RomImage(const RomImage&) = delete;
+		RomImage& operator=(const RomImage&) = delete;
+
+		~RomImage()
+		{
+			Unmap();
+		}
+
+		const uint8_t* Data() const
+		{
+			return m_Data;
+		}
+
+		size_t Size() const
+		{
+			return m_Size;
+		}
+
+		/// <summary>Content hash, usable as a DevicePool ROM tag.</summary>
+		uint64_t GetHash() const
+		{
+			return m_Hash;
+		}
+
+		/// <summary>True for a file mapping, false for a heap copy.</summary>
+		bool IsMapped() const
+		{
+			return m_Mapped;
+		}
+
+		/// <summary>Hash of the image content (never 0, which is the "no ROM" tag).</summary>
+		static uint64_t Hash(const uint8_t* Data, size_t Size)
+		{
+			StateHash Hash;
+
+			Hash.Add(Size);
+			Hash.Add(Data, Size);
+
+			return (Hash.Get() != 0) ? Hash.Get() : 1;
+		}
+
+	private:
+		friend class RomCache;
+
+		RomImage() :
+			m_Data(nullptr),
+			m_Size(0),
+			m_Hash(0),
+			m_Mapped(false)
+		{
+		}
+
+		/* Map a file read-only, the image is empty if that fails */
+		void Map(const std::filesystem::path& FileName)
+		{
+#if defined(_WIN32)
+			HANDLE File = CreateFileW(FileName.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+			if (File == INVALID_HANDLE_VALUE) return;
+
+			LARGE_INTEGER FileSize = {};
+
+			if (GetFileSizeEx(File, &FileSize) && (FileSize.QuadPart > 0))
+			{
+				/* The view keeps the mapping alive */
+				HANDLE Mapping = CreateFileMappingW(File, nullptr, PAGE_READONLY, 0, 0, nullptr);
+
+				if (Mapping != nullptr)
+				{
+					m_Data = static_cast<const uint8_t*>(MapViewOfFile(Mapping, FILE_MAP_READ, 0, 0, 0));
+					CloseHandle(Mapping);
+				}
+
+				if (m_Data != nullptr) m_Size = (size_t)FileSize.QuadPart;
+			}
+
+			CloseHandle(File);
+#else
+			int File = open(FileName.c_str(), O_RDONLY);
+			if (File < 0) return;
+
+			struct stat Info = {};
+
+			if ((fstat(File, &Info) == 0) && (Info.st_size > 0))
+			{
+				void* View = mmap(nullptr, (size_t)Info.st_size, PROT_READ, MAP_SHARED, File, 0);
+
+				if (View != MAP_FAILED)
+				{
+					m_Data = static_cast<const uint8_t*>(View);
+					m_Size = (size_t)Info.st_size;
+				}
+			}
+
+			close(File);
+#endif
+			m_Mapped = (m_Data != nullptr);
+		}
+
+		void Unmap()
+		{
+			if (!m_Mapped) return;
+
+#if defined(_WIN32)
+			UnmapViewOfFile(m_Data);
+#else
+			munmap(const_cast<uint8_t*>(m_Data), m_Size);
+#endif
+			m_Mapped = false;
+		}
+
+		const uint8_t*			m_Data;
+		size_t					m_Size;
+		uint64_t				m_Hash;
+		bool					m_Mapped;
+		std::vector<uint8_t>	m_Copy;		/* Heap copy (not mapped) */
+	};
+
+	using RomHandle = std::shared_ptr<const RomImage>;
+
+	/// <summary>Content addressed store of ROM images.</summary>
+	/// <remarks>
+	/// Images are identified by a hash of their content: loading a ROM that is already in the cache,
+	/// from any file or buffer, hands out the existing image. The cache does not own the images, an
+	/// image is released when the last handle to it is dropped. Use Shared() for one cache for all
+	/// devices of the process, all methods are thread-safe.
+	/// Example:
+	///   auto Rom = TC::RomCache::Shared().Map(L"yrw801.rom");
+	///   RomSet.Attach(*Device, 0, Rom);
+	/// </remarks>
+	class RomCache
+	{
+	public:
+		RomCache() = default;
+
+		RomCache(const RomCache&) = delete;
+		RomCache& operator=(const RomCache&) = delete;
+
+		/// <summary>The cache shared by the whole process.</summary>
+		static RomCache& Shared()
+		{
+			static RomCache s_Cache;
+
+			return s_Cache;
+		}
+
+		/// <summary>Map a ROM file, or read it if it can not be mapped.</summary>
+		/// <returns>The image, nullptr if the file can not be read or is empty.</returns>
+		RomHandle Map(const std::filesystem::path& FileName)
+		{
+			std::error_code Error;
+
+			/* A file that did not change is not hashed again */
+			auto Key = std::filesystem::absolute(FileName, Error).native();
+			auto Time = std::filesystem::last_write_time(FileName, Error);
+			auto FileSize = std::filesystem::file_size(FileName, Error);
+
+			if (Error) return nullptr;
+
+			{
+				std::lock_guard<std::mutex> Lock(m_Mutex);
+
+				auto Entry = m_Files.find(Key);
+
+				if ((Entry != m_Files.end()) && (Entry->second.Time == Time) && (Entry->second.Size == FileSize))
+				{
+					if (auto Image = Entry->second.Image.lock()) return Image;
+				}
+			}
+
+			std::shared_ptr<RomImage> Image(new RomImage());
+
+			Image->Map(FileName);
+
+			if (!Image->IsMapped() && !Read(FileName, *Image)) return nullptr;
+
+			Image->m_Hash = RomImage::Hash(Image->m_Data, Image->m_Size);
+
+			std::lock_guard<std::mutex> Lock(m_Mutex);
+
+			RomHandle Shared = Store(std::move(Image));
+
+			m_Files[Key] = { Shared, Time, FileSize };
+
+			return Shared;
+		}
+
+		/// <summary>Add a ROM image from a host buffer (eg. a decompressed ROM set).</summary>
+		/// <returns>The cached image, a copy of the buffer is only made if the content is new.</returns>
+		RomHandle Insert(const uint8_t* Data, size_t Size)
+		{
+			if ((Data == nullptr) || (Size == 0)) return nullptr;
+
+			uint64_t Hash = RomImage::Hash(Data, Size);
+
+			{
+				std::lock_guard<std::mutex> Lock(m_Mutex);
+
+				if (auto Image = Find(Hash, Data, Size)) return Image;
+			}
+
+			std::shared_ptr<RomImage> Image(new RomImage());
+
+			Image->m_Copy.assign(Data, Data + Size);
+			Image->m_Data = Image->m_Copy.data();
+			Image->m_Size = Size;
+			Image->m_Hash = Hash;
+
+			std::lock_guard<std::mutex> Lock(m_Mutex);
+
+			return Store(std::move(Image));
+		}
+
+		/// <summary>Number of images in use.</summary>
+		size_t GetCount()
+		{
+			std::lock_guard<std::mutex> Lock(m_Mutex);
+
+			Prune();
+
+			return m_Images.size();
+		}
+
+		/// <summary>Heap memory held by the images in use in bytes (mapped images are not included).</summary>
+		size_t GetResidentSize()
+		{
+			std::lock_guard<std::mutex> Lock(m_Mutex);
+
+			size_t Size = 0;
+
+			for (auto& Entry : m_Images)
+			{
+				if (auto Image = Entry.second.lock()) Size += Image->m_Copy.capacity();
+			}
+
+			return Size;
+		}
+
+	private:
+		struct file_t
+		{
+			std::weak_ptr<const RomImage>		Image;
+			std::filesystem::file_time_type		Time;
+			uintmax_t							Size;
+		};
+
+		static bool Read(const std::filesystem::path& FileName, RomImage& Image)
+		{
+			std::ifstream File(FileName, std::ios::binary | std::ios::ate);
+
+			if (!File.is_open()) return false;
+
+			std::streamoff Size = File.tellg();
+			if (Size <= 0) return false;
+
+			Image.m_Copy.resize((size_t)Size);
+
+			File.seekg(0);
+			if (!File.read(reinterpret_cast<char*>(Image.m_Copy.data()), Size)) return false;
+
+			Image.m_Data = Image.m_Copy.data();
+			Image.m_Size = Image.m_Copy.size();
+
+			return true;
+		}
+
+		/* Look up an image in use with the same content (lock held) */
+		RomHandle Find(uint64_t Hash, const uint8_t* Data, size_t Size)
+		{
+			auto Range = m_Images.equal_range(Hash);
+
+			for (auto Entry = Range.first; Entry != Range.second; ++Entry)
+			{
+				auto Image = Entry->second.lock();
+
+				/* Equal hashes of different content are kept apart */
+				if ((Image != nullptr) && (Image->m_Size == Size) && !memcmp(Image->m_Data, Data, Size)) return Image;
+			}
+
+			return nullptr;
+		}
+
+		/* Add a new image, or drop it for the one in use with the same content (lock held) */
+		RomHandle Store(std::shared_ptr<RomImage> Image)
+		{
+			if (auto Existing = Find(Image->m_Hash, Image->m_Data, Image->m_Size)) return Existing;
+
+			Prune();
+
+			m_Images.emplace(Image->m_Hash, Image);
+
+			return Image;
+		}
+
+		/* Forget released images (lock held) */
+		void Prune()
+		{
+			std::erase_if(m_Images, [](auto& Entry) { return Entry.second.expired(); });
+			std::erase_if(m_Files, [](auto& Entry) { return Entry.second.Image.expired(); });
+		}
+
+		std::mutex																m_Mutex;
+		std::unordered_multimap<uint64_t, std::weak_ptr<const RomImage>>		m_Images;	/* Content hash -> image */
+		std::unordered_map<std::filesystem::path::string_type, file_t>			m_Files;	/* Mapped file -> image */
+	};
+
+	/// <summary>The ROM images used by the memories of one or more devices.</summary>
+	/// <remarks>
+	/// Devices read an attached image directly (see IMemoryAccess::AttachMemory), the set keeps the
+	/// images alive for them. It has to outlive the devices, or their memories have to be re-attached
+	/// or power-on reset before the set is destroyed. This includes devices kept by a DevicePool.
+	/// </remarks>
+	class RomSet
+	{
+	public:
+		/// <summary>Attach an image to a device memory, a device that can not read host memory gets a copy.</summary>
+		/// <returns>True if the image was attached, false if it was copied (or the image is nullptr).</returns>
+		bool Attach(IMemoryAccess& Device, uint32_t MemoryID, RomHandle Image)
+		{
+			if (Image == nullptr) return false;
+
+			uint8_t* Data = const_cast<uint8_t*>(Image->Data());
+			size_t Size = Image->Size();
+
+			bool Attached = Device.AttachMemory(MemoryID, Data, Size);
+
+			if (!Attached)
+			{
+				/* Data beyond the address space is ignored, as it is for an attached image */
+				size_t MemorySize = Device.GetMemorySize(MemoryID);
+				if (MemorySize != 0) Size = std::min(Size, MemorySize);
+
+				Device.CopyToMemory(MemoryID, 0, Data, Size);
+			}
+
+			/* One image per device memory */
+			for (auto& Entry : m_Entries)
+			{
+				if ((Entry.Device == &Device) && (Entry.MemoryID == MemoryID))
+				{
+					Entry.Image = std::move(Image);
+					return Attached;
+				}
+			}
+
+			m_Entries.push_back({ &Device, MemoryID, std::move(Image) });
+
+			return Attached;
+		}
+
+		/// <summary>Tag of the images in the set, for DevicePool::Acquire (0 = empty set).</summary>
+		uint64_t GetTag() const
+		{
+			if (m_Entries.empty()) return 0;
+
+			StateHash Hash;
+
+			for (auto& Entry : m_Entries)
+			{
+				Hash.Add(Entry.MemoryID);
+				Hash.Add(Entry.Image->GetHash());
+			}
+
+			return (Hash.Get() != 0) ? Hash.Get() : 1;
+		}
+
+		/// <summary>Release all images, the devices using them have to be power-on reset first.</summary>
+		void Clear()
+		{
+			m_Entries.clear();
+		}
+
+	private:
+		struct entry_t
+		{
+			IMemoryAccess*	Device;
+			uint32_t		MemoryID;
+			RomHandle		Image;
+		};
+
+		std::vector<entry_t>	m_Entries;
+	};
+}
+
+#endif // !_TRITON_CORE_ROM_CACHE_H_
\ No newline at end of file
@@ -0,0 +1,360 @@
+/*
+ _____    _ _            ___
+|_   _| _(_) |_ ___ _ _ / __|___ _ _ ___
+  | || '_| |  _/ _ \ ' \ (__/ _ \ '_/ -_)
+  |_||_| |_|\__\___/_||_\___\___/_| \___|
+
+Copyright  2024, Michel Gerritse
+All rights reserved.
+
+This source code is available under the BSD-3-Clause license.
+See LICENSE.txt in the root directory of this source tree.
+
+*/
+#ifndef _TRITON_CORE_SCHEDULER_H_
+#define _TRITON_CORE_SCHEDULER_H_
+
+#include <algorithm>
+#include <functional>
+#include <queue>
+#include <vector>
+
+#include "../Interfaces/ISoundDevice.h"
+
+/// <summary>TritonCore API version 1</summary>
+namespace TritonCore_v1
+{
+	/// <summary>Event driven scheduler for boards with CPU cores and sound devices.</summary>
+	/// <remarks>
+	/// All participants share one time base, the ticks of the master clock. The CPU cores run in
+	/// time slices, a slice ends at the next device event (see ISoundDevice::GetCyclesToNextEvent),
+	/// at the end of Run or after the quantum, whichever comes first. Pending events are kept in a
+	/// heap ordered by their timestamp.
+	/// Sound devices are only updated as far as necessary: register writes are queued with their
+	/// timestamp and applied at the end of the slice, updating the device up to every write. A device
+	/// without writes or events is only updated at the end of Run. Interrupts raised by a device
+	/// (see ISoundDevice::SetIrqCallback) are reported at the start of the CPU slice they belong to.
+	/// The clock speeds of the participants are taken when they are added.
+	/// A scheduler is not thread-safe, it is owned by the thread that runs the board.
+	/// </remarks>
+	class Scheduler
+	{
+	public:
+		/// <summary>Run a CPU core for a budget of clock cycles.</summary>
+		/// <remarks>Cores that overrun the budget carry the overrun themselves (eg. H8_520::Execute).</remarks>
+		using ExecuteCallback = std::function<void(uint32_t Cycles)>;
+
+		/// <param name="MasterClock">Time base in ticks per second (eg. the fastest clock of the board).</param>
+		Scheduler(uint32_t MasterClock) :
+			m_MasterClock(std::max(MasterClock, 1u)),
+			m_Quantum(std::max(MasterClock / 1000, 1u)),
+			m_Now(0),
+			m_SliceEnd(0)
+		{
+		}
+
+		Scheduler(const Scheduler&) = delete;
+		Scheduler& operator=(const Scheduler&) = delete;
+
+		/// <summary>Add a sound device, its audio output is rendered to OutBuffer (see ISoundDevice::Update).</summary>
+		/// <returns>Device number used by the other methods.</returns>
+		uint32_t AddDevice(ISoundDevice* Device, std::vector<IAudioBuffer*>& OutBuffer)
+		{
+			device_t Entry = {};
+
+			Entry.Device = Device;
+			Entry.OutBuffer = &OutBuffer;
+			Entry.Clock = std::max(Device->GetClockSpeed(), 1u);
+			Entry.Time = m_Now;
+			Entry.EventTime = UINT64_MAX;
+
+			/* Longest span that stays within one 32-bit Update call */
+			Entry.MaxTicks = std::clamp<uint64_t>(((uint64_t)UINT32_MAX * m_MasterClock) / Entry.Clock, 1, 1ull << 31);
+
+			m_Devices.push_back(Entry);
+
+			Predict((uint32_t)m_Devices.size() - 1);
+
+			return (uint32_t)m_Devices.size() - 1;
+		}
+
+		/// <summary>Add a CPU core running at ClockSpeed.</summary>
+		/// <returns>CPU number used by the other methods.</returns>
+		uint32_t AddCpu(uint32_t ClockSpeed, ExecuteCallback Execute)
+		{
+			m_Cpus.push_back({ std::move(Execute), std::max(ClockSpeed, 1u), 0 });
+
+			return (uint32_t)m_Cpus.size() - 1;
+		}
+
+		/// <summary>Longest CPU slice in master clock ticks (default 1 ms, 0 = slices only end at events).</summary>
+		/// <remarks>
+		/// Bounds the timing error of the CPU cores against each other, and the delay of an event
+		/// created by a write within a slice (eg. starting a timer), queued writes are applied at
+		/// the end of the slice.
+		/// </remarks>
+		void SetQuantum(uint32_t Ticks)
+		{
+			m_Quantum = Ticks;
+		}
+
+		/// <summary>Start of the running CPU slice, or the end of the last Run outside a slice.</summary>
+		uint64_t GetTime() const
+		{
+			return m_Now;
+		}
+
+		/// <summary>Timestamp of a CPU cycle within the running slice, for cores that know
+		/// how far into their budget they are.</summary>
+		uint64_t GetCpuTime(uint32_t Cpu, uint32_t Cycles) const
+		{
+			return std::min(m_Now + ((uint64_t)Cycles * m_MasterClock) / m_Cpus[Cpu].Clock, m_SliceEnd);
+		}
+
+		/// <summary>Queue ISoundDevice::Write, timestamped at the start of the running slice.</summary>
+		void Write(uint32_t Device, uint32_t Address, uint32_t Data)
+		{
+			WriteAt(Device, m_Now, Address, Data);
+		}
+
+		/// <summary>Queue ISoundDevice::Write with an explicit timestamp within the running slice (see GetCpuTime).</summary>
+		void WriteAt(uint32_t Device, uint64_t Time, uint32_t Address, uint32_t Data)
+		{
+			Queue(Device, { Time, Address, Data, false });
+		}
+
+		/// <summary>Queue IDevice::SendExclusiveCommand, timestamped at the start of the running slice.</summary>
+		void SendExclusiveCommand(uint32_t Device, uint32_t Command, uint32_t Value)
+		{
+			Queue(Device, { m_Now, Command, Value, true });
+		}
+
+		/// <summary>Bring a device up to date (eg. before reading its status register or memory).</summary>
+		/// <remarks>The queued writes up to Time are applied, the device is updated up to Time.</remarks>
+		void Sync(uint32_t Device, uint64_t Time)
+		{
+			auto& Entry = m_Devices[Device];
+
+			Apply(Entry, Time);
+			Advance(Entry, Time);
+			Predict(Device);
+		}
+
+		void Sync(uint32_t Device)
+		{
+			Sync(Device, m_Now);
+		}
+
+		/// <summary>Run the board for Ticks master clock ticks.</summary>
+		/// <remarks>At the end all devices are updated up to the new time, so their audio output covers the whole span.</remarks>
+		void Run(uint64_t Ticks)
+		{
+			uint64_t Target = m_Now + Ticks;
+
+			/* Writes made outside Run */
+			Flush();
+
+			while (true)
+			{
+				/* Devices with a due event, their interrupts are seen by the next slice */
+				ProcessEvents();
+
+				if (m_Now >= Target) break;
+
+				/* The slice ends at the next event (always in the future after ProcessEvents) */
+				m_SliceEnd = Target;
+
+				if (m_Quantum != 0) m_SliceEnd = std::min(m_SliceEnd, m_Now + m_Quantum);
+				if (!m_Events.empty()) m_SliceEnd = std::min(m_SliceEnd, m_Events.top().Time);
+
+				for (auto& Cpu : m_Cpus)
+				{
+					uint64_t Total = (m_SliceEnd - m_Now) * Cpu.Clock + Cpu.Remainder;
+
+					Cpu.Remainder = Total % m_MasterClock;
+
+					if ((Total / m_MasterClock) != 0) Cpu.Execute((uint32_t)std::min<uint64_t>(Total / m_MasterClock, UINT32_MAX));
+				}
+
+				m_Now = m_SliceEnd;
+
+				/* Writes made during the slice */
+				Flush();
+			}
+
+			m_SliceEnd = m_Now;
+
+			for (uint32_t i = 0; i < (uint32_t)m_Devices.size(); i++) Sync(i, m_Now);
+		}
+
+	private:
+		struct write_t
+		{
+			uint64_t	Time;
+			uint32_t	Address;
+			uint32_t	Data;
+			bool		Exclusive;	/* SendExclusiveCommand instead of Write */
+		};
+
+		struct device_t
+		{
+			ISoundDevice*				Device;
+			std::vector<IAudioBuffer*>*	OutBuffer;
+			uint32_t					Clock;
+			uint64_t					MaxTicks;	/* Longest span per Update call */
+			uint64_t					Time;		/* Master clock ticks the device is updated for */
+			uint64_t					Remainder;	/* Fraction of a device clock cycle (in master clock cycles) */
+			uint64_t					EventTime;	/* Scheduled event (UINT64_MAX = none) */
+			uint32_t					Sequence;	/* Invalidates superseded events */
+			std::vector<write_t>		Writes;		/* Queued register writes */
+		};
+
+		struct cpu_t
+		{
+			ExecuteCallback	Execute;
+			uint32_t		Clock;
+			uint64_t		Remainder;
+		};
+
+		struct event_t
+		{
+			uint64_t	Time;
+			uint32_t	Device;
+			uint32_t	Sequence;
+
+			bool operator>(const event_t& Other) const { return Time > Other.Time; }
+		};
+
+		void Queue(uint32_t Device, const write_t& Write)
+		{
+			auto& Entry = m_Devices[Device];
+
+			Entry.Writes.push_back(Write);
+
+			/* Writes are applied in time order, writes from several CPU cores can arrive out of order */
+			if ((Entry.Writes.size() > 1) && (Write.Time < Entry.Writes[Entry.Writes.size() - 2].Time))
+			{
+				std::stable_sort(Entry.Writes.begin(), Entry.Writes.end(), [](auto& A, auto& B) { return A.Time < B.Time; });
+			}
+		}
+
+		/* Update the devices with an event up to now, superseded events are dropped */
+		void ProcessEvents()
+		{
+			while (!m_Events.empty())
+			{
+				event_t Event = m_Events.top();
+
+				if (Event.Sequence == m_Devices[Event.Device].Sequence)
+				{
+					if (Event.Time > m_Now) break;
+
+					m_Devices[Event.Device].EventTime = UINT64_MAX;
+				}
+
+				m_Events.pop();
+
+				if (Event.Sequence == m_Devices[Event.Device].Sequence) Sync(Event.Device, m_Now);
+			}
+		}
+
+		/* Apply the queued writes of every device */
+		void Flush()
+		{
+			for (uint32_t i = 0; i < (uint32_t)m_Devices.size(); i++)
+			{
+				if (m_Devices[i].Writes.empty()) continue;
+
+				Apply(m_Devices[i], UINT64_MAX);
+				Predict(i);
+			}
+		}
+
+		/* Apply the queued writes up to Time, the device is updated up to every write */
+		void Apply(device_t& Entry, uint64_t Time)
+		{
+			size_t Count = 0;
+
+			for (; (Count < Entry.Writes.size()) && (Entry.Writes[Count].Time <= Time); Count++)
+			{
+				auto& Write = Entry.Writes[Count];
+
+				Advance(Entry, Write.Time);
+
+				if (Write.Exclusive)
+					Entry.Device->SendExclusiveCommand(Write.Address, Write.Data);
+				else
+					Entry.Device->Write(Write.Address, Write.Data);
+			}
+
+			Entry.Writes.erase(Entry.Writes.begin(), Entry.Writes.begin() + Count);
+		}
+
+		/* Update a device up to Time, a device that is ahead already stays where it is */
+		void Advance(device_t& Entry, uint64_t Time)
+		{
+			while (Entry.Time < Time)
+			{
+				uint64_t Ticks = std::min(Time - Entry.Time, Entry.MaxTicks);
+				uint64_t Total = Ticks * Entry.Clock + Entry.Remainder;
+
+				Entry.Time += Ticks;
+				Entry.Remainder = Total % m_MasterClock;
+
+				if ((Total / m_MasterClock) != 0) Entry.Device->Update((uint32_t)(Total / m_MasterClock), *Entry.OutBuffer);
+			}
+		}
+
+		/* Schedule the next event of a device, replaces the previous one */
+		void Predict(uint32_t Device)
+		{
+			auto& Entry = m_Devices[Device];
+
+			uint64_t Cycles = Entry.Device->GetCyclesToNextEvent();
+			uint64_t Time = UINT64_MAX;
+
+			/* No event, or too far away to be represented */
+			if ((Cycles != 0) && (Cycles <= ((UINT64_MAX >> 1) / m_MasterClock)))
+			{
+				/* First tick at which the device has run the predicted number of clock cycles */
+				Time = Entry.Time + ((Cycles * m_MasterClock) - Entry.Remainder + Entry.Clock - 1) / Entry.Clock;
+			}
+
+			/* Most writes don't move the event */
+			if (Time == Entry.EventTime) return;
+
+			Entry.Sequence++;
+			Entry.EventTime = Time;
+
+			if (Time == UINT64_MAX) return;
+
+			/* Drop the superseded events once they dominate the heap */
+			if (m_Events.size() >= (4 * m_Devices.size() + 64)) Compact();
+
+			m_Events.push({ Time, Device, Entry.Sequence });
+		}
+
+		void Compact()
+		{
+			std::vector<event_t> Events;
+
+			for (; !m_Events.empty(); m_Events.pop())
+			{
+				if (m_Events.top().Sequence == m_Devices[m_Events.top().Device].Sequence) Events.push_back(m_Events.top());
+			}
+
+			for (auto& Event : Events) m_Events.push(Event);
+		}
+
+		uint32_t	m_MasterClock;
+		uint32_t	m_Quantum;
+		uint64_t	m_Now;			/* Start of the running slice */
+		uint64_t	m_SliceEnd;		/* End of the running slice */
+
+		std::vector<device_t>	m_Devices;
+		std::vector<cpu_t>		m_Cpus;
+		std::priority_queue<event_t, std::vector<event_t>, std::greater<event_t>>	m_Events;
+	};
+}
+
+#endif // !_TRITON_CORE_SCHEDULER_H_
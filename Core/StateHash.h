@@ -0,0 +1,157 @@
+/*
+ _____    _ _            ___
+|_   _| _(_) |_ ___ _ _ / __|___ _ _ ___
+  | || '_| |  _/ _ \ ' \ (__/ _ \ '_/ -_)
+  |_||_| |_|\__\___/_||_\___\___/_| \___|
+
+Copyright  2024, Michel Gerritse
+All rights reserved.
+
+This source code is available under the BSD-3-Clause license.
+See LICENSE.txt in the root directory of this source tree.
+
+*/
+#ifndef _TRITON_CORE_STATE_HASH_H_
+#define _TRITON_CORE_STATE_HASH_H_
+
+#include <bit>
+#include <cstring>
+#include <unordered_map>
+#include <vector>
+
+#include "../Interfaces/IStateAccess.h"
+
+/// <summary>TritonCore API version 1</summary>
+namespace TritonCore_v1
+{
+	/// <summary>64-bit hash of the synthesis state of one or more devices.</summary>
+	/// <remarks>
+	/// The state is the one saved by IStateAccess::SaveState: registers, voice state and the memory
+	/// pages written by the device itself. Uploaded or attached memory (eg. a sample ROM) is not part
+	/// of a saved state, so it is not hashed either. The hash is built incrementally, device by device,
+	/// the work buffer is kept so hashing does not allocate once it has grown to the largest state.
+	/// Free running counters (eg. the envelope generator counter, the LFO or the cycles left over from
+	/// the last Update call) are part of the state: a repeat is only found when they repeat as well.
+	/// </remarks>
+	class StateHash
+	{
+	public:
+		StateHash() :
+			m_Hash(Seed)
+		{
+		}
+
+		/// <summary>Start a new hash.</summary>
+		void Clear()
+		{
+			m_Hash = Seed;
+		}
+
+		/// <summary>Add the saved state of a device.</summary>
+		void Add(IStateAccess& Device)
+		{
+			m_State.clear();
+
+			StateWriter Writer(m_State);
+			Device.SaveState(Writer);
+
+			/* The size separates the states of consecutive devices */
+			Add(m_State.size());
+			Add(m_State.data(), m_State.size());
+		}
+
+		/// <summary>Add host state (eg. a stream position or the RAM of a sound driver).</summary>
+		void Add(const void* Data, size_t Size)
+		{
+			const uint8_t* p = static_cast<const uint8_t*>(Data);
+			uint64_t Hash = m_Hash;
+
+			for (; Size >= 8; Size -= 8, p += 8)
+			{
+				uint64_t Word;
+				memcpy(&Word, p, 8);
+
+				Hash = Mix(Hash, Word);
+			}
+
+			if (Size != 0)
+			{
+				uint64_t Word = 0;
+				memcpy(&Word, p, Size);
+
+				Hash = Mix(Hash, Word ^ ((uint64_t)Size << 56));
+			}
+
+			m_Hash = Hash;
+		}
+
+		void Add(uint64_t Value)
+		{
+			m_Hash = Mix(m_Hash, Value);
+		}
+
+		uint64_t Get() const
+		{
+			return m_Hash;
+		}
+
+	private:
+		static constexpr uint64_t Seed = 0x9E3779B97F4A7C15ull;
+
+		static inline uint64_t Mix(uint64_t Hash, uint64_t Word)
+		{
+			return std::rotl((Hash ^ Word) * 0xBF58476D1CE4E5B9ull, 31) * 0x94D049BB133111EBull;
+		}
+
+		uint64_t				m_Hash;
+		std::vector<uint8_t>	m_State;	/* Work buffer */
+	};
+
+	/// <summary>Finds the first repeat of a state, checked at points in time chosen by the host.</summary>
+	/// <remarks>
+	/// A repeated device state only marks a loop if the input that follows repeats too, eg. when the
+	/// host adds its own state (a sound driver, a stream position) to the hash. Hosts that check at
+	/// every frame boundary of the same rate find loops that are exact to that frame.
+	/// </remarks>
+	class LoopDetector
+	{
+	public:
+		/// <param name="MaxEntries">Number of states remembered, later states are only compared.</param>
+		LoopDetector(size_t MaxEntries = 1 << 20) :
+			m_MaxEntries(MaxEntries)
+		{
+		}
+
+		/// <summary>Compare a state with the earlier ones and remember it.</summary>
+		/// <param name="Hash">State hash (see StateHash).</param>
+		/// <param name="Time">Host defined position of the state (eg. samples played).</param>
+		/// <param name="Start">Set to the position the state was first seen at (the loop start).</param>
+		/// <returns>True if the state was seen before.</returns>
+		bool Check(uint64_t Hash, uint64_t Time, uint64_t& Start)
+		{
+			auto Entry = m_Seen.find(Hash);
+
+			if (Entry != m_Seen.end())
+			{
+				Start = Entry->second;
+				return true;
+			}
+
+			if (m_Seen.size() < m_MaxEntries) m_Seen.emplace(Hash, Time);
+
+			return false;
+		}
+
+		/// <summary>Forget all states.</summary>
+		void Clear()
+		{
+			m_Seen.clear();
+		}
+
+	private:
+		size_t									m_MaxEntries;
+		std::unordered_map<uint64_t, uint64_t>	m_Seen;		/* Hash -> first position */
+	};
+}
+
+#endif // !_TRITON_CORE_STATE_HASH_H_
\ No newline at end of file
@@ -0,0 +1,182 @@
+/*
+ _____    _ _            ___
+|_   _| _(_) |_ ___ _ _ / __|___ _ _ ___
+  | || '_| |  _/ _ \ ' \ (__/ _ \ '_/ -_)
+  |_||_| |_|\__\___/_||_\___\___/_| \___|
+
+Copyright  2024, Michel Gerritse
+All rights reserved.
+
+This source code is available under the BSD-3-Clause license.
+See LICENSE.txt in the root directory of this source tree.
+
+*/
+#ifndef _TRITON_CORE_STATS_H_
+#define _TRITON_CORE_STATS_H_
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+
+/* Device instrumentation is compiled out unless TC_DEVICE_STATS is set to 1 */
+#ifndef TC_DEVICE_STATS
+#define TC_DEVICE_STATS 0
+#endif
+
+/// <summary>TritonCore API version 1</summary>
+namespace TritonCore_v1
+{
+	/// <summary>Snapshot of the instrumentation counters of a device.</summary>
+	struct StatsSnapshot
+	{
+		static constexpr uint32_t RangeShift = 4;	/* 16 registers per range */
+		static constexpr uint32_t Ranges = 48;		/* Register 0x000 - 0x2FF (higher registers are added to the last range) */
+
+		uint64_t	UpdateCalls;			/* Number of Update calls */
+		uint64_t	UpdateTime;				/* Wall time spent in Update (ns) */
+		uint64_t	Frames;					/* Output frames rendered (or skipped by fast-forward) */
+		uint64_t	Writes;					/* Register writes */
+		uint64_t	WritesPerRange[Ranges];	/* Register writes per register range */
+		uint64_t	KeyOns;					/* Key on events (voices, FM operators count individually) */
+		uint32_t	ActiveVoices;			/* Voices (or FM operators) keyed on at the end of the last Update call */
+	};
+
+	/// <summary>Device instrumentation counters.</summary>
+	/// <remarks>
+	/// Counters are only ever written by the thread that owns the device (the thread calling
+	/// Write and Update), any other thread can read them at any time without locking.
+	/// All methods compile to nothing when TC_DEVICE_STATS is 0.
+	/// </remarks>
+	class DeviceStats
+	{
+	public:
+		static constexpr bool Enabled = (TC_DEVICE_STATS != 0);
+
+		/// <summary>Times an Update call, construct at the start of Update.</summary>
+		class UpdateScope
+		{
+		public:
+			UpdateScope(DeviceStats& Stats, uint64_t Frames = 0)
+#if TC_DEVICE_STATS
+				: m_Stats(Stats), m_Start(std::chrono::steady_clock::now())
+			{
+				m_Stats.m_Frames.Add(Frames);
+			}
+#else
+			{
+			}
+#endif
+
+			~UpdateScope()
+			{
+#if TC_DEVICE_STATS
+				auto Elapsed = std::chrono::steady_clock::now() - m_Start;
+
+				m_Stats.m_UpdateCalls.Add(1);
+				m_Stats.m_UpdateTime.Add(std::chrono::duration_cast<std::chrono::nanoseconds>(Elapsed).count());
+#endif
+			}
+
+			UpdateScope(const UpdateScope&) = delete;
+			UpdateScope& operator=(const UpdateScope&) = delete;
+
+			/// <summary>Store the active voice count, Count is only invoked when instrumentation is enabled.</summary>
+			template<typename F>
+			inline void ActiveVoices(F&& Count)
+			{
+#if TC_DEVICE_STATS
+				m_Stats.m_ActiveVoices.store((uint32_t)Count(), std::memory_order_relaxed);
+#endif
+			}
+
+		private:
+#if TC_DEVICE_STATS
+			DeviceStats&							m_Stats;
+			std::chrono::steady_clock::time_point	m_Start;
+#endif
+		};
+
+		DeviceStats() = default;
+
+		DeviceStats(const DeviceStats&) = delete;
+		DeviceStats& operator=(const DeviceStats&) = delete;
+
+		/// <summary>Count a register write.</summary>
+		/// <param name="Register">Device register number.</param>
+		inline void RegisterWrite(uint32_t Register)
+		{
+#if TC_DEVICE_STATS
+			uint32_t Range = Register >> StatsSnapshot::RangeShift;
+
+			m_Writes.Add(1);
+			m_WritesPerRange[(Range < StatsSnapshot::Ranges) ? Range : (StatsSnapshot::Ranges - 1)].Add(1);
+#endif
+		}
+
+		/// <summary>Count output frames (for devices that render their outputs in separate stages).</summary>
+		inline void AddFrames(uint64_t Frames)
+		{
+#if TC_DEVICE_STATS
+			m_Frames.Add(Frames);
+#endif
+		}
+
+		/// <summary>Count a key on event.</summary>
+		inline void KeyOn()
+		{
+#if TC_DEVICE_STATS
+			m_KeyOns.Add(1);
+#endif
+		}
+
+		/// <summary>Read the counters (any thread).</summary>
+		/// <returns>False if instrumentation is compiled out.</returns>
+		bool Get(StatsSnapshot& Stats) const
+		{
+#if TC_DEVICE_STATS
+			Stats.UpdateCalls = m_UpdateCalls.Get();
+			Stats.UpdateTime = m_UpdateTime.Get();
+			Stats.Frames = m_Frames.Get();
+			Stats.Writes = m_Writes.Get();
+			Stats.KeyOns = m_KeyOns.Get();
+			Stats.ActiveVoices = m_ActiveVoices.load(std::memory_order_relaxed);
+
+			for (uint32_t i = 0; i < StatsSnapshot::Ranges; i++) Stats.WritesPerRange[i] = m_WritesPerRange[i].Get();
+
+			return true;
+#else
+			Stats = {};
+			return false;
+#endif
+		}
+
+	private:
+#if TC_DEVICE_STATS
+		/* Single writer counter, a plain load + store avoids a locked read-modify-write */
+		struct counter_t
+		{
+			std::atomic<uint64_t> Value = 0;
+
+			inline void Add(uint64_t Count)
+			{
+				Value.store(Value.load(std::memory_order_relaxed) + Count, std::memory_order_relaxed);
+			}
+
+			inline uint64_t Get() const
+			{
+				return Value.load(std::memory_order_relaxed);
+			}
+		};
+
+		counter_t				m_UpdateCalls;
+		counter_t				m_UpdateTime;
+		counter_t				m_Frames;
+		counter_t				m_Writes;
+		counter_t				m_WritesPerRange[StatsSnapshot::Ranges];
+		counter_t				m_KeyOns;
+		std::atomic<uint32_t>	m_ActiveVoices = 0;
+#endif
+	};
+}
+
+#endif // !_TRITON_CORE_STATS_H_
\ No newline at end of file
@@ -0,0 +1,450 @@
+/*
+ _____    _ _            ___
+|_   _| _(_) |_ ___ _ _ / __|___ _ _ ___
+  | || '_| |  _/ _ \ ' \ (__/ _ \ '_/ -_)
+  |_||_| |_|\__\___/_||_\___\___/_| \___|
+
+Copyright  2024, Michel Gerritse
+All rights reserved.
+
+This source code is available under the BSD-3-Clause license.
+See LICENSE.txt in the root directory of this source tree.
+
+*/
+#ifndef _TRITON_CORE_TRACE_H_
+#define _TRITON_CORE_TRACE_H_
+
+#include <atomic>
+#include <bit>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include "../Interfaces/ISoundDevice.h"
+
+/// <summary>TritonCore API version 1</summary>
+namespace TritonCore_v1
+{
+	/// <summary>Register write recorded by a trace.</summary>
+	struct TraceEntry
+	{
+		enum : uint8_t
+		{
+			Write = 0,	/* ISoundDevice::Write(Address, Data) */
+			Register,	/* ISoundDevice::WriteBatch (one entry per register) */
+			Exclusive	/* IDevice::SendExclusiveCommand(Address, Data) */
+		};
+
+		uint64_t	Cycle;		/* Device clock cycles since the start of the trace */
+		uint32_t	Address;	/* Address latch, register number or command */
+		uint32_t	Data;
+		uint8_t		Type;
+		uint8_t		Port;		/* WriteBatch port */
+	};
+
+	/// <summary>Lock-free register write trace.</summary>
+	/// <remarks>
+	/// Single producer (the thread that owns the device), single consumer (any other thread
+	/// draining the trace). The entries are preallocated, recording never allocates, blocks or
+	/// takes a lock. A full ring drops new entries, the dropped entries are counted.
+	/// </remarks>
+	class TraceRing
+	{
+	public:
+		/// <param name="Capacity">Number of entries, rounded up to a power of 2.</param>
+		TraceRing(size_t Capacity) :
+			m_Capacity(std::bit_ceil(std::max<size_t>(Capacity, 1))),
+			m_Mask(m_Capacity - 1),
+			m_Entries(m_Capacity),
+			m_ReadPos(0),
+			m_WritePos(0),
+			m_Drops(0)
+		{
+		}
+
+		TraceRing(const TraceRing&) = delete;
+		TraceRing& operator=(const TraceRing&) = delete;
+
+		/// <summary>Record an entry (producer).</summary>
+		inline void Push(const TraceEntry& Entry)
+		{
+			size_t WritePos = m_WritePos.load(std::memory_order_relaxed);
+
+			if ((WritePos - m_ReadPos.load(std::memory_order_acquire)) == m_Capacity)
+			{
+				m_Drops.fetch_add(1, std::memory_order_relaxed);
+				return;
+			}
+
+			m_Entries[WritePos & m_Mask] = Entry;
+			m_WritePos.store(WritePos + 1, std::memory_order_release);
+		}
+
+		/// <summary>Take up to Count entries from the ring (consumer).</summary>
+		/// <returns>Number of entries read.</returns>
+		size_t Read(TraceEntry* Out, size_t Count)
+		{
+			size_t ReadPos = m_ReadPos.load(std::memory_order_relaxed);
+			size_t WritePos = m_WritePos.load(std::memory_order_acquire);
+
+			Count = std::min(Count, WritePos - ReadPos);
+
+			for (size_t i = 0; i < Count; i++) Out[i] = m_Entries[(ReadPos + i) & m_Mask];
+
+			m_ReadPos.store(ReadPos + Count, std::memory_order_release);
+
+			return Count;
+		}
+
+		/// <summary>Take all entries from the ring and append them to Out (consumer).</summary>
+		void Drain(std::vector<TraceEntry>& Out)
+		{
+			size_t Offset = Out.size();
+
+			Out.resize(Offset + GetCount());
+			Out.resize(Offset + Read(Out.data() + Offset, Out.size() - Offset));
+		}
+
+		size_t GetCount() const
+		{
+			return m_WritePos.load(std::memory_order_acquire) - m_ReadPos.load(std::memory_order_acquire);
+		}
+
+		size_t GetCapacity() const { return m_Capacity; }
+		uint64_t GetDropCount() const { return m_Drops.load(std::memory_order_relaxed); }
+
+	private:
+		const size_t			m_Capacity;
+		const size_t			m_Mask;
+		std::vector<TraceEntry>	m_Entries;
+
+		/* Consumer and producer positions live on separate cache lines */
+		alignas(64) std::atomic<size_t>		m_ReadPos;
+		alignas(64) std::atomic<size_t>		m_WritePos;
+		std::atomic<uint64_t>				m_Drops;
+	};
+
+	/// <summary>Sound device wrapper that records every register write in a trace ring.</summary>
+	/// <remarks>
+	/// All calls are forwarded to the wrapped device, the timestamps are the clock cycles passed
+	/// to Update and FastForward. Devices that are not wrapped have no tracing overhead at all, a
+	/// disabled wrapper costs one branch per write. Memory uploads (IMemoryAccess) are not traced,
+	/// they go to the device itself.
+	/// </remarks>
+	class TracedDevice : public ISoundDevice
+	{
+	public:
+		TracedDevice(ISoundDevice* Device, TraceRing* Ring) :
+			m_Device(Device),
+			m_Ring(Ring),
+			m_Enabled(true),
+			m_Cycle(0)
+		{
+		}
+
+		/// <summary>Start or pause recording (the timestamps keep running).</summary>
+		void SetEnabled(bool Enable) { m_Enabled = Enable; }
+
+		ISoundDevice* GetDevice() const { return m_Device; }
+		uint64_t GetCycle() const { return m_Cycle; }
+
+		/* IDevice methods */
+		const wchar_t* GetDeviceName() { return m_Device->GetDeviceName(); }
+		void Reset(ResetType Type) { m_Device->Reset(Type); }
+
+		void SendExclusiveCommand(uint32_t Command, uint32_t Value)
+		{
+			Record(TraceEntry::Exclusive, 0, Command, Value);
+			m_Device->SendExclusiveCommand(Command, Value);
+		}
+
+		/* ISoundDevice methods */
+		bool EnumAudioOutputs(uint32_t OutputNr, AUDIO_OUTPUT_DESC& Desc) { return m_Device->EnumAudioOutputs(OutputNr, Desc); }
+		void SetClockSpeed(uint32_t ClockSpeed) { m_Device->SetClockSpeed(ClockSpeed); }
+		uint32_t GetClockSpeed() { return m_Device->GetClockSpeed(); }
+
+		void Write(uint32_t Address, uint32_t Data)
+		{
+			Record(TraceEntry::Write, 0, Address, Data);
+			m_Device->Write(Address, Data);
+		}
+
+		void Update(uint32_t ClockCycles, std::vector<IAudioBuffer*>& OutBuffer)
+		{
+			m_Device->Update(ClockCycles, OutBuffer);
+			m_Cycle += ClockCycles;
+		}
+
+		void FastForward(uint32_t ClockCycles)
+		{
+			m_Device->FastForward(ClockCycles);
+			m_Cycle += ClockCycles;
+		}
+
+		uint32_t GetCyclesForFrames(uint32_t OutputNr, uint32_t Frames) { return m_Device->GetCyclesForFrames(OutputNr, Frames); }
+		uint32_t GetCyclesToNextEvent() { return m_Device->GetCyclesToNextEvent(); }
+		bool SetIrqCallback(TC::IrqCallback Callback) { return m_Device->SetIrqCallback(std::move(Callback)); }
+
+		bool SetOutputRate(uint32_t OutputNr, uint32_t SampleRate) { return m_Device->SetOutputRate(OutputNr, SampleRate); }
+		bool SetOutputFormat(uint32_t OutputNr, uint32_t SampleFormat) { return m_Device->SetOutputFormat(OutputNr, SampleFormat); }
+		bool SetChannelOutputs(bool Enable) { return m_Device->SetChannelOutputs(Enable); }
+		bool SetMixedOutput(bool Enable) { return m_Device->SetMixedOutput(Enable); }
+		bool SetChannelMask(uint64_t Enabled) { return m_Device->SetChannelMask(Enabled); }
+
+		bool WriteBatch(uint32_t Port, const REGISTER_WRITE* Writes, size_t Count)
+		{
+			if (!m_Device->WriteBatch(Port, Writes, Count)) return false;
+
+			/* Only batches the device accepted, the host falls back to (traced) Write calls otherwise */
+			for (size_t i = 0; m_Enabled && (i < Count); i++) Record(TraceEntry::Register, Port, Writes[i].Register, Writes[i].Data);
+
+			return true;
+		}
+
+		bool WriteRegisters(uint32_t Port, uint32_t Register, const uint8_t* Data, size_t Count)
+		{
+			if (!m_Device->WriteRegisters(Port, Register, Data, Count)) return false;
+
+			for (size_t i = 0; m_Enabled && (i < Count); i++) Record(TraceEntry::Register, Port, Register + (uint32_t)i, Data[i]);
+
+			return true;
+		}
+
+		bool GetStats(StatsSnapshot& Stats) { return m_Device->GetStats(Stats); }
+
+	private:
+		inline void Record(uint8_t Type, uint32_t Port, uint32_t Address, uint32_t Data)
+		{
+			if (!m_Enabled) return;
+
+			m_Ring->Push({ m_Cycle, Address, Data, Type, (uint8_t)Port });
+		}
+
+		ISoundDevice*	m_Device;
+		TraceRing*		m_Ring;
+		bool			m_Enabled;
+		uint64_t		m_Cycle;
+	};
+
+	/// <summary>Trace log file.</summary>
+	/// <remarks>
+	/// VGM like command stream in device clock cycles, all values little endian:
+	///
+	///   "TCTL", version (32-bit), clock speed (32-bit), device name length (32-bit), device name (UTF-16)
+	///   0x50 aaaaaaaa dddddddd     Write(Address, Data)
+	///   0x51 pp rrrr dddd          WriteBatch register (port, register, data)
+	///   0x52 cccccccc vvvvvvvv     SendExclusiveCommand(Command, Value)
+	///   0x61 nnnnnnnn              Wait n clock cycles
+	///   0x66                       End of log
+	/// </remarks>
+	class TraceLog
+	{
+	public:
+		static constexpr uint32_t Version = 1;
+
+		std::wstring			DeviceName;
+		uint32_t				ClockSpeed = 0;
+		std::vector<TraceEntry>	Entries;	/* In cycle order */
+
+		bool Save(const std::filesystem::path& FileName) const
+		{
+			std::ofstream File(FileName, std::ios::binary | std::ios::trunc);
+
+			if (!File.is_open()) return false;
+
+			File.write("TCTL", 4);
+			Write32(File, Version);
+			Write32(File, ClockSpeed);
+			Write32(File, (uint32_t)DeviceName.size());
+
+			for (wchar_t Char : DeviceName) Write16(File, (uint16_t)Char);
+
+			uint64_t Cycle = 0;
+
+			for (auto& Entry : Entries)
+			{
+				/* Waits longer than 32-bit are split */
+				while (Entry.Cycle > Cycle)
+				{
+					uint32_t Wait = (uint32_t)std::min<uint64_t>(Entry.Cycle - Cycle, UINT32_MAX);
+
+					File.put(0x61);
+					Write32(File, Wait);
+					Cycle += Wait;
+				}
+
+				switch (Entry.Type)
+				{
+				case TraceEntry::Write:
+					File.put(0x50);
+					Write32(File, Entry.Address);
+					Write32(File, Entry.Data);
+					break;
+
+				case TraceEntry::Register:
+					File.put(0x51);
+					File.put((char)Entry.Port);
+					Write16(File, (uint16_t)Entry.Address);
+					Write16(File, (uint16_t)Entry.Data);
+					break;
+
+				case TraceEntry::Exclusive:
+					File.put(0x52);
+					Write32(File, Entry.Address);
+					Write32(File, Entry.Data);
+					break;
+				}
+			}
+
+			File.put(0x66);
+			File.close();
+
+			return !File.fail();
+		}
+
+		bool Load(const std::filesystem::path& FileName)
+		{
+			std::ifstream File(FileName, std::ios::binary);
+
+			if (!File.is_open()) return false;
+
+			char Magic[4] = {};
+			uint32_t FileVersion = 0;
+			uint32_t Length = 0;
+
+			bool Valid = File.read(Magic, 4) && !memcmp(Magic, "TCTL", 4) && Read32(File, FileVersion) &&
+				(FileVersion == Version) && Read32(File, ClockSpeed) && Read32(File, Length) && (Length < 0x100);
+
+			DeviceName.clear();
+			Entries.clear();
+
+			for (uint32_t i = 0; Valid && (i < Length); i++)
+			{
+				uint16_t Char = 0;
+
+				Valid = Read16(File, Char);
+				DeviceName += (wchar_t)Char;
+			}
+
+			uint64_t Cycle = 0;
+
+			while (Valid)
+			{
+				int Command = File.get();
+				TraceEntry Entry = { Cycle, 0, 0, TraceEntry::Write, 0 };
+				uint16_t Register = 0;
+				uint16_t Data = 0;
+				uint32_t Wait = 0;
+
+				if (Command == 0x66) break;
+
+				switch (Command)
+				{
+				case 0x50:
+					Valid = Read32(File, Entry.Address) && Read32(File, Entry.Data);
+					break;
+
+				case 0x51:
+					Entry.Type = TraceEntry::Register;
+					Entry.Port = (uint8_t)File.get();
+					Valid = Read16(File, Register) && Read16(File, Data);
+					Entry.Address = Register;
+					Entry.Data = Data;
+					break;
+
+				case 0x52:
+					Entry.Type = TraceEntry::Exclusive;
+					Valid = Read32(File, Entry.Address) && Read32(File, Entry.Data);
+					break;
+
+				case 0x61:
+					Valid = Read32(File, Wait);
+					Cycle += Wait;
+					continue;
+
+				default: /* Unknown command or end of file */
+					Valid = false;
+					continue;
+				}
+
+				Entries.push_back(Entry);
+			}
+
+			return Valid;
+		}
+
+		/// <summary>Replay the log on a device, the device is updated up to the timestamp of every entry.</summary>
+		/// <param name="Unit">Optional, the number of cycles the device is updated with at most per Update call.</param>
+		/// <returns>Number of clock cycles the device was updated for.</returns>
+		uint64_t Replay(ISoundDevice* Device, std::vector<IAudioBuffer*>& OutBuffer, uint32_t Unit = UINT32_MAX) const
+		{
+			uint64_t Cycle = 0;
+
+			for (auto& Entry : Entries)
+			{
+				while (Entry.Cycle > Cycle)
+				{
+					uint32_t Cycles = (uint32_t)std::min<uint64_t>(Entry.Cycle - Cycle, std::max(Unit, 1u));
+
+					Device->Update(Cycles, OutBuffer);
+					Cycle += Cycles;
+				}
+
+				switch (Entry.Type)
+				{
+				case TraceEntry::Write:
+					Device->Write(Entry.Address, Entry.Data);
+					break;
+
+				case TraceEntry::Register:
+				{
+					REGISTER_WRITE Write = { (uint16_t)Entry.Address, (uint16_t)Entry.Data };
+					Device->WriteBatch(Entry.Port, &Write, 1);
+					break;
+				}
+
+				case TraceEntry::Exclusive:
+					Device->SendExclusiveCommand(Entry.Address, Entry.Data);
+					break;
+				}
+			}
+
+			return Cycle;
+		}
+
+	private:
+		static void Write16(std::ofstream& File, uint16_t Value)
+		{
+			char Bytes[2] = { (char)Value, (char)(Value >> 8) };
+			File.write(Bytes, 2);
+		}
+
+		static void Write32(std::ofstream& File, uint32_t Value)
+		{
+			char Bytes[4] = { (char)Value, (char)(Value >> 8), (char)(Value >> 16), (char)(Value >> 24) };
+			File.write(Bytes, 4);
+		}
+
+		static bool Read16(std::ifstream& File, uint16_t& Value)
+		{
+			uint8_t Bytes[2];
+			if (!File.read((char*)Bytes, 2)) return false;
+
+			Value = Bytes[0] | (Bytes[1] << 8);
+			return true;
+		}
+
+		static bool Read32(std::ifstream& File, uint32_t& Value)
+		{
+			uint8_t Bytes[4];
+			if (!File.read((char*)Bytes, 4)) return false;
+
+			Value = Bytes[0] | (Bytes[1] << 8) | (Bytes[2] << 16) | ((uint32_t)Bytes[3] << 24);
+			return true;
+		}
+	};
+}
+
+#endif // !_TRITON_CORE_TRACE_H_
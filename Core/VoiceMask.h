@@ -0,0 +1,90 @@
+/*
+ _____    _ _            ___
+|_   _| _(_) |_ ___ _ _ / __|___ _ _ ___
+  | || '_| |  _/ _ \ ' \ (__/ _ \ '_/ -_)
+  |_||_| |_|\__\___/_||_\___\___/_| \___|
+
+Copyright  2024, Michel Gerritse
+All rights reserved.
+
+This source code is available under the BSD-3-Clause license.
+See LICENSE.txt in the root directory of this source tree.
+
+*/
+#ifndef _TRITON_CORE_VOICE_MASK_H_
+#define _TRITON_CORE_VOICE_MASK_H_
+
+#include <cstdint>
+
+/// <summary>TritonCore API version 1</summary>
+namespace TritonCore_v1
+{
+	/// <summary>Voice enable mask of a device (see ISoundDevice::SetChannelMask).</summary>
+	/// <remarks>
+	/// Muted voices skip their output computation, the device still advances their state.
+	/// Voices that keep a history of their previous outputs (eg. FM operator feedback and
+	/// modulation) are not exact right after unmuting. Those voices first run a number of
+	/// warm-up samples with their outputs computed but silenced, afterwards their output is
+	/// identical to a render in which the voice was never muted.
+	/// The mask is a host setting, it is not part of the device state.
+	/// </remarks>
+	class VoiceMask
+	{
+	public:
+		/// <param name="WarmUpVoices">Voices that need warm-up samples after unmuting.</param>
+		/// <param name="WarmUp">Number of warm-up samples.</param>
+		VoiceMask(uint64_t WarmUpVoices = 0, uint32_t WarmUp = 0) :
+			m_Enabled(~0ull),
+			m_WarmUpVoices(WarmUpVoices),
+			m_WarmUp(WarmUp),
+			m_Warming(0),
+			m_Counter(0)
+		{
+		}
+
+		/// <summary>Set the enabled voices (bit set = enabled).</summary>
+		void Set(uint64_t Enabled)
+		{
+			uint64_t Unmuted = Enabled & ~m_Enabled & m_WarmUpVoices;
+
+			m_Enabled = Enabled;
+			m_Warming = (m_Warming & Enabled) | Unmuted;
+
+			if (Unmuted != 0) m_Counter = m_WarmUp;
+			if (m_Counter == 0) m_Warming = 0;
+		}
+
+		/// <summary>Voices that skip their output computation.</summary>
+		inline uint64_t Skip() const
+		{
+			return ~m_Enabled;
+		}
+
+		/// <summary>Voices with a silenced output (muted or warming up).</summary>
+		inline uint64_t Silent() const
+		{
+			return ~m_Enabled | m_Warming;
+		}
+
+		/// <summary>No voice is muted or warming up.</summary>
+		inline bool IsClear() const
+		{
+			return (m_Enabled == ~0ull) && (m_Warming == 0);
+		}
+
+		/// <summary>Call once per output sample.</summary>
+		inline void Tick()
+		{
+			if ((m_Counter != 0) && (--m_Counter == 0)) m_Warming = 0;
+		}
+
+	private:
+		uint64_t	m_Enabled;
+		uint64_t	m_WarmUpVoices;
+		uint32_t	m_WarmUp;
+		uint64_t	m_Warming;		/* Unmuted voices still warming up */
+		uint32_t	m_Counter;		/* Warm-up samples left */
+	};
+}
+
+#endif // !_TRITON_CORE_VOICE_MASK_H_
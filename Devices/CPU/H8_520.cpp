@@ -13,16 +13,74 @@ See LICENSE.txt in the root directory of this source tree.
 */
 #include "H8_520.h"
 
+/*
+	Hitachi H8/520 (H8/500 CPU core)
+
+	- 8 general registers (R6 = frame pointer, R7 = stack pointer)
+	- Minimum mode (64KB) and maximum mode (1MB, 64KB pages selected by CP, DP, EP and TP)
+	- 512B on-chip RAM, 16KB on-chip ROM
+
+	Instructions are decoded once into a direct mapped cache keyed by CP:PC and executed
+	through a dispatch table. Writes to the on-chip RAM invalidate the decoded instructions
+	that overlap the written address. Instruction timings are approximate: 2 states per
+	instruction word, 2 states per memory operand and the stack / multiply / divide extras.
+*/
+
 /* Static class member initialization */
 const std::wstring H8_520::s_DeviceName = L"Hitachi H8/520";
 
-H8_520::H8_520()
+/* Status register flags */
+static constexpr uint32_t FlagC = 0x0001;	/* Carry */
+static constexpr uint32_t FlagV = 0x0002;	/* Overflow */
+static constexpr uint32_t FlagZ = 0x0004;	/* Zero */
+static constexpr uint32_t FlagN = 0x0008;	/* Negative */
+static constexpr uint32_t FlagI = 0x0700;	/* Interrupt mask */
+static constexpr uint32_t FlagT = 0x8000;	/* Trace */
+
+/* On-chip memory map (page 0) */
+static constexpr uint32_t RamStart = 0xFD80;
+static constexpr uint32_t RegStart = 0xFF80;
+static constexpr uint32_t RegSize = 0x0080;
+
+/* Dispatch table index, see s_Handlers */
+enum Handler : uint8_t
+{
+	H_INVALID, H_NOP, H_BCC, H_BSR, H_JMP, H_JSR, H_PJMP, H_PJSR, H_RTS, H_PRTS, H_RTE,
+	H_TRAPA, H_TRAPVS, H_SLEEP, H_LINK, H_UNLK, H_LDM, H_STM, H_SCB, H_MOV_LOAD, H_MOV_STORE,
+	H_MOV_IMM, H_CMP_IMM, H_ADDQ, H_ALU, H_ADDSUBS, H_ADDSUBX, H_UNARY, H_SHIFT, H_EXTEND,
+	H_BIT, H_CONTROL, H_LDC, H_STC, H_MULXU, H_DIVXU, H_XCH, H_DECIMAL
+};
+
+const H8_520::handler_t H8_520::s_Handlers[] =
+{
+	&H8_520::OpInvalid, &H8_520::OpNop, &H8_520::OpBcc, &H8_520::OpBsr, &H8_520::OpJmp,
+	&H8_520::OpJsr, &H8_520::OpPjmp, &H8_520::OpPjsr, &H8_520::OpRts, &H8_520::OpPrts,
+	&H8_520::OpRte, &H8_520::OpTrapa, &H8_520::OpTrapVs, &H8_520::OpSleep, &H8_520::OpLink,
+	&H8_520::OpUnlk, &H8_520::OpLdm, &H8_520::OpStm, &H8_520::OpScb, &H8_520::OpMovLoad,
+	&H8_520::OpMovStore, &H8_520::OpMovImm, &H8_520::OpCmpImm, &H8_520::OpAddQ, &H8_520::OpAlu,
+	&H8_520::OpAddSubS, &H8_520::OpAddSubX, &H8_520::OpUnary, &H8_520::OpShift, &H8_520::OpExtend,
+	&H8_520::OpBit, &H8_520::OpControl, &H8_520::OpLdc, &H8_520::OpStc, &H8_520::OpMulxu,
+	&H8_520::OpDivxu, &H8_520::OpXch, &H8_520::OpDecimal
+};
+
+H8_520::H8_520() :
+	AddrMask(0x00FFFF),
+	IsMinimum(true),
+	IsExpanded(false),
+	HasOnchipROM(true),
+	ModePins(McuMode::Mode7),
+	CycleBalance(0),
+	Bus(AddressBits, PageBits),
+	External(AddressBits, PageBits),
+	Cache(CacheSize)
 {
 	ResetToDefaults();
 
 	/* Clear on-chip ROM */
 	OnchipROM.fill(0x00);
-	
+
+	BuildMemoryMap();
+
 	/* Put CPU in reset state */
 	State = CpuState::RESET;
 	ResetPin = PinState::Low;
@@ -42,7 +100,7 @@ void H8_520::ResetToDefaults()
 	PC = 0xDEAD;
 
 	SR = 0x0700;
-	
+
 	CP = 0x00;
 	DP = 0x00;
 	EP = 0x00;
@@ -51,6 +109,8 @@ void H8_520::ResetToDefaults()
 
 	OnchipRAM.fill(0x00);
 
+	FlushCache();
+
 	//TODO: On-chip device registers
 }
 
@@ -80,132 +140,1676 @@ void H8_520::GenerateException(ExceptionType Type)
 {
 	uint32_t VectorAddr;
 
+	/* An exception while handling an exception (eg. an odd stack pointer) is not stacked again */
+	uint32_t Resume = (State == CpuState::SLEEP) ? CpuState::IEXEC : State;
+	State = CpuState::EXCEP;
+
+	/* Save PC, CP (maximum mode) and SR */
+	Push16(PC);
+	if (!IsMinimum) Push16(CP);
+	Push16(SR);
+
+	/* Clear trace, mask interrupts for NMI */
+	SR &= ~FlagT;
+	if (Type == ExceptionType::NonMaskableInterrupt) SR |= FlagI;
+
 	if (IsMinimum)
 	{
 		VectorAddr = Type * 2;
+
+		PC = Read16(VectorAddr);
 	}
 	else
 	{
 		VectorAddr = Type * 4;
+
+		CP = Read16(VectorAddr) & 0x00FF;
+		PC = Read16(VectorAddr + 2);
 	}
+
+	CycleBalance -= 2 * (IsMinimum ? 8 : 10);
+
+	State = (Resume == CpuState::EXCEP) ? CpuState::IEXEC : Resume;
 }
 
-void H8_520::Execute()
+uint32_t H8_520::Execute(uint32_t Cycles)
 {
-	switch (State)
+	CycleBalance += Cycles;
+
+	int32_t Start = CycleBalance;
+
+	while (CycleBalance > 0)
 	{
-	case CpuState::HSTBY:
-		/* Do nothing, we can only leave this state by setting /RES low */
-		return;
+		switch (State)
+		{
+		case CpuState::HSTBY:
+			/* Do nothing, we can only leave this state by setting /RES low */
+			CycleBalance = 0;
+			break;
 
-	case CpuState::SSTBY:
-		/* TODO */
-		return;
+		case CpuState::SSTBY:
+			/* TODO */
+			CycleBalance = 0;
+			break;
 
-	case CpuState::RESET:
-		if (ResetPin == PinState::Low) return;
+		case CpuState::RESET:
+			if (ResetPin == PinState::Low)
+			{
+				CycleBalance = 0;
+				break;
+			}
 
-		/* We are moving out the reset state, reset CPU to default values */
-		ResetToDefaults();
+			/* We are moving out the reset state, reset CPU to default values */
+			ResetToDefaults();
 
-		/* Latch mode pins into MDCR register */
-		MDCR = 0xC0 | (ModePins & 0x07); /* b7 and b6 are always set */
-		
-		/* Check CPU mode compatibility */
-		switch (MDCR & 0x07)
-		{
-		//TODO: Create memory map based on operating mode
+			/* Latch mode pins into MDCR register */
+			MDCR = 0xC0 | (ModePins & 0x07); /* b7 and b6 are always set */
 
-		case McuMode::Mode0:
-			__debugbreak();
-			break;
+			/* Check CPU mode compatibility */
+			switch (MDCR & 0x07)
+			{
+			//TODO: Create memory map based on operating mode
 
-		case McuMode::Mode1:
-			AddrMask = 0x00FFFF; /* 16-bit address bus */
-			IsMinimum = true;
-			IsExpanded = true;
-			HasOnchipROM = false;
-			break;
+			case McuMode::Mode0:
+				__debugbreak();
+				break;
 
-		case McuMode::Mode2:
-			AddrMask = 0x00FFFF; /* 16-bit address bus */
-			IsMinimum = true;
-			IsExpanded = true;
-			HasOnchipROM = true;
-			break;
+			case McuMode::Mode1:
+				AddrMask = 0x00FFFF; /* 16-bit address bus */
+				IsMinimum = true;
+				IsExpanded = true;
+				HasOnchipROM = false;
+				break;
 
-		case McuMode::Mode3:
-			AddrMask = 0x0FFFFF; /* 20-bit address bus */
-			IsMinimum = true;
-			IsExpanded = true;
-			HasOnchipROM = false;
-			break;
+			case McuMode::Mode2:
+				AddrMask = 0x00FFFF; /* 16-bit address bus */
+				IsMinimum = true;
+				IsExpanded = true;
+				HasOnchipROM = true;
+				break;
+
+			case McuMode::Mode3:
+				AddrMask = 0x0FFFFF; /* 20-bit address bus */
+				IsMinimum = false;
+				IsExpanded = true;
+				HasOnchipROM = false;
+				break;
+
+			case McuMode::Mode4:
+				AddrMask = 0x0FFFFF; /* 20-bit address bus */
+				IsMinimum = false;
+				IsExpanded = true;
+				HasOnchipROM = true;
+				break;
+
+			case McuMode::Mode5:
+				__debugbreak();
+				break;
+
+			case McuMode::Mode6:
+				State = CpuState::HSTBY;
+				continue;
+
+			case McuMode::Mode7:
+				AddrMask = 0x00FFFF; /* 16-bit address bus */
+				IsMinimum = true;
+				IsExpanded = false;
+				HasOnchipROM = true;
+				break;
+			}
 
-		case McuMode::Mode4:
-			AddrMask = 0x0FFFFF; /* 20-bit address bus */
-			IsMinimum = true;
-			IsExpanded = true;
-			HasOnchipROM = true;
+			if (IsMinimum)
+			{
+				PC = Read16(0x0000);
+			}
+			else
+			{
+				CP = Read16(0x0000) & 0x00FF;
+				PC = Read16(0x0002);
+			}
+
+			/* The memory map and decoded instructions depend on the operating mode */
+			BuildMemoryMap();
+			FlushCache();
+
+			State = CpuState::IEXEC;
+			CycleBalance -= 2 * 10;
 			break;
 
-		case McuMode::Mode5:
-			__debugbreak;
+		case CpuState::EXCEP:
+			/* Exceptions are handled by GenerateException */
+			State = CpuState::IEXEC;
 			break;
 
-		case McuMode::Mode6:
-			State = CpuState::HSTBY;
-			return;
+		case CpuState::IEXEC:
+		{
+			const OPCODE& Op = Fetch();
+
+			PC = (PC + Op.Length) & 0xFFFF;
+			CycleBalance -= Op.States;
 
-		case McuMode::Mode7:
-			AddrMask = 0x00FFFF; /* 20-bit address bus */
-			IsMinimum = true;
-			IsExpanded = false;
-			HasOnchipROM = true;
+			(this->*s_Handlers[Op.Handler])(Op);
+
+			if (SR & FlagT) GenerateException(ExceptionType::Trace);
 			break;
 		}
-		
-		if (IsMinimum)
-		{
-			PC = Read16(0x0000);
-		}
-		else
-		{
-			CP = Read16(0x0000) & 0x00FF;
-			PC = Read16(0x0002);
+
+		case CpuState::SLEEP:
+			/* Only an interrupt or a reset ends the sleep mode */
+			CycleBalance = 0;
+			break;
+
+		case CpuState::BUSRL:
+			/* Not supported on H8/520. We should not get here */
+			__debugbreak();
+			CycleBalance = 0;
+			break;
 		}
+	}
+
+	return (uint32_t)(Start - CycleBalance);
+}
+
+void H8_520::CopyToMemory(uint32_t MemoryID, size_t Offset, uint8_t* Data, size_t Size)
+{
+	switch (MemoryID)
+	{
+	case MemoryID::ROM:
+		if ((Offset > OnchipROM.size()) || (Size > (OnchipROM.size() - Offset))) break;
+
+		memcpy(OnchipROM.data() + Offset, Data, Size);
+
+		/* Decoded instructions can come from the old ROM data */
+		FlushCache();
 		break;
 
-	case CpuState::EXCEP:
-		/* TODO */
-		return;
+	default:
+		break;
+	}
+}
 
-	case CpuState::IEXEC:
-		/* TODO */
-		return;
+void H8_520::CopyToMemoryIndirect(uint32_t MemoryID, size_t Offset, uint8_t* Data, size_t Size)
+{
+	/* No banking */
+	CopyToMemory(MemoryID, Offset, Data, Size);
+}
 
-	case CpuState::SLEEP:
-		/* TODO */
-		return;
+size_t H8_520::GetMemorySize(uint32_t MemoryID)
+{
+	switch (MemoryID)
+	{
+	case MemoryID::ROM:
+		return OnchipROM.size();
 
-	case CpuState::BUSRL:
-		/* Not supported on H8/520. We should not get here */
-		__debugbreak();
-		return;
+	default:
+		return 0;
+	}
+}
+
+size_t H8_520::GetResidentSize()
+{
+	/* The on-chip memories are part of the device, only the decoded instructions are allocated */
+	return Cache.capacity() * sizeof(OPCODE);
+}
+
+void H8_520::MapExternal(uint32_t Start, uint32_t Size, uint8_t* Data, bool Writable)
+{
+	External.MapMemory(Start, Size, Data, Writable);
+
+	BuildMemoryMap();
+	FlushCache();
+}
+
+void H8_520::MapExternal(uint32_t Start, uint32_t Size, TC::MemoryMap::read_t Read, TC::MemoryMap::write_t Write)
+{
+	External.MapHandler(Start, Size, std::move(Read), std::move(Write));
+
+	BuildMemoryMap();
+	FlushCache();
+}
+
+void H8_520::UnmapExternal(uint32_t Start, uint32_t Size)
+{
+	External.Unmap(Start, Size);
+
+	BuildMemoryMap();
+	FlushCache();
+}
+
+void H8_520::BuildMemoryMap()
+{
+	/* The external address space is only accessible in the expanded modes */
+	if (IsExpanded)
+	{
+		Bus.Assign(External);
+	}
+	else
+	{
+		Bus.Clear();
 	}
+
+	if (HasOnchipROM)
+	{
+		Bus.MapMemory(0x0000, (uint32_t)OnchipROM.size(), OnchipROM.data(), false);
+	}
+
+	Bus.MapMemory(RamStart, (uint32_t)OnchipRAM.size(), OnchipRAM.data(), true);
+	Bus.MapHandler(RegStart, RegSize, [this](uint32_t Address) { return ReadIO(Address); }, [this](uint32_t Address, uint8_t Data) { WriteIO(Address, Data); });
+}
+
+uint8_t H8_520::ReadIO(uint32_t Address)
+{
+	//TODO: On-chip device registers
+	return 0xFF;
+}
+
+void H8_520::WriteIO(uint32_t Address, uint8_t Data)
+{
+	//TODO: On-chip device registers
 }
 
 uint8_t H8_520::Read8(uint32_t Address)
 {
-	return 0;
+	return Bus.Read8(Address & AddrMask);
 }
 
 uint16_t H8_520::Read16(uint32_t Address)
 {
 	if (Address & 0x01)
 	{
-		GenerateException(ExceptionType::AddressError);
+		if (State == CpuState::IEXEC) GenerateException(ExceptionType::AddressError);
 		Address &= 0x00FFFFFE; /* Is this correct ?? */
 	}
-	
+
 	return (Read8(Address) << 8) | Read8(Address + 1);
 }
+
+void H8_520::Write8(uint32_t Address, uint8_t Data)
+{
+	Address &= AddrMask;
+
+	Bus.Write8(Address, Data);
+
+	/* Self-modifying code / code copied to RAM */
+	InvalidateCache(Address);
+}
+
+void H8_520::Write16(uint32_t Address, uint16_t Data)
+{
+	if (Address & 0x01)
+	{
+		if (State == CpuState::IEXEC) GenerateException(ExceptionType::AddressError);
+		Address &= 0x00FFFFFE;
+	}
+
+	Write8(Address, Data >> 8);
+	Write8(Address + 1, Data & 0xFF);
+}
+
+const H8_520::OPCODE& H8_520::Fetch()
+{
+	uint32_t Address = CodeAddress(PC);
+
+	OPCODE& Op = Cache[Address & (CacheSize - 1)];
+
+	if (Op.Tag != Address) Decode(Address, Op);
+
+	return Op;
+}
+
+void H8_520::FlushCache()
+{
+	for (auto& Op : Cache) Op.Tag = ~0u;
+}
+
+void H8_520::InvalidateCache(uint32_t Address)
+{
+	/* All instructions that start up to MaxLength - 1 bytes before the written address */
+	for (uint32_t i = 0; i < MaxLength; i++)
+	{
+		uint32_t Start = (Address & 0xFF0000) | ((Address - i) & 0xFFFF);
+
+		OPCODE& Op = Cache[Start & (CacheSize - 1)];
+
+		if ((Op.Tag == Start) && (Op.Length > i)) Op.Tag = ~0u;
+	}
+}
+
+void H8_520::Decode(uint32_t Address, OPCODE& Op)
+{
+	auto Byte = [&](uint32_t Offset) -> uint32_t { return Read8((Address & 0xFF0000) | ((Address + Offset) & 0xFFFF)); };
+	auto Word = [&](uint32_t Offset) -> uint32_t { return (Byte(Offset) << 8) | Byte(Offset + 1); };
+
+	Op = {};
+	Op.Tag = Address;
+	Op.Handler = H_INVALID;
+	Op.Length = 1;
+
+	uint32_t Code = Byte(0);
+
+	/* Instructions with a page (maximum mode only) */
+	bool Paged = false;
+
+	switch (Code)
+	{
+	case 0x00: /* NOP */
+		Op.Handler = H_NOP;
+		break;
+
+	case 0x01: /* SCB/F */
+	case 0x06: /* SCB/NE */
+	case 0x07: /* SCB/EQ */
+		if ((Byte(1) & 0xF8) != 0xB8) break;
+
+		Op.Handler = H_SCB;
+		Op.Rn = Byte(1) & 0x07;
+		Op.Rd = (Code == 0x01) ? 0x01 : (Code == 0x06) ? 0x06 : 0x07; /* Condition that ends the loop (F, NE, EQ) */
+		Op.Imm = (int8_t)Byte(2);
+		Op.Length = 3;
+		break;
+
+	case 0x02: /* LDM @SP+, <Register list> */
+	case 0x12: /* STM <Register list>, @-SP */
+		Op.Handler = (Code == 0x02) ? H_LDM : H_STM;
+		Op.Imm = Byte(1);
+		Op.Length = 2;
+		break;
+
+	case 0x03: /* PJSR @aa:24 */
+	case 0x13: /* PJMP @aa:24 */
+		Op.Handler = (Code == 0x03) ? H_PJSR : H_PJMP;
+		Op.EA = EA_ABS16;
+		Op.Disp = (Byte(1) << 16) | Word(2);
+		Op.Length = 4;
+		Paged = true;
+		break;
+
+	case 0x04: /* #xx:8 */
+	case 0x05: /* @aa:8 (byte) */
+	case 0x0C: /* #xx:16 */
+	case 0x0D: /* @aa:8 (word) */
+	case 0x15: /* @aa:16 (byte) */
+	case 0x1D: /* @aa:16 (word) */
+		DecodeGeneral(Address, Op);
+		break;
+
+	case 0x08: /* TRAPA #xx */
+		if ((Byte(1) & 0xF0) != 0x10) break;
+
+		Op.Handler = H_TRAPA;
+		Op.Rd = Byte(1) & 0x0F;
+		Op.Length = 2;
+		break;
+
+	case 0x09: /* TRAP/VS */
+		Op.Handler = H_TRAPVS;
+		break;
+
+	case 0x0A: /* RTE */
+		Op.Handler = H_RTE;
+		break;
+
+	case 0x0E: /* BSR d:8 */
+	case 0x1E: /* BSR d:16 */
+		Op.Handler = H_BSR;
+		Op.Imm = (Code == 0x0E) ? (int8_t)Byte(1) : (int16_t)Word(1);
+		Op.Length = (Code == 0x0E) ? 2 : 3;
+		break;
+
+	case 0x0F: /* UNLK FP */
+		Op.Handler = H_UNLK;
+		break;
+
+	case 0x10: /* JMP @aa:16 */
+	case 0x18: /* JSR @aa:16 */
+		Op.Handler = (Code == 0x10) ? H_JMP : H_JSR;
+		Op.EA = EA_ABS16;
+		Op.Disp = Word(1);
+		Op.Length = 3;
+		break;
+
+	case 0x11: /* JMP, JSR, PJMP, PJSR, PRTS and PRTD */
+	{
+		uint32_t Sub = Byte(1);
+
+		Op.Length = 2;
+
+		if (Sub == 0x19) /* PRTS */
+		{
+			Op.Handler = H_PRTS;
+			Paged = true;
+		}
+		else if ((Sub == 0x14) || (Sub == 0x1C)) /* PRTD #xx:8 / #xx:16 */
+		{
+			Op.Handler = H_PRTS;
+			Op.Imm = (Sub == 0x14) ? (int8_t)Byte(2) : (int16_t)Word(2);
+			Op.Length = (Sub == 0x14) ? 3 : 4;
+			Paged = true;
+		}
+		else if (Sub >= 0xC0)
+		{
+			static constexpr uint8_t Handlers[2][2] = { { H_PJMP, H_PJSR }, { H_JMP, H_JSR } };
+
+			Op.Rn = Sub & 0x07;
+
+			switch (Sub & 0xF0)
+			{
+			case 0xC0: /* PJMP / PJSR @Rn */
+				Op.EA = EA_IND;
+				Paged = true;
+				break;
+
+			case 0xD0: /* JMP / JSR @Rn */
+				Op.EA = EA_IND;
+				break;
+
+			case 0xE0: /* JMP / JSR @(d:8,Rn) */
+				Op.EA = EA_DISP;
+				Op.Disp = (int8_t)Byte(2);
+				Op.Length = 3;
+				break;
+
+			case 0xF0: /* JMP / JSR @(d:16,Rn) */
+				Op.EA = EA_DISP;
+				Op.Disp = (int16_t)Word(2);
+				Op.Length = 4;
+				break;
+			}
+
+			Op.Handler = Handlers[(Sub & 0xF0) != 0xC0][(Sub >> 3) & 0x01];
+		}
+		break;
+	}
+
+	case 0x14: /* RTD #xx:8 */
+	case 0x1C: /* RTD #xx:16 */
+		Op.Handler = H_RTS;
+		Op.Imm = (Code == 0x14) ? (int8_t)Byte(1) : (int16_t)Word(1);
+		Op.Length = (Code == 0x14) ? 2 : 3;
+		break;
+
+	case 0x17: /* LINK FP, #xx:8 */
+	case 0x1F: /* LINK FP, #xx:16 */
+		Op.Handler = H_LINK;
+		Op.Imm = (Code == 0x17) ? (int8_t)Byte(1) : (int16_t)Word(1);
+		Op.Length = (Code == 0x17) ? 2 : 3;
+		break;
+
+	case 0x19: /* RTS */
+		Op.Handler = H_RTS;
+		break;
+
+	case 0x1A: /* SLEEP */
+		Op.Handler = H_SLEEP;
+		break;
+
+	default:
+		switch (Code & 0xF0)
+		{
+		case 0x20: /* Bcc d:8 */
+		case 0x30: /* Bcc d:16 */
+			Op.Handler = H_BCC;
+			Op.Rd = Code & 0x0F;
+			Op.Imm = (Code < 0x30) ? (int8_t)Byte(1) : (int16_t)Word(1);
+			Op.Length = (Code < 0x30) ? 2 : 3;
+			break;
+
+		case 0x40: /* CMP:E #xx:8, Rd / CMP:I #xx:16, Rd */
+		case 0x50: /* MOV:E #xx:8, Rd / MOV:I #xx:16, Rd */
+			Op.Handler = ((Code & 0xF0) == 0x40) ? H_CMP_IMM : H_MOV_IMM;
+			Op.EA = EA_REG;
+			Op.Word = (Code >> 3) & 0x01;
+			Op.Rn = Code & 0x07;
+			Op.Imm = Op.Word ? Word(1) : Byte(1);
+			Op.Length = Op.Word ? 3 : 2;
+			break;
+
+		case 0x60: /* MOV:L @aa:8, Rd */
+		case 0x70: /* MOV:S Rs, @aa:8 */
+			Op.Handler = ((Code & 0xF0) == 0x60) ? H_MOV_LOAD : H_MOV_STORE;
+			Op.EA = EA_ABS8;
+			Op.Word = (Code >> 3) & 0x01;
+			Op.Rd = Code & 0x07;
+			Op.Disp = Byte(1);
+			Op.Length = 2;
+			break;
+
+		case 0x80: /* MOV:F @(d:8,R6), Rd */
+		case 0x90: /* MOV:F Rs, @(d:8,R6) */
+			Op.Handler = ((Code & 0xF0) == 0x80) ? H_MOV_LOAD : H_MOV_STORE;
+			Op.EA = EA_DISP;
+			Op.Word = (Code >> 3) & 0x01;
+			Op.Rn = 6;
+			Op.Rd = Code & 0x07;
+			Op.Disp = (int8_t)Byte(1);
+			Op.Length = 2;
+			break;
+
+		case 0xA0: /* Rn */
+		case 0xB0: /* @-Rn */
+		case 0xC0: /* @Rn+ */
+		case 0xD0: /* @Rn */
+		case 0xE0: /* @(d:8,Rn) */
+		case 0xF0: /* @(d:16,Rn) */
+			DecodeGeneral(Address, Op);
+			break;
+
+		default: /* 0x0B, 0x16 and 0x1B are not used */
+			break;
+		}
+		break;
+	}
+
+	/* Page instructions don't exist in minimum mode */
+	if (Paged && IsMinimum) Op.Handler = H_INVALID;
+
+	/* Instruction fetch: 2 states per word */
+	Op.States += 2 * ((Op.Length + 1) >> 1);
+
+	/* Operand access */
+	if ((Op.EA != EA_NONE) && (Op.EA != EA_REG) && (Op.EA != EA_IMM))
+	{
+		switch (Op.Handler)
+		{
+		case H_JMP:
+		case H_JSR:
+		case H_PJMP:
+		case H_PJSR:
+			break;
+
+		case H_ADDQ:
+		case H_UNARY:
+		case H_SHIFT:
+		case H_BIT:
+			Op.States += 4; /* Read-modify-write */
+			break;
+
+		default:
+			Op.States += 2;
+			break;
+		}
+	}
+
+	/* Stack and arithmetic extras */
+	switch (Op.Handler)
+	{
+	case H_BSR:
+	case H_JSR:
+	case H_RTS:
+	case H_LINK:
+	case H_UNLK:
+		Op.States += 4;
+		break;
+
+	case H_PJSR:
+	case H_PRTS:
+	case H_RTE:
+		Op.States += 8;
+		break;
+
+	case H_LDM:
+	case H_STM:
+		Op.States += 2 + 2 * std::popcount((uint32_t)Op.Imm);
+		break;
+
+	case H_TRAPA:
+	case H_TRAPVS:
+		Op.States += 2;
+		break;
+
+	case H_MULXU:
+		Op.States += Op.Word ? 22 : 14;
+		break;
+
+	case H_DIVXU:
+		Op.States += Op.Word ? 26 : 18;
+		break;
+
+	default:
+		break;
+	}
+}
+
+void H8_520::DecodeGeneral(uint32_t Address, OPCODE& Op)
+{
+	auto Byte = [&](uint32_t Offset) -> uint32_t { return Read8((Address & 0xFF0000) | ((Address + Offset) & 0xFFFF)); };
+	auto Word = [&](uint32_t Offset) -> uint32_t { return (Byte(Offset) << 8) | Byte(Offset + 1); };
+
+	/* Effective address field */
+	uint32_t Code = Byte(0);
+	uint32_t Pos = 1;
+
+	Op.Word = (Code >> 3) & 0x01;
+	Op.Rn = Code & 0x07;
+
+	switch (Code)
+	{
+	case 0x04: /* #xx:8 */
+		Op.EA = EA_IMM;
+		Op.Disp = Byte(1);
+		Pos = 2;
+		break;
+
+	case 0x0C: /* #xx:16 */
+		Op.EA = EA_IMM;
+		Op.Disp = Word(1);
+		Pos = 3;
+		break;
+
+	case 0x05: /* @aa:8 */
+	case 0x0D:
+		Op.EA = EA_ABS8;
+		Op.Disp = Byte(1);
+		Pos = 2;
+		break;
+
+	case 0x15: /* @aa:16 */
+	case 0x1D:
+		Op.EA = EA_ABS16;
+		Op.Disp = Word(1);
+		Pos = 3;
+		break;
+
+	default:
+		switch (Code & 0xF0)
+		{
+		case 0xA0: Op.EA = EA_REG; break;
+		case 0xB0: Op.EA = EA_PREDEC; break;
+		case 0xC0: Op.EA = EA_POSTINC; break;
+		case 0xD0: Op.EA = EA_IND; break;
+
+		case 0xE0:
+			Op.EA = EA_DISP;
+			Op.Disp = (int8_t)Byte(1);
+			Pos = 2;
+			break;
+
+		case 0xF0:
+			Op.EA = EA_DISP;
+			Op.Disp = (int16_t)Word(1);
+			Pos = 3;
+			break;
+		}
+		break;
+	}
+
+	/* Operation code */
+	uint32_t Oper = Byte(Pos);
+
+	Op.Rd = Oper & 0x07;
+	Op.Length = Pos + 1;
+
+	/* The destination is the effective address */
+	bool Writes = false;
+
+	switch (Oper & 0xF8)
+	{
+	case 0x00:
+	case 0x08:
+		switch (Oper)
+		{
+		case 0x00: /* MOVFPE, MOVTPE, DADD and DSUB */
+		{
+			uint32_t Ext = Byte(Pos + 1);
+
+			Op.Rd = Ext & 0x07;
+			Op.Length = Pos + 2;
+
+			switch (Ext & 0xF8)
+			{
+			case 0x80: /* MOVFPE @aa:16, Rd */
+				if ((Op.EA == EA_ABS16) && !Op.Word) Op.Handler = H_MOV_LOAD;
+				break;
+
+			case 0x90: /* MOVTPE Rs, @aa:16 */
+				if ((Op.EA == EA_ABS16) && !Op.Word) Op.Handler = H_MOV_STORE;
+				break;
+
+			case 0xA0: /* DADD Rs, Rd */
+			case 0xB0: /* DSUB Rs, Rd */
+				if ((Op.EA != EA_REG) || Op.Word) break;
+
+				Op.Handler = H_DECIMAL;
+				Op.Func = (Ext >> 4) & 0x01;
+				break;
+			}
+			break;
+		}
+
+		case 0x04: /* CMP:G #xx:8, <EA> */
+			Op.Handler = H_CMP_IMM;
+			Op.Imm = Op.Word ? (int8_t)Byte(Pos + 1) & 0xFFFF : Byte(Pos + 1);
+			Op.Length = Pos + 2;
+			break;
+
+		case 0x05: /* CMP:G #xx:16, <EA> */
+			if (!Op.Word) break;
+
+			Op.Handler = H_CMP_IMM;
+			Op.Imm = Word(Pos + 1);
+			Op.Length = Pos + 3;
+			break;
+
+		case 0x06: /* MOV:G #xx:8, <EA> */
+			Op.Handler = H_MOV_IMM;
+			Op.Imm = Op.Word ? (int8_t)Byte(Pos + 1) & 0xFFFF : Byte(Pos + 1);
+			Op.Length = Pos + 2;
+			Writes = true;
+			break;
+
+		case 0x07: /* MOV:G #xx:16, <EA> */
+			if (!Op.Word) break;
+
+			Op.Handler = H_MOV_IMM;
+			Op.Imm = Word(Pos + 1);
+			Op.Length = Pos + 3;
+			Writes = true;
+			break;
+
+		default: /* ADD:Q #1, #2, #-1, #-2 */
+			if ((Oper & 0x0A) != 0x08) break;
+
+			Op.Handler = H_ADDQ;
+			Op.Imm = ((Oper & 0x04) ? -1 : 1) * ((Oper & 0x01) + 1);
+			Writes = true;
+			break;
+		}
+		break;
+
+	case 0x10:
+		if (Oper < 0x13) /* SWAP, EXTS, EXTU */
+		{
+			if ((Op.EA != EA_REG) || Op.Word) break;
+
+			Op.Handler = H_EXTEND;
+			Op.Func = Oper & 0x03;
+			Op.Rd = Op.Rn;
+		}
+		else if (Oper < 0x18) /* CLR, NEG, NOT, TST, TAS */
+		{
+			if ((Oper == 0x17) && Op.Word) break;
+
+			Op.Handler = H_UNARY;
+			Op.Func = Oper & 0x07;
+			Writes = (Oper != 0x16);
+		}
+		else /* SHAL, SHAR, SHLL, SHLR, ROTL, ROTR, ROTXL, ROTXR */
+		{
+			Op.Handler = H_SHIFT;
+			Op.Func = Oper & 0x07;
+			Writes = true;
+		}
+		break;
+
+	case 0x20: /* ADD:G <EA>, Rd */
+	case 0x30: /* SUB <EA>, Rd */
+	case 0x40: /* OR <EA>, Rd */
+	case 0x50: /* AND <EA>, Rd */
+	case 0x60: /* XOR <EA>, Rd */
+	case 0x70: /* CMP:G <EA>, Rd */
+		Op.Handler = H_ALU;
+		Op.Func = Oper >> 4;
+		break;
+
+	case 0x28: /* ADDS <EA>, Rd */
+	case 0x38: /* SUBS <EA>, Rd */
+		Op.Handler = H_ADDSUBS;
+		Op.Func = (Oper >> 4) & 0x01;
+		break;
+
+	case 0x48: /* ORC #xx, CR / BSET Rs, <EA> */
+	case 0x58: /* ANDC #xx, CR / BCLR Rs, <EA> */
+	case 0x68: /* XORC #xx, CR / BNOT Rs, <EA> */
+	case 0x78: /* BTST Rs, <EA> */
+		if ((Op.EA == EA_IMM) && (Oper < 0x78))
+		{
+			Op.Handler = H_CONTROL;
+			Op.Func = Oper >> 4;
+		}
+		else
+		{
+			/* Bit number in Rs */
+			Op.Handler = H_BIT;
+			Op.Func = 0x04 | (((Oper >> 4) - 4) & 0x03);
+			Writes = (Oper < 0x78);
+		}
+		break;
+
+	case 0x80: /* MOV:G <EA>, Rd */
+		Op.Handler = H_MOV_LOAD;
+		break;
+
+	case 0x88: /* LDC <EA>, CR */
+		Op.Handler = H_LDC;
+		break;
+
+	case 0x90: /* MOV:G Rs, <EA> / XCH Rs, Rd */
+		if (Op.EA == EA_REG)
+		{
+			if (Op.Word) Op.Handler = H_XCH;
+		}
+		else
+		{
+			Op.Handler = H_MOV_STORE;
+			Writes = true;
+		}
+		break;
+
+	case 0x98: /* STC CR, <EA> */
+		Op.Handler = H_STC;
+		Writes = true;
+		break;
+
+	case 0xA0: /* ADDX <EA>, Rd */
+	case 0xB0: /* SUBX <EA>, Rd */
+		Op.Handler = H_ADDSUBX;
+		Op.Func = (Oper >> 4) & 0x01;
+		break;
+
+	case 0xA8: /* MULXU <EA>, Rd */
+	case 0xB8: /* DIVXU <EA>, Rd */
+		/* Word operations use the register pair Rd:Rd+1 */
+		if (Op.Word && (Op.Rd & 0x01)) break;
+
+		Op.Handler = (Oper < 0xB0) ? H_MULXU : H_DIVXU;
+		break;
+
+	default: /* BSET, BCLR, BNOT, BTST #xx, <EA> */
+		Op.Handler = H_BIT;
+		Op.Func = (Oper >> 4) & 0x03;
+		Op.Rd = Oper & 0x0F;
+		Writes = (Oper < 0xF0);
+		break;
+	}
+
+	/* Control registers: SR (word), CCR, BR, EP, DP, TP (byte) */
+	if ((Op.Handler == H_CONTROL) || (Op.Handler == H_LDC) || (Op.Handler == H_STC))
+	{
+		bool Valid = (Op.Rd == 0) ? (Op.Word != 0) : ((Op.Word == 0) && (Op.Rd != 2) && (Op.Rd != 6));
+
+		if (!Valid) Op.Handler = H_INVALID;
+	}
+
+	/* An immediate can't be written */
+	if (Writes && (Op.EA == EA_IMM)) Op.Handler = H_INVALID;
+}
+
+uint32_t H8_520::CodeAddress(uint32_t Offset) const
+{
+	return IsMinimum ? (Offset & 0xFFFF) : ((CP << 16) | (Offset & 0xFFFF));
+}
+
+uint32_t H8_520::DataAddress(uint32_t Rn, uint32_t Offset) const
+{
+	if (IsMinimum) return Offset & 0xFFFF;
+
+	/* R0 - R3 use DP, R4 - R5 use EP, R6 - R7 use TP */
+	uint32_t Page = (Rn < 4) ? DP : (Rn < 6) ? EP : TP;
+
+	return (Page << 16) | (Offset & 0xFFFF);
+}
+
+uint32_t H8_520::EffectiveAddress(const OPCODE& Op)
+{
+	uint32_t Step = Op.Word ? 2 : 1;
+
+	switch (Op.EA)
+	{
+	case EA_PREDEC:
+		R[Op.Rn] = (R[Op.Rn] - Step) & 0xFFFF;
+		return DataAddress(Op.Rn, R[Op.Rn]);
+
+	case EA_POSTINC:
+	{
+		uint32_t Address = DataAddress(Op.Rn, R[Op.Rn]);
+		R[Op.Rn] = (R[Op.Rn] + Step) & 0xFFFF;
+		return Address;
+	}
+
+	case EA_IND:
+		return DataAddress(Op.Rn, R[Op.Rn]);
+
+	case EA_DISP:
+		return DataAddress(Op.Rn, R[Op.Rn] + Op.Disp);
+
+	case EA_ABS8:
+		return DataAddress(0, (BR << 8) | Op.Disp);
+
+	case EA_ABS16:
+		return DataAddress(0, Op.Disp);
+
+	default: /* Register / immediate */
+		return 0;
+	}
+}
+
+uint32_t H8_520::ReadOperand(const OPCODE& Op, uint32_t Address)
+{
+	switch (Op.EA)
+	{
+	case EA_REG:
+		return ReadRegister(Op.Rn, Op.Word);
+
+	case EA_IMM:
+		return Op.Disp;
+
+	default:
+		return Op.Word ? Read16(Address) : Read8(Address);
+	}
+}
+
+void H8_520::WriteOperand(const OPCODE& Op, uint32_t Address, uint32_t Data)
+{
+	if (Op.EA == EA_REG)
+	{
+		WriteRegister(Op.Rn, Op.Word, Data);
+	}
+	else if (Op.Word)
+	{
+		Write16(Address, Data & 0xFFFF);
+	}
+	else
+	{
+		Write8(Address, Data & 0xFF);
+	}
+}
+
+uint32_t H8_520::ReadRegister(uint32_t Rn, uint32_t Word) const
+{
+	return Word ? R[Rn] : (R[Rn] & 0xFF);
+}
+
+void H8_520::WriteRegister(uint32_t Rn, uint32_t Word, uint32_t Data)
+{
+	/* Byte writes keep the upper byte */
+	R[Rn] = Word ? (Data & 0xFFFF) : ((R[Rn] & 0xFF00) | (Data & 0xFF));
+}
+
+uint32_t H8_520::ReadControl(uint32_t Cr) const
+{
+	switch (Cr)
+	{
+	case 0: return SR;
+	case 1: return SR & 0xFF;
+	case 3: return BR;
+	case 4: return EP;
+	case 5: return DP;
+	case 7: return TP;
+	default: return 0;
+	}
+}
+
+void H8_520::WriteControl(uint32_t Cr, uint32_t Data)
+{
+	switch (Cr)
+	{
+	case 0: SR = Data & (FlagT | FlagI | 0x0F); break;
+	case 1: SR = (SR & 0xFF00) | (Data & 0x0F); break;
+	case 3: BR = Data & 0xFF; break;
+	case 4: EP = Data & 0xFF; break;
+	case 5: DP = Data & 0xFF; break;
+	case 7: TP = Data & 0xFF; break;
+	default: break;
+	}
+}
+
+void H8_520::Push16(uint16_t Data)
+{
+	R[7] = (R[7] - 2) & 0xFFFF;
+
+	Write16(DataAddress(7, R[7]), Data);
+}
+
+uint16_t H8_520::Pop16()
+{
+	uint16_t Data = Read16(DataAddress(7, R[7]));
+
+	R[7] = (R[7] + 2) & 0xFFFF;
+
+	return Data;
+}
+
+bool H8_520::TestCondition(uint32_t Cc) const
+{
+	bool C = (SR & FlagC) != 0;
+	bool V = (SR & FlagV) != 0;
+	bool Z = (SR & FlagZ) != 0;
+	bool N = (SR & FlagN) != 0;
+
+	switch (Cc & 0x0F)
+	{
+	case 0x00: return true;				/* BRA (BT) */
+	case 0x01: return false;			/* BRN (BF) */
+	case 0x02: return !(C || Z);		/* BHI */
+	case 0x03: return C || Z;			/* BLS */
+	case 0x04: return !C;				/* BCC (BHS) */
+	case 0x05: return C;				/* BCS (BLO) */
+	case 0x06: return !Z;				/* BNE */
+	case 0x07: return Z;				/* BEQ */
+	case 0x08: return !V;				/* BVC */
+	case 0x09: return V;				/* BVS */
+	case 0x0A: return !N;				/* BPL */
+	case 0x0B: return N;				/* BMI */
+	case 0x0C: return N == V;			/* BGE */
+	case 0x0D: return N != V;			/* BLT */
+	case 0x0E: return !Z && (N == V);	/* BGT */
+	default:   return Z || (N != V);	/* BLE */
+	}
+}
+
+void H8_520::SetNZ(uint32_t Result, uint32_t Word)
+{
+	/* Logical result: N and Z set, V cleared, C unchanged */
+	uint32_t Mask = Word ? 0xFFFF : 0xFF;
+	uint32_t Sign = Word ? 0x8000 : 0x80;
+
+	SR &= ~(FlagN | FlagZ | FlagV);
+
+	if (Result & Sign) SR |= FlagN;
+	if ((Result & Mask) == 0) SR |= FlagZ;
+}
+
+uint32_t H8_520::Add(uint32_t A, uint32_t B, uint32_t Carry, uint32_t Word, bool Extended)
+{
+	uint32_t Mask = Word ? 0xFFFF : 0xFF;
+	uint32_t Sign = Word ? 0x8000 : 0x80;
+
+	A &= Mask;
+	B &= Mask;
+
+	uint32_t Result = A + B + Carry;
+
+	SR &= ~(FlagN | FlagV | FlagC);
+
+	if (Result > Mask) SR |= FlagC;
+	if (~(A ^ B) & (A ^ Result) & Sign) SR |= FlagV;
+	if (Result & Sign) SR |= FlagN;
+
+	Result &= Mask;
+
+	/* ADDX / SUBX only clear Z (multi-precision results) */
+	if (Result != 0) SR &= ~FlagZ;
+	else if (!Extended) SR |= FlagZ;
+
+	return Result;
+}
+
+uint32_t H8_520::Sub(uint32_t A, uint32_t B, uint32_t Carry, uint32_t Word, bool Extended)
+{
+	uint32_t Mask = Word ? 0xFFFF : 0xFF;
+	uint32_t Sign = Word ? 0x8000 : 0x80;
+
+	A &= Mask;
+	B &= Mask;
+
+	uint32_t Result = A - B - Carry;
+
+	SR &= ~(FlagN | FlagV | FlagC);
+
+	if ((B + Carry) > A) SR |= FlagC;
+	if ((A ^ B) & (A ^ Result) & Sign) SR |= FlagV;
+	if (Result & Sign) SR |= FlagN;
+
+	Result &= Mask;
+
+	if (Result != 0) SR &= ~FlagZ;
+	else if (!Extended) SR |= FlagZ;
+
+	return Result;
+}
+
+void H8_520::Branch(int32_t Disp)
+{
+	/* PC relative to the next instruction */
+	PC = (PC + Disp) & 0xFFFF;
+
+	CycleBalance -= 2;
+}
+
+void H8_520::OpInvalid(const OPCODE& Op)
+{
+	/* The saved PC points to the next instruction */
+	GenerateException(ExceptionType::InvalidInstruction);
+}
+
+void H8_520::OpNop(const OPCODE& Op)
+{
+}
+
+void H8_520::OpBcc(const OPCODE& Op)
+{
+	if (TestCondition(Op.Rd)) Branch(Op.Imm);
+}
+
+void H8_520::OpBsr(const OPCODE& Op)
+{
+	Push16(PC);
+	Branch(Op.Imm);
+}
+
+void H8_520::OpJmp(const OPCODE& Op)
+{
+	PC = (Op.EA == EA_ABS16) ? Op.Disp : (EffectiveAddress(Op) & 0xFFFF);
+}
+
+void H8_520::OpJsr(const OPCODE& Op)
+{
+	uint32_t Target = (Op.EA == EA_ABS16) ? Op.Disp : (EffectiveAddress(Op) & 0xFFFF);
+
+	Push16(PC);
+	PC = Target;
+}
+
+void H8_520::OpPjmp(const OPCODE& Op)
+{
+	if (Op.EA == EA_ABS16) /* @aa:24 */
+	{
+		CP = (Op.Disp >> 16) & 0xFF;
+		PC = Op.Disp & 0xFFFF;
+	}
+	else /* @Rn: page in Rn, address in Rn+1 */
+	{
+		CP = R[Op.Rn] & 0xFF;
+		PC = R[(Op.Rn + 1) & 0x07];
+	}
+}
+
+void H8_520::OpPjsr(const OPCODE& Op)
+{
+	Push16(PC);
+	Push16(CP);
+
+	OpPjmp(Op);
+}
+
+void H8_520::OpRts(const OPCODE& Op)
+{
+	PC = Pop16();
+
+	/* RTD: release the stack arguments */
+	R[7] = (R[7] + Op.Imm) & 0xFFFF;
+}
+
+void H8_520::OpPrts(const OPCODE& Op)
+{
+	CP = Pop16() & 0xFF;
+	PC = Pop16();
+
+	/* PRTD: release the stack arguments */
+	R[7] = (R[7] + Op.Imm) & 0xFFFF;
+}
+
+void H8_520::OpRte(const OPCODE& Op)
+{
+	SR = Pop16() & (FlagT | FlagI | 0x0F);
+	if (!IsMinimum) CP = Pop16() & 0xFF;
+	PC = Pop16();
+}
+
+void H8_520::OpTrapa(const OPCODE& Op)
+{
+	GenerateException((ExceptionType)(ExceptionType::TrapA0 + Op.Rd));
+}
+
+void H8_520::OpTrapVs(const OPCODE& Op)
+{
+	if (SR & FlagV) GenerateException(ExceptionType::Trap);
+}
+
+void H8_520::OpSleep(const OPCODE& Op)
+{
+	State = CpuState::SLEEP;
+}
+
+void H8_520::OpLink(const OPCODE& Op)
+{
+	Push16(R[6]);
+
+	R[6] = R[7];
+	R[7] = (R[7] + Op.Imm) & 0xFFFF;
+}
+
+void H8_520::OpUnlk(const OPCODE& Op)
+{
+	R[7] = R[6];
+	R[6] = Pop16();
+}
+
+void H8_520::OpLdm(const OPCODE& Op)
+{
+	/* Lowest register from the lowest address */
+	for (uint32_t n = 0; n < 8; n++)
+	{
+		if ((Op.Imm >> n) & 0x01) R[n] = Pop16();
+	}
+}
+
+void H8_520::OpStm(const OPCODE& Op)
+{
+	for (int32_t n = 7; n >= 0; n--)
+	{
+		if ((Op.Imm >> n) & 0x01) Push16(R[n]);
+	}
+}
+
+void H8_520::OpScb(const OPCODE& Op)
+{
+	/* Loop until the condition is met or the counter reaches -1 */
+	if (TestCondition(Op.Rd)) return;
+
+	R[Op.Rn] = (R[Op.Rn] - 1) & 0xFFFF;
+
+	if (R[Op.Rn] != 0xFFFF) Branch(Op.Imm);
+}
+
+void H8_520::OpMovLoad(const OPCODE& Op)
+{
+	uint32_t Data = ReadOperand(Op, EffectiveAddress(Op));
+
+	WriteRegister(Op.Rd, Op.Word, Data);
+	SetNZ(Data, Op.Word);
+}
+
+void H8_520::OpMovStore(const OPCODE& Op)
+{
+	/* The source is read before a pre-decrement */
+	uint32_t Data = ReadRegister(Op.Rd, Op.Word);
+
+	WriteOperand(Op, EffectiveAddress(Op), Data);
+	SetNZ(Data, Op.Word);
+}
+
+void H8_520::OpMovImm(const OPCODE& Op)
+{
+	WriteOperand(Op, EffectiveAddress(Op), Op.Imm);
+	SetNZ(Op.Imm, Op.Word);
+}
+
+void H8_520::OpCmpImm(const OPCODE& Op)
+{
+	Sub(ReadOperand(Op, EffectiveAddress(Op)), Op.Imm, 0, Op.Word, false);
+}
+
+void H8_520::OpAddQ(const OPCODE& Op)
+{
+	uint32_t Address = EffectiveAddress(Op);
+	uint32_t Data = ReadOperand(Op, Address);
+
+	if (Op.Imm > 0) Data = Add(Data, Op.Imm, 0, Op.Word, false);
+	else Data = Sub(Data, -Op.Imm, 0, Op.Word, false);
+
+	WriteOperand(Op, Address, Data);
+}
+
+void H8_520::OpAlu(const OPCODE& Op)
+{
+	uint32_t Src = ReadOperand(Op, EffectiveAddress(Op));
+	uint32_t Dst = ReadRegister(Op.Rd, Op.Word);
+
+	switch (Op.Func)
+	{
+	case 2: /* ADD */
+		WriteRegister(Op.Rd, Op.Word, Add(Dst, Src, 0, Op.Word, false));
+		break;
+
+	case 3: /* SUB */
+		WriteRegister(Op.Rd, Op.Word, Sub(Dst, Src, 0, Op.Word, false));
+		break;
+
+	case 4: /* OR */
+		WriteRegister(Op.Rd, Op.Word, Dst | Src);
+		SetNZ(Dst | Src, Op.Word);
+		break;
+
+	case 5: /* AND */
+		WriteRegister(Op.Rd, Op.Word, Dst & Src);
+		SetNZ(Dst & Src, Op.Word);
+		break;
+
+	case 6: /* XOR */
+		WriteRegister(Op.Rd, Op.Word, Dst ^ Src);
+		SetNZ(Dst ^ Src, Op.Word);
+		break;
+
+	default: /* CMP */
+		Sub(Dst, Src, 0, Op.Word, false);
+		break;
+	}
+}
+
+void H8_520::OpAddSubS(const OPCODE& Op)
+{
+	/* 16-bit register result, byte operands are sign extended, flags are not affected */
+	uint32_t Src = ReadOperand(Op, EffectiveAddress(Op));
+
+	if (!Op.Word) Src = (int8_t)Src;
+
+	R[Op.Rd] = (Op.Func ? (R[Op.Rd] - Src) : (R[Op.Rd] + Src)) & 0xFFFF;
+}
+
+void H8_520::OpAddSubX(const OPCODE& Op)
+{
+	uint32_t Src = ReadOperand(Op, EffectiveAddress(Op));
+	uint32_t Dst = ReadRegister(Op.Rd, Op.Word);
+	uint32_t Carry = SR & FlagC;
+
+	WriteRegister(Op.Rd, Op.Word, Op.Func ? Sub(Dst, Src, Carry, Op.Word, true) : Add(Dst, Src, Carry, Op.Word, true));
+}
+
+void H8_520::OpUnary(const OPCODE& Op)
+{
+	uint32_t Address = EffectiveAddress(Op);
+	uint32_t Data = (Op.Func == 3) ? 0 : ReadOperand(Op, Address);
+
+	switch (Op.Func)
+	{
+	case 3: /* CLR */
+		WriteOperand(Op, Address, 0);
+		SetNZ(0, Op.Word);
+		SR &= ~FlagC;
+		break;
+
+	case 4: /* NEG */
+		WriteOperand(Op, Address, Sub(0, Data, 0, Op.Word, false));
+		break;
+
+	case 5: /* NOT */
+		WriteOperand(Op, Address, ~Data);
+		SetNZ(~Data, Op.Word);
+		break;
+
+	case 6: /* TST */
+		SetNZ(Data, Op.Word);
+		SR &= ~FlagC;
+		break;
+
+	default: /* TAS */
+		SetNZ(Data, 0);
+		SR &= ~FlagC;
+		WriteOperand(Op, Address, Data | 0x80);
+		break;
+	}
+}
+
+void H8_520::OpShift(const OPCODE& Op)
+{
+	uint32_t Mask = Op.Word ? 0xFFFF : 0xFF;
+	uint32_t Sign = Op.Word ? 0x8000 : 0x80;
+
+	uint32_t Address = EffectiveAddress(Op);
+	uint32_t Data = ReadOperand(Op, Address) & Mask;
+	uint32_t Carry = SR & FlagC;
+	uint32_t Result;
+	uint32_t Out;
+
+	switch (Op.Func)
+	{
+	case 0: /* SHAL */
+	case 2: /* SHLL */
+		Out = (Data & Sign) != 0;
+		Result = Data << 1;
+		break;
+
+	case 1: /* SHAR */
+		Out = Data & 0x01;
+		Result = (Data >> 1) | (Data & Sign);
+		break;
+
+	case 3: /* SHLR */
+		Out = Data & 0x01;
+		Result = Data >> 1;
+		break;
+
+	case 4: /* ROTL */
+		Out = (Data & Sign) != 0;
+		Result = (Data << 1) | Out;
+		break;
+
+	case 5: /* ROTR */
+		Out = Data & 0x01;
+		Result = (Data >> 1) | (Out ? Sign : 0);
+		break;
+
+	case 6: /* ROTXL */
+		Out = (Data & Sign) != 0;
+		Result = (Data << 1) | Carry;
+		break;
+
+	default: /* ROTXR */
+		Out = Data & 0x01;
+		Result = (Data >> 1) | (Carry ? Sign : 0);
+		break;
+	}
+
+	Result &= Mask;
+
+	WriteOperand(Op, Address, Result);
+	SetNZ(Result, Op.Word);
+
+	SR = (SR & ~FlagC) | Out;
+
+	/* SHAL: overflow when the sign changed */
+	if ((Op.Func == 0) && ((Data ^ Result) & Sign)) SR |= FlagV;
+}
+
+void H8_520::OpExtend(const OPCODE& Op)
+{
+	uint32_t Data = R[Op.Rd];
+
+	switch (Op.Func)
+	{
+	case 0: /* SWAP */
+		Data = ((Data & 0xFF) << 8) | ((Data >> 8) & 0xFF);
+		break;
+
+	case 1: /* EXTS */
+		Data = (int8_t)(Data & 0xFF) & 0xFFFF;
+		break;
+
+	default: /* EXTU */
+		Data &= 0xFF;
+		break;
+	}
+
+	R[Op.Rd] = Data;
+	SetNZ(Data, 1);
+}
+
+void H8_520::OpBit(const OPCODE& Op)
+{
+	uint32_t Address = EffectiveAddress(Op);
+	uint32_t Data = ReadOperand(Op, Address);
+
+	/* Bit number: immediate or the low bits of Rs */
+	uint32_t Bit = ((Op.Func & 0x04) ? R[Op.Rd] : Op.Rd) & (Op.Word ? 0x0F : 0x07);
+
+	if ((Data >> Bit) & 0x01) SR &= ~FlagZ;
+	else SR |= FlagZ;
+
+	switch (Op.Func & 0x03)
+	{
+	case 0: /* BSET */
+		WriteOperand(Op, Address, Data | (1 << Bit));
+		break;
+
+	case 1: /* BCLR */
+		WriteOperand(Op, Address, Data & ~(1 << Bit));
+		break;
+
+	case 2: /* BNOT */
+		WriteOperand(Op, Address, Data ^ (1 << Bit));
+		break;
+
+	default: /* BTST */
+		break;
+	}
+}
+
+void H8_520::OpControl(const OPCODE& Op)
+{
+	uint32_t Data = ReadControl(Op.Rd);
+
+	switch (Op.Func)
+	{
+	case 4: Data |= Op.Disp; break;		/* ORC */
+	case 5: Data &= Op.Disp; break;		/* ANDC */
+	default: Data ^= Op.Disp; break;	/* XORC */
+	}
+
+	WriteControl(Op.Rd, Data);
+}
+
+void H8_520::OpLdc(const OPCODE& Op)
+{
+	WriteControl(Op.Rd, ReadOperand(Op, EffectiveAddress(Op)));
+}
+
+void H8_520::OpStc(const OPCODE& Op)
+{
+	WriteOperand(Op, EffectiveAddress(Op), ReadControl(Op.Rd));
+}
+
+void H8_520::OpMulxu(const OPCODE& Op)
+{
+	uint32_t Src = ReadOperand(Op, EffectiveAddress(Op));
+	uint32_t Result;
+
+	if (Op.Word) /* Rd:Rd+1 = Rd x <EA> */
+	{
+		Result = R[Op.Rd] * Src;
+
+		R[Op.Rd] = Result >> 16;
+		R[Op.Rd + 1] = Result & 0xFFFF;
+	}
+	else /* Rd = Rd (low byte) x <EA> */
+	{
+		Result = (R[Op.Rd] & 0xFF) * Src;
+
+		R[Op.Rd] = Result;
+		Result <<= 16; /* Flags from the 16-bit result */
+	}
+
+	SR &= ~(FlagN | FlagZ | FlagV | FlagC);
+
+	if (Result & 0x80000000) SR |= FlagN;
+	if (Result == 0) SR |= FlagZ;
+}
+
+void H8_520::OpDivxu(const OPCODE& Op)
+{
+	uint32_t Src = ReadOperand(Op, EffectiveAddress(Op));
+
+	if (Src == 0)
+	{
+		GenerateException(ExceptionType::DivideByZero);
+		return;
+	}
+
+	uint32_t Dividend = Op.Word ? ((R[Op.Rd] << 16) | R[Op.Rd + 1]) : R[Op.Rd];
+	uint32_t Quotient = Dividend / Src;
+	uint32_t Remainder = Dividend % Src;
+
+	SR &= ~(FlagN | FlagZ | FlagV | FlagC);
+
+	/* Quotient overflow: the operands are not changed */
+	if (Quotient > (Op.Word ? 0xFFFFu : 0xFFu))
+	{
+		SR |= FlagV;
+		return;
+	}
+
+	if (Op.Word) /* Rd = remainder, Rd+1 = quotient */
+	{
+		R[Op.Rd] = Remainder;
+		R[Op.Rd + 1] = Quotient;
+	}
+	else /* Rd = remainder (high byte), quotient (low byte) */
+	{
+		R[Op.Rd] = (Remainder << 8) | Quotient;
+	}
+
+	if (Quotient & (Op.Word ? 0x8000 : 0x80)) SR |= FlagN;
+	if (Quotient == 0) SR |= FlagZ;
+}
+
+void H8_520::OpXch(const OPCODE& Op)
+{
+	std::swap(R[Op.Rn], R[Op.Rd]);
+}
+
+void H8_520::OpDecimal(const OPCODE& Op)
+{
+	auto FromBCD = [](uint32_t Data) { return ((Data >> 4) & 0x0F) * 10 + (Data & 0x0F); };
+
+	int32_t Src = FromBCD(R[Op.Rn] & 0xFF);
+	int32_t Dst = FromBCD(R[Op.Rd] & 0xFF);
+	int32_t Carry = SR & FlagC;
+
+	int32_t Result = Op.Func ? (Dst - Src - Carry) : (Dst + Src + Carry);
+
+	SR &= ~FlagC;
+
+	if (Result < 0) { Result += 100; SR |= FlagC; }
+	if (Result > 99) { Result -= 100; SR |= FlagC; }
+
+	/* Like ADDX / SUBX, Z is only cleared */
+	if (Result != 0) SR &= ~FlagZ;
+
+	R[Op.Rd] = (R[Op.Rd] & 0xFF00) | ((Result / 10) << 4) | (Result % 10);
+}
+
+void H8_520::SaveState(StateWriter& Writer)
+{
+	Writer.BeginChunk("H852", 2);
+
+	Writer.Write(R);
+	Writer.Write(PC);
+	Writer.Write(SR);
+	Writer.Write(CP);
+	Writer.Write(DP);
+	Writer.Write(EP);
+	Writer.Write(TP);
+	Writer.Write(BR);
+	Writer.Write(MDCR);
+	Writer.Write(AddrMask);
+	Writer.Write(IsMinimum);
+	Writer.Write(IsExpanded);
+	Writer.Write(HasOnchipROM);
+	Writer.Write(State);
+	Writer.Write(ResetPin);
+	Writer.Write(ModePins);
+	Writer.Write(CycleBalance);
+	Writer.Write(OnchipRAM);
+
+	Writer.EndChunk();
+}
+
+bool H8_520::LoadState(StateReader& Reader)
+{
+	if (!Reader.BeginChunk("H852", 2)) return false;
+
+	Reader.Read(R);
+	Reader.Read(PC);
+	Reader.Read(SR);
+	Reader.Read(CP);
+	Reader.Read(DP);
+	Reader.Read(EP);
+	Reader.Read(TP);
+	Reader.Read(BR);
+	Reader.Read(MDCR);
+	Reader.Read(AddrMask);
+	Reader.Read(IsMinimum);
+	Reader.Read(IsExpanded);
+	Reader.Read(HasOnchipROM);
+	Reader.Read(State);
+	Reader.Read(ResetPin);
+	Reader.Read(ModePins);
+	Reader.Read(CycleBalance);
+	Reader.Read(OnchipRAM);
+
+	/* The decoded instructions belong to the previous memory contents */
+	BuildMemoryMap();
+	FlushCache();
+
+	return Reader.EndChunk();
+}
@@ -15,9 +15,11 @@ See LICENSE.txt in the root directory of this source tree.
 #define _H8_520_H_
 
 #include "../../TritonCore.h"
+#include "../../Interfaces/IMemoryAccess.h"
+#include "../../Interfaces/IStateAccess.h"
 
 /* Hitachi H8/520 */
-class H8_520
+class H8_520 : public IMemoryAccess, public IStateAccess
 {
 public:
 	enum CpuState : uint32_t
@@ -85,6 +87,12 @@ public:
 		TrapA15
 	};
 
+	/* Memory IDs (see IMemoryAccess) */
+	enum MemoryID : uint32_t
+	{
+		ROM	/* 16KB on-chip ROM */
+	};
+
 	H8_520();
 	~H8_520() = default;
 
@@ -92,11 +100,68 @@ public:
 	void SetOperatingMode(McuMode NewMode);
 	void SetResetPinState(PinState NewState);
 	void GenerateException(ExceptionType Type);
-	void Execute();
+
+	/* Run for a budget of states (clock cycles), returns the number of states executed. The last
+	   instruction can exceed the budget, the overrun is taken from the next budget */
+	uint32_t Execute(uint32_t Cycles);
+
+	/* External address space (expanded modes), Start and Size must be aligned to 128 bytes. The
+	   on-chip ROM, RAM and registers take priority over the external pages */
+	void MapExternal(uint32_t Start, uint32_t Size, uint8_t* Data, bool Writable);
+	void MapExternal(uint32_t Start, uint32_t Size, TC::MemoryMap::read_t Read, TC::MemoryMap::write_t Write);
+	void UnmapExternal(uint32_t Start, uint32_t Size);
+
+	/* IMemoryAccess methods */
+	void CopyToMemory(uint32_t MemoryID, size_t Offset, uint8_t* Data, size_t Size);
+	void CopyToMemoryIndirect(uint32_t MemoryID, size_t Offset, uint8_t* Data, size_t Size);
+	size_t GetMemorySize(uint32_t MemoryID);
+	size_t GetResidentSize();
+
+	/* IStateAccess methods */
+	void SaveState(StateWriter& Writer);
+	bool LoadState(StateReader& Reader);
 
 private:
 	static const std::wstring s_DeviceName;
 
+	/* Addressing modes */
+	enum EaMode : uint8_t
+	{
+		EA_NONE,	/* No effective address (short format) */
+		EA_REG,		/* Rn */
+		EA_PREDEC,	/* @-Rn */
+		EA_POSTINC,	/* @Rn+ */
+		EA_IND,		/* @Rn */
+		EA_DISP,	/* @(d:8,Rn) / @(d:16,Rn) */
+		EA_ABS8,	/* @aa:8 (BR supplies the upper 8 bits) */
+		EA_ABS16,	/* @aa:16 */
+		EA_IMM		/* #xx:8 / #xx:16 */
+	};
+
+	/* Pre-decoded instruction */
+	struct OPCODE
+	{
+		uint32_t	Tag;		/* CP:PC of the instruction, ~0 = empty */
+		uint8_t		Handler;	/* Dispatch table index */
+		uint8_t		Length;		/* Instruction length (bytes) */
+		uint8_t		States;		/* Execution states */
+		uint8_t		EA;			/* Addressing mode (see EaMode) */
+		uint8_t		Word;		/* Operand size (0 = byte, 1 = word) */
+		uint8_t		Rn;			/* EA register */
+		uint8_t		Rd;			/* Register / control register / bit / condition field */
+		uint8_t		Func;		/* Sub-operation (ALU function, shift type, ...) */
+		int32_t		Disp;		/* EA displacement, absolute address or immediate data */
+		int32_t		Imm;		/* Operation immediate data or branch displacement */
+	};
+
+	using handler_t = void (H8_520::*)(const OPCODE& Op);
+
+	static constexpr uint32_t CacheSize = 4096;	/* Decoded instructions (direct mapped) */
+	static constexpr uint32_t MaxLength = 6;	/* Longest instruction (bytes) */
+	static constexpr uint32_t AddressBits = 20;	/* Maximum mode address space */
+	static constexpr uint32_t PageBits = 7;	/* 128B pages (on-chip RAM and registers are 128B aligned) */
+	static const handler_t s_Handlers[];
+
 	uint32_t	R[8];		/* General Registers (16-bit) */
 	uint32_t	PC;			/* Program Counter (16-bit) */
 	uint32_t	SR;			/* Status Register (16-bit) */
@@ -117,11 +182,92 @@ private:
 	PinState	ResetPin;	/* /RES pin */
 	uint32_t	ModePins;	/* MD0, MD1 and MD2 pin states */
 
+	int32_t		CycleBalance;	/* States left in the budget (negative = overrun) */
+
 	std::array<uint8_t, 512>	OnchipRAM;	/* 512B on-chip RAM */
 	std::array<uint8_t, 16384>	OnchipROM;	/* 16KB on-chip ROM */
 
+	TC::MemoryMap	Bus;		/* Memory map of the current operating mode */
+	TC::MemoryMap	External;	/* External address space, as attached by the host */
+
+	std::vector<OPCODE>	Cache;	/* Decoded instructions, keyed by CP:PC (not part of the state) */
+
 	uint8_t		Read8(uint32_t Address);
 	uint16_t	Read16(uint32_t Address);
+	void		Write8(uint32_t Address, uint8_t Data);
+	void		Write16(uint32_t Address, uint16_t Data);
+
+	/* Memory map */
+	void		BuildMemoryMap();
+	uint8_t		ReadIO(uint32_t Address);
+	void		WriteIO(uint32_t Address, uint8_t Data);
+
+	/* Instruction cache */
+	const OPCODE&	Fetch();
+	void		Decode(uint32_t Address, OPCODE& Op);
+	void		DecodeGeneral(uint32_t Address, OPCODE& Op);
+	void		FlushCache();
+	void		InvalidateCache(uint32_t Address);
+
+	/* Addressing */
+	uint32_t	CodeAddress(uint32_t Offset) const;
+	uint32_t	DataAddress(uint32_t Rn, uint32_t Offset) const;
+	uint32_t	EffectiveAddress(const OPCODE& Op);
+	uint32_t	ReadOperand(const OPCODE& Op, uint32_t Address);
+	void		WriteOperand(const OPCODE& Op, uint32_t Address, uint32_t Data);
+	uint32_t	ReadRegister(uint32_t Rn, uint32_t Word) const;
+	void		WriteRegister(uint32_t Rn, uint32_t Word, uint32_t Data);
+	uint32_t	ReadControl(uint32_t Cr) const;
+	void		WriteControl(uint32_t Cr, uint32_t Data);
+	void		Push16(uint16_t Data);
+	uint16_t	Pop16();
+
+	/* Status register */
+	bool		TestCondition(uint32_t Cc) const;
+	void		SetNZ(uint32_t Result, uint32_t Word);
+	uint32_t	Add(uint32_t A, uint32_t B, uint32_t Carry, uint32_t Word, bool Extended);
+	uint32_t	Sub(uint32_t A, uint32_t B, uint32_t Carry, uint32_t Word, bool Extended);
+	void		Branch(int32_t Disp);
+
+	/* Instruction handlers (see s_Handlers) */
+	void		OpInvalid(const OPCODE& Op);
+	void		OpNop(const OPCODE& Op);
+	void		OpBcc(const OPCODE& Op);
+	void		OpBsr(const OPCODE& Op);
+	void		OpJmp(const OPCODE& Op);
+	void		OpJsr(const OPCODE& Op);
+	void		OpPjmp(const OPCODE& Op);
+	void		OpPjsr(const OPCODE& Op);
+	void		OpRts(const OPCODE& Op);
+	void		OpPrts(const OPCODE& Op);
+	void		OpRte(const OPCODE& Op);
+	void		OpTrapa(const OPCODE& Op);
+	void		OpTrapVs(const OPCODE& Op);
+	void		OpSleep(const OPCODE& Op);
+	void		OpLink(const OPCODE& Op);
+	void		OpUnlk(const OPCODE& Op);
+	void		OpLdm(const OPCODE& Op);
+	void		OpStm(const OPCODE& Op);
+	void		OpScb(const OPCODE& Op);
+	void		OpMovLoad(const OPCODE& Op);
+	void		OpMovStore(const OPCODE& Op);
+	void		OpMovImm(const OPCODE& Op);
+	void		OpCmpImm(const OPCODE& Op);
+	void		OpAddQ(const OPCODE& Op);
+	void		OpAlu(const OPCODE& Op);
+	void		OpAddSubS(const OPCODE& Op);
+	void		OpAddSubX(const OPCODE& Op);
+	void		OpUnary(const OPCODE& Op);
+	void		OpShift(const OPCODE& Op);
+	void		OpExtend(const OPCODE& Op);
+	void		OpBit(const OPCODE& Op);
+	void		OpControl(const OPCODE& Op);
+	void		OpLdc(const OPCODE& Op);
+	void		OpStc(const OPCODE& Op);
+	void		OpMulxu(const OPCODE& Op);
+	void		OpDivxu(const OPCODE& Op);
+	void		OpXch(const OPCODE& Op);
+	void		OpDecimal(const OPCODE& Op);
 };
 
 #endif // !_H8_520_H_
\ No newline at end of file
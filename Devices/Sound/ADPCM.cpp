@@ -15,7 +15,7 @@ See LICENSE.txt in the root directory of this source tree.
 
 namespace Shared
 {
-	static const int16_t DeltaTable[16] =
+	static constexpr int16_t DeltaTable[16] =
 	{
 		/*
 			Delta = 2 * (Nibble & 0x7) + 1
@@ -35,34 +35,29 @@ namespace OKI::ADPCM
 
 	*/
 	
-	static int16_t DiffTable[49 * 16];
-
-	void InitDecoder()
+	static constexpr auto DiffTable = []
 	{
-		static bool Initialized = false;
+		std::array<int16_t, 49 * 16> Table{};
 
-		if (!Initialized)
+		const int16_t SizeTable[49] =
 		{
-			const int16_t SizeTable[49] =
-			{
-				16, 17, 19, 21, 23, 25, 28, 31, 34, 37, 41, 45,
-				50, 55, 60, 66, 73, 80, 88, 97, 107, 118, 130, 143,
-				157, 173, 190, 209, 230, 253, 279, 307, 337, 371, 408, 449,
-				494, 544, 598, 658, 724, 796, 876, 963, 1060, 1166, 1282, 1411, 1552
-			};
+			16, 17, 19, 21, 23, 25, 28, 31, 34, 37, 41, 45,
+			50, 55, 60, 66, 73, 80, 88, 97, 107, 118, 130, 143,
+			157, 173, 190, 209, 230, 253, 279, 307, 337, 371, 408, 449,
+			494, 544, 598, 658, 724, 796, 876, 963, 1060, 1166, 1282, 1411, 1552
+		};
 
-			for (auto Step = 0; Step < 49; Step++)
+		for (auto Step = 0; Step < 49; Step++)
+		{
+			for (auto Nibble = 0; Nibble < 16; Nibble++)
 			{
-				for (auto Nibble = 0; Nibble < 16; Nibble++)
-				{
-					auto Diff = (Shared::DeltaTable[Nibble] * SizeTable[Step]) / 8;
-					DiffTable[(Step * 16) | Nibble] = Diff;
-				}
+				auto Diff = (Shared::DeltaTable[Nibble] * SizeTable[Step]) / 8;
+				Table[(Step * 16) | Nibble] = Diff;
 			}
-
-			Initialized = true;
 		}
-	}
+
+		return Table;
+	}();
 
 	void Decode(uint8_t Nibble, int32_t* pStep, int16_t* pSignal)
 	{
@@ -94,34 +89,29 @@ namespace YM::ADPCMA
 
 	*/
 	
-	static int16_t DiffTable[49 * 16];
-
-	void InitDecoder()
+	static constexpr auto DiffTable = []
 	{
-		static bool Initialized = false;
+		std::array<int16_t, 49 * 16> Table{};
 
-		if (!Initialized)
+		const int16_t SizeTable[49] =
 		{
-			const int16_t SizeTable[49] =
-			{
-				16, 17, 19, 21, 23, 25, 28, 31, 34, 37, 41, 45,
-				50, 55, 60, 66, 73, 80, 88, 97, 107, 118, 130, 143,
-				157, 173, 190, 209, 230, 253, 279, 307, 337, 371, 408, 449,
-				494, 544, 598, 658, 724, 796, 876, 963, 1060, 1166, 1282, 1411, 1552
-			};
+			16, 17, 19, 21, 23, 25, 28, 31, 34, 37, 41, 45,
+			50, 55, 60, 66, 73, 80, 88, 97, 107, 118, 130, 143,
+			157, 173, 190, 209, 230, 253, 279, 307, 337, 371, 408, 449,
+			494, 544, 598, 658, 724, 796, 876, 963, 1060, 1166, 1282, 1411, 1552
+		};
 
-			for (auto Step = 0; Step < 49; Step++)
+		for (auto Step = 0; Step < 49; Step++)
+		{
+			for (auto Nibble = 0; Nibble < 16; Nibble++)
 			{
-				for (auto Nibble = 0; Nibble < 16; Nibble++)
-				{
-					auto Diff = (Shared::DeltaTable[Nibble] * SizeTable[Step]) / 8;
-					DiffTable[(Step * 16) | Nibble] = Diff << 4; /* 12 to 16-bit */
-				}
+				auto Diff = (Shared::DeltaTable[Nibble] * SizeTable[Step]) / 8;
+				Table[(Step * 16) | Nibble] = Diff << 4; /* 12 to 16-bit */
 			}
-
-			Initialized = true;
 		}
-	}
+
+		return Table;
+	}();
 
 	void Decode(uint8_t Nibble, int32_t* pStep, int16_t* pSignal)
 	{
@@ -14,22 +14,23 @@ See LICENSE.txt in the root directory of this source tree.
 #ifndef _ADPCM_H_
 #define _ADPCM_H_
 
+#include <unordered_map>
+
 #include "../../TritonCore.h"
 
+/* Decoded sample caching is enabled unless TC_ADPCM_CACHE is set to 0 */
+#ifndef TC_ADPCM_CACHE
+#define TC_ADPCM_CACHE 1
+#endif
+
 namespace OKI::ADPCM
 {
-	/* Initialize the Dialogic ADPCM decoder */
-	void InitDecoder();
-	
 	/* Decode a nibble */
 	void Decode(uint8_t Nibble, int32_t* pStep, int16_t* pSignal);
 }
 
 namespace YM::ADPCMA
 {
-	/* Initialize the Yamaha ADPCM-A decoder */
-	void InitDecoder();
-	
 	/* Decode a nibble */
 	void Decode(uint8_t Nibble, int32_t* pStep, int16_t* pSignal);
 }
@@ -46,4 +47,105 @@ namespace YM::ADPCMZ
 	void Decode(uint8_t Nibble, int32_t* pStep, int16_t* pSignal);
 }
 
+/* Decoded sample cache
+   A sample always starts from the same decoder state (step 0, signal 0), so as long as
+   the memory doesn't change the decoded signal from a start address never changes either.
+   The cache stores the signal and decoder step after every nibble, a sample is filled while
+   it is played for the first time. A channel can leave the cached data at any point (eg. when
+   the cache is full) and continue decoding from memory. Samples stay valid until the cache is cleared */
+class ADPCMCache
+{
+public:
+	static constexpr bool Enabled = (TC_ADPCM_CACHE != 0);
+
+	static constexpr size_t MaxNibbles = 1 << 22;	/* Nibbles per sample */
+	static constexpr size_t MaxSize = 1 << 24;		/* Nibbles in total */
+
+	using decoder_t = void (*)(uint8_t Nibble, int32_t* pStep, int16_t* pSignal);
+
+	struct sample_t
+	{
+		uint32_t				Start;	/* Start address (byte) */
+		std::vector<int16_t>	Signal;	/* Decoded signal per nibble */
+		std::vector<uint16_t>	Step;	/* Decoder step per nibble */
+	};
+
+	ADPCMCache(decoder_t Decoder) :
+		m_Decoder(Decoder),
+		m_Size(0)
+	{
+	}
+
+	ADPCMCache(const ADPCMCache&) = delete;
+	ADPCMCache& operator=(const ADPCMCache&) = delete;
+
+	/* Forget all decoded samples, any sample pointer handed out becomes invalid */
+	void Clear()
+	{
+		m_Samples.clear();
+		m_Size = 0;
+	}
+
+	/* Get the sample starting at byte address Start (high nibble first), nullptr if caching is disabled */
+	sample_t* Get(uint32_t Start)
+	{
+		if constexpr (!Enabled) return nullptr;
+
+		auto& Sample = m_Samples[Start];
+		Sample.Start = Start;
+
+		return &Sample;
+	}
+
+	/* Decode the nibble at byte address Address (NibbleShift: 4 = high, 0 = low nibble) through the sample,
+	   Read(Address) returns a memory byte. Nibbles are decoded in order, returns false if the nibble is not
+	   (and can't be) cached, the decoder state is left untouched then */
+	template<typename F>
+	inline bool Fetch(sample_t* Sample, uint32_t Address, uint32_t NibbleShift, int32_t* pStep, int16_t* pSignal, F&& Read)
+	{
+		if (Sample == nullptr) return false;
+
+		size_t Pos = ((size_t)(Address - Sample->Start) << 1) | (NibbleShift ? 0 : 1);
+
+		if (Pos >= Sample->Signal.size())
+		{
+			/* Extend the sample by the next nibble */
+			if ((Pos != Sample->Signal.size()) || (Pos >= MaxNibbles) || (m_Size >= MaxSize)) return false;
+
+			int32_t Step = (Pos != 0) ? Sample->Step[Pos - 1] : 0;
+			int16_t Signal = (Pos != 0) ? Sample->Signal[Pos - 1] : 0;
+
+			m_Decoder((Read(Address) >> NibbleShift) & 0x0F, &Step, &Signal);
+
+			Sample->Signal.push_back(Signal);
+			Sample->Step.push_back((uint16_t)Step);
+			m_Size++;
+		}
+
+		*pSignal = Sample->Signal[Pos];
+		*pStep = Sample->Step[Pos];
+
+		return true;
+	}
+
+	/* Heap memory held by the decoded samples (hash table overhead is approximated) */
+	size_t GetResidentSize() const
+	{
+		size_t Size = m_Samples.bucket_count() * sizeof(void*);
+
+		for (auto& [Start, Sample] : m_Samples)
+		{
+			Size += sizeof(std::pair<const uint32_t, sample_t>) + sizeof(void*);
+			Size += Sample.Signal.capacity() * sizeof(int16_t) + Sample.Step.capacity() * sizeof(uint16_t);
+		}
+
+		return Size;
+	}
+
+private:
+	decoder_t								m_Decoder;
+	size_t									m_Size;		/* Cached nibbles */
+	std::unordered_map<uint32_t, sample_t>	m_Samples;
+};
+
 #endif // !_ADPCM_H_
\ No newline at end of file
@@ -14,6 +14,7 @@ See LICENSE.txt in the root directory of this source tree.
 #ifndef _AY_H_
 #define _AY_H_
 
+#include <algorithm>
 #include <cstdint>
 
 namespace AY /* AY8910 family / clones */
@@ -63,8 +64,18 @@ namespace AY /* AY8910 family / clones */
 		uint8_t		Register[16];
 	};
 
+	/* Number of tone channels with tone or noise output and a non-zero (or envelope) amplitude */
+	inline uint32_t ActiveTones(const tone_t (&Tone)[3])
+	{
+		uint32_t Count = 0;
+
+		for (auto& Chan : Tone) Count += ((Chan.ToneDisable & Chan.NoiseDisable) == 0) && (Chan.AmpCtrl || Chan.Amplitude != 0);
+
+		return Count;
+	}
+
 	/* Mask table for unused / undefined register bits (AY only) */
-	static const uint32_t Mask[16] =
+	inline constexpr uint32_t Mask[16] =
 	{
 		0xFF, 0x0F, 0xFF, 0x0F, 0xFF, 0x0F, 0x1F, 0xFF, 0x1F, 0x1F, 0x1F, 0xFF, 0xFF, 0x0F, 0xFF, 0xFF
 	};
@@ -73,7 +84,7 @@ namespace AY /* AY8910 family / clones */
 	constexpr int16_t DCOffset02V = (int16_t)(double)((0.2) * (32767.f / 5.f));
 	
 	/* Amplitude table (AY variants) */
-	static const int16_t Amplitude16[16] =
+	inline constexpr int16_t Amplitude16[16] =
 	{
 		/*	AY-3-8910 output measurements:
 			https://github.com/michelgerritse/YM-research/blob/main/AY8910%20-%20Output.xlsx
@@ -88,7 +99,7 @@ namespace AY /* AY8910 family / clones */
 	};
 
 	/* Amplitude table (YM variants) */
-	static const int16_t Amplitude32[32] =
+	inline constexpr int16_t Amplitude32[32] =
 	{
 		/*	YM2149 output measurements:
 			https://github.com/michelgerritse/YM-research/blob/main/AY8910%20-%20Output.xlsx
@@ -105,7 +116,7 @@ namespace AY /* AY8910 family / clones */
 	};
 
 	/* Map 4-bit amplitude level to 5-bit (YM only) */
-	static const uint32_t MapLvl4to5[16] =
+	inline constexpr uint32_t MapLvl4to5[16] =
 	{
 		/*
 			We assume:
@@ -125,6 +136,102 @@ namespace AY /* AY8910 family / clones */
 		0, 3, 5, 7, 9, 11, 13, 15, 17, 19, 21, 23, 25, 27, 29, 31
 	};
 
+	/* Update the envelope, noise and tone generators for one sample (OPN chips) */
+	inline void UpdateGenerators(ssg_t& SSG)
+	{
+		/* Update envelope generator */
+		if ((SSG.Envelope.Counter += 2) >= SSG.Envelope.Period.u32) //FIXME: should be += 1
+		{
+			/* Reset counter */
+			SSG.Envelope.Counter = 0;
+
+			/* Count down step counter (31 -> 0) */
+			SSG.Envelope.Step -= SSG.Envelope.StepDec;
+
+			if (SSG.Envelope.Step & 32) /* Envelope cycle completed */
+			{
+				/* Restart cycle */
+				SSG.Envelope.Step = 31;
+
+				/* Stop counting (if needed) */
+				SSG.Envelope.StepDec = SSG.Envelope.Hld ^ 1;
+
+				/* Toggle output inversion */
+				SSG.Envelope.Inv ^= SSG.Envelope.Alt;
+			}
+
+			/* Apply output inversion and lookup amplitude */
+			SSG.Envelope.Amplitude = AY::Amplitude32[SSG.Envelope.Step ^ SSG.Envelope.Inv];
+		}
+
+		/* Update noise generator */
+		if (SSG.Noise.Prescaler ^= 1)
+		{
+			if ((SSG.Noise.Counter += 2) >= SSG.Noise.Period) //FIXME: should be += 1
+			{
+				/* Reset counter */
+				SSG.Noise.Counter = 0;
+
+				/* Update output flag */
+				SSG.Noise.Output = SSG.Noise.LFSR & 1;
+
+				/* Tap bits 3 and 0 (XOR feedback) */
+				uint32_t Seed = ((SSG.Noise.LFSR >> 3) ^ (SSG.Noise.LFSR >> 0)) & 1;
+
+				/* Shift LFSR and apply seed (17-bit wide) */
+				SSG.Noise.LFSR = (SSG.Noise.LFSR >> 1) | (Seed << 16);
+			}
+		}
+
+		/* Update tone generators */
+		for (auto i = 0; i < 3; i++)
+		{
+			auto& Tone = SSG.Tone[i];
+
+			if ((Tone.Counter += 2) >= Tone.Period.u32) //FIXME: should be += 1
+			{
+				/* Reset counter */
+				Tone.Counter = 0;
+
+				/* Toggle output flag */
+				Tone.Output ^= 1;
+			}
+		}
+	}
+
+	/* Output of one tone generator, tone and noise mixed (implemented as a mask) with amplitude control */
+	inline int16_t ToneOutput(const ssg_t& SSG, const tone_t& Tone)
+	{
+		uint32_t Mask = ~(((Tone.Output | Tone.ToneDisable) & (SSG.Noise.Output | Tone.NoiseDisable)) - 1);
+
+		return (Tone.AmpCtrl ? SSG.Envelope.Amplitude : Tone.Amplitude) & Mask;
+	}
+
+	/* SSG part of a mixed OPN output: runs the SSG samples that fall within one OPN sample of Cycles
+	   clock cycles (Divider = clock cycles per SSG sample, CyclesToDo carries the remainder, so the
+	   rate ratio is exact) and averages them. ToneOut receives the 16-bit average of every tone (muted
+	   tones are 0), returns the 16-bit average of the tone mix */
+	inline int16_t UpdateMixed(ssg_t& SSG, uint32_t& CyclesToDo, uint32_t Cycles, uint32_t Divider, uint32_t Muted, int16_t* ToneOut)
+	{
+		int32_t Sum[3] = { 0, 0, 0 };
+		int32_t Count = 0;
+
+		for (CyclesToDo += Cycles; CyclesToDo >= Divider; CyclesToDo -= Divider, Count++)
+		{
+			UpdateGenerators(SSG);
+
+			for (uint32_t i = 0; i < 3; i++)
+			{
+				if (((Muted >> i) & 1) == 0) Sum[i] += ToneOutput(SSG, SSG.Tone[i]);
+			}
+		}
+
+		Count = std::max(Count, 1);
+
+		for (uint32_t i = 0; i < 3; i++) ToneOut[i] = (int16_t)((Sum[i] / Count) >> 1);
+
+		return (int16_t)(((Sum[0] + Sum[1] + Sum[2]) / Count) >> 1);
+	}
 
 /* Test code to validate the envelope generator output for all possible shapes
 #include <cstdio>
@@ -33,6 +33,9 @@ void AY8910::Reset(ResetType Type)
 {
 	m_CyclesToDo = 0;
 
+	/* Clear the band-limited output history */
+	for (auto& Synth : m_SynthSSG) Synth.Clear();
+
 	/* Clear register array (initial state is 0 for all registers) */
 	m_Register.fill(0);
 
@@ -67,24 +70,24 @@ bool AY8910::EnumAudioOutputs(uint32_t OutputNr, AUDIO_OUTPUT_DESC& Desc)
 	switch (OutputNr)
 	{
 		case 0: /* Channel A */
-			Desc.SampleRate = m_ClockSpeed / m_ClockDivider;
-			Desc.SampleFormat = 0;
+			Desc.SampleRate = m_SynthSSG[0].GetSampleRate(m_ClockSpeed / m_ClockDivider);
+			Desc.SampleFormat = AudioFormat::AUDIO_FMT_S16;
 			Desc.Channels = 1;
 			Desc.ChannelMask = SPEAKER_FRONT_CENTER;
 			Desc.Description = L"Channel A";
 			break;
 
 		case 1: /* Channel B */
-			Desc.SampleRate = m_ClockSpeed / m_ClockDivider;
-			Desc.SampleFormat = 0;
+			Desc.SampleRate = m_SynthSSG[1].GetSampleRate(m_ClockSpeed / m_ClockDivider);
+			Desc.SampleFormat = AudioFormat::AUDIO_FMT_S16;
 			Desc.Channels = 1;
 			Desc.ChannelMask = SPEAKER_FRONT_CENTER;
 			Desc.Description = L"Channel B";
 			break;
 
 		case 2: /* Channel C */
-			Desc.SampleRate = m_ClockSpeed / m_ClockDivider;
-			Desc.SampleFormat = 0;
+			Desc.SampleRate = m_SynthSSG[2].GetSampleRate(m_ClockSpeed / m_ClockDivider);
+			Desc.SampleFormat = AudioFormat::AUDIO_FMT_S16;
 			Desc.Channels = 1;
 			Desc.ChannelMask = SPEAKER_FRONT_CENTER;
 			Desc.Description = L"Channel C";
@@ -107,6 +110,20 @@ uint32_t AY8910::GetClockSpeed()
 	return m_ClockSpeed;
 }
 
+bool AY8910::GetStats(TC::StatsSnapshot& Stats)
+{
+	return m_Stats.Get(Stats);
+}
+
+bool AY8910::SetOutputRate(uint32_t OutputNr, uint32_t SampleRate)
+{
+	if (OutputNr >= 3) return false;
+
+	m_SynthSSG[OutputNr].SetRates(m_ClockSpeed / m_ClockDivider, SampleRate);
+
+	return true;
+}
+
 void AY8910::Write(uint32_t Address, uint32_t Data)
 {
 	Address &= 0x0F;
@@ -114,6 +131,8 @@ void AY8910::Write(uint32_t Address, uint32_t Data)
 
 	m_Register[Address] = Data;
 
+	m_Stats.RegisterWrite(Address);
+
 	switch (Address)
 	{
 		case 0x00: /* Channel A Tone Period (Fine Tune) */
@@ -220,6 +239,13 @@ void AY8910::Update(uint32_t ClockCycles, std::vector<IAudioBuffer*>& OutBuffer)
 	uint32_t Samples = TotalCycles / m_ClockDivider;
 	m_CyclesToDo = TotalCycles % m_ClockDivider;
 
+	TC::DeviceStats::UpdateScope Stats(m_Stats, Samples);
+
+	AudioBlock<int16_t> Block[3] = { OutBuffer[0], OutBuffer[1], OutBuffer[2] };
+
+	/* Follow clock and prescaler changes */
+	for (auto& Synth : m_SynthSSG) Synth.SetInputRate(m_ClockSpeed / m_ClockDivider);
+
 	int16_t Out;
 	uint32_t Mask;
 
@@ -293,7 +319,51 @@ void AY8910::Update(uint32_t ClockCycles, std::vector<IAudioBuffer*>& OutBuffer)
 			Out = Tone.AmpCtrl ? m_Envelope.Amplitude : Tone.Amplitude;
 			
 			/* 16-bit output */
-			OutBuffer[i]->WriteSampleS16(Out & Mask);
+			m_SynthSSG[i].Write(Out & Mask, Block[i]);
 		}
 	}
+
+	/* Output the completed band-limited samples */
+	for (auto i = 0; i < 3; i++) m_SynthSSG[i].Flush(Block[i]);
+
+	Stats.ActiveVoices([&] { return AY::ActiveTones(m_Tone); });
+}
+
+bool AY8910::IsSilent()
+{
+	return AY::ActiveTones(m_Tone) == 0;
+}
+
+uint32_t AY8910::GetCyclesForFrames(uint32_t OutputNr, uint32_t Frames)
+{
+	/* Band-limited outputs are rendered at the output rate */
+	if ((OutputNr >= 3) || m_SynthSSG[OutputNr].IsEnabled()) return 0;
+
+	return CyclesForFrames(Frames, m_ClockDivider, m_CyclesToDo);
+}
+
+void AY8910::SaveState(StateWriter& State)
+{
+	State.BeginChunk("8910", 1);
+
+	State.Write(m_Tone);
+	State.Write(m_Noise);
+	State.Write(m_Envelope);
+	State.Write(m_Register);
+	State.Write(m_CyclesToDo);
+
+	State.EndChunk();
+}
+
+bool AY8910::LoadState(StateReader& State)
+{
+	if (!State.BeginChunk("8910", 1)) return false;
+
+	State.Read(m_Tone);
+	State.Read(m_Noise);
+	State.Read(m_Envelope);
+	State.Read(m_Register);
+	State.Read(m_CyclesToDo);
+
+	return State.EndChunk();
 }
\ No newline at end of file
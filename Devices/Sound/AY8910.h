@@ -15,10 +15,12 @@ See LICENSE.txt in the root directory of this source tree.
 #define _AY8910_H_
 
 #include "../../Interfaces/ISoundDevice.h"
+#include "../../Interfaces/IStateAccess.h"
 #include "AY.h"
+#include "../../Core/BandLimited.h"
 
 /* General Instrument AY-3-8910 */
-class AY8910 : public ISoundDevice
+class AY8910 : public ISoundDevice, public IStateAccess
 {
 public:
 	AY8910(uint32_t ClockSpeed = 2'000'000);
@@ -35,6 +37,14 @@ public:
 	uint32_t		GetClockSpeed();
 	void			Write(uint32_t Address, uint32_t Data);
 	void			Update(uint32_t ClockCycles, std::vector<IAudioBuffer*>& OutBuffer);
+	bool			IsSilent();
+	uint32_t		GetCyclesForFrames(uint32_t OutputNr, uint32_t Frames);
+	bool			GetStats(TC::StatsSnapshot& Stats);
+	bool			SetOutputRate(uint32_t OutputNr, uint32_t SampleRate);
+
+	/* IStateAccess methods */
+	void			SaveState(StateWriter& State);
+	bool			LoadState(StateReader& State);
 
 private:
 	AY::tone_t		m_Tone[3];
@@ -46,6 +56,9 @@ private:
 	uint32_t	m_ClockSpeed;
 	uint32_t	m_ClockDivider;
 	uint32_t	m_CyclesToDo;
+	TC::DeviceStats	m_Stats;
+
+	TC::BandLimitedSynth m_SynthSSG[3]; /* SSG output rate synthesis (not part of the state) */
 };
 
 #endif // !_AY8910_H_
\ No newline at end of file
@@ -12,6 +12,14 @@ See LICENSE.txt in the root directory of this source tree.
 
 */
 #include "YM3014.h"
+#include "../../../Core/Cpu.h"
+
+#if TC_CPU_X86
+#include <emmintrin.h>
+#elif defined(__aarch64__) || defined(_M_ARM64)
+#include <arm_neon.h>
+#define YM3014_NEON 1
+#endif
 
 /*
 	Yamaha YM3014(B) - Serial Input Floating D/A Converter (DAC-SS)
@@ -83,27 +91,22 @@ See LICENSE.txt in the root directory of this source tree.
 	N = (_S2 * 2^2) + (_S1 * 2^1) + _S0 (Note: S2-S0 are inverted)
 
 	Die shot: https://siliconpr0n.org/map/yamaha/y3014/
+
+	Batch conversion:
+	-----------------
+
+	All intermediate values of the conversion are multiples of 2^-16 within [-1, 1], so they are
+	exact in single precision and the vectorized conversion matches the scalar one bit for bit.
+	The exponent is found by comparing against the 6 mantissa range thresholds instead of
+	counting leading zero's, and the mantissa is aligned by multiplying with 2^Shift (only the
+	low 16 bits of the product are needed).
 */
 
 /* Static class member initialization */
 const std::wstring YM3014::s_DeviceName = L"Yamaha YM3014";
 
-const std::wstring& YM3014::GetDeviceName()
-{
-	return s_DeviceName;
-}
-
-uint32_t YM3014::GetAudioFormat()
-{
-	return AudioFormat::AUDIO_FMT_F32;
-}
-
-uint32_t YM3014::GetAudioChannels()
-{
-	return 1;
-}
-
-float YM3014::SendDigitalData(int16_t Data)
+/* Convert a single sample */
+static float ConvertSample(int16_t Data)
 {	
 	/* Invert negative data (1's complement) */
 	uint32_t uData = (Data ^ (Data >> 15));
@@ -138,4 +141,140 @@ float YM3014::SendDigitalData(int16_t Data)
 	float Vout = Mantissa / Exponent;
 
 	return Vout;
+}
+
+/* Convert a block of samples */
+static void ConvertScalar(const int16_t* Data, float* Out, size_t Count)
+{
+	for (size_t i = 0; i < Count; i++) Out[i] = ConvertSample(Data[i]);
+}
+
+#if TC_CPU_X86
+static void ConvertSSE2(const int16_t* Data, float* Out, size_t Count)
+{
+	size_t i = 0;
+
+	const __m128i Sign = _mm_set1_epi16(0x200);
+	const __m128i Mask = _mm_set1_epi16(0x3FF);
+	const __m128 Step = _mm_set1_ps(1.0f / 512.0f);
+	const __m128 Bias = _mm_set1_ps(-1.0f + 0.0009765625f);
+
+	for (; i + 8 <= Count; i += 8)
+	{
+		__m128i Sample = _mm_loadu_si128((const __m128i*)(Data + i));
+
+		/* Invert negative data (1's complement) */
+		__m128i uData = _mm_xor_si128(Sample, _mm_srai_epi16(Sample, 15));
+
+		/* 2^Shift, 64 >> (number of thresholds reached) */
+		__m128i Pow2 = _mm_set1_epi16(64);
+
+		for (int32_t n = 0; n < 6; n++)
+		{
+			__m128i Reached = _mm_cmpgt_epi16(uData, _mm_set1_epi16((0x200 << n) - 1));
+			Pow2 = _mm_sub_epi16(Pow2, _mm_and_si128(Reached, _mm_set1_epi16(32 >> n)));
+		}
+
+		/* Extract the 10 significant bits, invert sign */
+		__m128i Mantissa = _mm_xor_si128(_mm_and_si128(_mm_srli_epi16(_mm_mullo_epi16(Sample, Pow2), 6), Mask), Sign);
+
+		__m128i Zero = _mm_setzero_si128();
+
+		for (int32_t Half = 0; Half < 2; Half++)
+		{
+			__m128i M32 = Half ? _mm_unpackhi_epi16(Mantissa, Zero) : _mm_unpacklo_epi16(Mantissa, Zero);
+			__m128i E32 = Half ? _mm_unpackhi_epi16(Pow2, Zero) : _mm_unpacklo_epi16(Pow2, Zero);
+
+			__m128 Vout = _mm_add_ps(Bias, _mm_mul_ps(Step, _mm_cvtepi32_ps(M32)));
+			Vout = _mm_div_ps(Vout, _mm_cvtepi32_ps(E32));
+
+			_mm_storeu_ps(Out + i + Half * 4, Vout);
+		}
+	}
+
+	/* Remaining samples */
+	ConvertScalar(Data + i, Out + i, Count - i);
+}
+#elif YM3014_NEON
+static void ConvertNEON(const int16_t* Data, float* Out, size_t Count)
+{
+	size_t i = 0;
+
+	const int16x8_t Sign = vdupq_n_s16(0x200);
+	const int16x8_t Mask = vdupq_n_s16(0x3FF);
+	const float32x4_t Step = vdupq_n_f32(1.0f / 512.0f);
+	const float32x4_t Bias = vdupq_n_f32(-1.0f + 0.0009765625f);
+
+	for (; i + 8 <= Count; i += 8)
+	{
+		int16x8_t Sample = vld1q_s16(Data + i);
+
+		/* Invert negative data (1's complement) */
+		int16x8_t uData = veorq_s16(Sample, vshrq_n_s16(Sample, 15));
+
+		/* 2^Shift, 64 >> (number of thresholds reached) */
+		int16x8_t Pow2 = vdupq_n_s16(64);
+
+		for (int32_t n = 0; n < 6; n++)
+		{
+			int16x8_t Reached = vreinterpretq_s16_u16(vcgtq_s16(uData, vdupq_n_s16((0x200 << n) - 1)));
+			Pow2 = vsubq_s16(Pow2, vandq_s16(Reached, vdupq_n_s16(32 >> n)));
+		}
+
+		/* Extract the 10 significant bits, invert sign */
+		uint16x8_t Product = vreinterpretq_u16_s16(vmulq_s16(Sample, Pow2));
+		int16x8_t Mantissa = veorq_s16(vandq_s16(vreinterpretq_s16_u16(vshrq_n_u16(Product, 6)), Mask), Sign);
+
+		for (int32_t Half = 0; Half < 2; Half++)
+		{
+			int32x4_t M32 = vmovl_s16(Half ? vget_high_s16(Mantissa) : vget_low_s16(Mantissa));
+			int32x4_t E32 = vmovl_s16(Half ? vget_high_s16(Pow2) : vget_low_s16(Pow2));
+
+			float32x4_t Vout = vaddq_f32(Bias, vmulq_f32(Step, vcvtq_f32_s32(M32)));
+			Vout = vdivq_f32(Vout, vcvtq_f32_s32(E32));
+
+			vst1q_f32(Out + i + Half * 4, Vout);
+		}
+	}
+
+	/* Remaining samples */
+	ConvertScalar(Data + i, Out + i, Count - i);
+}
+#endif
+
+YM3014::YM3014()
+{
+	/* Select the batch conversion kernel */
+	auto Kernels = TC::CpuKernels<convert_kernel_t>(ConvertScalar);
+#if TC_CPU_X86
+	Kernels.Add(TC::CpuTier::SSE2, ConvertSSE2);
+#elif YM3014_NEON
+	Kernels.Add(TC::CpuTier::NEON, ConvertNEON);
+#endif
+	m_Convert = Kernels.Select();
+}
+
+const std::wstring& YM3014::GetDeviceName()
+{
+	return s_DeviceName;
+}
+
+uint32_t YM3014::GetAudioFormat()
+{
+	return AudioFormat::AUDIO_FMT_F32;
+}
+
+uint32_t YM3014::GetAudioChannels()
+{
+	return 1;
+}
+
+float YM3014::SendDigitalData(int16_t Data)
+{
+	return ConvertSample(Data);
+}
+
+void YM3014::SendDigitalData(const int16_t* Data, float* Out, size_t Count)
+{
+	m_Convert(Data, Out, Count);
 }
\ No newline at end of file
@@ -21,16 +21,69 @@ See LICENSE.txt in the root directory of this source tree.
 class YM3014
 {
 public:
-	YM3014() = default;
+	YM3014();
 	~YM3014() = default;
 
 	const std::wstring& GetDeviceName();
 	uint32_t			GetAudioFormat();
 	uint32_t			GetAudioChannels();
 	float				SendDigitalData(int16_t Data);
+	void				SendDigitalData(const int16_t* Data, float* Out, size_t Count);
+
+	/* Local sample block (see AudioBlock), the digital samples are converted in bulk when the
+	   block is committed to the audio buffer */
+	template<size_t Size = 1024>
+	class OutputBlock
+	{
+	public:
+		OutputBlock(YM3014& Dac, IAudioBuffer* Buffer) :
+			m_Dac(Dac),
+			m_Buffer(Buffer),
+			m_Count(0)
+		{
+		}
+
+		~OutputBlock()
+		{
+			Commit();
+		}
+
+		OutputBlock(const OutputBlock&) = delete;
+		OutputBlock& operator=(const OutputBlock&) = delete;
+
+		inline void Write(int16_t Data)
+		{
+			m_Digital[m_Count++] = Data;
+
+			if (m_Count == Size) Commit();
+		}
+
+		void Commit()
+		{
+			if (m_Buffer == nullptr) m_Count = 0;
+			if (m_Count == 0) return;
+
+			m_Dac.SendDigitalData(m_Digital, m_Analog, m_Count);
+			m_Buffer->WriteSamplesF32(m_Analog, m_Count);
+
+			m_Count = 0;
+		}
+
+	private:
+		YM3014&			m_Dac;
+		IAudioBuffer*	m_Buffer;
+		size_t			m_Count;
+		int16_t			m_Digital[Size];
+		float			m_Analog[Size];
+	};
 
 private:
+	/* Batch conversion kernel */
+	using convert_kernel_t = void (*)(const int16_t* Data, float* Out, size_t Count);
+
 	static const std::wstring s_DeviceName;
+
+	convert_kernel_t m_Convert; /* Selected for the host CPU */
 };
 
 #endif // !_YM3014_H_
\ No newline at end of file
@@ -214,27 +214,63 @@ void YM3413::SendCommandData(uint32_t Command)
 }
 
 void YM3413::ProcessChannel0(int16_t* pChanL, int16_t* pChanR)
-{	
-	/* Store new samples */
-	int16_t NewSampleL = *pChanL;
-	int16_t NewSampleR = *pChanR;
+{
+	int16_t Frame[2] = { *pChanL, *pChanR };
 
-	/* Output previously generated samples */
-	*pChanL = 0;
-	*pChanR = 0;
+	ProcessBlock(0, Frame, Frame, 1);
 
-	//TODO: Process DSP program for 32 cycles
+	*pChanL = Frame[0];
+	*pChanR = Frame[1];
 }
 
 void YM3413::ProcessChannel1(int16_t* pChanL, int16_t* pChanR)
 {
-	/* Store new samples */
-	int16_t NewSampleL = *pChanL;
-	int16_t NewSampleR = *pChanR;
+	int16_t Frame[2] = { *pChanL, *pChanR };
+
+	ProcessBlock(1, Frame, Frame, 1);
+
+	*pChanL = Frame[0];
+	*pChanR = Frame[1];
+}
+
+void YM3413::ProcessChannel0(const int16_t* Send, int16_t* Return, size_t Frames)
+{
+	ProcessBlock(0, Send, Return, Frames);
+}
+
+void YM3413::ProcessChannel1(const int16_t* Send, int16_t* Return, size_t Frames)
+{
+	ProcessBlock(1, Send, Return, Frames);
+}
+
+void YM3413::ProcessBlock(uint32_t Channel, const int16_t* Send, int16_t* Return, size_t Frames)
+{
+	/*
+		Every frame the new samples are clocked in while the previously generated samples are
+		clocked out, so the return of frame n is the result of the DSP program for frame n - 1.
+		Processing a block runs the DSP program over consecutive frames, which walks the delay
+		lines in memory sequentially instead of once per call.
+		Send and Return may point to the same buffer.
+	*/
+
+	//TODO: Process DSP program for 32 cycles per frame (the program format is unknown)
 
 	/* Output previously generated samples */
-	*pChanL = 0;
-	*pChanR = 0;
+	std::fill_n(Return, Frames * 2, 0);
+}
+
+void YM3413::SaveState(StateWriter& State)
+{
+	State.Write(m_CommandCounter);
+	State.Write(m_Volume);
+	State.Write(m_Memory.data(), m_Memory.size());
+}
+
+bool YM3413::LoadState(StateReader& State)
+{
+	State.Read(m_CommandCounter);
+	State.Read(m_Volume);
+	State.Read(m_Memory.data(), m_Memory.size());
 
-	//TODO: Process DSP program for 32 cycles
+	return !State.Failed();
 }
\ No newline at end of file
@@ -15,6 +15,7 @@ See LICENSE.txt in the root directory of this source tree.
 #define _YM3413_H_
 
 #include "..\..\..\TritonCore.h"
+#include "..\..\..\Interfaces\IStateAccess.h"
 
 /* Yamaha YM3413 (LDSP) */
 class YM3413
@@ -29,11 +30,28 @@ public:
 	void ProcessChannel0(int16_t* pChanL, int16_t* pChanR);
 	void ProcessChannel1(int16_t* pChanL, int16_t* pChanR);
 
+	/* Block processing: Frames stereo frames (interleaved L/R) of DSP send into the same number of
+	   return frames. Equivalent to calling ProcessChannelN once per frame */
+	void ProcessChannel0(const int16_t* Send, int16_t* Return, size_t Frames);
+	void ProcessChannel1(const int16_t* Send, int16_t* Return, size_t Frames);
+
+	/* DSP memory size in bytes */
+	size_t GetMemorySize() const
+	{
+		return m_Memory.size();
+	}
+
+	/* State access (DSP memory is working memory and is saved in full) */
+	void SaveState(StateWriter& State);
+	bool LoadState(StateReader& State);
+
 private:
 	std::vector<uint8_t>	m_Memory;
 	uint32_t				m_CommandCounter;
 
 	uint8_t					m_Volume;
+
+	void ProcessBlock(uint32_t Channel, const int16_t* Send, int16_t* Return, size_t Frames);
 };
 
 #endif // !_YM3413_H_
\ No newline at end of file
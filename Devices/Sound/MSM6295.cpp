@@ -71,14 +71,11 @@ const uint8_t MSM6295::s_VolumeTable[16] =
 };
 
 MSM6295::MSM6295(bool PinSS) :
-	m_ClockDivider(PinSS ? 132 : 165)
+	m_ClockDivider(PinSS ? 132 : 165),
+	m_Memory(0x40000), /* 256KB address space */
+	m_MemoryMask(0x3FFFF),
+	m_Cache(OKI::ADPCM::Decode)
 {
-	/* Initialize ADPCM decoder */
-	OKI::ADPCM::InitDecoder();
-	
-	/* Set memory size to 256KB */
-	m_Memory.resize(0x40000);
-
 	Reset(ResetType::PowerOnDefaults);
 }
 
@@ -100,8 +97,10 @@ void MSM6295::Reset(ResetType Type)
 	if (Type == ResetType::PowerOnDefaults)
 	{
 		/* Clear PCM memory */
-		memset(m_Memory.data(), 0, m_Memory.size());
+		m_Memory.Clear();
 	}
+
+	ResetCache(Type == ResetType::PowerOnDefaults);
 }
 
 void MSM6295::SendExclusiveCommand(uint32_t Command, uint32_t Value)
@@ -114,7 +113,7 @@ bool MSM6295::EnumAudioOutputs(uint32_t OutputNr, AUDIO_OUTPUT_DESC& Desc)
 	if (OutputNr == 0)
 	{
 		Desc.SampleRate = m_ClockSpeed / m_ClockDivider;
-		Desc.SampleFormat = 0;
+		Desc.SampleFormat = AudioFormat::AUDIO_FMT_S16;
 		Desc.Channels = 1;
 		Desc.ChannelMask = SPEAKER_FRONT_CENTER;
 		Desc.Description = L"Dialogic ADPCM";
@@ -135,6 +134,11 @@ uint32_t MSM6295::GetClockSpeed()
 	return m_ClockSpeed;
 }
 
+bool MSM6295::GetStats(TC::StatsSnapshot& Stats)
+{
+	return m_Stats.Get(Stats);
+}
+
 void MSM6295::Write(uint32_t Address, uint32_t Data)
 {
 	/*
@@ -143,6 +147,8 @@ void MSM6295::Write(uint32_t Address, uint32_t Data)
 		- if data bit7 = 0: we expect 1 byte, which will suspend the selected channels
 	*/
 
+	m_Stats.RegisterWrite(Address);
+
 	if (m_NextByte) /* Channel and attenuation selection (2nd byte) */
 	{
 		uint32_t AttnIndex = Data & 0x0F;
@@ -182,19 +188,24 @@ void MSM6295::LoadPhrase(uint32_t Index, uint32_t Phrase, uint32_t AttnIndex)
 	if (!Channel.On)
 	{
 		uint32_t Offset = Phrase << 3; /* Each phrase header is 8 bytes */
-		uint32_t Start = (m_Memory[Offset + 0] << 16) | (m_Memory[Offset + 1] << 8) | (m_Memory[Offset + 2] << 0);
-		uint32_t End   = (m_Memory[Offset + 3] << 16) | (m_Memory[Offset + 4] << 8) | (m_Memory[Offset + 5] << 0);
+		uint32_t Start = (m_Memory.Read(Offset + 0) << 16) | (m_Memory.Read(Offset + 1) << 8) | (m_Memory.Read(Offset + 2) << 0);
+		uint32_t End   = (m_Memory.Read(Offset + 3) << 16) | (m_Memory.Read(Offset + 4) << 8) | (m_Memory.Read(Offset + 5) << 0);
 		
 		/* Start channel */
 		Channel.On = 1;
-		Channel.Addr = Start & 0x3FFFF;
-		Channel.End = (End + 1) & 0x3FFFF; /* Inclusive */
+		Channel.Addr = Start & m_MemoryMask;
+		Channel.End = (End + 1) & m_MemoryMask; /* Inclusive */
 		Channel.Volume = s_VolumeTable[AttnIndex];
 
 		/* Reset decoder state */
 		Channel.Signal = 0;
 		Channel.Step = 0;
 		Channel.NibbleShift = 4; /* Start with high order nibble */
+
+		/* Look up the decoded phrase */
+		m_Sample[Index] = m_Cache.Get(Channel.Addr);
+
+		m_Stats.KeyOn();
 	}
 }
 
@@ -204,51 +215,160 @@ void MSM6295::Update(uint32_t ClockCycles, std::vector<IAudioBuffer*>& OutBuffer
 	uint32_t Samples = TotalCycles / m_ClockDivider;
 	m_CyclesToDo = TotalCycles % m_ClockDivider;
 
+	TC::DeviceStats::UpdateScope Stats(m_Stats, Samples);
+
+	AudioBlock<int16_t> Block(OutBuffer[0]);
+
 	int16_t Out;
 
 	while (Samples != 0)
 	{
 		Out = 0;
 
-		for (auto &Channel : m_Channel)
+		for (uint32_t i = 0; i < 4; i++)
 		{
+			auto& Channel = m_Channel[i];
+
 			if (Channel.On)
 			{
-				/* Load nibble from memory */
-				uint8_t Nibble = (m_Memory[Channel.Addr] >> Channel.NibbleShift) & 0x0F;
+				/* Look up the decoded nibble, decode from memory if it is not cached */
+				if (!m_Cache.Fetch(m_Sample[i], Channel.Addr, Channel.NibbleShift, &Channel.Step, &Channel.Signal, [&](uint32_t Address) { return m_Memory.Read(Address); }))
+				{
+					/* Load nibble from memory */
+					uint8_t Nibble = (m_Memory.Read(Channel.Addr) >> Channel.NibbleShift) & 0x0F;
+
+					/* Decode ADPCM nibble */
+					OKI::ADPCM::Decode(Nibble, &Channel.Step, &Channel.Signal);
+				}
 
 				/* Alternate between 1st and 2nd nibble */
 				Channel.NibbleShift ^= 4;
 
 				/* Increase address counter (do this after the ^= 4) */
-				Channel.Addr = (Channel.Addr + (Channel.NibbleShift >> 2)) & 0x3FFFF;
+				Channel.Addr = (Channel.Addr + (Channel.NibbleShift >> 2)) & m_MemoryMask;
 
 				/* Check for end of phrase */
 				if (Channel.Addr == Channel.End) Channel.On = 0;
 
-				/* Decode ADPCM nibble */
-				OKI::ADPCM::Decode(Nibble, &Channel.Step, &Channel.Signal);
-
 				/* Apply attenuation and accumulate */
 				Out += (Channel.Signal * Channel.Volume) >> 3;
 			}
 		}
 
-		OutBuffer[0]->WriteSampleS16(Out);
+		Block.Write(Out);
 
 		Samples--;
 	}
+
+	Stats.ActiveVoices([&] { return std::count_if(std::begin(m_Channel), std::end(m_Channel), [](auto& Channel) { return Channel.On != 0; }); });
+}
+
+uint32_t MSM6295::GetCyclesForFrames(uint32_t OutputNr, uint32_t Frames)
+{
+	/* All outputs run at the same rate */
+	return CyclesForFrames(Frames, m_ClockDivider, m_CyclesToDo);
+}
+
+bool MSM6295::IsSilent()
+{
+	/* Channels stop at the end of their phrase */
+	for (auto& Channel : m_Channel) if (Channel.On != 0) return false;
+
+	return true;
 }
 
 void MSM6295::CopyToMemory(uint32_t MemoryID, size_t Offset, uint8_t* Data, size_t Size)
 {
-	if ((Offset + Size) > m_Memory.size()) return;
+	if (!m_Memory.Upload(Offset, Data, Size)) return;
 
-	memcpy(m_Memory.data() + Offset, Data, Size);
+	ResetCache(true);
 }
 
 void MSM6295::CopyToMemoryIndirect(uint32_t MemoryID, size_t Offset, uint8_t* Data, size_t Size)
 {
 	/* No specialized implementation needed */
 	CopyToMemory(MemoryID, Offset, Data, Size);
+}
+
+bool MSM6295::AttachMemory(uint32_t MemoryID, const uint8_t* Data, size_t Size)
+{
+	m_Memory.Attach(Data, Size);
+
+	/* Phrases are decoded from the attached data */
+	ResetCache(true);
+
+	return true;
+}
+
+size_t MSM6295::GetMemorySize(uint32_t MemoryID)
+{
+	return m_Memory.MaxSize();
+}
+
+bool MSM6295::SetMemorySize(uint32_t MemoryID, size_t Size)
+{
+	/* 18-bit address bus, the memory has to hold the phrase table (1KB) */
+	if (!TC::IsPowerOfTwo(Size) || (Size < 0x400) || (Size > 0x40000)) return false;
+
+	/* Unused address lines mirror the fitted memory */
+	m_Memory.SetMaxSize(Size);
+	m_MemoryMask = (uint32_t)(Size - 1);
+
+	/* Playing phrases continue in the mirrored memory */
+	for (auto& Channel : m_Channel)
+	{
+		Channel.Addr &= m_MemoryMask;
+		Channel.End &= m_MemoryMask;
+	}
+
+	ResetCache(true);
+
+	return true;
+}
+
+size_t MSM6295::GetResidentSize()
+{
+	return m_Memory.GetResidentSize() + m_Cache.GetResidentSize();
+}
+
+void MSM6295::ResetCache(bool Clear)
+{
+	/* Clearing is needed when the memory changed */
+	if (Clear) m_Cache.Clear();
+
+	for (auto& Sample : m_Sample) Sample = nullptr;
+}
+
+void MSM6295::SaveState(StateWriter& State)
+{
+	State.BeginChunk("6295", 1);
+
+	State.Write(m_Channel);
+	State.Write(m_PhraseLatch);
+	State.Write(m_NextByte);
+	State.Write(m_CyclesToDo);
+
+	State.EndChunk();
+}
+
+bool MSM6295::LoadState(StateReader& State)
+{
+	if (!State.BeginChunk("6295", 1)) return false;
+
+	State.Read(m_Channel);
+	State.Read(m_PhraseLatch);
+	State.Read(m_NextByte);
+	State.Read(m_CyclesToDo);
+
+	/* The state can come from a device with a larger memory */
+	for (auto& Channel : m_Channel)
+	{
+		Channel.Addr &= m_MemoryMask;
+		Channel.End &= m_MemoryMask;
+	}
+
+	/* The channels continue decoding from memory */
+	ResetCache(false);
+
+	return State.EndChunk();
 }
\ No newline at end of file
@@ -16,9 +16,11 @@ See LICENSE.txt in the root directory of this source tree.
 
 #include "../../Interfaces/ISoundDevice.h"
 #include "../../Interfaces/IMemoryAccess.h"
+#include "../../Interfaces/IStateAccess.h"
+#include "ADPCM.h"
 
 /* Oki MSM6295 4-channel mixing ADPCM voice synthesis LSI */
-class MSM6295 : public ISoundDevice, public IMemoryAccess
+class MSM6295 : public ISoundDevice, public IMemoryAccess, public IStateAccess
 {
 public:
 	MSM6295(bool PinSS = false);
@@ -35,10 +37,21 @@ public:
 	uint32_t		GetClockSpeed();
 	void			Write(uint32_t Address, uint32_t Data);
 	void			Update(uint32_t ClockCycles, std::vector<IAudioBuffer*>& OutBuffer);
+	uint32_t		GetCyclesForFrames(uint32_t OutputNr, uint32_t Frames);
+	bool			IsSilent();
+	bool			GetStats(TC::StatsSnapshot& Stats);
 
 	/* IMemoryAccess methods */
 	void			CopyToMemory(uint32_t MemoryID, size_t Offset, uint8_t* Data, size_t Size);
 	void			CopyToMemoryIndirect(uint32_t MemoryID, size_t Offset, uint8_t* Data, size_t Size);
+	bool			AttachMemory(uint32_t MemoryID, const uint8_t* Data, size_t Size);
+	size_t			GetMemorySize(uint32_t MemoryID);
+	bool			SetMemorySize(uint32_t MemoryID, size_t Size);
+	size_t			GetResidentSize();
+
+	/* IStateAccess methods */
+	void			SaveState(StateWriter& State);
+	bool			LoadState(StateReader& State);
 
 private:
 	struct CHANNEL
@@ -60,12 +73,18 @@ private:
 	uint32_t	m_ClockSpeed;
 	uint32_t	m_ClockDivider;
 	uint32_t	m_CyclesToDo;
+	TC::DeviceStats	m_Stats;
+
+	SampleMemory m_Memory;
+	uint32_t m_MemoryMask; /* Fitted memory (smaller memories are mirrored) */
 
-	std::vector<uint8_t> m_Memory;
+	ADPCMCache				m_Cache;		/* Decoded phrases */
+	ADPCMCache::sample_t*	m_Sample[4];	/* Decoded phrase per channel (not part of the state) */
 
 	static const uint8_t s_VolumeTable[16];
 
 	void LoadPhrase(uint32_t Index, uint32_t Phrase, uint32_t AttnIndex);
+	void ResetCache(bool Clear);
 };
 
 #endif // !_MSM6295_H_
\ No newline at end of file
@@ -16,9 +16,10 @@ See LICENSE.txt in the root directory of this source tree.
 
 #include "../../Interfaces/ISoundDevice.h"
 #include "../../Interfaces/IMemoryAccess.h"
+#include "../../Interfaces/IStateAccess.h"
 
 /* NULL sound device */
-class NullSound : public ISoundDevice, public IMemoryAccess
+class NullSound : public ISoundDevice, public IMemoryAccess, public IStateAccess
 {
 public:
 	NullSound() {};
@@ -62,6 +63,18 @@ public:
 
 	void CopyToMemoryIndirect(uint32_t MemoryID, size_t Offset, uint8_t* Data, size_t Size)
 	{}
+
+	/* IStateAccess methods */
+	void SaveState(StateWriter& State)
+	{
+		State.BeginChunk("NULL", 1);
+		State.EndChunk();
+	}
+
+	bool LoadState(StateReader& State)
+	{
+		return State.BeginChunk("NULL", 1) && State.EndChunk();
+	}
 };
 
 #endif // !_NULLSOUND_H_
\ No newline at end of file
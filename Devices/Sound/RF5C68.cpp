@@ -31,7 +31,9 @@ See LICENSE.txt in the root directory of this source tree.
 RF5C68::RF5C68(uint32_t Model, bool UseRAMAX) :
 	m_ClockDivider(384),
 	m_Shift(11),
-	m_Model(Model)
+	m_Model(Model),
+	m_DacAddress(0x1000),
+	m_Muted(0)
 {
 	uint32_t Size = 64 * 1024; /* Default to 64KB */
 
@@ -84,10 +86,13 @@ void RF5C68::Reset(ResetType Type)
 	/* Reset all channels */
 	memset(m_Channel, 0, sizeof(m_Channel));
 
+	m_DacStream.Stop();
+
 	if (Type == ResetType::PowerOnDefaults)
 	{
 		/* Clear PCM memory */
 		memset(m_Memory.data(), 0, m_Memory.size());
+		m_MemoryPages.Clear();
 	}
 }
 
@@ -101,7 +106,7 @@ bool RF5C68::EnumAudioOutputs(uint32_t OutputNr, AUDIO_OUTPUT_DESC& Desc)
 	if (OutputNr == 0)
 	{
 		Desc.SampleRate = m_ClockSpeed / m_ClockDivider;
-		Desc.SampleFormat = 0;
+		Desc.SampleFormat = AudioFormat::AUDIO_FMT_S16;
 		Desc.Channels = 2;
 		Desc.ChannelMask = SPEAKER_FRONT_LEFT | SPEAKER_FRONT_RIGHT;
 		Desc.Description = L"";
@@ -112,6 +117,14 @@ bool RF5C68::EnumAudioOutputs(uint32_t OutputNr, AUDIO_OUTPUT_DESC& Desc)
 	return false;
 }
 
+bool RF5C68::SetChannelMask(uint64_t Enabled)
+{
+	/* Channels 1 - 8 */
+	m_Muted = ~Enabled & 0xFF;
+
+	return true;
+}
+
 void RF5C68::SetClockSpeed(uint32_t ClockSpeed)
 {
 	m_ClockSpeed = ClockSpeed;
@@ -122,6 +135,11 @@ uint32_t RF5C68::GetClockSpeed()
 	return m_ClockSpeed;
 }
 
+bool RF5C68::GetStats(TC::StatsSnapshot& Stats)
+{
+	return m_Stats.Get(Stats);
+}
+
 void RF5C68::Write(uint32_t Address, uint32_t Data)
 {
 	/*
@@ -135,6 +153,7 @@ void RF5C68::Write(uint32_t Address, uint32_t Data)
 
 	if (Address & 0x1000) /* Waveform data (0x1000-0x1FFF) */
 	{
+		m_MemoryPages.Touch(m_Memory.data(), m_Memory.size(), m_WaveBank | (Address & 0x0FFF));
 		m_Memory[m_WaveBank | (Address & 0x0FFF)] = Data;
 		return;
 	}
@@ -142,6 +161,8 @@ void RF5C68::Write(uint32_t Address, uint32_t Data)
 	{
 		auto& Channel = m_Channel[m_ChannelBank];
 
+		m_Stats.RegisterWrite(Address);
+
 		switch (Address)
 		{
 		case 0x00: /* Envelope Register */
@@ -205,6 +226,7 @@ void RF5C68::Write(uint32_t Address, uint32_t Data)
 				{
 					/* Restarting channel, load start address */
 					m_Channel[i].ADDR = m_Channel[i].ST << m_Shift;
+					m_Stats.KeyOn();
 				}
 
 				m_Channel[i].ON = ON;
@@ -225,17 +247,24 @@ void RF5C68::Update(uint32_t ClockCycles, std::vector<IAudioBuffer*>& OutBuffer)
 	uint32_t Samples = TotalCycles / m_ClockDivider;
 	m_CyclesToDo = TotalCycles % m_ClockDivider;
 
-	int32_t OutL;
-	int32_t OutR;
-	uint8_t PCM;
+	/* Channels are only switched on and off by register writes */
+	TC::DeviceStats::UpdateScope Stats(m_Stats, Samples);
+	Stats.ActiveVoices([&] { return m_Sounding ? std::popcount(m_ChannelCtrl) : 0; });
+
+	AudioBlock<int16_t> Block(OutBuffer[0]);
 
-	if (!m_Sounding || !m_ChannelCtrl) /* IC is not sounding / all channels are OFF */
+	uint32_t Value = 0;
+
+	if (m_DacStream.IsActive()) m_DacStream.Prepare(m_ClockSpeed, m_ClockDivider);
+
+	/* IC is not sounding / all channels are OFF (a stream can change that) */
+	if ((!m_Sounding || !m_ChannelCtrl) && !m_DacStream.IsActive())
 	{
 		/* Clear sample buffer (samples x 16-bit x 2 channels) */
 		for (uint32_t i = 0; i < Samples; i++)
 		{
-			OutBuffer[0]->WriteSampleS16(0);
-			OutBuffer[0]->WriteSampleS16(0);
+			Block.Write(0);
+			Block.Write(0);
 		}
 
 		return;
@@ -243,66 +272,132 @@ void RF5C68::Update(uint32_t ClockCycles, std::vector<IAudioBuffer*>& OutBuffer)
 
 	while (Samples != 0)
 	{
-		OutL = 0;
-		OutR = 0;
+		uint32_t Frames = std::min(Samples, BlockFrames);
 
-		for (CHANNEL& Channel : m_Channel)
+		if (m_DacStream.IsActive())
 		{
-			if (Channel.ON)
+			/* Stream data lands between two samples (like a register / waveform data write), one sample per block */
+			Frames = 1;
+
+			if (m_DacStream.Tick(Value))
 			{
-				/* Read wave data from current address */
-				PCM = m_Memory[Channel.ADDR >> m_Shift];
+				Write(m_DacAddress, Value);
 
-				if (PCM == 0xFF) /* Loop stop data */
-				{
-					/* Set to loop start address */
-					Channel.ADDR = Channel.LS << m_Shift;
+				/* Waveform data is written to consecutive addresses (eg. filling a ring buffer) */
+				if (m_DacAddress & 0x1000) m_DacAddress = 0x1000 | ((m_DacAddress + 1) & 0x0FFF);
+			}
+		}
 
-					/* Re-read wave data */
-					PCM = m_Memory[Channel.ADDR >> m_Shift];
+		RenderBlock(Frames, Block);
 
-					if (PCM == 0xFF) continue; /* Looped to loop stop data, move to next channel */
-				}
+		Samples -= Frames;
+	}
+}
+
+void RF5C68::RenderBlock(uint32_t Frames, AudioBlock<int16_t>& Block)
+{
+	int32_t OutL[BlockFrames];
+	int32_t OutR[BlockFrames];
+
+	std::fill_n(OutL, Frames, 0);
+	std::fill_n(OutR, Frames, 0);
+
+	if (m_Sounding)
+	{
+		for (uint32_t i = 0; i < 8; i++)
+		{
+			if (m_Channel[i].ON) RenderChannel(m_Channel[i], (m_Muted >> i) & 1, Frames, OutL, OutR);
+		}
+	}
+
+	for (uint32_t i = 0; i < Frames; i++)
+	{
+		/* Limiter (signed 16-bit) */
+		int32_t L = std::clamp(OutL[i], -32768, 32767);
+		int32_t R = std::clamp(OutR[i], -32768, 32767);
+
+		/* 10-bit / 16-bit DAC output (interleaved) */
+		Block.Write(L & m_OutputMask);
+		Block.Write(R & m_OutputMask);
+	}
+}
+
+void RF5C68::RenderChannel(CHANNEL& Channel, bool Muted, uint32_t Frames, int32_t* OutL, int32_t* OutR)
+{
+	const uint8_t* Memory = m_Memory.data();
+	uint32_t Size = (uint32_t)m_Memory.size(); /* 2^27 >> m_Shift */
+	uint32_t Frame = 0;
+
+	while (Frame < Frames)
+	{
+		uint32_t Index = Channel.ADDR >> m_Shift;
+
+		if (Memory[Index] == 0xFF) /* Loop stop data */
+		{
+			/* Set to loop start address */
+			Channel.ADDR = Channel.LS << m_Shift;
+			Index = Channel.ADDR >> m_Shift;
+
+			/* Looped to loop stop data, the channel stays silent until the registers change */
+			if (Memory[Index] == 0xFF) return;
+		}
+
+		/*
+			Run: the samples up to the next loop stop data or the end of memory (where the address counter wraps).
+			Only the memory the run can reach is searched, a run is at least one sample
+		*/
+		uint32_t Run = Frames - Frame;
+
+		if (Channel.FD != 0)
+		{
+			uint32_t Last = std::min((Channel.ADDR + ((Run - 1) * Channel.FD)) >> m_Shift, Size - 1);
+			auto Stop = (const uint8_t*)memchr(Memory + Index, 0xFF, (Last - Index) + 1);
+			uint32_t End = (Stop != nullptr) ? (uint32_t)(Stop - Memory) : Last + 1;
+
+			Run = std::min(Run, ((End << m_Shift) - Channel.ADDR + Channel.FD - 1) / Channel.FD);
+		}
+
+		/* Muted channels only advance their address counter */
+		if (!Muted)
+		{
+			uint32_t Address = Channel.ADDR;
 
-				/* Advance address counter (limit to 27-bits) */
-				Channel.ADDR = (Channel.ADDR + Channel.FD) & 0x07FFFFFF;
+			for (uint32_t i = Frame; i < Frame + Run; i++)
+			{
+				uint32_t PCM = Memory[Address >> m_Shift];
+				Address += Channel.FD;
 
 				/* Apply panning + envelope and add/sub to output buffer
 
 					7-bit PCM x 8-bit ENV x 4-bit PAN = 19-bit
-					The most significant 14-bits are accumulated
+					The most significant 14-bits are accumulated (bit 7 set = add)
 				*/
-				if (PCM & 0x80)
-				{
-					PCM &= 0x7F;
-					OutL += (PCM * Channel.PREMUL_L) >> 5;
-					OutR += (PCM * Channel.PREMUL_R) >> 5;
-				}
-				else
-				{
-					OutL -= (PCM * Channel.PREMUL_L) >> 5;
-					OutR -= (PCM * Channel.PREMUL_R) >> 5;
-				}
+				int32_t Sign = (int32_t)(PCM >> 7) - 1;
+
+				OutL[i] += ((int32_t)(((PCM & 0x7F) * Channel.PREMUL_L) >> 5) ^ Sign) - Sign;
+				OutR[i] += ((int32_t)(((PCM & 0x7F) * Channel.PREMUL_R) >> 5) ^ Sign) - Sign;
 			}
 		}
 
-		/* Limiter (signed 16-bit) */
-		OutL = std::clamp(OutL, -32768, 32767);
-		OutR = std::clamp(OutR, -32768, 32767);
+		/* Advance address counter (limit to 27-bits) */
+		Channel.ADDR = (Channel.ADDR + (Run * Channel.FD)) & 0x07FFFFFF;
 
-		/* 10-bit / 16-bit DAC output (interleaved) */
-		OutBuffer[0]->WriteSampleS16(OutL & m_OutputMask);
-		OutBuffer[0]->WriteSampleS16(OutR & m_OutputMask);
-
-		Samples--;
+		Frame += Run;
 	}
 }
 
+uint32_t RF5C68::GetCyclesForFrames(uint32_t OutputNr, uint32_t Frames)
+{
+	/* All outputs run at the same rate */
+	return CyclesForFrames(Frames, m_ClockDivider, m_CyclesToDo);
+}
+
 void RF5C68::CopyToMemory(uint32_t MemoryID, size_t Offset, uint8_t* Data, size_t Size)
 {
 	if ((Offset + Size) > m_Memory.size()) return;
 
 	memcpy(m_Memory.data() + Offset, Data, Size);
+	m_MemoryPages.Upload(m_Memory.data(), Offset, Size);
 }
 
 void RF5C68::CopyToMemoryIndirect(uint32_t MemoryID, size_t Offset, uint8_t* Data, size_t Size)
@@ -310,4 +405,82 @@ void RF5C68::CopyToMemoryIndirect(uint32_t MemoryID, size_t Offset, uint8_t* Dat
 	if ((Offset + Size + m_WaveBank) > m_Memory.size()) return;
 
 	memcpy(m_Memory.data() + Offset + m_WaveBank, Data, Size);
+	m_MemoryPages.Upload(m_Memory.data(), Offset + m_WaveBank, Size);
+}
+
+size_t RF5C68::GetMemorySize(uint32_t MemoryID)
+{
+	/* The memory size follows the chip type and address format (see constructor) */
+	return m_Memory.size();
+}
+
+bool RF5C68::RevertMemory()
+{
+	m_MemoryPages.Revert(m_Memory.data(), m_Memory.size());
+
+	return true;
+}
+
+size_t RF5C68::GetResidentSize()
+{
+	return m_Memory.capacity() + m_MemoryPages.GetResidentSize();
+}
+
+void RF5C68::SaveState(StateWriter& State)
+{
+	State.BeginChunk("5C68", 1);
+
+	State.Write(m_Channel);
+	State.Write(m_Sounding);
+	State.Write(m_WaveBank);
+	State.Write(m_ChannelBank);
+	State.Write(m_ChannelCtrl);
+	State.Write(m_CyclesToDo);
+
+	/* Only the pages written by the device itself */
+	m_MemoryPages.Save(State, m_Memory.data());
+
+	State.EndChunk();
+}
+
+bool RF5C68::LoadState(StateReader& State)
+{
+	if (!State.BeginChunk("5C68", 1)) return false;
+
+	State.Read(m_Channel);
+	State.Read(m_Sounding);
+	State.Read(m_WaveBank);
+	State.Read(m_ChannelBank);
+	State.Read(m_ChannelCtrl);
+	State.Read(m_CyclesToDo);
+
+	if (!m_MemoryPages.Load(State, m_Memory.data(), m_Memory.size())) return false;
+
+	return State.EndChunk();
+}
+
+bool RF5C68::StartDacStream(const DAC_STREAM_DESC& Desc)
+{
+	uint32_t Address = Desc.Register & 0x1FFF;
+
+	if ((Address > 0x08) && !(Address & 0x1000)) return false;
+
+	m_DacAddress = Address;
+
+	return m_DacStream.Start(Desc, 1);
+}
+
+void RF5C68::StopDacStream()
+{
+	m_DacStream.Stop();
+}
+
+void RF5C68::SetDacStreamFrequency(uint32_t Frequency)
+{
+	m_DacStream.SetFrequency(Frequency);
+}
+
+bool RF5C68::IsDacStreamActive()
+{
+	return m_DacStream.IsActive();
 }
\ No newline at end of file
@@ -16,9 +16,11 @@ See LICENSE.txt in the root directory of this source tree.
 
 #include "../../Interfaces/ISoundDevice.h"
 #include "../../Interfaces/IMemoryAccess.h"
+#include "../../Interfaces/IDacStream.h"
+#include "../../Interfaces/IStateAccess.h"
 
 /* Ricoh RF5C68 / RF5C164 PCM Sound Source */
-class RF5C68 : public ISoundDevice, public IMemoryAccess
+class RF5C68 : public ISoundDevice, public IMemoryAccess, public IStateAccess, public IDacStream
 {
 public:
 	enum MODEL
@@ -37,14 +39,30 @@ public:
 
 	/* ISoundDevice methods */
 	bool			EnumAudioOutputs(uint32_t OutputNr, AUDIO_OUTPUT_DESC& Desc);
+	bool			SetChannelMask(uint64_t Enabled);
 	void			SetClockSpeed(uint32_t ClockSpeed);
 	uint32_t		GetClockSpeed();
 	void			Write(uint32_t Address, uint32_t Data);
 	void			Update(uint32_t ClockCycles, std::vector<IAudioBuffer*>& OutBuffer);
+	uint32_t		GetCyclesForFrames(uint32_t OutputNr, uint32_t Frames);
+	bool			GetStats(TC::StatsSnapshot& Stats);
 
 	/* IMemoryAccess methods */
 	void			CopyToMemory(uint32_t MemoryID, size_t Offset, uint8_t* Data, size_t Size);
 	void			CopyToMemoryIndirect(uint32_t MemoryID, size_t Offset, uint8_t* Data, size_t Size);
+	size_t			GetMemorySize(uint32_t MemoryID);
+	bool			RevertMemory();
+	size_t			GetResidentSize();
+
+	/* IStateAccess methods */
+	void			SaveState(StateWriter& State);
+	bool			LoadState(StateReader& State);
+
+	/* IDacStream methods (registers 0x00 - 0x08 or waveform data 0x1000 - 0x1FFF) */
+	bool			StartDacStream(const DAC_STREAM_DESC& Desc);
+	void			StopDacStream();
+	void			SetDacStreamFrequency(uint32_t Frequency);
+	bool			IsDacStreamActive();
 
 private:
 
@@ -65,12 +83,23 @@ private:
 		uint32_t	PREMUL_R;	/* ENV * PAN (R) pre-multiplied data */
 	};
 
+	/* Frames mixed per block */
+	static constexpr uint32_t BlockFrames = 256;
+
+	void		RenderBlock(uint32_t Frames, AudioBlock<int16_t>& Block);
+	void		RenderChannel(CHANNEL& Channel, bool Muted, uint32_t Frames, int32_t* OutL, int32_t* OutR);
+
 	CHANNEL		m_Channel[8];	/* PCM channels */
 	uint32_t	m_Sounding;		/* IC sounding */
 	uint32_t	m_WaveBank;		/* Current wave bank */
 	uint32_t	m_ChannelBank;	/* Current channel */
 	uint8_t		m_ChannelCtrl;	/* Channel control register */
 
+	DacStream	m_DacStream;	/* Register / waveform data stream */
+	uint32_t	m_DacAddress;	/* Stream destination address */
+
+	uint8_t		m_Muted;		/* Muted channels (not part of the state) */
+
 	uint32_t m_Model;			/* Device model */
 	uint32_t m_Shift;			/* Fixed point shift (16.11 or 17.10) */
 	uint32_t m_OutputMask;		/* DAC output mask */
@@ -78,8 +107,10 @@ private:
 	uint32_t m_ClockSpeed;
 	uint32_t m_ClockDivider;
 	uint32_t m_CyclesToDo;
+	TC::DeviceStats	m_Stats;
 
 	std::vector<uint8_t> m_Memory;
+	PageTracker m_MemoryPages; /* Device written memory pages */
 };
 
 #endif // !_RF5C68_H_
\ No newline at end of file
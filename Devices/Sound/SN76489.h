@@ -15,6 +15,7 @@ See LICENSE.txt in the root directory of this source tree.
 #define _SN76489_CORE_H_
 
 #include "../../Interfaces/ISoundDevice.h"
+#include "../../Interfaces/IStateAccess.h"
 
 /*
 	Supported SN76489 family (and clones) overview:
@@ -57,12 +58,14 @@ namespace SNPSG
 		bool IsStereo,
 		uint32_t Divider
 	>
-	class Core : public ISoundDevice
+	class Core : public ISoundDevice, public IStateAccess
 	{
 	public:
 		/* Constructor */
 		Core() :
-			m_ClockDivider(Divider)
+			m_ClockDivider(Divider),
+			m_ChannelOutputs(false),
+			m_VoiceGate{ 0xFFFF, 0xFFFF, 0xFFFF, 0xFFFF }
 		{
 			//double Volume = 32767.0 / 8.0; /* This needs validation */
 
@@ -149,9 +152,35 @@ namespace SNPSG
 				return true;
 			}
 
+			if (m_ChannelOutputs && (OutputNr >= 1) && (OutputNr <= 4)) /* Tone 1 - 3, noise */
+			{
+				Desc.SampleRate		= (m_ClockSpeed / m_ClockDivider) / 2;
+				Desc.SampleFormat	= AudioFormat::AUDIO_FMT_S16;
+				Desc.Channels		= 1;
+				Desc.ChannelMask	= SPEAKER_FRONT_CENTER;
+				Desc.Description	= (OutputNr == 4) ? L"Noise" : L"Tone " + std::to_wstring(OutputNr);
+
+				return true;
+			}
+
 			return false;
 		}
 
+		bool SetChannelOutputs(bool Enable)
+		{
+			m_ChannelOutputs = Enable;
+
+			return true;
+		}
+
+		bool SetChannelMask(uint64_t Enabled)
+		{
+			/* Tone 1 - 3, noise (the counters keep running) */
+			for (auto i = 0; i < 4; i++) m_VoiceGate[i] = ((Enabled >> i) & 1) ? 0xFFFF : 0;
+
+			return true;
+		}
+
 		void SetClockSpeed(uint32_t ClockSpeed)
 		{
 			m_ClockSpeed = ClockSpeed;
@@ -171,6 +200,8 @@ namespace SNPSG
 				m_Register = (Data >> 4) & 0x07;
 			}
 
+			m_Stats.RegisterWrite(m_Register << TC::StatsSnapshot::RangeShift); /* One range per register */
+
 			switch (m_Register)
 			{
 			case 0: /* Tone 1 period */
@@ -249,6 +280,8 @@ namespace SNPSG
 			uint32_t Samples = TotalCycles / m_ClockDivider;
 			m_CyclesToDo = TotalCycles % m_ClockDivider;
 
+			TC::DeviceStats::UpdateScope Stats(m_Stats, Samples);
+
 			if constexpr (IsStereo)
 			{
 				UpdateStereo(Samples, OutBuffer);
@@ -257,29 +290,118 @@ namespace SNPSG
 			{
 				UpdateMono(Samples, OutBuffer);
 			}
+
+			Stats.ActiveVoices([&]
+			{
+				auto Tones = std::count_if(std::begin(m_Tone), std::end(m_Tone), [](auto& Tone) { return Tone.Volume != 0; });
+
+				return Tones + ((m_Noise.Volume != 0) ? 1 : 0);
+			});
+		}
+
+		uint32_t GetCyclesForFrames(uint32_t OutputNr, uint32_t Frames)
+		{
+			if (Frames == 0) return 0;
+
+			/* A frame is output every other tick, the next tick outputs one when the sample hack is set */
+			uint32_t Ticks = (2 * Frames) - (m_SampleHack & 1);
+
+			return CyclesForFrames(Ticks, m_ClockDivider, m_CyclesToDo);
+		}
+
+		bool IsSilent()
+		{
+			for (auto& Tone : m_Tone) if (Tone.Volume != 0) return false;
+
+			return m_Noise.Volume == 0;
+		}
+
+		bool GetStats(TC::StatsSnapshot& Stats)
+		{
+			return m_Stats.Get(Stats);
+		}
+
+		/* IStateAccess methods */
+		void SaveState(StateWriter& State)
+		{
+			State.BeginChunk("PSG ", 1);
+
+			State.Write(m_Register);
+			State.Write(m_StereoMask);
+			State.Write(m_Tone);
+			State.Write(m_Noise);
+			State.Write(m_CyclesToDo);
+			State.Write(m_SampleHack);
+
+			State.EndChunk();
+		}
+
+		bool LoadState(StateReader& State)
+		{
+			if (!State.BeginChunk("PSG ", 1)) return false;
+
+			State.Read(m_Register);
+			State.Read(m_StereoMask);
+			State.Read(m_Tone);
+			State.Read(m_Noise);
+			State.Read(m_CyclesToDo);
+			State.Read(m_SampleHack);
+
+			return State.EndChunk();
 		}
 
 	private:
 
+		/*
+			The outputs only change when a tone or noise counter reloads. Instead of stepping
+			every tick, the counters skip ahead to the tick of the next reload and the constant
+			outputs in between are written in one go (the output is identical to stepping).
+		*/
+
 		void UpdateMono(uint32_t Samples, std::vector<IAudioBuffer*>& OutBuffer)
 		{
-			int16_t  Out;
+			AudioBlock<int16_t> Block(OutBuffer[0]);
+			AudioTaps<4> Taps(OutBuffer, 1, m_ChannelOutputs);
+
+			int16_t Voices[4];
 
 			while (Samples != 0)
 			{
+				/* Skip the ticks before the next reload */
+				uint32_t Ticks = std::min(Samples, GetTicksToReload()) - 1;
+
+				if (Ticks != 0)
+				{
+					SkipTicks(Ticks);
+
+					int16_t Out = MixMono();
+					uint32_t Outputs = GetOutputs(Ticks);
+
+					for (auto n = Outputs; n != 0; n--) Block.Write(Out);
+
+					if (Taps.IsActive())
+					{
+						MixVoices(Voices);
+
+						for (auto n = Outputs; n != 0; n--) Taps.Write(Voices);
+					}
+
+					Samples -= Ticks;
+				}
+
 				UpdateToneGenerators();
 				UpdateNoiseGenerator();
 
-				/* Mix channels */
+				/* Output sample to buffer */
 				if (!(m_SampleHack ^= 1)) //FIXME
 				{
-					Out = (m_Tone[0].Volume & m_Tone[0].FlipFlop);
-					Out += (m_Tone[1].Volume & m_Tone[1].FlipFlop);
-					Out += (m_Tone[2].Volume & m_Tone[2].FlipFlop);
-					Out += (m_Noise.Volume & m_Noise.Output);
+					Block.Write(MixMono());
 
-					/* Output sample to buffer */
-					OutBuffer[0]->WriteSampleS16(Out);
+					if (Taps.IsActive())
+					{
+						MixVoices(Voices);
+						Taps.Write(Voices);
+					}
 				}
 
 				Samples--;
@@ -288,38 +410,138 @@ namespace SNPSG
 
 		void UpdateStereo(uint32_t Samples, std::vector<IAudioBuffer*>& OutBuffer)
 		{
+			AudioBlock<int16_t> Block(OutBuffer[0]);
+			AudioTaps<4> Taps(OutBuffer, 1, m_ChannelOutputs);
+
+			int16_t Voices[4];
+
 			int16_t OutL;
 			int16_t OutR;
 
 			while (Samples != 0)
 			{
-				OutL = OutR = 0;
+				/* Skip the ticks before the next reload */
+				uint32_t Ticks = std::min(Samples, GetTicksToReload()) - 1;
+
+				if (Ticks != 0)
+				{
+					SkipTicks(Ticks);
+
+					MixStereo(OutL, OutR);
+					uint32_t Outputs = GetOutputs(Ticks);
+
+					for (auto n = Outputs; n != 0; n--)
+					{
+						Block.Write(OutL);
+						Block.Write(OutR);
+					}
+
+					if (Taps.IsActive())
+					{
+						MixVoices(Voices);
+
+						for (auto n = Outputs; n != 0; n--) Taps.Write(Voices);
+					}
+
+					Samples -= Ticks;
+				}
 
 				UpdateToneGenerators();
 				UpdateNoiseGenerator();
 
-				/* Mix channels */
+				/* Output samples to buffer */
 				if (!(m_SampleHack ^= 1)) //FIXME
 				{
-					if (m_StereoMask & 0x10) OutL += (m_Tone[0].Volume & m_Tone[0].FlipFlop);
-					if (m_StereoMask & 0x20) OutL += (m_Tone[1].Volume & m_Tone[1].FlipFlop);
-					if (m_StereoMask & 0x40) OutL += (m_Tone[2].Volume & m_Tone[2].FlipFlop);
-					if (m_StereoMask & 0x80) OutL += (m_Noise.Volume & m_Noise.Output);
-
-					if (m_StereoMask & 0x01) OutR += (m_Tone[0].Volume & m_Tone[0].FlipFlop);
-					if (m_StereoMask & 0x02) OutR += (m_Tone[1].Volume & m_Tone[1].FlipFlop);
-					if (m_StereoMask & 0x04) OutR += (m_Tone[2].Volume & m_Tone[2].FlipFlop);
-					if (m_StereoMask & 0x08) OutR += (m_Noise.Volume & m_Noise.Output);
-
-					/* Output samples to buffer */
-					OutBuffer[0]->WriteSampleS16(OutL);
-					OutBuffer[0]->WriteSampleS16(OutR);
+					MixStereo(OutL, OutR);
+
+					Block.Write(OutL);
+					Block.Write(OutR);
+
+					if (Taps.IsActive())
+					{
+						MixVoices(Voices);
+						Taps.Write(Voices);
+					}
 				}
 
 				Samples--;
 			}
 		}
 
+		inline int16_t MixMono()
+		{
+			int16_t Out;
+
+			Out = (m_Tone[0].Volume & m_Tone[0].FlipFlop & m_VoiceGate[0]);
+			Out += (m_Tone[1].Volume & m_Tone[1].FlipFlop & m_VoiceGate[1]);
+			Out += (m_Tone[2].Volume & m_Tone[2].FlipFlop & m_VoiceGate[2]);
+			Out += (m_Noise.Volume & m_Noise.Output & m_VoiceGate[3]);
+
+			return Out;
+		}
+
+		/* Voice outputs (tone 1 - 3, noise) before the stereo mask */
+		inline void MixVoices(int16_t* Out)
+		{
+			for (auto i = 0; i < 3; i++) Out[i] = (m_Tone[i].Volume & m_Tone[i].FlipFlop & m_VoiceGate[i]);
+
+			Out[3] = (m_Noise.Volume & m_Noise.Output & m_VoiceGate[3]);
+		}
+
+		inline void MixStereo(int16_t& OutL, int16_t& OutR)
+		{
+			OutL = OutR = 0;
+
+			if (m_StereoMask & 0x10) OutL += (m_Tone[0].Volume & m_Tone[0].FlipFlop & m_VoiceGate[0]);
+			if (m_StereoMask & 0x20) OutL += (m_Tone[1].Volume & m_Tone[1].FlipFlop & m_VoiceGate[1]);
+			if (m_StereoMask & 0x40) OutL += (m_Tone[2].Volume & m_Tone[2].FlipFlop & m_VoiceGate[2]);
+			if (m_StereoMask & 0x80) OutL += (m_Noise.Volume & m_Noise.Output & m_VoiceGate[3]);
+
+			if (m_StereoMask & 0x01) OutR += (m_Tone[0].Volume & m_Tone[0].FlipFlop & m_VoiceGate[0]);
+			if (m_StereoMask & 0x02) OutR += (m_Tone[1].Volume & m_Tone[1].FlipFlop & m_VoiceGate[1]);
+			if (m_StereoMask & 0x04) OutR += (m_Tone[2].Volume & m_Tone[2].FlipFlop & m_VoiceGate[2]);
+			if (m_StereoMask & 0x08) OutR += (m_Noise.Volume & m_Noise.Output & m_VoiceGate[3]);
+		}
+
+		/* Number of ticks up to and including the next counter reload */
+		static inline uint32_t GetTicksToReload(int32_t Counter)
+		{
+			if constexpr (AllowZeroPeriod) return std::max(Counter, 1);
+			else return (Counter != 0) ? Counter : 0x400;
+		}
+
+		inline uint32_t GetTicksToReload() const
+		{
+			uint32_t Ticks = GetTicksToReload(m_Noise.Counter);
+
+			for (auto& Tone : m_Tone) Ticks = std::min(Ticks, GetTicksToReload(Tone.Counter));
+
+			return Ticks;
+		}
+
+		/* Advance all counters, the ticks must not reach a reload */
+		inline void SkipTicks(uint32_t Ticks)
+		{
+			for (auto& Tone : m_Tone)
+			{
+				if constexpr (AllowZeroPeriod) Tone.Counter -= Ticks;
+				else Tone.Counter = (Tone.Counter - Ticks) & 0x3FF;
+			}
+
+			if constexpr (AllowZeroPeriod) m_Noise.Counter -= Ticks;
+			else m_Noise.Counter = (m_Noise.Counter - Ticks) & 0x3FF;
+		}
+
+		/* Number of samples output within the ticks, every 2nd tick outputs a sample */
+		inline uint32_t GetOutputs(uint32_t Ticks)
+		{
+			uint32_t Outputs = (Ticks + m_SampleHack) >> 1;
+
+			m_SampleHack ^= Ticks & 1;
+
+			return Outputs;
+		}
+
 		void UpdateToneGenerators()
 		{
 			/*	Note: The flipflop is used as a mask over the volume output */
@@ -406,6 +628,10 @@ namespace SNPSG
 		uint32_t	m_ClockDivider;
 		uint32_t	m_CyclesToDo;
 		uint32_t	m_SampleHack; //FIXME
+		bool		m_ChannelOutputs;	/* Per-voice outputs enabled (not part of the state) */
+		uint16_t	m_VoiceGate[4];		/* Voice enable masks, see SetChannelMask (not part of the state) */
+
+		TC::DeviceStats	m_Stats;
 	};
 } // namespace SNPSG
 
@@ -132,6 +132,11 @@ uint32_t SegaPCM::GetClockSpeed()
 	return m_ClockSpeed;
 }
 
+bool SegaPCM::GetStats(TC::StatsSnapshot& Stats)
+{
+	return m_Stats.Get(Stats);
+}
+
 void SegaPCM::Write(uint32_t Address, uint32_t Data)
 {	
 	Data &= 0xFF; /* 8-bit data bus */
@@ -141,6 +146,8 @@ void SegaPCM::Write(uint32_t Address, uint32_t Data)
 	auto Bank     = TC::GetBit(Address, 7u);
 	auto& Channel = m_Channel[Offset];
 
+	m_Stats.RegisterWrite(Address & 0xFF);
+
 	switch ((Bank << 3) | Register)
 	{
 	case 0x00: /* Current Address [7:0] (validation needed) */
@@ -180,6 +187,8 @@ void SegaPCM::Write(uint32_t Address, uint32_t Data)
 		break;
 
 	case 0x0E: /* Channel Control + Banking */
+		if (!Channel.On && !(Data & 0x01)) m_Stats.KeyOn();
+
 		Channel.On   = (Data & 0x01) ? 0 : ~0;
 		Channel.Loop = (Data & 0x02) ? 0 : ~0;
 		Channel.Bank = (Data & m_BankMask) << m_BankShift;
@@ -201,47 +210,128 @@ void SegaPCM::Update(uint32_t ClockCycles, std::vector<IAudioBuffer*>& OutBuffer
 	uint32_t Samples = TotalCycles / m_ClockDivider;
 	m_CyclesToDo = TotalCycles % m_ClockDivider;
 
-	int32_t OutL;
-	int32_t OutR;
-	int8_t PCM;
+	TC::DeviceStats::UpdateScope Stats(m_Stats, Samples);
+
+	AudioBlock<int16_t> Block(OutBuffer[AudioOut::Default]);
 
-	while (Samples--)
+	int32_t OutL[BlockFrames];
+	int32_t OutR[BlockFrames];
+
+	while (Samples != 0)
 	{
-		OutL = 0;
-		OutR = 0;
+		uint32_t Frames = std::min(Samples, BlockFrames);
+
+		std::fill_n(OutL, Frames, 0);
+		std::fill_n(OutR, Frames, 0);
 
-		for (auto& Channel : m_Channel)
+		for (auto& Channel : m_Channel) RenderChannel(Channel, Frames, OutL, OutR);
+
+		for (uint32_t i = 0; i < Frames; i++)
 		{
-			/* Load PCM data, convert from 8-bit unsigned to signed */
-			PCM = (m_Memory[Channel.Bank | (Channel.Addr.u32 >> 8)] ^ 0x80) & Channel.On;
+			/* Limiter (signed 16-bit) */
+			//OutL[i] = std::clamp(OutL[i], -32768, 32767);
+			//OutR[i] = std::clamp(OutR[i], -32768, 32767);
 
-			/* Increase address counter (16.8 fixed point) */
-			Channel.Addr = (Channel.Addr.u32 + Channel.Delta) & 0x00FFFFFF;
+			//TODO: Implement National Semiconductor DAC1022 (or similar 10-bit DAC) 
+			Block.Write((int16_t)OutL[i]);
+			Block.Write((int16_t)OutR[i]);
+		}
+
+		Samples -= Frames;
+	}
+
+	Stats.ActiveVoices([&] { return std::count_if(std::begin(m_Channel), std::end(m_Channel), [](auto& Channel) { return Channel.On != 0; }); });
+}
 
-			if (Channel.Addr.u8hl == Channel.EndAddr)
+void SegaPCM::RenderChannel(channel_t& Channel, uint32_t Frames, int32_t* OutL, int32_t* OutR)
+{
+	/* The bank bits above the 16-bit address select the memory block, the lower bits are or'ed with the address */
+	const uint8_t* Wave = m_Memory.data() + (Channel.Bank & ~0xFFFF);
+	uint32_t BankLow = Channel.Bank & 0xFFFF;
+	uint32_t Frame = 0;
+
+	while (Frame < Frames)
+	{
+		uint32_t Address = Channel.Addr.u32;
+
+		/*
+			Run: the samples before the address counter enters the end address page, the counter advances
+			less than a page per sample so it can't skip it. The sample that enters the page is done on its own
+		*/
+		uint32_t Run = 0;
+
+		if ((Channel.Delta != 0) && ((Address >> 16) != Channel.EndAddr))
+		{
+			uint32_t Distance = ((Channel.EndAddr << 16) - Address) & 0x00FFFFFF;
+
+			Run = std::min(Frames - Frame, ((Distance + Channel.Delta - 1) / Channel.Delta) - 1);
+		}
+		else if (Channel.Delta == 0)
+		{
+			/* The address counter doesn't move */
+			Run = ((Address >> 16) != Channel.EndAddr) ? Frames - Frame : 0;
+		}
+
+		if (Run != 0)
+		{
+			/* Channels that are off (or panned out) only advance their address counter */
+			if (Channel.On && (Channel.PanL | Channel.PanR))
 			{
-				/* Load loop address */
-				Channel.Addr = Channel.LoopAddr.u32 | (Channel.Addr.u32 & 0xFF); /* Do we need to keep the 16.8 fractional part ? */
-				
-				/* Disable sound generation (if not looping) */
-				Channel.On &= Channel.Loop;
+				for (uint32_t i = Frame; i < Frame + Run; i++)
+				{
+					/* Load PCM data, convert from 8-bit unsigned to signed */
+					int8_t PCM = Wave[((Address >> 8) & 0xFFFF) | BankLow] ^ 0x80;
+					Address += Channel.Delta;
+
+					/* Apply panning and accumulate in output buffer */
+					OutL[i] += (PCM * Channel.PanL);
+					OutR[i] += (PCM * Channel.PanR);
+				}
 			}
 
-			/* Apply panning and accumulate in output buffer */
-			OutL += (PCM * Channel.PanL);
-			OutR += (PCM * Channel.PanR);
+			/* Increase address counter (16.8 fixed point) */
+			Channel.Addr = (Channel.Addr.u32 + (Run * Channel.Delta)) & 0x00FFFFFF;
+
+			Frame += Run;
+			continue;
 		}
 
-		/* Limiter (signed 16-bit) */
-		//OutL = std::clamp(OutL, -32768, 32767);
-		//OutR = std::clamp(OutR, -32768, 32767);
+		/* Load PCM data, convert from 8-bit unsigned to signed */
+		int8_t PCM = (Wave[((Address >> 8) & 0xFFFF) | BankLow] ^ 0x80) & Channel.On;
 
-		//TODO: Implement National Semiconductor DAC1022 (or similar 10-bit DAC) 
-		OutBuffer[AudioOut::Default]->WriteSampleS16(OutL);
-		OutBuffer[AudioOut::Default]->WriteSampleS16(OutR);
+		/* Increase address counter (16.8 fixed point) */
+		Channel.Addr = (Address + Channel.Delta) & 0x00FFFFFF;
+
+		if (Channel.Addr.u8hl == Channel.EndAddr)
+		{
+			/* Load loop address */
+			Channel.Addr = Channel.LoopAddr.u32 | (Channel.Addr.u32 & 0xFF); /* Do we need to keep the 16.8 fractional part ? */
+			
+			/* Disable sound generation (if not looping) */
+			Channel.On &= Channel.Loop;
+		}
+
+		/* Apply panning and accumulate in output buffer */
+		OutL[Frame] += (PCM * Channel.PanL);
+		OutR[Frame] += (PCM * Channel.PanR);
+
+		Frame++;
 	}
 }
 
+uint32_t SegaPCM::GetCyclesForFrames(uint32_t OutputNr, uint32_t Frames)
+{
+	/* All outputs run at the same rate */
+	return CyclesForFrames(Frames, m_ClockDivider, m_CyclesToDo);
+}
+
+bool SegaPCM::IsSilent()
+{
+	for (auto& Channel : m_Channel) if (Channel.On != 0) return false;
+
+	return true;
+}
+
 void SegaPCM::CopyToMemory(uint32_t MemoryID, size_t Offset, uint8_t* Data, size_t Size)
 {
 	if ((Offset + Size) > m_Memory.size()) return;
@@ -253,4 +343,35 @@ void SegaPCM::CopyToMemoryIndirect(uint32_t MemoryID, size_t Offset, uint8_t* Da
 {
 	/* No specialized implementation needed */
 	CopyToMemory(MemoryID, Offset, Data, Size);
+}
+
+size_t SegaPCM::GetMemorySize(uint32_t MemoryID)
+{
+	/* The fitted memory is set by the bank flags (see constructor) */
+	return m_Memory.size();
+}
+
+size_t SegaPCM::GetResidentSize()
+{
+	return m_Memory.capacity();
+}
+
+void SegaPCM::SaveState(StateWriter& State)
+{
+	State.BeginChunk("SPCM", 1);
+
+	State.Write(m_Channel);
+	State.Write(m_CyclesToDo);
+
+	State.EndChunk();
+}
+
+bool SegaPCM::LoadState(StateReader& State)
+{
+	if (!State.BeginChunk("SPCM", 1)) return false;
+
+	State.Read(m_Channel);
+	State.Read(m_CyclesToDo);
+
+	return State.EndChunk();
 }
\ No newline at end of file
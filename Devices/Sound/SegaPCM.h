@@ -16,9 +16,10 @@ See LICENSE.txt in the root directory of this source tree.
 
 #include "../../Interfaces/ISoundDevice.h"
 #include "../../Interfaces/IMemoryAccess.h"
+#include "../../Interfaces/IStateAccess.h"
 
 /* SegaPCM (315-5218) */
-class SegaPCM : public ISoundDevice, public IMemoryAccess
+class SegaPCM : public ISoundDevice, public IMemoryAccess, public IStateAccess
 {
 public:
 	SegaPCM(uint32_t ClockSpeed = 16'000'000, uint32_t BankFlags = 0);
@@ -35,10 +36,19 @@ public:
 	uint32_t		GetClockSpeed();
 	void			Write(uint32_t Address, uint32_t Data);
 	void			Update(uint32_t ClockCycles, std::vector<IAudioBuffer*>& OutBuffer);
+	uint32_t		GetCyclesForFrames(uint32_t OutputNr, uint32_t Frames);
+	bool			IsSilent();
+	bool			GetStats(TC::StatsSnapshot& Stats);
 
 	/* IMemoryAccess methods */
 	void			CopyToMemory(uint32_t MemoryID, size_t Offset, uint8_t* Data, size_t Size);
 	void			CopyToMemoryIndirect(uint32_t MemoryID, size_t Offset, uint8_t* Data, size_t Size);
+	size_t			GetMemorySize(uint32_t MemoryID);
+	size_t			GetResidentSize();
+
+	/* IStateAccess methods */
+	void			SaveState(StateWriter& State);
+	bool			LoadState(StateReader& State);
 
 private:
 	static const std::wstring s_DeviceName;
@@ -57,6 +67,11 @@ private:
 		uint8_t		EndAddr;	/* End address (8-bit) */
 	};
 
+	/* Frames mixed per block */
+	static constexpr uint32_t BlockFrames = 256;
+
+	void		RenderChannel(channel_t& Channel, uint32_t Frames, int32_t* OutL, int32_t* OutR);
+
 	channel_t	m_Channel[16];
 	uint32_t	m_BankShift;
 	uint32_t	m_BankMask;
@@ -64,6 +79,7 @@ private:
 	uint32_t	m_ClockSpeed;
 	uint32_t	m_ClockDivider;
 	uint32_t	m_CyclesToDo;
+	TC::DeviceStats	m_Stats;
 
 	std::vector<uint8_t> m_Memory;
 };
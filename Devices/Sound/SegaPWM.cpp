@@ -34,6 +34,13 @@ See LICENSE.txt in the root directory of this source tree.
 	- When the cycle register is set to 1, no sound will be output
 	- Pulse width can not exceed the cycle time;
 
+	FIFO emulation:
+	---------------
+	Pulse width writes go into the FIFOs, at the start of every PWM cycle (CycleReg clock cycles)
+	the next value is pulled from each FIFO. Register writes can be tagged with a clock cycle (WriteAt),
+	Update applies them at the output sample they fall in, so a single Update call renders the
+	waveform of any number of writes.
+
 	Cheat sheet:
 	------------
 
@@ -57,8 +64,13 @@ See LICENSE.txt in the root directory of this source tree.
 
 SEGAPWM::SEGAPWM(uint32_t ClockSpeed) :
 	m_ClockSpeed(ClockSpeed),
-	m_ClockDivider(MAX_DIV)
+	m_ClockDivider(MAX_DIV),
+	m_DacRegister(0x04),
+	m_Head(0),
+	m_Sorted(true)
 {
+	m_Events.reserve(1024);
+
 	Reset(ResetType::PowerOnDefaults);
 }
 
@@ -78,6 +90,16 @@ void SEGAPWM::Reset(ResetType Type)
 
 	m_BaseLineL = 0;
 	m_BaseLineR = 0;
+
+	m_FifoL = {};
+	m_FifoR = {};
+	m_PwmCycles = 0;
+
+	m_Events.clear();
+	m_Head = 0;
+	m_Sorted = true;
+
+	m_DacStream.Stop();
 }
 
 void SEGAPWM::SendExclusiveCommand(uint32_t Command, uint32_t Value)
@@ -91,7 +113,7 @@ bool SEGAPWM::EnumAudioOutputs(uint32_t OutputNr, AUDIO_OUTPUT_DESC& Desc)
 	if (OutputNr == 0)
 	{
 		Desc.SampleRate = m_ClockSpeed / m_ClockDivider;
-		Desc.SampleFormat = 0;
+		Desc.SampleFormat = AudioFormat::AUDIO_FMT_S16;
 		Desc.Channels = 2;
 		Desc.ChannelMask = SPEAKER_FRONT_LEFT | SPEAKER_FRONT_RIGHT;
 		Desc.Description = L"";
@@ -112,10 +134,17 @@ uint32_t SEGAPWM::GetClockSpeed()
 	return m_ClockSpeed;
 }
 
+bool SEGAPWM::GetStats(TC::StatsSnapshot& Stats)
+{
+	return m_Stats.Get(Stats);
+}
+
 void SEGAPWM::Write(uint32_t Address, uint32_t Data)
 {	
 	Data &= 0xFFF;
 	
+	m_Stats.RegisterWrite(Address & 0x0F);
+
 	switch (Address & 0x0F)
 	{
 		/* PWM Control Register (MD: A15130H, SH2: 20004030H) */
@@ -134,18 +163,18 @@ void SEGAPWM::Write(uint32_t Address, uint32_t Data)
 
 		/* Lch Pulse Width Register (MD: A15134H, SH2: 20004034H) */
 		case 0x02:
-			m_PulseWidthL = Data;
+			PushFifo(m_FifoL, Data);
 			break;
 
 		/* Rch Pulse Width Register (MD: A15136H, SH2: 20004036H) */
 		case 0x03:
-			m_PulseWidthR = Data;
+			PushFifo(m_FifoR, Data);
 			break;
 
 		/* Mono Pulse Width Register (MD: A15138H, SH2: 20004038H) */
 		case 0x04:
-			m_PulseWidthL = Data;
-			m_PulseWidthR = Data;
+			PushFifo(m_FifoL, Data);
+			PushFifo(m_FifoR, Data);
 			break;
 
 		default:
@@ -153,68 +182,257 @@ void SEGAPWM::Write(uint32_t Address, uint32_t Data)
 	}
 }
 
+void SEGAPWM::WriteAt(uint32_t ClockCycle, uint32_t Address, uint32_t Data)
+{
+	if ((m_Events.size() > m_Head) && (m_Events.back().ClockCycle > ClockCycle)) m_Sorted = false;
+
+	m_Events.push_back({ ClockCycle, Address, Data });
+}
+
 void SEGAPWM::Update(uint32_t ClockCycles, std::vector<IAudioBuffer*>& OutBuffer)
 {
+	/* End of the first sample, relative to the start of this call (event timestamps) */
+	int64_t SampleEnd = (int64_t)m_ClockDivider - m_CyclesToDo;
+
 	uint32_t TotalCycles = ClockCycles + m_CyclesToDo;
 	uint32_t Samples = TotalCycles / m_ClockDivider;
 	m_CyclesToDo = TotalCycles % m_ClockDivider;
 
+	TC::DeviceStats::UpdateScope Stats(m_Stats, Samples);
+	Stats.ActiveVoices([&] { return (m_CycleReg != 0) ? 2 : 0; }); /* Both PWM channels run while the cycle register is set */
+
+	AudioBlock<int16_t> Block(OutBuffer[0]);
+
 	int16_t OutL = 0;
 	int16_t OutR = 0;
+	uint32_t Value = 0;
+
+	UpdateOutput(OutL, OutR);
+
+	if (m_DacStream.IsActive()) m_DacStream.Prepare(m_ClockSpeed, m_ClockDivider);
 
-	if (m_CycleReg != 0)
+	if (!m_Sorted)
 	{
-		int16_t LMD = 0;
-		int16_t RMD = 0;
-		
-		/* Calculate zero/base line (use first sample written to avoid clicks) */
-		if (m_BaseLineL == 0) m_BaseLineL = m_PulseWidthL;
-		if (m_BaseLineR == 0) m_BaseLineR = m_PulseWidthR;
-		
-		/* Convert pulse width into 16-bit signed output */
-		if (m_BaseLineL) LMD = ((m_PulseWidthL - m_BaseLineL) * 0x7FFF) / m_BaseLineL;
-		if (m_BaseLineR) RMD = ((m_PulseWidthR - m_BaseLineR) * 0x7FFF) / m_BaseLineR;
-
-		/* Output mapping */
-		switch (m_PwmControl & 0x0F)
+		/* Keep queue order for writes sharing a timestamp */
+		std::stable_sort(m_Events.begin() + m_Head, m_Events.end(),
+			[](const event_t& a, const event_t& b) { return a.ClockCycle < b.ClockCycle; });
+
+		m_Sorted = true;
+	}
+
+	while (Samples-- != 0)
+	{
+		bool Changed = false;
+
+		/* Timestamped writes that fall in this sample */
+		while ((m_Head < m_Events.size()) && (m_Events[m_Head].ClockCycle < SampleEnd))
 		{
-		case 0x00: /* RMD = OFF, LMD = OFF (undocumented) */
-		case 0x05: /* RMD = R, LMD = L */
-			OutL = LMD;
-			OutR = RMD;
-			break;
+			Write(m_Events[m_Head].Address, m_Events[m_Head].Data);
+			m_Head++;
+			Changed = true;
+		}
 
-		case 0x01: /* RMD = OFF, LMD = L */
-			OutL = LMD;
-			break;
+		/* DAC stream data, applied like a register write */
+		if (m_DacStream.IsActive() && m_DacStream.Tick(Value))
+		{
+			Write(m_DacRegister, Value);
+			Changed = true;
+		}
 
-		case 0x02: /* RMD = OFF, LMD = R */
-			OutR = LMD;
-			break;
+		/* Start of a PWM cycle, pull the next pulse widths */
+		if (m_CycleReg != 0)
+		{
+			for (m_PwmCycles += m_ClockDivider; m_PwmCycles >= m_CycleReg; m_PwmCycles -= m_CycleReg)
+			{
+				Changed |= PullFifo(m_FifoL, m_PulseWidthL);
+				Changed |= PullFifo(m_FifoR, m_PulseWidthR);
+			}
+		}
 
-		case 0x04: /* RMD = R, LMD = OFF */
-			OutR = RMD;
-			break;
+		if (Changed) UpdateOutput(OutL, OutR);
 
-		case 0x08: /* RMD = L, LMD = OFF */
-			OutL = RMD;
-			break;
+		/* 16-bit DAC output (interleaved) */
+		Block.Write(OutL);
+		Block.Write(OutR);
 
-		case 0x0A: /* RMD = L, LMD = R */
-			OutL = RMD;
-			OutR = LMD;
-			break;
+		SampleEnd += m_ClockDivider;
+	}
 
-		default:
-			__debugbreak();
-			break;
-		}
+	/* Drop the applied writes and rebase the remaining ones, writes in the partial sample go to the next sample */
+	m_Events.erase(m_Events.begin(), m_Events.begin() + m_Head);
+	m_Head = 0;
+
+	for (auto& Event : m_Events)
+	{
+		Event.ClockCycle = (Event.ClockCycle > ClockCycles) ? Event.ClockCycle - ClockCycles : 0;
 	}
+}
 
-	while (Samples-- != 0)
+uint32_t SEGAPWM::GetCyclesForFrames(uint32_t OutputNr, uint32_t Frames)
+{
+	/* All outputs run at the same rate */
+	return CyclesForFrames(Frames, m_ClockDivider, m_CyclesToDo);
+}
+
+void SEGAPWM::UpdateOutput(int16_t& OutL, int16_t& OutR)
+{
+	OutL = 0;
+	OutR = 0;
+
+	if (m_CycleReg == 0) return;
+
+	int16_t LMD = 0;
+	int16_t RMD = 0;
+	
+	/* Calculate zero/base line (use first sample written to avoid clicks) */
+	if (m_BaseLineL == 0) m_BaseLineL = m_PulseWidthL;
+	if (m_BaseLineR == 0) m_BaseLineR = m_PulseWidthR;
+	
+	/* Convert pulse width into 16-bit signed output */
+	if (m_BaseLineL) LMD = ((m_PulseWidthL - m_BaseLineL) * 0x7FFF) / m_BaseLineL;
+	if (m_BaseLineR) RMD = ((m_PulseWidthR - m_BaseLineR) * 0x7FFF) / m_BaseLineR;
+
+	/* Output mapping */
+	switch (m_PwmControl & 0x0F)
 	{
-		/* 16-bit DAC output (interleaved) */
-		OutBuffer[0]->WriteSampleS16(OutL);
-		OutBuffer[0]->WriteSampleS16(OutR);
+	case 0x00: /* RMD = OFF, LMD = OFF (undocumented) */
+	case 0x05: /* RMD = R, LMD = L */
+		OutL = LMD;
+		OutR = RMD;
+		break;
+
+	case 0x01: /* RMD = OFF, LMD = L */
+		OutL = LMD;
+		break;
+
+	case 0x02: /* RMD = OFF, LMD = R */
+		OutR = LMD;
+		break;
+
+	case 0x04: /* RMD = R, LMD = OFF */
+		OutR = RMD;
+		break;
+
+	case 0x08: /* RMD = L, LMD = OFF */
+		OutL = RMD;
+		break;
+
+	case 0x0A: /* RMD = L, LMD = R */
+		OutL = RMD;
+		OutR = LMD;
+		break;
+
+	default:
+		__debugbreak();
+		break;
+	}
+}
+
+void SEGAPWM::PushFifo(fifo_t& Fifo, int16_t Data)
+{
+	/* A full FIFO discards the oldest data */
+	if (Fifo.Count == 3)
+	{
+		Fifo.Data[0] = Fifo.Data[1];
+		Fifo.Data[1] = Fifo.Data[2];
+		Fifo.Count--;
 	}
+
+	Fifo.Data[Fifo.Count++] = Data;
+}
+
+bool SEGAPWM::PullFifo(fifo_t& Fifo, int16_t& Data)
+{
+	/* An empty FIFO keeps the last pulled value */
+	if (Fifo.Count == 0) return false;
+
+	Data = Fifo.Data[0];
+	Fifo.Data[0] = Fifo.Data[1];
+	Fifo.Data[1] = Fifo.Data[2];
+	Fifo.Count--;
+
+	return true;
+}
+
+void SEGAPWM::SaveState(StateWriter& State)
+{
+	State.BeginChunk("SPWM", 2);
+
+	State.Write(m_PwmControl);
+	State.Write(m_CycleReg);
+	State.Write(m_PulseWidthL);
+	State.Write(m_PulseWidthR);
+	State.Write(m_BaseLineL);
+	State.Write(m_BaseLineR);
+	State.Write(m_FifoL);
+	State.Write(m_FifoR);
+	State.Write(m_PwmCycles);
+	State.Write(m_CyclesToDo);
+
+	/* Pending timestamped writes */
+	uint32_t Pending = (uint32_t)(m_Events.size() - m_Head);
+
+	State.Write(Pending);
+	State.Write(m_Events.data() + m_Head, Pending * sizeof(event_t));
+
+	State.EndChunk();
+}
+
+bool SEGAPWM::LoadState(StateReader& State)
+{
+	if (!State.BeginChunk("SPWM", 2)) return false;
+
+	State.Read(m_PwmControl);
+	State.Read(m_CycleReg);
+	State.Read(m_PulseWidthL);
+	State.Read(m_PulseWidthR);
+	State.Read(m_BaseLineL);
+	State.Read(m_BaseLineR);
+	State.Read(m_FifoL);
+	State.Read(m_FifoR);
+	State.Read(m_PwmCycles);
+	State.Read(m_CyclesToDo);
+
+	uint32_t Pending = 0;
+
+	State.Read(Pending);
+
+	/* Timestamps are relative to the next Update call, the writes are kept in order */
+	m_Events.clear();
+	m_Head = 0;
+	m_Sorted = true;
+
+	for (uint32_t i = 0; (i < Pending) && !State.Failed(); i++)
+	{
+		event_t Event = {};
+
+		State.Read(Event);
+		m_Events.push_back(Event);
+	}
+
+	return State.EndChunk();
+}
+
+bool SEGAPWM::StartDacStream(const DAC_STREAM_DESC& Desc)
+{
+	if ((Desc.Register & 0x0F) > 0x04) return false;
+
+	m_DacRegister = Desc.Register & 0x0F;
+
+	return m_DacStream.Start(Desc, 2);
+}
+
+void SEGAPWM::StopDacStream()
+{
+	m_DacStream.Stop();
+}
+
+void SEGAPWM::SetDacStreamFrequency(uint32_t Frequency)
+{
+	m_DacStream.SetFrequency(Frequency);
+}
+
+bool SEGAPWM::IsDacStreamActive()
+{
+	return m_DacStream.IsActive();
 }
\ No newline at end of file
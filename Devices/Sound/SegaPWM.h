@@ -15,9 +15,11 @@ See LICENSE.txt in the root directory of this source tree.
 #define _SEGAPWM_H_
 
 #include "../../Interfaces/ISoundDevice.h"
+#include "../../Interfaces/IDacStream.h"
+#include "../../Interfaces/IStateAccess.h"
 
 /* Sega 32X PWM */
-class SEGAPWM : public ISoundDevice
+class SEGAPWM : public ISoundDevice, public IStateAccess, public IDacStream
 {
 public:
 	SEGAPWM(uint32_t ClockSpeed = 23011360);
@@ -34,18 +36,68 @@ public:
 	uint32_t		GetClockSpeed();
 	void			Write(uint32_t Address, uint32_t Data);
 	void			Update(uint32_t ClockCycles, std::vector<IAudioBuffer*>& OutBuffer);
+	uint32_t		GetCyclesForFrames(uint32_t OutputNr, uint32_t Frames);
+	bool			GetStats(TC::StatsSnapshot& Stats);
+
+	/* IStateAccess methods */
+	void			SaveState(StateWriter& State);
+	bool			LoadState(StateReader& State);
+
+	/* IDacStream methods (registers 0x00 - 0x04, 12-bit samples) */
+	bool			StartDacStream(const DAC_STREAM_DESC& Desc);
+	void			StopDacStream();
+	void			SetDacStreamFrequency(uint32_t Frequency);
+	bool			IsDacStreamActive();
+
+	/* Register write at a given clock cycle, relative to the start of the next Update call
+	   The write is applied when Update reaches that cycle, so a host can queue all writes of a frame
+	   (eg. 32X PCM streamed through the pulse width registers) and render it with a single Update call.
+	   Writes with the same timestamp are applied in order, writes beyond the end of an Update call are
+	   kept for the next one */
+	void			WriteAt(uint32_t ClockCycle, uint32_t Address, uint32_t Data);
 
 private:
+	/* 3-step pulse width FIFO */
+	struct fifo_t
+	{
+		int16_t		Data[3];
+		uint32_t	Count;
+	};
+
+	/* Timestamped register write (see WriteAt) */
+	struct event_t
+	{
+		uint32_t	ClockCycle;
+		uint32_t	Address;
+		uint32_t	Data;
+	};
+
+	void		UpdateOutput(int16_t& OutL, int16_t& OutR);
+	void		PushFifo(fifo_t& Fifo, int16_t Data);
+	bool		PullFifo(fifo_t& Fifo, int16_t& Data);
+
 	uint32_t	m_PwmControl;		/* PWM Control Register */
 	uint32_t	m_CycleReg;			/* Cycle Register */
 	 int16_t	m_PulseWidthL;		/* Pulse Width L Register */
 	 int16_t	m_PulseWidthR;		/* Pulse Width R Register */
 	 int16_t	m_BaseLineL;
 	 int16_t	m_BaseLineR;
+
+	fifo_t		m_FifoL;			/* Pulse width FIFO L */
+	fifo_t		m_FifoR;			/* Pulse width FIFO R */
+	uint32_t	m_PwmCycles;		/* Clock cycles into the current PWM cycle */
+
+	std::vector<event_t> m_Events;	/* Timestamped register writes */
+	size_t		m_Head;				/* First pending write */
+	bool		m_Sorted;			/* Writes were queued in order */
+
+	DacStream	m_DacStream;		/* Pulse width data stream */
+	uint32_t	m_DacRegister;		/* Stream destination register */
 	
 	uint32_t	m_ClockSpeed;
 	uint32_t	m_ClockDivider;
 	uint32_t	m_CyclesToDo;
+	TC::DeviceStats	m_Stats;
 };
 
 #endif // !_SEGAPWM_H_
\ No newline at end of file
@@ -0,0 +1,99 @@
+/*
+ _____    _ _            ___
+|_   _| _(_) |_ ___ _ _ / __|___ _ _ ___
+  | || '_| |  _/ _ \ ' \ (__/ _ \ '_/ -_)
+  |_||_| |_|\__\___/_||_\___\___/_| \___|
+
+Copyright  2024, Michel Gerritse
+All rights reserved.
+
+This source code is available under the BSD-3-Clause license.
+See LICENSE.txt in the root directory of this source tree.
+
+*/
+#include "WriteQueue.h"
+
+/*
+	Timestamped register write queue
+
+	Instead of interleaving ISoundDevice::Write() and very short Update() calls,
+	a host queues its writes tagged with a clock cycle and then calls Update() once.
+	The queue renders the device in slices between the queued events, the device
+	keeps track of partial samples through its own m_CyclesToDo bookkeeping.
+
+	- Timestamps are in device clock cycles, relative to the start of the next Update call
+	- Writes with the same timestamp are applied in the order they were queued
+	- Writes beyond the end of an Update call are kept and rebased for the next call
+*/
+
+WriteQueue::WriteQueue(ISoundDevice* Device) :
+	m_Device(Device),
+	m_Head(0),
+	m_Sorted(true)
+{
+	m_Events.reserve(1024);
+}
+
+void WriteQueue::Write(uint32_t ClockCycle, uint32_t Address, uint32_t Data)
+{
+	if ((m_Events.size() > m_Head) && (m_Events.back().ClockCycle > ClockCycle)) m_Sorted = false;
+
+	m_Events.push_back({ ClockCycle, Address, Data });
+}
+
+void WriteQueue::Update(uint32_t ClockCycles, std::vector<IAudioBuffer*>& OutBuffer)
+{
+	if (!m_Sorted)
+	{
+		/* Keep queue order for writes sharing a timestamp */
+		std::stable_sort(m_Events.begin() + m_Head, m_Events.end(),
+			[](const event_t& a, const event_t& b) { return a.ClockCycle < b.ClockCycle; });
+
+		m_Sorted = true;
+	}
+
+	uint32_t Time = 0;
+
+	while ((m_Head < m_Events.size()) && (m_Events[m_Head].ClockCycle < ClockCycles))
+	{
+		uint32_t EventTime = m_Events[m_Head].ClockCycle;
+
+		/* Render up to the event */
+		if (EventTime > Time)
+		{
+			m_Device->Update(EventTime - Time, OutBuffer);
+			Time = EventTime;
+		}
+
+		/* Apply all writes sharing this timestamp */
+		while ((m_Head < m_Events.size()) && (m_Events[m_Head].ClockCycle == EventTime))
+		{
+			m_Device->Write(m_Events[m_Head].Address, m_Events[m_Head].Data);
+			m_Head++;
+		}
+	}
+
+	/* Render the remainder */
+	if (ClockCycles > Time) m_Device->Update(ClockCycles - Time, OutBuffer);
+
+	/* Drop consumed events and rebase the remaining ones */
+	m_Events.erase(m_Events.begin(), m_Events.begin() + m_Head);
+	m_Head = 0;
+
+	for (auto& Event : m_Events)
+	{
+		Event.ClockCycle -= ClockCycles;
+	}
+}
+
+void WriteQueue::Clear()
+{
+	m_Events.clear();
+	m_Head = 0;
+	m_Sorted = true;
+}
+
+size_t WriteQueue::GetPendingCount() const
+{
+	return m_Events.size() - m_Head;
+}
\ No newline at end of file
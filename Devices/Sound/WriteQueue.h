@@ -0,0 +1,51 @@
+/*
+ _____    _ _            ___
+|_   _| _(_) |_ ___ _ _ / __|___ _ _ ___
+  | || '_| |  _/ _ \ ' \ (__/ _ \ '_/ -_)
+  |_||_| |_|\__\___/_||_\___\___/_| \___|
+
+Copyright  2024, Michel Gerritse
+All rights reserved.
+
+This source code is available under the BSD-3-Clause license.
+See LICENSE.txt in the root directory of this source tree.
+
+*/
+#ifndef _WRITE_QUEUE_H_
+#define _WRITE_QUEUE_H_
+
+#include "../../Interfaces/ISoundDevice.h"
+
+/* Timestamped register write queue */
+class WriteQueue
+{
+public:
+	WriteQueue(ISoundDevice* Device);
+	~WriteQueue() = default;
+
+	/* Queue a register write at a given clock cycle (relative to the next Update call) */
+	void	Write(uint32_t ClockCycle, uint32_t Address, uint32_t Data);
+
+	/* Render ClockCycles, applying the queued writes at their timestamps */
+	void	Update(uint32_t ClockCycles, std::vector<IAudioBuffer*>& OutBuffer);
+
+	/* Drop all pending writes */
+	void	Clear();
+
+	size_t	GetPendingCount() const;
+
+private:
+	struct event_t
+	{
+		uint32_t	ClockCycle;
+		uint32_t	Address;
+		uint32_t	Data;
+	};
+
+	ISoundDevice*			m_Device;
+	std::vector<event_t>	m_Events;
+	size_t					m_Head;			/* First pending event */
+	bool					m_Sorted;		/* Events were queued in order */
+};
+
+#endif // !_WRITE_QUEUE_H_
\ No newline at end of file
@@ -21,9 +21,6 @@ See LICENSE.txt in the root directory of this source tree.
 #define FLAG_PCMBUSY	0x01	/* ADPCM-B busy */
 #define FLAG_BRDY		0x08	/* ADPCM-B bus ready */
 #define FLAG_EOS		0x10	/* ADPCM-B end of sample */
-#define FLAG_TIMER2		0x20	/* Timer 2 overflow */
-#define FLAG_TIMER1		0x40	/* Timer 1 overflow */
-#define FLAG_IRQ		0x80	/* Interrupt request */
 
 /* ADPCM-B control register 1 bits */
 #define CTRL1_RESET		0x01
@@ -45,52 +42,17 @@ enum AudioOut
 	Default = 0
 };
 
-/* Slot naming */
-enum SlotName
-{
-	S1 = 0,	/* Modulator */
-	S2		/* Carrier   */
-};
-
-/* Channel naming */
-enum ChannelName
-{
-	CH1 = 0, CH2, CH3, CH4, CH5, CH6, CH7, CH8, CH9
-};
-
-/* Envelope phases */
-enum ADSR : uint32_t
-{
-	Attack = 0,
-	Decay,
-	Sustain,
-	Release
-};
-
-/* Drum instruments */
-enum Rhythm : uint32_t
-{
-	BD1 = 12,	/* Bass drum 1 (CH7 - S1) */
-	BD2 = 13,	/* Bass drum 2 (CH7 - S2) */
-	HH  = 14,	/* High hat    (CH8 - S1) */
-	SD  = 15,	/* Snare drum  (CH8 - S2) */
-	TOM = 16,	/* Tom tom     (CH9 - S1) */
-	CYM = 17	/* Top cymbal  (CH9 - S2) */
-};
-
 /* Static class member initialization */
 const std::wstring Y8950::s_DeviceName = L"Yamaha Y8950";
 
 Y8950::Y8950(uint32_t ClockSpeed) :
 	m_ClockSpeed(ClockSpeed),
-	m_ClockDivider(4 * 18)
+	m_ClockDivider(4 * 18),
+	m_Memory(0x40000)
 {
 	/* Create DAC */
 	m_DAC = std::make_unique<YM3014>();
 	
-	/* Build OPL tables */
-	YM::OPL::BuildTables();
-
 	/* Reset device */
 	Reset(ResetType::PowerOnDefaults);
 }
@@ -111,30 +73,10 @@ void Y8950::Reset(ResetType Type)
 	m_IoCtrl = 0;
 
 	/* Reset OPL unit */
-	memset(&m_OPL, 0, sizeof(m_OPL));
-
-	m_OPL.LfoAmShift = 4; /* 1.0dB */
-	m_OPL.LfoPmShift = 1; /* 7 cents */
-
-	m_OPL.NoiseLFSR = 1 << 22;
-
-	/* Default operator register state */
-	for (auto& Slot : m_OPL.Slot)
-	{
-		Slot.Multi = YM::OPL::Multiply[0]; /* x0.5 */
-
-		Slot.EgPhase = ADSR::Release;
-		Slot.EgLevel = YM::OPL::MaxAttenuation;
-		Slot.EgType = 1; /* non-percussive sound */
-
-		Slot.KeyScaling = 2;
-		Slot.KeyScaleShift = YM::OPL::KeyScaleShift[0];
-
-		Slot.WaveTable = &YM::OPL::WaveTable[0][0];
-	}
+	m_OPL.Reset();
 
 	/* Default flag mask */
-	SetStatusMask(FLAG_EOS | FLAG_BRDY);
+	m_OPL.SetStatusMask(FLAG_EOS | FLAG_BRDY);
 
 	/* Reset ADPCM-B unit */
 	memset(&m_ADPCMB, 0, sizeof(m_ADPCMB));
@@ -144,14 +86,19 @@ void Y8950::Reset(ResetType Type)
 	/* Reset ADPCM-B memory */
 	if (Type == ResetType::PowerOnDefaults)
 	{
-		m_Memory.fill(0);
+		m_Memory.Clear();
 	}
+
+	m_Irq.Set(m_OPL.IsIrqAsserted());
 }
 
 void Y8950::SendExclusiveCommand(uint32_t Command, uint32_t Value)
 {
-	Write(0x00, Command & 0xFF);
-	Write(0x01, Value);
+	/* Same as an address write followed by a data write */
+	m_AddressLatch = Command & 0xFF;
+
+	m_Stats.RegisterWrite(m_AddressLatch);
+	WriteRegisterArray(m_AddressLatch, Value & 0xFF);
 }
 
 bool Y8950::EnumAudioOutputs(uint32_t OutputNr, AUDIO_OUTPUT_DESC& Desc)
@@ -179,6 +126,11 @@ uint32_t Y8950::GetClockSpeed()
 	return m_ClockSpeed;
 }
 
+bool Y8950::GetStats(TC::StatsSnapshot& Stats)
+{
+	return m_Stats.Get(Stats);
+}
+
 uint32_t Y8950::Read(uint32_t Address)
 {
 	if ((Address & 0x01) == 0)
@@ -205,709 +157,315 @@ void Y8950::Write(uint32_t Address, uint32_t Data)
 	}
 	else /* Data write mode */
 	{
+		m_Stats.RegisterWrite(m_AddressLatch);
 		WriteRegisterArray(m_AddressLatch, Data);
 	}
 }
 
-void Y8950::WriteRegisterArray(uint8_t Address, uint8_t Data)
+bool Y8950::WriteBatch(uint32_t Port, const REGISTER_WRITE* Writes, size_t Count)
 {
-	/* Address to slot mapping */
-	static const int32_t SlotMap[32] =
-	{
-		 0,  2,  4,  1,  3,  5, -1, -1,
-		 6,  8, 10,  7,  9, 11, -1, -1,
-		12, 14, 16, 13, 15, 17, -1, -1,
-		-1, -1, -1, -1, -1, -1, -1, -1
-	};
-
-	/* Address to channel mapping */
-	static const int32_t ChannelMap[16] =
-	{
-		 CH1, CH2, CH3, CH4, CH5, CH6, CH7, CH8,
-		 CH9,  -1,  -1,  -1,  -1,  -1,  -1,  -1
-	};
+	if (Port != 0) return false; /* Single port */
+	if (Count == 0) return true;
 
-	switch (Address & 0xF0)
+	for (size_t i = 0; i < Count; i++)
 	{
-	case 0x00:
-	case 0x10: /* Mode / ADPCM-B data */
-		switch (Address & 0x1F)
-		{
-		case 0x01: /* LSI test */
-			m_OPL.LsiTest2 = (Data >> 2) & 0x01; /* Phase generator reset */
-			break;
-
-		case 0x02: /* Timer 1 */
-			m_OPL.Timer1.Period = Data;
-			break;
-
-		case 0x03: /* Timer 2 */
-			m_OPL.Timer2.Period = Data;
-			break;
-
-		case 0x04: /* IRQ reset / Timer control */
-		{
-			if (Data & 0x80)
-			{
-				ResetStatusFlag(FLAG_TIMER1 | FLAG_TIMER2 | FLAG_EOS | FLAG_BRDY);
-				return;
-			}
-
-			SetStatusMask(Data & (FLAG_TIMER1 | FLAG_TIMER2 | FLAG_EOS | FLAG_BRDY));
-
-			/* Timer 1 and 2 start / stop */
-			auto ST1 = (Data >> 0) & 0x01;
-			auto ST2 = (Data >> 1) & 0x01;
-
-			if (m_OPL.Timer1.Start ^ ST1)
-			{
-				m_OPL.Timer1.Start = ST1;
-				m_OPL.Timer1.Counter = 256 - m_OPL.Timer1.Period;
-			}
-
-			if (m_OPL.Timer2.Start ^ ST2)
-			{
-				m_OPL.Timer2.Start = ST2;
-				m_OPL.Timer2.Counter = 256 - m_OPL.Timer2.Period;
-			}
-			break;
-		}
-
-		case 0x05: /* Keyboard IN */
-			/* Read only */
-			break;
-
-		case 0x06: /* Keyboard OUT */
-			/* Not implemented */
-			break;
-
-		case 0x07: /* ADPCM-B control 1 */
-			m_ADPCMB.Ctrl1 = Data;
-
-			/* Reset internal ADPCM-B state */
-			if (Data & CTRL1_RESET)
-			{
-				ResetStatusFlag(FLAG_PCMBUSY | FLAG_EOS);
-				SetStatusFlag(FLAG_BRDY);
-				
-				m_ADPCMB.AddrDelta = 0;
-				m_ADPCMB.SignalT1 = 0;
-				m_ADPCMB.SignalT0 = 0;
-				m_ADPCMB.Step = 127;
-				m_ADPCMB.NibbleShift = 4;
-			}
-
-			/* Assert / clear the SPOFF pin (not implemented) */
-			//PinSPOFF = (Data & CTRL1_SPOFF) >> 1;
-
-			/* Start encoder / decoder */
-			if (Data & CTRL1_START)
-			{
-				SetStatusFlag(FLAG_PCMBUSY);
-
-				/* Reset address counter */
-				m_ADPCMB.Addr = (m_ADPCMB.Start.u32 & m_ADPCMB.Limit.u32) << m_ADPCMB.Shift;
-			}
-			break;
+		m_Stats.RegisterWrite(Writes[i].Register & 0xFF);
+		WriteRegisterArray(Writes[i].Register & 0xFF, Writes[i].Data & 0xFF);
+	}
 
-		case 0x08: /* CSM mode / Note select / ADPCM-B control 2 */
-			m_OPL.CSM		= (Data >> 7) & 0x01;
-			m_OPL.NTS		= (Data >> 6) & 0x01;
-			m_ADPCMB.Ctrl2	= (Data >> 0) & 0x0F;
+	/* The address latch holds the last register written */
+	m_AddressLatch = Writes[Count - 1].Register & 0xFF;
 
-			switch (Data & (CTRL2_64K | CTRL2_ROM))
-			{
-			case 0x00: /* 256Kb DRAM */
-				m_ADPCMB.Shift = 2;
-				m_ADPCMB.Limit = 0xFFFF;
-				break;
-
-			case 0x02: /* 64Kb DRAM */
-				m_ADPCMB.Shift = 2;
-				m_ADPCMB.Limit = 0x3FFF;
-				break;
-
-			case 0x01:
-			case 0x03: /* 256KB ROM */
-				m_ADPCMB.Shift = 5;
-				m_ADPCMB.Limit = 0x1FFF;
-				break;
+	return true;
+}
 
-			}
-			break;
+bool Y8950::WriteRegisters(uint32_t Port, uint32_t Register, const uint8_t* Data, size_t Count)
+{
+	if ((Port != 0) || ((Register + Count) > 0x100)) return false;
 
-		case 0x09: /* Start address (L) */
-			m_ADPCMB.Start.u8ll = Data;
-			break;
+	/* No latched registers, a dump is restored in register order */
+	for (size_t i = 0; i < Count; i++)
+	{
+		m_Stats.RegisterWrite(Register + i);
+		WriteRegisterArray(Register + i, Data[i]);
+	}
 
-		case 0x0A: /* Start address (H) */
-			m_ADPCMB.Start.u8lh = Data;
-			break;
+	return true;
+}
 
-		case 0x0B: /* Stop address (L) */
-			m_ADPCMB.Stop.u8ll = Data;
-			break;
+void Y8950::WriteRegisterArray(uint8_t Address, uint8_t Data)
+{
+	/* FM data */
+	if (Address >= 0x20)
+	{
+		m_OPL.Write(Address, Data);
+		return;
+	}
 
-		case 0x0C: /* Stop address (H) */
-			m_ADPCMB.Stop.u8lh = Data;
-			break;
+	switch (Address) /* Mode / ADPCM-B data */
+	{
+	case 0x01: /* LSI test */
+	case 0x02: /* Timer 1 */
+	case 0x03: /* Timer 2 */
+	case 0x04: /* IRQ reset / Timer control */
+		m_OPL.Write(Address, Data);
+		break;
 
-		case 0x0D: /* Prescale (L) */
-			m_ADPCMB.Prescale.u8ll = Data;
-			break;
+	case 0x05: /* Keyboard IN */
+		/* Read only */
+		break;
 
-		case 0x0E: /* Prescale (H) */
-			m_ADPCMB.Prescale.u8lh = Data & 0x07;
-			break;
+	case 0x06: /* Keyboard OUT */
+		/* Not implemented */
+		break;
 
-		case 0x0F: /* ADPCM data */
-			__debugbreak();
-			break;
+	case 0x07: /* ADPCM-B control 1 */
+		m_ADPCMB.Ctrl1 = Data;
 
-		case 0x10: /* Delta-N (L) */
-			m_ADPCMB.DeltaN.u8ll = Data;
-			break;
+		/* Reset internal ADPCM-B state */
+		if (Data & CTRL1_RESET)
+		{
+			m_OPL.ClearStatusFlags(FLAG_PCMBUSY | FLAG_EOS);
+			m_OPL.SetStatusFlags(FLAG_BRDY);
+			
+			m_ADPCMB.AddrDelta = 0;
+			m_ADPCMB.SignalT1 = 0;
+			m_ADPCMB.SignalT0 = 0;
+			m_ADPCMB.Step = 127;
+			m_ADPCMB.NibbleShift = 4;
+		}
 
-		case 0x11: /* Delta-N (H) */
-			m_ADPCMB.DeltaN.u8lh = Data;
-			break;
+		/* Assert / clear the SPOFF pin (not implemented) */
+		//PinSPOFF = (Data & CTRL1_SPOFF) >> 1;
 
-		case 0x12: /* Level control */
-			m_ADPCMB.LevelCtrl = Data;
-			break;
+		/* Start encoder / decoder */
+		if (Data & CTRL1_START)
+		{
+			m_OPL.SetStatusFlags(FLAG_PCMBUSY);
 
-		case 0x15: /* DAC data (H) */
-			__debugbreak();
-			break;
+			/* Reset address counter */
+			m_ADPCMB.Addr = (m_ADPCMB.Start.u32 & m_ADPCMB.Limit.u32) << m_ADPCMB.Shift;
 
-		case 0x16: /* DAC data (L) */
-			__debugbreak();
-			break;
+			m_Stats.KeyOn();
+		}
+		break;
 
-		case 0x17: /* Shift */
-			__debugbreak();
-			break;
+	case 0x08: /* CSM mode / Note select / ADPCM-B control 2 */
+		m_OPL.Write(Address, Data);
+		m_ADPCMB.Ctrl2 = (Data >> 0) & 0x0F;
 
-		case 0x18: /* I/O control */
-			m_IoCtrl = Data & 0x0F; /* 0 = input, 1 = output */
+		switch (Data & (CTRL2_64K | CTRL2_ROM))
+		{
+		case 0x00: /* 256Kb DRAM */
+			m_ADPCMB.Shift = 2;
+			m_ADPCMB.Limit = 0xFFFF;
 			break;
 
-		case 0x19: /* I/O data */
-			//if (m_IoCtrl & 0x01) TODO: output (Data >> 0) & 0x01 to IO port 0
-			//if (m_IoCtrl & 0x02) TODO: output (Data >> 1) & 0x01 to IO port 1
-			//if (m_IoCtrl & 0x04) TODO: output (Data >> 2) & 0x01 to IO port 2
-			//if (m_IoCtrl & 0x08) TODO: output (Data >> 3) & 0x01 to IO port 3
+		case 0x02: /* 64Kb DRAM */
+			m_ADPCMB.Shift = 2;
+			m_ADPCMB.Limit = 0x3FFF;
 			break;
 
-		case 0x1A: /* PCM data */
-			/* Read only */
+		case 0x01:
+		case 0x03: /* 256KB ROM */
+			m_ADPCMB.Shift = 5;
+			m_ADPCMB.Limit = 0x1FFF;
 			break;
 
-		default: /* Not used */
-			__debugbreak();
-			break;
 		}
 		break;
 
-	case 0x20:
-	case 0x30: /* AM / PM / EG-Type / KSR / Multiply */
-	{
-		int32_t SlotId = SlotMap[Address & 0x1F]; if (SlotId == -1) return;
-		auto& Slot = m_OPL.Slot[SlotId];
-
-		Slot.LfoAmOn = (Data & 0x80) ? ~0 : 0; /* Tremolo on / off mask */
-		Slot.LfoPmOn = (Data & 0x40) ? ~0 : 0; /* Vibrato on / off mask */
-
-		Slot.EgType     = (Data & 0x20) ? 0 : 1;
-		Slot.KeyScaling = (Data & 0x10) ? 0 : 2;
-
-		Slot.Multi = YM::OPL::Multiply[Data & 0x0F];
-
+	case 0x09: /* Start address (L) */
+		m_ADPCMB.Start.u8ll = Data;
 		break;
-	}
 
-	case 0x40:
-	case 0x50: /* KSL / Total level */
-	{
-		int32_t SlotId = SlotMap[Address & 0x1F]; if (SlotId == -1) return;
-		auto& Slot = m_OPL.Slot[SlotId];
-
-		Slot.KeyScaleShift = YM::OPL::KeyScaleShift[(Data >> 6) & 0x03];
-		Slot.TotalLevel = (Data >> 0) & 0x3F;
+	case 0x0A: /* Start address (H) */
+		m_ADPCMB.Start.u8lh = Data;
 		break;
-	}
 
-	case 0x60:
-	case 0x70: /* AR / DR */
-	{
-		int32_t SlotId = SlotMap[Address & 0x1F]; if (SlotId == -1) return;
-		auto& Slot = m_OPL.Slot[SlotId];
+	case 0x0B: /* Stop address (L) */
+		m_ADPCMB.Stop.u8ll = Data;
+		break;
 
-		Slot.EgRate[ADSR::Attack] = (Data >> 4) & 0x0F;
-		Slot.EgRate[ADSR::Decay]  = (Data >> 0) & 0x0F;
+	case 0x0C: /* Stop address (H) */
+		m_ADPCMB.Stop.u8lh = Data;
 		break;
-	}
 
-	case 0x80:
-	case 0x90: /* SL / RR */
-	{
-		int32_t SlotId = SlotMap[Address & 0x1F]; if (SlotId == -1) return;
-		auto& Slot = m_OPL.Slot[SlotId];
+	case 0x0D: /* Prescale (L) */
+		m_ADPCMB.Prescale.u8ll = Data;
+		break;
 
-		Slot.SustainLvl = (Data >> 4) & 0x0F;
-		Slot.EgRate[ADSR::Release] = (Data >> 0) & 0x0F;
+	case 0x0E: /* Prescale (H) */
+		m_ADPCMB.Prescale.u8lh = Data & 0x07;
+		break;
 
-		/* If all SL bits are set, SL is -93dB. See OPL4 manual page 47 */
-		Slot.SustainLvl |= (Slot.SustainLvl + 1) & 0x10;
+	case 0x0F: /* ADPCM data */
+		__debugbreak();
 		break;
-	}
 
-	case 0xA0: /* F-Number (L) */
-	{
-		int32_t ChannelId = ChannelMap[Address & 0x0F]; if (ChannelId == -1) return;
-		auto& Channel = m_OPL.Channel[ChannelId];
+	case 0x10: /* Delta-N (L) */
+		m_ADPCMB.DeltaN.u8ll = Data;
+		break;
 
-		Channel.FNum &= 0x300;
-		Channel.FNum |= Data;
+	case 0x11: /* Delta-N (H) */
+		m_ADPCMB.DeltaN.u8lh = Data;
 		break;
-	}
 
-	case 0xB0: /* Key On / Block / F-Number (H) */
-	{
-		if (Address == 0xBD) /* AM, PM depth / Rhythm */
-		{
-			m_OPL.LfoAmShift = (Data & 0x80) ? 2 : 4; /* Depth = 4.8 or 1.0dB */
-			m_OPL.LfoPmShift = (Data & 0x40) ? 0 : 1; /* Depth = 7 or 14 cents */
-			m_OPL.RHY = (Data >> 5) & 0x01;
+	case 0x12: /* Level control */
+		m_ADPCMB.LevelCtrl = Data;
+		break;
 
-			if (m_OPL.RHY) /* Key on/off drum instruments */
-			{
-				m_OPL.Slot[Rhythm::BD1].DrumLatch = (Data >> 4) & 0x01;
-				m_OPL.Slot[Rhythm::BD2].DrumLatch = (Data >> 4) & 0x01;
-				m_OPL.Slot[Rhythm::SD ].DrumLatch = (Data >> 3) & 0x01;
-				m_OPL.Slot[Rhythm::TOM].DrumLatch = (Data >> 2) & 0x01;
-				m_OPL.Slot[Rhythm::CYM ].DrumLatch = (Data >> 1) & 0x01;
-				m_OPL.Slot[Rhythm::HH ].DrumLatch = (Data >> 0) & 0x01;
-			}
-		}
-		else
-		{
-			int32_t ChannelId = ChannelMap[Address & 0x0F]; if (ChannelId == -1) return;
-			auto& Channel = m_OPL.Channel[ChannelId];
+	case 0x15: /* DAC data (H) */
+		__debugbreak();
+		break;
 
-			Channel.KeyLatch = (Data >> 5) & 0x01;
-			Channel.Block    = (Data >> 2) & 0x07;
+	case 0x16: /* DAC data (L) */
+		__debugbreak();
+		break;
 
-			Channel.FNum &= 0x0FF;
-			Channel.FNum |= (Data & 0x03) << 8;
+	case 0x17: /* Shift */
+		__debugbreak();
+		break;
 
-			/* Calculate keycode */
-			Channel.KeyCode = (Channel.Block << 1);
-			Channel.KeyCode |= (Channel.FNum >> (9 - m_OPL.NTS)) & 0x01; /* Select FNUM b9 or b8 */
-		}
+	case 0x18: /* I/O control */
+		m_IoCtrl = Data & 0x0F; /* 0 = input, 1 = output */
 		break;
-	}
 
-	case 0xC0: /* Feedback / Connection */
-	{
-		int32_t ChannelId = ChannelMap[Address & 0x0F]; if (ChannelId == -1) return;
-		auto& Channel = m_OPL.Channel[ChannelId];
+	case 0x19: /* I/O data */
+		//if (m_IoCtrl & 0x01) TODO: output (Data >> 0) & 0x01 to IO port 0
+		//if (m_IoCtrl & 0x02) TODO: output (Data >> 1) & 0x01 to IO port 1
+		//if (m_IoCtrl & 0x04) TODO: output (Data >> 2) & 0x01 to IO port 2
+		//if (m_IoCtrl & 0x08) TODO: output (Data >> 3) & 0x01 to IO port 3
+		break;
 
-		Channel.FB   = (Data >> 1) & 0x07;
-		Channel.Algo = (Data >> 0) & 0x01;
+	case 0x1A: /* PCM data */
+		/* Read only */
 		break;
-	}
 
 	default: /* Not used */
+		__debugbreak();
 		break;
 	}
-}
-
-void Y8950::UpdateTimers()
-{
-	/* Update global timer */
-	m_OPL.Timer++;
-
-	/* Update LFO-AM (tremolo) */
-	if ((m_OPL.Timer & YM::OPL::LfoAmPeriod) == 0)
-	{
-		m_OPL.LfoAmStep = (m_OPL.LfoAmStep + 1) % YM::OPL::LfoAmSteps;
-
-		if (m_OPL.LfoAmStep < (YM::OPL::LfoAmSteps / 2)) /* Increase */
-		{
-			m_OPL.LfoAmLevel = m_OPL.LfoAmStep >> m_OPL.LfoAmShift;
-		}
-		else /* Decrease */
-		{
-			m_OPL.LfoAmLevel = (YM::OPL::LfoAmSteps - m_OPL.LfoAmStep) >> m_OPL.LfoAmShift;
-		}
-	}
-
-	/* Update LFO-PM (vibrato) */
-	if ((m_OPL.Timer & YM::OPL::LfoPmPeriod) == 0)
-	{
-		m_OPL.LfoPmStep = (m_OPL.LfoPmStep + 1) & YM::OPL::LfoPmSteps;
-	}
-
-	/* Update timer 1 */
-	if (m_OPL.Timer1.Start)
-	{
-		if ((m_OPL.Timer & YM::OPL::Timer1Mask) == 0)
-		{
-			if (--m_OPL.Timer1.Counter == 0)
-			{
-				SetStatusFlag(FLAG_TIMER1);
-				m_OPL.Timer1.Counter = 256 - m_OPL.Timer1.Period;
-
-				/* CSM Key On */
-				if (m_OPL.CSM)
-				{
-					for (auto& Slot : m_OPL.Slot) Slot.CsmLatch = 1;
-				}
-			}
-		}
-	}
 
-	/* Update timer 2 */
-	if (m_OPL.Timer2.Start)
-	{
-		if ((m_OPL.Timer & YM::OPL::Timer2Mask) == 0)
-		{
-			if (--m_OPL.Timer2.Counter == 0)
-			{
-				SetStatusFlag(FLAG_TIMER2);
-				m_OPL.Timer2.Counter = 256 - m_OPL.Timer2.Period;
-			}
-		}
-	}
+	/* FM registers don't affect the flags */
+	m_Irq.Set(m_OPL.IsIrqAsserted());
 }
 
 void Y8950::Update(uint32_t ClockCycles, std::vector<IAudioBuffer*>& OutBuffer)
 {
-	static const uint32_t SlotOrder[] =
-	{
-		 0,  2,  4,  1,  3,  5,
-		 6,  8, 10,  7,  9, 11,
-		12, 14, 16, 13, 15, 17
-	};
-
 	uint32_t TotalCycles = ClockCycles + m_CyclesToDo;
 	uint32_t Samples = TotalCycles / m_ClockDivider;
 	m_CyclesToDo = TotalCycles % m_ClockDivider;
 
+	TC::DeviceStats::UpdateScope Stats(m_Stats, Samples);
+
+	/* Without an output buffer only the chip state is advanced (fast-forward) */
+	bool Render = (OutBuffer[AudioOut::Default] != nullptr);
+
+	/* The DAC converts the digital output in bulk */
+	YM3014::OutputBlock Block(*m_DAC, OutBuffer[AudioOut::Default]);
+
 	while (Samples-- != 0)
 	{
-		ClearOutput();
-		UpdateTimers();
+		/* Update timers and LFO */
+		m_OPL.UpdateTimers();
 
 		/* Update slots (operators) */
-		for (auto& SlotId : SlotOrder)
-		{
-			UpdateEnvelopeGenerator(SlotId);
-			UpdatePhaseGenerator(SlotId);
-			UpdateOperatorUnit(SlotId);
-			UpdateNoiseGenerator();
-		}
-
-		GenerateOutput(CH1);
-		GenerateOutput(CH2);
-		GenerateOutput(CH3);
-		GenerateOutput(CH4);
-		GenerateOutput(CH5);
-		GenerateOutput(CH6);
-		GenerateOutput(CH7);
-		GenerateOutput(CH8);
-		GenerateOutput(CH9);
+		m_OPL.UpdateSlots(Render, m_Stats);
 
 		/* Update ADPCM-B */
 		UpdateADPCMB();
 
+		if (!Render) continue;
+
+		/* Accumulate FM channels */
+		m_OPL.UpdateAccumulator();
+
 		/* Limit (signed 16-bit) */
-		int16_t Out = std::clamp(m_OPL.Out, -32768, 32767);
+		int16_t Out = std::clamp(m_OPL.Out + m_ADPCMB.OutL, -32768, 32767);
 
 		/* Digital to "analog" conversion */
-		float AnalogOut = m_DAC->SendDigitalData(Out);
-
-		OutBuffer[AudioOut::Default]->WriteSampleF32(AnalogOut);
+		Block.Write(Out);
 	}
+
+	Stats.ActiveVoices([&]
+	{
+		auto Slots = std::count_if(std::begin(m_OPL.Slot), std::end(m_OPL.Slot), [](auto& Slot) { return Slot.KeyState != 0; });
+
+		return Slots + ((m_ADPCMB.Ctrl1 & CTRL1_START) ? 1 : 0);
+	});
+
+	/* Timer overflows and ADPCM flags raise the interrupt output */
+	m_Irq.Set(m_OPL.IsIrqAsserted());
 }
 
-void Y8950::CopyToMemory(uint32_t MemoryID, size_t Offset, uint8_t* Data, size_t Size)
+uint32_t Y8950::GetCyclesForFrames(uint32_t OutputNr, uint32_t Frames)
 {
-	if ((Offset + Size) > m_Memory.size()) return;
-	memcpy(m_Memory.data() + Offset, Data, Size);
+	/* All outputs run at the same rate */
+	return CyclesForFrames(Frames, m_ClockDivider, m_CyclesToDo);
 }
 
-void Y8950::CopyToMemoryIndirect(uint32_t MemoryID, size_t Offset, uint8_t* Data, size_t Size)
+uint32_t Y8950::GetCyclesToNextEvent()
 {
-	/* No specialized implementation needed */
-	CopyToMemory(MemoryID, Offset, Data, Size);
+	/* Timer 1 and 2 count OPL samples (the ADPCM flags are not predicted) */
+	return CyclesForFrames(m_OPL.GetSamplesToTimerEvent(), m_ClockDivider, m_CyclesToDo);
 }
 
-void Y8950::UpdatePhaseGenerator(uint32_t SlotId)
+bool Y8950::IsSilent()
 {
-	auto& Chan = m_OPL.Channel[SlotId >> 1];
-	auto& Slot = m_OPL.Slot[SlotId];
-
-	uint32_t FNum = Chan.FNum;
-
-	/* Reset phase counter */
-	if (Slot.PgReset | m_OPL.LsiTest2) Slot.PgPhase = 0;
-
-	/* Apply LFO-PM (vibrato) */
-	if (Slot.LfoPmOn != 0)
-	{
-		/* LFO-PM shape (8 steps):
-
-			  2
-			 / \
-			1   3
-		   /     \
-		--0-------4-------0--
-				   \     /
-					5   7
-					 \ /
-					  6
-		*/
-
-		uint32_t Inc = FNum >> 7;
-
-		switch (m_OPL.LfoPmStep)
-		{
-		case 0:
-		case 4: /* Center */
-			break;
-
-		case 1:
-		case 3: /* Halfway - positive */
-			FNum += (Inc >> (1 + m_OPL.LfoPmShift));
-			break;
-
-		case 2: /* Top - positive */
-			FNum += (Inc >> m_OPL.LfoPmShift);
-			break;
-
-		case 5:
-		case 7: /* Halfway - negative */
-			FNum -= (Inc >> (1 + m_OPL.LfoPmShift));
-			break;
-
-		case 6: /* Top - negative */
-			FNum -= (Inc >> m_OPL.LfoPmShift);
-		}
-	}
-
-	/* Block shift (16-bit) */
-	uint32_t Inc = (FNum << Chan.Block) >> 1;
-
-	/* Multiply (19-bit) */
-	Inc = (Inc * Slot.Multi) >> 1;
-
-	/* Update phase counter (19-bit: 10.9) */
-	Slot.PgPhase += Inc;
-	Slot.PgOutput = Slot.PgPhase >> 9;
-
-	if (m_OPL.RHY)
-	{
-		switch (SlotId)
-		{
-		case Rhythm::HH:
-		{
-			/* Get high hat b8; map it to b1 of the result (b0 of the result is reserved for the noise bit) */
-			m_OPL.PhaseHH8 = (Slot.PgOutput >> 7) & 0x02; /* b8 */
-
-			/* Get high hat b7, b3 and b2; map it to b4, b3, and b2 of the result */
-			m_OPL.PhaseHH = (Slot.PgOutput >> 3) & 0x10; /* b7 */
-			m_OPL.PhaseHH |= (Slot.PgOutput >> 0) & 0x0C; /* b3 and b2 */
-
-			/* Lookup the phase input bit */
-			uint32_t PhaseIn = YM::OPL::PhaseIn[m_OPL.PhaseHH | m_OPL.PhaseTC];
-
-			/* Lookup the high hat phase output bits */
-			Slot.PgOutput = YM::OPL::PhaseOutHH[(PhaseIn << 1) | m_OPL.NoiseOut];
-			break;
-		}
-
-		case Rhythm::SD:
-			/* Lookup the snare drum phase output bits */
-			Slot.PgOutput = YM::OPL::PhaseOutSD[m_OPL.PhaseHH8 | m_OPL.NoiseOut];
-			break;
-
-		case Rhythm::CYM:
-		{
-			/* Get top cymbal b5 and b3; map it to b1 and b0 of the result */
-			m_OPL.PhaseTC = (Slot.PgOutput >> 4) & 0x02; /* b5 */
-			m_OPL.PhaseTC |= (Slot.PgOutput >> 3) & 0x01; /* b3 */
-
-			/* Lookup the phase input bit */
-			uint32_t PhaseIn = YM::OPL::PhaseIn[m_OPL.PhaseHH | m_OPL.PhaseTC];
-
-			/* Calculate the top cymbal phase output bits */
-			Slot.PgOutput = (PhaseIn << 9) | 0x80;
-			break;
-		}
-		}
-	}
+	return m_OPL.IsIdle() && ((m_ADPCMB.Ctrl1 & CTRL1_START) == 0);
 }
 
-void Y8950::UpdateEnvelopeGenerator(uint32_t SlotId)
+bool Y8950::SetIrqCallback(TC::IrqCallback Callback)
 {
-	auto& Chan = m_OPL.Channel[SlotId >> 1];
-	auto& Slot = m_OPL.Slot[SlotId];
-
-	/*-------------------------------------*/
-	/* Step 1: Key On / Off event handling */
-	/*-------------------------------------*/
-	uint32_t NewKeyState = (Chan.KeyLatch | Slot.CsmLatch | Slot.DrumLatch);
-	uint32_t EnvelopeStart = 0;
-
-	/* Clear CSM key on flag */
-	Slot.CsmLatch = 0;
-	
-	switch ((NewKeyState << 1) | Slot.KeyState)
-	{
-	case 0x00:
-	case 0x03: /* No key state changes */
-		Slot.PgReset = 0;
-		break;
-
-	case 0x01: /* Key off state */
-		Slot.EgPhase = ADSR::Release;
-		Slot.PgReset = 0;
-		Slot.KeyState = 0;
-		break;
-
-	case 0x02: /* Key on state */
-		Slot.EgPhase = ADSR::Attack;
-		Slot.PgReset = 1;
-		Slot.KeyState = 1;
-		EnvelopeStart = 1;
-		break;
-	}
-
-	/*-------------------------------*/
-	/* Step 2: Envelope update cycle */
-	/*-------------------------------*/
-	uint32_t Rate = 0;
-
-	switch (Slot.EgPhase)
-	{
-	case ADSR::Attack:
-		Rate = Slot.EgRate[ADSR::Attack];
-		break;
+	m_Irq.SetCallback(std::move(Callback));
 
-	case ADSR::Decay:
-		Rate = Slot.EgRate[ADSR::Decay];
-		break;
-
-	case ADSR::Sustain:
-		/* Note: EG-Type selects sustain or release */
-		Rate = Slot.EgRate[ADSR::Sustain + Slot.EgType];
-		break;
-
-	case ADSR::Release:
-		Rate = Slot.EgRate[ADSR::Release];
-		break;
-	}
-
-	if (Rate != 0)
-	{
-		/* Calculate scaled rate: (4 * rate) + scale value */
-		uint32_t ScaledRate = std::min((Rate << 2) + (Chan.KeyCode >> Slot.KeyScaling), 63u);
-
-		/* Get timer resolution */
-		uint32_t Shift = YM::OPL::EgShift[ScaledRate];
-		uint32_t Mask = (1 << Shift) - 1;
-
-		if ((m_OPL.Timer & Mask) == 0) /* Timer expired */
-		{
-			uint16_t Level = Slot.EgLevel;
-
-			/* Get update cycle (8 cycles in total) */
-			uint32_t Cycle = (m_OPL.Timer >> Shift) & 0x07;
-
-			/* Lookup attenuation adjustment */
-			uint32_t AttnInc = YM::OPL::EgLevelAdjust[ScaledRate][Cycle];
-
-			switch (Slot.EgPhase)
-			{
-			case ADSR::Attack:
-				if (ScaledRate >= 60)
-				{					
-					/* Instant attack */
-					if (EnvelopeStart) Level = 0;
-				}
-				else
-				{
-					if (Level != 0) Level += ((~Level * AttnInc) >> 3);
-				}
-
-				if (Level == 0) Slot.EgPhase = (Slot.SustainLvl != 0) ? ADSR::Decay : ADSR::Sustain;
-				break;
-
-			case ADSR::Decay:
-				Level += AttnInc;
-				if ((Level >> 4) == Slot.SustainLvl) Slot.EgPhase = ADSR::Sustain;
-				break;
-
-			case ADSR::Sustain:
-			case ADSR::Release:
-				Level += AttnInc;
-				if (Level >= YM::OPL::MaxEgLevel) Level = YM::OPL::MaxAttenuation;
-				break;
-			}
-
-			Slot.EgLevel = Level;
-		}
-	}
-
-	/*-------------------------------------*/
-	/* Step 3: Envelope output calculation */
-	/*-------------------------------------*/
-	uint32_t Attn = Slot.EgLevel + (Slot.TotalLevel << 2);
-
-	/* Apply key scale level */
-	Attn += YM::OPL::KeyScaleLevel[Chan.FNum >> 6][Chan.Block] >> Slot.KeyScaleShift; //TODO: Pre-calculate KSL
+	return true;
+}
 
-	/* Apply LFO-AM (tremolo) */
-	Attn += m_OPL.LfoAmLevel & Slot.LfoAmOn;
+void Y8950::CopyToMemory(uint32_t MemoryID, size_t Offset, uint8_t* Data, size_t Size)
+{
+	m_Memory.Upload(Offset, Data, Size);
+}
 
-	/* Limit and shift from 4.5 to 4.8 */
-	Slot.EgOutput = std::min(Attn, YM::OPL::MaxAttenuation) << 3;
+void Y8950::CopyToMemoryIndirect(uint32_t MemoryID, size_t Offset, uint8_t* Data, size_t Size)
+{
+	/* No specialized implementation needed */
+	CopyToMemory(MemoryID, Offset, Data, Size);
 }
 
-void Y8950::UpdateOperatorUnit(uint32_t SlotId)
+bool Y8950::AttachMemory(uint32_t MemoryID, const uint8_t* Data, size_t Size)
 {
-	auto& Slot = m_OPL.Slot[SlotId];
+	m_Memory.Attach(Data, Size);
 
-	/* Phase modulation (10-bit) */
-	uint32_t Phase = Slot.PgOutput + GetModulation(SlotId);
+	return true;
+}
 
-	/* Attenuation (4.8 + 4.8 = 5.8 fixed point) */
-	uint32_t Level = Slot.WaveTable[Phase & 0x1FF] + Slot.EgOutput;
+size_t Y8950::GetMemorySize(uint32_t MemoryID)
+{
+	return m_Memory.MaxSize();
+}
 
-	/* dB to linear conversion (12-bit) */
-	int16_t Output = YM::OPL::ExpTable[Level & 0xFF] >> (Level >> 8);
+bool Y8950::SetMemorySize(uint32_t MemoryID, size_t Size)
+{
+	/* 18-bit address bus */
+	if (!TC::IsPowerOfTwo(Size) || (Size > 0x40000)) return false;
 
-	/* Inverse output (13-bit) */
-	if (Phase & 0x200) Output = ~Output; /* Don't negate !*/
+	/* Data beyond the fitted memory reads as open bus */
+	m_Memory.SetMaxSize(Size);
 
-	/* The last 2 generated samples are stored */
-	Slot.Output[1] = Slot.Output[0];
-	Slot.Output[0] = Output;
+	return true;
 }
 
-void Y8950::UpdateNoiseGenerator()
+size_t Y8950::GetResidentSize()
 {
-	/* ! This needs validation ! */
-	m_OPL.NoiseOut = m_OPL.NoiseLFSR & 1;
-
-	uint32_t Seed = ((m_OPL.NoiseLFSR >> 14) ^ (m_OPL.NoiseLFSR >> 0)) & 1;
-	m_OPL.NoiseLFSR = (m_OPL.NoiseLFSR >> 1) | (Seed << 22);
+	return m_Memory.GetResidentSize();
 }
 
 void Y8950::UpdateADPCMB()
 {
+	m_ADPCMB.OutL = 0;
+
 	if (m_OPL.Status & FLAG_PCMBUSY)
 	{
 		/* Add frequency delta (range: 2362 - 65536) */
@@ -918,7 +476,7 @@ void Y8950::UpdateADPCMB()
 			m_ADPCMB.AddrDelta.u16h = 0;
 
 			/* Read nibble from external memory */
-			uint8_t Nibble = (m_Memory[m_ADPCMB.Addr] >> m_ADPCMB.NibbleShift) & 0x0F;
+			uint8_t Nibble = (m_Memory.Read(m_ADPCMB.Addr) >> m_ADPCMB.NibbleShift) & 0x0F;
 
 			/* Alternate between 1st and 2nd nibble */
 			m_ADPCMB.NibbleShift ^= 4;
@@ -929,7 +487,7 @@ void Y8950::UpdateADPCMB()
 			/* Check for stop address (inclusive) */
 			if ((m_ADPCMB.Addr >> m_ADPCMB.Shift) > m_ADPCMB.Stop.u32)
 			{
-				SetStatusFlag(FLAG_EOS);
+				m_OPL.SetStatusFlags(FLAG_EOS);
 				
 				if (m_ADPCMB.Ctrl1 & CTRL1_REPEAT) /* Loop */
 				{
@@ -942,7 +500,7 @@ void Y8950::UpdateADPCMB()
 				}
 				else /* Stop */
 				{
-					ResetStatusFlag(FLAG_PCMBUSY);
+					m_OPL.ClearStatusFlags(FLAG_PCMBUSY);
 				}
 			}
 
@@ -961,135 +519,38 @@ void Y8950::UpdateADPCMB()
 		uint16_t T1 = m_ADPCMB.AddrDelta.u16l;
 		int16_t Sample = ((T0 * m_ADPCMB.SignalT0) + (T1 * m_ADPCMB.SignalT1)) >> 16;
 
-		/* Level control (13-bit) and accumulate */
-		m_OPL.Out += (Sample * m_ADPCMB.LevelCtrl) >> 11;
+		/* Level control (13-bit) */
+		m_ADPCMB.OutL = (Sample * m_ADPCMB.LevelCtrl) >> 11;
 	}
 }
 
-void Y8950::ClearOutput()
+void Y8950::SaveState(StateWriter& State)
 {
-	m_OPL.Out = 0;
-}
+	State.BeginChunk("8950", 4);
 
-void Y8950::GenerateOutput(uint32_t ChannelId)
-{
-	/* ! This needs validation ! */
-	auto& Chan = m_OPL.Channel[ChannelId];
+	State.Write(m_AddressLatch);
+	State.Write(m_OPL);
+	State.Write(m_ADPCMB);
+	State.Write(m_IoCtrl);
+	State.Write(m_CyclesToDo);
 
-	int16_t Output = 0;
-
-	if (m_OPL.RHY)
-	{
-		switch (ChannelId)
-		{
-		case CH7: /* Bass drum */
-			Output = m_OPL.Slot[BD2].Output[0];
-
-			/* Limit (13-bit) and mix channel output */
-			m_OPL.Out += std::clamp<int16_t>(Output, -4096, 4095) * 2;
-			return;
-
-		case CH8: /* High hat + Snare drum */
-			Output = m_OPL.Slot[HH].Output[1]; /* Delayed by 1 sample ? */
-			Output += m_OPL.Slot[SD].Output[0];
-
-			/* Limit (13-bit) and mix channel output */
-			m_OPL.Out += std::clamp<int16_t>(Output, -4096, 4095) * 2;
-			return;
-
-		case CH9: /* Tom + Top cymbal */
-			Output = m_OPL.Slot[TOM].Output[1]; /* Delayed by 1 sample ? */
-			Output += m_OPL.Slot[CYM].Output[0];
-
-			/* Limit (13-bit) and mix channel output */
-			m_OPL.Out += std::clamp<int16_t>(Output, -4096, 4095) * 2;
-			return;
-		}
-	}
-
-	uint32_t SlotBase = ChannelId << 1;
-
-	if (Chan.Algo == 0)
-	{
-		Output = m_OPL.Slot[SlotBase + S2].Output[0];
-	}
-	else
-	{
-		Output += m_OPL.Slot[SlotBase + S1].Output[1]; /* Delayed by 1 sample */
-		Output += m_OPL.Slot[SlotBase + S2].Output[0];
-	}
-
-	/* Limit (13-bit) and mix channel output */
-	m_OPL.Out += std::clamp<int16_t>(Output, -4096, 4095);
+	State.EndChunk();
 }
 
-int16_t Y8950::GetModulation(uint32_t SlotId)
+bool Y8950::LoadState(StateReader& State)
 {
-	auto& Chan = m_OPL.Channel[SlotId >> 1];
+	if (!State.BeginChunk("8950", 4)) return false;
 
-	if (m_OPL.RHY)
-	{
-		/*
-			A special case is needed for the drum instruments that don't have modulation input.
-			The bass drum and tom can be processed normally.
+	State.Read(m_AddressLatch);
+	State.Read(m_OPL);
+	State.Read(m_ADPCMB);
+	State.Read(m_IoCtrl);
+	State.Read(m_CyclesToDo);
 
-			High hat can still do self feedback ?
-		*/
+	/* Wave table pointers are not portable between processes */
+	for (auto& Slot : m_OPL.Slot) Slot.WaveTable = &YM::OPL::WaveTable[0][0];
 
-		switch (SlotId)
-		{
-			//case Rhythm::HH: return 0;
-		case Rhythm::SD: return 0;
-		case Rhythm::CYM: return 0;
-		}
-	}
+	m_Irq.Set(m_OPL.IsIrqAsserted());
 
-	switch ((Chan.Algo << 1) | (SlotId & 1))
-	{
-	case 0x00: /* Algo: 0 - Modulator */
-	case 0x02: /* Algo: 1 - Modulator */
-		if (Chan.FB) /* Slot 1 self-feedback modulation */
-			return (m_OPL.Slot[SlotId].Output[0] + m_OPL.Slot[SlotId].Output[1]) >> (9 - Chan.FB);
-		else
-			return 0;
-
-	case 0x01: /* Algo: 0 - Carrier */
-		return m_OPL.Slot[SlotId - 1].Output[1]; /* Delayed by 1 sample */
-
-	case 0x03: /* Algo: 1 - Carrier */
-		return 0;
-	}
-
-	return 0;
-}
-
-void Y8950::SetStatusFlag(uint8_t Flag)
-{	
-	m_OPL.Status |= (Flag & m_OPL.StatusMask);
-
-	if (m_OPL.Status & (FLAG_TIMER1 | FLAG_TIMER2 | FLAG_EOS | FLAG_BRDY))
-	{
-		/* Set IRQ flag */
-		m_OPL.Status |= FLAG_IRQ;
-
-		//TODO: Set /IRQ pin to 0
-	}
-}
-
-void Y8950::ResetStatusFlag(uint8_t Flag)
-{
-	m_OPL.Status &= ~Flag;
-
-	if ((m_OPL.Status & (FLAG_TIMER1 | FLAG_TIMER2 | FLAG_EOS | FLAG_BRDY)) == 0)
-	{
-		/* Reset IRQ */
-		m_OPL.Status &= ~FLAG_IRQ;
-
-		//TODO: Set /IRQ pin to 1
-	}
-}
-
-void Y8950::SetStatusMask(uint8_t Mask)
-{
-	m_OPL.StatusMask = ~Mask; /* Invert as 1: mask, 0: don't mask */
+	return State.EndChunk();
 }
\ No newline at end of file
@@ -33,6 +33,9 @@ void YM2149::Reset(ResetType Type)
 {
 	m_CyclesToDo = 0;
 
+	/* Clear the band-limited output history */
+	for (auto& Synth : m_SynthSSG) Synth.Clear();
+
 	/* Clear register array (initial state is 0 for all registers) */
 	m_Register.fill(0);
 
@@ -66,24 +69,24 @@ bool YM2149::EnumAudioOutputs(uint32_t OutputNr, AUDIO_OUTPUT_DESC& Desc)
 	switch (OutputNr)
 	{
 	case 0: /* Channel A */
-		Desc.SampleRate = m_ClockSpeed / m_ClockDivider;
-		Desc.SampleFormat = 0;
+		Desc.SampleRate = m_SynthSSG[0].GetSampleRate(m_ClockSpeed / m_ClockDivider);
+		Desc.SampleFormat = AudioFormat::AUDIO_FMT_S16;
 		Desc.Channels = 1;
 		Desc.ChannelMask = SPEAKER_FRONT_CENTER;
 		Desc.Description = L"Channel A";
 		break;
 
 	case 1: /* Channel B */
-		Desc.SampleRate = m_ClockSpeed / m_ClockDivider;
-		Desc.SampleFormat = 0;
+		Desc.SampleRate = m_SynthSSG[1].GetSampleRate(m_ClockSpeed / m_ClockDivider);
+		Desc.SampleFormat = AudioFormat::AUDIO_FMT_S16;
 		Desc.Channels = 1;
 		Desc.ChannelMask = SPEAKER_FRONT_CENTER;
 		Desc.Description = L"Channel B";
 		break;
 
 	case 2: /* Channel C */
-		Desc.SampleRate = m_ClockSpeed / m_ClockDivider;
-		Desc.SampleFormat = 0;
+		Desc.SampleRate = m_SynthSSG[2].GetSampleRate(m_ClockSpeed / m_ClockDivider);
+		Desc.SampleFormat = AudioFormat::AUDIO_FMT_S16;
 		Desc.Channels = 1;
 		Desc.ChannelMask = SPEAKER_FRONT_CENTER;
 		Desc.Description = L"Channel C";
@@ -106,6 +109,20 @@ uint32_t YM2149::GetClockSpeed()
 	return m_ClockSpeed;
 }
 
+bool YM2149::GetStats(TC::StatsSnapshot& Stats)
+{
+	return m_Stats.Get(Stats);
+}
+
+bool YM2149::SetOutputRate(uint32_t OutputNr, uint32_t SampleRate)
+{
+	if (OutputNr >= 3) return false;
+
+	m_SynthSSG[OutputNr].SetRates(m_ClockSpeed / m_ClockDivider, SampleRate);
+
+	return true;
+}
+
 void YM2149::Write(uint32_t Address, uint32_t Data)
 {
 	Address &= 0x0F;
@@ -113,6 +130,8 @@ void YM2149::Write(uint32_t Address, uint32_t Data)
 
 	Data &= AY::Mask[Address]; /* Mask unused bits after storing */
 
+	m_Stats.RegisterWrite(Address);
+
 	switch (Address)
 	{
 	case 0x00: /* Channel A Tone Period (Fine Tune) */
@@ -219,6 +238,13 @@ void YM2149::Update(uint32_t ClockCycles, std::vector<IAudioBuffer*>& OutBuffer)
 	uint32_t Samples = TotalCycles / m_ClockDivider;
 	m_CyclesToDo = TotalCycles % m_ClockDivider;
 
+	TC::DeviceStats::UpdateScope Stats(m_Stats, Samples);
+
+	AudioBlock<int16_t> Block[3] = { OutBuffer[0], OutBuffer[1], OutBuffer[2] };
+
+	/* Follow clock and prescaler changes */
+	for (auto& Synth : m_SynthSSG) Synth.SetInputRate(m_ClockSpeed / m_ClockDivider);
+
 	int16_t Out;
 	uint32_t Mask;
 
@@ -289,7 +315,43 @@ void YM2149::Update(uint32_t ClockCycles, std::vector<IAudioBuffer*>& OutBuffer)
 			Out = Tone.AmpCtrl ? m_Envelope.Amplitude : Tone.Amplitude;
 
 			/* 16-bit output */
-			OutBuffer[i]->WriteSampleS16(Out & Mask);
+			m_SynthSSG[i].Write(Out & Mask, Block[i]);
 		}
 	}
+
+	/* Output the completed band-limited samples */
+	for (auto i = 0; i < 3; i++) m_SynthSSG[i].Flush(Block[i]);
+
+	Stats.ActiveVoices([&] { return AY::ActiveTones(m_Tone); });
+}
+
+bool YM2149::IsSilent()
+{
+	return AY::ActiveTones(m_Tone) == 0;
+}
+
+void YM2149::SaveState(StateWriter& State)
+{
+	State.BeginChunk("2149", 1);
+
+	State.Write(m_Tone);
+	State.Write(m_Noise);
+	State.Write(m_Envelope);
+	State.Write(m_Register);
+	State.Write(m_CyclesToDo);
+
+	State.EndChunk();
+}
+
+bool YM2149::LoadState(StateReader& State)
+{
+	if (!State.BeginChunk("2149", 1)) return false;
+
+	State.Read(m_Tone);
+	State.Read(m_Noise);
+	State.Read(m_Envelope);
+	State.Read(m_Register);
+	State.Read(m_CyclesToDo);
+
+	return State.EndChunk();
 }
\ No newline at end of file
@@ -15,10 +15,12 @@ See LICENSE.txt in the root directory of this source tree.
 #define _YM2149_H_
 
 #include "../../Interfaces/ISoundDevice.h"
+#include "../../Interfaces/IStateAccess.h"
 #include "AY.h"
+#include "../../Core/BandLimited.h"
 
 /* Yamaha YM2149 (SSG) */
-class YM2149 : public ISoundDevice
+class YM2149 : public ISoundDevice, public IStateAccess
 {
 public:
 	YM2149(uint32_t ClockSpeed = 4'000'000, bool SelIsLow = false);
@@ -35,6 +37,13 @@ public:
 	uint32_t		GetClockSpeed();
 	void			Write(uint32_t Address, uint32_t Data);
 	void			Update(uint32_t ClockCycles, std::vector<IAudioBuffer*>& OutBuffer);
+	bool			IsSilent();
+	bool			GetStats(TC::StatsSnapshot& Stats);
+	bool			SetOutputRate(uint32_t OutputNr, uint32_t SampleRate);
+
+	/* IStateAccess methods */
+	void			SaveState(StateWriter& State);
+	bool			LoadState(StateReader& State);
 
 private:
 	AY::tone_t		m_Tone[3];
@@ -46,6 +55,9 @@ private:
 	uint32_t	m_ClockSpeed;
 	uint32_t	m_ClockDivider;
 	uint32_t	m_CyclesToDo;
+	TC::DeviceStats	m_Stats;
+
+	TC::BandLimitedSynth m_SynthSSG[3]; /* SSG output rate synthesis (not part of the state) */
 };
 
 #endif // !_YM2149_H_
\ No newline at end of file
@@ -15,11 +15,13 @@ See LICENSE.txt in the root directory of this source tree.
 #define _YM2203_H_
 
 #include "../../Interfaces/ISoundDevice.h"
+#include "../../Interfaces/IStateAccess.h"
 #include "AY.h"
-#include "YM_OPN.h"
+#include "../../Core/BandLimited.h"
+#include "YM_OPN_Engine.h"
 
 /* Yamaha YM2203 (OPN) */
-class YM2203 : public ISoundDevice
+class YM2203 : public ISoundDevice, public IStateAccess
 {
 public:
 	YM2203(uint32_t ClockSpeed = 4'000'000);
@@ -36,32 +38,25 @@ public:
 	uint32_t		GetClockSpeed();
 	uint32_t		Read(int32_t Address);
 	void			Write(uint32_t Address, uint32_t Data);
+	bool			WriteBatch(uint32_t Port, const REGISTER_WRITE* Writes, size_t Count);
+	bool			WriteRegisters(uint32_t Port, uint32_t Register, const uint8_t* Data, size_t Count);
 	void			Update(uint32_t ClockCycles, std::vector<IAudioBuffer*>& OutBuffer);
+	uint32_t		GetCyclesForFrames(uint32_t OutputNr, uint32_t Frames);
+	uint32_t		GetCyclesToNextEvent();
+	bool			IsSilent();
+	bool			SetIrqCallback(TC::IrqCallback Callback);
+	bool			GetStats(TC::StatsSnapshot& Stats);
+	bool			SetOutputRate(uint32_t OutputNr, uint32_t SampleRate);
+	bool			SetMixedOutput(bool Enable);
+
+	/* IStateAccess methods */
+	void			SaveState(StateWriter& State);
+	bool			LoadState(StateReader& State);
 
 private:
 
-	/* OPN data type */
-	struct opn_t
-	{
-		YM::OPN::operator_t	Slot[12];
-		YM::OPN::channel_t	Channel[3];
-		YM::OPN::timer_t	TimerA;
-		YM::OPN::timer_t	TimerB;
-
-		uint32_t	FnumLatch;			/* Fnum latch (3-bit) */
-		uint32_t	FnumLatch3CH;		/* Fnum latch 3CH (3-bit) */
-		uint32_t	BlockLatch;			/* Block latch (3-bit) */
-		uint32_t	BlockLatch3CH;		/* Block latch 3CH (3-bit) */
-		uint32_t	Fnum3CH[3];			/* 3CH Frequency Nr. (11-bit) */
-		uint32_t	Block3CH[3];		/* 3CH Block (3-bit) */
-		uint32_t	KeyCode3CH[3];		/* 3CH Key code (5-bit) */
-		uint32_t	EgCounter;			/* EG counter (12-bit) */
-		uint32_t	EgClock;			/* EG clock (/3 divisor) */
-		uint32_t	Mode3CH;			/* 3CH Mode enable flag */
-		uint32_t	ModeCSM;			/* CSM Mode enable flag */
-		uint8_t		Status;				/* Status register (8-bit) */
-		int16_t		Out;				/* Accumulator ouput */
-	};
+	/* OPN unit: 3 channels, 14-bit mono */
+	using opn_t = YM::OPN::Engine<0x07, 14, false, false, false, false, true>;
 
 	uint8_t			m_AddressLatch;		/* Address latch (8-bit) */
 	uint32_t		m_PreScalerOPN;		/* OPN Prescaler (/6 /3 /2) */
@@ -73,29 +68,17 @@ private:
 	uint32_t	m_ClockSpeed;
 	uint32_t	m_CyclesToDoSSG;
 	uint32_t	m_CyclesToDoOPN;
+	TC::DeviceStats	m_Stats;
+	TC::IrqLine		m_Irq;		/* Interrupt output (not part of the state) */
+	bool			m_MixedOutput;	/* SSG mixed into the FM output (not part of the state) */
 
-	void		WriteSSG(uint8_t Address, uint8_t Data);
-	void		WriteMode(uint8_t Address, uint8_t Data);
-	void		WriteFM(uint8_t Address, uint8_t Data);
+	TC::BandLimitedSynth m_SynthSSG[3]; /* SSG output rate synthesis (not part of the state) */
 
-	void		SetStatusFlags(uint8_t Flags);
-	void		ClearStatusFlags(uint8_t Flags);
+	void		WriteRegister(uint32_t Port, uint8_t Address, uint8_t Data);
+	void		WriteSSG(uint8_t Address, uint8_t Data);
 
 	void		UpdateOPN(uint32_t ClockCycles, std::vector<IAudioBuffer*>& OutBuffer);
 	void		UpdateSSG(uint32_t ClockCycles, std::vector<IAudioBuffer*>& OutBuffer);
-
-	void		PrepareSlot(uint32_t SlotId);
-	void		UpdatePhaseGenerator(uint32_t SlotId);
-	void		UpdateEnvelopeGenerator(uint32_t SlotId);
-	void		UpdateOperatorUnit(uint32_t SlotId);
-	void		ClearAccumulator();
-	void		UpdateAccumulator(uint32_t SlotId);
-	void		UpdateTimers();
-
-	int16_t		GetModulation(uint32_t SlotId);
-	uint8_t		CalculateRate(uint8_t Rate, uint8_t KeyCode, uint8_t KeyScale);
-	void		ProcessKeyEvent(uint32_t SlotId);
-	void		StartEnvelope(uint32_t SlotId);
 };
 
 #endif // !_YM2203_H_
\ No newline at end of file
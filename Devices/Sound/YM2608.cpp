@@ -15,7 +15,39 @@ See LICENSE.txt in the root directory of this source tree.
 #include "YM_RSS.h"
 #include "ADPCM.h"
 
-#define VGM_WORKAROUND /* Workaround for VGM files */
+namespace YM::RSS
+{
+	/* Decoded instrument ROM
+	   The ROM never changes and an instrument always starts at its start offset with a reset decoder,
+	   so the signal and decoder step of every nibble is known up front. The table is decoded once and
+	   shared by all instances */
+	struct decoded_rom_t
+	{
+		int16_t		Signal[sizeof(InstrumentROM) * 2];	/* Decoded signal per nibble */
+		uint16_t	Step[sizeof(InstrumentROM) * 2];	/* Decoder step per nibble */
+	};
+
+	static const decoded_rom_t DecodedROM = []
+	{
+		decoded_rom_t ROM{};
+
+		for (auto i = 0; i < 6; i++)
+		{
+			int32_t Step = 0;
+			int16_t Signal = 0;
+
+			for (uint32_t Nibble = InstrumentOffsets[(i * 2) + 0] << 1; Nibble <= ((InstrumentOffsets[(i * 2) + 1] << 1) | 1); Nibble++)
+			{
+				YM::ADPCMA::Decode((InstrumentROM[Nibble >> 1] >> ((Nibble & 1) ? 0 : 4)) & 0x0F, &Step, &Signal);
+
+				ROM.Signal[Nibble] = Signal;
+				ROM.Step[Nibble] = (uint16_t)Step;
+			}
+		}
+
+		return ROM;
+	}();
+}
 
 /*
 	Yamaha YM2608 (OPNA)
@@ -89,38 +121,13 @@ enum AudioOut
 	OPN,
 };
 
-/* Slot naming */
-enum SlotName
-{
-	S1 = 0, S2, S3, S4
-};
-
-/* Channel naming */
-enum ChannelName
-{
-	CH1 = 0, CH2, CH3, CH4, CH5, CH6
-};
-
-/* Name to Slot ID */
-#define O(c, s) { (c << 2) + s}
-
-/* Envelope phases */
-enum ADSR : uint32_t
-{
-	Attack = 0,
-	Decay,
-	Sustain,
-	Release
-};
-
 YM2608::YM2608(uint32_t ClockSpeed) :
 	m_ClockSpeed(ClockSpeed),
 	m_PreScalerOPN(6),
-	m_PreScalerSSG(4)
+	m_PreScalerSSG(4),
+	m_MemoryADPCMB(0x200000),
+	m_MixedOutput(false)
 {
-	YM::OPN::BuildTables();
-	YM::ADPCMA::InitDecoder();
-
 	/* Initialize instrument data only once */
 	for (auto i = 0; i < 6; i++)
 	{
@@ -141,6 +148,9 @@ void YM2608::Reset(ResetType Type)
 	m_CyclesToDoSSG = 0;
 	m_CyclesToDoOPN = 0;
 
+	/* Clear the band-limited output history */
+	m_SynthSSG.Clear();
+
 	/* Reset prescalers */
 	//m_PreScalerOPN = 6;
 	//m_PreScalerSSG = 4;
@@ -168,39 +178,19 @@ void YM2608::Reset(ResetType Type)
 	m_SSG.Envelope.Inv = 0;
 
 	/* Reset OPN unit */
-	memset(&m_OPN, 0, sizeof(m_OPN));
+	m_OPN.Reset();
 
 	/* Default general register state */
-	m_OPN.Status	= 0;
 	m_OPN.FlagCtrl	= FLAG_ZERO | FLAG_BRDY | FLAG_EOS;
 	m_OPN.IrqEnable	= FLAG_ZERO | FLAG_BRDY | FLAG_EOS | FLAG_TIMERB | FLAG_TIMERA;
-	m_OPN.LFO.Period = YM::OPN::LfoPeriod[0];
-
-	/* Default operator register state */
-	for (auto& Slot : m_OPN.Slot)
-	{
-		Slot.Multi = 1; /* x0.5 */
-		Slot.EgPhase = ADSR::Release;
-		Slot.EgLevel = 0x3FF;
-	}
-
-	/* Default channel register state */
-	for (auto& Channel : m_OPN.Channel)
-	{
-		/* All channels are ON by default for OPN compatibility */
-		Channel.MaskL = ~0;
-		Channel.MaskR = ~0;
-	}
 
 	/* Reset RSS unit */
+	memset(&m_ADPCMA, 0, sizeof(m_ADPCMA));
 	m_ADPCMA.TotalLevel = 0x3F;
 	m_RhythmChannels = 6;
 
 	for (auto& Channel : m_ADPCMA.Channel)
 	{
-		Channel.KeyOn = 0;
-		Channel.OutL = 0;
-		Channel.OutR = 0;
 		Channel.Level = 0x1F;
 		Channel.MaskL = ~0;
 		Channel.MaskR = ~0;
@@ -216,22 +206,18 @@ void YM2608::Reset(ResetType Type)
 	/* Reset ADPCM-B memory */
 	if (Type == ResetType::PowerOnDefaults)
 	{
-		m_MemoryADPCMB.fill(0);
+		m_MemoryADPCMB.Clear();
 	}
+
+	m_Irq.Set(m_OPN.IsIrqAsserted());
 }
 
 void YM2608::SendExclusiveCommand(uint32_t Command, uint32_t Value)
 {
-	if (Command & 0x100) /* Port 1 */
-	{
-		Write(0x02, Command & 0xFF);
-		Write(0x03, Value);
-	}
-	else /* Port 0 */
-	{
-		Write(0x00, Command & 0xFF);
-		Write(0x01, Value);
-	}
+	/* Same as an address write followed by a data write */
+	m_AddressLatch = Command & 0xFF;
+
+	WriteRegister((Command >> 8) & 0x01, m_AddressLatch, Value & 0xFF);
 }
 
 bool YM2608::EnumAudioOutputs(uint32_t OutputNr, AUDIO_OUTPUT_DESC& Desc)
@@ -239,19 +225,19 @@ bool YM2608::EnumAudioOutputs(uint32_t OutputNr, AUDIO_OUTPUT_DESC& Desc)
 	switch (OutputNr)
 	{
 	case AudioOut::SSG: /* SSG - Analog Out */
-		Desc.SampleRate = m_ClockSpeed / (16 * m_PreScalerSSG);
-		Desc.SampleFormat = 0;
+		Desc.SampleRate = m_SynthSSG.GetSampleRate(m_ClockSpeed / (16 * m_PreScalerSSG));
+		Desc.SampleFormat = AudioFormat::AUDIO_FMT_S16;
 		Desc.Channels = 1;
 		Desc.ChannelMask = SPEAKER_FRONT_CENTER;
-		Desc.Description = L"Analog Out";
+		Desc.Description = m_MixedOutput ? L"Analog Out (mixed into FM)" : L"Analog Out";
 		return true;
 
 	case AudioOut::OPN: /* FM */
 		Desc.SampleRate = m_ClockSpeed / (24 * m_PreScalerOPN);
-		Desc.SampleFormat = 0;
+		Desc.SampleFormat = AudioFormat::AUDIO_FMT_S16;
 		Desc.Channels = 2;
 		Desc.ChannelMask = SPEAKER_FRONT_LEFT | SPEAKER_FRONT_RIGHT;
-		Desc.Description = L"FM + ADPCM";
+		Desc.Description = m_MixedOutput ? L"FM + ADPCM + SSG" : L"FM + ADPCM";
 		return true;
 
 	default:
@@ -271,6 +257,27 @@ uint32_t YM2608::GetClockSpeed()
 	return m_ClockSpeed;
 }
 
+bool YM2608::GetStats(TC::StatsSnapshot& Stats)
+{
+	return m_Stats.Get(Stats);
+}
+
+bool YM2608::SetOutputRate(uint32_t OutputNr, uint32_t SampleRate)
+{
+	if (OutputNr != AudioOut::SSG) return false;
+
+	m_SynthSSG.SetRates(m_ClockSpeed / (16 * m_PreScalerSSG), SampleRate);
+
+	return true;
+}
+
+bool YM2608::SetMixedOutput(bool Enable)
+{
+	m_MixedOutput = Enable;
+
+	return true;
+}
+
 uint32_t YM2608::Read(int32_t Address)
 {
 	/* 2-bit address bus (A0 - A1) */
@@ -320,43 +327,93 @@ void YM2608::Write(uint32_t Address, uint32_t Data)
 		break;
 
 	case 0x01: /* Port 0 data write mode */
-		switch (m_AddressLatch & 0xF0)
+		WriteRegister(0, m_AddressLatch, Data);
+		break;
+
+	case 0x03: /* Port 1 data write mode */
+		WriteRegister(1, m_AddressLatch, Data);
+		break;
+	}
+}
+
+bool YM2608::WriteBatch(uint32_t Port, const REGISTER_WRITE* Writes, size_t Count)
+{
+	if (Count == 0) return true;
+
+	Port &= 0x01;
+
+	for (size_t i = 0; i < Count; i++) WriteRegister(Port, Writes[i].Register & 0xFF, Writes[i].Data & 0xFF);
+
+	/* The address latch holds the last register written */
+	m_AddressLatch = Writes[Count - 1].Register & 0xFF;
+
+	return true;
+}
+
+bool YM2608::WriteRegisters(uint32_t Port, uint32_t Register, const uint8_t* Data, size_t Count)
+{
+	if ((Register + Count) > 0x100) return false;
+
+	Port &= 0x01;
+
+	/* SSG, ADPCM and mode data (0x00 - 0x2F) */
+	for (; (Count != 0) && (Register < 0x30); Register++, Data++, Count--) WriteRegister(Port, Register, *Data);
+
+	if (Count == 0) return true;
+
+	/* FM data (0x30 - 0xB6) */
+	for (size_t i = 0; i < Count; i++) m_Stats.RegisterWrite((Port << 8) | (Register + i));
+
+	m_OPN.WriteFMRange(Register, Port, Data, Count);
+
+	return true;
+}
+
+void YM2608::WriteRegister(uint32_t Port, uint8_t Address, uint8_t Data)
+{
+	m_Stats.RegisterWrite((Port << 8) | Address);
+
+	if (Port == 0)
+	{
+		switch (Address & 0xF0)
 		{
 		case 0x00: /* Write SSG data (0x00 - 0x0F) */
-			WriteSSG(m_AddressLatch, Data);
+			WriteSSG(Address, Data);
 			break;
 
 		case 0x10: /* Write RSS data (0x10 - 0x1F) */
-			WriteRSS(m_AddressLatch, Data);
+			WriteRSS(Address, Data);
 			break;
 
 		case 0x20: /* Write OPN mode data (0x20 - 0x2F) */
-			WriteMode(m_AddressLatch, Data);
+			/* Note: the prescaler selection (0x2D - 0x2F) is disabled, see the notes at the top */
+			m_OPN.WriteMode(Address, Data, m_Stats);
 			break;
 
 		default: /* Write OPN FM data (0x30 - 0xB6) */
-			WriteFM(m_AddressLatch, 0, Data);
+			m_OPN.WriteFM(Address, 0, Data);
 			break;
 		}
-		break;
-
-	case 0x03:/* Port 1 data write mode */
-		switch (m_AddressLatch & 0xF0)
+	}
+	else
+	{
+		switch (Address & 0xF0)
 		{
 		case 0x00: /* Write ADPCM-B data (0x00 - 0x0F) */
 		case 0x10: /* Flag Control / Unused (0x10 - 0x1F) */
-			WriteADPCMB(m_AddressLatch, Data);
+			WriteADPCMB(Address, Data);
 			break;
 
 		case 0x20: /* Unused (0x20 - 0x2F) */
 			break;
 
 		default: /* Write OPN FM data (0x30 - 0xB6) */
-			WriteFM(m_AddressLatch, 1, Data);
+			m_OPN.WriteFM(Address, 1, Data);
 			break;
 		}
-		break;
 	}
+
+	m_Irq.Set(m_OPN.IsIrqAsserted());
 }
 
 void YM2608::WriteSSG(uint8_t Address, uint8_t Data)
@@ -493,6 +550,8 @@ void YM2608::WriteRSS(uint8_t Address, uint8_t Data)
 					Channel.Step = 0;
 					Channel.Signal = 0;
 					Channel.NibbleShift = 4; /* Start at high nibble */
+
+					m_Stats.KeyOn();
 				}
 
 				Channel.KeyOn = DM;
@@ -545,15 +604,15 @@ void YM2608::WriteADPCMB(uint8_t Address, uint8_t Data)
 
 		if (m_ADPCMB.Ctrl1 & CTRL1_RESET)
 		{
-			ClearStatusFlags(FLAG_PCMBUSY | FLAG_ZERO | FLAG_EOS);
-			SetStatusFlags(FLAG_BRDY);
+			m_OPN.ClearStatusFlags(FLAG_PCMBUSY | FLAG_ZERO | FLAG_EOS);
+			m_OPN.SetStatusFlags(FLAG_BRDY);
 		}
 
 		/* Note: Only ADPCM-B decoding from memory supported */
 		if ((m_ADPCMB.Ctrl1 & (CTRL1_START | CTRL1_REC | CTRL1_MEMDATA)) == (CTRL1_START | CTRL1_MEMDATA))
 		{
-			ClearStatusFlags(FLAG_ZERO | FLAG_BRDY | FLAG_EOS);
-			SetStatusFlags(FLAG_PCMBUSY);
+			m_OPN.ClearStatusFlags(FLAG_ZERO | FLAG_BRDY | FLAG_EOS);
+			m_OPN.SetStatusFlags(FLAG_PCMBUSY);
 			
 			m_ADPCMB.Addr = m_ADPCMB.Start.u32 << m_ADPCMB.Shift;
 			m_ADPCMB.AddrDelta = 0;
@@ -562,6 +621,8 @@ void YM2608::WriteADPCMB(uint8_t Address, uint8_t Data)
 			m_ADPCMB.SignalT0 = 0;
 			m_ADPCMB.Step = 127;
 			m_ADPCMB.NibbleShift = 4;
+
+			m_Stats.KeyOn();
 		}
 		break;
 
@@ -645,301 +706,128 @@ void YM2608::WriteADPCMB(uint8_t Address, uint8_t Data)
 	}
 }
 
-void YM2608::WriteMode(uint8_t Address, uint8_t Data)
+void YM2608::Update(uint32_t ClockCycles, std::vector<IAudioBuffer*>& OutBuffer)
 {
-	switch (Address) /* 0x20 - 0x2F */
-	{
-	case 0x20: /* Not used */
-		break;
-	
-	case 0x21: /* LSI Test */
-		/* Not implemented */
-		break;
-
-	case 0x22: /* LFO Control */
-		m_OPN.LFO.Enable = (Data & 0x08) ? ~0 : 0; /* Note: implemented as a mask */
-		m_OPN.LFO.Period = YM::OPN::LfoPeriod[Data & 0x07];
-		break;
-
-	case 0x23: /* Not used */
-		break;
-
-	case 0x24: /* Timer A [9:2] */
-		m_OPN.TimerA.Period &= 0x03;
-		m_OPN.TimerA.Period |= (Data << 2);
-		break;
-
-	case 0x25: /* Timer A [1:0] */
-		m_OPN.TimerA.Period &= 0x3FC;
-		m_OPN.TimerA.Period |= (Data & 0x03);
-		break;
+	TC::DeviceStats::UpdateScope Stats(m_Stats);
 
-	case 0x26: /* Timer B */
-		m_OPN.TimerB.Period = Data;
-		break;
+	/* In mixed mode the SSG runs within the OPN samples */
+	if (!m_MixedOutput) UpdateSSG(ClockCycles, OutBuffer);
+	UpdateOPN(ClockCycles, OutBuffer);
 
-	case 0x27: /* 3CH mode / Timer control */
+	Stats.ActiveVoices([&]
 	{
-		/* Timer A and B start / stop */
-		auto StartA = (Data >> 0) & 0x01;
-		auto StartB = (Data >> 1) & 0x01;
-		
-		if (m_OPN.TimerA.Load ^ StartA)
-		{
-			m_OPN.TimerA.Load = StartA;
-			m_OPN.TimerA.Counter = 1024 - m_OPN.TimerA.Period;
-		}
-
-		if (m_OPN.TimerB.Load ^ StartB)
-		{
-			m_OPN.TimerB.Load = StartB;
-			m_OPN.TimerB.Counter = (256 - m_OPN.TimerB.Period) << 4; /* Note: period x16 to sync with Timer A */
-		}
+		auto Slots = std::count_if(std::begin(m_OPN.Slot), std::end(m_OPN.Slot), [](auto& Slot) { return Slot.KeyState != 0; });
+		auto Rhythm = std::count_if(std::begin(m_ADPCMA.Channel), std::end(m_ADPCMA.Channel), [](auto& Channel) { return Channel.KeyOn != 0; });
 
-		/* Timer A/B enable */
-		m_OPN.TimerA.Enable = (Data >> 2) & 0x01;
-		m_OPN.TimerB.Enable = (Data >> 3) & 0x01;
+		return Slots + Rhythm + AY::ActiveTones(m_SSG.Tone) + ((m_ADPCMB.Ctrl1 & CTRL1_START) ? 1 : 0);
+	});
 
-		/* Timer A/B overflow flag reset */
-		if (Data & 0x10) ClearStatusFlags(FLAG_TIMERA);
-		if (Data & 0x20) ClearStatusFlags(FLAG_TIMERB);
+	/* Timer overflows and ADPCM flags raise the interrupt output */
+	m_Irq.Set(m_OPN.IsIrqAsserted());
+}
 
-		/* 3CH / CSM mode */
-		m_OPN.Mode3CH = ((Data & 0xC0) != 0x00) ? 1 : 0;
-		m_OPN.ModeCSM = ((Data & 0xC0) == 0x80) ? 1 : 0;
-		break;
-	}
-		
-	case 0x28: /* Key On/Off */
+uint32_t YM2608::GetCyclesForFrames(uint32_t OutputNr, uint32_t Frames)
+{
+	switch (OutputNr)
 	{
-		if ((Data & 0x03) == 0x03) break; /* Invalid channel */
-		if ((Data & 0x04) && (m_OPN.ModeSCH == 0)) break; /* We're in OPN compatibility mode */
-		
-		uint32_t ChannelId = ((Data & 0x03) + ((Data & 0x04) ? 3 : 0)) << 2;
-
-		m_OPN.Slot[ChannelId + S1].KeyLatch = (Data >> 4) & 0x01;
-		m_OPN.Slot[ChannelId + S2].KeyLatch = (Data >> 5) & 0x01;
-		m_OPN.Slot[ChannelId + S3].KeyLatch = (Data >> 6) & 0x01;
-		m_OPN.Slot[ChannelId + S4].KeyLatch = (Data >> 7) & 0x01;
-
-#ifdef VGM_WORKAROUND
-		/*	Note: This is a work-around as key events should not be procesed here.
-			Some VGM files write consecutive key-on / key-off data without a render update in between.
-			This causes latched key data, which has not yet been processed, to be overwritten
-		*/
-		ProcessKeyEvent(ChannelId + S1);
-		ProcessKeyEvent(ChannelId + S2);
-		ProcessKeyEvent(ChannelId + S3);
-		ProcessKeyEvent(ChannelId + S4);
-#endif // VGM_WORKAROUND
-		break;
-	}
-
-	case 0x29: /* SCH / IRQ Enable */
-		m_OPN.ModeSCH   = (Data >> 7) & 0x01;
-		m_OPN.IrqEnable = (Data >> 0) & 0x1F;
-		break;
+	case AudioOut::SSG: /* Band-limited outputs are rendered at the output rate, mixed outputs receive no samples */
+		return (m_MixedOutput || m_SynthSSG.IsEnabled()) ? 0 : CyclesForFrames(Frames, 16 * m_PreScalerSSG, m_CyclesToDoSSG);
 
-	case 0x2A: /* Not used */
-		break;
-
-	case 0x2B: /* Not used */
-		break;
-
-	case 0x2C: /* Not used */
-		break;
-
-	case 0x2D: /* Prescaler selection (/6) */
-		/*m_PreScalerOPN = 6;
-		m_PreScalerSSG = 4;*/
-		break;
+	case AudioOut::OPN:
+		return CyclesForFrames(Frames, 24 * m_PreScalerOPN, m_CyclesToDoOPN);
 
-	case 0x2E: /* Prescaler selection (/3) */
-		/*if (m_PreScalerOPN == 6)
-		{
-			m_PreScalerOPN = 3;
-			m_PreScalerSSG = 2;
-		}*/
-		break;
-
-	case 0x2F: /* Prescaler selection (/2) */
-		/*m_PreScalerOPN = 2;
-		m_PreScalerSSG = 1;*/
-		break;
+	default:
+		return 0;
 	}
 }
 
-void YM2608::WriteFM(uint8_t Address, uint8_t Port, uint8_t Data)
+uint32_t YM2608::GetCyclesToNextEvent()
 {
-	/* Slot address mapping: S1 - S3 - S2 - S4 */
-	static const int32_t SlotMap[2][16] =
-	{
-		{
-			/* Port 0: Channel 1 - 3 */
-			O(CH1,S1), O(CH2,S1), O(CH3,S1), -1, O(CH1,S3), O(CH2,S3), O(CH3,S3), -1,
-			O(CH1,S2), O(CH2,S2), O(CH3,S2), -1, O(CH1,S4), O(CH2,S4), O(CH3,S4), -1
-		},
-		{
-			/* Port 1: Channel 4 - 6 */
-			O(CH4,S1), O(CH5,S1), O(CH6,S1), -1, O(CH4,S3), O(CH5,S3), O(CH6,S3), -1,
-			O(CH4,S2), O(CH5,S2), O(CH6,S2), -1, O(CH4,S4), O(CH5,S4), O(CH6,S4), -1
-		}
-	};
-
-	int32_t SlotId = SlotMap[Port][Address & 0x0F];
-	if (SlotId == -1) return;
-
-	if (Address < 0xA0) /* Slot register map (0x30 - 0x9F) */
-	{
-		auto& Slot = m_OPN.Slot[SlotId];
-
-		switch (Address & 0xF0)
-		{
-		case 0x30: /* Detune / Multiply */
-			Slot.Detune = (Data >> 4) & 0x07;
-			Slot.Multi = (Data & 0x0F) << 1;
-			if (Slot.Multi == 0) Slot.Multi = 1;
-			break;
-
-		case 0x40: /* Total Level */
-			Slot.TotalLevel = (Data & 0x7F) << 3;
-			break;
+	/* Timer A and B count OPN samples (the ADPCM flags are not predicted) */
+	return CyclesForFrames(m_OPN.GetSamplesToTimerEvent(), 24 * m_PreScalerOPN, m_CyclesToDoOPN);
+}
 
-		case 0x50: /* Key Scale / Attack Rate */
-			Slot.KeyScale = (Data >> 6);
-			Slot.EgRate[ADSR::Attack] = Data & 0x1F;
-			break;
+bool YM2608::IsSilent()
+{
+	if (!m_OPN.IsIdle() || (AY::ActiveTones(m_SSG.Tone) != 0)) return false;
 
-		case 0x60: /* Decay Rate / AM On */
-			Slot.AmOn = (Data & 0x80) ? ~0 : 0; /* Note: AM On/Off is implemented as a mask */
-			Slot.EgRate[ADSR::Decay] = Data & 0x1F;
-			break;
+	/* Rhythm / ADPCM playback */
+	for (auto& Channel : m_ADPCMA.Channel) if (Channel.KeyOn != 0) return false;
 
-		case 0x70: /* Sustain Rate */
-			Slot.EgRate[ADSR::Sustain] = Data & 0x1F;
-			break;
+	return (m_ADPCMB.Ctrl1 & CTRL1_START) == 0;
+}
 
-		case 0x80: /* Sustain Level / Release Rate */
-			/* If all SL bits are set, SL is 93dB. See YM2608 manual page 28 */
-			Slot.SustainLvl = (Data >> 4) & 0x0F;
-			Slot.SustainLvl |= (Slot.SustainLvl + 1) & 0x10;
-			Slot.SustainLvl <<= 5;
+bool YM2608::SetIrqCallback(TC::IrqCallback Callback)
+{
+	m_Irq.SetCallback(std::move(Callback));
 
-			/* Map RR from 4 to 5 bits, with LSB always set to 1 */
-			Slot.EgRate[ADSR::Release] = ((Data & 0x0F) << 1) | 0x01;
-			break;
+	return true;
+}
 
-		case 0x90: /* SSG-EG Envelope Control */
-			Slot.SsgEnable = (Data >> 3) & 0x01;
-			Slot.SsgEgInv = (Data >> 2) & 0x01;
-			Slot.SsgEgAlt = (Data >> 1) & 0x01;
-			Slot.SsgEgHld = (Data >> 0) & 0x01;
-			break;
-		}
-	}
-	else /* Channel register map (0xA0 - 0xB6) */
+void YM2608::CopyToMemory(uint32_t MemoryID, size_t Offset, uint8_t* Data, size_t Size)
+{
+	switch (MemoryID)
 	{
-		auto& Chan = m_OPN.Channel[SlotId >> 2];
-
-		switch (Address & 0xFC)
-		{
-		case 0xA0: /* F-Num 1 */
-			Chan.FNum = m_OPN.FnumLatch | Data;
-			Chan.Block = m_OPN.BlockLatch;
-			Chan.KeyCode = (Chan.Block << 2) | YM::OPN::Note[Chan.FNum >> 7];
-			break;
-
-		case 0xA4: /* F-Num 2 / Block Latch */
-			m_OPN.FnumLatch = (Data & 0x07) << 8;
-			m_OPN.BlockLatch = (Data >> 3) & 0x07;
-			break;
-		case 0xA8: /* 3 Ch-3 F-Num  */
-			if (Port == 0)
-			{
-				/* Slot order for 3CH mode */
-				if (Address == 0xA9)
-				{
-					m_OPN.Fnum3CH[S1] = m_OPN.FnumLatch3CH | Data;
-					m_OPN.Block3CH[S1] = m_OPN.BlockLatch3CH;
-					m_OPN.KeyCode3CH[S1] = (m_OPN.Block3CH[S1] << 2) | YM::OPN::Note[m_OPN.Fnum3CH[S1] >> 7];
-				}
-				else if (Address == 0xA8)
-				{
-					m_OPN.Fnum3CH[S3] = m_OPN.FnumLatch3CH | Data;
-					m_OPN.Block3CH[S3] = m_OPN.BlockLatch3CH;
-					m_OPN.KeyCode3CH[S3] = (m_OPN.Block3CH[S3] << 2) | YM::OPN::Note[m_OPN.Fnum3CH[S3] >> 7];
-				}
-				else /* 0xAA */
-				{
-					m_OPN.Fnum3CH[S2] = m_OPN.FnumLatch3CH | Data;
-					m_OPN.Block3CH[S2] = m_OPN.BlockLatch3CH;
-					m_OPN.KeyCode3CH[S2] = (m_OPN.Block3CH[S2] << 2) | YM::OPN::Note[m_OPN.Fnum3CH[S2] >> 7];
-				}
-			}
-			break;
-
-		case 0xAC: /* 3 Ch-3 F-Num / Block Latch */
-			if (Port == 0)
-			{
-				m_OPN.FnumLatch3CH = (Data & 0x07) << 8;
-				m_OPN.BlockLatch3CH = (Data >> 3) & 0x07;
-			}
-			break;
-
-		case 0xB0: /* Feedback / Connection */
-			Chan.FB = (Data >> 3) & 0x07;
-			Chan.Algo = Data & 0x07;
-			break;
+	case YM::OPN::Memory::ADPCMB:
+		m_MemoryADPCMB.Upload(Offset, Data, Size);
+		break;
 
-		case 0xB4: /* PMS / AMS / Panning */
-			Chan.MaskL = (Data & 0x80) ? ~0 : 0;
-			Chan.MaskR = (Data & 0x40) ? ~0 : 0;
-			Chan.AMS = (Data >> 4) & 0x03;
-			Chan.PMS = Data & 0x07;
-			break;
-		}
+	default:
+		break;
 	}
 }
 
-void YM2608::SetStatusFlags(uint8_t Flags)
+void YM2608::CopyToMemoryIndirect(uint32_t MemoryID, size_t Offset, uint8_t* Data, size_t Size)
 {
-	m_OPN.Status |= Flags & ~m_OPN.FlagCtrl;
+	/* No specialized implementation needed */
+	CopyToMemory(MemoryID, Offset, Data, Size);
+}
 
-	if (m_OPN.Status & m_OPN.IrqEnable & Flags)
+bool YM2608::AttachMemory(uint32_t MemoryID, const uint8_t* Data, size_t Size)
+{
+	switch (MemoryID)
 	{
-		/* TODO: Set interrupt line */
+	case YM::OPN::Memory::ADPCMB:
+		m_MemoryADPCMB.Attach(Data, Size);
+		return true;
+
+	default:
+		return false;
 	}
 }
 
-void YM2608::ClearStatusFlags(uint8_t Flags)
+size_t YM2608::GetMemorySize(uint32_t MemoryID)
 {
-	m_OPN.Status &= ~Flags;
-}
+	switch (MemoryID)
+	{
+	case YM::OPN::Memory::ADPCMB:
+		return m_MemoryADPCMB.MaxSize();
 
-void YM2608::Update(uint32_t ClockCycles, std::vector<IAudioBuffer*>& OutBuffer)
-{
-	UpdateSSG(ClockCycles, OutBuffer);
-	UpdateOPN(ClockCycles, OutBuffer);
+	default:
+		return 0;
+	}
 }
 
-void YM2608::CopyToMemory(uint32_t MemoryID, size_t Offset, uint8_t* Data, size_t Size)
+bool YM2608::SetMemorySize(uint32_t MemoryID, size_t Size)
 {
+	if (!TC::IsPowerOfTwo(Size)) return false;
+
 	switch (MemoryID)
 	{
-	case YM::OPN::Memory::ADPCMB:
-		if ((Offset + Size) > m_MemoryADPCMB.size()) break;
-		memcpy(m_MemoryADPCMB.data() + Offset, Data, Size);
-		break;
+	case YM::OPN::Memory::ADPCMB: /* Up to 2MB (A2 - A20) */
+		if (Size > 0x200000) return false;
+
+		m_MemoryADPCMB.SetMaxSize(Size);
+		return true;
 
 	default:
-		break;
+		return false;
 	}
 }
 
-void YM2608::CopyToMemoryIndirect(uint32_t MemoryID, size_t Offset, uint8_t* Data, size_t Size)
+size_t YM2608::GetResidentSize()
 {
-	/* No specialized implementation needed */
-	CopyToMemory(MemoryID, Offset, Data, Size);
+	return m_MemoryADPCMB.GetResidentSize();
 }
 
 void YM2608::UpdateSSG(uint32_t ClockCycles, std::vector<IAudioBuffer*>& OutBuffer)
@@ -948,130 +836,60 @@ void YM2608::UpdateSSG(uint32_t ClockCycles, std::vector<IAudioBuffer*>& OutBuff
 	uint32_t Samples = TotalCycles / (16 * m_PreScalerSSG);
 	m_CyclesToDoSSG = TotalCycles % (16 * m_PreScalerSSG);
 
+	AudioBlock<int16_t> Block(OutBuffer[AudioOut::SSG]);
+
+	/* Follow clock and prescaler changes */
+	m_SynthSSG.SetInputRate(m_ClockSpeed / (16 * m_PreScalerSSG));
+
 	int16_t Out;
-	uint32_t Mask;
 
 	while (Samples-- != 0)
 	{
 		Out = 0;
 
-		/* Update envelope generator */
-		if ((m_SSG.Envelope.Counter += 2) >= m_SSG.Envelope.Period.u32) //FIXME: should be += 1
-		{
-			/* Reset counter */
-			m_SSG.Envelope.Counter = 0;
-
-			/* Count down step counter (31 -> 0) */
-			m_SSG.Envelope.Step -= m_SSG.Envelope.StepDec;
+		/* Update envelope, noise and tone generators */
+		AY::UpdateGenerators(m_SSG);
 
-			if (m_SSG.Envelope.Step & 32) /* Envelope cycle completed */
-			{
-				/* Restart cycle */
-				m_SSG.Envelope.Step = 31;
-
-				/* Stop counting (if needed) */
-				m_SSG.Envelope.StepDec = m_SSG.Envelope.Hld ^ 1;
-
-				/* Toggle output inversion */
-				m_SSG.Envelope.Inv ^= m_SSG.Envelope.Alt;
-			}
-
-			/* Apply output inversion and lookup amplitude */
-			m_SSG.Envelope.Amplitude = AY::Amplitude32[m_SSG.Envelope.Step ^ m_SSG.Envelope.Inv];
-		}
-
-		/* Update noise generator */
-		if (m_SSG.Noise.Prescaler ^= 1)
-		{
-			if ((m_SSG.Noise.Counter += 2) >= m_SSG.Noise.Period) //FIXME: should be += 1
-			{
-				/* Reset counter */
-				m_SSG.Noise.Counter = 0;
-
-				/* Update output flag */
-				m_SSG.Noise.Output = m_SSG.Noise.LFSR & 1;
-
-				/* Tap bits 3 and 0 (XOR feedback) */
-				uint32_t Seed = ((m_SSG.Noise.LFSR >> 3) ^ (m_SSG.Noise.LFSR >> 0)) & 1;
-
-				/* Shift LFSR and apply seed (17-bit wide) */
-				m_SSG.Noise.LFSR = (m_SSG.Noise.LFSR >> 1) | (Seed << 16);
-			}
-		}
-
-		/* Update, mix and buffer tone generators */
+		/* Mix tone generators */
 		for (auto i = 0; i < 3; i++)
 		{
-			auto& Tone = m_SSG.Tone[i];
-
-			if ((Tone.Counter += 2) >= Tone.Period.u32) //FIXME: should be += 1
-			{
-				/* Reset counter */
-				Tone.Counter = 0;
-
-				/* Toggle output flag */
-				Tone.Output ^= 1;
-			}
-
-			/* Mix tone and noise (implemented as a mask) */
-			Mask = ~(((Tone.Output | Tone.ToneDisable) & (m_SSG.Noise.Output | Tone.NoiseDisable)) - 1);
-
-			/* Amplitude control */
-			Out += (Tone.AmpCtrl ? m_SSG.Envelope.Amplitude : Tone.Amplitude) & Mask;
+			Out += AY::ToneOutput(m_SSG, m_SSG.Tone[i]);
 		}
 
 		/* 16-bit output */
-		OutBuffer[AudioOut::SSG]->WriteSampleS16(Out >> 1);
+		m_SynthSSG.Write(Out >> 1, Block);
 	}
+
+	/* Output the completed band-limited samples */
+	m_SynthSSG.Flush(Block);
 }
 
 void YM2608::UpdateOPN(uint32_t ClockCycles, std::vector<IAudioBuffer*>& OutBuffer)
 {
-	static const uint32_t SlotOrder[] =
-	{
-		 O(CH1,S1), O(CH2,S1), O(CH3,S1), O(CH4,S1), O(CH5,S1), O(CH6,S1),
-		 O(CH1,S3), O(CH2,S3), O(CH3,S3), O(CH4,S3), O(CH5,S3), O(CH6,S3),
-		 O(CH1,S2), O(CH2,S2), O(CH3,S2), O(CH4,S2), O(CH5,S2), O(CH6,S2),
-		 O(CH1,S4), O(CH2,S4), O(CH3,S4), O(CH4,S4), O(CH5,S4), O(CH6,S4)
-	};
-
 	uint32_t TotalCycles = ClockCycles + m_CyclesToDoOPN;
 	uint32_t Samples = TotalCycles / (24 * m_PreScalerOPN);
 	m_CyclesToDoOPN = TotalCycles % (24 * m_PreScalerOPN);
 
-	while (Samples-- != 0)
-	{
-		ClearAccumulator();
-		
-		/* Update Timer A, Timer B and LFO */
-		UpdateTimers();
-		UpdateLFO();
+	m_Stats.AddFrames(Samples);
 
-		/* Update envelope clock */
-		m_OPN.EgClock = (m_OPN.EgClock + 1) % 3;
+	/* Without an output buffer only the chip state is advanced (fast-forward) */
+	bool Render = (OutBuffer[AudioOut::OPN] != nullptr);
 
-		/* Update envelope counter */
-		m_OPN.EgCounter = (m_OPN.EgCounter + (m_OPN.EgClock >> 1)) & 0xFFF;
+	AudioBlock<int16_t> Block(OutBuffer[AudioOut::OPN]);
 
-		/* Update slots (operators) */
-		for (auto& Slot : SlotOrder)
-		{
-			PrepareSlot(Slot);
-			UpdatePhaseGenerator(Slot);
-			UpdateEnvelopeGenerator(Slot);
-			UpdateOperatorUnit(Slot);
-		}
+	int16_t OutSSG = 0;
+	int16_t ToneOut[3];
 
-		UpdateAccumulator(CH1);
-		UpdateAccumulator(CH2);
-		UpdateAccumulator(CH3);
+	while (Samples-- != 0)
+	{
+		/* Mixed output: SSG samples within this OPN sample */
+		if (m_MixedOutput) OutSSG = AY::UpdateMixed(m_SSG, m_CyclesToDoSSG, 24 * m_PreScalerOPN, 16 * m_PreScalerSSG, 0, ToneOut);
 
-		if (m_OPN.ModeSCH) /* 6-channel mode enabled */
-		{
-			UpdateAccumulator(CH4);
-			UpdateAccumulator(CH5);
-			UpdateAccumulator(CH6);
-		}
+		/* Update Timer A, Timer B, LFO and envelope counter */
+		m_OPN.UpdateCounters();
+
+		/* Update slots (operators) */
+		uint32_t Active = m_OPN.UpdateSlots(Render, m_Stats);
 
 		/* Update ADPCM-A clock */
 		/*m_ClockADPCMA -= (m_PreScalerOPN * 24);
@@ -1091,13 +909,25 @@ void YM2608::UpdateOPN(uint32_t ClockCycles, std::vector<IAudioBuffer*>& OutBuff
 		}*/
 		UpdateADPCMB();
 
+		if (!Render) continue;
+
+		/* Accumulate FM channels (CH4 - CH6 in 6-channel mode only) */
+		m_OPN.UpdateAccumulator(Active);
+
 		/* Mix FM, ADPCM-A and ADPCM-B */
 		int16_t OutL = m_OPN.OutL + m_ADPCMA.OutL + m_ADPCMB.OutL;
 		int16_t OutR = m_OPN.OutR + m_ADPCMA.OutR + m_ADPCMB.OutR;
 
+		/* Mix SSG (limited to 16-bit) */
+		if (m_MixedOutput)
+		{
+			OutL = (int16_t)std::clamp(OutL + OutSSG, -32768, 32767);
+			OutR = (int16_t)std::clamp(OutR + OutSSG, -32768, 32767);
+		}
+
 		/* 16-bit output */
-		OutBuffer[AudioOut::OPN]->WriteSampleS16(OutL);
-		OutBuffer[AudioOut::OPN]->WriteSampleS16(OutR);
+		Block.Write(OutL);
+		Block.Write(OutR);
 	}
 }
 
@@ -1113,8 +943,11 @@ void YM2608::UpdateADPCMA()
 
 		if (Channel.KeyOn)
 		{				
-			/* Read nibble from instrument ROM */
-			uint8_t Nibble = (YM::RSS::InstrumentROM[Channel.Addr] >> Channel.NibbleShift) & 0x0F;
+			/* Fetch the decoded nibble (the decoder state is kept for the state) */
+			uint32_t Nibble = (Channel.Addr << 1) | (Channel.NibbleShift ? 0 : 1);
+
+			Channel.Signal = YM::RSS::DecodedROM.Signal[Nibble];
+			Channel.Step = YM::RSS::DecodedROM.Step[Nibble];
 
 			/* Alternate between 1st and 2nd nibble */
 			Channel.NibbleShift ^= 4;
@@ -1125,9 +958,6 @@ void YM2608::UpdateADPCMA()
 			/* Check for end address (inclusive) */
 			if (Channel.Addr > Channel.End.u32) Channel.KeyOn = 0;
 
-			/* Decode ADPCM-A nibble */
-			YM::ADPCMA::Decode(Nibble, &Channel.Step, &Channel.Signal);
-
 			uint32_t Attn = m_ADPCMA.TotalLevel + Channel.Level;
 
 			if (Attn <= 63)
@@ -1175,7 +1005,7 @@ void YM2608::UpdateADPCMB()
 			m_ADPCMB.AddrDelta.u16h = 0;
 
 			/* Read nibble from external memory */
-			uint8_t Nibble = (m_MemoryADPCMB[m_ADPCMB.Addr] >> m_ADPCMB.NibbleShift) & 0x0F;
+			uint8_t Nibble = (m_MemoryADPCMB.Read(m_ADPCMB.Addr) >> m_ADPCMB.NibbleShift) & 0x0F;
 
 			/* Alternate between 1st and 2nd nibble */
 			m_ADPCMB.NibbleShift ^= 4;
@@ -1198,8 +1028,8 @@ void YM2608::UpdateADPCMB()
 				}
 				else /* Stop */
 				{
-					ClearStatusFlags(FLAG_PCMBUSY);
-					SetStatusFlags(FLAG_EOS);
+					m_OPN.ClearStatusFlags(FLAG_PCMBUSY);
+					m_OPN.SetStatusFlags(FLAG_EOS);
 				}
 			}
 
@@ -1226,448 +1056,44 @@ void YM2608::UpdateADPCMB()
 	}
 }
 
-void YM2608::PrepareSlot(uint32_t SlotId)
+void YM2608::SaveState(StateWriter& State)
 {
-	uint32_t ChannelId = SlotId >> 2;
-	auto& Chan = m_OPN.Channel[ChannelId];
-	auto& Slot = m_OPN.Slot[SlotId];
-
-	/* Copy some values for later processing */
-	Slot.FNum = Chan.FNum;
-	Slot.Block = Chan.Block;
-	Slot.KeyCode = Chan.KeyCode;
-
-	if (m_OPN.Mode3CH)
-	{
-		auto i = SlotId & 3;
-
-		/* Get Block/FNum for channel 3: S1-S2-S3 */
-		if ((ChannelId == CH3) && (i != S4))
-		{
-			Slot.FNum = m_OPN.Fnum3CH[i];
-			Slot.Block = m_OPN.Block3CH[i];
-			Slot.KeyCode = m_OPN.KeyCode3CH[i];
-		}
-	}
+	State.BeginChunk("2608", 5);
+
+	State.Write(m_AddressLatch);
+	State.Write(m_PreScalerOPN);
+	State.Write(m_PreScalerSSG);
+	State.Write(m_SSG);
+	State.Write(m_OPN);
+	State.Write(m_ADPCMA);
+	State.Write(m_ADPCMB);
+	State.Write(m_RhythmChannels);
+	State.Write(m_ClockADPCMA);
+	State.Write(m_ClockADPCMB);
+	State.Write(m_CyclesToDoSSG);
+	State.Write(m_CyclesToDoOPN);
+
+	State.EndChunk();
 }
 
-void YM2608::UpdatePhaseGenerator(uint32_t SlotId)
+bool YM2608::LoadState(StateReader& State)
 {
-	auto& Chan = m_OPN.Channel[SlotId >> 2];
-	auto& Slot = m_OPN.Slot[SlotId];
-
-	uint32_t FNum = Slot.FNum << 1; /* 11 to 12-bit */
-
-	/* LFO frequency modulation (12-bit result) */
-	FNum = (FNum + YM::OPN::LfoPmTable[FNum >> 5][m_OPN.LFO.Step >> 2][Chan.PMS]) & 0xFFF;
-
-	/* Block shift (17-bit result) */
-	uint32_t Inc = (FNum << Slot.Block) >> 2;
-
-	/* Detune (17-bit result, might overflow) */
-	Inc = (Inc + YM::OPN::Detune[Slot.KeyCode][Slot.Detune]) & 0x1FFFF;
-
-	/* Multiply (20-bit result) */
-	Inc = (Inc * Slot.Multi) >> 1;
-
-	/* Update phase counter (20-bit) */
-	Slot.PgPhase = (Slot.PgPhase + Inc) & 0xFFFFF;
-}
-
-void YM2608::UpdateEnvelopeGenerator(uint32_t SlotId)
-{
-	auto& Chan = m_OPN.Channel[SlotId >> 2];
-	auto& Slot = m_OPN.Slot[SlotId];
-
-	/*-------------------------------------*/
-	/* Step 0: Key On / Off event handling */
-	/*-------------------------------------*/
-	ProcessKeyEvent(SlotId);
-
-	/*-----------------------------*/
-	/* Step 1: SSG-EG update cycle */
-	/*-----------------------------*/
-	if ((Slot.EgLevel >> 9) & Slot.SsgEnable)
-	{
-		if (Slot.KeyState) /* Attack, decay or sustain phase */
-		{
-			if (Slot.SsgEgHld) /* Hold mode */
-			{
-				/* Set output inversion to the hold state */
-				Slot.SsgEgInvOut = Slot.SsgEgInv ^ Slot.SsgEgAlt;
-			}
-			else /* Repeating mode */
-			{
-				StartEnvelope(SlotId);
-
-				/* Flip output inversion flag (if alternating) */
-				Slot.SsgEgInvOut ^= Slot.SsgEgAlt;
-
-				/* Restart the phase counter when we are repeating normally (not alternating) */
-				//if (Slot.SsgEgAlt == 0) Slot.PgPhase = 0;
-				Slot.PgPhase &= ~(Slot.SsgEgAlt - 1);
-			}
-		}
-		else /* Release phase */
-		{
-			/* Force the EG attenuation to maximum when we hit 0x200 during release */
-			Slot.EgLevel = 0x3FF;
-		}
-	}
-
-	/*-------------------------------*/
-	/* Step 2: Envelope update cycle */
-	/*-------------------------------*/
-	if (m_OPN.EgClock == 2)
-	{
-		/* When attacking, move to the decay phase when attenuation level is minimal */
-		if ((Slot.EgPhase | Slot.EgLevel) == 0)
-		{
-			Slot.EgPhase = ADSR::Decay;
-		}
-
-		/* If we reached the sustain level, move to the sustain phase */
-		if ((Slot.EgPhase == ADSR::Decay) && (Slot.EgLevel >= Slot.SustainLvl))
-		{
-			Slot.EgPhase = ADSR::Sustain;
-		}
-
-		/* Get key scaled rate */
-		uint32_t Rate = CalculateRate(Slot.EgRate[Slot.EgPhase], Slot.KeyCode, Slot.KeyScale);
-
-		/* Get EG counter resolution */
-		uint32_t Shift = YM::OPN::EgShift[Rate];
-		uint32_t Mask = (1 << Shift) - 1;
-
-		if ((m_OPN.EgCounter & Mask) == 0) /* Counter overflowed */
-		{
-			uint16_t Level = Slot.EgLevel;
-
-			/* Get update cycle (8 cycles in total) */
-			uint32_t Cycle = (m_OPN.EgCounter >> Shift) & 0x07;
-
-			/* Lookup attenuation adjustment */
-			uint32_t AttnInc = YM::OPN::EgLevelAdjust[Rate][Cycle];
-
-			if (Slot.EgPhase == ADSR::Attack) /* Exponential attack */
-			{
-				if (Rate < 62)
-				{
-					Level += ((~Level * AttnInc) >> 4);
-				}
-			}
-			else /* Linear decay */
-			{
-				/* When SSG-EG is active, don't update once we hit 0x200 */
-				if (((Level >> 9) & Slot.SsgEnable) == 0)
-				{
-					Level += AttnInc << (Slot.SsgEnable << 1);
-
-					/* Limit to maximum attenuation */
-					if (Level > 0x3FF) Level = 0x3FF;
-				}
-			}
-
-			Slot.EgLevel = Level;
-		}
-	}
-
-	/*-------------------------------------*/
-	/* Step 3: Envelope output calculation */
-	/*-------------------------------------*/
-	uint32_t Attn = Slot.EgLevel;
-
-	/* Apply SGG-EG output inversion */
-	if (Slot.SsgEgInvOut) Attn = (0x200 - Attn) & 0x3FF;
-
-	/* Apply total level */
-	Attn += Slot.TotalLevel;
-
-	/* Apply AM LFO */
-	Attn += (YM::OPN::LfoAmTable[m_OPN.LFO.Step][Chan.AMS] & Slot.AmOn);
-
-	/* Limit (10-bit = 4.6 fixed point) */
-	if (Attn > 0x3FF) Attn = 0x3FF;
-
-	/* Convert from 4.6 to 4.8 fixed point */
-	Slot.EgOutput = Attn << 2;
-}
-
-void YM2608::UpdateOperatorUnit(uint32_t SlotId)
-{
-	auto& Slot = m_OPN.Slot[SlotId];
-
-	/* Phase modulation (10-bit) */
-	uint32_t Phase = (Slot.PgPhase >> 10) + GetModulation(SlotId);
-
-	/* Attenuation (4.8 + 4.8 = 5.8 fixed point) */
-	uint32_t Level = YM::OPN::SineTable[Phase & 0x1FF] + Slot.EgOutput;
-
-	/* dB to linear conversion (13-bit) */
-	int16_t Output = YM::OPN::ExpTable[Level & 0xFF] >> (Level >> 8);
-
-	/* Negate output (14-bit) */
-	if (Phase & 0x200) Output = -Output;
-
-	/* The last 2 generated samples are stored */
-	Slot.Output[1] = Slot.Output[0];
-	Slot.Output[0] = Output;
-}
-
-void YM2608::ClearAccumulator()
-{
-	m_OPN.OutL = 0;
-	m_OPN.OutR = 0;
-}
-
-void YM2608::UpdateAccumulator(uint32_t ChannelId)
-{
-	int16_t Output = 0;
-	uint32_t SlotId = ChannelId << 2;
-
-	/* Accumulate output */
-	switch (m_OPN.Channel[ChannelId].Algo)
-	{
-	case 0:
-	case 1:
-	case 2:
-	case 3: /* S4 */
-		Output = m_OPN.Slot[SlotId + S4].Output[0];
-		break;
-
-	case 4: /* S2 + S4 */
-		Output = m_OPN.Slot[SlotId + S2].Output[0] + m_OPN.Slot[SlotId + S4].Output[0];
-		break;
-
-	case 5:
-	case 6: /* S2 + S3 + S4 */
-		Output = m_OPN.Slot[SlotId + S2].Output[0] + m_OPN.Slot[SlotId + S3].Output[0] + m_OPN.Slot[SlotId + S4].Output[0];
-		break;
-
-	case 7: /* S1 + S2 + S3 + S4 */
-		Output = m_OPN.Slot[SlotId + S1].Output[0] + m_OPN.Slot[SlotId + S2].Output[0] + m_OPN.Slot[SlotId + S3].Output[0] + m_OPN.Slot[SlotId + S4].Output[0];
-		break;
-	}
-
-	/* Limit (signed 14 to 13-bit) */
-	Output = std::clamp<int16_t>(Output, -8192, 8191) >> 1;
-
-	/* Mix channel output */
-	m_OPN.OutL += Output & m_OPN.Channel[ChannelId].MaskL;
-	m_OPN.OutR += Output & m_OPN.Channel[ChannelId].MaskR;
-}
-
-int16_t YM2608::GetModulation(uint32_t Cycle)
-{
-	auto& Chan = m_OPN.Channel[Cycle >> 2];
-
-	uint32_t SlotId = Cycle & 0x03;
-	uint32_t ChanId = Cycle & ~0x03;
-
-	switch (((Chan.Algo << 2) | SlotId) & 0x1F)
-	{
-	case 0x00: /* Algo: 0 - S1 */
-	case 0x04: /* Algo: 1 - S1 */
-	case 0x08: /* Algo: 2 - S1 */
-	case 0x0C: /* Algo: 3 - S1 */
-	case 0x10: /* Algo: 4 - S1 */
-	case 0x14: /* Algo: 5 - S1 */
-	case 0x18: /* Algo: 6 - S1 */
-	case 0x1C: /* Algo: 7 - S1 */
-		if (Chan.FB) /* Slot 1 self-feedback modulation (10-bit) */
-			return (m_OPN.Slot[Cycle].Output[0] + m_OPN.Slot[Cycle].Output[1]) >> (10 - Chan.FB);
-		else
-			return 0;
-
-	case 0x01: /* Algo: 0 - S2 */
-		return m_OPN.Slot[ChanId + S1].Output[0] >> 1;
-
-	case 0x02: /* Algo: 0 - S3 */
-		return m_OPN.Slot[ChanId + S2].Output[0] >> 1;
-
-	case 0x03: /* Algo: 0 - S4 */
-		return m_OPN.Slot[ChanId + S3].Output[0] >> 1;
-
-	case 0x05: /* Algo: 1 - S2 */
-		return 0;
-
-	case 0x06: /* Algo: 1 - S3 */
-		return (m_OPN.Slot[ChanId + S1].Output[1] + m_OPN.Slot[ChanId + S2].Output[0]) >> 1;
-
-	case 0x07: /* Algo: 1 - S4 */
-		return m_OPN.Slot[ChanId + S3].Output[0] >> 1;
-
-	case 0x09: /* Algo: 2 - S2 */
-		return 0;
-
-	case 0x0A: /* Algo: 2 - S3 */
-		return m_OPN.Slot[ChanId + S2].Output[0] >> 1;
-
-	case 0x0B: /* Algo: 2 - S4 */
-		return (m_OPN.Slot[ChanId + S1].Output[0] + m_OPN.Slot[ChanId + S3].Output[0]) >> 1;
-
-	case 0x0D: /* Algo: 3 - S2 */
-		return m_OPN.Slot[ChanId + S1].Output[0] >> 1;
-
-	case 0x0E: /* Algo: 3 - S3 */
-		return 0;
-
-	case 0x0F: /* Algo: 3 - S4 */
-		return (m_OPN.Slot[ChanId + S2].Output[1] + m_OPN.Slot[ChanId + S3].Output[0]) >> 1;
-
-	case 0x11: /* Algo: 4 - S2 */
-		return m_OPN.Slot[ChanId + S1].Output[0] >> 1;
-
-	case 0x12: /* Algo: 4 - S3 */
-		return 0;
-
-	case 0x13: /* Algo: 4 - S4 */
-		return m_OPN.Slot[ChanId + S3].Output[0] >> 1;
-
-	case 0x15: /* Algo: 5 - S2 */
-		return m_OPN.Slot[ChanId + S1].Output[0] >> 1;
-
-	case 0x16: /* Algo: 5 - S3 */
-		return m_OPN.Slot[ChanId + S1].Output[1] >> 1;
-
-	case 0x17: /* Algo: 5 - S4 */
-		return m_OPN.Slot[ChanId + S1].Output[0] >> 1;
-
-	case 0x19: /* Algo: 6 - S2 */
-		return m_OPN.Slot[ChanId + S1].Output[0] >> 1;
-
-	case 0x1A: /* Algo: 6 - S3 */
-	case 0x1B: /* Algo: 6 - S4 */
-		return 0;
-
-	case 0x1D: /* Algo: 7 - S2 */
-	case 0x1E: /* Algo: 7 - S3 */
-	case 0x1F: /* Algo: 7 - S4 */
-		return 0;
-	}
-
-	return 0;
-}
-
-uint8_t YM2608::CalculateRate(uint8_t Rate, uint8_t KeyCode, uint8_t KeyScale)
-{
-	uint8_t ScaledRate = 0;
-
-	/* YM2608 manual page 30 */
-	if (Rate != 0)
-	{
-		/* Calculate key scale value */
-		uint8_t KSV = KeyCode >> (3 - KeyScale);
-
-		/* Calculate key scaled rate */
-		ScaledRate = (Rate << 1) + KSV;
-
-		/* Limit to a max. of 63 */
-		if (ScaledRate > 63) ScaledRate = 63;
-	}
-
-	return ScaledRate;
-}
-
-void YM2608::ProcessKeyEvent(uint32_t SlotId)
-{
-	auto& Slot = m_OPN.Slot[SlotId];
-
-	/* Get latched key on/off state */
-	uint32_t NewState = (Slot.KeyLatch | Slot.CsmLatch);
-
-	/* Clear CSM key on flag */
-	Slot.CsmLatch = 0;
-
-	if (Slot.KeyState ^ NewState)
-	{
-		if (NewState) /* Key On */
-		{
-			/* Start envelope */
-			StartEnvelope(SlotId);
-
-			/* Reset phase counter */
-			Slot.PgPhase = 0;
-
-			/* Set SSG-EG inverted ouput flag to the initial state when we are in any SSG-EG inverted mode */
-			Slot.SsgEgInvOut = Slot.SsgEnable & Slot.SsgEgInv;
-		}
-		else /* Key Off */
-		{
-			/* Move envelope to release phase */
-			Slot.EgPhase = ADSR::Release;
-
-			if (Slot.SsgEgInvOut)
-			{
-				/* Allow the release phase to continue normally */
-				Slot.EgLevel = (0x200 - Slot.EgLevel) & 0x3FF;
-
-				/* Clear the SSG-EG inverted output flag */
-				Slot.SsgEgInvOut = 0;
-			}
-		}
-
-		Slot.KeyState = NewState;
-	}
-}
-
-void YM2608::StartEnvelope(uint32_t SlotId)
-{
-	auto& Slot = m_OPN.Slot[SlotId];
-
-	/* Move envelope to attack phase */
-	Slot.EgPhase = ADSR::Attack;
-
-	/* Instant attack */
-	if (CalculateRate(Slot.EgRate[ADSR::Attack], Slot.KeyCode, Slot.KeyScale) >= 62)
-	{
-		/* Instant minimum attenuation */
-		Slot.EgLevel = 0;
-	}
-}
-
-void YM2608::UpdateLFO()
-{
-	if (++m_OPN.LFO.Counter >= m_OPN.LFO.Period)
-	{
-		m_OPN.LFO.Counter = 0;
-		m_OPN.LFO.Step = (m_OPN.LFO.Step + 1) & 0x7F;
-	}
-
-	m_OPN.LFO.Step &= m_OPN.LFO.Enable;
-}
-
-void YM2608::UpdateTimers()
-{
-	if (m_OPN.TimerA.Load)
-	{
-		if (--m_OPN.TimerA.Counter == 0)
-		{
-			m_OPN.TimerA.Counter = 1024 - m_OPN.TimerA.Period;
-
-			/* Overflow flag enabled */
-			if (m_OPN.TimerA.Enable) SetStatusFlags(FLAG_TIMERA);
-
-			/* CSM Key On */
-			if (m_OPN.ModeCSM)
-			{
-				/* CSM Key-On all channel 3 slots */
-				m_OPN.Slot[8 + S1].CsmLatch = 1;
-				m_OPN.Slot[8 + S2].CsmLatch = 1;
-				m_OPN.Slot[8 + S3].CsmLatch = 1;
-				m_OPN.Slot[8 + S4].CsmLatch = 1;
-			}
-		}
-	}
-
-	if (m_OPN.TimerB.Load)
-	{
-		if (--m_OPN.TimerB.Counter == 0)
-		{
-			m_OPN.TimerB.Counter = (256 - m_OPN.TimerB.Period) << 4;
-
-			/* Overflow flag enabled */
-			if (m_OPN.TimerB.Enable) SetStatusFlags(FLAG_TIMERB);
-		}
-	}
+	if (!State.BeginChunk("2608", 5)) return false;
+
+	State.Read(m_AddressLatch);
+	State.Read(m_PreScalerOPN);
+	State.Read(m_PreScalerSSG);
+	State.Read(m_SSG);
+	State.Read(m_OPN);
+	State.Read(m_ADPCMA);
+	State.Read(m_ADPCMB);
+	State.Read(m_RhythmChannels);
+	State.Read(m_ClockADPCMA);
+	State.Read(m_ClockADPCMB);
+	State.Read(m_CyclesToDoSSG);
+	State.Read(m_CyclesToDoOPN);
+
+	m_Irq.Set(m_OPN.IsIrqAsserted());
+
+	return State.EndChunk();
 }
\ No newline at end of file
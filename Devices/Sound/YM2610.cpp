@@ -14,8 +14,6 @@ See LICENSE.txt in the root directory of this source tree.
 #include "YM2610.h"
 #include "ADPCM.h"
 
-#define VGM_WORKAROUND /* Workaround for VGM files */
-
 /*
 	Yamaha YM2610 (OPNB)
 
@@ -73,39 +71,18 @@ enum AudioOut
 {
 	SSG = 0,
 	OPN,
-};
-
-/* Slot naming */
-enum SlotName
-{
-	S1 = 0, S2, S3, S4
-};
-
-/* Channel naming */
-enum ChannelName
-{
-	/* Note: CH1 and CH4 are missing */
-	CH2 = 0, CH3, CH5, CH6
-};
-
-/* Name to Slot ID */
-#define O(c, s) { (c << 2) + s}
-
-/* Envelope phases */
-enum ADSR : uint32_t
-{
-	Attack = 0,
-	Decay,
-	Sustain,
-	Release
+	FM1				/* Channel outputs (optional): FM channels, ADPCM-A 1 - 6, ADPCM-B, SSG A - C */
 };
 
 YM2610::YM2610(uint32_t ClockSpeed):
-	m_ClockSpeed(ClockSpeed)
+	m_MemoryADPCMA(0x1000000),
+	m_MemoryADPCMB(0x1000000),
+	m_CacheADPCMA(YM::ADPCMA::Decode),
+	m_ClockSpeed(ClockSpeed),
+	m_ChannelOutputs(false),
+	m_MixedOutput(false),
+	m_VoiceMask(VoiceFM, 2)
 {
-	YM::OPN::BuildTables();
-	YM::ADPCMA::InitDecoder();
-
 	Reset(ResetType::PowerOnDefaults);
 }
 
@@ -119,6 +96,9 @@ void YM2610::Reset(ResetType Type)
 	m_CyclesToDoSSG = 0;
 	m_CyclesToDoOPN = 0;
 
+	/* Clear the band-limited output history */
+	m_SynthSSG.Clear();
+
 	/* Reset latches */
 	m_AddressLatch = 0;
 
@@ -139,32 +119,17 @@ void YM2610::Reset(ResetType Type)
 	m_SSG.Envelope.Inv = 0;
 
 	/* Reset OPN unit */
-	memset(&m_OPN, 0, sizeof(m_OPN));
+	m_OPN.Reset();
 
 	/* Default general register state */
-	m_OPN.Status = 0;
 	m_OPN.FlagCtrl = FLAG_BRDY | FLAG_EOS;
 	m_OPN.IrqEnable = FLAG_BRDY | FLAG_EOS | FLAG_TIMERB | FLAG_TIMERA;
-	m_OPN.LFO.Period = YM::OPN::LfoPeriod[0];
-
-	/* Default operator register state */
-	for (auto& Slot : m_OPN.Slot)
-	{
-		Slot.Multi = 1; /* x0.5 */
-		Slot.EgPhase = ADSR::Release;
-		Slot.EgLevel = 0x3FF;
-	}
-
-	/* Default channel register state */
-	for (auto& Channel : m_OPN.Channel)
-	{
-		/* All channels are ON by default for OPN compatibility */
-		Channel.MaskL = ~0;
-		Channel.MaskR = ~0;
-	}
 
 	/* Reset ADPCM-A unit */
 	memset(&m_ADPCMA, 0, sizeof(m_ADPCMA));
+	ResetCacheADPCMA(Type == ResetType::PowerOnDefaults);
+
+	for (auto& Sample : m_OutADPCM) Sample = 0;
 
 	/* Reset ADPCM-B unit */
 	memset(&m_ADPCMB, 0, sizeof(m_ADPCMB));
@@ -174,23 +139,19 @@ void YM2610::Reset(ResetType Type)
 	/* Reset ADPCM memory */
 	if (Type == ResetType::PowerOnDefaults)
 	{
-		m_MemoryADPCMA.fill(0);
-		m_MemoryADPCMB.fill(0);
+		m_MemoryADPCMA.Clear();
+		m_MemoryADPCMB.Clear();
 	}
+
+	m_Irq.Set(m_OPN.IsIrqAsserted());
 }
 
 void YM2610::SendExclusiveCommand(uint32_t Command, uint32_t Value)
 {
-	if (Command & 0x100) /* Port 1 */
-	{
-		Write(0x02, Command & 0xFF);
-		Write(0x03, Value);
-	}
-	else /* Port 0 */
-	{
-		Write(0x00, Command & 0xFF);
-		Write(0x01, Value);
-	}
+	/* Same as an address write followed by a data write */
+	m_AddressLatch = Command & 0xFF;
+
+	WriteRegister((Command >> 8) & 0x01, m_AddressLatch, Value & 0xFF);
 }
 
 bool YM2610::EnumAudioOutputs(uint32_t OutputNr, AUDIO_OUTPUT_DESC& Desc)
@@ -198,23 +159,46 @@ bool YM2610::EnumAudioOutputs(uint32_t OutputNr, AUDIO_OUTPUT_DESC& Desc)
 	switch (OutputNr)
 	{
 	case AudioOut::SSG:
-		Desc.SampleRate = m_ClockSpeed / (16 * 4);
-		Desc.SampleFormat = 0;
+		Desc.SampleRate = m_SynthSSG.GetSampleRate(m_ClockSpeed / (16 * 4));
+		Desc.SampleFormat = AudioFormat::AUDIO_FMT_S16;
 		Desc.Channels = 1;
 		Desc.ChannelMask = SPEAKER_FRONT_CENTER;
-		Desc.Description = L"Analog Out";
+		Desc.Description = m_MixedOutput ? L"Analog Out (mixed into FM)" : L"Analog Out";
 		return true;
 
 	case AudioOut::OPN:
 		Desc.SampleRate = m_ClockSpeed / (24 * 6);
-		Desc.SampleFormat = 0;
+		Desc.SampleFormat = AudioFormat::AUDIO_FMT_S16;
 		Desc.Channels = 2;
 		Desc.ChannelMask = SPEAKER_FRONT_LEFT | SPEAKER_FRONT_RIGHT;
-		Desc.Description = L"FM + ADPCM";
+		Desc.Description = m_MixedOutput ? L"FM + ADPCM + SSG" : L"FM + ADPCM";
 		return true;
 
 	default:
-		return false;
+		break;
+	}
+
+	if (m_ChannelOutputs && (OutputNr >= ChannelADPCMA) && (OutputNr < ChannelSSG + 3))
+	{
+		Desc.SampleRate = ((OutputNr < ChannelSSG) || m_MixedOutput) ? m_ClockSpeed / (24 * 6) : m_ClockSpeed / (16 * 4);
+		Desc.SampleFormat = AudioFormat::AUDIO_FMT_S16;
+		Desc.Channels = 1;
+		Desc.ChannelMask = SPEAKER_FRONT_CENTER;
+
+		if (OutputNr >= ChannelSSG) Desc.Description = std::wstring(L"SSG ") + wchar_t(L'A' + OutputNr - ChannelSSG);
+		else if (OutputNr == ChannelADPCMB) Desc.Description = L"ADPCM-B";
+		else Desc.Description = L"ADPCM-A " + std::to_wstring(OutputNr - ChannelADPCMA + 1);
+		return true;
+	}
+
+	if (m_ChannelOutputs && (OutputNr >= AudioOut::FM1) && (OutputNr < ChannelADPCMA))
+	{
+		Desc.SampleRate = m_ClockSpeed / (24 * 6);
+		Desc.SampleFormat = AudioFormat::AUDIO_FMT_S16;
+		Desc.Channels = 1;
+		Desc.ChannelMask = SPEAKER_FRONT_CENTER;
+		Desc.Description = L"FM " + std::to_wstring(OutputNr - AudioOut::FM1 + 1);
+		return true;
 	}
 
 	return false;
@@ -230,6 +214,42 @@ uint32_t YM2610::GetClockSpeed()
 	return m_ClockSpeed;
 }
 
+bool YM2610::GetStats(TC::StatsSnapshot& Stats)
+{
+	return m_Stats.Get(Stats);
+}
+
+bool YM2610::SetChannelOutputs(bool Enable)
+{
+	m_ChannelOutputs = Enable;
+
+	return true;
+}
+
+bool YM2610::SetChannelMask(uint64_t Enabled)
+{
+	/* Unmuted FM channels need 2 warm-up samples, the ADPCM and SSG voices are exact right away */
+	m_VoiceMask.Set(Enabled | ~((1ull << (VoiceSSG + 3)) - 1));
+
+	return true;
+}
+
+bool YM2610::SetOutputRate(uint32_t OutputNr, uint32_t SampleRate)
+{
+	if (OutputNr != AudioOut::SSG) return false;
+
+	m_SynthSSG.SetRates(m_ClockSpeed / (16 * 4), SampleRate);
+
+	return true;
+}
+
+bool YM2610::SetMixedOutput(bool Enable)
+{
+	m_MixedOutput = Enable;
+
+	return true;
+}
+
 uint32_t YM2610::Read(int32_t Address)
 {
 	/* 2-bit address bus (A0 - A1) */
@@ -279,41 +299,90 @@ void YM2610::Write(uint32_t Address, uint32_t Data)
 		break;
 
 	case 0x01: /* Port 0 data write mode */
-		switch (m_AddressLatch & 0xF0)
+		WriteRegister(0, m_AddressLatch, Data);
+		break;
+
+	case 0x03: /* Port 1 data write mode */
+		WriteRegister(1, m_AddressLatch, Data);
+		break;
+	}
+}
+
+bool YM2610::WriteBatch(uint32_t Port, const REGISTER_WRITE* Writes, size_t Count)
+{
+	if (Count == 0) return true;
+
+	Port &= 0x01;
+
+	for (size_t i = 0; i < Count; i++) WriteRegister(Port, Writes[i].Register & 0xFF, Writes[i].Data & 0xFF);
+
+	/* The address latch holds the last register written */
+	m_AddressLatch = Writes[Count - 1].Register & 0xFF;
+
+	return true;
+}
+
+bool YM2610::WriteRegisters(uint32_t Port, uint32_t Register, const uint8_t* Data, size_t Count)
+{
+	if ((Register + Count) > 0x100) return false;
+
+	Port &= 0x01;
+
+	/* SSG, ADPCM and mode data (0x00 - 0x2F) */
+	for (; (Count != 0) && (Register < 0x30); Register++, Data++, Count--) WriteRegister(Port, Register, *Data);
+
+	if (Count == 0) return true;
+
+	/* FM data (0x30 - 0xB6) */
+	for (size_t i = 0; i < Count; i++) m_Stats.RegisterWrite((Port << 8) | (Register + i));
+
+	m_OPN.WriteFMRange(Register, Port, Data, Count);
+
+	return true;
+}
+
+void YM2610::WriteRegister(uint32_t Port, uint8_t Address, uint8_t Data)
+{
+	m_Stats.RegisterWrite((Port << 8) | Address);
+
+	if (Port == 0)
+	{
+		switch (Address & 0xF0)
 		{
 		case 0x00: /* Write SSG data (0x00 - 0x0F) */
-			WriteSSG(m_AddressLatch, Data);
+			WriteSSG(Address, Data);
 			break;
 
 		case 0x10: /* Write ADPCM-B data (0x10 - 0x1F) */
-			WriteADPCMB(m_AddressLatch, Data);
+			WriteADPCMB(Address, Data);
 			break;
 
 		case 0x20: /* Write OPN mode data (0x20 - 0x2F) */
-			WriteMode(m_AddressLatch, Data);
+			m_OPN.WriteMode(Address, Data, m_Stats);
 			break;
 
 		default: /* Write OPN FM data (0x30 - 0xB6) */
-			WriteFM(m_AddressLatch, 0, Data);
+			m_OPN.WriteFM(Address, 0, Data);
 			break;
 		}
-		break;
-
-	case 0x03:/* Port 1 data write mode */
-		switch (m_AddressLatch & 0xF0)
+	}
+	else
+	{
+		switch (Address & 0xF0)
 		{
 		case 0x00: /* Write ADPCM-A data (0x00 - 0x2F) */
 		case 0x10:
 		case 0x20:
-			WriteADPCMA(m_AddressLatch, Data);
+			WriteADPCMA(Address, Data);
 			break;
 
 		default: /* Write OPN FM data (0x30 - 0xB6) */
-			WriteFM(m_AddressLatch, 1, Data);
+			m_OPN.WriteFM(Address, 1, Data);
 			break;
 		}
-		break;
 	}
+
+	m_Irq.Set(m_OPN.IsIrqAsserted());
 }
 
 void YM2610::WriteSSG(uint8_t Address, uint8_t Data)
@@ -450,6 +519,11 @@ void YM2610::WriteADPCMA(uint8_t Address, uint8_t Data)
 						Channel.Step = 0;
 						Channel.Signal = 0;
 						Channel.NibbleShift = 4; /* Start at high nibble */
+
+						/* Look up the decoded sample */
+						m_SampleADPCMA[i] = m_CacheADPCMA.Get(Channel.Addr);
+
+						m_Stats.KeyOn();
 					}
 
 					Channel.KeyOn = DM;
@@ -513,14 +587,14 @@ void YM2610::WriteADPCMB(uint8_t Address, uint8_t Data)
 
 		if (m_ADPCMB.Ctrl1 & CTRL1_RESET)
 		{
-			ClearStatusFlags(FLAG_PCMBUSY | FLAG_EOS);
-			SetStatusFlags(FLAG_BRDY);
+			m_OPN.ClearStatusFlags(FLAG_PCMBUSY | FLAG_EOS);
+			m_OPN.SetStatusFlags(FLAG_BRDY);
 		}
 
 		if (m_ADPCMB.Ctrl1 & CTRL1_START)
 		{
-			ClearStatusFlags(FLAG_BRDY | FLAG_EOS);
-			SetStatusFlags(FLAG_PCMBUSY);
+			m_OPN.ClearStatusFlags(FLAG_BRDY | FLAG_EOS);
+			m_OPN.SetStatusFlags(FLAG_PCMBUSY);
 
 			m_ADPCMB.Addr = m_ADPCMB.Start.u32 << 8;
 			m_ADPCMB.AddrDelta = 0;
@@ -529,6 +603,8 @@ void YM2610::WriteADPCMB(uint8_t Address, uint8_t Data)
 			m_ADPCMB.SignalT0 = 0;
 			m_ADPCMB.Step = 127;
 			m_ADPCMB.NibbleShift = 4;
+
+			m_Stats.KeyOn();
 		}
 		break;
 
@@ -591,295 +667,147 @@ void YM2610::WriteADPCMB(uint8_t Address, uint8_t Data)
 	}
 }
 
-void YM2610::WriteMode(uint8_t Address, uint8_t Data)
+void YM2610::Update(uint32_t ClockCycles, std::vector<IAudioBuffer*>& OutBuffer)
 {
-	switch (Address) /* 0x20 - 0x2F */
-	{
-	case 0x20: /* Not used */
-		break;
-
-	case 0x21: /* LSI Test */
-		/* Not implemented */
-		break;
+	TC::DeviceStats::UpdateScope Stats(m_Stats);
 
-	case 0x22: /* LFO Control */
-		m_OPN.LFO.Enable = (Data & 0x08) ? ~0 : 0; /* Note: implemented as a mask */
-		m_OPN.LFO.Period = YM::OPN::LfoPeriod[Data & 0x07];
-		break;
-
-	case 0x23: /* Not used */
-		break;
-
-	case 0x24: /* Timer A [9:2] */
-		m_OPN.TimerA.Period &= 0x03;
-		m_OPN.TimerA.Period |= (Data << 2);
-		break;
-
-	case 0x25: /* Timer A [1:0] */
-		m_OPN.TimerA.Period &= 0x3FC;
-		m_OPN.TimerA.Period |= (Data & 0x03);
-		break;
-
-	case 0x26: /* Timer B */
-		m_OPN.TimerB.Period = Data;
-		break;
+	/* In mixed mode the SSG runs within the OPN samples */
+	if (!m_MixedOutput) UpdateSSG(ClockCycles, OutBuffer);
+	UpdateOPN(ClockCycles, OutBuffer);
 
-	case 0x27: /* 3CH mode / Timer control */
+	Stats.ActiveVoices([&]
 	{
-		/* Timer A and B start / stop */
-		auto StartA = (Data >> 0) & 0x01;
-		auto StartB = (Data >> 1) & 0x01;
+		auto Slots = std::count_if(std::begin(m_OPN.Slot), std::end(m_OPN.Slot), [](auto& Slot) { return Slot.KeyState != 0; });
+		auto ADPCMA = std::count_if(std::begin(m_ADPCMA.Channel), std::end(m_ADPCMA.Channel), [](auto& Channel) { return Channel.KeyOn != 0; });
 
-		if (m_OPN.TimerA.Load ^ StartA)
-		{
-			m_OPN.TimerA.Load = StartA;
-			m_OPN.TimerA.Counter = 1024 - m_OPN.TimerA.Period;
-		}
+		return Slots + ADPCMA + AY::ActiveTones(m_SSG.Tone) + ((m_ADPCMB.Ctrl1 & CTRL1_START) ? 1 : 0);
+	});
 
-		if (m_OPN.TimerB.Load ^ StartB)
-		{
-			m_OPN.TimerB.Load = StartB;
-			m_OPN.TimerB.Counter = (256 - m_OPN.TimerB.Period) << 4; /* Note: period x16 to sync with Timer A */
-		}
+	/* Timer overflows and ADPCM flags raise the interrupt output */
+	m_Irq.Set(m_OPN.IsIrqAsserted());
+}
 
-		/* Timer A/B enable */
-		m_OPN.TimerA.Enable = (Data >> 2) & 0x01;
-		m_OPN.TimerB.Enable = (Data >> 3) & 0x01;
+uint32_t YM2610::GetCyclesForFrames(uint32_t OutputNr, uint32_t Frames)
+{
+	/* Band-limited outputs are rendered at the output rate, mixed outputs receive no samples */
+	if (OutputNr == AudioOut::SSG) return (m_MixedOutput || m_SynthSSG.IsEnabled()) ? 0 : CyclesForFrames(Frames, 16 * 4, m_CyclesToDoSSG);
 
-		/* Timer A/B overflow flag reset */
-		if (Data & 0x10) ClearStatusFlags(FLAG_TIMERA);
-		if (Data & 0x20) ClearStatusFlags(FLAG_TIMERB);
+	/* The SSG channel outputs run at the native SSG rate (OPN rate in mixed mode) */
+	if ((OutputNr >= ChannelSSG) && (OutputNr < ChannelSSG + 3) && !m_MixedOutput) return CyclesForFrames(Frames, 16 * 4, m_CyclesToDoSSG);
 
-		/* 3CH / CSM mode */
-		m_OPN.Mode3CH = ((Data & 0xC0) != 0x00) ? 1 : 0;
-		m_OPN.ModeCSM = ((Data & 0xC0) == 0x80) ? 1 : 0;
-		break;
-	}
+	return CyclesForFrames(Frames, 24 * 6, m_CyclesToDoOPN);
+}
 
-	case 0x28: /* Key On/Off */
-	{
-		if ((Data & 0x03) == 0x00) break; /* Invalid channel */
-		if ((Data & 0x03) == 0x03) break; /* Invalid channel */
-
-		uint32_t ChannelId = (((Data & 0x03) - 1) + ((Data & 0x04) ? 2 : 0)) << 2;
-
-		m_OPN.Slot[ChannelId + S1].KeyLatch = (Data >> 4) & 0x01;
-		m_OPN.Slot[ChannelId + S2].KeyLatch = (Data >> 5) & 0x01;
-		m_OPN.Slot[ChannelId + S3].KeyLatch = (Data >> 6) & 0x01;
-		m_OPN.Slot[ChannelId + S4].KeyLatch = (Data >> 7) & 0x01;
-
-#ifdef VGM_WORKAROUND
-		/*	Note: This is a work-around as key events should not be procesed here.
-			Some VGM files write consecutive key-on / key-off data without a render update in between.
-			This causes latched key data, which has not yet been processed, to be overwritten
-		*/
-		ProcessKeyEvent(ChannelId + S1);
-		ProcessKeyEvent(ChannelId + S2);
-		ProcessKeyEvent(ChannelId + S3);
-		ProcessKeyEvent(ChannelId + S4);
-#endif // VGM_WORKAROUND
-		break;
-	}
+uint32_t YM2610::GetCyclesToNextEvent()
+{
+	/* Timer A and B count OPN samples (the ADPCM flags are not predicted) */
+	return CyclesForFrames(m_OPN.GetSamplesToTimerEvent(), 24 * 6, m_CyclesToDoOPN);
+}
 
-	case 0x29: /* Not used */
-		break;
+bool YM2610::IsSilent()
+{
+	if (!m_OPN.IsIdle() || (AY::ActiveTones(m_SSG.Tone) != 0)) return false;
 
-	case 0x2A: /* Not used */
-		break;
+	/* Rhythm / ADPCM playback */
+	for (auto& Channel : m_ADPCMA.Channel) if (Channel.KeyOn != 0) return false;
 
-	case 0x2B: /* Not used */
-		break;
+	return (m_ADPCMB.Ctrl1 & CTRL1_START) == 0;
+}
 
-	case 0x2C: /* Not used */
-		break;
+bool YM2610::SetIrqCallback(TC::IrqCallback Callback)
+{
+	m_Irq.SetCallback(std::move(Callback));
+
+	return true;
+}
 
-	case 0x2D: /* Not used */
+void YM2610::CopyToMemory(uint32_t MemoryID, size_t Offset, uint8_t* Data, size_t Size)
+{
+	switch (MemoryID)
+	{
+	case YM::OPN::Memory::ADPCMA:
+		m_MemoryADPCMA.Upload(Offset, Data, Size);
+		ResetCacheADPCMA(true);
 		break;
 
-	case 0x2E: /* Not used */
+	case YM::OPN::Memory::ADPCMB:
+		m_MemoryADPCMB.Upload(Offset, Data, Size);
 		break;
 
-	case 0x2F: /* Not used */
+	default:
 		break;
 	}
 }
 
-void YM2610::WriteFM(uint8_t Address, uint8_t Port, uint8_t Data)
+void YM2610::CopyToMemoryIndirect(uint32_t MemoryID, size_t Offset, uint8_t* Data, size_t Size)
 {
-	/* Slot address mapping: S1 - S3 - S2 - S4 */
-	static const int32_t SlotMap[2][16] =
-	{
-		{
-			/* Port 0: Channel 1 - 3 */
-			-1, O(CH2,S1), O(CH3,S1), -1, -1, O(CH2,S3), O(CH3,S3), -1,
-			-1, O(CH2,S2), O(CH3,S2), -1, -1, O(CH2,S4), O(CH3,S4), -1
-		},
-		{
-			/* Port 1: Channel 4 - 6 */
-			-1, O(CH5,S1), O(CH6,S1), -1, -1, O(CH5,S3), O(CH6,S3), -1,
-			-1, O(CH5,S2), O(CH6,S2), -1, -1, O(CH5,S4), O(CH6,S4), -1
-		}
-	};
-
-	int32_t SlotId = SlotMap[Port][Address & 0x0F];
-	if (SlotId == -1) return;
-
-	if (Address < 0xA0) /* Slot register map (0x30 - 0x9F) */
-	{
-		auto& Slot = m_OPN.Slot[SlotId];
-
-		switch (Address & 0xF0)
-		{
-		case 0x30: /* Detune / Multiply */
-			Slot.Detune = (Data >> 4) & 0x07;
-			Slot.Multi = (Data & 0x0F) << 1;
-			if (Slot.Multi == 0) Slot.Multi = 1;
-			break;
-
-		case 0x40: /* Total Level */
-			Slot.TotalLevel = (Data & 0x7F) << 3;
-			break;
-
-		case 0x50: /* Key Scale / Attack Rate */
-			Slot.KeyScale = (Data >> 6);
-			Slot.EgRate[ADSR::Attack] = Data & 0x1F;
-			break;
-
-		case 0x60: /* Decay Rate / AM On */
-			Slot.AmOn = (Data & 0x80) ? ~0 : 0; /* Note: AM On/Off is implemented as a mask */
-			Slot.EgRate[ADSR::Decay] = Data & 0x1F;
-			break;
-
-		case 0x70: /* Sustain Rate */
-			Slot.EgRate[ADSR::Sustain] = Data & 0x1F;
-			break;
-
-		case 0x80: /* Sustain Level / Release Rate */
-			/* If all SL bits are set, SL is 93dB. See YM2608 manual page 28 */
-			Slot.SustainLvl = (Data >> 4) & 0x0F;
-			Slot.SustainLvl |= (Slot.SustainLvl + 1) & 0x10;
-			Slot.SustainLvl <<= 5;
-
-			/* Map RR from 4 to 5 bits, with LSB always set to 1 */
-			Slot.EgRate[ADSR::Release] = ((Data & 0x0F) << 1) | 0x01;
-			break;
+	/* No specialized implementation needed */
+	CopyToMemory(MemoryID, Offset, Data, Size);
+}
 
-		case 0x90: /* SSG-EG Envelope Control */
-			Slot.SsgEnable = (Data >> 3) & 0x01;
-			Slot.SsgEgInv = (Data >> 2) & 0x01;
-			Slot.SsgEgAlt = (Data >> 1) & 0x01;
-			Slot.SsgEgHld = (Data >> 0) & 0x01;
-			break;
-		}
-	}
-	else /* Channel register map (0xA0 - 0xB6) */
+bool YM2610::AttachMemory(uint32_t MemoryID, const uint8_t* Data, size_t Size)
+{
+	switch (MemoryID)
 	{
-		auto& Chan = m_OPN.Channel[SlotId >> 2];
-
-		switch (Address & 0xFC)
-		{
-		case 0xA0: /* F-Num 1 */
-			Chan.FNum = m_OPN.FnumLatch | Data;
-			Chan.Block = m_OPN.BlockLatch;
-			Chan.KeyCode = (Chan.Block << 2) | YM::OPN::Note[Chan.FNum >> 7];
-			break;
-
-		case 0xA4: /* F-Num 2 / Block Latch */
-			m_OPN.FnumLatch = (Data & 0x07) << 8;
-			m_OPN.BlockLatch = (Data >> 3) & 0x07;
-			break;
-		case 0xA8: /* 3 Ch-3 F-Num  */
-			if (Port == 0)
-			{
-				/* Slot order for 3CH mode */
-				if (Address == 0xA9)
-				{
-					m_OPN.Fnum3CH[S1] = m_OPN.FnumLatch3CH | Data;
-					m_OPN.Block3CH[S1] = m_OPN.BlockLatch3CH;
-					m_OPN.KeyCode3CH[S1] = (m_OPN.Block3CH[S1] << 2) | YM::OPN::Note[m_OPN.Fnum3CH[S1] >> 7];
-				}
-				else if (Address == 0xA8)
-				{
-					m_OPN.Fnum3CH[S3] = m_OPN.FnumLatch3CH | Data;
-					m_OPN.Block3CH[S3] = m_OPN.BlockLatch3CH;
-					m_OPN.KeyCode3CH[S3] = (m_OPN.Block3CH[S3] << 2) | YM::OPN::Note[m_OPN.Fnum3CH[S3] >> 7];
-				}
-				else /* 0xAA */
-				{
-					m_OPN.Fnum3CH[S2] = m_OPN.FnumLatch3CH | Data;
-					m_OPN.Block3CH[S2] = m_OPN.BlockLatch3CH;
-					m_OPN.KeyCode3CH[S2] = (m_OPN.Block3CH[S2] << 2) | YM::OPN::Note[m_OPN.Fnum3CH[S2] >> 7];
-				}
-			}
-			break;
-
-		case 0xAC: /* 3 Ch-3 F-Num / Block Latch */
-			if (Port == 0)
-			{
-				m_OPN.FnumLatch3CH = (Data & 0x07) << 8;
-				m_OPN.BlockLatch3CH = (Data >> 3) & 0x07;
-			}
-			break;
+	case YM::OPN::Memory::ADPCMA:
+		m_MemoryADPCMA.Attach(Data, Size);
+		ResetCacheADPCMA(true);
+		return true;
 
-		case 0xB0: /* Feedback / Connection */
-			Chan.FB = (Data >> 3) & 0x07;
-			Chan.Algo = Data & 0x07;
-			break;
+	case YM::OPN::Memory::ADPCMB:
+		m_MemoryADPCMB.Attach(Data, Size);
+		return true;
 
-		case 0xB4: /* PMS / AMS / Panning */
-			Chan.MaskL = (Data & 0x80) ? ~0 : 0;
-			Chan.MaskR = (Data & 0x40) ? ~0 : 0;
-			Chan.AMS = (Data >> 4) & 0x03;
-			Chan.PMS = Data & 0x07;
-			break;
-		}
+	default:
+		return false;
 	}
 }
 
-void YM2610::SetStatusFlags(uint8_t Flags)
+size_t YM2610::GetMemorySize(uint32_t MemoryID)
 {
-	m_OPN.Status |= Flags & ~m_OPN.FlagCtrl;
-
-	if (m_OPN.Status & m_OPN.IrqEnable & Flags)
+	switch (MemoryID)
 	{
-		/* TODO: Set interrupt line */
-	}
-}
+	case YM::OPN::Memory::ADPCMA:
+		return m_MemoryADPCMA.MaxSize();
 
-void YM2610::ClearStatusFlags(uint8_t Flags)
-{
-	m_OPN.Status &= ~Flags;
-}
+	case YM::OPN::Memory::ADPCMB:
+		return m_MemoryADPCMB.MaxSize();
 
-void YM2610::Update(uint32_t ClockCycles, std::vector<IAudioBuffer*>& OutBuffer)
-{
-	UpdateSSG(ClockCycles, OutBuffer);
-	UpdateOPN(ClockCycles, OutBuffer);
+	default:
+		return 0;
+	}
 }
 
-void YM2610::CopyToMemory(uint32_t MemoryID, size_t Offset, uint8_t* Data, size_t Size)
+bool YM2610::SetMemorySize(uint32_t MemoryID, size_t Size)
 {
+	/* 24-bit address bus on both memories */
+	if (!TC::IsPowerOfTwo(Size) || (Size > 0x1000000)) return false;
+
 	switch (MemoryID)
 	{
 	case YM::OPN::Memory::ADPCMA:
-		if ((Offset + Size) > m_MemoryADPCMA.size()) break;
-		memcpy(m_MemoryADPCMA.data() + Offset, Data, Size);
-		break;
+		m_MemoryADPCMA.SetMaxSize(Size);
+		ResetCacheADPCMA(true);
+		return true;
 
 	case YM::OPN::Memory::ADPCMB:
-		if ((Offset + Size) > m_MemoryADPCMB.size()) break;
-		memcpy(m_MemoryADPCMB.data() + Offset, Data, Size);
-		break;
+		m_MemoryADPCMB.SetMaxSize(Size);
+		return true;
 
 	default:
-		break;
+		return false;
 	}
 }
 
-void YM2610::CopyToMemoryIndirect(uint32_t MemoryID, size_t Offset, uint8_t* Data, size_t Size)
+bool YM2610::RevertMemory()
 {
-	/* No specialized implementation needed */
-	CopyToMemory(MemoryID, Offset, Data, Size);
+	/* Sample ROM only, the device never writes to it */
+	return true;
+}
+
+size_t YM2610::GetResidentSize()
+{
+	return m_MemoryADPCMA.GetResidentSize() + m_MemoryADPCMB.GetResidentSize() + m_CacheADPCMA.GetResidentSize();
 }
 
 void YM2610::UpdateSSG(uint32_t ClockCycles, std::vector<IAudioBuffer*>& OutBuffer)
@@ -888,124 +816,88 @@ void YM2610::UpdateSSG(uint32_t ClockCycles, std::vector<IAudioBuffer*>& OutBuff
 	uint32_t Samples = TotalCycles / (16 * 4);
 	m_CyclesToDoSSG = TotalCycles % (16 * 4);
 
+	AudioBlock<int16_t> Block(OutBuffer[AudioOut::SSG]);
+	AudioTaps<3> Taps(OutBuffer, ChannelSSG, m_ChannelOutputs);
+
+	/* Follow clock and prescaler changes */
+	m_SynthSSG.SetInputRate(m_ClockSpeed / (16 * 4));
+
 	int16_t Out;
-	uint32_t Mask;
+	int16_t ToneOut[3];
+
+	/* Muted tones skip the amplitude control and mixing */
+	uint32_t Muted = (m_VoiceMask.Skip() >> VoiceSSG) & 0x07;
 
 	while (Samples-- != 0)
 	{
 		Out = 0;
 
-		/* Update envelope generator */
-		if ((m_SSG.Envelope.Counter += 2) >= m_SSG.Envelope.Period.u32) //FIXME: should be += 1
-		{
-			/* Reset counter */
-			m_SSG.Envelope.Counter = 0;
-
-			/* Count down step counter (31 -> 0) */
-			m_SSG.Envelope.Step -= m_SSG.Envelope.StepDec;
+		/* Update envelope, noise and tone generators */
+		AY::UpdateGenerators(m_SSG);
 
-			if (m_SSG.Envelope.Step & 32) /* Envelope cycle completed */
-			{
-				/* Restart cycle */
-				m_SSG.Envelope.Step = 31;
-
-				/* Stop counting (if needed) */
-				m_SSG.Envelope.StepDec = m_SSG.Envelope.Hld ^ 1;
-
-				/* Toggle output inversion */
-				m_SSG.Envelope.Inv ^= m_SSG.Envelope.Alt;
-			}
-
-			/* Apply output inversion and lookup amplitude */
-			m_SSG.Envelope.Amplitude = AY::Amplitude32[m_SSG.Envelope.Step ^ m_SSG.Envelope.Inv];
-		}
-
-		/* Update noise generator */
-		if (m_SSG.Noise.Prescaler ^= 1)
+		/* Mix and buffer tone generators */
+		for (auto i = 0; i < 3; i++)
 		{
-			if ((m_SSG.Noise.Counter += 2) >= m_SSG.Noise.Period) //FIXME: should be += 1
-			{
-				/* Reset counter */
-				m_SSG.Noise.Counter = 0;
+			ToneOut[i] = 0;
 
-				/* Update output flag */
-				m_SSG.Noise.Output = m_SSG.Noise.LFSR & 1;
+			if ((Muted >> i) & 1) continue;
 
-				/* Tap bits 3 and 0 (XOR feedback) */
-				uint32_t Seed = ((m_SSG.Noise.LFSR >> 3) ^ (m_SSG.Noise.LFSR >> 0)) & 1;
-
-				/* Shift LFSR and apply seed (17-bit wide) */
-				m_SSG.Noise.LFSR = (m_SSG.Noise.LFSR >> 1) | (Seed << 16);
-			}
+			ToneOut[i] = AY::ToneOutput(m_SSG, m_SSG.Tone[i]);
+			Out += ToneOut[i];
 		}
 
-		/* Update, mix and buffer tone generators */
-		for (auto i = 0; i < 3; i++)
-		{
-			auto& Tone = m_SSG.Tone[i];
-
-			if ((Tone.Counter += 2) >= Tone.Period.u32) //FIXME: should be += 1
-			{
-				/* Reset counter */
-				Tone.Counter = 0;
-
-				/* Toggle output flag */
-				Tone.Output ^= 1;
-			}
+		/* 16-bit output */
+		m_SynthSSG.Write(Out >> 1, Block);
 
-			/* Mix tone and noise (implemented as a mask) */
-			Mask = ~(((Tone.Output | Tone.ToneDisable) & (m_SSG.Noise.Output | Tone.NoiseDisable)) - 1);
+		if (Taps.IsActive())
+		{
+			for (auto& Sample : ToneOut) Sample >>= 1;
 
-			/* Amplitude control */
-			Out += (Tone.AmpCtrl ? m_SSG.Envelope.Amplitude : Tone.Amplitude) & Mask;
+			Taps.Write(ToneOut);
 		}
-
-		/* 16-bit output */
-		OutBuffer[AudioOut::SSG]->WriteSampleS16(Out >> 1);
 	}
+
+	/* Output the completed band-limited samples */
+	m_SynthSSG.Flush(Block);
 }
 
 void YM2610::UpdateOPN(uint32_t ClockCycles, std::vector<IAudioBuffer*>& OutBuffer)
 {
-	static const uint32_t SlotOrder[] =
-	{
-		 O(CH2,S1), O(CH3,S1), O(CH5,S1), O(CH6,S1),
-		 O(CH2,S3), O(CH3,S3), O(CH5,S3), O(CH6,S3),
-		 O(CH2,S2), O(CH3,S2), O(CH5,S2), O(CH6,S2),
-		 O(CH2,S4), O(CH3,S4), O(CH5,S4), O(CH6,S4)
-	};
-
 	uint32_t TotalCycles = ClockCycles + m_CyclesToDoOPN;
 	uint32_t Samples = TotalCycles / (24 * 6);
 	m_CyclesToDoOPN = TotalCycles % (24 * 6);
 
-	while (Samples-- != 0)
-	{
-		ClearAccumulator();
+	m_Stats.AddFrames(Samples);
 
-		/* Update Timer A, Timer B and LFO */
-		UpdateTimers();
-		UpdateLFO();
+	AudioBlock<int16_t> Block(OutBuffer[AudioOut::OPN]);
+	AudioTaps<opnb_t::Channels> TapsFM(OutBuffer, AudioOut::FM1, m_ChannelOutputs);
+	AudioTaps<7> TapsADPCM(OutBuffer, ChannelADPCMA, m_ChannelOutputs);
+	AudioTaps<3> TapsSSG(OutBuffer, ChannelSSG, m_ChannelOutputs && m_MixedOutput);
 
-		/* Update envelope clock */
-		m_OPN.EgClock = (m_OPN.EgClock + 1) % 3;
+	/* Without an output buffer only the chip state is advanced (fast-forward) */
+	bool Render = (OutBuffer[AudioOut::OPN] != nullptr) || TapsFM.IsActive() || TapsADPCM.IsActive() || TapsSSG.IsActive();
 
-		/* Update envelope counter */
-		m_OPN.EgCounter = (m_OPN.EgCounter + (m_OPN.EgClock >> 1)) & 0xFFF;
+	int16_t ChannelOut[opnb_t::Channels];
 
-		/* Update slots (operators) */
-		for (auto& Slot : SlotOrder)
-		{
-			PrepareSlot(Slot);
-			UpdatePhaseGenerator(Slot);
-			UpdateEnvelopeGenerator(Slot);
-			UpdateOperatorUnit(Slot);
-		}
+	/* Muted FM channels skip their operator units */
+	uint32_t Skip = (uint32_t)m_VoiceMask.Skip() & VoiceFM;
+	uint32_t Silent = (uint32_t)m_VoiceMask.Silent() & VoiceFM;
 
-		UpdateAccumulator(CH2);
-		UpdateAccumulator(CH3);
-		UpdateAccumulator(CH5);
-		UpdateAccumulator(CH6);
+	/* Mixed output: muted tones skip the amplitude control and mixing */
+	uint32_t MutedSSG = (m_VoiceMask.Skip() >> VoiceSSG) & 0x07;
+	int16_t OutSSG = 0;
+	int16_t ToneOut[3];
+
+	while (Samples-- != 0)
+	{
+		/* Mixed output: SSG samples within this OPN sample */
+		if (m_MixedOutput) OutSSG = AY::UpdateMixed(m_SSG, m_CyclesToDoSSG, 24 * 6, 16 * 4, MutedSSG, ToneOut);
+
+		/* Update Timer A, Timer B, LFO and envelope counter */
+		m_OPN.UpdateCounters();
+
+		/* Update slots (operators) */
+		uint32_t Active = m_OPN.UpdateSlots(Render, m_Stats, Skip);
 
 		/* Update ADPCM-A */
 		if (m_OPN.EgClock == 0) UpdateADPCMA();
@@ -1013,13 +905,37 @@ void YM2610::UpdateOPN(uint32_t ClockCycles, std::vector<IAudioBuffer*>& OutBuff
 		/* Update ADPCM-B */
 		UpdateADPCMB();
 
+		if (!Render) continue;
+
+		/* Accumulate FM channels */
+		m_OPN.UpdateAccumulator(Active, TapsFM.IsActive() ? ChannelOut : nullptr, Silent);
+
+		if (!m_VoiceMask.IsClear())
+		{
+			m_VoiceMask.Tick();
+
+			Skip = (uint32_t)m_VoiceMask.Skip() & VoiceFM;
+			Silent = (uint32_t)m_VoiceMask.Silent() & VoiceFM;
+		}
+
+		if (TapsFM.IsActive()) TapsFM.Write(ChannelOut);
+		if (TapsADPCM.IsActive()) TapsADPCM.Write(m_OutADPCM); /* ADPCM-A 1 - 6 and ADPCM-B */
+		if (TapsSSG.IsActive()) TapsSSG.Write(ToneOut);
+
 		/* Mix FM, ADPCM-A and ADPCM-B */
 		int16_t OutL = m_OPN.OutL + m_ADPCMA.OutL + m_ADPCMB.OutL;
 		int16_t OutR = m_OPN.OutR + m_ADPCMA.OutR + m_ADPCMB.OutR;
 
+		/* Mix SSG (limited to 16-bit) */
+		if (m_MixedOutput)
+		{
+			OutL = (int16_t)std::clamp(OutL + OutSSG, -32768, 32767);
+			OutR = (int16_t)std::clamp(OutR + OutSSG, -32768, 32767);
+		}
+
 		/* 16-bit output */
-		OutBuffer[AudioOut::OPN]->WriteSampleS16(OutL);
-		OutBuffer[AudioOut::OPN]->WriteSampleS16(OutR);
+		Block.Write(OutL);
+		Block.Write(OutR);
 	}
 }
 
@@ -1028,12 +944,26 @@ void YM2610::UpdateADPCMA()
 	int16_t OutL = 0;
 	int16_t OutR = 0;
 
-	for (auto& Channel : m_ADPCMA.Channel)
+	/* Muted channels are decoded, but skip the volume control and mixing */
+	uint32_t Muted = (m_VoiceMask.Skip() >> VoiceADPCMA) & 0x3F;
+
+	for (uint32_t i = 0; i < 6; i++)
 	{
+		auto& Channel = m_ADPCMA.Channel[i];
+
+		m_OutADPCM[i] = 0;
+
 		if (Channel.KeyOn != 0)
 		{
-			/* Read nibble from memory */
-			uint8_t Nibble = (m_MemoryADPCMA[Channel.Addr] >> Channel.NibbleShift) & 0x0F;
+			/* Look up the decoded nibble, decode from memory if it is not cached */
+			if (!m_CacheADPCMA.Fetch(m_SampleADPCMA[i], Channel.Addr, Channel.NibbleShift, &Channel.Step, &Channel.Signal, [&](uint32_t Address) { return m_MemoryADPCMA.Read(Address); }))
+			{
+				/* Read nibble from memory */
+				uint8_t Nibble = (m_MemoryADPCMA.Read(Channel.Addr) >> Channel.NibbleShift) & 0x0F;
+
+				/* Decode ADPCM-A nibble */
+				YM::ADPCMA::Decode(Nibble, &Channel.Step, &Channel.Signal);
+			}
 
 			/* Alternate between 1st and 2nd nibble */
 			Channel.NibbleShift ^= 4;
@@ -1044,8 +974,7 @@ void YM2610::UpdateADPCMA()
 			/* Check for end address (inclusive) */
 			if ((Channel.Addr >> 8) > Channel.End.u32) Channel.KeyOn = 0;
 
-			/* Decode ADPCM-A nibble */
-			YM::ADPCMA::Decode(Nibble, &Channel.Step, &Channel.Signal);
+			if ((Muted >> i) & 1) continue;
 
 			uint32_t Attn = m_ADPCMA.TotalLevel + Channel.Level;
 
@@ -1060,6 +989,8 @@ void YM2610::UpdateADPCMA()
 				/* Multiply and shift ADPCM-A signal */
 				int16_t Sample = (Volume * Channel.Signal) >> 10;
 
+				m_OutADPCM[i] = Sample;
+
 				/* Accumulate samples */
 				OutL += Sample & Channel.MaskL;
 				OutR += Sample & Channel.MaskR;
@@ -1071,6 +1002,14 @@ void YM2610::UpdateADPCMA()
 	m_ADPCMA.OutR = OutR;
 }
 
+void YM2610::ResetCacheADPCMA(bool Clear)
+{
+	/* Clearing is needed when the ADPCM-A memory changed */
+	if (Clear) m_CacheADPCMA.Clear();
+
+	for (auto& Sample : m_SampleADPCMA) Sample = nullptr;
+}
+
 void YM2610::UpdateADPCMB()
 {
 	if (m_OPN.Status & FLAG_PCMBUSY)
@@ -1083,7 +1022,7 @@ void YM2610::UpdateADPCMB()
 			m_ADPCMB.AddrDelta.u16h = 0;
 
 			/* Read nibble from external memory */
-			uint8_t Nibble = (m_MemoryADPCMB[m_ADPCMB.Addr] >> m_ADPCMB.NibbleShift) & 0x0F;
+			uint8_t Nibble = (m_MemoryADPCMB.Read(m_ADPCMB.Addr) >> m_ADPCMB.NibbleShift) & 0x0F;
 
 			/* Alternate between 1st and 2nd nibble */
 			m_ADPCMB.NibbleShift ^= 4;
@@ -1106,8 +1045,8 @@ void YM2610::UpdateADPCMB()
 				}
 				else /* Stop */
 				{
-					ClearStatusFlags(FLAG_PCMBUSY);
-					SetStatusFlags(FLAG_EOS);
+					m_OPN.ClearStatusFlags(FLAG_PCMBUSY);
+					m_OPN.SetStatusFlags(FLAG_EOS);
 				}
 			}
 
@@ -1118,6 +1057,16 @@ void YM2610::UpdateADPCMB()
 			YM::ADPCMB::Decode(Nibble, &m_ADPCMB.Step, &m_ADPCMB.SignalT1);
 		}
 
+		if ((m_VoiceMask.Skip() >> VoiceADPCMB) & 1)
+		{
+			/* Muted, the decoder state is advanced only */
+			m_OutADPCM[6] = 0;
+
+			m_ADPCMB.OutL = 0;
+			m_ADPCMB.OutR = 0;
+			return;
+		}
+
 		/* Linear interpolation */
 		uint16_t T0 = 0x10000 - m_ADPCMB.AddrDelta.u16l;
 		uint16_t T1 = m_ADPCMB.AddrDelta.u16l;
@@ -1126,453 +1075,44 @@ void YM2610::UpdateADPCMB()
 		/* Level control (15-bit)  */
 		Sample = (Sample * m_ADPCMB.LevelCtrl) >> 9;
 
+		m_OutADPCM[6] = Sample;
+
 		m_ADPCMB.OutL = Sample & m_ADPCMB.MaskL;
 		m_ADPCMB.OutR = Sample & m_ADPCMB.MaskR;
 	}
 }
 
-void YM2610::PrepareSlot(uint32_t SlotId)
+void YM2610::SaveState(StateWriter& State)
 {
-	uint32_t ChannelId = SlotId >> 2;
-	auto& Chan = m_OPN.Channel[ChannelId];
-	auto& Slot = m_OPN.Slot[SlotId];
-
-	/* Copy some values for later processing */
-	Slot.FNum = Chan.FNum;
-	Slot.Block = Chan.Block;
-	Slot.KeyCode = Chan.KeyCode;
-
-	if (m_OPN.Mode3CH)
-	{
-		auto i = SlotId & 3;
-
-		/* Get Block/FNum for channel 3: S1-S2-S3 */
-		if ((ChannelId == CH3) && (i != S4))
-		{
-			Slot.FNum = m_OPN.Fnum3CH[i];
-			Slot.Block = m_OPN.Block3CH[i];
-			Slot.KeyCode = m_OPN.KeyCode3CH[i];
-		}
-	}
-}
-
-void YM2610::UpdatePhaseGenerator(uint32_t SlotId)
-{
-	auto& Chan = m_OPN.Channel[SlotId >> 2];
-	auto& Slot = m_OPN.Slot[SlotId];
-
-	uint32_t FNum = Slot.FNum << 1; /* 11 to 12-bit */
-
-	/* LFO frequency modulation (12-bit result) */
-	FNum = (FNum + YM::OPN::LfoPmTable[FNum >> 5][m_OPN.LFO.Step >> 2][Chan.PMS]) & 0xFFF;
-
-	/* Block shift (17-bit result) */
-	uint32_t Inc = (FNum << Slot.Block) >> 2;
-
-	/* Detune (17-bit result, might overflow) */
-	Inc = (Inc + YM::OPN::Detune[Slot.KeyCode][Slot.Detune]) & 0x1FFFF;
+	State.BeginChunk("2610", 5);
 
-	/* Multiply (20-bit result) */
-	Inc = (Inc * Slot.Multi) >> 1;
+	State.Write(m_AddressLatch);
+	State.Write(m_SSG);
+	State.Write(m_OPN);
+	State.Write(m_ADPCMA);
+	State.Write(m_ADPCMB);
+	State.Write(m_CyclesToDoSSG);
+	State.Write(m_CyclesToDoOPN);
 
-	/* Update phase counter (20-bit) */
-	Slot.PgPhase = (Slot.PgPhase + Inc) & 0xFFFFF;
+	State.EndChunk();
 }
 
-void YM2610::UpdateEnvelopeGenerator(uint32_t SlotId)
+bool YM2610::LoadState(StateReader& State)
 {
-	auto& Chan = m_OPN.Channel[SlotId >> 2];
-	auto& Slot = m_OPN.Slot[SlotId];
-
-	/*-------------------------------------*/
-	/* Step 0: Key On / Off event handling */
-	/*-------------------------------------*/
-	ProcessKeyEvent(SlotId);
-
-	/*-----------------------------*/
-	/* Step 1: SSG-EG update cycle */
-	/*-----------------------------*/
-	if ((Slot.EgLevel >> 9) & Slot.SsgEnable)
-	{
-		if (Slot.KeyState) /* Attack, decay or sustain phase */
-		{
-			if (Slot.SsgEgHld) /* Hold mode */
-			{
-				/* Set output inversion to the hold state */
-				Slot.SsgEgInvOut = Slot.SsgEgInv ^ Slot.SsgEgAlt;
-			}
-			else /* Repeating mode */
-			{
-				StartEnvelope(SlotId);
+	if (!State.BeginChunk("2610", 5)) return false;
 
-				/* Flip output inversion flag (if alternating) */
-				Slot.SsgEgInvOut ^= Slot.SsgEgAlt;
+	State.Read(m_AddressLatch);
+	State.Read(m_SSG);
+	State.Read(m_OPN);
+	State.Read(m_ADPCMA);
+	State.Read(m_ADPCMB);
+	State.Read(m_CyclesToDoSSG);
+	State.Read(m_CyclesToDoOPN);
 
-				/* Restart the phase counter when we are repeating normally (not alternating) */
-				//if (Slot.SsgEgAlt == 0) Slot.PgPhase = 0;
-				Slot.PgPhase &= ~(Slot.SsgEgAlt - 1);
-			}
-		}
-		else /* Release phase */
-		{
-			/* Force the EG attenuation to maximum when we hit 0x200 during release */
-			Slot.EgLevel = 0x3FF;
-		}
-	}
+	/* The channels continue decoding from memory */
+	ResetCacheADPCMA(false);
 
-	/*-------------------------------*/
-	/* Step 2: Envelope update cycle */
-	/*-------------------------------*/
-	if (m_OPN.EgClock == 2)
-	{
-		/* When attacking, move to the decay phase when attenuation level is minimal */
-		if ((Slot.EgPhase | Slot.EgLevel) == 0)
-		{
-			Slot.EgPhase = ADSR::Decay;
-		}
-
-		/* If we reached the sustain level, move to the sustain phase */
-		if ((Slot.EgPhase == ADSR::Decay) && (Slot.EgLevel >= Slot.SustainLvl))
-		{
-			Slot.EgPhase = ADSR::Sustain;
-		}
-
-		/* Get key scaled rate */
-		uint32_t Rate = CalculateRate(Slot.EgRate[Slot.EgPhase], Slot.KeyCode, Slot.KeyScale);
-
-		/* Get EG counter resolution */
-		uint32_t Shift = YM::OPN::EgShift[Rate];
-		uint32_t Mask = (1 << Shift) - 1;
-
-		if ((m_OPN.EgCounter & Mask) == 0) /* Counter overflowed */
-		{
-			uint16_t Level = Slot.EgLevel;
-
-			/* Get update cycle (8 cycles in total) */
-			uint32_t Cycle = (m_OPN.EgCounter >> Shift) & 0x07;
-
-			/* Lookup attenuation adjustment */
-			uint32_t AttnInc = YM::OPN::EgLevelAdjust[Rate][Cycle];
-
-			if (Slot.EgPhase == ADSR::Attack) /* Exponential attack */
-			{
-				if (Rate < 62)
-				{
-					Level += ((~Level * AttnInc) >> 4);
-				}
-			}
-			else /* Linear decay */
-			{
-				/* When SSG-EG is active, don't update once we hit 0x200 */
-				if (((Level >> 9) & Slot.SsgEnable) == 0)
-				{
-					Level += AttnInc << (Slot.SsgEnable << 1);
-
-					/* Limit to maximum attenuation */
-					if (Level > 0x3FF) Level = 0x3FF;
-				}
-			}
-
-			Slot.EgLevel = Level;
-		}
-	}
-
-	/*-------------------------------------*/
-	/* Step 3: Envelope output calculation */
-	/*-------------------------------------*/
-	uint32_t Attn = Slot.EgLevel;
-
-	/* Apply SGG-EG output inversion */
-	if (Slot.SsgEgInvOut) Attn = (0x200 - Attn) & 0x3FF;
-
-	/* Apply total level */
-	Attn += Slot.TotalLevel;
-
-	/* Apply AM LFO */
-	Attn += (YM::OPN::LfoAmTable[m_OPN.LFO.Step][Chan.AMS] & Slot.AmOn);
-
-	/* Limit (10-bit = 4.6 fixed point) */
-	if (Attn > 0x3FF) Attn = 0x3FF;
-
-	/* Convert from 4.6 to 4.8 fixed point */
-	Slot.EgOutput = Attn << 2;
-}
-
-void YM2610::UpdateOperatorUnit(uint32_t SlotId)
-{
-	auto& Slot = m_OPN.Slot[SlotId];
+	m_Irq.Set(m_OPN.IsIrqAsserted());
 
-	/* Phase modulation (10-bit) */
-	uint32_t Phase = (Slot.PgPhase >> 10) + GetModulation(SlotId);
-
-	/* Attenuation (4.8 + 4.8 = 5.8 fixed point) */
-	uint32_t Level = YM::OPN::SineTable[Phase & 0x1FF] + Slot.EgOutput;
-
-	/* dB to linear conversion (13-bit) */
-	int16_t Output = YM::OPN::ExpTable[Level & 0xFF] >> (Level >> 8);
-
-	/* Negate output (14-bit) */
-	if (Phase & 0x200) Output = -Output;
-
-	/* The last 2 generated samples are stored */
-	Slot.Output[1] = Slot.Output[0];
-	Slot.Output[0] = Output;
-}
-
-void YM2610::ClearAccumulator()
-{
-	m_OPN.OutL = 0;
-	m_OPN.OutR = 0;
-}
-
-void YM2610::UpdateAccumulator(uint32_t ChannelId)
-{
-	int16_t Output = 0;
-	uint32_t SlotId = ChannelId << 2;
-
-	/* Accumulate output */
-	switch (m_OPN.Channel[ChannelId].Algo)
-	{
-	case 0:
-	case 1:
-	case 2:
-	case 3: /* S4 */
-		Output = m_OPN.Slot[SlotId + S4].Output[0];
-		break;
-
-	case 4: /* S2 + S4 */
-		Output = m_OPN.Slot[SlotId + S2].Output[0] + m_OPN.Slot[SlotId + S4].Output[0];
-		break;
-
-	case 5:
-	case 6: /* S2 + S3 + S4 */
-		Output = m_OPN.Slot[SlotId + S2].Output[0] + m_OPN.Slot[SlotId + S3].Output[0] + m_OPN.Slot[SlotId + S4].Output[0];
-		break;
-
-	case 7: /* S1 + S2 + S3 + S4 */
-		Output = m_OPN.Slot[SlotId + S1].Output[0] + m_OPN.Slot[SlotId + S2].Output[0] + m_OPN.Slot[SlotId + S3].Output[0] + m_OPN.Slot[SlotId + S4].Output[0];
-		break;
-	}
-
-	/* Limit (signed 14 to 13-bit) */
-	Output = std::clamp<int16_t>(Output, -8192, 8191) >> 1;
-
-	/* Mix channel output */
-	m_OPN.OutL += Output & m_OPN.Channel[ChannelId].MaskL;
-	m_OPN.OutR += Output & m_OPN.Channel[ChannelId].MaskR;
-}
-
-int16_t YM2610::GetModulation(uint32_t Cycle)
-{
-	auto& Chan = m_OPN.Channel[Cycle >> 2];
-
-	uint32_t SlotId = Cycle & 0x03;
-	uint32_t ChanId = Cycle & ~0x03;
-
-	switch (((Chan.Algo << 2) | SlotId) & 0x1F)
-	{
-	case 0x00: /* Algo: 0 - S1 */
-	case 0x04: /* Algo: 1 - S1 */
-	case 0x08: /* Algo: 2 - S1 */
-	case 0x0C: /* Algo: 3 - S1 */
-	case 0x10: /* Algo: 4 - S1 */
-	case 0x14: /* Algo: 5 - S1 */
-	case 0x18: /* Algo: 6 - S1 */
-	case 0x1C: /* Algo: 7 - S1 */
-		if (Chan.FB) /* Slot 1 self-feedback modulation (10-bit) */
-			return (m_OPN.Slot[Cycle].Output[0] + m_OPN.Slot[Cycle].Output[1]) >> (10 - Chan.FB);
-		else
-			return 0;
-
-	case 0x01: /* Algo: 0 - S2 */
-		return m_OPN.Slot[ChanId + S1].Output[0] >> 1;
-
-	case 0x02: /* Algo: 0 - S3 */
-		return m_OPN.Slot[ChanId + S2].Output[0] >> 1;
-
-	case 0x03: /* Algo: 0 - S4 */
-		return m_OPN.Slot[ChanId + S3].Output[0] >> 1;
-
-	case 0x05: /* Algo: 1 - S2 */
-		return 0;
-
-	case 0x06: /* Algo: 1 - S3 */
-		return (m_OPN.Slot[ChanId + S1].Output[1] + m_OPN.Slot[ChanId + S2].Output[0]) >> 1;
-
-	case 0x07: /* Algo: 1 - S4 */
-		return m_OPN.Slot[ChanId + S3].Output[0] >> 1;
-
-	case 0x09: /* Algo: 2 - S2 */
-		return 0;
-
-	case 0x0A: /* Algo: 2 - S3 */
-		return m_OPN.Slot[ChanId + S2].Output[0] >> 1;
-
-	case 0x0B: /* Algo: 2 - S4 */
-		return (m_OPN.Slot[ChanId + S1].Output[0] + m_OPN.Slot[ChanId + S3].Output[0]) >> 1;
-
-	case 0x0D: /* Algo: 3 - S2 */
-		return m_OPN.Slot[ChanId + S1].Output[0] >> 1;
-
-	case 0x0E: /* Algo: 3 - S3 */
-		return 0;
-
-	case 0x0F: /* Algo: 3 - S4 */
-		return (m_OPN.Slot[ChanId + S2].Output[1] + m_OPN.Slot[ChanId + S3].Output[0]) >> 1;
-
-	case 0x11: /* Algo: 4 - S2 */
-		return m_OPN.Slot[ChanId + S1].Output[0] >> 1;
-
-	case 0x12: /* Algo: 4 - S3 */
-		return 0;
-
-	case 0x13: /* Algo: 4 - S4 */
-		return m_OPN.Slot[ChanId + S3].Output[0] >> 1;
-
-	case 0x15: /* Algo: 5 - S2 */
-		return m_OPN.Slot[ChanId + S1].Output[0] >> 1;
-
-	case 0x16: /* Algo: 5 - S3 */
-		return m_OPN.Slot[ChanId + S1].Output[1] >> 1;
-
-	case 0x17: /* Algo: 5 - S4 */
-		return m_OPN.Slot[ChanId + S1].Output[0] >> 1;
-
-	case 0x19: /* Algo: 6 - S2 */
-		return m_OPN.Slot[ChanId + S1].Output[0] >> 1;
-
-	case 0x1A: /* Algo: 6 - S3 */
-	case 0x1B: /* Algo: 6 - S4 */
-		return 0;
-
-	case 0x1D: /* Algo: 7 - S2 */
-	case 0x1E: /* Algo: 7 - S3 */
-	case 0x1F: /* Algo: 7 - S4 */
-		return 0;
-	}
-
-	return 0;
-}
-
-uint8_t YM2610::CalculateRate(uint8_t Rate, uint8_t KeyCode, uint8_t KeyScale)
-{
-	uint8_t ScaledRate = 0;
-
-	/* YM2608 manual page 30 */
-	if (Rate != 0)
-	{
-		/* Calculate key scale value */
-		uint8_t KSV = KeyCode >> (3 - KeyScale);
-
-		/* Calculate key scaled rate */
-		ScaledRate = (Rate << 1) + KSV;
-
-		/* Limit to a max. of 63 */
-		if (ScaledRate > 63) ScaledRate = 63;
-	}
-
-	return ScaledRate;
-}
-
-void YM2610::ProcessKeyEvent(uint32_t SlotId)
-{
-	auto& Slot = m_OPN.Slot[SlotId];
-
-	/* Get latched key on/off state */
-	uint32_t NewState = (Slot.KeyLatch | Slot.CsmLatch);
-
-	/* Clear CSM key on flag */
-	Slot.CsmLatch = 0;
-
-	if (Slot.KeyState ^ NewState)
-	{
-		if (NewState) /* Key On */
-		{
-			/* Start envelope */
-			StartEnvelope(SlotId);
-
-			/* Reset phase counter */
-			Slot.PgPhase = 0;
-
-			/* Set SSG-EG inverted ouput flag to the initial state when we are in any SSG-EG inverted mode */
-			Slot.SsgEgInvOut = Slot.SsgEnable & Slot.SsgEgInv;
-		}
-		else /* Key Off */
-		{
-			/* Move envelope to release phase */
-			Slot.EgPhase = ADSR::Release;
-
-			if (Slot.SsgEgInvOut)
-			{
-				/* Allow the release phase to continue normally */
-				Slot.EgLevel = (0x200 - Slot.EgLevel) & 0x3FF;
-
-				/* Clear the SSG-EG inverted output flag */
-				Slot.SsgEgInvOut = 0;
-			}
-		}
-
-		Slot.KeyState = NewState;
-	}
-}
-
-void YM2610::StartEnvelope(uint32_t SlotId)
-{
-	auto& Slot = m_OPN.Slot[SlotId];
-
-	/* Move envelope to attack phase */
-	Slot.EgPhase = ADSR::Attack;
-
-	/* Instant attack */
-	if (CalculateRate(Slot.EgRate[ADSR::Attack], Slot.KeyCode, Slot.KeyScale) >= 62)
-	{
-		/* Instant minimum attenuation */
-		Slot.EgLevel = 0;
-	}
-}
-
-void YM2610::UpdateLFO()
-{
-	if (++m_OPN.LFO.Counter >= m_OPN.LFO.Period)
-	{
-		m_OPN.LFO.Counter = 0;
-		m_OPN.LFO.Step = (m_OPN.LFO.Step + 1) & 0x7F;
-	}
-
-	m_OPN.LFO.Step &= m_OPN.LFO.Enable;
-}
-
-void YM2610::UpdateTimers()
-{
-	if (m_OPN.TimerA.Load)
-	{
-		if (--m_OPN.TimerA.Counter == 0)
-		{
-			m_OPN.TimerA.Counter = 1024 - m_OPN.TimerA.Period;
-
-			/* Overflow flag enabled */
-			if (m_OPN.TimerA.Enable) SetStatusFlags(FLAG_TIMERA);
-
-			/* CSM Key On */
-			if (m_OPN.ModeCSM)
-			{
-				/* CSM Key-On all channel 3 slots */
-				m_OPN.Slot[8 + S1].CsmLatch = 1;
-				m_OPN.Slot[8 + S2].CsmLatch = 1;
-				m_OPN.Slot[8 + S3].CsmLatch = 1;
-				m_OPN.Slot[8 + S4].CsmLatch = 1;
-			}
-		}
-	}
-
-	if (m_OPN.TimerB.Load)
-	{
-		if (--m_OPN.TimerB.Counter == 0)
-		{
-			m_OPN.TimerB.Counter = (256 - m_OPN.TimerB.Period) << 4;
-
-			/* Overflow flag enabled */
-			if (m_OPN.TimerB.Enable) SetStatusFlags(FLAG_TIMERB);
-		}
-	}
+	return State.EndChunk();
 }
\ No newline at end of file
@@ -16,12 +16,16 @@ See LICENSE.txt in the root directory of this source tree.
 
 #include "../../Interfaces/ISoundDevice.h"
 #include "../../Interfaces/IMemoryAccess.h"
+#include "../../Interfaces/IStateAccess.h"
 #include "AY.h"
-#include "YM_OPN.h"
+#include "../../Core/BandLimited.h"
+#include "../../Core/VoiceMask.h"
+#include "YM_OPN_Engine.h"
 #include "YM.h"
+#include "ADPCM.h"
 
 /* Yamaha YM2610 (OPNB) */
-class YM2610 : public ISoundDevice, public IMemoryAccess
+class YM2610 : public ISoundDevice, public IMemoryAccess, public IStateAccess
 {
 public:
 	YM2610(uint32_t ClockSpeed = 8'000'000);
@@ -38,40 +42,36 @@ public:
 	uint32_t		GetClockSpeed();
 	uint32_t		Read(int32_t Address);
 	void			Write(uint32_t Address, uint32_t Data);
+	bool			WriteBatch(uint32_t Port, const REGISTER_WRITE* Writes, size_t Count);
+	bool			WriteRegisters(uint32_t Port, uint32_t Register, const uint8_t* Data, size_t Count);
 	void			Update(uint32_t ClockCycles, std::vector<IAudioBuffer*>& OutBuffer);
+	uint32_t		GetCyclesForFrames(uint32_t OutputNr, uint32_t Frames);
+	uint32_t		GetCyclesToNextEvent();
+	bool			IsSilent();
+	bool			SetIrqCallback(TC::IrqCallback Callback);
+	bool			GetStats(TC::StatsSnapshot& Stats);
+	bool			SetOutputRate(uint32_t OutputNr, uint32_t SampleRate);
+	bool			SetChannelOutputs(bool Enable);
+	bool			SetChannelMask(uint64_t Enabled);
+	bool			SetMixedOutput(bool Enable);
 
 	/* IMemoryAccess methods */
 	void			CopyToMemory(uint32_t MemoryID, size_t Offset, uint8_t* Data, size_t Size);
 	void			CopyToMemoryIndirect(uint32_t MemoryID, size_t Offset, uint8_t* Data, size_t Size);
+	bool			AttachMemory(uint32_t MemoryID, const uint8_t* Data, size_t Size);
+	size_t			GetMemorySize(uint32_t MemoryID);
+	bool			SetMemorySize(uint32_t MemoryID, size_t Size);
+	bool			RevertMemory();
+	size_t			GetResidentSize();
+
+	/* IStateAccess methods */
+	void			SaveState(StateWriter& State);
+	bool			LoadState(StateReader& State);
 
 private:
 
-	/* OPNB data type */
-	struct opnb_t
-	{
-		YM::OPN::operator_t	Slot[16];
-		YM::OPN::channel_t	Channel[4];
-		YM::OPN::timer_t	TimerA;
-		YM::OPN::timer_t	TimerB;
-		YM::OPN::lfo_t		LFO;
-
-		uint32_t	FnumLatch;			/* Fnum latch (3-bit) */
-		uint32_t	FnumLatch3CH;		/* Fnum latch 3CH (3-bit) */
-		uint32_t	BlockLatch;			/* Block latch (3-bit) */
-		uint32_t	BlockLatch3CH;		/* Block latch 3CH (3-bit) */
-		uint32_t	Fnum3CH[3];			/* 3CH Frequency Nr. (11-bit) */
-		uint32_t	Block3CH[3];		/* 3CH Block (3-bit) */
-		uint32_t	KeyCode3CH[3];		/* 3CH Key code (5-bit) */
-		uint32_t	EgCounter;			/* EG counter (12-bit) */
-		uint32_t	EgClock;			/* EG clock (/3 divisor) */
-		uint32_t	Mode3CH;			/* 3CH Mode enable flag */
-		uint32_t	ModeCSM;			/* CSM Mode enable flag */
-		uint8_t		Status;				/* Status register (8-bit) */
-		uint8_t		FlagCtrl;			/* Flag control register (8-bit) */
-		uint8_t		IrqEnable;			/* IRQ enable flags */
-		int16_t		OutL;				/* Accumulator ouput (L) */
-		int16_t		OutR;				/* Accumulator ouput (R) */
-	};
+	/* OPNB unit: 4 channels (CH1 and CH4 are missing), 13-bit stereo, LFO */
+	using opnb_t = YM::OPN::Engine<0x36, 13, true, false, false, false, false>;
 
 	uint8_t				m_AddressLatch;		/* Address latch (8-bit) */
 
@@ -80,41 +80,48 @@ private:
 	YM::adpcma_t		m_ADPCMA;			/* ADPCM-A unit */
 	YM::adpcmb_t		m_ADPCMB;			/* ADPCM-B unit */
 
-	std::array<uint8_t, 0x1000000>	m_MemoryADPCMA;	/* 16MB ADPCM-A memory */
-	std::array<uint8_t, 0x1000000>	m_MemoryADPCMB;	/* 16MB ADPCM-B memory */
+	SampleMemory		m_MemoryADPCMA;		/* 16MB ADPCM-A memory */
+	SampleMemory		m_MemoryADPCMB;		/* 16MB ADPCM-B memory */
+
+	ADPCMCache			m_CacheADPCMA;		/* Decoded ADPCM-A samples */
+	ADPCMCache::sample_t*	m_SampleADPCMA[6];	/* Decoded sample per ADPCM-A channel (not part of the state) */
 
 	uint32_t	m_ClockSpeed;
 	uint32_t	m_CyclesToDoSSG;
 	uint32_t	m_CyclesToDoOPN;
+	TC::DeviceStats	m_Stats;
+	TC::IrqLine		m_Irq;		/* Interrupt output (not part of the state) */
+
+	TC::BandLimitedSynth m_SynthSSG; /* SSG output rate synthesis (not part of the state) */
+
+	/* Per-channel outputs (not part of the state) */
+	static constexpr uint32_t ChannelADPCMA = 2 + opnb_t::Channels;	/* Output number of ADPCM-A 1 */
+	static constexpr uint32_t ChannelADPCMB = ChannelADPCMA + 6;
+	static constexpr uint32_t ChannelSSG = ChannelADPCMB + 1;		/* Output number of SSG A */
+
+	bool		m_ChannelOutputs;
+	bool		m_MixedOutput;		/* SSG mixed into the FM output (not part of the state) */
+	int16_t		m_OutADPCM[7];		/* ADPCM-A 1 - 6 and ADPCM-B outputs before panning */
 
+	/* Channel mask voices (same order as the per-channel outputs, not part of the state) */
+	static constexpr uint32_t VoiceFM = (1 << opnb_t::Channels) - 1;
+	static constexpr uint32_t VoiceADPCMA = opnb_t::Channels;	/* Voice number of ADPCM-A 1 */
+	static constexpr uint32_t VoiceADPCMB = VoiceADPCMA + 6;
+	static constexpr uint32_t VoiceSSG = VoiceADPCMB + 1;		/* Voice number of SSG A */
+
+	TC::VoiceMask	m_VoiceMask;
+
+	void		WriteRegister(uint32_t Port, uint8_t Address, uint8_t Data);
 	void		WriteSSG(uint8_t Address, uint8_t Data);
 	void		WriteADPCMA(uint8_t Address, uint8_t Data);
 	void		WriteADPCMB(uint8_t Address, uint8_t Data);
-	void		WriteMode(uint8_t Address, uint8_t Data);
-	void		WriteFM(uint8_t Address, uint8_t Port, uint8_t Data);
-
-	void		SetStatusFlags(uint8_t Flags);
-	void		ClearStatusFlags(uint8_t Flags);
 
 	void		UpdateSSG(uint32_t ClockCycles, std::vector<IAudioBuffer*>& OutBuffer);
 	void		UpdateOPN(uint32_t ClockCycles, std::vector<IAudioBuffer*>& OutBuffer);
 
 	void		UpdateADPCMA();
+	void		ResetCacheADPCMA(bool Clear);
 	void		UpdateADPCMB();
-
-	void		PrepareSlot(uint32_t SlotId);
-	void		UpdatePhaseGenerator(uint32_t SlotId);
-	void		UpdateEnvelopeGenerator(uint32_t SlotId);
-	void		UpdateOperatorUnit(uint32_t SlotId);
-	void		ClearAccumulator();
-	void		UpdateAccumulator(uint32_t SlotId);
-	void		UpdateLFO();
-	void		UpdateTimers();
-
-	int16_t		GetModulation(uint32_t SlotId);
-	uint8_t		CalculateRate(uint8_t Rate, uint8_t KeyCode, uint8_t KeyScale);
-	void		ProcessKeyEvent(uint32_t SlotId);
-	void		StartEnvelope(uint32_t SlotId);
 };
 
 #endif // !_YM2610_H_
\ No newline at end of file
@@ -14,8 +14,6 @@ See LICENSE.txt in the root directory of this source tree.
 #include "YM2612.h"
 #include "YM.h"
 
-#define VGM_WORKAROUND /* Workaround for VGM files */
-
 /*
 	Yamaha YM2612 (OPN2)
 
@@ -43,7 +41,8 @@ See LICENSE.txt in the root directory of this source tree.
 /* Audio output enumeration */
 enum AudioOut
 {
-	OPN = 0
+	OPN = 0,
+	FM1				/* Channel outputs FM 1 - FM 6 (optional) */
 };
 
 /* Slot naming */
@@ -61,53 +60,17 @@ enum ChannelName
 /* Name to Slot ID */
 #define O(c, s) { (c << 2) + s}
 
-/* Envelope phases */
-enum ADSR: uint32_t
-{
-	Attack = 0,
-	Decay,
-	Sustain,
-	Release
-};
-
-static int16_t DacDiscontinuity[512];
-
 YM2612::YM2612(uint32_t ClockSpeed) :
-	m_ClockSpeed(ClockSpeed)
+	m_ClockSpeed(ClockSpeed),
+	m_OutputFormat(AudioFormat::AUDIO_FMT_S16),
+	m_SlotGroups(YM::OPN::SIMD::IsSupported()),
+	m_ChannelOutputs(false),
+	m_VoiceMask(0x3F, 2),
+	m_OutputRate(0),
+	m_FastPos(0),
+	m_FastTicks(0),
+	m_SlotGroup()
 {
-	static bool Initialized = false;
-
-	/* Build DAC discontinuity table */
-	if (!Initialized)
-	{
-		Initialized = true;
-
-		for (uint16_t i = 0; i < 512; i++)
-		{
-			/*
-			TODO: This needs validation... will need real voltage measurements
-			https://docs.google.com/document/d/1ST9GbFfPnIjLT5loytFCm3pB0kWQ1Oe34DCBBV8saY8/pub
-			*/
-
-			int16_t DacOut = i & 0xFF;
-
-			if (i & 256) /* Negative output */
-			{
-				DacOut -= 256;
-				DacOut -= 3;
-			}
-			else /* Positive output */
-			{
-				/* Do we need to apply an offset on the positive side ? */
-				DacOut += 0;
-			}
-
-			DacDiscontinuity[i] = DacOut << 5; /* Signed 9 to 14-bit */
-		}
-	}
-	
-	YM::OPN::BuildTables();
-
 	Reset(ResetType::PowerOnDefaults);
 }
 
@@ -125,57 +88,96 @@ void YM2612::Reset(ResetType Type)
 	m_PortLatch = 0;
 
 	/* Reset OPN unit */
-	memset(&m_OPN, 0, sizeof(m_OPN));
+	m_OPN.Reset();
 
-	/* Default general register state */
-	m_OPN.LFO.Period = YM::OPN::LfoPeriod[0];
+	/* Both timers drive the interrupt output */
+	m_OPN.IrqEnable = YM::OPN::FlagTimerB | YM::OPN::FlagTimerA;
 
-	/* Default operator register state */
-	for (auto& Slot : m_OPN.Slot)
-	{
-		Slot.Multi = 1; /* x0.5 */
-		Slot.EgPhase = ADSR::Release;
-		Slot.EgLevel = 0x3FF;
-	}
+	m_DacStream.Stop();
 
-	/* Default channel register state */
-	for (auto& Channel : m_OPN.Channel)
-	{
-		/* All channels are ON by default for OPN compatibility */
-		Channel.MaskL = ~0;
-		Channel.MaskR = ~0;
-	}
+	m_FastPos = 0;
+	m_FastTicks = 0;
+
+	m_Irq.Set(m_OPN.IsIrqAsserted());
 }
 
 void YM2612::SendExclusiveCommand(uint32_t Command, uint32_t Value)
 {
-	if (Command & 0x100) /* Port 1 */
-	{
-		Write(0x02, Command & 0xFF);
-		Write(0x03, Value);
-	}
-	else /* Port 0 */
-	{
-		Write(0x00, Command & 0xFF);
-		Write(0x01, Value);
-	}
+	/* Same as an address write followed by a data write */
+	m_AddressLatch = Command & 0xFF;
+	m_PortLatch = (Command >> 8) & 0x01;
+
+	WriteRegister(m_PortLatch, m_AddressLatch, Value & 0xFF);
 }
 
 bool YM2612::EnumAudioOutputs(uint32_t OutputNr, AUDIO_OUTPUT_DESC& Desc)
 {
 	if (OutputNr == AudioOut::OPN)
 	{
-		Desc.SampleRate = m_ClockSpeed / (6 * 24);
-		Desc.SampleFormat = 0;
+		Desc.SampleRate = (m_OutputRate != 0) ? m_OutputRate : m_ClockSpeed / (6 * 24);
+		Desc.SampleFormat = m_OutputFormat;
 		Desc.Channels = 2;
 		Desc.ChannelMask = SPEAKER_FRONT_LEFT | SPEAKER_FRONT_RIGHT;
 		Desc.Description = L"FM";
 		return true;
 	}
 
+	if (m_ChannelOutputs && (OutputNr >= AudioOut::FM1) && (OutputNr < (AudioOut::FM1 + opn2_t::Channels)))
+	{
+		uint32_t ChannelNr = OutputNr - AudioOut::FM1 + 1;
+
+		Desc.SampleRate = (m_OutputRate != 0) ? m_OutputRate : m_ClockSpeed / (6 * 24);
+		Desc.SampleFormat = AudioFormat::AUDIO_FMT_S16;
+		Desc.Channels = 1;
+		Desc.ChannelMask = SPEAKER_FRONT_CENTER;
+		Desc.Description = (ChannelNr == 6) ? L"FM 6 / DAC" : L"FM " + std::to_wstring(ChannelNr);
+		return true;
+	}
+
 	return false;
 }
 
+bool YM2612::SetOutputRate(uint32_t OutputNr, uint32_t SampleRate)
+{
+	/*	Fast render mode: the FM unit is rendered straight at the output rate (below the native rate)
+		The timers, LFO, EG counter and DAC stream still run at the native rate. The phase generators
+		advance all native samples since the previous output sample at once and the operator units
+		are updated once per output sample. Not bit exact and without anti-aliasing, for low-power
+		playback only. The channel outputs use the same rate
+	*/
+	if ((OutputNr != AudioOut::OPN) || (SampleRate >= m_ClockSpeed / (6 * 24))) return false;
+
+	m_OutputRate = SampleRate;
+	m_FastPos = 0;
+	m_FastTicks = 0;
+
+	return true;
+}
+
+bool YM2612::SetOutputFormat(uint32_t OutputNr, uint32_t SampleFormat)
+{
+	if ((OutputNr != AudioOut::OPN) || (SampleFormat > AudioFormat::AUDIO_FMT_F32)) return false;
+
+	m_OutputFormat = SampleFormat;
+
+	return true;
+}
+
+bool YM2612::SetChannelOutputs(bool Enable)
+{
+	m_ChannelOutputs = Enable;
+
+	return true;
+}
+
+bool YM2612::SetChannelMask(uint64_t Enabled)
+{
+	/* FM 1 - 6 (FM 6 includes the DAC), unmuted channels need 2 warm-up samples */
+	m_VoiceMask.Set(Enabled | ~0x3Full);
+
+	return true;
+}
+
 void YM2612::SetClockSpeed(uint32_t ClockSpeed)
 {
 	m_ClockSpeed = ClockSpeed;
@@ -186,6 +188,11 @@ uint32_t YM2612::GetClockSpeed()
 	return m_ClockSpeed;
 }
 
+bool YM2612::GetStats(TC::StatsSnapshot& Stats)
+{
+	return m_Stats.Get(Stats);
+}
+
 uint32_t YM2612::Read(uint32_t Address)
 {
 	switch (Address & 0x03) /* 2-bit address bus (A0 - A1) */
@@ -220,799 +227,374 @@ void YM2612::Write(uint32_t Address, uint32_t Data)
 
 	case 0x01: /* Data write mode */
 	case 0x03:
-		if (m_AddressLatch < 0x30) /* Write mode data (0x20 - 0x2F) */
-		{
-			if (m_PortLatch == 0) /* Only valid for port 0 */
-			{
-				WriteMode(m_AddressLatch, Data);
-			}
-		}
-		else /* Write FM data (0x30 - 0xB6) */
-		{
-			WriteFM(m_AddressLatch, m_PortLatch, Data);
-		}
+		WriteRegister(m_PortLatch, m_AddressLatch, Data);
 		break;
 	}
 }
 
-void YM2612::WriteMode(uint8_t Address, uint8_t Data)
+bool YM2612::WriteBatch(uint32_t Port, const REGISTER_WRITE* Writes, size_t Count)
 {
-	switch (Address) /* 0x20 - 0x2F */
-	{
-	case 0x20: /* Not used */
-		break;
+	if (Count == 0) return true;
 
-	case 0x21: /* LSI Test */
-		/* Not implemented */
-		break;
+	Port &= 0x01;
 
-	case 0x22: /* LFO Control */
-		m_OPN.LFO.Enable = (Data & 0x08) ? ~0 : 0; /* Note: implemented as a mask */
-		m_OPN.LFO.Period = YM::OPN::LfoPeriod[Data & 0x07];
-		break;
+	for (size_t i = 0; i < Count; i++) WriteRegister(Port, Writes[i].Register & 0xFF, Writes[i].Data & 0xFF);
 
-	case 0x23: /* Not used */
-		break;
+	/* The latches hold the last register written */
+	m_AddressLatch = Writes[Count - 1].Register & 0xFF;
+	m_PortLatch = Port;
 
-	case 0x24: /* Timer A [9:2] */
-		m_OPN.TimerA.Period &= 0x03;
-		m_OPN.TimerA.Period |= (Data << 2);
-		break;
+	return true;
+}
 
-	case 0x25: /* Timer A [1:0] */
-		m_OPN.TimerA.Period &= 0x3FC;
-		m_OPN.TimerA.Period |= (Data & 0x03);
-		break;
+bool YM2612::WriteRegisters(uint32_t Port, uint32_t Register, const uint8_t* Data, size_t Count)
+{
+	if ((Register + Count) > 0x100) return false;
 
-	case 0x26: /* Timer B */
-		m_OPN.TimerB.Period = Data;
-		break;
+	Port &= 0x01;
 
-	case 0x27: /* 3CH mode / Timer control */
-	{
-		/* Timer A and B start / stop */
-		auto StartA = (Data >> 0) & 0x01;
-		auto StartB = (Data >> 1) & 0x01;
+	/* Write mode data (0x20 - 0x2F) */
+	for (; (Count != 0) && (Register < 0x30); Register++, Data++, Count--) WriteRegister(Port, Register, *Data);
 
-		if (m_OPN.TimerA.Load ^ StartA)
-		{
-			m_OPN.TimerA.Load = StartA;
-			m_OPN.TimerA.Counter = 1024 - m_OPN.TimerA.Period;
-		}
+	if (Count == 0) return true;
 
-		if (m_OPN.TimerB.Load ^ StartB)
-		{
-			m_OPN.TimerB.Load = StartB;
-			m_OPN.TimerB.Counter = (256 - m_OPN.TimerB.Period) << 4; /* Note: period x16 to sync with Timer A */
-		}
+	/* FM data (0x30 - 0xB6) */
+	for (size_t i = 0; i < Count; i++) m_Stats.RegisterWrite((Port << 8) | (Register + i));
 
-		/* Timer A/B enable */
-		m_OPN.TimerA.Enable = (Data >> 2) & 0x01;
-		m_OPN.TimerB.Enable = (Data >> 3) & 0x01;
+	m_OPN.WriteFMRange(Register, Port, Data, Count);
 
-		/* Timer A/B overflow flag reset */
-		if (Data & 0x10) ClearStatusFlags(FLAG_TIMERA);
-		if (Data & 0x20) ClearStatusFlags(FLAG_TIMERB);
+	return true;
+}
 
-		/* 3CH / CSM mode */
-		m_OPN.Mode3CH = ((Data & 0xC0) != 0x00) ? 1 : 0;
-		m_OPN.ModeCSM = ((Data & 0xC0) == 0x80) ? 1 : 0;
-		break;
-	}
+void YM2612::WriteRegister(uint32_t Port, uint8_t Address, uint8_t Data)
+{
+	m_Stats.RegisterWrite((Port << 8) | Address);
 
-	case 0x28: /* Key On/Off */
+	if (Address < 0x30) /* Write mode data (0x20 - 0x2F) */
 	{
-		if ((Data & 0x03) == 0x03) break; /* Invalid channel */
-
-		uint32_t ChannelId = ((Data & 0x03) + ((Data & 0x04) ? 3 : 0)) << 2;
-
-		m_OPN.Slot[ChannelId + S1].KeyLatch = (Data >> 4) & 0x01;
-		m_OPN.Slot[ChannelId + S2].KeyLatch = (Data >> 5) & 0x01;
-		m_OPN.Slot[ChannelId + S3].KeyLatch = (Data >> 6) & 0x01;
-		m_OPN.Slot[ChannelId + S4].KeyLatch = (Data >> 7) & 0x01;
-
-#ifdef VGM_WORKAROUND
-		/*	Note: This is a work-around as key events should not be procesed here.
-			Some VGM files write consecutive key-on / key-off data without a render update in between.
-			This causes latched key data, which has not yet been processed, to be overwritten
-		*/
-		ProcessKeyEvent(ChannelId + S1);
-		ProcessKeyEvent(ChannelId + S2);
-		ProcessKeyEvent(ChannelId + S3);
-		ProcessKeyEvent(ChannelId + S4);
-#endif // VGM_WORKAROUND
-		break;
+		if (Port == 0) /* Only valid for port 0 */
+		{
+			m_OPN.WriteMode(Address, Data, m_Stats);
+		}
+	}
+	else /* Write FM data (0x30 - 0xB6) */
+	{
+		m_OPN.WriteFM(Address, Port, Data);
 	}
 
-	case 0x29: /* Not used */
-		break;
+	m_Irq.Set(m_OPN.IsIrqAsserted());
+}
 
-	case 0x2A: /* DAC data */
-		m_OPN.DacData &= 0x01;
-		m_OPN.DacData |= (Data << 1);
+void YM2612::Update(uint32_t ClockCycles, std::vector<IAudioBuffer*>& OutBuffer)
+{
+	switch (m_OutputFormat)
+	{
+	case AudioFormat::AUDIO_FMT_S32:
+		if (m_OutputRate != 0) RenderFast<int32_t>(ClockCycles, OutBuffer);
+		else RenderSamples<int32_t>(ClockCycles, OutBuffer);
 		break;
 
-	case 0x2B: /* DAC select */
-		m_OPN.DacSelect = Data >> 7;
+	case AudioFormat::AUDIO_FMT_F32:
+		if (m_OutputRate != 0) RenderFast<float>(ClockCycles, OutBuffer);
+		else RenderSamples<float>(ClockCycles, OutBuffer);
 		break;
 
-	case 0x2C: /* LSI Test 2 */
-		m_OPN.DacData &= ~0x01;
-		m_OPN.DacData |= ((Data >> 3) & 0x01);
+	default:
+		if (m_OutputRate != 0) RenderFast<int16_t>(ClockCycles, OutBuffer);
+		else RenderSamples<int16_t>(ClockCycles, OutBuffer);
 		break;
+	}
 
-	case 0x2D: /* Not used */
-		break;
+	/* Timer overflows raise the interrupt output */
+	m_Irq.Set(m_OPN.IsIrqAsserted());
+}
 
-	case 0x2E: /* Not used */
-		break;
+uint32_t YM2612::GetCyclesForFrames(uint32_t OutputNr, uint32_t Frames)
+{
+	/* The fast render mode runs at the output rate */
+	if (m_OutputRate != 0) return 0;
 
-	case 0x2F: /* Not used */
-		break;
-	}
+	return CyclesForFrames(Frames, 24 * 6, m_CyclesToDo);
 }
 
-void YM2612::WriteFM(uint8_t Address, uint8_t Port, uint8_t Data)
+bool YM2612::RenderBlock(uint32_t OutputNr, uint32_t Frames, std::vector<IAudioBuffer*>& OutBuffer, const TIMED_REGISTER_WRITE* Writes, size_t Count)
 {
-	/* Slot address mapping: S1 - S3 - S2 - S4 */
-	static const int32_t SlotMap[2][16] =
-	{
-		{
-			/* Port 0: Channel 1 - 3 */
-			O(CH1,S1), O(CH2,S1), O(CH3,S1), -1, O(CH1,S3), O(CH2,S3), O(CH3,S3), -1,
-			O(CH1,S2), O(CH2,S2), O(CH3,S2), -1, O(CH1,S4), O(CH2,S4), O(CH3,S4), -1
-		},
-		{
-			/* Port 1: Channel 4 - 6 */
-			O(CH4,S1), O(CH5,S1), O(CH6,S1), -1, O(CH4,S3), O(CH5,S3), O(CH6,S3), -1,
-			O(CH4,S2), O(CH5,S2), O(CH6,S2), -1, O(CH4,S4), O(CH5,S4), O(CH6,S4), -1
-		}
-	};
+	/* The fast render mode runs at the output rate */
+	if (m_OutputRate != 0) return false;
 
-	int32_t SlotId = SlotMap[Port][Address & 0x0F];
-	if (SlotId == -1) return;
-
-	if (Address < 0xA0) /* Slot register map (0x30 - 0x9F) */
+	switch (m_OutputFormat)
 	{
-		auto& Slot = m_OPN.Slot[SlotId];
+	case AudioFormat::AUDIO_FMT_S32:
+		RenderBlock<int32_t>(Frames, OutBuffer, Writes, Count);
+		break;
 
-		switch (Address & 0xF0)
-		{
-		case 0x30: /* Detune / Multiply */
-			Slot.Detune = (Data >> 4) & 0x07;
-			Slot.Multi = (Data & 0x0F) << 1;
-			if (Slot.Multi == 0) Slot.Multi = 1;
-			break;
-
-		case 0x40: /* Total Level */
-			Slot.TotalLevel = (Data & 0x7F) << 3;
-			break;
-
-		case 0x50: /* Key Scale / Attack Rate */
-			Slot.KeyScale = (Data >> 6);
-			Slot.EgRate[ADSR::Attack] = Data & 0x1F;
-			break;
-
-		case 0x60: /* Decay Rate / AM On */
-			Slot.AmOn = (Data & 0x80) ? ~0 : 0; /* Note: AM On/Off is implemented as a mask */
-			Slot.EgRate[ADSR::Decay] = Data & 0x1F;
-			break;
-
-		case 0x70: /* Sustain Rate */
-			Slot.EgRate[ADSR::Sustain] = Data & 0x1F;
-			break;
-
-		case 0x80: /* Sustain Level / Release Rate */
-			/* If all SL bits are set, SL is 93dB. See YM2608 manual page 28 */
-			Slot.SustainLvl = (Data >> 4) & 0x0F;
-			Slot.SustainLvl |= (Slot.SustainLvl + 1) & 0x10;
-			Slot.SustainLvl <<= 5;
-
-			/* Map RR from 4 to 5 bits, with LSB always set to 1 */
-			Slot.EgRate[ADSR::Release] = ((Data & 0x0F) << 1) | 0x01;
-			break;
-
-		case 0x90: /* SSG-EG Envelope Control */
-			Slot.SsgEnable = (Data >> 3) & 0x01;
-			Slot.SsgEgInv = (Data >> 2) & 0x01;
-			Slot.SsgEgAlt = (Data >> 1) & 0x01;
-			Slot.SsgEgHld = (Data >> 0) & 0x01;
-			break;
-		}
-	}
-	else /* Channel register map (0xA0 - 0xB6) */
-	{
-		auto& Chan = m_OPN.Channel[SlotId >> 2];
+	case AudioFormat::AUDIO_FMT_F32:
+		RenderBlock<float>(Frames, OutBuffer, Writes, Count);
+		break;
 
-		switch (Address & 0xFC)
-		{
-		case 0xA0: /* F-Num 1 */
-			Chan.FNum = m_OPN.FnumLatch | Data;
-			Chan.Block = m_OPN.BlockLatch;
-			Chan.KeyCode = (Chan.Block << 2) | YM::OPN::Note[Chan.FNum >> 7];
-			break;
-
-		case 0xA4: /* F-Num 2 / Block Latch */
-			m_OPN.FnumLatch = (Data & 0x07) << 8;
-			m_OPN.BlockLatch = (Data >> 3) & 0x07;
-			break;
-		case 0xA8: /* 3 Ch-3 F-Num  */
-			if (Port == 0)
-			{
-				/* Slot order for 3CH mode */
-				if (Address == 0xA9)
-				{
-					m_OPN.Fnum3CH[S1] = m_OPN.FnumLatch3CH | Data;
-					m_OPN.Block3CH[S1] = m_OPN.BlockLatch3CH;
-					m_OPN.KeyCode3CH[S1] = (m_OPN.Block3CH[S1] << 2) | YM::OPN::Note[m_OPN.Fnum3CH[S1] >> 7];
-				}
-				else if (Address == 0xA8)
-				{
-					m_OPN.Fnum3CH[S3] = m_OPN.FnumLatch3CH | Data;
-					m_OPN.Block3CH[S3] = m_OPN.BlockLatch3CH;
-					m_OPN.KeyCode3CH[S3] = (m_OPN.Block3CH[S3] << 2) | YM::OPN::Note[m_OPN.Fnum3CH[S3] >> 7];
-				}
-				else /* 0xAA */
-				{
-					m_OPN.Fnum3CH[S2] = m_OPN.FnumLatch3CH | Data;
-					m_OPN.Block3CH[S2] = m_OPN.BlockLatch3CH;
-					m_OPN.KeyCode3CH[S2] = (m_OPN.Block3CH[S2] << 2) | YM::OPN::Note[m_OPN.Fnum3CH[S2] >> 7];
-				}
-			}
-			break;
-
-		case 0xAC: /* 3 Ch-3 F-Num / Block Latch */
-			if (Port == 0)
-			{
-				m_OPN.FnumLatch3CH = (Data & 0x07) << 8;
-				m_OPN.BlockLatch3CH = (Data >> 3) & 0x07;
-			}
-			break;
-
-		case 0xB0: /* Feedback / Connection */
-			Chan.FB = (Data >> 3) & 0x07;
-			Chan.Algo = Data & 0x07;
-			break;
-
-		case 0xB4: /* PMS / AMS / Panning */
-			Chan.MaskL = (Data & 0x80) ? ~0 : 0;
-			Chan.MaskR = (Data & 0x40) ? ~0 : 0;
-			Chan.AMS = (Data >> 4) & 0x03;
-			Chan.PMS = Data & 0x07;
-			break;
-		}
+	default:
+		RenderBlock<int16_t>(Frames, OutBuffer, Writes, Count);
+		break;
 	}
-}
 
-void YM2612::SetStatusFlags(uint8_t Flags)
-{
-	m_OPN.Status |= Flags;
+	/* Timer overflows raise the interrupt output */
+	m_Irq.Set(m_OPN.IsIrqAsserted());
 
-	if (Flags & (FLAG_TIMERA | FLAG_TIMERB))
-	{
-		/* TODO: Set interrupt line */
-	}
+	return true;
 }
 
-void YM2612::ClearStatusFlags(uint8_t Flags)
+uint32_t YM2612::GetCyclesToNextEvent()
 {
-	m_OPN.Status &= ~Flags;
+	/* Timer A and B count OPN samples */
+	return CyclesForFrames(m_OPN.GetSamplesToTimerEvent(), 24 * 6, m_CyclesToDo);
 }
 
-void YM2612::Update(uint32_t ClockCycles, std::vector<IAudioBuffer*>& OutBuffer)
+bool YM2612::IsSilent()
 {
-	static const uint32_t SlotOrder[] =
-	{
-		 O(CH1,S1), O(CH2,S1), O(CH3,S1), O(CH4,S1), O(CH5,S1), O(CH6,S1),
-		 O(CH1,S3), O(CH2,S3), O(CH3,S3), O(CH4,S3), O(CH5,S3), O(CH6,S3),
-		 O(CH1,S2), O(CH2,S2), O(CH3,S2), O(CH4,S2), O(CH5,S2), O(CH6,S2),
-		 O(CH1,S4), O(CH2,S4), O(CH3,S4), O(CH4,S4), O(CH5,S4), O(CH6,S4)
-	};
-
-	uint32_t TotalCycles = ClockCycles + m_CyclesToDo;
-	uint32_t Samples = TotalCycles / (24 * 6);
-	m_CyclesToDo = TotalCycles % (24 * 6);
-
-	while (Samples-- != 0)
-	{
-		ClearAccumulator();
-
-		/* Update Timer A, Timer B and LFO */
-		UpdateTimers();
-		UpdateLFO();
-
-		/* Update envelope clock */
-		m_OPN.EgClock = (m_OPN.EgClock + 1) % 3;
-
-		/* Update envelope counter */
-		m_OPN.EgCounter += (m_OPN.EgClock >> 1);
-		m_OPN.EgCounter += (m_OPN.EgCounter >> 12); /* Overflow bug in the OPN unit */
-		m_OPN.EgCounter &= 0xFFF;
-
-		/* Update slots (operators) */
-		for (auto& Slot : SlotOrder)
-		{
-			PrepareSlot(Slot);
-			UpdatePhaseGenerator(Slot);
-			UpdateEnvelopeGenerator(Slot);
-			UpdateOperatorUnit(Slot);
-		}
-
-		UpdateAccumulator(CH1);
-		UpdateAccumulator(CH2);
-		UpdateAccumulator(CH3);
-		UpdateAccumulator(CH4);
-		UpdateAccumulator(CH5);
-		UpdateAccumulator(CH6);
+	/* A DAC stream keeps writing the DAC register */
+	return m_OPN.IsIdle() && !m_DacStream.IsActive();
+}
 
-		/* Limiter (signed 16-bit) */
-		int16_t Mol = std::clamp(m_OPN.OutL, -32768, 32767);
-		int16_t Mor = std::clamp(m_OPN.OutR, -32768, 32767);
+bool YM2612::SetIrqCallback(TC::IrqCallback Callback)
+{
+	m_Irq.SetCallback(std::move(Callback));
 
-		/* 16-bit output */
-		OutBuffer[AudioOut::OPN]->WriteSampleS16(Mol);
-		OutBuffer[AudioOut::OPN]->WriteSampleS16(Mor);
-	}
+	return true;
 }
 
-void YM2612::PrepareSlot(uint32_t SlotId)
+template<typename T>
+void YM2612::RenderSamples(uint32_t ClockCycles, std::vector<IAudioBuffer*>& OutBuffer)
 {
-	uint32_t ChannelId = SlotId >> 2;
-	auto& Chan = m_OPN.Channel[ChannelId];
-	auto& Slot = m_OPN.Slot[SlotId];
+	AudioBlock<T> Block(OutBuffer[AudioOut::OPN]);
+	AudioTaps<opn2_t::Channels> Taps(OutBuffer, AudioOut::FM1, m_ChannelOutputs);
 
-	/* Copy some values for later processing */
-	Slot.FNum = Chan.FNum;
-	Slot.Block = Chan.Block;
-	Slot.KeyCode = Chan.KeyCode;
+	/* Sample blocks of a null output buffer are not filled at all */
+	RenderSamples<T>(ClockCycles, (OutBuffer[AudioOut::OPN] != nullptr) ? &Block : nullptr, &Taps);
+}
 
-	if (m_OPN.Mode3CH)
-	{
-		auto i = SlotId & 3;
+template<typename T>
+void YM2612::RenderBlock(uint32_t Frames, std::vector<IAudioBuffer*>& OutBuffer, const TIMED_REGISTER_WRITE* Writes, size_t Count)
+{
+	/* The output buffers are set up once for the whole block */
+	AudioBlock<T> Block(OutBuffer[AudioOut::OPN]);
+	AudioTaps<opn2_t::Channels> Taps(OutBuffer, AudioOut::FM1, m_ChannelOutputs);
 
-		/* Get Block/FNum for channel 3: S1-S2-S3 */
-		if ((ChannelId == CH3) && (i != S4))
-		{
-			Slot.FNum = m_OPN.Fnum3CH[i];
-			Slot.Block = m_OPN.Block3CH[i];
-			Slot.KeyCode = m_OPN.KeyCode3CH[i];
-		}
-	}
+	RenderBlock<T>(Frames, (OutBuffer[AudioOut::OPN] != nullptr) ? &Block : nullptr, &Taps, Writes, Count);
 }
 
-void YM2612::UpdatePhaseGenerator(uint32_t SlotId)
+template<typename T>
+void YM2612::RenderFast(uint32_t ClockCycles, std::vector<IAudioBuffer*>& OutBuffer)
 {
-	auto& Chan = m_OPN.Channel[SlotId >> 2];
-	auto& Slot = m_OPN.Slot[SlotId];
-
-	uint32_t FNum = Slot.FNum << 1; /* 11 to 12-bit */
+	uint32_t TotalCycles = ClockCycles + m_CyclesToDo;
+	uint32_t Samples = TotalCycles / (24 * 6);
+	m_CyclesToDo = TotalCycles % (24 * 6);
 
-	/* LFO frequency modulation (12-bit result) */
-	FNum = (FNum + YM::OPN::LfoPmTable[FNum >> 5][m_OPN.LFO.Step >> 2][Chan.PMS]) & 0xFFF;
+	TC::DeviceStats::UpdateScope Stats(m_Stats, Samples);
 
-	/* Block shift (17-bit result) */
-	uint32_t Inc = (FNum << Slot.Block) >> 2;
+	AudioBlock<T> Block(OutBuffer[AudioOut::OPN]);
+	AudioTaps<opn2_t::Channels> Taps(OutBuffer, AudioOut::FM1, m_ChannelOutputs);
 
-	/* Detune (17-bit result, might overflow) */
-	Inc = (Inc + YM::OPN::Detune[Slot.KeyCode][Slot.Detune]) & 0x1FFFF;
+	/* Without an output buffer only the chip state is advanced (fast-forward) */
+	bool Render = (OutBuffer[AudioOut::OPN] != nullptr) || Taps.IsActive();
 
-	/* Multiply (20-bit result) */
-	Inc = (Inc * Slot.Multi) >> 1;
+	int16_t ChannelOut[opn2_t::Channels];
 
-	/* Update phase counter (20-bit) */
-	Slot.PgPhase = (Slot.PgPhase + Inc) & 0xFFFFF;
-}
+	/* Muted channels skip their operator units */
+	uint32_t Skip = (uint32_t)m_VoiceMask.Skip() & 0x3F;
+	uint32_t Silent = (uint32_t)m_VoiceMask.Silent() & 0x3F;
 
-void YM2612::UpdateEnvelopeGenerator(uint32_t SlotId)
-{
-	auto& Chan = m_OPN.Channel[SlotId >> 2];
-	auto& Slot = m_OPN.Slot[SlotId];
+	/* Output samples per native sample (16.16 fixed point, follows clock changes) */
+	uint32_t Step = (uint32_t)std::min<uint64_t>(((uint64_t)m_OutputRate << 16) / std::max(m_ClockSpeed / (24 * 6), 1u), 0x10000);
 
-	/*-------------------------------------*/
-	/* Step 0: Key On / Off event handling */
-	/*-------------------------------------*/
-	ProcessKeyEvent(SlotId);
+	uint32_t DacValue = 0;
 
-	/*-----------------------------*/
-	/* Step 1: SSG-EG update cycle */
-	/*-----------------------------*/
-	if ((Slot.EgLevel >> 9) & Slot.SsgEnable)
-	{
-		if (Slot.KeyState) /* Attack, decay or sustain phase */
-		{
-			if (Slot.SsgEgHld) /* Hold mode */
-			{
-				/* Set output inversion to the hold state */
-				Slot.SsgEgInvOut = Slot.SsgEgInv ^ Slot.SsgEgAlt;
-			}
-			else /* Repeating mode */
-			{
-				StartEnvelope(SlotId);
-
-				/* Flip output inversion flag (if alternating) */
-				Slot.SsgEgInvOut ^= Slot.SsgEgAlt;
-
-				/* Restart the phase counter when we are repeating normally (not alternating) */
-				//if (Slot.SsgEgAlt == 0) Slot.PgPhase = 0;
-				Slot.PgPhase &= ~(Slot.SsgEgAlt - 1);
-			}
-		}
-		else /* Release phase */
-		{
-			/* Force the EG attenuation to maximum when we hit 0x200 during release */
-			Slot.EgLevel = 0x3FF;
-		}
-	}
+	if (m_DacStream.IsActive()) m_DacStream.Prepare(m_ClockSpeed, 24 * 6);
 
-	/*-------------------------------*/
-	/* Step 2: Envelope update cycle */
-	/*-------------------------------*/
-	if (m_OPN.EgClock == 2)
+	while (Samples-- != 0)
 	{
-		/* When attacking, move to the decay phase when attenuation level is minimal */
-		if ((Slot.EgPhase | Slot.EgLevel) == 0)
-		{
-			Slot.EgPhase = ADSR::Decay;
-		}
-
-		/* If we reached the sustain level, move to the sustain phase */
-		if ((Slot.EgPhase == ADSR::Decay) && (Slot.EgLevel >= Slot.SustainLvl))
-		{
-			Slot.EgPhase = ADSR::Sustain;
-		}
+		/* DAC stream data, applied like a write to register 0x2A */
+		if (m_DacStream.IsActive() && m_DacStream.Tick(DacValue)) m_OPN.WriteMode(0x2A, DacValue & 0xFF, m_Stats);
 
-		/* Get key scaled rate */
-		uint32_t Rate = CalculateRate(Slot.EgRate[Slot.EgPhase], Slot.KeyCode, Slot.KeyScale);
+		/* Update Timer A, Timer B, LFO and envelope counter */
+		m_OPN.UpdateCounters();
 
-		/* Get EG counter resolution */
-		uint32_t Shift = YM::OPN::EgShift[Rate];
-		uint32_t Mask = (1 << Shift) - 1;
+		/* Envelope generators on their EG clock cycle */
+		m_OPN.UpdateEnvelopes(m_Stats);
 
-		if ((m_OPN.EgCounter & Mask) == 0) /* Counter overflowed */
-		{
-			uint16_t Level = Slot.EgLevel;
-
-			/* Get update cycle (8 cycles in total) */
-			uint32_t Cycle = (m_OPN.EgCounter >> Shift) & 0x07;
-
-			/* Lookup attenuation adjustment */
-			uint32_t AttnInc = YM::OPN::EgLevelAdjust[Rate][Cycle];
-
-			if (Slot.EgPhase == ADSR::Attack) /* Exponential attack */
-			{
-				if (Rate < 62)
-				{
-					Level += ((~Level * AttnInc) >> 4);
-				}
-			}
-			else /* Linear decay */
-			{
-				/* When SSG-EG is active, don't update once we hit 0x200 */
-				if (((Level >> 9) & Slot.SsgEnable) == 0)
-				{
-					Level += AttnInc << (Slot.SsgEnable << 1);
-
-					/* Limit to maximum attenuation */
-					if (Level > 0x3FF) Level = 0x3FF;
-				}
-			}
-
-			Slot.EgLevel = Level;
-		}
-	}
-
-	/*-------------------------------------*/
-	/* Step 3: Envelope output calculation */
-	/*-------------------------------------*/
-	uint32_t Attn = Slot.EgLevel;
+		m_FastTicks++;
 
-	/* Apply SGG-EG output inversion */
-	if (Slot.SsgEgInvOut) Attn = (0x200 - Attn) & 0x3FF;
+		/* Output sample clock */
+		if ((m_FastPos += Step) < 0x10000) continue;
 
-	/* Apply total level */
-	Attn += Slot.TotalLevel;
+		m_FastPos -= 0x10000;
 
-	/* Apply AM LFO */
-	Attn += (YM::OPN::LfoAmTable[m_OPN.LFO.Step][Chan.AMS] & Slot.AmOn);
+		/* Update slots (operators), the phase generators advance all native samples at once */
+		uint32_t Active = m_OPN.UpdateSlotsFast(m_FastTicks, Render, Skip);
 
-	/* Limit (10-bit = 4.6 fixed point) */
-	if (Attn > 0x3FF) Attn = 0x3FF;
+		m_FastTicks = 0;
 
-	/* Convert from 4.6 to 4.8 fixed point */
-	Slot.EgOutput = Attn << 2;
-}
-
-void YM2612::UpdateOperatorUnit(uint32_t SlotId)
-{
-	auto& Slot = m_OPN.Slot[SlotId];
+		if (!Render) continue;
 
-	/* Phase modulation (10-bit) */
-	uint32_t Phase = (Slot.PgPhase >> 10) + GetModulation(SlotId);
+		/* Accumulate FM / DAC channels */
+		m_OPN.UpdateAccumulator(Active, Taps.IsActive() ? ChannelOut : nullptr, Silent);
 
-	/* Attenuation (4.8 + 4.8 = 5.8 fixed point) */
-	uint32_t Level = YM::OPN::SineTable[Phase & 0x1FF] + Slot.EgOutput;
+		if (!m_VoiceMask.IsClear())
+		{
+			m_VoiceMask.Tick();
 
-	/* dB to linear conversion (13-bit) */
-	int16_t Output = YM::OPN::ExpTable[Level & 0xFF] >> (Level >> 8);
+			Skip = (uint32_t)m_VoiceMask.Skip() & 0x3F;
+			Silent = (uint32_t)m_VoiceMask.Silent() & 0x3F;
+		}
 
-	/* Negate output (14-bit) */
-	if (Phase & 0x200) Output = -Output;
+		if (Taps.IsActive()) Taps.Write(ChannelOut);
 
-	/* The last 2 generated samples are stored */
-	Slot.Output[1] = Slot.Output[0];
-	Slot.Output[0] = Output;
-}
+		/* Limiter (signed 16-bit, F32 outputs are not limited) */
+		Block.Write(OutputSample<T>(m_OPN.OutL));
+		Block.Write(OutputSample<T>(m_OPN.OutR));
+	}
 
-void YM2612::ClearAccumulator()
-{
-	m_OPN.OutL = 0;
-	m_OPN.OutR = 0;
+	Stats.ActiveVoices([&] { return std::count_if(std::begin(m_OPN.Slot), std::end(m_OPN.Slot), [](auto& Slot) { return Slot.KeyState != 0; }); });
 }
 
-void YM2612::UpdateAccumulator(uint32_t ChannelId)
+uint32_t YM2612::UpdateSlotGroups(bool Render, uint32_t Skip)
 {
-	int16_t Output = 0;
-	uint32_t SlotId = ChannelId << 2;
-
-	if ((ChannelId == CH6) && m_OPN.DacSelect)
-	{
-		Output = m_OPN.DacData - 0x100;
-	}
-	else
+	static const uint32_t SlotOrder[] =
 	{
-		/* Accumulate output */
-		switch (m_OPN.Channel[ChannelId].Algo)
-		{
-		case 0:
-		case 1:
-		case 2:
-		case 3: /* S4 */
-			Output += m_OPN.Slot[SlotId + S4].Output[0] >> 5;
-			break;
-
-		case 4: /* S2 + S4 */
-			Output += m_OPN.Slot[SlotId + S2].Output[0] >> 5;
-			Output += m_OPN.Slot[SlotId + S4].Output[0] >> 5;
-			break;
-
-		case 5:
-		case 6: /* S2 + S3 + S4 */
-			Output += m_OPN.Slot[SlotId + S2].Output[0] >> 5;
-			Output += m_OPN.Slot[SlotId + S3].Output[0] >> 5;
-			Output += m_OPN.Slot[SlotId + S4].Output[0] >> 5;
-			break;
-
-		case 7: /* S1 + S2 + S3 + S4 */
-			Output += m_OPN.Slot[SlotId + S1].Output[0] >> 5;
-			Output += m_OPN.Slot[SlotId + S2].Output[0] >> 5;
-			Output += m_OPN.Slot[SlotId + S3].Output[0] >> 5;
-			Output += m_OPN.Slot[SlotId + S4].Output[0] >> 5;
-			break;
-		}
-	}
+		 O(CH1,S1), O(CH2,S1), O(CH3,S1), O(CH4,S1), O(CH5,S1), O(CH6,S1),
+		 O(CH1,S3), O(CH2,S3), O(CH3,S3), O(CH4,S3), O(CH5,S3), O(CH6,S3),
+		 O(CH1,S2), O(CH2,S2), O(CH3,S2), O(CH4,S2), O(CH5,S2), O(CH6,S2),
+		 O(CH1,S4), O(CH2,S4), O(CH3,S4), O(CH4,S4), O(CH5,S4), O(CH6,S4)
+	};
 
-	/* Limit (signed 9-bit) */
-	Output = std::clamp<int16_t>(Output, -256, 255);
+	uint32_t Active = 0;
 
-	/* Generate DAC output */
-	Output = DacDiscontinuity[Output & 0x1FF];
+	/* The same operator of all 6 channels at once */
+	for (uint32_t Group = 0; Group < 24; Group += 6) Active += UpdateSlotGroup(&SlotOrder[Group], Render, Skip);
 
-	/* Mix channel output */
-	m_OPN.OutL += Output & m_OPN.Channel[ChannelId].MaskL;
-	m_OPN.OutR += Output & m_OPN.Channel[ChannelId].MaskR;
+	return Active;
 }
 
-int16_t YM2612::GetModulation(uint32_t Cycle)
+uint32_t YM2612::UpdateSlotGroup(const uint32_t* SlotIds, bool Render, uint32_t Skip)
 {
-	auto& Chan = m_OPN.Channel[Cycle >> 2];
+	auto& Group = m_SlotGroup;
 
-	uint32_t SlotId = Cycle & 0x03;
-	uint32_t ChanId = Cycle & ~0x03;
+	uint32_t Active = 0;
+	uint32_t Lanes[6];
 
-	switch (((Chan.Algo << 2) | SlotId) & 0x1F)
+	/* Phase generator */
+	for (uint32_t i = 0; i < 6; i++)
 	{
-	case 0x00: /* Algo: 0 - S1 */
-	case 0x04: /* Algo: 1 - S1 */
-	case 0x08: /* Algo: 2 - S1 */
-	case 0x0C: /* Algo: 3 - S1 */
-	case 0x10: /* Algo: 4 - S1 */
-	case 0x14: /* Algo: 5 - S1 */
-	case 0x18: /* Algo: 6 - S1 */
-	case 0x1C: /* Algo: 7 - S1 */
-		if (Chan.FB) /* Slot 1 self-feedback modulation (10-bit) */
-			return (m_OPN.Slot[Cycle].Output[0] + m_OPN.Slot[Cycle].Output[1]) >> (10 - Chan.FB);
-		else
-			return 0;
-
-	case 0x01: /* Algo: 0 - S2 */
-		return m_OPN.Slot[ChanId + S1].Output[0] >> 1;
-
-	case 0x02: /* Algo: 0 - S3 */
-		return m_OPN.Slot[ChanId + S2].Output[0] >> 1;
-
-	case 0x03: /* Algo: 0 - S4 */
-		return m_OPN.Slot[ChanId + S3].Output[0] >> 1;
-
-	case 0x05: /* Algo: 1 - S2 */
-		return 0;
-
-	case 0x06: /* Algo: 1 - S3 */
-		return (m_OPN.Slot[ChanId + S1].Output[1] + m_OPN.Slot[ChanId + S2].Output[0]) >> 1;
-
-	case 0x07: /* Algo: 1 - S4 */
-		return m_OPN.Slot[ChanId + S3].Output[0] >> 1;
-
-	case 0x09: /* Algo: 2 - S2 */
-		return 0;
+		auto& Slot = m_OPN.Slot[SlotIds[i]];
 
-	case 0x0A: /* Algo: 2 - S3 */
-		return m_OPN.Slot[ChanId + S2].Output[0] >> 1;
+		/* Note: key on writes use the prepared key code, also for idle slots */
+		m_OPN.PrepareSlot(SlotIds[i]);
 
-	case 0x0B: /* Algo: 2 - S4 */
-		return (m_OPN.Slot[ChanId + S1].Output[0] + m_OPN.Slot[ChanId + S3].Output[0]) >> 1;
+		/* Idle slots are skipped, their lanes are calculated but not stored */
+		if (YM::OPN::IsIdle(Slot)) continue;
 
-	case 0x0D: /* Algo: 3 - S2 */
-		return m_OPN.Slot[ChanId + S1].Output[0] >> 1;
+		Lanes[Active++] = i;
 
-	case 0x0E: /* Algo: 3 - S3 */
-		return 0;
+		Group.FNum[i] = Slot.FNum;
+		Group.Block[i] = Slot.Block;
+		Group.KeyCode[i] = Slot.KeyCode;
+		Group.Detune[i] = Slot.Detune;
+		Group.Multi[i] = Slot.Multi;
+		Group.PMS[i] = m_OPN.Channel[SlotIds[i] >> 2].PMS;
+		Group.PgPhase[i] = Slot.PgPhase;
+	}
 
-	case 0x0F: /* Algo: 3 - S4 */
-		return (m_OPN.Slot[ChanId + S2].Output[1] + m_OPN.Slot[ChanId + S3].Output[0]) >> 1;
+	if (Active == 0) return 0;
 
-	case 0x11: /* Algo: 4 - S2 */
-		return m_OPN.Slot[ChanId + S1].Output[0] >> 1;
+	YM::OPN::SIMD::UpdatePhaseGenerator(Group, m_OPN.LFO.Step);
 
-	case 0x12: /* Algo: 4 - S3 */
-		return 0;
-
-	case 0x13: /* Algo: 4 - S4 */
-		return m_OPN.Slot[ChanId + S3].Output[0] >> 1;
+	/* Envelope generator (key events can reset the phase counter) */
+	for (uint32_t n = 0; n < Active; n++)
+	{
+		uint32_t i = Lanes[n];
+		auto& Slot = m_OPN.Slot[SlotIds[i]];
 
-	case 0x15: /* Algo: 5 - S2 */
-		return m_OPN.Slot[ChanId + S1].Output[0] >> 1;
+		Slot.PgPhase = Group.PgPhase[i];
 
-	case 0x16: /* Algo: 5 - S3 */
-		return m_OPN.Slot[ChanId + S1].Output[1] >> 1;
+		m_OPN.UpdateEnvelopeGenerator(SlotIds[i], m_Stats);
 
-	case 0x17: /* Algo: 5 - S4 */
-		return m_OPN.Slot[ChanId + S1].Output[0] >> 1;
+		Group.PgPhase[i] = Slot.PgPhase;
+		Group.EgOutput[i] = Slot.EgOutput;
+	}
 
-	case 0x19: /* Algo: 6 - S2 */
-		return m_OPN.Slot[ChanId + S1].Output[0] >> 1;
+	if (!Render) return Active;
 
-	case 0x1A: /* Algo: 6 - S3 */
-	case 0x1B: /* Algo: 6 - S4 */
-		return 0;
+	/* Operator unit, the lanes of muted channels are skipped */
+	uint32_t Count = 0;
 
-	case 0x1D: /* Algo: 7 - S2 */
-	case 0x1E: /* Algo: 7 - S3 */
-	case 0x1F: /* Algo: 7 - S4 */
-		return 0;
+	for (uint32_t n = 0; n < Active; n++)
+	{
+		if (!m_OPN.IsSkipped(SlotIds[Lanes[n]], Skip)) Lanes[Count++] = Lanes[n];
 	}
 
-	return 0;
-}
+	if (Count == 0) return Active;
 
-uint8_t YM2612::CalculateRate(uint8_t Rate, uint8_t KeyCode, uint8_t KeyScale)
-{
-	uint8_t ScaledRate = 0;
+	for (uint32_t n = 0; n < Count; n++) Group.Modulation[Lanes[n]] = m_OPN.GetModulation(SlotIds[Lanes[n]]);
 
-	/* YM2608 manual page 30 */
-	if (Rate != 0)
-	{
-		/* Calculate key scale value */
-		uint8_t KSV = KeyCode >> (3 - KeyScale);
+	YM::OPN::SIMD::UpdateOperatorUnit(Group);
 
-		/* Calculate key scaled rate */
-		ScaledRate = (Rate << 1) + KSV;
+	for (uint32_t n = 0; n < Count; n++)
+	{
+		uint32_t i = Lanes[n];
+		auto& Slot = m_OPN.Slot[SlotIds[i]];
 
-		/* Limit to a max. of 63 */
-		if (ScaledRate > 63) ScaledRate = 63;
+		/* The last 2 generated samples are stored */
+		Slot.Output[1] = Slot.Output[0];
+		Slot.Output[0] = (int16_t)Group.Output[i];
 	}
 
-	return ScaledRate;
+	return Active;
 }
 
-void YM2612::ProcessKeyEvent(uint32_t SlotId)
+void YM2612::SaveState(StateWriter& State)
 {
-	auto& Slot = m_OPN.Slot[SlotId];
-
-	/* Get latched key on/off state */
-	uint32_t NewState = (Slot.KeyLatch | Slot.CsmLatch);
+	State.BeginChunk("2612", 5);
 
-	/* Clear CSM key on flag */
-	Slot.CsmLatch = 0;
+	State.Write(m_AddressLatch);
+	State.Write(m_PortLatch);
+	State.Write(m_OPN);
+	State.Write(m_CyclesToDo);
 
-	if (Slot.KeyState ^ NewState)
-	{
-		if (NewState) /* Key On */
-		{
-			/* Start envelope */
-			StartEnvelope(SlotId);
-
-			/* Reset phase counter */
-			Slot.PgPhase = 0;
+	State.EndChunk();
+}
 
-			/* Set SSG-EG inverted ouput flag to the initial state when we are in any SSG-EG inverted mode */
-			Slot.SsgEgInvOut = Slot.SsgEnable & Slot.SsgEgInv;
-		}
-		else /* Key Off */
-		{
-			/* Move envelope to release phase */
-			Slot.EgPhase = ADSR::Release;
+bool YM2612::LoadState(StateReader& State)
+{
+	if (!State.BeginChunk("2612", 5)) return false;
 
-			if (Slot.SsgEgInvOut)
-			{
-				/* Allow the release phase to continue normally */
-				Slot.EgLevel = (0x200 - Slot.EgLevel) & 0x3FF;
+	State.Read(m_AddressLatch);
+	State.Read(m_PortLatch);
+	State.Read(m_OPN);
+	State.Read(m_CyclesToDo);
 
-				/* Clear the SSG-EG inverted output flag */
-				Slot.SsgEgInvOut = 0;
-			}
-		}
+	m_Irq.Set(m_OPN.IsIrqAsserted());
 
-		Slot.KeyState = NewState;
-	}
+	return State.EndChunk();
 }
 
-void YM2612::StartEnvelope(uint32_t SlotId)
+bool YM2612::StartDacStream(const DAC_STREAM_DESC& Desc)
 {
-	auto& Slot = m_OPN.Slot[SlotId];
+	/* Only the DAC data register (port 0) */
+	if ((Desc.Register & 0x1FF) != 0x2A) return false;
 
-	/* Move envelope to attack phase */
-	Slot.EgPhase = ADSR::Attack;
-
-	/* Instant attack */
-	if (CalculateRate(Slot.EgRate[ADSR::Attack], Slot.KeyCode, Slot.KeyScale) >= 62)
-	{
-		/* Instant minimum attenuation */
-		Slot.EgLevel = 0;
-	}
+	return m_DacStream.Start(Desc, 1);
 }
 
-void YM2612::UpdateLFO()
+void YM2612::StopDacStream()
 {
-	if (++m_OPN.LFO.Counter >= m_OPN.LFO.Period)
-	{
-		m_OPN.LFO.Counter = 0;
-		m_OPN.LFO.Step = (m_OPN.LFO.Step + 1) & 0x7F;
-	}
-
-	m_OPN.LFO.Step &= m_OPN.LFO.Enable;
+	m_DacStream.Stop();
 }
 
-void YM2612::UpdateTimers()
+void YM2612::SetDacStreamFrequency(uint32_t Frequency)
 {
-	if (m_OPN.TimerA.Load)
-	{
-		if (--m_OPN.TimerA.Counter == 0)
-		{
-			m_OPN.TimerA.Counter = 1024 - m_OPN.TimerA.Period;
-
-			/* Overflow flag enabled */
-			if (m_OPN.TimerA.Enable) SetStatusFlags(FLAG_TIMERA);
-
-			/* CSM Key On */
-			if (m_OPN.ModeCSM)
-			{
-				/* CSM Key-On all channel 3 slots */
-				m_OPN.Slot[8 + S1].CsmLatch = 1;
-				m_OPN.Slot[8 + S2].CsmLatch = 1;
-				m_OPN.Slot[8 + S3].CsmLatch = 1;
-				m_OPN.Slot[8 + S4].CsmLatch = 1;
-			}
-		}
-	}
-
-	if (m_OPN.TimerB.Load)
-	{
-		if (--m_OPN.TimerB.Counter == 0)
-		{
-			m_OPN.TimerB.Counter = (256 - m_OPN.TimerB.Period) << 4;
+	m_DacStream.SetFrequency(Frequency);
+}
 
-			/* Overflow flag enabled */
-			if (m_OPN.TimerB.Enable) SetStatusFlags(FLAG_TIMERB);
-		}
-	}
+bool YM2612::IsDacStreamActive()
+{
+	return m_DacStream.IsActive();
 }
\ No newline at end of file
@@ -15,10 +15,14 @@ See LICENSE.txt in the root directory of this source tree.
 #define _YM2612_H_
 
 #include "../../Interfaces/ISoundDevice.h"
-#include "YM_OPN.h"
+#include "../../Interfaces/IDacStream.h"
+#include "../../Interfaces/IStateAccess.h"
+#include "../../Core/VoiceMask.h"
+#include "YM_OPN_Engine.h"
+#include "YM_OPN_SIMD.h"
 
 /* Yamaha YM2612 (OPN2) */
-class YM2612 : public ISoundDevice
+class YM2612 : public ISoundDevice, public IStateAccess, public IDacStream
 {
 public:
 	YM2612(uint32_t ClockSpeed = 8'000'000);
@@ -31,67 +35,197 @@ public:
 
 	/* ISoundDevice methods */
 	bool			EnumAudioOutputs(uint32_t OutputNr, AUDIO_OUTPUT_DESC& Desc);
+	bool			SetOutputRate(uint32_t OutputNr, uint32_t SampleRate);
+	bool			SetOutputFormat(uint32_t OutputNr, uint32_t SampleFormat);
+	bool			SetChannelOutputs(bool Enable);
+	bool			SetChannelMask(uint64_t Enabled);
 	void			SetClockSpeed(uint32_t ClockSpeed);
 	uint32_t		GetClockSpeed();
 	uint32_t		Read(uint32_t Address);
 	void			Write(uint32_t Address, uint32_t Data);
+	bool			WriteBatch(uint32_t Port, const REGISTER_WRITE* Writes, size_t Count);
+	bool			WriteRegisters(uint32_t Port, uint32_t Register, const uint8_t* Data, size_t Count);
 	void			Update(uint32_t ClockCycles, std::vector<IAudioBuffer*>& OutBuffer);
+	uint32_t		GetCyclesForFrames(uint32_t OutputNr, uint32_t Frames);
+	bool			RenderBlock(uint32_t OutputNr, uint32_t Frames, std::vector<IAudioBuffer*>& OutBuffer, const TIMED_REGISTER_WRITE* Writes, size_t Count);
+	uint32_t		GetCyclesToNextEvent();
+	bool			IsSilent();
+	bool			SetIrqCallback(TC::IrqCallback Callback);
+	bool			GetStats(TC::StatsSnapshot& Stats);
 
-private:
+	/* Static dispatch update: the FM output is written to a sink of a type known at compile time as
+	   interleaved stereo samples of type T (see AudioSink), the whole render loop is inlined for it.
+	   The virtual Update is a thin wrapper around the same loop. Always renders at the native rate
+	   (the fast render mode is ignored) and without channel outputs */
+	template<typename T = int16_t, AudioSink<T> S>
+	void			Update(uint32_t ClockCycles, S& Sink)
+	{
+		RenderSamples<T>(ClockCycles, &Sink, nullptr);
+
+		m_Irq.Set(m_OPN.IsIrqAsserted());
+	}
 
-	/* OPN2 data type */
-	struct opn2_t
+	/* Static dispatch low latency render (see RenderBlock), to the same sinks as the static dispatch Update.
+	   Writes are to port 0 / 1 */
+	template<typename T = int16_t, AudioSink<T> S>
+	void			RenderBlock(uint32_t Frames, S& Sink, const TIMED_REGISTER_WRITE* Writes, size_t Count)
 	{
-		YM::OPN::operator_t	Slot[24];
-		YM::OPN::channel_t	Channel[6];
-		YM::OPN::timer_t	TimerA;
-		YM::OPN::timer_t	TimerB;
-		YM::OPN::lfo_t		LFO;
-
-		uint32_t	FnumLatch;			/* Fnum latch (3-bit) */
-		uint32_t	FnumLatch3CH;		/* Fnum latch 3CH (3-bit) */
-		uint32_t	BlockLatch;			/* Block latch (3-bit) */
-		uint32_t	BlockLatch3CH;		/* Block latch 3CH (3-bit) */
-		uint32_t	Fnum3CH[3];			/* 3CH Frequency Nr. (11-bit) */
-		uint32_t	Block3CH[3];		/* 3CH Block (3-bit) */
-		uint32_t	KeyCode3CH[3];		/* 3CH Key code (5-bit) */
-		uint32_t	EgCounter;			/* EG counter (12-bit) */
-		uint32_t	EgClock;			/* EG clock (/3 divisor) */
-		uint32_t	Mode3CH;			/* 3CH Mode enable flag */
-		uint32_t	ModeCSM;			/* CSM Mode enable flag */
-		uint8_t		Status;				/* Status register (8-bit) */
-		uint32_t	DacSelect;			/* DAC Select flag */
-		int16_t		DacData;			/* DAC Data (9-bit) */
-		int32_t		OutL;				/* Accumulator output (L) */
-		int32_t		OutR;				/* Accumulator output (R) */
-	};
+		RenderBlock<T>(Frames, &Sink, nullptr, Writes, Count);
+
+		m_Irq.Set(m_OPN.IsIrqAsserted());
+	}
+
+	/* IStateAccess methods */
+	void			SaveState(StateWriter& State);
+	bool			LoadState(StateReader& State);
+
+	/* IDacStream methods (register 0x2A, DAC data) */
+	bool			StartDacStream(const DAC_STREAM_DESC& Desc);
+	void			StopDacStream();
+	void			SetDacStreamFrequency(uint32_t Frequency);
+	bool			IsDacStreamActive();
+
+private:
+
+	/* The batch renders the instances with their own units (see YM2612Batch) */
+	friend class YM2612Batch;
+
+	/* OPN2 unit: 6 channels, 9-bit DAC, LFO, EG counter overflow bug */
+	using opn2_t = YM::OPN::Engine<0x3F, 9, true, false, true, true, false>;
 
 	uint8_t		m_AddressLatch;		/* Address latch (8-bit) */
 	uint8_t		m_PortLatch;		/* Port latch (1-bit) */
 
 	opn2_t		m_OPN;				/* OPN2 unit */
+	DacStream	m_DacStream;		/* DAC data stream */
 	
 	uint32_t	m_ClockSpeed;
 	uint32_t	m_CyclesToDo;
+	uint32_t	m_OutputFormat;		/* Output sample format */
+	bool		m_SlotGroups;		/* Vectorized slot group updates */
+	bool		m_ChannelOutputs;	/* Per-channel outputs enabled */
+	TC::VoiceMask	m_VoiceMask;	/* Enabled channels (not part of the state) */
 
-	void		WriteMode(uint8_t Register, uint8_t Data);
-	void		WriteFM(uint8_t Register, uint8_t Port, uint8_t Data);
-	void		SetStatusFlags(uint8_t Flags);
-	void		ClearStatusFlags(uint8_t Flags);
-
-	void		PrepareSlot(uint32_t SlotId);
-	void		UpdatePhaseGenerator(uint32_t SlotId);
-	void		UpdateEnvelopeGenerator(uint32_t SlotId);
-	void		UpdateOperatorUnit(uint32_t SlotId);
-	void		ClearAccumulator();
-	void		UpdateAccumulator(uint32_t SlotId);
-	void		UpdateLFO();
-	void		UpdateTimers();
-	
-	int16_t		GetModulation(uint32_t SlotId);
-	uint8_t		CalculateRate(uint8_t Rate, uint8_t KeyCode, uint8_t KeyScale);
-	void		ProcessKeyEvent(uint32_t SlotId);
-	void		StartEnvelope(uint32_t SlotId);
+	/* Fast render at the output rate (not bit exact, not part of the state) */
+	uint32_t	m_OutputRate;		/* Output sample rate (0 = native rate, exact render) */
+	uint32_t	m_FastPos;			/* Output sample clock (16.16 fixed point) */
+	uint32_t	m_FastTicks;		/* Native samples since the last output sample */
+	TC::DeviceStats	m_Stats;
+	TC::IrqLine		m_Irq;		/* Interrupt output (not part of the state) */
+
+	YM::OPN::SIMD::group_t	m_SlotGroup;	/* Slot group work area */
+
+	void		WriteRegister(uint32_t Port, uint8_t Address, uint8_t Data);
+
+	template<typename T>
+	void		RenderSamples(uint32_t ClockCycles, std::vector<IAudioBuffer*>& OutBuffer);
+	template<typename T, typename S>
+	void		RenderSamples(uint32_t ClockCycles, S* Sink, AudioTaps<opn2_t::Channels>* Taps);
+	template<typename T>
+	void		RenderFast(uint32_t ClockCycles, std::vector<IAudioBuffer*>& OutBuffer);
+	template<typename T>
+	void		RenderBlock(uint32_t Frames, std::vector<IAudioBuffer*>& OutBuffer, const TIMED_REGISTER_WRITE* Writes, size_t Count);
+	template<typename T, typename S>
+	void		RenderBlock(uint32_t Frames, S* Sink, AudioTaps<opn2_t::Channels>* Taps, const TIMED_REGISTER_WRITE* Writes, size_t Count);
+	template<typename T, typename S>
+	void		RenderFrames(uint32_t Samples, S* Sink, AudioTaps<opn2_t::Channels>* Taps);
+	uint32_t	UpdateSlotGroups(bool Render, uint32_t Skip);
+	uint32_t	UpdateSlotGroup(const uint32_t* SlotIds, bool Render, uint32_t Skip);
 };
 
+/* Exact render, shared by the virtual and the static dispatch Update.
+   Defined in the header so it can be instantiated for the sink type of the host */
+template<typename T, typename S>
+void YM2612::RenderSamples(uint32_t ClockCycles, S* Sink, AudioTaps<opn2_t::Channels>* Taps)
+{
+	uint32_t TotalCycles = ClockCycles + m_CyclesToDo;
+	uint32_t Samples = TotalCycles / (24 * 6);
+	m_CyclesToDo = TotalCycles % (24 * 6);
+
+	RenderFrames<T>(Samples, Sink, Taps);
+}
+
+/* Low latency render, the writes are applied in between runs of the render loop */
+template<typename T, typename S>
+void YM2612::RenderBlock(uint32_t Frames, S* Sink, AudioTaps<opn2_t::Channels>* Taps, const TIMED_REGISTER_WRITE* Writes, size_t Count)
+{
+	uint32_t Frame = 0;
+
+	for (size_t i = 0; i < Count; i++)
+	{
+		uint32_t Next = std::clamp(Writes[i].Frame, Frame, Frames);
+
+		if (Next != Frame) RenderFrames<T>(Next - Frame, Sink, Taps);
+		Frame = Next;
+
+		/* Same as WriteBatch: the latches hold the last register written */
+		m_PortLatch = Writes[i].Port & 0x01;
+		m_AddressLatch = Writes[i].Register & 0xFF;
+
+		WriteRegister(m_PortLatch, m_AddressLatch, Writes[i].Data & 0xFF);
+	}
+
+	if (Frame != Frames) RenderFrames<T>(Frames - Frame, Sink, Taps);
+
+	/* Exactly Frames frames were rendered, as by Render */
+	m_CyclesToDo = 0;
+}
+
+/* Exact render loop at the native rate */
+template<typename T, typename S>
+void YM2612::RenderFrames(uint32_t Samples, S* Sink, AudioTaps<opn2_t::Channels>* Taps)
+{
+	TC::DeviceStats::UpdateScope Stats(m_Stats, Samples);
+
+	bool Voices = (Taps != nullptr) && Taps->IsActive();
+
+	/* Without an output only the chip state is advanced (fast-forward) */
+	bool Render = (Sink != nullptr) || Voices;
+
+	int16_t ChannelOut[opn2_t::Channels];
+
+	/* Muted channels skip their operator units */
+	uint32_t Skip = (uint32_t)m_VoiceMask.Skip() & 0x3F;
+	uint32_t Silent = (uint32_t)m_VoiceMask.Silent() & 0x3F;
+
+	uint32_t DacValue = 0;
+
+	if (m_DacStream.IsActive()) m_DacStream.Prepare(m_ClockSpeed, 24 * 6);
+
+	while (Samples-- != 0)
+	{
+		/* DAC stream data, applied like a write to register 0x2A */
+		if (m_DacStream.IsActive() && m_DacStream.Tick(DacValue)) m_OPN.WriteMode(0x2A, DacValue & 0xFF, m_Stats);
+
+		/* Update Timer A, Timer B, LFO and envelope counter */
+		m_OPN.UpdateCounters();
+
+		/* Update slots (operators), idle slots are skipped */
+		uint32_t Active = m_SlotGroups ? UpdateSlotGroups(Render, Skip) : m_OPN.UpdateSlots(Render, m_Stats, Skip);
+
+		if (!Render) continue;
+
+		/* Accumulate FM / DAC channels */
+		m_OPN.UpdateAccumulator(Active, Voices ? ChannelOut : nullptr, Silent);
+
+		if (!m_VoiceMask.IsClear())
+		{
+			m_VoiceMask.Tick();
+
+			Skip = (uint32_t)m_VoiceMask.Skip() & 0x3F;
+			Silent = (uint32_t)m_VoiceMask.Silent() & 0x3F;
+		}
+
+		if (Voices) Taps->Write(ChannelOut);
+
+		if (Sink == nullptr) continue;
+
+		/* Limiter (signed 16-bit, F32 outputs are not limited) */
+		Sink->Write(OutputSample<T>(m_OPN.OutL));
+		Sink->Write(OutputSample<T>(m_OPN.OutR));
+	}
+
+	Stats.ActiveVoices([&] { return std::count_if(std::begin(m_OPN.Slot), std::end(m_OPN.Slot), [](auto& Slot) { return Slot.KeyState != 0; }); });
+}
+
 #endif // !_YM2612_H_
\ No newline at end of file
@@ -0,0 +1,281 @@
+/*
+ _____    _ _            ___
+|_   _| _(_) |_ ___ _ _ / __|___ _ _ ___
+  | || '_| |  _/ _ \ ' \ (__/ _ \ '_/ -_)
+  |_||_| |_|\__\___/_||_\___\___/_| \___|
+
+Copyright  2024, Michel Gerritse
+All rights reserved.
+
+This source code is available under the BSD-3-Clause license.
+See LICENSE.txt in the root directory of this source tree.
+
+*/
+#include "YM2612Batch.h"
+
+/*
+	Yamaha YM2612 (OPN2) batch
+
+	The per-sample order of every instance is the same as in YM2612::RenderFrames: DAC stream,
+	counters, slots (S1, S3, S2, S4 per channel), accumulator. The phase generator and operator unit
+	of a slot run vectorized across the instances, the envelope generator and the modulation input
+	are evaluated per instance by its own OPN unit.
+
+	Not supported in a batch: channel outputs and the fast render mode (both are ignored)
+*/
+
+YM2612Batch::YM2612Batch(uint32_t Instances, uint32_t ClockSpeed) :
+	m_Instances(std::clamp(Instances, 1u, MaxInstances)),
+	m_CyclesToDo(0),
+	m_OutputFormat(AudioFormat::AUDIO_FMT_S16),
+	m_SlotGroups(YM::OPN::SIMD::IsSupported()),
+	m_SlotGroup()
+{
+	for (uint32_t Lane = 0; Lane < m_Instances; Lane++) m_Chip[Lane] = std::make_unique<YM2612>(ClockSpeed);
+}
+
+uint32_t YM2612Batch::GetInstances()
+{
+	return m_Instances;
+}
+
+YM2612& YM2612Batch::GetInstance(uint32_t Lane)
+{
+	return *m_Chip[Lane % m_Instances];
+}
+
+void YM2612Batch::Reset(ResetType Type)
+{
+	m_CyclesToDo = 0;
+
+	for (uint32_t Lane = 0; Lane < m_Instances; Lane++) m_Chip[Lane]->Reset(Type);
+}
+
+bool YM2612Batch::SetOutputFormat(uint32_t SampleFormat)
+{
+	if (SampleFormat > AudioFormat::AUDIO_FMT_F32) return false;
+
+	m_OutputFormat = SampleFormat;
+
+	return true;
+}
+
+void YM2612Batch::Update(uint32_t ClockCycles, std::vector<IAudioBuffer*>& OutBuffer)
+{
+	switch (m_OutputFormat)
+	{
+	case AudioFormat::AUDIO_FMT_S32:
+		RenderSamples<int32_t>(ClockCycles, OutBuffer);
+		break;
+
+	case AudioFormat::AUDIO_FMT_F32:
+		RenderSamples<float>(ClockCycles, OutBuffer);
+		break;
+
+	default:
+		RenderSamples<int16_t>(ClockCycles, OutBuffer);
+		break;
+	}
+
+	for (uint32_t Lane = 0; Lane < m_Instances; Lane++)
+	{
+		auto& Chip = *m_Chip[Lane];
+
+		/* The instances follow the batch remainder */
+		Chip.m_CyclesToDo = m_CyclesToDo;
+
+		/* Timer overflows raise the interrupt output */
+		Chip.m_Irq.Set(Chip.m_OPN.IsIrqAsserted());
+	}
+}
+
+uint32_t YM2612Batch::GetCyclesForFrames(uint32_t Frames)
+{
+	return CyclesForFrames(Frames, 24 * 6, m_CyclesToDo);
+}
+
+template<typename T>
+void YM2612Batch::RenderSamples(uint32_t ClockCycles, std::vector<IAudioBuffer*>& OutBuffer)
+{
+	static const uint32_t SlotOrder[] =
+	{
+		0x00, 0x02, 0x01, 0x03, /* CH1: S1, S3, S2, S4 */
+		0x04, 0x06, 0x05, 0x07, /* CH2 */
+		0x08, 0x0A, 0x09, 0x0B, /* CH3 */
+		0x0C, 0x0E, 0x0D, 0x0F, /* CH4 */
+		0x10, 0x12, 0x11, 0x13, /* CH5 */
+		0x14, 0x16, 0x15, 0x17  /* CH6 */
+	};
+
+	uint32_t TotalCycles = ClockCycles + m_CyclesToDo;
+	uint32_t Samples = TotalCycles / (24 * 6);
+	m_CyclesToDo = TotalCycles % (24 * 6);
+
+	IAudioBuffer* Buffer[MaxInstances] = {};
+
+	for (uint32_t Lane = 0; Lane < m_Instances; Lane++) Buffer[Lane] = (Lane < OutBuffer.size()) ? OutBuffer[Lane] : nullptr;
+
+	/* Instances without an output only advance the chip state (fast-forward) */
+	bool Render[MaxInstances];
+
+	for (uint32_t Lane = 0; Lane < MaxInstances; Lane++) Render[Lane] = (Buffer[Lane] != nullptr);
+
+	bool Rendered = std::any_of(std::begin(Render), std::end(Render), [](bool Out) { return Out; });
+
+	AudioBlock<T, 256> Block[MaxInstances] = { Buffer[0], Buffer[1], Buffer[2], Buffer[3], Buffer[4], Buffer[5], Buffer[6], Buffer[7] };
+	std::optional<TC::DeviceStats::UpdateScope> Stats[MaxInstances];
+
+	/* Muted channels skip their operator units */
+	uint32_t Skip[MaxInstances];
+	uint32_t Silent[MaxInstances];
+	uint32_t DacValue[MaxInstances] = {};
+	uint32_t Active[MaxInstances];
+
+	for (uint32_t Lane = 0; Lane < m_Instances; Lane++)
+	{
+		auto& Chip = *m_Chip[Lane];
+
+		Stats[Lane].emplace(Chip.m_Stats, Samples);
+
+		Skip[Lane] = (uint32_t)Chip.m_VoiceMask.Skip() & 0x3F;
+		Silent[Lane] = (uint32_t)Chip.m_VoiceMask.Silent() & 0x3F;
+
+		if (Chip.m_DacStream.IsActive()) Chip.m_DacStream.Prepare(Chip.m_ClockSpeed, 24 * 6);
+	}
+
+	while (Samples-- != 0)
+	{
+		for (uint32_t Lane = 0; Lane < m_Instances; Lane++)
+		{
+			auto& Chip = *m_Chip[Lane];
+
+			/* DAC stream data, applied like a write to register 0x2A */
+			if (Chip.m_DacStream.IsActive() && Chip.m_DacStream.Tick(DacValue[Lane])) Chip.m_OPN.WriteMode(0x2A, DacValue[Lane] & 0xFF, Chip.m_Stats);
+
+			/* Update Timer A, Timer B, LFO and envelope counter */
+			Chip.m_OPN.UpdateCounters();
+
+			Active[Lane] = 0;
+		}
+
+		/* Update slots (operators), idle slots are skipped */
+		if (m_SlotGroups)
+		{
+			for (auto SlotId : SlotOrder) UpdateSlotGroup(SlotId, Render, Skip, Active);
+		}
+		else
+		{
+			for (uint32_t Lane = 0; Lane < m_Instances; Lane++) Active[Lane] = m_Chip[Lane]->m_OPN.UpdateSlots(Render[Lane], m_Chip[Lane]->m_Stats, Skip[Lane]);
+		}
+
+		if (!Rendered) continue;
+
+		for (uint32_t Lane = 0; Lane < m_Instances; Lane++)
+		{
+			auto& Chip = *m_Chip[Lane];
+
+			if (!Render[Lane]) continue;
+
+			/* Accumulate FM / DAC channels */
+			Chip.m_OPN.UpdateAccumulator(Active[Lane], nullptr, Silent[Lane]);
+
+			if (!Chip.m_VoiceMask.IsClear())
+			{
+				Chip.m_VoiceMask.Tick();
+
+				Skip[Lane] = (uint32_t)Chip.m_VoiceMask.Skip() & 0x3F;
+				Silent[Lane] = (uint32_t)Chip.m_VoiceMask.Silent() & 0x3F;
+			}
+
+			/* Limiter (signed 16-bit, F32 outputs are not limited) */
+			Block[Lane].Write(OutputSample<T>(Chip.m_OPN.OutL));
+			Block[Lane].Write(OutputSample<T>(Chip.m_OPN.OutR));
+		}
+	}
+
+	for (uint32_t Lane = 0; Lane < m_Instances; Lane++)
+	{
+		auto& OPN = m_Chip[Lane]->m_OPN;
+
+		Stats[Lane]->ActiveVoices([&] { return std::count_if(std::begin(OPN.Slot), std::end(OPN.Slot), [](auto& Slot) { return Slot.KeyState != 0; }); });
+	}
+}
+
+void YM2612Batch::UpdateSlotGroup(uint32_t SlotId, const bool* Render, const uint32_t* Skip, uint32_t* Active)
+{
+	auto& Group = m_SlotGroup;
+
+	uint32_t Count = 0;
+	uint32_t Lanes[MaxInstances];
+	uint32_t LfoStep[MaxInstances] = {};
+
+	/* Phase generator */
+	for (uint32_t Lane = 0; Lane < m_Instances; Lane++)
+	{
+		auto& OPN = m_Chip[Lane]->m_OPN;
+		auto& Slot = OPN.Slot[SlotId];
+
+		/* Note: key on writes use the prepared key code, also for idle slots */
+		OPN.PrepareSlot(SlotId);
+
+		/* Idle slots are skipped, their lanes are calculated but not stored */
+		if (YM::OPN::IsIdle(Slot)) continue;
+
+		Lanes[Count++] = Lane;
+
+		Group.FNum[Lane] = Slot.FNum;
+		Group.Block[Lane] = Slot.Block;
+		Group.KeyCode[Lane] = Slot.KeyCode;
+		Group.Detune[Lane] = Slot.Detune;
+		Group.Multi[Lane] = Slot.Multi;
+		Group.PMS[Lane] = OPN.Channel[SlotId >> 2].PMS;
+		Group.PgPhase[Lane] = Slot.PgPhase;
+		LfoStep[Lane] = OPN.LFO.Step;
+	}
+
+	if (Count == 0) return;
+
+	YM::OPN::SIMD::UpdatePhaseGenerator(Group, LfoStep);
+
+	/* Envelope generator (key events can reset the phase counter) */
+	for (uint32_t n = 0; n < Count; n++)
+	{
+		uint32_t Lane = Lanes[n];
+		auto& Chip = *m_Chip[Lane];
+		auto& Slot = Chip.m_OPN.Slot[SlotId];
+
+		Active[Lane]++;
+
+		Slot.PgPhase = Group.PgPhase[Lane];
+
+		Chip.m_OPN.UpdateEnvelopeGenerator(SlotId, Chip.m_Stats);
+
+		Group.PgPhase[Lane] = Slot.PgPhase;
+		Group.EgOutput[Lane] = Slot.EgOutput;
+	}
+
+	/* Operator unit, the lanes of fast-forwarded instances and muted channels are skipped */
+	uint32_t Used = 0;
+
+	for (uint32_t n = 0; n < Count; n++)
+	{
+		uint32_t Lane = Lanes[n];
+
+		if (Render[Lane] && !m_Chip[Lane]->m_OPN.IsSkipped(SlotId, Skip[Lane])) Lanes[Used++] = Lane;
+	}
+
+	if (Used == 0) return;
+
+	for (uint32_t n = 0; n < Used; n++) Group.Modulation[Lanes[n]] = m_Chip[Lanes[n]]->m_OPN.GetModulation(SlotId);
+
+	YM::OPN::SIMD::UpdateOperatorUnit(Group);
+
+	for (uint32_t n = 0; n < Used; n++)
+	{
+		auto& Slot = m_Chip[Lanes[n]]->m_OPN.Slot[SlotId];
+
+		/* The last 2 generated samples are stored */
+		Slot.Output[1] = Slot.Output[0];
+		Slot.Output[0] = (int16_t)Group.Output[Lanes[n]];
+	}
+}
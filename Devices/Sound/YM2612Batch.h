@@ -0,0 +1,64 @@
+/*
+ _____    _ _            ___
+|_   _| _(_) |_ ___ _ _ / __|___ _ _ ___
+  | || '_| |  _/ _ \ ' \ (__/ _ \ '_/ -_)
+  |_||_| |_|\__\___/_||_\___\___/_| \___|
+
+Copyright  2024, Michel Gerritse
+All rights reserved.
+
+This source code is available under the BSD-3-Clause license.
+See LICENSE.txt in the root directory of this source tree.
+
+*/
+#ifndef _YM2612_BATCH_H_
+#define _YM2612_BATCH_H_
+
+#include <optional>
+#include "YM2612.h"
+
+/* Yamaha YM2612 (OPN2) batch
+
+   Up to 8 independent YM2612 instances advanced in lock-step, for offline rendering of many
+   tracks at once. The slots of all instances are evaluated as slot groups with one instance per
+   lane: the same slot of every instance shares a group, so all lanes of a group are used and no
+   lane depends on another. Every lane is bit exact with an instance rendered on its own.
+
+   Each instance keeps its own registers, state and stats (see GetInstance). Register writes,
+   state access and the channel mask go to the instances directly, Update must only be called on
+   the batch. Without AVX2 support (or TC_OPN_SIMD) the instances run their scalar slot loop in
+   lock-step. Note: the envelope generator stays scalar per lane, it dominates the slot update */
+class YM2612Batch
+{
+public:
+	/* Maximum number of instances (one per slot group lane) */
+	static constexpr uint32_t MaxInstances = YM::OPN::SIMD::Lanes;
+
+	YM2612Batch(uint32_t Instances, uint32_t ClockSpeed = 8'000'000);
+	~YM2612Batch() = default;
+
+	uint32_t	GetInstances();
+	YM2612&		GetInstance(uint32_t Lane);
+
+	void		Reset(ResetType Type);
+	bool		SetOutputFormat(uint32_t SampleFormat);
+
+	/* Advance all instances, OutBuffer holds the FM output of every instance (index = lane, null = fast-forward) */
+	void		Update(uint32_t ClockCycles, std::vector<IAudioBuffer*>& OutBuffer);
+	uint32_t	GetCyclesForFrames(uint32_t Frames);
+
+private:
+	std::unique_ptr<YM2612>	m_Chip[MaxInstances];
+	uint32_t	m_Instances;
+	uint32_t	m_CyclesToDo;
+	uint32_t	m_OutputFormat;		/* Output sample format (all instances) */
+	bool		m_SlotGroups;		/* Vectorized slot group updates */
+
+	YM::OPN::SIMD::group_t	m_SlotGroup;	/* Slot group work area */
+
+	template<typename T>
+	void		RenderSamples(uint32_t ClockCycles, std::vector<IAudioBuffer*>& OutBuffer);
+	void		UpdateSlotGroup(uint32_t SlotId, const bool* Render, const uint32_t* Skip, uint32_t* Active);
+};
+
+#endif // !_YM2612_BATCH_H_
@@ -15,11 +15,12 @@ See LICENSE.txt in the root directory of this source tree.
 #define _YM3812_H_
 
 #include "../../Interfaces/ISoundDevice.h"
-#include "YM_OPL.h"
+#include "../../Interfaces/IStateAccess.h"
+#include "YM_OPL_Engine.h"
 #include "DAC/YM3014.h"
 
 /* Yamaha YM3812 (OPL2) */
-class YM3812 : public ISoundDevice
+class YM3812 : public ISoundDevice, public IStateAccess
 {
 public:
 	YM3812(uint32_t ClockSpeed = 4'000'000);
@@ -36,64 +37,36 @@ public:
 	uint32_t		GetClockSpeed();
 	uint32_t		Read(uint32_t Address);
 	void			Write(uint32_t Address, uint32_t Data);
+	bool			WriteBatch(uint32_t Port, const REGISTER_WRITE* Writes, size_t Count);
+	bool			WriteRegisters(uint32_t Port, uint32_t Register, const uint8_t* Data, size_t Count);
 	void			Update(uint32_t ClockCycles, std::vector<IAudioBuffer*>& OutBuffer);
+	uint32_t		GetCyclesForFrames(uint32_t OutputNr, uint32_t Frames);
+	uint32_t		GetCyclesToNextEvent();
+	bool			IsSilent();
+	bool			SetIrqCallback(TC::IrqCallback Callback);
+	bool			GetStats(TC::StatsSnapshot& Stats);
 
-private:
-
-	/* OPL data type */
-	struct opl2_t
-	{
-		YM::OPL::operator_t	Slot[18];
-		YM::OPL::channel_t	Channel[9];
-		YM::OPL::timer_t	Timer1;
-		YM::OPL::timer_t	Timer2;
-
-		uint32_t	Timer;			/* Global timer (13-bit) */
-		uint32_t	CSM;			/* CSM mode on/off flag */
-		uint32_t	NTS;			/* Note select flag */
-		uint32_t	RHY;			/* Rhythm mode on/off flag */
-		uint8_t		Status;			/* Status register (8-bit) */
-		int32_t		Out;			/* Accumulator output */
-
-		uint32_t	LfoAmStep;		/* Current LFO-AM step */
-		uint32_t	LfoAmShift;		/* LFO-AM depth selector */
-		uint32_t	LfoAmLevel;		/* LFO-AM attn. level */
-
-		uint32_t	LfoPmStep;		/* Current LFO-PM step */
-		uint32_t	LfoPmShift;		/* LFO-PM depth selector */
+	/* IStateAccess methods */
+	void			SaveState(StateWriter& State);
+	bool			LoadState(StateReader& State);
 
-		uint32_t	WaveSelectEnable; /* Wave select enable flag */
-
-		uint32_t	NoiseLFSR;		/* Noise shift register (23-bit) */
-		uint32_t	NoiseOut;		/* Noise output (1-bit) */
-
-		uint8_t		PhaseHH8;		/* High hat phase bit (b8) */
-		uint8_t		PhaseHH;		/* High hat phase bits (b7, b3, b2) */
-		uint8_t		PhaseTC;		/* Top cymbal phase bits (b5, b3) */
+private:
 
-		uint32_t	LsiTest2;		/* LSI test bit 2 */
-	};
+	/* OPL unit configuration */
+	using opl2_t = YM::OPL::Engine<true, false>;
 
 	static const std::wstring s_DeviceName;
 
 	uint32_t	m_ClockSpeed;
 	uint32_t	m_ClockDivider;
 	uint32_t	m_CyclesToDo;
+	TC::DeviceStats	m_Stats;
+	TC::IrqLine		m_Irq;		/* Interrupt output (not part of the state) */
 
 	uint8_t		m_AddressLatch;		/* Address latch (8-bit) */
 	opl2_t		m_OPL;				/* OPL unit */
 
 	std::unique_ptr<YM3014>	m_DAC;
-
-	void		WriteRegisterArray(uint8_t Address, uint8_t Data);
-	void		UpdateTimers();
-	void		UpdatePhaseGenerator(uint32_t SlotId);
-	void		UpdateEnvelopeGenerator(uint32_t SlotId);
-	void		UpdateOperatorUnit(uint32_t SlotId);
-	void		UpdateNoiseGenerator();
-	void		ClearOutput();
-	void		GenerateOutput(uint32_t ChannelId);
-	int16_t		GetModulation(uint32_t SlotId);
 };
 
 #endif // !_YM3812_H_
\ No newline at end of file
@@ -17,6 +17,13 @@ See LICENSE.txt in the root directory of this source tree.
 /*
 	Yamaha YMF278-B (OPL4)
 
+	FM part:
+	- OPL3 compatible, 18 channels (2 register arrays)
+	- 2 and 4-operator channels (up to 6 4-operator channels)
+	- 8 waveforms
+	- Rhythm mode (array 0)
+	- FM runs at clock / 684, it is mixed into the PCM output at clock / 768
+
 	PCM part:
 	- 24 PCM channels
 	- 8-bit, 12-bit and 16-bit linear PCM data
@@ -30,8 +37,11 @@ See LICENSE.txt in the root directory of this source tree.
 	- TL interpolation
 	- Attenuation (Envelope has a -96dB - 0dB range, TL and PAN a -48dB - 0 range but something is not adding up)
 
+	Things to validate (FM):
+	- 4-operator output selection (taken from the 1st channel)
+	- FM resampling (the FM samples of an output sample are averaged)
+
 	Things to do:
-	- Implement FM
 	- Implement pseudo-reverb
 	- Implement damping
 	- Output channel selection
@@ -52,15 +62,27 @@ static const uint32_t MixAttnTable[8] =
 	0, 0x20, 0x40, 0x60, 0x80, 0xA0, 0xC0, 0x3FF
 };
 
-YMF278B::YMF278B() :
-	m_ClockSpeed(33868800),
-	m_ClockDivider(768)
+/* Mix control attenuation to linear gain (13-bit, 0dB = 1.0) */
+static inline int32_t MixGain(uint32_t Attn)
 {
-	YM::GEW8::BuildTables();
+	/* 0dB passes the samples unchanged */
+	if (Attn == 0) return 1 << 13;
 
-	/* Set memory size to 4MB */
-	m_Memory.resize(0x400000);
+	/* Convert from 4.6 to 4.8 fixed point */
+	Attn <<= 2;
+
+	return YM::GEW8::ExpTable[Attn & 0xFF] >> (Attn >> 8);
+}
 
+YMF278B::YMF278B() :
+	m_ClockSpeed(33868800),
+	m_ClockDivider(768),
+	m_FmClockDivider(684),
+	m_VoiceGroups(YM::GEW8::SIMD::IsSupported()),
+	m_VoiceGroup(),
+	m_Memory(0x400000), /* 4MB address space */
+	m_MemoryMask(0x3FFFFF)
+{
 	Reset(ResetType::PowerOnDefaults);
 }
 
@@ -72,9 +94,13 @@ const wchar_t* YMF278B::GetDeviceName()
 void YMF278B::Reset(ResetType Type)
 {
 	m_CyclesToDo = 0;
+	m_FmCycles = 0;
 
 	m_AddressLatch = 0;
 
+	/* Reset FM unit */
+	m_FM.Reset();
+
 	/* Reset utility registers */
 	m_MemoryAddress.u32 = 0;
 	m_MemoryAccess = 0;
@@ -93,6 +119,7 @@ void YMF278B::Reset(ResetType Type)
 
 	/* Reset counters */
 	m_EnvelopeCounter = 0;
+	m_EnvelopeRates = YM::GetEgRates(YM::GEW8::EgSchedule, m_EnvelopeCounter);
 	m_InterpolCounter = 0;
 
 	/* Clear channel registers  */
@@ -106,12 +133,15 @@ void YMF278B::Reset(ResetType Type)
 
 		/* Default LFO period */
 		Channel.LfoPeriod = YM::GEW8::LfoPeriod[0];
+
+		SelectAddressGenerator(Channel);
 	}
 
 	if (Type == ResetType::PowerOnDefaults)
 	{
 		/* Clear PCM memory */
-		memset(m_Memory.data(), 0, m_Memory.size());
+		m_Memory.Clear();
+		m_MemoryPages.Clear();
 	}
 }
 
@@ -121,27 +151,12 @@ void YMF278B::SendExclusiveCommand(uint32_t Command, uint32_t Value)
 
 bool YMF278B::EnumAudioOutputs(uint32_t OutputNr, AUDIO_OUTPUT_DESC& Desc)
 {
+	/* FM and PCM are mixed in a single pass, the mix (DO2) is the only output */
 	switch (OutputNr)
 	{
 	case 0:
 		Desc.SampleRate = m_ClockSpeed / m_ClockDivider;
-		Desc.SampleFormat = 0;
-		Desc.Channels = 2;
-		Desc.ChannelMask = SPEAKER_FRONT_LEFT | SPEAKER_FRONT_RIGHT;
-		Desc.Description = L"FM (DO0)";
-		return true;
-		
-	case 1:
-		Desc.SampleRate = m_ClockSpeed / m_ClockDivider;
-		Desc.SampleFormat = 0;
-		Desc.Channels = 2;
-		Desc.ChannelMask = SPEAKER_FRONT_LEFT | SPEAKER_FRONT_RIGHT;
-		Desc.Description = L"PCM (DO1)";
-		return true;
-
-	case 2:
-		Desc.SampleRate = m_ClockSpeed / m_ClockDivider;
-		Desc.SampleFormat = 0;
+		Desc.SampleFormat = AudioFormat::AUDIO_FMT_S16;
 		Desc.Channels = 2;
 		Desc.ChannelMask = SPEAKER_FRONT_LEFT | SPEAKER_FRONT_RIGHT;
 		Desc.Description = L"MIX (DO2)";
@@ -162,6 +177,11 @@ uint32_t YMF278B::GetClockSpeed()
 	return m_ClockSpeed;
 }
 
+bool YMF278B::GetStats(TC::StatsSnapshot& Stats)
+{
+	return m_Stats.Get(Stats);
+}
+
 void YMF278B::Write(uint32_t Address, uint32_t Data)
 {
 	/* 8-bit data bus (D0 - D7) */
@@ -177,14 +197,17 @@ void YMF278B::Write(uint32_t Address, uint32_t Data)
 		break;
 
 	case 0x01: /* FM array 0 data write mode */
+		m_Stats.RegisterWrite(m_AddressLatch);
 		WriteFM0(m_AddressLatch, Data);
 		break;
 
 	case 0x03: /* FM array 1 data write mode */
+		m_Stats.RegisterWrite(0x100 | m_AddressLatch);
 		WriteFM1(m_AddressLatch, Data);
 		break;
 
 	case 0x05: /* PCM data write mode */
+		m_Stats.RegisterWrite(0x200 | m_AddressLatch);
 		if (m_New2) WritePCM(m_AddressLatch, Data);
 		break;
 
@@ -193,9 +216,37 @@ void YMF278B::Write(uint32_t Address, uint32_t Data)
 	}
 }
 
-void YMF278B::WriteFM0(uint8_t Register, uint8_t Data)
+bool YMF278B::WriteBatch(uint32_t Port, const REGISTER_WRITE* Writes, size_t Count)
 {
+	/* Port 0 = FM array 0, 1 = FM array 1, 2 = PCM */
+	if (Port > 2) return false;
+	if (Count == 0) return true;
 
+	for (size_t i = 0; i < Count; i++)
+	{
+		uint8_t Register = Writes[i].Register & 0xFF;
+		uint8_t Data = Writes[i].Data & 0xFF;
+
+		m_Stats.RegisterWrite((Port << 8) | Register);
+
+		switch (Port)
+		{
+		case 0: WriteFM0(Register, Data); break;
+		case 1: WriteFM1(Register, Data); break;
+		case 2: if (m_New2) WritePCM(Register, Data); break;
+		}
+	}
+
+	/* The address latch holds the last register written */
+	m_AddressLatch = Writes[Count - 1].Register & 0xFF;
+
+	return true;
+}
+
+void YMF278B::WriteFM0(uint8_t Register, uint8_t Data)
+{
+	/* Mode registers and channels 1 - 9 */
+	m_FM.Write(Register, Data, 0);
 }
 
 void YMF278B::WriteFM1(uint8_t Register, uint8_t Data)
@@ -211,18 +262,20 @@ void YMF278B::WriteFM1(uint8_t Register, uint8_t Data)
 		break;
 
 	case 0x04: /* 4-Operator mode setting */
-		//TODO
+		m_FM.SetConnection(Data);
 		break;
 
 	case 0x05: /* Expansion register */
 		/* OPL3 mode enable flag */
 		m_New = Data & 0x01;
+		m_FM.SetNew(m_New);
 
 		/* OPL4 mode enable flag */
 		if (m_New) m_New2 = (Data >> 1) & 0x01;
 		break;
 
-	default:
+	default: /* Channels 10 - 18 */
+		m_FM.Write(Register, Data, 1);
 		break;
 	}
 }
@@ -260,7 +313,13 @@ void YMF278B::WritePCM(uint8_t Register, uint8_t Data)
 	case 0x06: /* Memory data */
 		if (m_MemoryAccess)
 		{
-			m_Memory[m_MemoryAddress.u32] = Data;
+			uint32_t Address = m_MemoryAddress.u32 & m_MemoryMask;
+
+			/* Grow the memory a page at a time, the page has to be resident for the tracker */
+			m_Memory.Reserve((Address | (PageTracker::PageSize - 1)) + 1);
+
+			m_MemoryPages.Touch(m_Memory.Data(), m_Memory.Size(), Address);
+			m_Memory.Write(Address, Data);
 			m_MemoryAddress.u32 = (m_MemoryAddress.u32 + 1) & 0x3FFFFF;
 		}
 		break;
@@ -390,45 +449,81 @@ void YMF278B::LoadWaveTable(CHANNEL& Channel)
 	}
 	
 	/* Byte 0: Wave format + start address [21:16] */
-	Channel.Format = m_Memory[Offset] >> 6;
-	Channel.Start.u8hl = m_Memory[Offset] & 0x3F;
+	Channel.Format = m_Memory.Read(Offset & m_MemoryMask) >> 6;
+	Channel.Start.u8hl = m_Memory.Read(Offset & m_MemoryMask) & 0x3F;
 
 	/* Byte 1: Start address [15:8] */
-	Channel.Start.u8lh = m_Memory[Offset + 1];
+	Channel.Start.u8lh = m_Memory.Read((Offset + 1) & m_MemoryMask);
 
 	/* Byte 2: Start address [7:0] */
-	Channel.Start.u8ll = m_Memory[Offset + 2];
+	Channel.Start.u8ll = m_Memory.Read((Offset + 2) & m_MemoryMask);
 
 	/* Byte 3: Loop address [15:8] */
-	Channel.Loop.u8h = m_Memory[Offset + 3];
+	Channel.Loop.u8h = m_Memory.Read((Offset + 3) & m_MemoryMask);
 
 	/* Byte 4: Loop address [7:0] */
-	Channel.Loop.u8l = m_Memory[Offset + 4];
+	Channel.Loop.u8l = m_Memory.Read((Offset + 4) & m_MemoryMask);
 
 	/* Byte 5 + 6: End address [15:0] */
-	Channel.End = 0x10000 - ((m_Memory[Offset + 5] << 8) | m_Memory[Offset + 6]);
+	Channel.End = 0x10000 - ((m_Memory.Read((Offset + 5) & m_MemoryMask) << 8) | m_Memory.Read((Offset + 6) & m_MemoryMask));
 
 	/* Byte 7: LFO + VIB */
-	Channel.LfoPeriod = YM::GEW8::LfoPeriod[(m_Memory[Offset + 7] >> 3) & 0x07];
-	Channel.PmDepth = m_Memory[Offset + 7] & 0x07;
+	Channel.LfoPeriod = YM::GEW8::LfoPeriod[(m_Memory.Read((Offset + 7) & m_MemoryMask) >> 3) & 0x07];
+	Channel.PmDepth = m_Memory.Read((Offset + 7) & m_MemoryMask) & 0x07;
 
 	/* Byte 8: Attack rate + decay rate  */
-	Channel.Rate[ADSR::Attack] = m_Memory[Offset + 8] >> 4;
-	Channel.Rate[ADSR::Decay] = m_Memory[Offset + 8] & 0x0F;
+	Channel.Rate[ADSR::Attack] = m_Memory.Read((Offset + 8) & m_MemoryMask) >> 4;
+	Channel.Rate[ADSR::Decay] = m_Memory.Read((Offset + 8) & m_MemoryMask) & 0x0F;
 
 	/* Byte 9: Decay level + sustain rate */
-	Channel.Rate[ADSR::Sustain] = m_Memory[Offset + 9] & 0x0F;
+	Channel.Rate[ADSR::Sustain] = m_Memory.Read((Offset + 9) & m_MemoryMask) & 0x0F;
 
 	/* If all DL bits are set, DL is -93dB. See OPL4 manual page 20 */
-	Channel.DL = (m_Memory[Offset + 9] & 0xF0) << 1;
+	Channel.DL = (m_Memory.Read((Offset + 9) & m_MemoryMask) & 0xF0) << 1;
 	if (Channel.DL == 0x1E0) Channel.DL = 0x3E0;
 
 	/* Byte 10: Rate correction + release rate */
-	Channel.RC = m_Memory[Offset + 10] >> 4;
-	Channel.Rate[ADSR::Release] = m_Memory[Offset + 10] & 0x0F;
+	Channel.RC = m_Memory.Read((Offset + 10) & m_MemoryMask) >> 4;
+	Channel.Rate[ADSR::Release] = m_Memory.Read((Offset + 10) & m_MemoryMask) & 0x0F;
 
 	/* Byte 11: AM */
-	Channel.AmDepth = m_Memory[Offset + 11] & 0x07;
+	Channel.AmDepth = m_Memory.Read((Offset + 11) & m_MemoryMask) & 0x07;
+
+	SelectAddressGenerator(Channel);
+}
+
+void YMF278B::SelectAddressGenerator(CHANNEL& Channel)
+{
+	auto& Generator = m_AddressGenerator[&Channel - m_Channel];
+
+	/* Reads only have to wrap around the fitted memory when the wave can reach past the end of the memory */
+	switch (Channel.Format)
+	{
+	case 0: /* 8-bit PCM */
+		if ((Channel.Start.u32 + YM::GEW8::WaveSpan<8>) <= m_Memory.Size())
+			Generator = &YMF278B::UpdateAddressGenerator<8, false>;
+		else
+			Generator = &YMF278B::UpdateAddressGenerator<8, true>;
+		break;
+
+	case 1: /* 12-bit PCM */
+		if ((Channel.Start.u32 + YM::GEW8::WaveSpan<12>) <= m_Memory.Size())
+			Generator = &YMF278B::UpdateAddressGenerator<12, false>;
+		else
+			Generator = &YMF278B::UpdateAddressGenerator<12, true>;
+		break;
+
+	case 2: /* 16-bit PCM */
+		if ((Channel.Start.u32 + YM::GEW8::WaveSpan<16>) <= m_Memory.Size())
+			Generator = &YMF278B::UpdateAddressGenerator<16, false>;
+		else
+			Generator = &YMF278B::UpdateAddressGenerator<16, true>;
+		break;
+
+	default: /* Invalid format */
+		Generator = &YMF278B::UpdateAddressGenerator<0, false>;
+		break;
+	}
 }
 
 void YMF278B::Update(uint32_t ClockCycles, std::vector<IAudioBuffer*>& OutBuffer)
@@ -437,78 +532,154 @@ void YMF278B::Update(uint32_t ClockCycles, std::vector<IAudioBuffer*>& OutBuffer
 	uint32_t Samples = TotalCycles / m_ClockDivider;
 	m_CyclesToDo = TotalCycles % m_ClockDivider;
 
+	AudioBlock<int16_t> Block(OutBuffer[0]);
+
+	RenderFrames(Samples, Block);
+}
+
+bool YMF278B::RenderBlock(uint32_t OutputNr, uint32_t Frames, std::vector<IAudioBuffer*>& OutBuffer, const TIMED_REGISTER_WRITE* Writes, size_t Count)
+{
+	/* The output buffer is set up once for the whole block */
+	AudioBlock<int16_t> Block(OutBuffer[0]);
+
+	uint32_t Frame = 0;
+
+	for (size_t i = 0; i < Count; i++)
+	{
+		uint32_t Next = std::clamp(Writes[i].Frame, Frame, Frames);
+
+		if (Next != Frame) RenderFrames(Next - Frame, Block);
+		Frame = Next;
+
+		REGISTER_WRITE Write = { Writes[i].Register, Writes[i].Data };
+		WriteBatch(Writes[i].Port, &Write, 1);
+	}
+
+	if (Frame != Frames) RenderFrames(Frames - Frame, Block);
+
+	/* Exactly Frames frames were rendered, as by Render */
+	m_CyclesToDo = 0;
+
+	return true;
+}
+
+void YMF278B::RenderFrames(uint32_t Samples, AudioBlock<int16_t>& Block)
+{
+	TC::DeviceStats::UpdateScope Stats(m_Stats, Samples);
+
+	/* Mix control is applied inline, it only changes between blocks */
+	const int32_t GainFML = MixGain(m_MixCtrlFML);
+	const int32_t GainFMR = MixGain(m_MixCtrlFMR);
+	const int32_t GainPCML = MixGain(m_MixCtrlPCML);
+	const int32_t GainPCMR = MixGain(m_MixCtrlPCMR);
+
 	int32_t OutL;
 	int32_t OutR;
 
 	while (Samples != 0)
 	{
+		/* FM unit, it runs at its own sample rate */
+		int32_t FmL = 0;
+		int32_t FmR = 0;
+		int32_t FmSamples = 0;
+
+		for (m_FmCycles += m_ClockDivider; m_FmCycles >= m_FmClockDivider; m_FmCycles -= m_FmClockDivider)
+		{
+			m_FM.UpdateTimers();
+			m_FM.UpdateSlots(true, m_Stats);
+			m_FM.UpdateAccumulator();
+
+			/* Limiter (signed 16-bit) */
+			FmL += std::clamp(m_FM.OutL, -32768, 32767);
+			FmR += std::clamp(m_FM.OutR, -32768, 32767);
+			FmSamples++;
+		}
+
+		/* Average the FM samples of this output sample */
+		if (FmSamples > 1)
+		{
+			FmL /= FmSamples;
+			FmR /= FmSamples;
+		}
+
+		/* PCM unit */
 		OutL = 0;
 		OutR = 0;
 
-		for (auto& Channel : m_Channel)
+		if (m_VoiceGroups)
 		{
-			UpdateLFO(Channel);
-			UpdateAddressGenerator(Channel);
-			UpdateInterpolator(Channel);
-			UpdateEnvelopeGenerator(Channel);
-			UpdateMultiplier(Channel);
-
-			OutL += Channel.OutputL;
-			OutR += Channel.OutputR;
+			YM::GEW8::SIMD::mix_t Mix;
+
+			UpdateVoiceGroups(Mix);
+
+			OutL = Mix.OutputL;
+			OutR = Mix.OutputR;
+		}
+		else
+		{
+			for (uint32_t i = 0; i < 24; i++)
+			{
+				auto& Channel = m_Channel[i];
+
+				UpdateLFO(Channel);
+				(this->*m_AddressGenerator[i])(Channel);
+				UpdateInterpolator(Channel);
+				UpdateEnvelopeGenerator(Channel);
+				UpdateMultiplier(Channel);
+
+				OutL += Channel.OutputL;
+				OutR += Channel.OutputR;
+			}
 		}
 
 		/* Global counter increments */
 		m_EnvelopeCounter++;
+		m_EnvelopeRates = YM::GetEgRates(YM::GEW8::EgSchedule, m_EnvelopeCounter);
 		m_InterpolCounter++;
 
 		/* Limiter (signed 16-bit) */
 		OutL = std::clamp(OutL, -32768, 32767);
 		OutR = std::clamp(OutR, -32768, 32767);
 
+		/* Mix control (FM + PCM) */
+		OutL = ((FmL * GainFML) + (OutL * GainPCML)) >> 13;
+		OutR = ((FmR * GainFMR) + (OutR * GainPCMR)) >> 13;
+
+		/* Limiter (signed 16-bit) */
+		OutL = std::clamp(OutL, -32768, 32767);
+		OutR = std::clamp(OutR, -32768, 32767);
+
 		/* 16-bit DAC output (interleaved) */
-		OutBuffer[0]->WriteSampleS16(OutL);
-		OutBuffer[0]->WriteSampleS16(OutR);
+		Block.Write(OutL);
+		Block.Write(OutR);
 
 		Samples--;
 	}
+
+	Stats.ActiveVoices([&]
+	{
+		return std::count_if(std::begin(m_Channel), std::end(m_Channel), [](auto& Channel) { return Channel.KeyOn != 0; }) +
+			   std::count_if(std::begin(m_FM.Slot), std::end(m_FM.Slot), [](auto& Slot) { return Slot.KeyState != 0; });
+	});
 }
 
-int16_t YMF278B::ReadSample(CHANNEL& Channel)
+bool YMF278B::IsSilent()
 {
-	uint32_t Offset;
-	int16_t Sample = 0;
+	if (!m_FM.IsIdle()) return false;
 
-	switch (Channel.Format)
+	for (auto& Channel : m_Channel)
 	{
-	case 0: /* 8-bit PCM */
-		Offset = Channel.Start.u32 + Channel.SampleCount;
-		Sample = m_Memory[Offset] << 8;
-		break;
-
-	case 1: /* 12-bit PCM */
-		Offset = Channel.Start.u32 + ((Channel.SampleCount * 3) / 2);
-
-		if (Channel.SampleCount & 0x01)
-		{
-			Sample = (m_Memory[Offset + 2] << 8) | ((m_Memory[Offset + 1] & 0x0F) << 4);
-		}
-		else
-		{
-			Sample = (m_Memory[Offset + 0] << 8) | (m_Memory[Offset + 1] & 0xF0);
-		}
-		break;
-
-	case 2: /* 16-bit PCM */
-		Offset = Channel.Start.u32 + (Channel.SampleCount * 2);
-
-		Sample = (m_Memory[Offset + 0] << 8) | m_Memory[Offset + 1];
-		break;
-
-	case 3: /* Invalid format */
-		break;
+		if ((Channel.KeyOn | Channel.KeyPending) != 0) return false;
+		if ((Channel.EgLevel < YM::GEW8::MaxAttenuation) || ((Channel.OutputL | Channel.OutputR) != 0)) return false;
 	}
 
-	return Sample;
+	return true;
+}
+
+uint32_t YMF278B::GetCyclesForFrames(uint32_t OutputNr, uint32_t Frames)
+{
+	/* All outputs run at the same rate */
+	return CyclesForFrames(Frames, m_ClockDivider, m_CyclesToDo);
 }
 
 void YMF278B::UpdateLFO(CHANNEL& Channel)
@@ -531,10 +702,11 @@ void YMF278B::UpdateLFO(CHANNEL& Channel)
 	}
 }
 
+template<uint32_t Bits, bool Wrap>
 void YMF278B::UpdateAddressGenerator(CHANNEL& Channel)
 {
 	/* Vibrato lookup */
-	int32_t Vibrato = YM::GEW8::VibratoTable[Channel.LfoStep >> 2][Channel.PmDepth]; /* 64 steps */
+	int32_t Vibrato = YM::GEW8::GetVibrato(Channel.LfoStep >> 2, Channel.PmDepth); /* 64 steps */
 
 	/* Calculate address increment */
 	uint32_t Inc = ((1024 + Channel.FNum + Vibrato) << (8 + Channel.Octave)) >> 3;
@@ -558,7 +730,19 @@ void YMF278B::UpdateAddressGenerator(CHANNEL& Channel)
 
 		/* Load new sample */
 		Channel.SampleT0 = Channel.SampleT1;
-		Channel.SampleT1 = ReadSample(Channel);
+
+		if constexpr (Wrap)
+		{
+			const uint32_t Mask = m_MemoryMask;
+
+			Channel.SampleT1 = YM::GEW8::FetchSample<Bits>(Channel.Start.u32, Channel.SampleCount, [&](uint32_t Offset) { return m_Memory.Read(Offset & Mask); });
+		}
+		else
+		{
+			const uint8_t* Memory = m_Memory.Data();
+
+			Channel.SampleT1 = YM::GEW8::FetchSample<Bits>(Channel.Start.u32, Channel.SampleCount, [=](uint32_t Offset) { return Memory[Offset]; });
+		}
 	}
 }
 
@@ -572,14 +756,10 @@ void YMF278B::UpdateEnvelopeGenerator(CHANNEL& Channel)
 	/* Get adjusted / key scaled rate */
 	uint32_t Rate = CalculateRate(Channel, Channel.Rate[Channel.EgPhase]);
 
-	/* Get EG counter resolution */
-	uint32_t Shift = YM::GEW8::EgShift[Rate];
-	uint32_t Mask = (1 << Shift) - 1;
-
-	if ((m_EnvelopeCounter & Mask) == 0) /* Counter overflowed */
+	if ((m_EnvelopeRates >> Rate) & 1) /* Counter overflowed */
 	{
 		/* Get update cycle (8 cycles in total) */
-		uint32_t Cycle = (m_EnvelopeCounter >> Shift) & 0x07;
+		uint32_t Cycle = (m_EnvelopeCounter >> YM::GEW8::EgShift[Rate]) & 0x07;
 
 		/* Lookup attenuation adjustment */
 		uint32_t AttnInc = YM::GEW8::EgLevelAdjust[Rate][Cycle];
@@ -627,6 +807,22 @@ void YMF278B::UpdateEnvelopeGenerator(CHANNEL& Channel)
 }
 
 void YMF278B::UpdateMultiplier(CHANNEL& Channel)
+{
+	uint32_t AttnL;
+	uint32_t AttnR;
+
+	UpdateAttenuation(Channel, AttnL, AttnR);
+
+	/* dB to linear conversion (13-bit) */
+	uint32_t VolumeL = YM::GEW8::ExpTable[AttnL & 0xFF] >> (AttnL >> 8);
+	uint32_t VolumeR = YM::GEW8::ExpTable[AttnR & 0xFF] >> (AttnR >> 8);
+
+	/* Multiply with interpolated sample */
+	Channel.OutputL = (Channel.Sample * VolumeL) >> 15;
+	Channel.OutputR = (Channel.Sample * VolumeR) >> 15;
+}
+
+void YMF278B::UpdateAttenuation(CHANNEL& Channel, uint32_t& AttnL, uint32_t& AttnR)
 {
 	/* Level interpolation
 
@@ -652,17 +848,15 @@ void YMF278B::UpdateMultiplier(CHANNEL& Channel)
 	/* Get envelope generator output (10-bit = 4.6 fixed point) */
 	uint32_t Attenuation = Channel.EgLevel;
 
-	int16_t Sample = Channel.Sample;
-
 	/* Apply AM LFO (tremolo) */
-	Attenuation += YM::GEW8::TremoloTable[Channel.LfoStep][Channel.AmDepth];
+	Attenuation += YM::GEW8::GetTremolo(Channel.LfoStep, Channel.AmDepth);
 
 	/* Apply total level */
 	Attenuation += Channel.TL << 2;
 
 	/* Apply pan */
-	uint32_t AttnL = Attenuation + Channel.PanAttnL;
-	uint32_t AttnR = Attenuation + Channel.PanAttnR;
+	AttnL = Attenuation + Channel.PanAttnL;
+	AttnR = Attenuation + Channel.PanAttnR;
 
 	/* Limit */
 	if (AttnL > 0x3FF) AttnL = 0x3FF;
@@ -671,14 +865,40 @@ void YMF278B::UpdateMultiplier(CHANNEL& Channel)
 	/* Convert from 4.6 to 4.8 fixed point */
 	AttnL <<= 2;
 	AttnR <<= 2;
+}
 
-	/* dB to linear conversion (13-bit) */
-	uint32_t VolumeL = YM::GEW8::ExpTable[AttnL & 0xFF] >> (AttnL >> 8);
-	uint32_t VolumeR = YM::GEW8::ExpTable[AttnR & 0xFF] >> (AttnR >> 8);
+void YMF278B::UpdateVoiceGroups(YM::GEW8::SIMD::mix_t& Mix)
+{
+	for (uint32_t i = 0; i < 24; i++)
+	{
+		auto& Channel = m_Channel[i];
+		auto& Group = m_VoiceGroup[i / YM::GEW8::SIMD::Lanes];
+		uint32_t Lane = i % YM::GEW8::SIMD::Lanes;
 
-	/* Multiply with interpolated sample */
-	Channel.OutputL = (Sample * VolumeL) >> 15;
-	Channel.OutputR = (Sample * VolumeR) >> 15;
+		UpdateLFO(Channel);
+		(this->*m_AddressGenerator[i])(Channel);
+
+		/* Interpolate before key on events reset the address counter */
+		Group.SampleT0[Lane] = Channel.SampleT0;
+		Group.SampleT1[Lane] = Channel.SampleT1;
+		Group.Fraction[Lane] = Channel.SampleDelta;
+
+		UpdateEnvelopeGenerator(Channel);
+		UpdateAttenuation(Channel, Group.AttnL[Lane], Group.AttnR[Lane]);
+	}
+
+	YM::GEW8::SIMD::UpdateMultiplier(m_VoiceGroup, 3, 15, Mix);
+
+	for (uint32_t i = 0; i < 24; i++)
+	{
+		auto& Channel = m_Channel[i];
+		auto& Group = m_VoiceGroup[i / YM::GEW8::SIMD::Lanes];
+		uint32_t Lane = i % YM::GEW8::SIMD::Lanes;
+
+		Channel.Sample = (int16_t)Group.Sample[Lane];
+		Channel.OutputL = (int16_t)Group.OutputL[Lane];
+		Channel.OutputR = (int16_t)Group.OutputR[Lane];
+	}
 }
 
 void YMF278B::UpdateInterpolator(CHANNEL& Channel)
@@ -694,6 +914,8 @@ void YMF278B::ProcessKeyOnOff(CHANNEL& Channel)
 {
 	if (Channel.KeyPending) /* Key On */
 	{
+		m_Stats.KeyOn();
+
 		/* Reset sample counter */
 		Channel.SampleCount = 0;
 		Channel.SampleDelta = 0;
@@ -753,13 +975,132 @@ uint8_t YMF278B::CalculateRate(CHANNEL& Channel, uint8_t Rate)
 
 void YMF278B::CopyToMemory(uint32_t MemoryID, size_t Offset, uint8_t* Data, size_t Size)
 {
-	if ((Offset + Size) > m_Memory.size()) return;
+	if (!m_Memory.Upload(Offset, Data, Size)) return;
+
+	m_MemoryPages.Upload(m_Memory.Data(), Offset, Size);
 
-	memcpy(m_Memory.data() + Offset, Data, Size);
+	for (auto& Channel : m_Channel) SelectAddressGenerator(Channel);
 }
 
 void YMF278B::CopyToMemoryIndirect(uint32_t MemoryID, size_t Offset, uint8_t* Data, size_t Size)
 {
 	/* No specialized implementation needed */
 	CopyToMemory(MemoryID, Offset, Data, Size);
+}
+
+bool YMF278B::AttachMemory(uint32_t MemoryID, const uint8_t* Data, size_t Size)
+{
+	/* The attached data is the new baseline, SRAM writes copy it first */
+	m_Memory.Attach(Data, Size);
+	m_MemoryPages.Clear();
+
+	for (auto& Channel : m_Channel) SelectAddressGenerator(Channel);
+
+	return true;
+}
+
+size_t YMF278B::GetMemorySize(uint32_t MemoryID)
+{
+	return m_Memory.MaxSize();
+}
+
+bool YMF278B::SetMemorySize(uint32_t MemoryID, size_t Size)
+{
+	/* 22-bit address bus */
+	if (!TC::IsPowerOfTwo(Size) || (Size > 0x400000)) return false;
+
+	/* Unused address lines mirror the fitted memory, the remaining memory is the new baseline */
+	m_Memory.SetMaxSize(Size);
+	m_MemoryMask = (uint32_t)(Size - 1);
+	m_MemoryPages.Clear();
+
+	for (auto& Channel : m_Channel) SelectAddressGenerator(Channel);
+
+	return true;
+}
+
+bool YMF278B::RevertMemory()
+{
+	m_MemoryPages.Revert([&](size_t Size) { return (Size <= m_Memory.MaxSize()) ? m_Memory.Reserve(Size) : nullptr; });
+
+	for (auto& Channel : m_Channel) SelectAddressGenerator(Channel);
+
+	return true;
+}
+
+size_t YMF278B::GetResidentSize()
+{
+	return m_Memory.GetResidentSize() + m_MemoryPages.GetResidentSize();
+}
+
+void YMF278B::SaveState(StateWriter& State)
+{
+	State.BeginChunk("F278", 3);
+
+	State.Write(m_Channel);
+	State.Write(m_FM);
+
+	/* Wave table pointers are not portable between processes, store the selection instead */
+	for (auto& Slot : m_FM.Slot) State.Write((uint8_t)((Slot.WaveTable - &YM::OPL::WaveTable[0][0]) >> 10));
+
+	State.Write(m_AddressLatch);
+	State.Write(m_New);
+	State.Write(m_New2);
+	State.Write(m_MemoryAddress);
+	State.Write(m_MemoryAccess);
+	State.Write(m_MemoryType);
+	State.Write(m_WaveTableHeader);
+	State.Write(m_MixCtrlFML);
+	State.Write(m_MixCtrlFMR);
+	State.Write(m_MixCtrlPCML);
+	State.Write(m_MixCtrlPCMR);
+	State.Write(m_EnvelopeCounter);
+	State.Write(m_InterpolCounter);
+	State.Write(m_FmCycles);
+	State.Write(m_CyclesToDo);
+
+	/* Only the pages written by the device itself */
+	m_MemoryPages.Save(State, m_Memory.Data());
+
+	State.EndChunk();
+}
+
+bool YMF278B::LoadState(StateReader& State)
+{
+	if (!State.BeginChunk("F278", 3)) return false;
+
+	State.Read(m_Channel);
+	State.Read(m_FM);
+
+	for (auto& Slot : m_FM.Slot)
+	{
+		uint8_t Wave = 0;
+		State.Read(Wave);
+
+		Slot.WaveTable = &YM::OPL::WaveTable[Wave & 0x07][0];
+	}
+
+	State.Read(m_AddressLatch);
+	State.Read(m_New);
+	State.Read(m_New2);
+	State.Read(m_MemoryAddress);
+	State.Read(m_MemoryAccess);
+	State.Read(m_MemoryType);
+	State.Read(m_WaveTableHeader);
+	State.Read(m_MixCtrlFML);
+	State.Read(m_MixCtrlFMR);
+	State.Read(m_MixCtrlPCML);
+	State.Read(m_MixCtrlPCMR);
+	State.Read(m_EnvelopeCounter);
+	State.Read(m_InterpolCounter);
+	State.Read(m_FmCycles);
+
+	m_EnvelopeRates = YM::GetEgRates(YM::GEW8::EgSchedule, m_EnvelopeCounter);
+	State.Read(m_CyclesToDo);
+
+	if (!m_MemoryPages.Load(State, [&](size_t Size) { return (Size <= m_Memory.MaxSize()) ? m_Memory.Reserve(Size) : nullptr; })) return false;
+
+	for (auto& Channel : m_Channel) SelectAddressGenerator(Channel);
+
+	return State.EndChunk();
 }
\ No newline at end of file
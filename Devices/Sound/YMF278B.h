@@ -16,9 +16,12 @@ See LICENSE.txt in the root directory of this source tree.
 
 #include "../../Interfaces/ISoundDevice.h"
 #include "../../Interfaces/IMemoryAccess.h"
+#include "../../Interfaces/IStateAccess.h"
+#include "YM_GEW_SIMD.h"
+#include "YM_OPL_Engine.h"
 
 /* Yamaha YMF278B (FM + Wave Table Synthesizer) */
-class YMF278B : public ISoundDevice, public IMemoryAccess
+class YMF278B : public ISoundDevice, public IMemoryAccess, public IStateAccess
 {
 public:
 	YMF278B();
@@ -34,11 +37,25 @@ public:
 	void			SetClockSpeed(uint32_t ClockSpeed);
 	uint32_t		GetClockSpeed();
 	void			Write(uint32_t Address, uint32_t Data);
+	bool			WriteBatch(uint32_t Port, const REGISTER_WRITE* Writes, size_t Count);
 	void			Update(uint32_t ClockCycles, std::vector<IAudioBuffer*>& OutBuffer);
+	bool			IsSilent();
+	uint32_t		GetCyclesForFrames(uint32_t OutputNr, uint32_t Frames);
+	bool			RenderBlock(uint32_t OutputNr, uint32_t Frames, std::vector<IAudioBuffer*>& OutBuffer, const TIMED_REGISTER_WRITE* Writes, size_t Count);
+	bool			GetStats(TC::StatsSnapshot& Stats);
 
 	/* IMemoryAccess methods */
 	void			CopyToMemory(uint32_t MemoryID, size_t Offset, uint8_t* Data, size_t Size);
 	void			CopyToMemoryIndirect(uint32_t MemoryID, size_t Offset, uint8_t* Data, size_t Size);
+	bool			AttachMemory(uint32_t MemoryID, const uint8_t* Data, size_t Size);
+	size_t			GetMemorySize(uint32_t MemoryID);
+	bool			SetMemorySize(uint32_t MemoryID, size_t Size);
+	bool			RevertMemory();
+	size_t			GetResidentSize();
+
+	/* IStateAccess methods */
+	void			SaveState(StateWriter& State);
+	bool			LoadState(StateReader& State);
 
 private:
 
@@ -51,48 +68,55 @@ private:
 		Release
 	};
 
+	/* Channel state, the per-sample fields first. Fields are packed to their width */
 	struct CHANNEL
 	{
-		pair16_t	WaveNr;		/* Wave table number (9-bit) */
-		uint32_t	FNum;		/* Frequency number (10-bit) */
-		uint32_t	FNum9;		/* Copy of FNum bit 9 */
-		int32_t		Octave;		/* Octave (signed 4-bit) */
-		uint32_t	PanAttnL;	/* Pan attenuation left */
-		uint32_t	PanAttnR;	/* Pan attenuation right */
-		uint32_t	TL;			/* Total Level (7-bit) */
-		uint32_t	TargetTL;	/* Interpolated TL */
-
-		uint32_t	KeyOn;		/* Key On / Off flag */
-		uint32_t	KeyPending;	/* Key On / Off pending state */
-		uint32_t	EgPhase;	/* Envelope phase */
-		uint32_t	EgLevel;	/* Envelope output level (10-bit) */
-
-		uint32_t	SampleCount;	/* Sample address (whole part) */
+		/* Address generator + interpolator */
 		uint32_t	SampleDelta;	/* Sample address (fractional) */
-
-		uint32_t	Format;		/* Wave format (2-bit) */
-		pair32_t	Start;		/* Start address (22-bit) */
-		pair16_t	Loop;		/* Loop address (16-bit) */
-		uint32_t	End;		/* End address (16-bit) */
-		uint8_t		Rate[4];	/* ADSR rates (4-bit) */
-		uint32_t	DL;			/* Decay level (4-bit) */
-		uint32_t	RC;			/* Rate correction (4-bit) */
-
-		uint32_t	LfoCounter;	/* LFO counter */
-		uint32_t	LfoPeriod;	/* LFO period */
-		uint8_t		LfoStep;	/* LFO step counter (8-bit) */
-		uint32_t	LfoReset;	/* LFO reset flag */
-		uint32_t	PmDepth;	/* Vibrato depth (3-bit) */
-		uint32_t	AmDepth;	/* Tremolo depth (3-bit) */
-
-		int16_t		SampleT0;	/* Sample interpolation T0 */
-		int16_t		SampleT1;	/* Sample interpolation T1 */
-		int16_t		Sample;		/* Interpolated sample */
-		int16_t		OutputL;	/* Channel output (left) */
-		int16_t		OutputR;	/* Channel output (right) */
+		uint32_t	SampleCount;	/* Sample address (whole part) */
+		uint32_t	End;			/* End address (16-bit) */
+		pair32_t	Start;			/* Start address (22-bit) */
+		pair16_t	Loop;			/* Loop address (16-bit) */
+		uint16_t	FNum;			/* Frequency number (10-bit) */
+		int16_t		SampleT0;		/* Sample interpolation T0 */
+		int16_t		SampleT1;		/* Sample interpolation T1 */
+		int16_t		Sample;			/* Interpolated sample */
+		int16_t		OutputL;		/* Channel output (left) */
+		int16_t		OutputR;		/* Channel output (right) */
+		int8_t		Octave;			/* Octave (signed 4-bit) */
+		uint8_t		FNum9;			/* Copy of FNum bit 9 */
+
+		/* Envelope generator + multiplier */
+		uint32_t	EgLevel;		/* Envelope output level (10-bit, the attack step carries past it) */
+		uint16_t	DL;				/* Decay level (4-bit) */
+		uint16_t	PanAttnL;		/* Pan attenuation left */
+		uint16_t	PanAttnR;		/* Pan attenuation right */
+		uint8_t		EgPhase;		/* Envelope phase */
+		uint8_t		Rate[4];		/* ADSR rates (4-bit) */
+		uint8_t		RC;				/* Rate correction (4-bit) */
+		uint8_t		TL;				/* Total Level (7-bit) */
+		uint8_t		TargetTL;		/* Interpolated TL */
+		uint8_t		KeyOn;			/* Key On / Off flag */
+		uint8_t		KeyPending;		/* Key On / Off pending state */
+
+		/* LFO */
+		uint16_t	LfoCounter;		/* LFO counter */
+		uint16_t	LfoPeriod;		/* LFO period */
+		uint8_t		LfoStep;		/* LFO step counter (8-bit) */
+		uint8_t		LfoReset;		/* LFO reset flag */
+		uint8_t		PmDepth;		/* Vibrato depth (3-bit) */
+		uint8_t		AmDepth;		/* Tremolo depth (3-bit) */
+
+		/* Register state */
+		pair16_t	WaveNr;			/* Wave table number (9-bit) */
+		uint8_t		Format;			/* Wave format (2-bit) */
 	};
 
+	/* Address generator specialised for a wave format and memory bounds */
+	using address_generator_t = void (YMF278B::*)(CHANNEL& Channel);
+
 	CHANNEL		m_Channel[24];
+	address_generator_t	m_AddressGenerator[24];	/* Selected per channel (not part of the state) */
 	uint8_t		m_AddressLatch;
 
 	uint32_t	m_New;				/* OPL3 enable flag */
@@ -109,25 +133,40 @@ private:
 	uint32_t	m_MixCtrlPCMR;		/* Mix control attenuation (PCM Right) */
 	
 	uint32_t	m_EnvelopeCounter;	/* Global envelope counter */
+	uint64_t	m_EnvelopeRates;	/* Envelope rates updated at the envelope counter (not part of the state) */
 	uint32_t	m_InterpolCounter;	/* Global TL interpolation counter */
 
 	uint32_t	m_ClockSpeed;
 	uint32_t	m_ClockDivider;
+	uint32_t	m_FmClockDivider;	/* FM sample clock divider */
+	uint32_t	m_FmCycles;			/* FM clock cycles of the current output sample */
 	uint32_t	m_CyclesToDo;
+	bool		m_VoiceGroups;		/* Vectorized voice group updates */
+	TC::DeviceStats	m_Stats;
+
+	YM::GEW8::SIMD::group_t	m_VoiceGroup[3];	/* Voice group work area (24 channels) */
+
+	YM::OPL::Engine<true, false, true> m_FM; /* FM unit (OPL3) */
 
-	std::vector<uint8_t> m_Memory;
+	SampleMemory m_Memory; /* External memory (ROM / SRAM) */
+	uint32_t m_MemoryMask; /* Fitted memory (smaller memories are mirrored) */
+	PageTracker m_MemoryPages; /* Device written memory pages */
 
 	void WriteFM0(uint8_t Register, uint8_t Data);
 	void WriteFM1(uint8_t Register, uint8_t Data);
 	void WritePCM(uint8_t Register, uint8_t Data);
 
 	void LoadWaveTable(CHANNEL& Channel);
-	int16_t ReadSample(CHANNEL& Channel);
+	void SelectAddressGenerator(CHANNEL& Channel);
 	
+	void	RenderFrames(uint32_t Samples, AudioBlock<int16_t>& Block);
 	void	UpdateLFO(CHANNEL& Channel);
+	template<uint32_t Bits, bool Wrap>
 	void	UpdateAddressGenerator(CHANNEL& Channel);
 	void	UpdateEnvelopeGenerator(CHANNEL& Channel);
 	void	UpdateMultiplier(CHANNEL& Channel);
+	void	UpdateAttenuation(CHANNEL& Channel, uint32_t& AttnL, uint32_t& AttnR);
+	void	UpdateVoiceGroups(YM::GEW8::SIMD::mix_t& Mix);
 	void	UpdateInterpolator(CHANNEL& Channel);
 	
 	void	ProcessKeyOnOff(CHANNEL& Channel);
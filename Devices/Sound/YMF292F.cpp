@@ -12,9 +12,62 @@ See LICENSE.txt in the root directory of this source tree.
 
 */
 #include "YMF292F.h"
+#include <cmath>
 
 /*
 	Yamaha YMF292-F (Saturn Custom Sound Processor)
+
+	- 32 slots, 8/16-bit PCM from sound memory (512KB), noise source
+	- FM through the sound stack (the slot outputs of the last 2 samples)
+	- Per slot pitch and amplitude LFO (saw, square, triangle, noise)
+	- 128 step DSP with a ring buffer in sound memory
+	- 3 timers, interrupt pending / enable registers and a MIDI FIFO
+
+	Register map (16-bit words, big endian byte access):
+	----------------------------------------------------
+
+	0x000 - 0x3FF	Slot registers (32 slots x 0x20 bytes)
+	0x400 - 0x42F	Common control registers
+	0x600 - 0x67F	Sound stack (64 words)
+	0x700 - 0x77F	DSP coefficients (COEF, 64 words)
+	0x780 - 0x7BF	DSP memory addresses (MADRS, 32 words)
+	0x800 - 0xBFF	DSP micro program (MPRO, 128 steps x 4 words)
+	0xC00 - 0xDFF	DSP work buffer (TEMP, 128 x 24-bit)
+	0xE00 - 0xE7F	DSP memory data registers (MEMS, 32 x 24-bit)
+	0xE80 - 0xEBF	DSP slot inputs (MIXS, 16 x 20-bit)
+	0xEC0 - 0xEDF	DSP effect outputs (EFREG, 16 words)
+	0xEE0 - 0xEE3	DSP external inputs (EXTS, 2 words)
+
+	Slot register words:
+
+	 Word | Bits
+	------+-------------------------------------------------------------------------
+	  0   | KX(12) KB(11) SBCTL(10-9) SSCTL(8-7) LPCTL(6-5) PCM8B(4) SA[19:16](3-0)
+	  1   | SA[15:0]
+	  2   | LSA
+	  3   | LEA
+	  4   | D2R(15-11) D1R(10-6) EGHOLD(5) AR(4-0)
+	  5   | LPSLNK(14) KRS(13-10) DL(9-5) RR(4-0)
+	  6   | STWINH(9) SDIR(8) TL(7-0)
+	  7   | MDL(15-12) MDXSL(11-6) MDYSL(5-0)
+	  8   | OCT(14-11) FNS(9-0)
+	  9   | LFORE(15) LFOF(14-10) PLFOWS(9-8) PLFOS(7-5) ALFOWS(4-3) ALFOS(2-0)
+	 10   | ISEL(6-3) IMXL(2-0)
+	 11   | DISDL(15-13) DIPAN(12-8) EFSDL(7-5) EFPAN(4-0)
+
+	Slot processing:
+	----------------
+
+	Every sample the slot stages run in this order:
+	1. LFO, envelope generator and attenuation (lane loops over all slots)
+	2. Address generator, sample fetch and interpolation (slot by slot, the modulation input of
+	   a slot can be the output of a slot processed earlier in the same sample)
+	3. Direct mix and DSP input mix (lane loop)
+	4. DSP program, effect output mix
+
+	The DSP follows the documented micro program format, memory data is stored in the 16-bit
+	floating point format unless NOFL is set. The DMA controller and the interrupt outputs are
+	not emulated, the timers and interrupt pending flags are.
 */
 
 /* Audio output enumeration */
@@ -35,6 +88,116 @@ enum ADSR : uint32_t
 /* Static class member initialization */
 const std::wstring YMF292F::s_DeviceName = L"Yamaha YMF292-F";
 
+/* Send level attenuation (DISDL, IMXL, EFSDL: 0 = off, 7 = 0dB, 6dB steps) */
+static constexpr uint32_t SendAttn[8] =
+{
+	YM::GEW8::MaxAttenuation, 6 << 6, 5 << 6, 4 << 6, 3 << 6, 2 << 6, 1 << 6, 0
+};
+
+/* Pan attenuation (DIPAN, EFPAN: bit 4 selects the attenuated side, 3dB steps, 0xF = off) */
+static constexpr auto PanAttn = []
+{
+	std::array<std::array<uint32_t, 32>, 2> Table{};
+
+	for (uint32_t Pan = 0; Pan < 32; Pan++)
+	{
+		uint32_t Attn = ((Pan & 0x0F) == 0x0F) ? YM::GEW8::MaxAttenuation : (Pan & 0x0F) << 5;
+
+		Table[0][Pan] = (Pan & 0x10) ? Attn : 0; /* Left */
+		Table[1][Pan] = (Pan & 0x10) ? 0 : Attn; /* Right */
+	}
+
+	return Table;
+}();
+
+/* LFO period (samples per step, 256 steps) */
+static constexpr uint16_t LfoPeriod[32] =
+{
+	/*
+		LFOF frequencies (Hz):
+		0.17, 0.19, 0.23, 0.27, 0.34, 0.39, 0.45, 0.55, 0.68, 0.78, 0.92, 1.10, 1.39, 1.60, 1.87, 2.27,
+		2.87, 3.31, 3.92, 4.79, 6.15, 7.18, 8.80, 10.8, 16.4, 21.5, 27.6, 34.7, 46.7, 60.0, 81.3, 172.3
+
+		Period = 44100 / (256 * Freq)
+	*/
+	1013, 907, 749, 638, 507, 442, 383, 313, 253, 221, 187, 157, 124, 108, 92, 76,
+	60, 52, 44, 36, 28, 24, 20, 16, 11, 8, 6, 5, 4, 3, 2, 1
+};
+
+/* Amplitude LFO depth (ALFOS: 0, 0.4, 0.8, 1.5, 3, 6, 12, 24 dB at the maximum LFO output) */
+static constexpr uint32_t AlfoScale[8] =
+{
+	0, 4, 9, 16, 32, 64, 128, 256
+};
+
+/* Pitch LFO frequency factor (PLFOS: 0, 7, 13.5, 27, 55, 112, 230, 494 cents at the maximum LFO output) */
+static const auto PitchFactor = []
+{
+	static constexpr double Cents[8] = { 0.0, 7.0, 13.5, 27.0, 55.0, 112.0, 230.0, 494.0 };
+
+	std::array<std::array<uint16_t, 256>, 8> Table{};
+
+	for (uint32_t Depth = 0; Depth < 8; Depth++)
+	{
+		for (int32_t Lfo = -128; Lfo < 128; Lfo++)
+		{
+			/* 1.10 fixed point */
+			Table[Depth][Lfo + 128] = (uint16_t)std::lround(1024.0 * std::exp2((Cents[Depth] * Lfo) / (128.0 * 1200.0)));
+		}
+	}
+
+	return Table;
+}();
+
+/* Volume of an attenuation (10-bit: 4.6), 13-bit linear */
+static inline uint32_t Volume(uint32_t Attn)
+{
+	Attn = std::min(Attn, YM::GEW8::MaxAttenuation) << 2;
+
+	return YM::GEW8::ExpTable[Attn & 0xFF] >> (Attn >> 8);
+}
+
+/* Store a DSP value in 16-bit floating point format (1 sign, 4 exponent, 11 mantissa bits) */
+static uint16_t PackFloat(int32_t Value)
+{
+	uint32_t Sign = (Value >> 23) & 0x01;
+	uint32_t Temp = (Value ^ (Value << 1)) & 0xFFFFFF;
+	uint32_t Exponent = 0;
+
+	while ((Exponent < 12) && ((Temp & 0x800000) == 0))
+	{
+		Temp <<= 1;
+		Exponent++;
+	}
+
+	uint32_t Mantissa = (Exponent < 12) ? ((uint32_t)Value << Exponent) & 0x3FFFFF : (uint32_t)Value << 11;
+
+	return (uint16_t)((Sign << 15) | (Exponent << 11) | ((Mantissa >> 11) & 0x7FF));
+}
+
+/* Load a DSP value from 16-bit floating point format */
+static int32_t UnpackFloat(uint16_t Value)
+{
+	uint32_t Sign = (Value >> 15) & 0x01;
+	uint32_t Exponent = (Value >> 11) & 0x0F;
+	int32_t Mantissa = (Value & 0x7FF) << 11;
+
+	if (Exponent > 11)
+	{
+		Exponent = 11;
+		Mantissa |= Sign << 22;
+	}
+	else
+	{
+		Mantissa |= (Sign ^ 1) << 22;
+	}
+
+	Mantissa |= Sign << 23;
+
+	/* Sign extend from 24-bit */
+	return ((Mantissa << 8) >> 8) >> Exponent;
+}
+
 YMF292F::YMF292F(uint32_t ClockSpeed) :
 	m_ClockSpeed(ClockSpeed),
 	m_ClockDivider(512)
@@ -55,20 +218,36 @@ void YMF292F::Reset(ResetType Type)
 	m_CyclesToDo = 0;
 
 	/* Initialize common registers */
+	memset(&m_Common, 0, sizeof(common_t));
+
 	m_Common.MemoryMask = 0x1FFFF;	/* Default to 128KB of sound memory */
 	m_Common.Dac18bit = 0;			/* Default to 16-bit output */
 	m_Common.MasterVolume = 0;
+	m_Common.MidiFifoFlags = 0x09;	/* MIDI input and output FIFO empty */
 
 	/* Initialize slot registers  */
-	for (auto& Slot : m_Slot)
+	memset(&m_Slots, 0, sizeof(slots_t));
+
+	for (uint32_t i = 0; i < Slots; i++)
 	{
-		memset(&Slot, 0, sizeof(YMF292F::slot_t));
+		m_Slots.EgPhase[i] = ADSR::Release;
+		m_Slots.EgLevel[i] = YM::GEW8::MaxAttenuation;
 	}
 
+	/* Initialize DSP */
+	memset(&m_DSP, 0, sizeof(dsp_t));
+	memset(&m_Lanes, 0, sizeof(lanes_t));
+
+	memset(m_Stack, 0, sizeof(m_Stack));
+	m_StackPtr = 0;
+	m_Timer = 0;
+	m_Noise = 1;
+
 	/* Clear sound memory */
 	if (Type == ResetType::PowerOnDefaults)
 	{
 		memset(m_Memory.data(), 0, m_Memory.size());
+		m_MemoryPages.Clear();
 	}
 }
 
@@ -81,7 +260,7 @@ bool YMF292F::EnumAudioOutputs(uint32_t OutputNr, AUDIO_OUTPUT_DESC& Desc)
 	if (OutputNr == AudioOut::Default)
 	{
 		Desc.SampleRate = m_ClockSpeed / m_ClockDivider;
-		Desc.SampleFormat = 0;
+		Desc.SampleFormat = AudioFormat::AUDIO_FMT_S16;
 		Desc.Channels = 2;
 		Desc.ChannelMask = SPEAKER_FRONT_LEFT | SPEAKER_FRONT_RIGHT;
 		Desc.Description = L"";
@@ -102,105 +281,1116 @@ uint32_t YMF292F::GetClockSpeed()
 	return m_ClockSpeed;
 }
 
+bool YMF292F::GetStats(TC::StatsSnapshot& Stats)
+{
+	return m_Stats.Get(Stats);
+}
+
 void YMF292F::Write(uint32_t Address, uint32_t Data)
 {
 	/* VGM only interface */
+	Address &= 0x0FFF;
+	m_Stats.RegisterWrite(Address);
+
 	switch (Address & 0x0F00)
 	{
 	case 0x0000:
 	case 0x0100:
 	case 0x0200:
 	case 0x0300: /* Slot control registers */
+	{
+		uint32_t SlotNr = Address >> 5;
+		uint32_t Word = (Address >> 1) & 0x0F;
+		uint16_t& Reg = m_Slots.Regs[SlotNr][Word];
+
+		/* Even addresses hold the upper byte */
+		Reg = (Address & 0x01) ? ((Reg & 0xFF00) | (Data & 0xFF)) : ((Reg & 0x00FF) | ((Data & 0xFF) << 8));
+
+		/* KYONEX is executed by writing the upper byte of word 0 */
+		WriteSlot(SlotNr, Word, Reg, (Word == 0) && !(Address & 0x01) && (Data & 0x10));
 		break;
+	}
 
 	case 0x0400: /* Common control registers */
 		WriteCommonControl8(Address, Data);
 		break;
 
 	case 0x0500: /* Not used */
-		__debugbreak();
 		break;
 
 	case 0x0600: /* Sound data stack */
+		if (Address < 0x680)
+		{
+			uint16_t Reg = m_Stack[(Address >> 1) & 0x3F];
+			Reg = (Address & 0x01) ? ((Reg & 0xFF00) | (Data & 0xFF)) : ((Reg & 0x00FF) | ((Data & 0xFF) << 8));
+			m_Stack[(Address >> 1) & 0x3F] = Reg;
+		}
 		break;
 
 	case 0x0700: /* Coef registers / Memory address registers */
-		break;
-
 	case 0x0800:
 	case 0x0900:
 	case 0x0A00:
 	case 0x0B00: /* DSP micro program */
-		break;
-
 	case 0x0C00:
 	case 0x0D00: /* Work buffer */
-		break;
-
 	case 0x0E00: /* Sound memory / Mix stack / Effect output */
+		WriteDSP(Address, Data);
 		break;
 
 	case 0x0F00: /* Not used */
-		__debugbreak();
 		break;
 	}
 }
 
-void YMF292F::Update(uint32_t ClockCycles, std::vector<IAudioBuffer*>& OutBuffer)
+uint8_t YMF292F::Read(uint32_t Address)
 {
-	uint32_t TotalCycles = ClockCycles + m_CyclesToDo;
-	uint32_t Samples = TotalCycles / m_ClockDivider;
-	m_CyclesToDo = TotalCycles % m_ClockDivider;
+	Address &= 0x0FFF;
+
+	uint16_t Reg = 0;
 
-	while (Samples-- != 0)
+	if (Address < 0x400) /* Slot control registers (KX reads as 0) */
 	{
-		OutBuffer[AudioOut::Default]->WriteSampleS16(0);
-		OutBuffer[AudioOut::Default]->WriteSampleS16(0);
+		uint32_t SlotNr = Address >> 5;
+		uint32_t Word = (Address >> 1) & 0x0F;
+
+		Reg = m_Slots.Regs[SlotNr][Word] & ((Word == 0) ? 0xEFFF : 0xFFFF);
 	}
+	else if (Address < 0x430) /* Common control registers */
+	{
+		auto& Common = m_Common;
+
+		switch ((Address >> 1) & 0x1F)
+		{
+		case 0x00: /* MEM4MB, DAC18B, VER, MVOL */
+			Reg = (Common.MemoryMask == 0x7FFFF ? 0x200 : 0) | (Common.Dac18bit << 8) | (Common.Version << 4) | Common.MasterVolume;
+			break;
+
+		case 0x01: /* RBL, RBP */
+			Reg = (Common.RingBufLength << 7) | (Common.RingBufAddr >> 13);
+			break;
+
+		case 0x02: /* MIDI flags, MIBUF */
+		{
+			Reg = (Common.MidiFifoFlags << 8) | ((Common.MiCount != 0) ? Common.MiBuf[0] : 0);
+
+			/* Reading the data byte takes it from the input FIFO */
+			if ((Address & 0x01) && (Common.MiCount != 0))
+			{
+				memmove(Common.MiBuf, Common.MiBuf + 1, MidiFifoSize - 1);
+				Common.MiCount--;
+
+				/* MIEMP, MIFULL and MIOVF */
+				Common.MidiFifoFlags = (Common.MidiFifoFlags & ~0x07) | ((Common.MiCount == 0) ? 0x01 : 0x00);
+			}
+			break;
+		}
+
+		case 0x04: /* MSLC, CA */
+		{
+			/* CA: bits 15 - 12 of the sample position of the monitored slot */
+			uint32_t SampleNr = m_Slots.Position[Common.MonitorSlot] >> 12;
+
+			Reg = (Common.MonitorSlot << 11) | (((SampleNr >> 12) & 0x0F) << 7);
+			break;
+		}
+
+		case 0x0C: /* TACTL, TIMA */
+		case 0x0D: /* TBCTL, TIMB */
+		case 0x0E: /* TCCTL, TIMC */
+		{
+			uint32_t Timer = ((Address >> 1) & 0x1F) - 0x0C;
+
+			Reg = (Common.TimerCtl[Timer] << 8) | (Common.TimerCount[Timer] & 0xFF);
+			break;
+		}
+
+		case 0x0F: Reg = Common.SoundIntEnable; break;
+		case 0x10: Reg = Common.SoundIntPending; break;
+		case 0x12: Reg = Common.SoundIntLevel[0]; break;
+		case 0x13: Reg = Common.SoundIntLevel[1]; break;
+		case 0x14: Reg = Common.SoundIntLevel[2]; break;
+		case 0x15: Reg = Common.MainIntEnable; break;
+		case 0x16: Reg = Common.MainIntPending; break;
+
+		default:
+			Reg = Common.Regs[(Address >> 1) & 0x1F];
+			break;
+		}
+	}
+	else if ((Address >= 0x600) && (Address < 0x680)) /* Sound data stack */
+	{
+		Reg = m_Stack[(Address >> 1) & 0x3F];
+	}
+	else if (Address >= 0x700)
+	{
+		return ReadDSP(Address);
+	}
+
+	return (Address & 0x01) ? (Reg & 0xFF) : (Reg >> 8);
 }
 
-void YMF292F::CopyToMemory(uint32_t MemoryID, size_t Offset, uint8_t* Data, size_t Size)
+void YMF292F::MidiIn(uint8_t Data)
 {
-	if ((Offset + Size) > m_Memory.size()) return;
+	auto& Common = m_Common;
 
-	memcpy(m_Memory.data() + Offset, Data, Size);
+	if (Common.MiCount == MidiFifoSize)
+	{
+		/* MIOVF */
+		Common.MidiFifoFlags |= 0x04;
+		return;
+	}
+
+	Common.MiBuf[Common.MiCount++] = Data;
+
+	/* MIEMP and MIFULL */
+	Common.MidiFifoFlags &= ~0x01;
+	if (Common.MiCount == MidiFifoSize) Common.MidiFifoFlags |= 0x02;
+
+	/* MIDI input interrupt */
+	Common.SoundIntPending |= 0x0008;
+	Common.MainIntPending |= 0x0008;
 }
 
-void YMF292F::CopyToMemoryIndirect(uint32_t MemoryID, size_t Offset, uint8_t* Data, size_t Size)
+bool YMF292F::MidiOut(uint8_t& Data)
 {
-	/* No specialized implementation needed */
-	CopyToMemory(MemoryID, Offset, Data, Size);
+	auto& Common = m_Common;
+
+	if (Common.MoCount == 0) return false;
+
+	Data = Common.MoBuf[0];
+
+	memmove(Common.MoBuf, Common.MoBuf + 1, MidiFifoSize - 1);
+	Common.MoCount--;
+
+	/* MOEMP and MOFULL */
+	Common.MidiFifoFlags &= ~0x10;
+	if (Common.MoCount == 0) Common.MidiFifoFlags |= 0x08;
+
+	return true;
+}
+
+void YMF292F::WriteSlot(uint32_t SlotNr, uint32_t Word, uint16_t Data, bool KeyExecute)
+{
+	auto& S = m_Slots;
+	uint32_t i = SlotNr;
+
+	switch (Word)
+	{
+	case 0x00:
+		S.KeyBit[i] = (Data >> 11) & 0x01;
+		S.SignCtl[i] = (Data >> 9) & 0x03;
+		S.SourceCtl[i] = (Data >> 7) & 0x03;
+		S.LoopCtl[i] = (Data >> 5) & 0x03;
+		S.Pcm8[i] = (Data >> 4) & 0x01;
+		S.StartAddr[i] = (S.StartAddr[i] & 0x0FFFF) | ((Data & 0x0F) << 16);
+
+		/* KYONEX is a trigger, it is not stored */
+		S.Regs[i][0] &= ~0x1000;
+		break;
+
+	case 0x01:
+		S.StartAddr[i] = (S.StartAddr[i] & 0xF0000) | Data;
+		break;
+
+	case 0x02:
+		S.LoopStart[i] = Data;
+		break;
+
+	case 0x03:
+		S.LoopEnd[i] = Data;
+		break;
+
+	case 0x04:
+		S.EgRate[i][ADSR::Sustain] = (Data >> 11) & 0x1F;
+		S.EgRate[i][ADSR::Decay] = (Data >> 6) & 0x1F;
+		S.EgHold[i] = (Data >> 5) & 0x01;
+		S.EgRate[i][ADSR::Attack] = Data & 0x1F;
+		break;
+
+	case 0x05:
+		S.LoopLink[i] = (Data >> 14) & 0x01;
+		S.KeyRateScale[i] = (Data >> 10) & 0x0F;
+		S.DecayLvl[i] = (Data >> 5) & 0x1F;
+		S.EgRate[i][ADSR::Release] = Data & 0x1F;
+		break;
+
+	case 0x06:
+		S.StackInhibit[i] = (Data >> 9) & 0x01;
+		S.Direct[i] = (Data >> 8) & 0x01;
+		S.TotalLevel[i] = Data & 0xFF;
+		break;
+
+	case 0x07:
+		S.ModLevel[i] = (Data >> 12) & 0x0F;
+		S.ModInputX[i] = (Data >> 6) & 0x3F;
+		S.ModInputY[i] = Data & 0x3F;
+		break;
+
+	case 0x08:
+		S.Octave[i] = (int8_t)(((Data >> 11) & 0x0F) ^ 0x08) - 8;
+		S.FNum[i] = Data & 0x3FF;
+		break;
+
+	case 0x09:
+		S.LfoReset[i] = (Data >> 15) & 0x01;
+		S.LfoFreq[i] = (Data >> 10) & 0x1F;
+		S.PlfoWave[i] = (Data >> 8) & 0x03;
+		S.PlfoDepth[i] = (Data >> 5) & 0x07;
+		S.AlfoWave[i] = (Data >> 3) & 0x03;
+		S.AlfoDepth[i] = Data & 0x07;
+		break;
+
+	case 0x0A:
+		S.InputSel[i] = (Data >> 3) & 0x0F;
+		S.InputLvl[i] = Data & 0x07;
+		break;
+
+	case 0x0B:
+		S.DirectLvl[i] = (Data >> 13) & 0x07;
+		S.DirectPan[i] = (Data >> 8) & 0x1F;
+		S.EffectLvl[i] = (Data >> 5) & 0x07;
+		S.EffectPan[i] = Data & 0x1F;
+		break;
+
+	default: /* Not used */
+		break;
+	}
+
+	if (KeyExecute) ExecuteKeyOn();
+}
+
+void YMF292F::ExecuteKeyOn()
+{
+	auto& S = m_Slots;
+
+	/* KYONEX: all slots take over their KB bit */
+	for (uint32_t i = 0; i < Slots; i++)
+	{
+		if (S.KeyBit[i] && !S.KeyState[i])
+		{
+			S.KeyState[i] = 1;
+			S.EgPhase[i] = ADSR::Attack;
+			S.EgLevel[i] = YM::GEW8::MaxAttenuation;
+			S.Position[i] = 0;
+			S.Reverse[i] = 0;
+			S.Stopped[i] = 0;
+
+			m_Stats.KeyOn();
+		}
+		else if (!S.KeyBit[i] && S.KeyState[i])
+		{
+			S.KeyState[i] = 0;
+			S.EgPhase[i] = ADSR::Release;
+		}
+	}
 }
 
 void YMF292F::WriteCommonControl8(uint32_t Address, uint8_t Data)
 {
 	/* !! 8-bit access to the common control registers !! */
-	
+
 	if (Address > 0x42F) return; /* Valid range: 0x400 - 0x42F */
-	
+
+	uint32_t Word = (Address >> 1) & 0x1F;
+	uint16_t& Reg = m_Common.Regs[Word];
+
+	/* Even addresses hold the upper byte */
+	Reg = (Address & 0x01) ? ((Reg & 0xFF00) | Data) : ((Reg & 0x00FF) | (Data << 8));
+
 	switch (Address & 0x3F)
 	{
-	case 0x00: /* Memory size / DAC output size */
-		m_Common.MemoryMask = (Data & 0x02) ? 0x7FFFF : 0x1FFFF;
-		m_Common.Dac18bit = Data & 0x01;
+	case 0x07: /* MOBUF */
+		if (m_Common.MoCount < MidiFifoSize)
+		{
+			m_Common.MoBuf[m_Common.MoCount++] = Data;
+
+			/* MOEMP and MOFULL */
+			m_Common.MidiFifoFlags &= ~0x08;
+			if (m_Common.MoCount == MidiFifoSize) m_Common.MidiFifoFlags |= 0x10;
+		}
 		break;
 
-	case 0x01: /* Version (read only) / Master volume */
-		m_Common.MasterVolume = Data & 0x0F;
+	case 0x18: /* Timer A control */
+	case 0x1A: /* Timer B control */
+	case 0x1C: /* Timer C control */
+		m_Common.TimerCtl[(Word - 0x0C)] = Data & 0x07;
 		break;
 
-	case 0x02: /* RBL[1] */
-		m_Common.RingBufLength = (m_Common.RingBufLength & 0x01) | ((Data & 0x01) << 1);
+	case 0x19: /* Timer A prescaler */
+	case 0x1B: /* Timer B prescaler */
+	case 0x1D: /* Timer C prescaler */
+		m_Common.TimerCount[(Word - 0x0C)] = Data;
 		break;
 
-	case 0x18: /* Timer A control */
+	case 0x23: /* SCIRE (lower byte) */
+		m_Common.SoundIntPending &= ~Data;
 		break;
 
-	case 0x19: /* Timer A prescaler */
+	case 0x22: /* SCIRE (upper byte) */
+		m_Common.SoundIntPending &= ~(Data << 8);
+		break;
+
+	case 0x2F: /* MCIRE (lower byte) */
+		m_Common.MainIntPending &= ~Data;
 		break;
 
-	default: /* Not handled yet */
-		__debugbreak();
+	case 0x2E: /* MCIRE (upper byte) */
+		m_Common.MainIntPending &= ~(Data << 8);
 		break;
+
+	default:
+		WriteCommon(Word, Reg);
+		break;
+	}
+}
+
+void YMF292F::WriteCommon(uint32_t Word, uint16_t Data)
+{
+	auto& Common = m_Common;
+
+	switch (Word)
+	{
+	case 0x00: /* Memory size / DAC output size / Master volume */
+		Common.MemoryMask = (Data & 0x200) ? 0x7FFFF : 0x1FFFF;
+		Common.Dac18bit = (Data >> 8) & 0x01;
+		Common.MasterVolume = Data & 0x0F;
+		break;
+
+	case 0x01: /* Ring buffer length / lead address */
+		Common.RingBufLength = (Data >> 7) & 0x03;
+		Common.RingBufAddr = (Data & 0x7F) << 13;
+		break;
+
+	case 0x04: /* Monitor slot */
+		Common.MonitorSlot = (Data >> 11) & 0x1F;
+		break;
+
+	case 0x0F: /* SCIEB */
+		Common.SoundIntEnable = Data & 0x07FF;
+		break;
+
+	case 0x10: /* SCIPD (only the CPU manual interrupt can be set) */
+		Common.SoundIntPending |= Data & 0x0020;
+		break;
+
+	case 0x12: /* SCILV0 */
+	case 0x13: /* SCILV1 */
+	case 0x14: /* SCILV2 */
+		Common.SoundIntLevel[Word - 0x12] = Data & 0xFF;
+		break;
+
+	case 0x15: /* MCIEB */
+		Common.MainIntEnable = Data & 0x07FF;
+		break;
+
+	case 0x16: /* MCIPD (only the CPU manual interrupt can be set) */
+		Common.MainIntPending |= Data & 0x0020;
+		break;
+
+	default: /* DMA transfers are not emulated (TODO) */
+		break;
+	}
+}
+
+void YMF292F::WriteDSP(uint32_t Address, uint8_t Data)
+{
+	auto& DSP = m_DSP;
+
+	uint32_t Word = (Address >> 1);
+	bool Upper = !(Address & 0x01);
+
+	/* Merge a byte into a 16-bit register */
+	auto Merge = [&](uint16_t Reg) -> uint16_t { return Upper ? ((Reg & 0x00FF) | (Data << 8)) : ((Reg & 0xFF00) | Data); };
+
+	/* 24-bit registers: even word = bits 7 - 0, odd word = bits 23 - 8 */
+	auto Merge24 = [&](int32_t Reg, uint32_t Index) -> int32_t
+	{
+		uint32_t Value = (uint32_t)Reg & 0xFFFFFF;
+
+		if (Index & 0x01) Value = (Value & 0x0000FF) | ((uint32_t)Merge((uint16_t)(Value >> 8)) << 8);
+		else Value = (Value & 0xFFFF00) | (Merge((uint16_t)(Value & 0xFF)) & 0xFF);
+
+		return (int32_t)(Value << 8) >> 8;
+	};
+
+	if (Address < 0x780) /* COEF */
+	{
+		DSP.Coef[Word & 0x3F] = Merge(DSP.Coef[Word & 0x3F]);
+	}
+	else if (Address < 0x7C0) /* MADRS */
+	{
+		DSP.MemAddr[Word & 0x1F] = Merge(DSP.MemAddr[Word & 0x1F]);
+	}
+	else if (Address < 0x800) /* Not used */
+	{
+	}
+	else if (Address < 0xC00) /* MPRO */
+	{
+		uint32_t Step = (Word >> 2) & 0x7F;
+		uint16_t& Reg = DSP.Program[Step][Word & 0x03];
+
+		Reg = Merge(Reg);
+
+		/* Only run the program up to the last non-zero step */
+		DSP.Steps = 0;
+
+		for (uint32_t n = 128; n > 0; n--)
+		{
+			auto& Program = DSP.Program[n - 1];
+
+			if ((Program[0] | Program[1] | Program[2] | Program[3]) != 0)
+			{
+				DSP.Steps = n;
+				break;
+			}
+		}
+	}
+	else if (Address < 0xE00) /* TEMP */
+	{
+		uint32_t Index = Word & 0xFF;
+		DSP.Temp[Index >> 1] = Merge24(DSP.Temp[Index >> 1], Index);
+	}
+	else if (Address < 0xE80) /* MEMS */
+	{
+		uint32_t Index = Word & 0x3F;
+		DSP.Mems[Index >> 1] = Merge24(DSP.Mems[Index >> 1], Index);
+	}
+	else if (Address < 0xEC0) /* MIXS (20-bit: even word = bits 3 - 0, odd word = bits 19 - 4) */
+	{
+		uint32_t Index = Word & 0x1F;
+		uint32_t Value = (uint32_t)DSP.Mixs[Index >> 1] & 0xFFFFF;
+
+		if (Index & 0x01) Value = (Value & 0x0000F) | ((uint32_t)Merge((uint16_t)(Value >> 4)) << 4);
+		else Value = (Value & 0xFFFF0) | (Merge((uint16_t)(Value & 0x0F)) & 0x0F);
+
+		DSP.Mixs[Index >> 1] = (int32_t)(Value << 12) >> 12;
+	}
+	else if (Address < 0xEE0) /* EFREG */
+	{
+		DSP.EfReg[Word & 0x0F] = (int16_t)Merge((uint16_t)DSP.EfReg[Word & 0x0F]);
+	}
+	else if (Address < 0xEE4) /* EXTS */
+	{
+		DSP.Exts[Word & 0x01] = (int16_t)Merge((uint16_t)DSP.Exts[Word & 0x01]);
 	}
 }
+
+uint8_t YMF292F::ReadDSP(uint32_t Address)
+{
+	auto& DSP = m_DSP;
+
+	uint32_t Word = (Address >> 1);
+	uint16_t Reg = 0;
+
+	if (Address < 0x780) Reg = DSP.Coef[Word & 0x3F];
+	else if (Address < 0x7C0) Reg = DSP.MemAddr[Word & 0x1F];
+	else if (Address < 0x800) Reg = 0;
+	else if (Address < 0xC00) Reg = DSP.Program[(Word >> 2) & 0x7F][Word & 0x03];
+	else if (Address < 0xE00) Reg = (Word & 0x01) ? (uint16_t)(DSP.Temp[(Word & 0xFF) >> 1] >> 8) : (DSP.Temp[(Word & 0xFF) >> 1] & 0xFF);
+	else if (Address < 0xE80) Reg = (Word & 0x01) ? (uint16_t)(DSP.Mems[(Word & 0x3F) >> 1] >> 8) : (DSP.Mems[(Word & 0x3F) >> 1] & 0xFF);
+	else if (Address < 0xEC0) Reg = (Word & 0x01) ? (uint16_t)(DSP.Mixs[(Word & 0x1F) >> 1] >> 4) : (DSP.Mixs[(Word & 0x1F) >> 1] & 0x0F);
+	else if (Address < 0xEE0) Reg = (uint16_t)DSP.EfReg[Word & 0x0F];
+	else if (Address < 0xEE4) Reg = (uint16_t)DSP.Exts[Word & 0x01];
+
+	return (Address & 0x01) ? (Reg & 0xFF) : (Reg >> 8);
+}
+
+void YMF292F::Update(uint32_t ClockCycles, std::vector<IAudioBuffer*>& OutBuffer)
+{
+	uint32_t TotalCycles = ClockCycles + m_CyclesToDo;
+	uint32_t Samples = TotalCycles / m_ClockDivider;
+	m_CyclesToDo = TotalCycles % m_ClockDivider;
+
+	TC::DeviceStats::UpdateScope Stats(m_Stats, Samples);
+
+	AudioBlock<int16_t> Block(OutBuffer[AudioOut::Default]);
+
+	/* Master volume (3dB steps, 0 = off) */
+	uint32_t MasterVolume = (m_Common.MasterVolume != 0) ? Volume((15 - m_Common.MasterVolume) << 5) : 0;
+
+	RenderBlock(Samples, [&](int32_t OutL, int32_t OutR)
+	{
+		/* Limiter (signed 16-bit) */
+		Block.Write((int16_t)std::clamp((OutL * (int32_t)MasterVolume) >> 13, -32768, 32767));
+		Block.Write((int16_t)std::clamp((OutR * (int32_t)MasterVolume) >> 13, -32768, 32767));
+	});
+
+	Stats.ActiveVoices([&] { return std::count(std::begin(m_Slots.KeyState), std::end(m_Slots.KeyState), 1); });
+}
+
+uint32_t YMF292F::GetCyclesForFrames(uint32_t OutputNr, uint32_t Frames)
+{
+	/* All outputs run at the same rate */
+	return CyclesForFrames(Frames, m_ClockDivider, m_CyclesToDo);
+}
+
+template<typename F>
+void YMF292F::RenderBlock(uint32_t Frames, F&& Output)
+{
+	for (uint32_t n = 0; n < Frames; n++)
+	{
+		/* Update global timer */
+		m_Timer++;
+
+		UpdateTimers();
+
+		/* Noise generator (17-bit LFSR) */
+		m_Noise = (m_Noise >> 1) | (((m_Noise ^ (m_Noise >> 3)) & 0x01) << 16);
+
+		/* Lane stages */
+		UpdateLFO();
+		UpdateEnvelopeGenerator();
+		UpdateAttenuation();
+
+		/* Slot order stage */
+		for (uint32_t i = 0; i < Slots; i++) UpdateAddressGenerator(i);
+
+		int32_t OutL = 0;
+		int32_t OutR = 0;
+
+		UpdateMixer(OutL, OutR);
+
+		Output(OutL, OutR);
+	}
+}
+
+void YMF292F::UpdateTimers()
+{
+	auto& Common = m_Common;
+
+	for (uint32_t t = 0; t < 3; t++)
+	{
+		/* Timers count up every 2^TxCTL samples and stop at 0xFF */
+		if ((m_Timer & ((1 << Common.TimerCtl[t]) - 1)) != 0) continue;
+		if (Common.TimerCount[t] >= 0xFF) continue;
+
+		if (++Common.TimerCount[t] == 0xFF)
+		{
+			Common.SoundIntPending |= 0x0040 << t;
+			Common.MainIntPending |= 0x0040 << t;
+		}
+	}
+
+	/* Sample interval interrupt */
+	Common.SoundIntPending |= 0x0400;
+	Common.MainIntPending |= 0x0400;
+}
+
+void YMF292F::UpdateLFO()
+{
+	auto& S = m_Slots;
+	auto& L = m_Lanes;
+
+	int32_t Noise = (int8_t)(m_Noise & 0xFF);
+
+	for (uint32_t i = 0; i < Slots; i++)
+	{
+		if (S.LfoReset[i])
+		{
+			S.LfoCounter[i] = 0;
+			S.LfoStep[i] = 0;
+		}
+		else if (++S.LfoCounter[i] >= LfoPeriod[S.LfoFreq[i]])
+		{
+			S.LfoCounter[i] = 0;
+			S.LfoStep[i]++;
+		}
+
+		uint32_t Step = S.LfoStep[i];
+
+		/* Pitch LFO (signed 8-bit) */
+		int32_t Pitch;
+
+		switch (S.PlfoWave[i])
+		{
+		case 0: Pitch = (int8_t)Step; break;											/* Saw */
+		case 1: Pitch = (Step < 128) ? 127 : -128; break;								/* Square */
+		case 2: Pitch = (Step < 64) ? Step * 2 : (Step < 192) ? 255 - Step * 2 : Step * 2 - 511; break;	/* Triangle */
+		default: Pitch = Noise; break;													/* Noise */
+		}
+
+		/* Amplitude LFO (unsigned 8-bit) */
+		uint32_t Amp;
+
+		switch (S.AlfoWave[i])
+		{
+		case 0: Amp = Step; break;														/* Saw */
+		case 1: Amp = (Step < 128) ? 0 : 255; break;									/* Square */
+		case 2: Amp = (Step < 128) ? Step * 2 : 511 - Step * 2; break;					/* Triangle */
+		default: Amp = Noise + 128; break;												/* Noise */
+		}
+
+		L.Pitch[i] = std::clamp(Pitch, -128, 127);
+		L.Alfo[i] = (Amp * AlfoScale[S.AlfoDepth[i]]) >> 8;
+	}
+}
+
+void YMF292F::UpdateEnvelopeGenerator()
+{
+	auto& S = m_Slots;
+
+	/* Rates updated at the global timer */
+	uint64_t Rates = YM::GetEgRates(YM::GEW8::EgSchedule, m_Timer);
+
+	for (uint32_t i = 0; i < Slots; i++)
+	{
+		uint32_t Phase = S.EgPhase[i];
+		uint32_t Rate = S.EgRate[i][Phase];
+
+		if (Rate == 0) continue;
+
+		/* Key rate scaling (KRS = 0xF: off) */
+		int32_t Correction = 0;
+
+		if (S.KeyRateScale[i] != 0x0F)
+		{
+			Correction = (S.Octave[i] + S.KeyRateScale[i]) * 2 + ((S.FNum[i] >> 9) & 0x01);
+		}
+
+		uint32_t ActualRate = std::clamp((int32_t)(Rate << 1) + Correction, 0, 63);
+
+		if (((Rates >> ActualRate) & 1) == 0) continue;
+
+		/* Get update cycle (8 cycles in total) */
+		uint32_t Cycle = (m_Timer >> YM::GEW8::EgShift[ActualRate]) & 0x07;
+
+		/* Lookup attenuation adjustment */
+		int32_t AttnInc = YM::GEW8::EgLevelAdjust[ActualRate][Cycle];
+		int32_t Level = S.EgLevel[i];
+
+		switch (Phase)
+		{
+		case ADSR::Attack:
+			if (ActualRate >= 62) Level = 0; /* Instant attack */
+			else if (Level != 0) Level += ((~Level * AttnInc) >> 4);
+
+			if (Level <= 0)
+			{
+				Level = 0;
+				S.EgPhase[i] = ADSR::Decay;
+			}
+			break;
+
+		case ADSR::Decay:
+			Level += AttnInc;
+			if ((Level >> 5) >= S.DecayLvl[i]) S.EgPhase[i] = ADSR::Sustain;
+			break;
+
+		case ADSR::Sustain:
+		case ADSR::Release:
+			Level += AttnInc;
+			break;
+		}
+
+		S.EgLevel[i] = (uint16_t)std::min<int32_t>(Level, YM::GEW8::MaxAttenuation);
+	}
+}
+
+void YMF292F::UpdateAttenuation()
+{
+	auto& S = m_Slots;
+	auto& L = m_Lanes;
+
+	/* Branch free lane loop: attenuation to linear volume of every output of a slot */
+	for (uint32_t i = 0; i < Slots; i++)
+	{
+		/* EGHOLD: the output stays at the maximum level during the attack phase */
+		uint32_t Eg = (S.EgHold[i] & (S.EgPhase[i] == ADSR::Attack)) ? 0 : S.EgLevel[i];
+
+		uint32_t Attn = Eg + (S.TotalLevel[i] << 2) + L.Alfo[i];
+
+		/* SDIR: bypass envelope, TL and tremolo */
+		Attn = S.Direct[i] ? 0 : Attn;
+
+		L.DirectL[i] = Volume(Attn + SendAttn[S.DirectLvl[i]] + PanAttn[0][S.DirectPan[i]]);
+		L.DirectR[i] = Volume(Attn + SendAttn[S.DirectLvl[i]] + PanAttn[1][S.DirectPan[i]]);
+		L.Input[i] = Volume(Attn + SendAttn[S.InputLvl[i]]);
+		L.Stack[i] = Volume(Attn);
+	}
+}
+
+int16_t YMF292F::ReadWord(uint32_t Address) const
+{
+	Address &= m_Common.MemoryMask & ~0x01;
+
+	return (int16_t)((m_Memory[Address] << 8) | m_Memory[Address + 1]);
+}
+
+void YMF292F::UpdateAddressGenerator(uint32_t i)
+{
+	auto& S = m_Slots;
+
+	/* Every slot has a sound stack entry */
+	uint32_t StackPtr = m_StackPtr;
+	m_StackPtr = (m_StackPtr + 1) & 0x3F;
+
+	/* Idle slots output silence */
+	if (S.Stopped[i] || (!S.KeyState[i] && (S.EgLevel[i] == YM::GEW8::MaxAttenuation)))
+	{
+		S.Sample[i] = 0;
+		if (!S.StackInhibit[i]) m_Stack[StackPtr] = 0;
+		return;
+	}
+
+	/* Calculate position increment (16.12) */
+	uint32_t Inc = ((1024 + S.FNum[i]) << (S.Octave[i] + 8)) >> 6;
+
+	/* Apply pitch LFO (vibrato) */
+	if (S.PlfoDepth[i] != 0) Inc = (Inc * PitchFactor[S.PlfoDepth[i]][m_Lanes.Pitch[i] + 128]) >> 10;
+
+	int32_t SampleNr = S.Position[i] >> 12;
+	int32_t Fraction = S.Position[i] & 0xFFF;
+
+	/* FM: modulation input from the sound stack */
+	if (S.ModLevel[i] >= 5)
+	{
+		int32_t Mod = (m_Stack[(StackPtr + S.ModInputX[i]) & 0x3F] + m_Stack[(StackPtr + S.ModInputY[i]) & 0x3F]) / 2;
+
+		SampleNr += Mod >> (16 - S.ModLevel[i]);
+	}
+
+	/* Sample fetch */
+	int32_t T0 = 0;
+	int32_t T1 = 0;
+
+	switch (S.SourceCtl[i])
+	{
+	case 0: /* Sound memory */
+		if (S.Pcm8[i])
+		{
+			uint32_t Mask = m_Common.MemoryMask;
+
+			T0 = (int8_t)m_Memory[(S.StartAddr[i] + SampleNr) & Mask] << 8;
+			T1 = (int8_t)m_Memory[(S.StartAddr[i] + SampleNr + 1) & Mask] << 8;
+		}
+		else
+		{
+			T0 = ReadWord(S.StartAddr[i] + SampleNr * 2);
+			T1 = ReadWord(S.StartAddr[i] + SampleNr * 2 + 2);
+		}
+		break;
+
+	case 1: /* Noise */
+		T0 = T1 = (int16_t)(m_Noise & 0xFFFF);
+		break;
+
+	default: /* No source */
+		break;
+	}
+
+	/* Linear sample interpolation */
+	int32_t Sample = (T0 * (0x1000 - Fraction) + T1 * Fraction) >> 12;
+
+	/* Sign bit control */
+	if (S.SignCtl[i] & 0x01) Sample ^= 0x7FFF;
+	if (S.SignCtl[i] & 0x02) Sample = (int16_t)(Sample ^ 0x8000);
+
+	S.Sample[i] = (int16_t)Sample;
+
+	/* Sound stack: output after envelope and TL */
+	if (!S.StackInhibit[i]) m_Stack[StackPtr] = (int16_t)((Sample * (int32_t)m_Lanes.Stack[i]) >> 13);
+
+	/* Update sample position */
+	int32_t Position = (int32_t)S.Position[i] + (S.Reverse[i] ? -(int32_t)Inc : (int32_t)Inc);
+
+	int32_t LoopStart = S.LoopStart[i] << 12;
+	int32_t LoopEnd = S.LoopEnd[i] << 12;
+
+	/* LPSLNK: decay starts when the loop start is reached */
+	if (S.LoopLink[i] && !S.Reverse[i] && (Position >= LoopStart) && (S.EgPhase[i] == ADSR::Attack)) S.EgPhase[i] = ADSR::Decay;
+
+	switch (S.LoopCtl[i])
+	{
+	case 0: /* No loop */
+		if (Position >= LoopEnd)
+		{
+			S.Stopped[i] = 1;
+			S.EgPhase[i] = ADSR::Release;
+			S.EgLevel[i] = YM::GEW8::MaxAttenuation;
+		}
+		break;
+
+	case 1: /* Normal loop */
+		if (Position >= LoopEnd) Position = LoopStart + std::max(Position - LoopEnd, 0) % std::max(LoopEnd - LoopStart, 0x1000);
+		break;
+
+	case 2: /* Reverse loop: play forward up to the loop start, then loop from loop end back to loop start */
+		if (!S.Reverse[i] && (Position >= LoopStart))
+		{
+			Position = LoopEnd - (Position - LoopStart);
+			S.Reverse[i] = 1;
+		}
+		else if (S.Reverse[i] && (Position < LoopStart))
+		{
+			Position = LoopEnd - (LoopStart - Position);
+		}
+		break;
+
+	case 3: /* Alternating loop */
+		if (!S.Reverse[i] && (Position >= LoopEnd))
+		{
+			Position = LoopEnd - (Position - LoopEnd);
+			S.Reverse[i] = 1;
+		}
+		else if (S.Reverse[i] && (Position < LoopStart))
+		{
+			Position = LoopStart + (LoopStart - Position);
+			S.Reverse[i] = 0;
+		}
+		break;
+	}
+
+	S.Position[i] = (uint32_t)std::max(Position, 0) & 0x0FFFFFFF;
+}
+
+void YMF292F::UpdateMixer(int32_t& OutL, int32_t& OutR)
+{
+	auto& S = m_Slots;
+	auto& L = m_Lanes;
+	auto& DSP = m_DSP;
+
+	/* Direct outputs (lane loop) */
+	for (uint32_t i = 0; i < Slots; i++)
+	{
+		OutL += (S.Sample[i] * (int32_t)L.DirectL[i]) >> 13;
+		OutR += (S.Sample[i] * (int32_t)L.DirectR[i]) >> 13;
+	}
+
+	/* DSP inputs (16-bit samples on the 20-bit MIXS scale) */
+	for (uint32_t i = 0; i < Slots; i++)
+	{
+		DSP.Mixs[S.InputSel[i]] += (S.Sample[i] * (int32_t)L.Input[i]) >> 11;
+	}
+
+	UpdateDSP();
+
+	/* Effect outputs: EFREG 0 - 15 use the send level / pan of slot 0 - 15, EXTS 0 - 1 those of slot 16 - 17 */
+	for (uint32_t i = 0; i < 18; i++)
+	{
+		if (S.EffectLvl[i] == 0) continue;
+
+		int32_t Effect = (i < 16) ? DSP.EfReg[i] : DSP.Exts[i - 16];
+
+		OutL += (Effect * (int32_t)Volume(SendAttn[S.EffectLvl[i]] + PanAttn[0][S.EffectPan[i]])) >> 13;
+		OutR += (Effect * (int32_t)Volume(SendAttn[S.EffectLvl[i]] + PanAttn[1][S.EffectPan[i]])) >> 13;
+	}
+}
+
+void YMF292F::UpdateDSP()
+{
+	auto& DSP = m_DSP;
+
+	memset(DSP.EfReg, 0, sizeof(DSP.EfReg));
+
+	if (DSP.Steps == 0)
+	{
+		memset(DSP.Mixs, 0, sizeof(DSP.Mixs));
+		return;
+	}
+
+	/* Ring buffer: 8K, 16K, 32K or 64K words */
+	uint32_t RingMask = (0x2000 << m_Common.RingBufLength) - 1;
+	uint32_t RingBase = m_Common.RingBufAddr >> 1; /* Word address */
+
+	int32_t Inputs = 0;
+
+	for (uint32_t Step = 0; Step < DSP.Steps; Step++)
+	{
+		const uint16_t* Program = DSP.Program[Step];
+
+		uint32_t TRA = (Program[0] >> 8) & 0x7F;
+		uint32_t TWT = (Program[0] >> 7) & 0x01;
+		uint32_t TWA = (Program[0] >> 0) & 0x7F;
+
+		uint32_t XSEL = (Program[1] >> 15) & 0x01;
+		uint32_t YSEL = (Program[1] >> 13) & 0x03;
+		uint32_t IRA = (Program[1] >> 6) & 0x3F;
+		uint32_t IWT = (Program[1] >> 5) & 0x01;
+		uint32_t IWA = (Program[1] >> 0) & 0x1F;
+
+		uint32_t TABLE = (Program[2] >> 15) & 0x01;
+		uint32_t MWT = (Program[2] >> 14) & 0x01;
+		uint32_t MRD = (Program[2] >> 13) & 0x01;
+		uint32_t EWT = (Program[2] >> 12) & 0x01;
+		uint32_t EWA = (Program[2] >> 8) & 0x0F;
+		uint32_t ADRL = (Program[2] >> 7) & 0x01;
+		uint32_t FRCL = (Program[2] >> 6) & 0x01;
+		uint32_t SHIFT = (Program[2] >> 4) & 0x03;
+		uint32_t YRL = (Program[2] >> 3) & 0x01;
+		uint32_t NEGB = (Program[2] >> 2) & 0x01;
+		uint32_t ZERO = (Program[2] >> 1) & 0x01;
+		uint32_t BSEL = (Program[2] >> 0) & 0x01;
+
+		uint32_t NOFL = (Program[3] >> 15) & 0x01;
+		uint32_t COEF = (Program[3] >> 9) & 0x3F;
+		uint32_t MASA = (Program[3] >> 2) & 0x1F;
+		uint32_t ADREB = (Program[3] >> 1) & 0x01;
+		uint32_t NXADR = (Program[3] >> 0) & 0x01;
+
+		/* Input select (24-bit) */
+		if (IRA <= 0x1F) Inputs = DSP.Mems[IRA];
+		else if (IRA <= 0x2F) Inputs = DSP.Mixs[IRA - 0x20] << 4; /* MIXS is 20-bit */
+		else Inputs = 0;
+
+		Inputs = (Inputs << 8) >> 8;
+
+		if (IWT)
+		{
+			/* Memory data of the previous read */
+			DSP.Mems[IWA] = DSP.MemVal;
+			if (IRA == IWA) Inputs = DSP.MemVal;
+		}
+
+		/* B operand */
+		int32_t B = 0;
+
+		if (!ZERO)
+		{
+			B = BSEL ? DSP.Acc : (DSP.Temp[(TRA + DSP.Dec) & 0x7F] << 8) >> 8;
+			if (NEGB) B = -B;
+		}
+
+		/* X operand */
+		int32_t X = XSEL ? Inputs : (DSP.Temp[(TRA + DSP.Dec) & 0x7F] << 8) >> 8;
+
+		/* Y operand (13-bit) */
+		int32_t Y;
+
+		switch (YSEL)
+		{
+		case 0: Y = DSP.Frc; break;
+		case 1: Y = DSP.Coef[COEF] >> 3; break;
+		case 2: Y = (DSP.Y >> 11) & 0x1FFF; break;
+		default: Y = (DSP.Y >> 4) & 0x0FFF; break;
+		}
+
+		if (YRL) DSP.Y = Inputs;
+
+		/* Shifter */
+		int32_t Shifted;
+
+		switch (SHIFT)
+		{
+		case 0: Shifted = std::clamp(DSP.Acc, -0x800000, 0x7FFFFF); break;
+		case 1: Shifted = std::clamp(DSP.Acc * 2, -0x800000, 0x7FFFFF); break;
+		case 2: Shifted = ((DSP.Acc * 2) << 8) >> 8; break;
+		default: Shifted = (DSP.Acc << 8) >> 8; break;
+		}
+
+		DSP.Shifted = Shifted;
+
+		/* Multiply accumulate */
+		Y = (Y << 19) >> 19;
+		DSP.Acc = (int32_t)(((int64_t)X * Y) >> 12) + B;
+
+		if (TWT) DSP.Temp[(TWA + DSP.Dec) & 0x7F] = Shifted;
+
+		if (FRCL) DSP.Frc = (SHIFT == 3) ? (Shifted & 0x0FFF) : ((Shifted >> 11) & 0x1FFF);
+
+		/* Ring buffer access (odd steps only) */
+		if ((MRD || MWT) && (Step & 0x01))
+		{
+			uint32_t Addr = DSP.MemAddr[MASA];
+
+			if (!TABLE) Addr += DSP.Dec;
+			if (ADREB) Addr += DSP.Adrs & 0x0FFF;
+			if (NXADR) Addr++;
+
+			Addr &= TABLE ? 0xFFFF : RingMask;
+
+			uint32_t Offset = ((RingBase + Addr) << 1) & m_Common.MemoryMask;
+
+			if (MRD)
+			{
+				uint16_t Data = (uint16_t)ReadWord(Offset);
+				DSP.MemVal = NOFL ? ((int32_t)(int16_t)Data << 8) : UnpackFloat(Data);
+			}
+
+			if (MWT)
+			{
+				uint16_t Data = NOFL ? (uint16_t)(Shifted >> 8) : PackFloat(Shifted);
+
+				m_MemoryPages.Touch(m_Memory.data(), m_Memory.size(), Offset);
+				m_Memory[Offset + 0] = Data >> 8;
+				m_Memory[Offset + 1] = Data & 0xFF;
+			}
+		}
+
+		if (ADRL) DSP.Adrs = (SHIFT == 3) ? ((Shifted >> 12) & 0x0FFF) : ((Inputs >> 16) & 0x0FFF);
+
+		if (EWT) DSP.EfReg[EWA] += Shifted >> 8;
+	}
+
+	DSP.Dec--;
+
+	memset(DSP.Mixs, 0, sizeof(DSP.Mixs));
+}
+
+void YMF292F::CopyToMemory(uint32_t MemoryID, size_t Offset, uint8_t* Data, size_t Size)
+{
+	if ((Offset + Size) > m_Memory.size()) return;
+
+	memcpy(m_Memory.data() + Offset, Data, Size);
+	m_MemoryPages.Upload(m_Memory.data(), Offset, Size);
+}
+
+void YMF292F::CopyToMemoryIndirect(uint32_t MemoryID, size_t Offset, uint8_t* Data, size_t Size)
+{
+	/* No specialized implementation needed */
+	CopyToMemory(MemoryID, Offset, Data, Size);
+}
+
+size_t YMF292F::GetMemorySize(uint32_t MemoryID)
+{
+	return m_Memory.size();
+}
+
+bool YMF292F::RevertMemory()
+{
+	m_MemoryPages.Revert(m_Memory.data(), m_Memory.size());
+
+	return true;
+}
+
+size_t YMF292F::GetResidentSize()
+{
+	return m_Memory.capacity() + m_MemoryPages.GetResidentSize();
+}
+
+void YMF292F::SaveState(StateWriter& State)
+{
+	State.BeginChunk("F292", 2);
+
+	State.Write(m_Common);
+	State.Write(m_Slots);
+	State.Write(m_DSP);
+	State.Write(m_Stack);
+	State.Write(m_StackPtr);
+	State.Write(m_Timer);
+	State.Write(m_Noise);
+	State.Write(m_CyclesToDo);
+
+	/* The DSP writes its ring buffer to sound memory */
+	m_MemoryPages.Save(State, m_Memory.data());
+
+	State.EndChunk();
+}
+
+bool YMF292F::LoadState(StateReader& State)
+{
+	if (!State.BeginChunk("F292", 2)) return false;
+
+	State.Read(m_Common);
+	State.Read(m_Slots);
+	State.Read(m_DSP);
+	State.Read(m_Stack);
+	State.Read(m_StackPtr);
+	State.Read(m_Timer);
+	State.Read(m_Noise);
+	State.Read(m_CyclesToDo);
+
+	if (!m_MemoryPages.Load(State, m_Memory.data(), m_Memory.size())) return false;
+
+	return State.EndChunk();
+}
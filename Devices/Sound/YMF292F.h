@@ -16,9 +16,11 @@ See LICENSE.txt in the root directory of this source tree.
 
 #include "../../Interfaces/ISoundDevice.h"
 #include "../../Interfaces/IMemoryAccess.h"
+#include "../../Interfaces/IStateAccess.h"
+#include "YM_GEW.h"
 
 /* Yamaha YMF292-F (Saturn Custom Sound Processor) */
-class YMF292F : public ISoundDevice, public IMemoryAccess
+class YMF292F : public ISoundDevice, public IMemoryAccess, public IStateAccess
 {
 public:
 	YMF292F(uint32_t ClockSpeed = 22'579'200);
@@ -35,14 +37,37 @@ public:
 	uint32_t		GetClockSpeed();
 	void			Write(uint32_t Address, uint32_t Data);
 	void			Update(uint32_t ClockCycles, std::vector<IAudioBuffer*>& OutBuffer);
+	uint32_t		GetCyclesForFrames(uint32_t OutputNr, uint32_t Frames);
+	bool			GetStats(TC::StatsSnapshot& Stats);
 
 	/* IMemoryAccess methods */
 	void			CopyToMemory(uint32_t MemoryID, size_t Offset, uint8_t* Data, size_t Size);
 	void			CopyToMemoryIndirect(uint32_t MemoryID, size_t Offset, uint8_t* Data, size_t Size);
+	size_t			GetMemorySize(uint32_t MemoryID);
+	bool			RevertMemory();
+	size_t			GetResidentSize();
+
+	/* IStateAccess methods */
+	void			SaveState(StateWriter& State);
+	bool			LoadState(StateReader& State);
+
+	/* Register read (8-bit), reading MIBUF takes a byte from the MIDI input FIFO */
+	uint8_t			Read(uint32_t Address);
+
+	/* MIDI interface: MidiIn queues a received byte (sets MIOVF when the FIFO is full), MidiOut
+	   takes a byte from the MIDI output FIFO and returns false when it is empty */
+	void			MidiIn(uint8_t Data);
+	bool			MidiOut(uint8_t& Data);
+
+	/* Number of slots */
+	static constexpr uint32_t Slots = 32;
 
 private:
 	static const std::wstring s_DeviceName;
 
+	/* MIDI FIFO depth */
+	static constexpr uint32_t MidiFifoSize = 4;
+
 	/* Common registers data type */
 	struct common_t
 	{
@@ -53,32 +78,150 @@ private:
 		uint8_t		RingBufLength;	/* RBL:    Ring buffer length */
 		uint32_t	RingBufAddr;	/* RBP:    Ring buffer lead address (20-bit) */
 		uint8_t		MidiFifoFlags;	/* MIDI input/output FIFO flags */
-		//			MiBuf;			/* MIBUF:  MIDI input data buffer */
-		//			MoBuf;			/* MOBUF:  MIDI output data buffer */
+		uint8_t		MiBuf[MidiFifoSize];	/* MIBUF:  MIDI input data buffer */
+		uint8_t		MiCount;		/* MIDI input FIFO level */
+		uint8_t		MoBuf[MidiFifoSize];	/* MOBUF:  MIDI output data buffer */
+		uint8_t		MoCount;		/* MIDI output FIFO level */
 		uint8_t		MonitorSlot;	/* MSLC:   Monitor slot (5-bit) */
-		uint8_t		CallAddress;	/* CA:     Call address (3-bit) */
+		uint8_t		CallAddress;	/* CA:     Call address (4-bit) */
+
+		uint8_t		TimerCtl[3];	/* TACTL, TBCTL, TCCTL: Timer prescaler (3-bit) */
+		uint16_t	TimerCount[3];	/* TIMA, TIMB, TIMC: Timer up-counter (8-bit) */
 
-		// TODO: To be completed
+		uint16_t	SoundIntEnable;	/* SCIEB:  Sound CPU interrupt enable */
+		uint16_t	SoundIntPending;/* SCIPD:  Sound CPU interrupt pending */
+		uint8_t		SoundIntLevel[3];	/* SCILV0 - SCILV2: Sound CPU interrupt level bits */
+		uint16_t	MainIntEnable;	/* MCIEB:  Main CPU interrupt enable */
+		uint16_t	MainIntPending;	/* MCIPD:  Main CPU interrupt pending */
+
+		uint16_t	Regs[0x18];		/* Register file (word access) */
 	};
 
-	/* Slot registers data type */
-	struct slot_t
+	/* Slot registers and state, structure of arrays (lane n = slot n)
+
+	The per sample stages (LFO, envelope, attenuation, mix) run as loops over all 32 lanes. Only
+	the address generator runs slot by slot, in slot order: FM modulation reads outputs of the
+	slots that were processed before it through the sound stack.
+	*/
+	struct slots_t
 	{
-		uint32_t	KeyState;		/* Key on/off state */
-		uint32_t	KeyLatch;		/* Latched key on/off flag */
-		uint32_t	KeyExLatch;		/* Latched key ex on/off flag */
+		/* Registers */
+		uint16_t	Regs[Slots][16];	/* Register file (word access) */
+		uint8_t		KeyBit[Slots];		/* KB:     Key on bit */
+		uint8_t		SignCtl[Slots];		/* SBCTL:  Sign bit control */
+		uint8_t		SourceCtl[Slots];	/* SSCTL:  Source control */
+		uint8_t		LoopCtl[Slots];		/* LPCTL:  Loop control */
+		uint8_t		Pcm8[Slots];		/* PCM8B:  8-bit PCM */
+		uint32_t	StartAddr[Slots];	/* SA:     Start address (20-bit) */
+		uint32_t	LoopStart[Slots];	/* LSA:    Loop start address (16-bit) */
+		uint32_t	LoopEnd[Slots];		/* LEA:    Loop end address (16-bit) */
+		uint8_t		EgRate[Slots][4];	/* AR, D1R, D2R, RR (5-bit) */
+		uint8_t		EgHold[Slots];		/* EGHOLD: Envelope hold */
+		uint8_t		LoopLink[Slots];	/* LPSLNK: Loop start link */
+		uint8_t		KeyRateScale[Slots];/* KRS:    Key rate scaling (4-bit) */
+		uint8_t		DecayLvl[Slots];	/* DL:     Decay level (5-bit) */
+		uint8_t		StackInhibit[Slots];/* STWINH: Stack write inhibit */
+		uint8_t		Direct[Slots];		/* SDIR:   Sound direct */
+		uint8_t		TotalLevel[Slots];	/* TL:     Total level (8-bit) */
+		uint8_t		ModLevel[Slots];	/* MDL:    Modulation level (4-bit) */
+		uint8_t		ModInputX[Slots];	/* MDXSL:  Modulation input X (6-bit) */
+		uint8_t		ModInputY[Slots];	/* MDYSL:  Modulation input Y (6-bit) */
+		int8_t		Octave[Slots];		/* OCT:    Octave (signed 4-bit) */
+		uint16_t	FNum[Slots];		/* FNS:    Frequency number (10-bit) */
+		uint8_t		LfoReset[Slots];	/* LFORE:  LFO reset */
+		uint8_t		LfoFreq[Slots];		/* LFOF:   LFO frequency (5-bit) */
+		uint8_t		PlfoWave[Slots];	/* PLFOWS: Pitch LFO waveform */
+		uint8_t		PlfoDepth[Slots];	/* PLFOS:  Pitch LFO depth */
+		uint8_t		AlfoWave[Slots];	/* ALFOWS: Amplitude LFO waveform */
+		uint8_t		AlfoDepth[Slots];	/* ALFOS:  Amplitude LFO depth */
+		uint8_t		InputSel[Slots];	/* ISEL:   DSP input (MIXS) select (4-bit) */
+		uint8_t		InputLvl[Slots];	/* IMXL:   DSP input level (3-bit) */
+		uint8_t		DirectLvl[Slots];	/* DISDL:  Direct send level (3-bit) */
+		uint8_t		DirectPan[Slots];	/* DIPAN:  Direct pan (5-bit) */
+		uint8_t		EffectLvl[Slots];	/* EFSDL:  Effect send level (3-bit) */
+		uint8_t		EffectPan[Slots];	/* EFPAN:  Effect pan (5-bit) */
+
+		/* State */
+		uint8_t		KeyState[Slots];	/* Key on/off state */
+		uint8_t		EgPhase[Slots];		/* Envelope phase */
+		uint16_t	EgLevel[Slots];		/* Envelope level (10-bit: 4.6) */
+		uint32_t	Position[Slots];	/* Sample position (28-bit: 16.12) */
+		uint8_t		Reverse[Slots];		/* Playing backwards */
+		uint8_t		Stopped[Slots];		/* End of a non-looped wave reached */
+		uint16_t	LfoCounter[Slots];	/* LFO counter */
+		uint8_t		LfoStep[Slots];		/* LFO step (8-bit) */
+		int32_t		Sample[Slots];		/* Interpolated sample */
+	};
+
+	/* Per sample slot outputs (work area, not part of the state) */
+	struct lanes_t
+	{
+		uint32_t	Alfo[Slots];		/* Amplitude LFO attenuation */
+		uint32_t	Stack[Slots];		/* Sound stack volume (EG, TL, ALFO) */
+		uint32_t	DirectL[Slots];		/* Direct output volume left */
+		uint32_t	DirectR[Slots];		/* Direct output volume right */
+		uint32_t	Input[Slots];		/* DSP input (MIXS) volume */
+		int32_t		Pitch[Slots];		/* Pitch LFO output (signed 8-bit) */
+	};
+
+	/* DSP registers and state */
+	struct dsp_t
+	{
+		uint16_t	Coef[64];			/* COEF:   Coefficients (13-bit) */
+		uint16_t	MemAddr[32];		/* MADRS:  Memory addresses */
+		uint16_t	Program[128][4];	/* MPRO:   Micro program (64-bit steps) */
+		int32_t		Temp[128];			/* TEMP:   Work buffer (24-bit) */
+		int32_t		Mems[32];			/* MEMS:   Memory data registers (24-bit) */
+		int32_t		Mixs[16];			/* MIXS:   Slot inputs (20-bit) */
+		int16_t		EfReg[16];			/* EFREG:  Effect outputs */
+		int16_t		Exts[2];			/* EXTS:   External inputs */
+
+		uint32_t	Steps;				/* Steps up to the last non-zero step */
+		uint32_t	Dec;				/* MDEC_CT: Ring buffer address decrement counter */
+		int32_t		Acc;				/* Accumulator (26-bit) */
+		int32_t		Shifted;			/* Shifter output (24-bit) */
+		int32_t		Y;					/* Y register (24-bit) */
+		uint32_t	Frc;				/* Fraction register (13-bit) */
+		uint32_t	Adrs;				/* Address register (12-bit) */
+		int32_t		MemVal;				/* Memory read data */
 	};
 
 	common_t	m_Common;
-	slot_t		m_Slot[32];
+	slots_t		m_Slots;
+	dsp_t		m_DSP;
+	lanes_t		m_Lanes;				/* Not part of the state */
+
+	int16_t		m_Stack[64];			/* Sound stack (slot outputs of the last 2 samples) */
+	uint32_t	m_StackPtr;				/* Sound stack write position */
+	uint32_t	m_Timer;				/* Global sample counter (envelope and timers) */
+	uint32_t	m_Noise;				/* Noise generator (17-bit LFSR) */
 
 	uint32_t	m_ClockSpeed;
 	uint32_t	m_ClockDivider;
 	uint32_t	m_CyclesToDo;
+	TC::DeviceStats	m_Stats;
 
 	std::vector<uint8_t>	m_Memory;
+	PageTracker				m_MemoryPages;	/* Device written memory pages (DSP ring buffer) */
 
+	template<typename F>
+	void	RenderBlock(uint32_t Frames, F&& Output);
+	void	WriteSlot(uint32_t SlotNr, uint32_t Word, uint16_t Data, bool KeyExecute);
+	void	WriteCommon(uint32_t Word, uint16_t Data);
 	void	WriteCommonControl8(uint32_t Address, uint8_t Data);
+	void	WriteDSP(uint32_t Address, uint8_t Data);
+	uint8_t	ReadDSP(uint32_t Address);
+	void	ExecuteKeyOn();
+
+	void	UpdateTimers();
+	void	UpdateLFO();
+	void	UpdateEnvelopeGenerator();
+	void	UpdateAttenuation();
+	void	UpdateAddressGenerator(uint32_t SlotNr);
+	void	UpdateMixer(int32_t& OutL, int32_t& OutR);
+	void	UpdateDSP();
+
+	int16_t	ReadWord(uint32_t Address) const;
 };
 
 #endif // !_YMF292F_H_
\ No newline at end of file
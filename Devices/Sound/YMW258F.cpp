@@ -55,13 +55,12 @@ const std::wstring YMW258F::s_DeviceName = L"Yamaha YMW258-F";
 YMW258F::YMW258F(uint32_t ClockSpeed, bool HasLDSP, size_t MemorySizeLDSP) :
 	m_ClockSpeed(ClockSpeed),
 	m_ClockDivider(224),
+	m_OutputFormat(AudioFormat::AUDIO_FMT_S16),
+	m_VoiceGroups(YM::GEW8::SIMD::IsSupported()),
+	m_VoiceGroup(),
+	m_Memory(0x400000), /* 4MB address space */
 	m_LDSP(HasLDSP ? std::make_unique<YM3413>(MemorySizeLDSP) : nullptr)
 {
-	YM::GEW8::BuildTables();
-
-	/* Set memory size to 4MB */
-	m_Memory.resize(0x400000);
-
 	Reset(ResetType::PowerOnDefaults);
 }
 
@@ -104,9 +103,12 @@ void YMW258F::Reset(ResetType Type)
 	if (Type == ResetType::PowerOnDefaults)
 	{
 		/* Clear PCM memory */
-		memset(m_Memory.data(), 0, m_Memory.size());
+		m_Memory.Clear();
+		m_MemoryPages.Clear();
 	}
 
+	for (auto& Channel : m_Channel) SelectAddressGenerator(Channel);
+
 	/* Reset LDSP */
 	if (m_LDSP != nullptr) m_LDSP->InitialClear();
 }
@@ -139,7 +141,7 @@ bool YMW258F::EnumAudioOutputs(uint32_t OutputNr, AUDIO_OUTPUT_DESC& Desc)
 	if (OutputNr == AudioOut::Default)
 	{
 		Desc.SampleRate		= m_ClockSpeed / m_ClockDivider;
-		Desc.SampleFormat	= AudioFormat::AUDIO_FMT_S16;
+		Desc.SampleFormat	= m_OutputFormat;
 		Desc.Channels		= 2;
 		Desc.ChannelMask	= SPEAKER_FRONT_LEFT | SPEAKER_FRONT_RIGHT;
 		Desc.Description	= L"Digital Out";
@@ -150,6 +152,15 @@ bool YMW258F::EnumAudioOutputs(uint32_t OutputNr, AUDIO_OUTPUT_DESC& Desc)
 	return false;
 }
 
+bool YMW258F::SetOutputFormat(uint32_t OutputNr, uint32_t SampleFormat)
+{
+	if ((OutputNr != AudioOut::Default) || (SampleFormat > AudioFormat::AUDIO_FMT_F32)) return false;
+
+	m_OutputFormat = SampleFormat;
+
+	return true;
+}
+
 void YMW258F::SetClockSpeed(uint32_t ClockSpeed)
 {
 	m_ClockSpeed = ClockSpeed;
@@ -160,6 +171,11 @@ uint32_t YMW258F::GetClockSpeed()
 	return m_ClockSpeed;
 }
 
+bool YMW258F::GetStats(TC::StatsSnapshot& Stats)
+{
+	return m_Stats.Get(Stats);
+}
+
 void YMW258F::Write(uint32_t Address, uint32_t Data)
 {	
 	/* 8-bit data bus (D0 - D7) */
@@ -168,6 +184,7 @@ void YMW258F::Write(uint32_t Address, uint32_t Data)
 	switch (Address & 0x0F) /* 4-bit address bus (A0 - A3) */
 	{
 	case 0x00: /* PCM data write */
+		m_Stats.RegisterWrite(m_RegisterLatch << TC::StatsSnapshot::RangeShift); /* One range per PCM register */
 		WritePcmData(m_ChannelLatch, m_RegisterLatch, Data);
 		break;
 
@@ -193,7 +210,11 @@ void YMW258F::Write(uint32_t Address, uint32_t Data)
 		break;
 
 	case 0x06: /* Memory data (Guess) */
-		m_Memory[m_MemoryAddress.u32] = Data;
+		/* Allocate up to the end of the page, the page tracker stores complete pages */
+		m_Memory.Reserve((m_MemoryAddress.u32 | (PageTracker::PageSize - 1)) + 1);
+
+		m_MemoryPages.Touch(m_Memory.Data(), m_Memory.Size(), m_MemoryAddress.u32);
+		m_Memory.Write(m_MemoryAddress.u32, Data);
 
 		/* Address auto increment */
 		m_MemoryAddress.u32 = (m_MemoryAddress.u32 + 1) & 0x3FFFFF;
@@ -381,38 +402,38 @@ void YMW258F::LoadWaveTable(YM::GEW8::channel_t& Channel)
 	size_t Offset = Channel.WaveNr.u16 * 12;
 
 	/* Wave format (2-bit) */
-	Channel.Format = m_Memory[Offset] >> 6;
+	Channel.Format = m_Memory.Read(Offset) >> 6;
 
 	/* Start address (22-bit) */
-	Channel.StartAddr = ((m_Memory[Offset] << 16) | (m_Memory[Offset + 1] << 8) | m_Memory[Offset + 2]) & 0x3FFFFF;
+	Channel.StartAddr = ((m_Memory.Read(Offset) << 16) | (m_Memory.Read(Offset + 1) << 8) | m_Memory.Read(Offset + 2)) & 0x3FFFFF;
 
 	/* Loop address (16-bit) */
-	Channel.LoopAddr = (m_Memory[Offset + 3] << 8) | m_Memory[Offset + 4];
+	Channel.LoopAddr = (m_Memory.Read(Offset + 3) << 8) | m_Memory.Read(Offset + 4);
 
 	/* End address (16-bit) */
-	Channel.EndAddr = 0x10000 - ((m_Memory[Offset + 5] << 8) | m_Memory[Offset + 6]);
+	Channel.EndAddr = 0x10000 - ((m_Memory.Read(Offset + 5) << 8) | m_Memory.Read(Offset + 6));
 
 	/* LFO (3-bit) + Vibrato (3-bit) */
-	Channel.LfoPeriod = YM::GEW8::LfoPeriod[(m_Memory[Offset + 7] >> 3) & 0x07];
-	Channel.PmDepth = m_Memory[Offset + 7] & 0x07;
+	Channel.LfoPeriod = YM::GEW8::LfoPeriod[(m_Memory.Read(Offset + 7) >> 3) & 0x07];
+	Channel.PmDepth = m_Memory.Read(Offset + 7) & 0x07;
 
 	/* Attack rate (4-bit) + Decay rate (4-bit)  */
-	Channel.EgRate[ADSR::Attack] = m_Memory[Offset + 8] >> 4;
-	Channel.EgRate[ADSR::Decay] = m_Memory[Offset + 8] & 0x0F;
+	Channel.EgRate[ADSR::Attack] = m_Memory.Read(Offset + 8) >> 4;
+	Channel.EgRate[ADSR::Decay] = m_Memory.Read(Offset + 8) & 0x0F;
 
 	/* Decay level (4-bit) + Sustain rate (4-bit) */
-	Channel.DecayLvl = m_Memory[Offset + 9] >> 4;
-	Channel.EgRate[ADSR::Sustain] = m_Memory[Offset + 9] & 0x0F;
+	Channel.DecayLvl = m_Memory.Read(Offset + 9) >> 4;
+	Channel.EgRate[ADSR::Sustain] = m_Memory.Read(Offset + 9) & 0x0F;
 	
 	/* If all DL bits are set, DL is -93dB. See OPL4 manual page 20 */
 	Channel.DecayLvl |= (Channel.DecayLvl + 1) & 0x10;
 
 	/* Rate correction (4-bit) + Release rate (4-bit) */
-	Channel.EgRateCorrect = m_Memory[Offset + 10] >> 4;
-	Channel.EgRate[ADSR::Release] = m_Memory[Offset + 10] & 0x0F;
+	Channel.EgRateCorrect = m_Memory.Read(Offset + 10) >> 4;
+	Channel.EgRate[ADSR::Release] = m_Memory.Read(Offset + 10) & 0x0F;
 
 	/* Tremolo (3-bit) */
-	Channel.AmDepth = m_Memory[Offset + 11] & 0x07;
+	Channel.AmDepth = m_Memory.Read(Offset + 11) & 0x07;
 
 	/* Appply banking (Sega MultiPCM only) */
 	if (m_Banking)
@@ -429,61 +450,162 @@ void YMW258F::LoadWaveTable(YM::GEW8::channel_t& Channel)
 			}
 		}
 	}
+
+	SelectAddressGenerator(Channel);
+}
+
+void YMW258F::SelectAddressGenerator(YM::GEW8::channel_t& Channel)
+{
+	auto& Generator = m_AddressGenerator[&Channel - m_Channel];
+
+	/* Bounds checked reads are only needed when the wave can reach past the end of the memory */
+	if (Channel.Format & 0x01) /* 12-bit PCM */
+	{
+		if ((Channel.StartAddr + YM::GEW8::WaveSpan<12>) <= m_Memory.Size())
+			Generator = &YMW258F::UpdateAddressGenerator<12, false>;
+		else
+			Generator = &YMW258F::UpdateAddressGenerator<12, true>;
+	}
+	else /* 8-bit PCM */
+	{
+		if ((Channel.StartAddr + YM::GEW8::WaveSpan<8>) <= m_Memory.Size())
+			Generator = &YMW258F::UpdateAddressGenerator<8, false>;
+		else
+			Generator = &YMW258F::UpdateAddressGenerator<8, true>;
+	}
 }
 
 void YMW258F::Update(uint32_t ClockCycles, std::vector<IAudioBuffer*>& OutBuffer)
+{
+	switch (m_OutputFormat)
+	{
+	case AudioFormat::AUDIO_FMT_S32:
+		RenderSamples<int32_t>(ClockCycles, OutBuffer);
+		break;
+
+	case AudioFormat::AUDIO_FMT_F32:
+		RenderSamples<float>(ClockCycles, OutBuffer);
+		break;
+
+	default:
+		RenderSamples<int16_t>(ClockCycles, OutBuffer);
+		break;
+	}
+}
+
+bool YMW258F::IsSilent()
+{
+	for (auto& Channel : m_Channel) if (!YM::GEW8::IsIdle(Channel)) return false;
+
+	return true;
+}
+
+uint32_t YMW258F::GetCyclesForFrames(uint32_t OutputNr, uint32_t Frames)
+{
+	/* All outputs run at the same rate */
+	return CyclesForFrames(Frames, m_ClockDivider, m_CyclesToDo);
+}
+
+template<typename T>
+void YMW258F::RenderSamples(uint32_t ClockCycles, std::vector<IAudioBuffer*>& OutBuffer)
 {
 	uint32_t TotalCycles = ClockCycles + m_CyclesToDo;
 	uint32_t Samples = TotalCycles / m_ClockDivider;
 	m_CyclesToDo = TotalCycles % m_ClockDivider;
 
+	TC::DeviceStats::UpdateScope Stats(m_Stats, Samples);
+
+	AudioBlock<T> Block(OutBuffer[AudioOut::Default]);
+
+	/* The samples are rendered in blocks, the LDSP processes the DSP send of a block in one call */
+	static constexpr uint32_t DspBlockSize = 64;
+
+	int32_t Accm[DspBlockSize * 2];
+	int16_t DspSample[DspBlockSize * 2];
+
+	while (Samples != 0)
+	{
+		uint32_t Frames = std::min(Samples, DspBlockSize);
+		Samples -= Frames;
+
+		RenderBlock(Accm, DspSample, Frames);
+
+		/* Round trip DSP samples */
+		if (m_LDSP != nullptr) m_LDSP->ProcessChannel0(DspSample, DspSample, Frames);
+
+		for (uint32_t i = 0; i < Frames * 2; i += 2)
+		{
+			/* Limiter (signed 18-bit) */
+			int32_t AccmL = std::clamp(Accm[i + 0] + (DspSample[i + 0] << 2), -131072, 131071);
+			int32_t AccmR = std::clamp(Accm[i + 1] + (DspSample[i + 1] << 2), -131072, 131071);
+
+			/* Note: The accumulator is 18-bit, 16-bit outputs only get the MSB 16-bits */
+			Block.Write(OutputSample<T, 18>(AccmL));
+			Block.Write(OutputSample<T, 18>(AccmR));
+
+			/* DSP Test code */
+			//Block.Write(DspSample[i + 0]);
+			//Block.Write(DspSample[i + 1]);
+		}
+	}
+
+	Stats.ActiveVoices([&] { return std::count_if(std::begin(m_Channel), std::end(m_Channel), [](auto& Channel) { return Channel.KeyState != 0; }); });
+}
+
+void YMW258F::RenderBlock(int32_t* Accm, int16_t* DspSample, uint32_t Frames)
+{
 	int32_t AccmL, AccmR, DspAccmL, DspAccmR;
-	int16_t DspSampleL, DspSampleR;
 
-	while (Samples-- != 0)
+	for (uint32_t n = 0; n < Frames; n++)
 	{
 		AccmL = AccmR = DspAccmL = DspAccmR = 0;
-		DspSampleL = DspSampleR = 0;
 
 		/* Update global timer */
 		m_Timer++;
-		
-		for (auto& Channel : m_Channel)
+		m_EgRates = YM::GetEgRates(YM::GEW8::EgSchedule, m_Timer);
+
+		if (m_VoiceGroups)
 		{
-			UpdateLFO(Channel);
-			UpdateEnvelopeGenerator(Channel);
-			UpdateAddressGenerator(Channel);
-			UpdateMultiplier(Channel);
+			YM::GEW8::SIMD::mix_t Mix;
 
-			AccmL += Channel.OutputL;
-			AccmR += Channel.OutputR;
+			UpdateVoiceGroups(Mix);
 
-			/* Validation needed: is DSP send level correctly applied ?? */
-			DspAccmL += Channel.OutputL >> (16 - (Channel.DspSendLvl << 1));
-			DspAccmR += Channel.OutputR >> (16 - (Channel.DspSendLvl << 1));
+			AccmL = Mix.OutputL;
+			AccmR = Mix.OutputR;
+			DspAccmL = Mix.DspL;
+			DspAccmR = Mix.DspR;
 		}
-
-		if (m_LDSP != nullptr)
+		else
 		{
-			/* Limit DSP accumulator (signed 18 to 16-bit) */
-			DspSampleL = std::clamp(DspAccmL, -131072, 131071) >> 2;
-			DspSampleR = std::clamp(DspAccmR, -131072, 131071) >> 2;
+			for (uint32_t i = 0; i < 28; i++)
+			{
+				auto& Channel = m_Channel[i];
 
-			/* Round trip DSP samples */
-			m_LDSP->ProcessChannel0(&DspSampleL, &DspSampleR);
+				UpdateLFO(Channel);
+
+				/* Idle channels don't contribute to the accumulators */
+				if (YM::GEW8::IsIdle(Channel)) continue;
+
+				UpdateEnvelopeGenerator(Channel);
+				(this->*m_AddressGenerator[i])(Channel);
+				UpdateInterpolator(Channel);
+				UpdateMultiplier(Channel);
+
+				AccmL += Channel.OutputL;
+				AccmR += Channel.OutputR;
+
+				/* Validation needed: is DSP send level correctly applied ?? */
+				DspAccmL += Channel.OutputL >> (16 - (Channel.DspSendLvl << 1));
+				DspAccmR += Channel.OutputR >> (16 - (Channel.DspSendLvl << 1));
+			}
 		}
-		
-		/* Limiter (signed 18-bit) */
-		AccmL = std::clamp(AccmL + (DspSampleL << 2), -131072, 131071);
-		AccmR = std::clamp(AccmR + (DspSampleR << 2), -131072, 131071);
 
-		/* Note: The accumulator is 18-bit, we only output the MSB 16-bits */
-		OutBuffer[AudioOut::Default]->WriteSampleS16(AccmL >> 2);
-		OutBuffer[AudioOut::Default]->WriteSampleS16(AccmR >> 2);
+		Accm[n * 2 + 0] = AccmL;
+		Accm[n * 2 + 1] = AccmR;
 
-		/* DSP Test code */
-		//OutBuffer[AudioOut::Default]->WriteSampleS16(DspSampleL);
-		//OutBuffer[AudioOut::Default]->WriteSampleS16(DspSampleR);
+		/* Limit DSP accumulator (signed 18 to 16-bit), no DSP return without LDSP */
+		DspSample[n * 2 + 0] = (m_LDSP != nullptr) ? std::clamp(DspAccmL, -131072, 131071) >> 2 : 0;
+		DspSample[n * 2 + 1] = (m_LDSP != nullptr) ? std::clamp(DspAccmR, -131072, 131071) >> 2 : 0;
 	}
 }
 
@@ -502,6 +624,7 @@ void YMW258F::UpdateLFO(YM::GEW8::channel_t& Channel)
 	}
 }
 
+template<uint32_t Bits, bool Checked>
 void YMW258F::UpdateAddressGenerator(YM::GEW8::channel_t& Channel)
 {
 	if (Channel.PgReset)
@@ -515,7 +638,7 @@ void YMW258F::UpdateAddressGenerator(YM::GEW8::channel_t& Channel)
 	}
 	
 	/* Vibrato lookup */
-	int32_t Vibrato = YM::GEW8::VibratoTable[Channel.LfoStep >> 2][Channel.PmDepth]; /* 64 steps */
+	int32_t Vibrato = YM::GEW8::GetVibrato(Channel.LfoStep >> 2, Channel.PmDepth); /* 64 steps */
 
 	/* Calculate address increment */
 	uint32_t Inc = ((1024 + Channel.FNum + Vibrato) << (8 + Channel.Octave)) >> 3;
@@ -527,32 +650,18 @@ void YMW258F::UpdateAddressGenerator(YM::GEW8::channel_t& Channel)
 	/* Check for delta overflow */
 	if (Channel.ReadAddr.u16h != OldAddr)
 	{
-		size_t Offset;
-		
 		/* Load new sample */
 		Channel.SampleT0 = Channel.SampleT1;
 
-		switch (Channel.Format)
+		if constexpr (Checked)
 		{
-		case 0:
-		case 2: /* 8-bit PCM */
-			Offset = Channel.StartAddr + OldAddr;
-			Channel.SampleT1 = m_Memory[Offset] << 8;
-			break;
-
-		case 1:
-		case 3: /* 12-bit PCM */
-			Offset = Channel.StartAddr + ((OldAddr / 2) * 3);
+			Channel.SampleT1 = YM::GEW8::FetchSample<Bits>(Channel.StartAddr, OldAddr, [&](uint32_t Offset) { return m_Memory.Read(Offset); });
+		}
+		else
+		{
+			const uint8_t* Memory = m_Memory.Data();
 
-			if (OldAddr & 0x01) /* 2nd sample */
-			{
-				Channel.SampleT1 = (m_Memory[Offset + 2] << 8) | ((m_Memory[Offset + 1] & 0x0F) << 4);
-			}
-			else /* 1st sample */
-			{
-				Channel.SampleT1 = (m_Memory[Offset + 0] << 8) | (m_Memory[Offset + 1] & 0xF0);
-			}
-			break;
+			Channel.SampleT1 = YM::GEW8::FetchSample<Bits>(Channel.StartAddr, OldAddr, [=](uint32_t Offset) { return Memory[Offset]; });
 		}
 
 		/* Check if we reached or exceeded the end address */
@@ -561,7 +670,10 @@ void YMW258F::UpdateAddressGenerator(YM::GEW8::channel_t& Channel)
 			Channel.ReadAddr.u16h -= (Channel.EndAddr - Channel.LoopAddr);
 		}
 	}
+}
 
+void YMW258F::UpdateInterpolator(YM::GEW8::channel_t& Channel)
+{
 	/* Linear sample interpolation */
 	uint32_t T0 = 0x10000 - Channel.ReadAddr.u16l;
 	uint32_t T1 = Channel.ReadAddr.u16l;
@@ -594,6 +706,7 @@ void YMW258F::UpdateEnvelopeGenerator(YM::GEW8::channel_t& Channel)
 		Channel.PgReset = 1;
 		Channel.KeyState = 1;
 		EnvelopeStart = 1;
+		m_Stats.KeyOn();
 		break;
 	}
 
@@ -628,16 +741,12 @@ void YMW258F::UpdateEnvelopeGenerator(YM::GEW8::channel_t& Channel)
 			}
 		}
 
-		/* Get timer resolution */
-		uint32_t Shift = YM::GEW8::EgShift[ActualRate];
-		uint32_t Mask = (1 << Shift) - 1;
-
-		if ((m_Timer & Mask) == 0) /* Timer expired */
+		if ((m_EgRates >> ActualRate) & 1) /* Timer expired */
 		{
 			uint16_t Level = Channel.EgLevel;
 
 			/* Get update cycle (8 cycles in total) */
-			uint32_t Cycle = (m_Timer >> Shift) & 0x07;
+			uint32_t Cycle = (m_Timer >> YM::GEW8::EgShift[ActualRate]) & 0x07;
 
 			/* Lookup attenuation adjustment */
 			uint32_t AttnInc = YM::GEW8::EgLevelAdjust[ActualRate][Cycle];
@@ -700,7 +809,7 @@ void YMW258F::UpdateEnvelopeGenerator(YM::GEW8::channel_t& Channel)
 	uint32_t Attn = Channel.EgLevel + (Channel.TotalLevel << 2);
 
 	/* Apply LFO-AM (tremolo) */
-	Attn += YM::GEW8::TremoloTable[Channel.LfoStep][Channel.AmDepth];
+	Attn += YM::GEW8::GetTremolo(Channel.LfoStep, Channel.AmDepth);
 
 	/* Apply pan, limit and shift from 4.6 to 4.8 */
 	Channel.EgOutputL = std::min(Attn + Channel.PanAttnL, YM::GEW8::MaxAttenuation) << 2;
@@ -721,15 +830,168 @@ void YMW258F::UpdateMultiplier(YM::GEW8::channel_t& Channel)
 	Channel.OutputR = (Channel.Sample * VolumeR) >> 13;
 }
 
+void YMW258F::UpdateVoiceGroups(YM::GEW8::SIMD::mix_t& Mix)
+{
+	uint32_t Active = 0;
+	uint32_t Lanes[28];
+
+	for (uint32_t i = 0; i < 28; i++)
+	{
+		auto& Channel = m_Channel[i];
+		auto& Group = m_VoiceGroup[i / YM::GEW8::SIMD::Lanes];
+		uint32_t Lane = i % YM::GEW8::SIMD::Lanes;
+
+		UpdateLFO(Channel);
+
+		/* Idle channels don't contribute to the accumulators */
+		if (YM::GEW8::IsIdle(Channel))
+		{
+			Group.SampleT0[Lane] = 0;
+			Group.SampleT1[Lane] = 0;
+			continue;
+		}
+
+		Lanes[Active++] = i;
+
+		UpdateEnvelopeGenerator(Channel);
+		(this->*m_AddressGenerator[i])(Channel);
+
+		Group.SampleT0[Lane] = Channel.SampleT0;
+		Group.SampleT1[Lane] = Channel.SampleT1;
+		Group.Fraction[Lane] = Channel.ReadAddr.u16l;
+		Group.AttnL[Lane] = Channel.EgOutputL;
+		Group.AttnR[Lane] = Channel.EgOutputR;
+
+		/* Unvalidated send levels above 8 only keep the sign (see register 0x00) */
+		Group.DspShift[Lane] = (Channel.DspSendLvl <= 8) ? (16 - (Channel.DspSendLvl << 1)) : 31;
+	}
+
+	if (Active == 0)
+	{
+		Mix = {};
+		return;
+	}
+
+	YM::GEW8::SIMD::UpdateMultiplier(m_VoiceGroup, 4, 13, Mix);
+
+	for (uint32_t n = 0; n < Active; n++)
+	{
+		uint32_t i = Lanes[n];
+		auto& Channel = m_Channel[i];
+		auto& Group = m_VoiceGroup[i / YM::GEW8::SIMD::Lanes];
+		uint32_t Lane = i % YM::GEW8::SIMD::Lanes;
+
+		Channel.Sample = (int16_t)Group.Sample[Lane];
+		Channel.OutputL = (int16_t)Group.OutputL[Lane];
+		Channel.OutputR = (int16_t)Group.OutputR[Lane];
+	}
+}
+
 void YMW258F::CopyToMemory(uint32_t MemoryID, size_t Offset, uint8_t* Data, size_t Size)
 {
-	if ((Offset + Size) > m_Memory.size()) return;
+	if (!m_Memory.Upload(Offset, Data, Size)) return;
 
-	memcpy(m_Memory.data() + Offset, Data, Size);
+	m_MemoryPages.Upload(m_Memory.Data(), Offset, Size);
+
+	for (auto& Channel : m_Channel) SelectAddressGenerator(Channel);
 }
 
 void YMW258F::CopyToMemoryIndirect(uint32_t MemoryID, size_t Offset, uint8_t* Data, size_t Size)
 {
 	/* No specialized implementation needed */
 	CopyToMemory(MemoryID, Offset, Data, Size);
+}
+
+bool YMW258F::AttachMemory(uint32_t MemoryID, const uint8_t* Data, size_t Size)
+{
+	/* The attached data is the new baseline */
+	m_Memory.Attach(Data, Size);
+	m_MemoryPages.Clear();
+
+	for (auto& Channel : m_Channel) SelectAddressGenerator(Channel);
+
+	return true;
+}
+
+size_t YMW258F::GetMemorySize(uint32_t MemoryID)
+{
+	return m_Memory.MaxSize();
+}
+
+bool YMW258F::SetMemorySize(uint32_t MemoryID, size_t Size)
+{
+	/* 22-bit address bus */
+	if (!TC::IsPowerOfTwo(Size) || (Size > 0x400000)) return false;
+
+	/* Data beyond the fitted memory reads as open bus, the remaining memory is the new baseline */
+	m_Memory.SetMaxSize(Size);
+	m_MemoryPages.Clear();
+
+	for (auto& Channel : m_Channel) SelectAddressGenerator(Channel);
+
+	return true;
+}
+
+bool YMW258F::RevertMemory()
+{
+	m_MemoryPages.Revert([&](size_t Size) { return (Size <= m_Memory.MaxSize()) ? m_Memory.Reserve(Size) : nullptr; });
+
+	for (auto& Channel : m_Channel) SelectAddressGenerator(Channel);
+
+	return true;
+}
+
+size_t YMW258F::GetResidentSize()
+{
+	/* The LDSP working memory is allocated by the constructor */
+	return m_Memory.GetResidentSize() + m_MemoryPages.GetResidentSize() + ((m_LDSP != nullptr) ? m_LDSP->GetMemorySize() : 0);
+}
+
+void YMW258F::SaveState(StateWriter& State)
+{
+	State.BeginChunk("W258", 2);
+
+	State.Write(m_Channel);
+	State.Write(m_ChannelLatch);
+	State.Write(m_RegisterLatch);
+	State.Write(m_Timer);
+	State.Write(m_MemoryAddress);
+	State.Write(m_DspCommand);
+	State.Write(m_DspCommandCnt);
+	State.Write(m_Banking);
+	State.Write(m_Bank0);
+	State.Write(m_Bank1);
+	State.Write(m_CyclesToDo);
+
+	/* Only the pages written by the device itself */
+	m_MemoryPages.Save(State, m_Memory.Data());
+
+	if (m_LDSP != nullptr) m_LDSP->SaveState(State);
+
+	State.EndChunk();
+}
+
+bool YMW258F::LoadState(StateReader& State)
+{
+	if (!State.BeginChunk("W258", 2)) return false;
+
+	State.Read(m_Channel);
+	State.Read(m_ChannelLatch);
+	State.Read(m_RegisterLatch);
+	State.Read(m_Timer);
+	State.Read(m_MemoryAddress);
+	State.Read(m_DspCommand);
+	State.Read(m_DspCommandCnt);
+	State.Read(m_Banking);
+	State.Read(m_Bank0);
+	State.Read(m_Bank1);
+	State.Read(m_CyclesToDo);
+
+	if (!m_MemoryPages.Load(State, [&](size_t Size) { return (Size <= m_Memory.MaxSize()) ? m_Memory.Reserve(Size) : nullptr; })) return false;
+
+	for (auto& Channel : m_Channel) SelectAddressGenerator(Channel);
+
+	if ((m_LDSP != nullptr) && !m_LDSP->LoadState(State)) return false;
+
+	return State.EndChunk();
 }
\ No newline at end of file
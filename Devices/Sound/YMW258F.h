@@ -16,11 +16,13 @@ See LICENSE.txt in the root directory of this source tree.
 
 #include "../../Interfaces/ISoundDevice.h"
 #include "../../Interfaces/IMemoryAccess.h"
+#include "../../Interfaces/IStateAccess.h"
 #include "YM_GEW.h"
+#include "YM_GEW_SIMD.h"
 #include "DSP/YM3413.h"
 
 /* Yamaha YMW258-F (Advanced Wave Memory) */
-class YMW258F : public ISoundDevice, public IMemoryAccess
+class YMW258F : public ISoundDevice, public IMemoryAccess, public IStateAccess
 {
 public:
 	YMW258F(uint32_t ClockSpeed = 9'400'000, bool HasLDSP = true, size_t MemorySizeLSDP = 0x20000); /* Default clock taken from PSR510 service manual */
@@ -33,23 +35,41 @@ public:
 
 	/* ISoundDevice methods */
 	bool			EnumAudioOutputs(uint32_t OutputNr, AUDIO_OUTPUT_DESC& Desc);
+	bool			SetOutputFormat(uint32_t OutputNr, uint32_t SampleFormat);
 	void			SetClockSpeed(uint32_t ClockSpeed);
 	uint32_t		GetClockSpeed();
 	void			Write(uint32_t Address, uint32_t Data);
 	void			Update(uint32_t ClockCycles, std::vector<IAudioBuffer*>& OutBuffer);
+	bool			IsSilent();
+	uint32_t		GetCyclesForFrames(uint32_t OutputNr, uint32_t Frames);
+	bool			GetStats(TC::StatsSnapshot& Stats);
 
 	/* IMemoryAccess methods */
 	void			CopyToMemory(uint32_t MemoryID, size_t Offset, uint8_t* Data, size_t Size);
 	void			CopyToMemoryIndirect(uint32_t MemoryID, size_t Offset, uint8_t* Data, size_t Size);
+	bool			AttachMemory(uint32_t MemoryID, const uint8_t* Data, size_t Size);
+	size_t			GetMemorySize(uint32_t MemoryID);
+	bool			SetMemorySize(uint32_t MemoryID, size_t Size);
+	bool			RevertMemory();
+	size_t			GetResidentSize();
+
+	/* IStateAccess methods */
+	void			SaveState(StateWriter& State);
+	bool			LoadState(StateReader& State);
 
 private:
 	static const std::wstring s_DeviceName;
 	
+	/* Address generator specialised for a wave format and memory bounds */
+	using address_generator_t = void (YMW258F::*)(YM::GEW8::channel_t& Channel);
+
 	YM::GEW8::channel_t	m_Channel[28];
+	address_generator_t	m_AddressGenerator[28];	/* Selected per channel (not part of the state) */
 
 	uint8_t		m_ChannelLatch;		/* PCM address latch */
 	uint8_t		m_RegisterLatch;	/* PCM register latch */
 	uint32_t	m_Timer;			/* Global timer */
+	uint64_t	m_EgRates;			/* Envelope rates updated at the global timer (not part of the state) */
 	pair32_t	m_MemoryAddress;	/* External memory address (22-bit) */
 	pair32_t	m_DspCommand;		/* DSP command data (32-bit) */
 	uint32_t	m_DspCommandCnt;	/* DSP command counter */
@@ -57,21 +77,34 @@ private:
 	uint32_t	m_ClockSpeed;
 	uint32_t	m_ClockDivider;
 	uint32_t	m_CyclesToDo;
+	uint32_t	m_OutputFormat;		/* Output sample format */
+	bool		m_VoiceGroups;		/* Vectorized voice group updates */
+	TC::DeviceStats	m_Stats;
+
+	YM::GEW8::SIMD::group_t	m_VoiceGroup[4];	/* Voice group work area (28 channels) */
 
 	uint32_t	m_Banking;			/* Banking enable flag */
 	uint32_t	m_Bank0;			/* PCM memory bank 0 */
 	uint32_t	m_Bank1;			/* PCM memory bank 1 */
 
-	std::vector<uint8_t>	m_Memory;
+	SampleMemory			m_Memory;		/* External memory (ROM / SRAM) */
+	PageTracker				m_MemoryPages;	/* Device written memory pages */
 	std::unique_ptr<YM3413>	m_LDSP;
 
+	template<typename T>
+	void	RenderSamples(uint32_t ClockCycles, std::vector<IAudioBuffer*>& OutBuffer);
+	void	RenderBlock(int32_t* Accm, int16_t* DspSample, uint32_t Frames);
 	void	WritePcmData(uint8_t ChannelNr, uint8_t Register, uint8_t Data);
 	void	LoadWaveTable(YM::GEW8::channel_t& Channel);
 	
 	void	UpdateLFO(YM::GEW8::channel_t& Channel);
+	void	SelectAddressGenerator(YM::GEW8::channel_t& Channel);
+	template<uint32_t Bits, bool Checked>
 	void	UpdateAddressGenerator(YM::GEW8::channel_t& Channel);
 	void	UpdateEnvelopeGenerator(YM::GEW8::channel_t& Channel);
+	void	UpdateInterpolator(YM::GEW8::channel_t& Channel);
 	void	UpdateMultiplier(YM::GEW8::channel_t& Channel);
+	void	UpdateVoiceGroups(YM::GEW8::SIMD::mix_t& Mix);
 };
 
 #endif // !_YMW258F_H_
\ No newline at end of file
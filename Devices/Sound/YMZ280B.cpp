@@ -13,6 +13,12 @@ See LICENSE.txt in the root directory of this source tree.
 */
 #include "YMZ280B.h"
 #include "ADPCM.h"
+#include "../../Core/Cpu.h"
+
+#if TC_CPU_X86
+#include <emmintrin.h>
+#define PCMD8_SSE2
+#endif
 
 /*
 	Yamaha YMZ280B (PCMD8) 8-Channel PCM/ADPCM Decoder
@@ -60,10 +66,57 @@ static const uint32_t PanAttnR[16] =
 	0, 0, 0, 0, 0, 0, 0, 0
 };
 
+/* Multiply and accumulate a channel block (16-bit) */
+static void MixChannel(int32_t* pOutL, int32_t* pOutR, const int16_t* pSample, int32_t LevelL, int32_t LevelR, uint32_t Samples)
+{
+	for (uint32_t n = 0; n < Samples; n++)
+	{
+		pOutL[n] += (pSample[n] * LevelL) >> 8;
+		pOutR[n] += (pSample[n] * LevelR) >> 8;
+	}
+}
+
+#if defined(PCMD8_SSE2)
+static void MixChannelSSE2(int32_t* pOutL, int32_t* pOutR, const int16_t* pSample, int32_t LevelL, int32_t LevelR, uint32_t Samples)
+{
+	uint32_t n = Samples & ~7;
+
+	/* The levels are 8-bit, the 16 x 16-bit products are exact */
+	__m128i VolL = _mm_set1_epi16((int16_t)LevelL);
+	__m128i VolR = _mm_set1_epi16((int16_t)LevelR);
+
+	for (uint32_t i = 0; i < n; i += 8)
+	{
+		__m128i Sample = _mm_load_si128((const __m128i*)(pSample + i));
+
+		__m128i Lo = _mm_mullo_epi16(Sample, VolL);
+		__m128i Hi = _mm_mulhi_epi16(Sample, VolL);
+		_mm_store_si128((__m128i*)(pOutL + i + 0), _mm_add_epi32(_mm_load_si128((const __m128i*)(pOutL + i + 0)), _mm_srai_epi32(_mm_unpacklo_epi16(Lo, Hi), 8)));
+		_mm_store_si128((__m128i*)(pOutL + i + 4), _mm_add_epi32(_mm_load_si128((const __m128i*)(pOutL + i + 4)), _mm_srai_epi32(_mm_unpackhi_epi16(Lo, Hi), 8)));
+
+		Lo = _mm_mullo_epi16(Sample, VolR);
+		Hi = _mm_mulhi_epi16(Sample, VolR);
+		_mm_store_si128((__m128i*)(pOutR + i + 0), _mm_add_epi32(_mm_load_si128((const __m128i*)(pOutR + i + 0)), _mm_srai_epi32(_mm_unpacklo_epi16(Lo, Hi), 8)));
+		_mm_store_si128((__m128i*)(pOutR + i + 4), _mm_add_epi32(_mm_load_si128((const __m128i*)(pOutR + i + 4)), _mm_srai_epi32(_mm_unpackhi_epi16(Lo, Hi), 8)));
+	}
+
+	/* Remaining samples */
+	MixChannel(pOutL + n, pOutR + n, pSample + n, LevelL, LevelR, Samples - n);
+}
+#endif
+
 YMZ280B::YMZ280B(uint32_t ClockSpeed) :
 	m_ClockSpeed(ClockSpeed),
-	m_ClockDivider(192)
+	m_ClockDivider(192),
+	m_MemoryMask(0x00FFFFFF)
 {
+	/* Select the mix kernel */
+	auto Kernels = TC::CpuKernels<mix_kernel_t>(MixChannel);
+#if defined(PCMD8_SSE2)
+	Kernels.Add(TC::CpuTier::SSE2, MixChannelSSE2);
+#endif
+	m_MixChannel = Kernels.Select();
+
 	/* Set memory size to 16MB */
 	m_Memory.resize(0x01000000);
 
@@ -97,7 +150,10 @@ void YMZ280B::Reset(ResetType Type)
 	{
 		/* Clear PCM memory */
 		memset(m_Memory.data(), 0, m_Memory.size());
+		m_MemoryPages.Clear();
 	}
+
+	m_Irq.Set(m_IrqEnabled && (m_Status != 0));
 }
 
 void YMZ280B::SendExclusiveCommand(uint32_t Command, uint32_t Value)
@@ -110,7 +166,7 @@ bool YMZ280B::EnumAudioOutputs(uint32_t OutputNr, AUDIO_OUTPUT_DESC& Desc)
 	if (OutputNr == AudioOut::PCMD8)
 	{
 		Desc.SampleRate = m_ClockSpeed / m_ClockDivider;
-		Desc.SampleFormat = 0;
+		Desc.SampleFormat = AudioFormat::AUDIO_FMT_S16;
 		Desc.Channels = 2;
 		Desc.ChannelMask = SPEAKER_FRONT_LEFT | SPEAKER_FRONT_RIGHT;
 		Desc.Description = L"";
@@ -131,13 +187,18 @@ uint32_t YMZ280B::GetClockSpeed()
 	return m_ClockSpeed;
 }
 
+bool YMZ280B::GetStats(TC::StatsSnapshot& Stats)
+{
+	return m_Stats.Get(Stats);
+}
+
 uint32_t YMZ280B::Read(uint32_t Address)
 {
 	if ((Address & 0x01) == 0) /* External memory read mode */
 	{
 		uint8_t Data = 0;
 		
-		if (m_MemEnabled) Data = m_Memory[m_MemAddress.u32];
+		if (m_MemEnabled) Data = m_Memory[m_MemAddress.u32 & m_MemoryMask];
 
 		/* Auto increment RAM address */
 		m_MemAddress.u32 = (m_MemAddress.u32 + 1) & 0x00FFFFFF;
@@ -149,10 +210,8 @@ uint32_t YMZ280B::Read(uint32_t Address)
 		uint8_t Ret = m_Status;
 		m_Status = 0;
 
-		if (m_IrqEnabled)
-		{
-			//TODO: Clear /IRQ line
-		}
+		/* Reading the status clears the /IRQ line */
+		m_Irq.Set(false);
 
 		return Ret;
 	}
@@ -166,6 +225,7 @@ void YMZ280B::Write(uint32_t Address, uint32_t Data)
 	
 	if (Address & 0x01) /* Data write mode (A0 = H) */
 	{
+		m_Stats.RegisterWrite(m_AddressLatch);
 		WriteRegister(m_AddressLatch, Data);
 	}
 	else /* Address write mode (A0 = L) */
@@ -294,7 +354,11 @@ void YMZ280B::WriteRegister(uint8_t Address, uint8_t Data)
 			break;
 
 		case 0x87: /* RAM data */
-			if (m_MemEnabled) m_Memory[m_MemAddress.u32] = Data;
+			if (m_MemEnabled)
+			{
+				m_MemoryPages.Touch(m_Memory.data(), m_Memory.size(), m_MemAddress.u32 & m_MemoryMask);
+				m_Memory[m_MemAddress.u32 & m_MemoryMask] = Data;
+			}
 
 			/* Auto increment RAM address */
 			m_MemAddress.u32 = (m_MemAddress.u32 + 1) & 0x00FFFFFF;
@@ -319,6 +383,8 @@ void YMZ280B::WriteRegister(uint8_t Address, uint8_t Data)
 			break;
 		}
 	}
+
+	m_Irq.Set(m_IrqEnabled && (m_Status != 0));
 }
 
 void YMZ280B::Update(uint32_t ClockCycles, std::vector<IAudioBuffer*>& OutBuffer)
@@ -327,108 +393,30 @@ void YMZ280B::Update(uint32_t ClockCycles, std::vector<IAudioBuffer*>& OutBuffer
 	uint32_t Samples = TotalCycles / m_ClockDivider;
 	m_CyclesToDo = TotalCycles % m_ClockDivider;
 
-	int32_t OutL;
-	int32_t OutR;
+	TC::DeviceStats::UpdateScope Stats(m_Stats, Samples);
+
+	AudioBlock<int16_t> Block(OutBuffer[AudioOut::PCMD8]);
 
-	while (Samples-- != 0)
+	alignas(16) int16_t Sample[BlockSize];
+	alignas(16) int32_t OutL[BlockSize];
+	alignas(16) int32_t OutR[BlockSize];
+
+	while (Samples != 0)
 	{
-		OutL = 0;
-		OutR = 0;
-		
-		for (auto i = 0; i < 8; i++)
+		/* Registers don't change within an update, so the channels can be rendered one after another */
+		uint32_t Count = std::min(Samples, BlockSize);
+
+		memset(OutL, 0, sizeof(OutL));
+		memset(OutR, 0, sizeof(OutR));
+
+		for (uint32_t i = 0; i < 8; i++)
 		{
 			auto& Channel = m_Channel[i];
 
 			if (Channel.KeyOn)
 			{
-				/* Update "pitch" generator (10-bit: 1.9) */
-				if (Channel.Mode == 1)
-					Channel.PitchCnt += Channel.Pitch.u8l + 1; /* 44.1kHz playback limit for ADPCM streams */
-				else
-					Channel.PitchCnt += Channel.Pitch.u16 + 1;
-
-				/* Check for "pitch" overflow (10-bit: 1.9) */
-				if (Channel.PitchCnt & 0x0200)
-				{
-					/* Remove integer part, keep fractional part */
-					Channel.PitchCnt &= 0x01FF;
-
-					/* Save previous sample */
-					Channel.SampleT0 = Channel.SampleT1;
-
-					/* Load new sample, update address counter */
-					switch (Channel.Mode)
-					{
-						case 0x00: /* Invalid format */
-							Channel.KeyOn = 0;
-							break;
-
-						case 0x01: /* 4-bit ADPCM format */
-							if (m_MemEnabled)
-							{
-								/* Load nibble from memory */
-								uint8_t Nibble = (m_Memory[Channel.Addr] >> Channel.NibbleShift) & 0x0F;
-
-								/* Decode ADPCM nibble */
-								YM::ADPCMZ::Decode(Nibble, &Channel.Step, &Channel.Signal);
-							}
-
-							/* Alternate between 1st and 2nd nibble */
-							Channel.NibbleShift ^= 4;
-
-							Channel.SampleT1 = Channel.Signal;
-							Channel.Addr += (Channel.NibbleShift >> 2);
-
-							/* Check if we reached loop start address */
-							if ((Channel.Addr == Channel.LoopStart.u32) && (Channel.NibbleShift != 0))
-							{
-								/* Save decoder state */
-								Channel.LoopSignal = Channel.Signal;
-								Channel.LoopStep = Channel.Step;
-							}
-							break;
-
-						case 0x02: /* 8-bit PCM format */
-							if (m_MemEnabled) Channel.SampleT1 = m_Memory[Channel.Addr] << 8;
-							Channel.Addr += 1;
-							break;
-
-						case 0x03: /* 16-bit PCM format */
-							if (m_MemEnabled) Channel.SampleT1 = (m_Memory[Channel.Addr + 0] << 8) | m_Memory[Channel.Addr + 1];
-							Channel.Addr += 2;
-							break;
-					}
-
-					if (Channel.Loop) /* Check for loop end address */
-					{
-						if (Channel.Addr >= Channel.LoopEnd.u32)
-						{
-							/* Reload loop start address */
-							Channel.Addr = Channel.LoopStart.u32;
-
-							/* Reload decoder state */
-							Channel.Signal = Channel.LoopSignal;
-							Channel.Step = Channel.LoopStep;
-						}
-					}
-					else /* Check for end address */
-					{
-						if (Channel.Addr >= Channel.End.u32)
-						{
-							/* Auto key off channel */
-							Channel.KeyOn = 0;
-
-							/* Set status flag */
-							m_Status |= (m_IrqMask & (1 << i));
-							//TODO: Asset IRQ line
-						}
-					}
-				}
-
-				/* Linear sample interpolation */
-				uint32_t T0 = 0x200 - Channel.PitchCnt;
-				uint32_t T1 = Channel.PitchCnt;
-				int16_t Sample = ((T0 * Channel.SampleT0) + (T1 * Channel.SampleT1)) >> 9;
+				/* Interpolated channel output */
+				RenderChannel(i, Sample, Count);
 
 				/* DSP voice data output */
 				//TODO: At this point channel data can be send to the external YSS225 DSP
@@ -438,18 +426,207 @@ void YMZ280B::Update(uint32_t ClockCycles, std::vector<IAudioBuffer*>& OutBuffer
 				int32_t LevelR = std::max<int32_t>(Channel.TotalLevel - Channel.PanAttnR, 0);
 
 				/* Multiply and accumulate (16-bit) */
-				OutL += (Sample * LevelL) >> 8;
-				OutR += (Sample * LevelR) >> 8;
+				m_MixChannel(OutL, OutR, Sample, LevelL, LevelR, Count);
+			}
+		}
+
+		for (uint32_t n = 0; n < Count; n++)
+		{
+			/* Limiter (signed 16-bit), 16-bit DAC output (interleaved) */
+			Block.Write(std::clamp(OutL[n], -32768, 32767));
+			Block.Write(std::clamp(OutR[n], -32768, 32767));
+		}
+
+		Samples -= Count;
+	}
+
+	Stats.ActiveVoices([&] { return std::count_if(std::begin(m_Channel), std::end(m_Channel), [](auto& Channel) { return Channel.KeyOn != 0; }); });
+
+	/* Sample end flags raise the /IRQ line */
+	m_Irq.Set(m_IrqEnabled && (m_Status != 0));
+}
+
+uint32_t YMZ280B::GetCyclesForFrames(uint32_t OutputNr, uint32_t Frames)
+{
+	/* All outputs run at the same rate */
+	return CyclesForFrames(Frames, m_ClockDivider, m_CyclesToDo);
+}
+
+uint32_t YMZ280B::GetCyclesToNextEvent()
+{
+	/* Samples until the first non-looping channel with an enabled status flag reaches its end address */
+	uint64_t Samples = UINT64_MAX;
+
+	for (uint32_t i = 0; i < 8; i++)
+	{
+		auto& Channel = m_Channel[i];
+
+		if (!Channel.KeyOn || Channel.Loop || (Channel.Mode == 0) || ((m_IrqMask & (1 << i)) == 0)) continue;
+
+		/* Sample fetches (pitch counter overflows) up to the end address, a channel at or past its
+		   end address keys off on the next fetch */
+		uint64_t Fetches = 1;
+
+		if (Channel.End.u32 > Channel.Addr)
+		{
+			uint64_t Distance = Channel.End.u32 - Channel.Addr;
+
+			switch (Channel.Mode)
+			{
+			case 0x01: /* 4-bit ADPCM, the address advances on every other nibble */
+				Fetches = (Distance * 2) - ((Channel.NibbleShift == 0) ? 1 : 0);
+				break;
+
+			case 0x02: /* 8-bit PCM */
+				Fetches = Distance;
+				break;
+
+			default: /* 16-bit PCM */
+				Fetches = (Distance + 1) / 2;
+				break;
 			}
 		}
 
-		/* Limiter (signed 16-bit) */
-		OutL = std::clamp(OutL, -32768, 32767);
-		OutR = std::clamp(OutR, -32768, 32767);
+		uint32_t Increment = ((Channel.Mode == 1) ? Channel.Pitch.u8l : Channel.Pitch.u16) + 1;
+
+		Samples = std::min(Samples, ((Fetches * 0x200) - Channel.PitchCnt + Increment - 1) / Increment);
+	}
+
+	if (Samples == UINT64_MAX) return 0;
+
+	return CyclesForFrames((uint32_t)std::min<uint64_t>(Samples, UINT32_MAX), m_ClockDivider, m_CyclesToDo);
+}
+
+bool YMZ280B::IsSilent()
+{
+	/* Channels stop playing at key off */
+	for (auto& Channel : m_Channel) if (Channel.KeyOn != 0) return false;
+
+	return true;
+}
+
+bool YMZ280B::SetIrqCallback(TC::IrqCallback Callback)
+{
+	m_Irq.SetCallback(std::move(Callback));
+
+	return true;
+}
+
+void YMZ280B::RenderChannel(uint32_t Index, int16_t* pSample, uint32_t Samples)
+{
+	auto& Channel = m_Channel[Index];
+
+	/* "Pitch" increment, 44.1kHz playback limit for ADPCM streams */
+	uint32_t Increment = ((Channel.Mode == 1) ? Channel.Pitch.u8l : Channel.Pitch.u16) + 1;
+
+	uint32_t n = 0;
+
+	while ((n < Samples) && Channel.KeyOn)
+	{
+		/* The samples up to the next "pitch" overflow only interpolate between T0 and T1 */
+		uint32_t Run = std::min((0x1FF - Channel.PitchCnt) / Increment, Samples - n);
+
+		int32_t T0 = Channel.SampleT0;
+		int32_t T1 = Channel.SampleT1;
+
+		for (; Run != 0; Run--)
+		{
+			Channel.PitchCnt += Increment;
+
+			/* Linear sample interpolation */
+			pSample[n++] = ((T0 * (int32_t)(0x200 - Channel.PitchCnt)) + (T1 * (int32_t)Channel.PitchCnt)) >> 9;
+		}
+
+		if (n == Samples) break;
+
+		/* Update "pitch" generator (10-bit: 1.9), this overflows */
+		Channel.PitchCnt += Increment;
+
+		UpdateSample(Index);
+
+		/* Linear sample interpolation */
+		pSample[n++] = ((Channel.SampleT0 * (int32_t)(0x200 - Channel.PitchCnt)) + (Channel.SampleT1 * (int32_t)Channel.PitchCnt)) >> 9;
+	}
+
+	/* Channel was keyed off */
+	for (; n < Samples; n++) pSample[n] = 0;
+}
+
+void YMZ280B::UpdateSample(uint32_t Index)
+{
+	auto& Channel = m_Channel[Index];
+
+	/* Remove integer part, keep fractional part */
+	Channel.PitchCnt &= 0x01FF;
+
+	/* Save previous sample */
+	Channel.SampleT0 = Channel.SampleT1;
+
+	/* Load new sample, update address counter */
+	switch (Channel.Mode)
+	{
+		case 0x00: /* Invalid format */
+			Channel.KeyOn = 0;
+			break;
+
+		case 0x01: /* 4-bit ADPCM format */
+			if (m_MemEnabled)
+			{
+				/* Load nibble from memory */
+				uint8_t Nibble = (m_Memory[Channel.Addr & m_MemoryMask] >> Channel.NibbleShift) & 0x0F;
+
+				/* Decode ADPCM nibble */
+				YM::ADPCMZ::Decode(Nibble, &Channel.Step, &Channel.Signal);
+			}
+
+			/* Alternate between 1st and 2nd nibble */
+			Channel.NibbleShift ^= 4;
+
+			Channel.SampleT1 = Channel.Signal;
+			Channel.Addr += (Channel.NibbleShift >> 2);
+
+			/* Check if we reached loop start address */
+			if ((Channel.Addr == Channel.LoopStart.u32) && (Channel.NibbleShift != 0))
+			{
+				/* Save decoder state */
+				Channel.LoopSignal = Channel.Signal;
+				Channel.LoopStep = Channel.Step;
+			}
+			break;
+
+		case 0x02: /* 8-bit PCM format */
+			if (m_MemEnabled) Channel.SampleT1 = m_Memory[Channel.Addr & m_MemoryMask] << 8;
+			Channel.Addr += 1;
+			break;
+
+		case 0x03: /* 16-bit PCM format */
+			if (m_MemEnabled) Channel.SampleT1 = (m_Memory[(Channel.Addr + 0) & m_MemoryMask] << 8) | m_Memory[(Channel.Addr + 1) & m_MemoryMask];
+			Channel.Addr += 2;
+			break;
+	}
+
+	if (Channel.Loop) /* Check for loop end address */
+	{
+		if (Channel.Addr >= Channel.LoopEnd.u32)
+		{
+			/* Reload loop start address */
+			Channel.Addr = Channel.LoopStart.u32;
+
+			/* Reload decoder state */
+			Channel.Signal = Channel.LoopSignal;
+			Channel.Step = Channel.LoopStep;
+		}
+	}
+	else /* Check for end address */
+	{
+		if (Channel.Addr >= Channel.End.u32)
+		{
+			/* Auto key off channel */
+			Channel.KeyOn = 0;
 
-		/* 16-bit DAC output (interleaved) */
-		OutBuffer[AudioOut::PCMD8]->WriteSampleS16(OutL);
-		OutBuffer[AudioOut::PCMD8]->WriteSampleS16(OutR);
+			/* Set status flag, the /IRQ line is set at the end of the update */
+			m_Status |= (m_IrqMask & (1 << Index));
+		}
 	}
 }
 
@@ -483,6 +660,8 @@ void YMZ280B::ProcessKeyOnOff(pcmd8_t& Channel, uint32_t NewState)
 			Channel.LoopSignal = 0;
 			Channel.LoopStep = 127;
 			Channel.NibbleShift = 4;
+
+			m_Stats.KeyOn();
 		}
 
 		Channel.KeyOn = NewState;
@@ -494,10 +673,87 @@ void YMZ280B::CopyToMemory(uint32_t MemoryID, size_t Offset, uint8_t* Data, size
 	if ((Offset + Size) > m_Memory.size()) return;
 
 	memcpy(m_Memory.data() + Offset, Data, Size);
+	m_MemoryPages.Upload(m_Memory.data(), Offset, Size);
 }
 
 void YMZ280B::CopyToMemoryIndirect(uint32_t MemoryID, size_t Offset, uint8_t* Data, size_t Size)
 {
 	/* No specialized implementation needed */
 	CopyToMemory(MemoryID, Offset, Data, Size);
+}
+
+size_t YMZ280B::GetMemorySize(uint32_t MemoryID)
+{
+	return m_Memory.size();
+}
+
+bool YMZ280B::SetMemorySize(uint32_t MemoryID, size_t Size)
+{
+	/* 24-bit address bus */
+	if (!TC::IsPowerOfTwo(Size) || (Size > 0x01000000)) return false;
+
+	/* Unused address lines mirror the fitted memory, the remaining memory is the new baseline */
+	m_Memory.resize(Size);
+	m_Memory.shrink_to_fit();
+	m_MemoryMask = (uint32_t)(Size - 1);
+	m_MemoryPages.Clear();
+
+	return true;
+}
+
+bool YMZ280B::RevertMemory()
+{
+	m_MemoryPages.Revert(m_Memory.data(), m_Memory.size());
+
+	return true;
+}
+
+size_t YMZ280B::GetResidentSize()
+{
+	return m_Memory.capacity() + m_MemoryPages.GetResidentSize();
+}
+
+void YMZ280B::SaveState(StateWriter& State)
+{
+	State.BeginChunk("Z280", 1);
+
+	State.Write(m_Channel);
+	State.Write(m_AddressLatch);
+	State.Write(m_Status);
+	State.Write(m_IrqMask);
+	State.Write(m_MemAddress);
+	State.Write(m_KeyEnabled);
+	State.Write(m_MemEnabled);
+	State.Write(m_IrqEnabled);
+	State.Write(m_DspEnabled);
+	State.Write(m_LsiTest);
+	State.Write(m_CyclesToDo);
+
+	/* Only the pages written by the device itself */
+	m_MemoryPages.Save(State, m_Memory.data());
+
+	State.EndChunk();
+}
+
+bool YMZ280B::LoadState(StateReader& State)
+{
+	if (!State.BeginChunk("Z280", 1)) return false;
+
+	State.Read(m_Channel);
+	State.Read(m_AddressLatch);
+	State.Read(m_Status);
+	State.Read(m_IrqMask);
+	State.Read(m_MemAddress);
+	State.Read(m_KeyEnabled);
+	State.Read(m_MemEnabled);
+	State.Read(m_IrqEnabled);
+	State.Read(m_DspEnabled);
+	State.Read(m_LsiTest);
+	State.Read(m_CyclesToDo);
+
+	if (!m_MemoryPages.Load(State, m_Memory.data(), m_Memory.size())) return false;
+
+	m_Irq.Set(m_IrqEnabled && (m_Status != 0));
+
+	return State.EndChunk();
 }
\ No newline at end of file
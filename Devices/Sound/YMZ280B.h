@@ -16,9 +16,10 @@ See LICENSE.txt in the root directory of this source tree.
 
 #include "../../Interfaces/ISoundDevice.h"
 #include "../../Interfaces/IMemoryAccess.h"
+#include "../../Interfaces/IStateAccess.h"
 
 /* Yamaha YMZ280B 8-channel ADPCM/PCM decoder (PCMD8) */
-class YMZ280B : public ISoundDevice, public IMemoryAccess
+class YMZ280B : public ISoundDevice, public IMemoryAccess, public IStateAccess
 {
 public:
 	YMZ280B(uint32_t ClockSpeed = 16'934'400);
@@ -36,12 +37,30 @@ public:
 	uint32_t		Read(uint32_t Address);
 	void			Write(uint32_t Address, uint32_t Data);
 	void			Update(uint32_t ClockCycles, std::vector<IAudioBuffer*>& OutBuffer);
+	uint32_t		GetCyclesForFrames(uint32_t OutputNr, uint32_t Frames);
+	uint32_t		GetCyclesToNextEvent();
+	bool			IsSilent();
+	bool			SetIrqCallback(TC::IrqCallback Callback);
+	bool			GetStats(TC::StatsSnapshot& Stats);
 
 	/* IMemoryAccess methods */
 	void			CopyToMemory(uint32_t MemoryID, size_t Offset, uint8_t* Data, size_t Size);
 	void			CopyToMemoryIndirect(uint32_t MemoryID, size_t Offset, uint8_t* Data, size_t Size);
+	size_t			GetMemorySize(uint32_t MemoryID);
+	bool			SetMemorySize(uint32_t MemoryID, size_t Size);
+	bool			RevertMemory();
+	size_t			GetResidentSize();
+
+	/* IStateAccess methods */
+	void			SaveState(StateWriter& State);
+	bool			LoadState(StateReader& State);
 
 private:
+	static constexpr uint32_t BlockSize = 64; /* Samples rendered per block */
+
+	/* Multiply and accumulate kernel of a channel block */
+	using mix_kernel_t = void (*)(int32_t* pOutL, int32_t* pOutR, const int16_t* pSample, int32_t LevelL, int32_t LevelR, uint32_t Samples);
+
 	struct pcmd8_t
 	{
 		pair16_t Pitch;			/* Frequency number (9-bit) */
@@ -84,11 +103,18 @@ private:
 	uint32_t	m_ClockSpeed;
 	uint32_t	m_ClockDivider;
 	uint32_t	m_CyclesToDo;
+	TC::DeviceStats	m_Stats;
+	TC::IrqLine		m_Irq;		/* Interrupt output (not part of the state) */
 
 	std::vector<uint8_t> m_Memory;
+	uint32_t m_MemoryMask; /* Fitted memory (smaller memories are mirrored) */
+	PageTracker m_MemoryPages; /* Device written memory pages */
+	mix_kernel_t m_MixChannel; /* Selected for the host CPU (not part of the state) */
 
 	void	WriteRegister(uint8_t Address, uint8_t Data);
 	void	ProcessKeyOnOff(pcmd8_t& Channel, uint32_t NewState);
+	void	RenderChannel(uint32_t Index, int16_t* pSample, uint32_t Samples);
+	void	UpdateSample(uint32_t Index);
 };
 
 #endif // !_YMZ280B_H_
\ No newline at end of file
@@ -33,6 +33,9 @@ void YMZ284::Reset(ResetType Type)
 {
 	m_CyclesToDo = 0;
 
+	/* Clear the band-limited output history */
+	m_SynthSSG.Clear();
+
 	/* Reset tone generators */
 	for (auto& Tone : m_Tone)
 	{
@@ -62,8 +65,8 @@ bool YMZ284::EnumAudioOutputs(uint32_t OutputNr, AUDIO_OUTPUT_DESC& Desc)
 {
 	if (OutputNr == 0)
 	{
-		Desc.SampleRate = m_ClockSpeed / m_ClockDivider;
-		Desc.SampleFormat = 0;
+		Desc.SampleRate = m_SynthSSG.GetSampleRate(m_ClockSpeed / m_ClockDivider);
+		Desc.SampleFormat = AudioFormat::AUDIO_FMT_S16;
 		Desc.Channels = 1;
 		Desc.ChannelMask = SPEAKER_FRONT_CENTER;
 		Desc.Description = L"Sound Out";
@@ -83,11 +86,27 @@ uint32_t YMZ284::GetClockSpeed()
 	return m_ClockSpeed;
 }
 
+bool YMZ284::GetStats(TC::StatsSnapshot& Stats)
+{
+	return m_Stats.Get(Stats);
+}
+
+bool YMZ284::SetOutputRate(uint32_t OutputNr, uint32_t SampleRate)
+{
+	if (OutputNr != 0) return false;
+
+	m_SynthSSG.SetRates(m_ClockSpeed / m_ClockDivider, SampleRate);
+
+	return true;
+}
+
 void YMZ284::Write(uint32_t Address, uint32_t Data)
 {
 	Address &= 0x0F;
 	Data &= AY::Mask[Address]; /* Mask unused bits */
 
+	m_Stats.RegisterWrite(Address);
+
 	switch (Address)
 	{
 	case 0x00: /* Channel A Tone Period (Fine Tune) */
@@ -194,6 +213,13 @@ void YMZ284::Update(uint32_t ClockCycles, std::vector<IAudioBuffer*>& OutBuffer)
 	uint32_t Samples = TotalCycles / m_ClockDivider;
 	m_CyclesToDo = TotalCycles % m_ClockDivider;
 
+	TC::DeviceStats::UpdateScope Stats(m_Stats, Samples);
+
+	AudioBlock<int16_t> Block(OutBuffer[0]);
+
+	/* Follow clock and prescaler changes */
+	m_SynthSSG.SetInputRate(m_ClockSpeed / m_ClockDivider);
+
 	int16_t Out;
 	uint32_t Mask;
 
@@ -267,6 +293,48 @@ void YMZ284::Update(uint32_t ClockCycles, std::vector<IAudioBuffer*>& OutBuffer)
 		}
 
 		/* 16-bit output */
-		OutBuffer[0]->WriteSampleS16(Out);
+		m_SynthSSG.Write(Out, Block);
 	}
+
+	/* Output the completed band-limited samples */
+	m_SynthSSG.Flush(Block);
+
+	Stats.ActiveVoices([&] { return AY::ActiveTones(m_Tone); });
+}
+
+bool YMZ284::IsSilent()
+{
+	return AY::ActiveTones(m_Tone) == 0;
+}
+
+uint32_t YMZ284::GetCyclesForFrames(uint32_t OutputNr, uint32_t Frames)
+{
+	/* Band-limited outputs are rendered at the output rate */
+	if ((OutputNr != 0) || m_SynthSSG.IsEnabled()) return 0;
+
+	return CyclesForFrames(Frames, m_ClockDivider, m_CyclesToDo);
+}
+
+void YMZ284::SaveState(StateWriter& State)
+{
+	State.BeginChunk("Z284", 1);
+
+	State.Write(m_Tone);
+	State.Write(m_Noise);
+	State.Write(m_Envelope);
+	State.Write(m_CyclesToDo);
+
+	State.EndChunk();
+}
+
+bool YMZ284::LoadState(StateReader& State)
+{
+	if (!State.BeginChunk("Z284", 1)) return false;
+
+	State.Read(m_Tone);
+	State.Read(m_Noise);
+	State.Read(m_Envelope);
+	State.Read(m_CyclesToDo);
+
+	return State.EndChunk();
 }
\ No newline at end of file
@@ -15,10 +15,12 @@ See LICENSE.txt in the root directory of this source tree.
 #define _YMZ284_H_
 
 #include "../../Interfaces/ISoundDevice.h"
+#include "../../Interfaces/IStateAccess.h"
 #include "AY.h"
+#include "../../Core/BandLimited.h"
 
 /* Yamaha YMZ284 (SSGL) */
-class YMZ284 : public ISoundDevice
+class YMZ284 : public ISoundDevice, public IStateAccess
 {
 public:
 	YMZ284(uint32_t ClockSpeed = 4'000'000);
@@ -35,6 +37,14 @@ public:
 	uint32_t		GetClockSpeed();
 	void			Write(uint32_t Address, uint32_t Data);
 	void			Update(uint32_t ClockCycles, std::vector<IAudioBuffer*>& OutBuffer);
+	bool			IsSilent();
+	uint32_t		GetCyclesForFrames(uint32_t OutputNr, uint32_t Frames);
+	bool			GetStats(TC::StatsSnapshot& Stats);
+	bool			SetOutputRate(uint32_t OutputNr, uint32_t SampleRate);
+
+	/* IStateAccess methods */
+	void			SaveState(StateWriter& State);
+	bool			LoadState(StateReader& State);
 
 private:
 	AY::tone_t		m_Tone[3];
@@ -44,6 +54,9 @@ private:
 	uint32_t	m_ClockSpeed;
 	uint32_t	m_ClockDivider;
 	uint32_t	m_CyclesToDo;
+	TC::DeviceStats	m_Stats;
+
+	TC::BandLimitedSynth m_SynthSSG; /* SSG output rate synthesis (not part of the state) */
 };
 
 #endif // !_YMZ284_H_
\ No newline at end of file
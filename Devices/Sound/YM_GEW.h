@@ -24,62 +24,57 @@ namespace YM::GEW8 /* Yamaha - GEW8 */
 	/* Maximum envelope level */
 	constexpr uint32_t MaxEgLevel = MaxAttenuation & ~((1 << 4) - 1);
 
-	/* Channel data type */
+	/* Channel data type
+	   The per-sample state comes first, followed by the register state. Fields are packed to their width */
 	struct channel_t
 	{
-		uint32_t	KeyState;		/* Key on/off state */
-		uint32_t	KeyLatch;		/* Latched key on/off flag */
-		
-		uint32_t	DspSendLvl;		/* DSP send level (4-bit) */
-		
-		pair16_t	WaveNr;			/* Wave table number (9-bit) */
-		uint32_t	Format;			/* Wave format (2-bit) */
-
-		uint32_t	FNum;			/* Frequency number (10-bit) */
-		uint32_t	FNum9;			/* Copy of FNum bit 9 */
-		int32_t		Octave;			/* Octave (signed 4-bit) */
-		
-		uint32_t	TotalLevel;		/* Total level (7-bit: 3.4) */
-		uint32_t	DecayLvl;		/* Decay level (5-bit: 4.1) */
-		uint32_t	TargetTL;		/* Interpolated TL */
-		uint32_t	PanAttnL;		/* Pan attenuation left */
-		uint32_t	PanAttnR;		/* Pan attenuation right */
-
-		uint32_t	EgPhase;		/* Envelope phase */
-		uint32_t	EgRate[4];		/* Envelope rates (4-bit) */
-		uint32_t	EgRateCorrect;	/* Rate correction (4-bit) */
-		uint32_t	EgLevel;		/* Envelope internal level (10-bit: 4.6) */
-		uint32_t	EgOutputL;		/* Envelope output (left)  (12-bit: 4.8) */
-		uint32_t	EgOutputR;		/* Envelope output (right) (12-bit: 4.8) */
-		uint32_t	EgUnknown;		/* Unknown EG related flag */
-
-		uint32_t	PgReset;		/* Phase reset flag */
-
+		/* Address generator + interpolator */
 		pair32_t	ReadAddr;		/* Read address (32-bit: 16.16) */
 		uint32_t	StartAddr;		/* Start address (22-bit) */
 		uint16_t	LoopAddr;		/* Loop address (16-bit) */
 		uint16_t	EndAddr;		/* End address (16-bit) */
-
-		uint32_t	LfoHold;		/* LFO hold flag */
-		uint32_t	LfoCounter;		/* LFO counter */
-		uint32_t	LfoPeriod;		/* LFO period */
-		uint8_t		LfoStep;		/* LFO step counter (8-bit) */
-		uint32_t	PmDepth;		/* Vibrato depth (3-bit) */
-		uint32_t	AmDepth;		/* Tremolo depth (3-bit) */
-
+		uint16_t	FNum;			/* Frequency number (10-bit) */
 		int16_t		SampleT0;		/* Sample interpolation T0 */
 		int16_t		SampleT1;		/* Sample interpolation T1 */
 		int16_t		Sample;			/* Interpolated sample */
 		int16_t		OutputL;		/* Channel output (left) */
 		int16_t		OutputR;		/* Channel output (right) */
-	};
+		int8_t		Octave;			/* Octave (signed 4-bit) */
+		uint8_t		FNum9;			/* Copy of FNum bit 9 */
+		uint8_t		PgReset;		/* Phase reset flag */
+
+		/* Envelope generator + multiplier */
+		uint16_t	EgLevel;		/* Envelope internal level (10-bit: 4.6) */
+		uint16_t	EgOutputL;		/* Envelope output (left)  (12-bit: 4.8) */
+		uint16_t	EgOutputR;		/* Envelope output (right) (12-bit: 4.8) */
+		uint16_t	PanAttnL;		/* Pan attenuation left */
+		uint16_t	PanAttnR;		/* Pan attenuation right */
+		uint8_t		EgPhase;		/* Envelope phase */
+		uint8_t		EgRate[4];		/* Envelope rates (4-bit) */
+		uint8_t		EgRateCorrect;	/* Rate correction (4-bit) */
+		uint8_t		DecayLvl;		/* Decay level (5-bit: 4.1) */
+		uint8_t		TotalLevel;		/* Total level (7-bit: 3.4) */
+		uint8_t		TargetTL;		/* Interpolated TL */
+		uint8_t		KeyState;		/* Key on/off state */
+		uint8_t		KeyLatch;		/* Latched key on/off flag */
+		uint8_t		DspSendLvl;		/* DSP send level (4-bit) */
+
+		/* LFO */
+		uint16_t	LfoCounter;		/* LFO counter */
+		uint16_t	LfoPeriod;		/* LFO period */
+		uint8_t		LfoStep;		/* LFO step counter (8-bit) */
+		uint8_t		LfoHold;		/* LFO hold flag */
+		uint8_t		PmDepth;		/* Vibrato depth (3-bit) */
+		uint8_t		AmDepth;		/* Tremolo depth (3-bit) */
 
-	static uint16_t ExpTable[256];
-	static uint32_t TremoloTable[256][8];
-	static  int32_t VibratoTable[64][8];
+		/* Register state */
+		pair16_t	WaveNr;			/* Wave table number (9-bit) */
+		uint8_t		Format;			/* Wave format (2-bit) */
+		uint8_t		EgUnknown;		/* Unknown EG related flag */
+	};
 
 	/* Pan attenuation (left) table */
-	static const uint32_t PanAttnL[16] =
+	inline constexpr uint32_t PanAttnL[16] =
 	{
 		/* See OPL4 datasheet page 22 (section PANPOT)
 
@@ -94,7 +89,7 @@ namespace YM::GEW8 /* Yamaha - GEW8 */
 	};
 
 	/* Pan attenuation (right) table */
-	static const uint32_t PanAttnR[16] =
+	inline constexpr uint32_t PanAttnR[16] =
 	{
 		/* See OPL4 datasheet page 22 (section PANPOT)
 
@@ -109,7 +104,7 @@ namespace YM::GEW8 /* Yamaha - GEW8 */
 	};
 
 	/* LFO period table */
-	static const uint32_t LfoPeriod[8] =
+	inline constexpr uint32_t LfoPeriod[8] =
 	{
 		/*
 			This table defines the period (in samples) of a given frequency
@@ -133,7 +128,7 @@ namespace YM::GEW8 /* Yamaha - GEW8 */
 	};
 
 	/* LFO AM (tremolo) depth table */
-	static const uint32_t LfoAmDepth[8] =
+	inline constexpr uint32_t LfoAmDepth[8] =
 	{
 		/*
 			This table is used to calculate the LFO AM (tremolo) attenuation adjustment
@@ -167,7 +162,7 @@ namespace YM::GEW8 /* Yamaha - GEW8 */
 	};
 
 	/* LFO PM (vibrato) depth table */
-	static const uint32_t LfoPmDepth[8] =
+	inline constexpr uint32_t LfoPmDepth[8] =
 	{
 		/*
 			This table is used to calculate the LFO PM (vibrato) frequency adjustment
@@ -209,7 +204,7 @@ namespace YM::GEW8 /* Yamaha - GEW8 */
 	};
 
 	/* Envelope counter shift table */
-	static const uint32_t EgShift[64] =
+	inline constexpr uint32_t EgShift[64] =
 	{
 		12, 12, 12, 12,
 		11, 11, 11, 11,
@@ -229,8 +224,11 @@ namespace YM::GEW8 /* Yamaha - GEW8 */
 		0,  0,  0,  0
 	};
 
+	/* Envelope rate schedule (see GenerateEgSchedule) */
+	inline constexpr eg_schedule_t EgSchedule = GenerateEgSchedule(EgShift);
+
 	/* Envelope generator level adjust table */
-	static const uint32_t EgLevelAdjust[64][8] =
+	inline constexpr uint32_t EgLevelAdjust[64][8] =
 	{
 		/* EG timing calculations: https://github.com/michelgerritse/YM-research */
 		{0,0,0,0,0,0,0,0}, {0,0,0,0,0,0,0,0}, {0,0,0,0,0,0,0,0}, {0,0,0,0,0,0,0,0}, /* Rate 00 - 03 */
@@ -254,60 +252,144 @@ namespace YM::GEW8 /* Yamaha - GEW8 */
 		{4,4,4,4,4,4,4,4}, {4,4,4,4,4,4,4,4}, {4,4,4,4,4,4,4,4}, {4,4,4,4,4,4,4,4}  /* Rate 60 - 63 */
 	};
 
-	/* Build all GEW8 related tables */
-	static void BuildTables()
+	/* Exponent table */
+	inline constexpr auto ExpTable = []
 	{
-		static bool Initialized = false;
+		std::array<uint16_t, 256> Table{};
 
-		if (!Initialized)
+		/*
+			Build exponent table:
+			1. Reverse the original table
+			2. Set the implicit bit10
+			3. Shift left by 2
+		*/
+		for (uint32_t i = 0; i < 256; i++)
 		{
-			/*
-				Build exponent table:
-				1. Reverse the original table
-				2. Set the implicit bit10
-				3. Shift left by 2
-			*/
-			for (uint32_t i = 0; i < 256; i++)
+			Table[i] = (YM::GenerateExponent(i ^ 0xFF) | 0x400) << 2;
+		}
+
+		return Table;
+	}();
+
+	/* Tremolo table (AM, 1st half of the waveform) */
+	inline constexpr auto TremoloTable = []
+	{
+		std::array<std::array<uint8_t, 8>, 128> Table{};
+
+		for (auto step = 0; step < 128; step++)
+		{
+			/* Triangular shaped wave (0x00 .. 0x7F, 0x7F .. 0x00) of 256 steps,
+			   the 2nd half mirrors the 1st one (see GetTremolo) */
+
+			//TODO: is this an inverted triangle (like OPN) ?
+			//		eg. starting at maximum amplitude
+			//		Als need to confirm on the step increment (which is 2 for OPN)
+
+			for (auto ams = 0; ams < 8; ams++)
 			{
-				ExpTable[i] = (YM::GenerateExponent(i ^ 0xFF) | 0x400) << 2;
+				Table[step][ams] = (step * LfoAmDepth[ams]) >> 7;
 			}
+		}
 
-			/* Tremolo table (AM) */
-			for (auto lfo = 0; lfo < 256; lfo++)
+		return Table;
+	}();
+
+	/* Vibrato table (PM, 1st quarter of the waveform) */
+	inline constexpr auto VibratoTable = []
+	{
+		std::array<std::array<uint8_t, 8>, 16> Table{};
+
+		for (auto step = 0; step < 16; step++)
+		{
+			/* Triangular shaped wave (0x0 .. 0xF, 0xF .. 0x0) of 64 steps (32 pos, 32 neg),
+			   the 2nd quarter mirrors the 1st one and the 2nd half is negated (see GetVibrato) */
+			for (auto pms = 0; pms < 8; pms++)
 			{
-				uint32_t step = lfo; /* 256 steps */
+				Table[step][pms] = (step * LfoPmDepth[pms]) >> 4;
+			}
+		}
 
-				/* Create triangular shaped wave (0x00 .. 0x7F, 0x7F .. 0x00) */
-				if (step & 0x80) step ^= 0xFF;
+		return Table;
+	}();
 
-				//TODO: is this an inverted triangle (like OPN) ?
-				//		eg. starting at maximum amplitude
-				//		Als need to confirm on the step increment (which is 2 for OPN)
+	/* Tremolo attenuation adjustment, Step = LFO step (8-bit) */
+	constexpr uint32_t GetTremolo(uint32_t Step, uint32_t Depth)
+	{
+		/* Mirror the 2nd half */
+		uint32_t Index = Step & 0x7F;
+		if (Step & 0x80) Index ^= 0x7F;
 
-				for (auto ams = 0; ams < 8; ams++)
-				{
-					TremoloTable[lfo][ams] = (step * LfoAmDepth[ams]) >> 7;
-				}
-			}
+		return TremoloTable[Index][Depth];
+	}
 
-			/* Vibrato table (PM) */
-			for (auto lfo = 0; lfo < 64; lfo++)
-			{
-				uint32_t step = lfo; /* 64 steps (32 pos, 32 neg) */
+	/* Vibrato frequency adjustment, Step = LFO-PM step (6-bit) */
+	constexpr int32_t GetVibrato(uint32_t Step, uint32_t Depth)
+	{
+		/* Mirror the 2nd quarter */
+		uint32_t Index = Step & 0x0F;
+		if (Step & 0x10) Index ^= 0x0F;
 
-				/* Create triangular shaped wave (0x0 .. 0xF, 0xF .. 0x0) */
-				if (step & 0x10) step ^= 0x1F;
+		int32_t Value = VibratoTable[Index][Depth];
 
-				for (auto pms = 0; pms < 8; pms++)
-				{
-					int32_t value = ((step & 0x0F) * LfoPmDepth[pms]) >> 4;
+		/* Negate the 2nd half */
+		return (Step & 0x20) ? -Value : Value;
+	}
 
-					VibratoTable[lfo][pms] = (lfo & 0x20) ? -value : value;
-				}
-			}
+	/* Byte offset of a sample number (relative to the start address) */
+	template<uint32_t Bits>
+	constexpr uint32_t SampleOffset(uint32_t SampleNr)
+	{
+		if constexpr (Bits == 12) return (SampleNr / 2) * 3;
+		else return SampleNr * (Bits / 8);
+	}
 
-			Initialized = true;
+	/* Memory span of a wave, reads of any 16-bit sample number stay within this range */
+	template<uint32_t Bits>
+	constexpr uint32_t WaveSpan = SampleOffset<Bits>(0xFFFF) + ((Bits == 12) ? 3 : (Bits / 8));
+
+	/* Fetch a sample for a given format (0 = invalid format), Read(Offset) returns a memory byte.
+	   The format is a template parameter so a channel can select its fetch path once when the
+	   wave table is loaded, instead of deciding the format for every sample */
+	template<uint32_t Bits, typename F>
+	inline int16_t FetchSample(uint32_t Start, uint32_t SampleNr, F&& Read)
+	{
+		uint32_t Offset = Start + SampleOffset<Bits>(SampleNr);
+
+		if constexpr (Bits == 8) /* 8-bit PCM */
+		{
+			return (int16_t)(Read(Offset) << 8);
 		}
+		else if constexpr (Bits == 12) /* 12-bit PCM */
+		{
+			if (SampleNr & 0x01) /* 2nd sample */
+			{
+				return (int16_t)((Read(Offset + 2) << 8) | ((Read(Offset + 1) & 0x0F) << 4));
+			}
+			else /* 1st sample */
+			{
+				return (int16_t)((Read(Offset + 0) << 8) | (Read(Offset + 1) & 0xF0));
+			}
+		}
+		else if constexpr (Bits == 16) /* 16-bit PCM */
+		{
+			return (int16_t)((Read(Offset + 0) << 8) | Read(Offset + 1));
+		}
+		else /* Invalid format */
+		{
+			return 0;
+		}
+	}
+
+	/* A channel is idle when it is keyed off, fully released and silent. Envelope, address and
+	   multiplier updates leave its output unchanged (the address counter is reset on key on)
+	   so only the LFO has to keep running */
+	inline bool IsIdle(const channel_t& Channel)
+	{
+		if ((Channel.KeyState | Channel.KeyLatch | Channel.PgReset) != 0) return false;
+		if ((Channel.EgLevel != MaxAttenuation) || (Channel.TotalLevel != Channel.TargetTL)) return false;
+		if ((Channel.EgOutputL != (MaxAttenuation << 2)) || (Channel.EgOutputR != (MaxAttenuation << 2))) return false;
+
+		return (Channel.OutputL | Channel.OutputR) == 0;
 	}
 }
 #endif // !_YM_GEW_H_
\ No newline at end of file
@@ -0,0 +1,118 @@
+/*
+ _____    _ _            ___
+|_   _| _(_) |_ ___ _ _ / __|___ _ _ ___
+  | || '_| |  _/ _ \ ' \ (__/ _ \ '_/ -_)
+  |_||_| |_|\__\___/_||_\___\___/_| \___|
+
+Copyright  2024, Michel Gerritse
+All rights reserved.
+
+This source code is available under the BSD-3-Clause license.
+See LICENSE.txt in the root directory of this source tree.
+
+*/
+#include "YM_GEW_SIMD.h"
+#include "../../Core/Cpu.h"
+
+#if TC_GEW_SIMD && TC_CPU_X86
+#include <immintrin.h>
+#define GEW_SIMD_AVX2
+#endif
+
+/*
+	Vectorized GEW8 voice groups
+
+	Bit exact with the scalar interpolator and multiplier of the GEW8 cores.
+	The exponent table lookup needs gathers and the exponent shift needs per lane
+	shift counts, both of which are only available from AVX2 onwards. Without AVX2
+	the devices keep using their scalar path (IsSupported returns false).
+*/
+namespace YM::GEW8::SIMD
+{
+#if defined(GEW_SIMD_AVX2)
+	/* 32-bit copy of the 16-bit table (gathers load 32-bit elements) */
+	alignas(32) static constexpr auto ExpTable32 = []
+	{
+		std::array<int32_t, 256> Table{};
+
+		for (uint32_t i = 0; i < 256; i++) Table[i] = ExpTable[i];
+
+		return Table;
+	}();
+
+	static inline TC_TARGET_AVX2 int32_t HorizontalSum(__m256i Value)
+	{
+		__m128i Sum = _mm_add_epi32(_mm256_castsi256_si128(Value), _mm256_extracti128_si256(Value, 1));
+
+		Sum = _mm_add_epi32(Sum, _mm_shuffle_epi32(Sum, _MM_SHUFFLE(1, 0, 3, 2)));
+		Sum = _mm_add_epi32(Sum, _mm_shuffle_epi32(Sum, _MM_SHUFFLE(2, 3, 0, 1)));
+
+		return _mm_cvtsi128_si32(Sum);
+	}
+
+	bool IsSupported()
+	{
+		return TC::IsSupported(TC::CpuTier::AVX2);
+	}
+
+	TC_TARGET_AVX2 void UpdateMultiplier(group_t* Groups, uint32_t Count, uint32_t Shift, mix_t& Mix)
+	{
+		const __m128i MulShift = _mm_cvtsi32_si128(Shift);
+		const __m256i One = _mm256_set1_epi32(0x10000);
+		const __m256i IndexMask = _mm256_set1_epi32(0xFF);
+
+		__m256i AccmL = _mm256_setzero_si256();
+		__m256i AccmR = _mm256_setzero_si256();
+		__m256i DspL = _mm256_setzero_si256();
+		__m256i DspR = _mm256_setzero_si256();
+
+		for (uint32_t i = 0; i < Count; i++)
+		{
+			auto& Group = Groups[i];
+
+			__m256i T0 = _mm256_load_si256((const __m256i*)Group.SampleT0);
+			__m256i T1 = _mm256_load_si256((const __m256i*)Group.SampleT1);
+			__m256i Fraction = _mm256_load_si256((const __m256i*)Group.Fraction);
+			__m256i AttnL = _mm256_load_si256((const __m256i*)Group.AttnL);
+			__m256i AttnR = _mm256_load_si256((const __m256i*)Group.AttnR);
+			__m256i DspShift = _mm256_load_si256((const __m256i*)Group.DspShift);
+
+			/* Linear sample interpolation (the weighted sum fits 32-bit) */
+			__m256i Sample = _mm256_add_epi32(_mm256_mullo_epi32(T0, _mm256_sub_epi32(One, Fraction)), _mm256_mullo_epi32(T1, Fraction));
+			Sample = _mm256_srai_epi32(Sample, 16);
+
+			/* dB to linear conversion (13-bit) */
+			__m256i VolumeL = _mm256_srlv_epi32(_mm256_i32gather_epi32(ExpTable32.data(), _mm256_and_si256(AttnL, IndexMask), 4), _mm256_srli_epi32(AttnL, 8));
+			__m256i VolumeR = _mm256_srlv_epi32(_mm256_i32gather_epi32(ExpTable32.data(), _mm256_and_si256(AttnR, IndexMask), 4), _mm256_srli_epi32(AttnR, 8));
+
+			/* Multiply with interpolated sample (16-bit) */
+			__m256i OutputL = _mm256_sra_epi32(_mm256_mullo_epi32(Sample, VolumeL), MulShift);
+			__m256i OutputR = _mm256_sra_epi32(_mm256_mullo_epi32(Sample, VolumeR), MulShift);
+
+			_mm256_store_si256((__m256i*)Group.Sample, Sample);
+			_mm256_store_si256((__m256i*)Group.OutputL, OutputL);
+			_mm256_store_si256((__m256i*)Group.OutputR, OutputR);
+
+			/* Mix */
+			AccmL = _mm256_add_epi32(AccmL, OutputL);
+			AccmR = _mm256_add_epi32(AccmR, OutputR);
+			DspL = _mm256_add_epi32(DspL, _mm256_srav_epi32(OutputL, DspShift));
+			DspR = _mm256_add_epi32(DspR, _mm256_srav_epi32(OutputR, DspShift));
+		}
+
+		Mix.OutputL = HorizontalSum(AccmL);
+		Mix.OutputR = HorizontalSum(AccmR);
+		Mix.DspL = HorizontalSum(DspL);
+		Mix.DspR = HorizontalSum(DspR);
+	}
+#else
+	bool IsSupported()
+	{
+		return false;
+	}
+
+	void UpdateMultiplier(group_t* Groups, uint32_t Count, uint32_t Shift, mix_t& Mix)
+	{
+	}
+#endif
+}
\ No newline at end of file
@@ -0,0 +1,73 @@
+/*
+ _____    _ _            ___
+|_   _| _(_) |_ ___ _ _ / __|___ _ _ ___
+  | || '_| |  _/ _ \ ' \ (__/ _ \ '_/ -_)
+  |_||_| |_|\__\___/_||_\___\___/_| \___|
+
+Copyright  2024, Michel Gerritse
+All rights reserved.
+
+This source code is available under the BSD-3-Clause license.
+See LICENSE.txt in the root directory of this source tree.
+
+*/
+#ifndef _YM_GEW_SIMD_H_
+#define _YM_GEW_SIMD_H_
+
+#include "../../TritonCore.h"
+#include "YM_GEW.h"
+
+/* Vectorized voice groups are compiled out unless TC_GEW_SIMD is set to 1
+   Note: the scalar voice loop is currently as fast (YMF278B) or faster (YMW258F), the
+   group packing and write back cost as much as the vectorized multiplier saves */
+#ifndef TC_GEW_SIMD
+#define TC_GEW_SIMD 0
+#endif
+
+namespace YM::GEW8::SIMD
+{
+	/* Number of lanes in a voice group */
+	constexpr uint32_t Lanes = 8;
+
+	/* Voice group, structure of arrays
+
+	The LFO, envelope and address generators of a voice stay scalar (they branch on key events,
+	envelope phases and loop points). Their results are gathered into a group, after which the
+	interpolator and multiplier of all voices are evaluated side by side and mixed.
+	Unused or idle lanes must hold a silent sample (T0 = T1 = 0).
+	*/
+	struct alignas(32) group_t
+	{
+		/* Interpolator input */
+		int32_t		SampleT0[Lanes];	/* Sample interpolation T0 */
+		int32_t		SampleT1[Lanes];	/* Sample interpolation T1 */
+		uint32_t	Fraction[Lanes];	/* Sample address (fractional, 16-bit) */
+
+		/* Multiplier input */
+		uint32_t	AttnL[Lanes];		/* Attenuation left  (12-bit: 4.8) */
+		uint32_t	AttnR[Lanes];		/* Attenuation right (12-bit: 4.8) */
+		uint32_t	DspShift[Lanes];	/* DSP send level shift */
+
+		/* Multiplier output */
+		int32_t		Sample[Lanes];		/* Interpolated sample */
+		int32_t		OutputL[Lanes];		/* Voice output (left) */
+		int32_t		OutputR[Lanes];		/* Voice output (right) */
+	};
+
+	/* Mixed output of the voice groups */
+	struct mix_t
+	{
+		int32_t		OutputL;			/* Output accumulator (left) */
+		int32_t		OutputR;			/* Output accumulator (right) */
+		int32_t		DspL;				/* DSP send accumulator (left) */
+		int32_t		DspR;				/* DSP send accumulator (right) */
+	};
+
+	/* Returns true if the host CPU can run the vectorized voice groups (AVX2) */
+	bool IsSupported();
+
+	/* Interpolate, attenuate and mix voice groups (Shift: multiplier output shift) */
+	void UpdateMultiplier(group_t* Groups, uint32_t Count, uint32_t Shift, mix_t& Mix);
+}
+
+#endif // !_YM_GEW_SIMD_H_
\ No newline at end of file
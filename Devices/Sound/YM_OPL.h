@@ -83,6 +83,8 @@ namespace YM::OPL /* Yamaha - FM Operator Type-L */
 
 		uint32_t	EgPhase;		/* Envelope phase */
 		uint32_t	EgRate[4];		/* Envelope rates (4-bit) */
+		uint32_t	EgScaledRate[4];/* Key scaled envelope rates (6-bit), cached until the rates or key code change */
+		uint32_t	EgHold;			/* Envelope level holds until the next phase transition */
 		uint32_t	EgLevel;		/* Envelope internal level (9-bit: 4.5) */
 		uint32_t	EgOutput;		/* Envelope output (12-bit: 4.8) */
 
@@ -90,8 +92,8 @@ namespace YM::OPL /* Yamaha - FM Operator Type-L */
 		uint32_t	PgOutput;		/* Phase output (10-bit) */
 		uint32_t	PgReset;		/* Phase reset flag */
 
-		uint16_t*	WaveTable;		/* Wave table pointer */
-		uint16_t	WaveSign;		/* Wave sign mask */
+		const uint16_t*	WaveTable;	/* Wave table pointer */
+		uint16_t	WaveSign;		/* Wave sign pattern (bit n = phase quarter n is negative) */
 
 		int16_t		Output[2];		/* Operator output (14-bit) */
 	};
@@ -105,23 +107,27 @@ namespace YM::OPL /* Yamaha - FM Operator Type-L */
 		uint32_t	KeyCode;		/* Key code (4-bit) */
 		uint32_t	Algo;			/* Algorithm (1-bit) */
 		uint32_t	FB;				/* Feedback (3-bit) */
+		uint32_t	PanL;			/* Left output on/off mask (OPL3) */
+		uint32_t	PanR;			/* Right output on/off mask (OPL3) */
 	};
 
 	/* Timer data type */
 	struct timer_t
 	{
 		uint32_t	Start;			/* Start / stop state */
-		uint32_t	Mask;			/* Overflow flag mask */
 		uint32_t	Period;			/* Period */
 		uint32_t	Counter;		/* Counter */
 	};
 
-	static uint16_t ExpTable[256];
-	static uint16_t WaveTable[4][1024];
-	
-	static const uint16_t WaveSign[8] =
+	/* Wave sign patterns, indexed by the wave select */
+	inline constexpr uint16_t WaveSign[8] =
 	{
-		0x200, 0, 0, 0, 0x200, 0, 0x200, 0x200
+		/*
+			Bit n is set when phase quarter n (phase bits 9 and 8) gives a negative output:
+			- Sine, square and log-saw: 2nd half
+			- Alternating sine: the 2nd quarter (the negative half of the double speed sine)
+		*/
+		0b1100, 0, 0, 0, 0b0010, 0, 0b1100, 0b1100
 	};
 
 	consteval uint32_t KSL(uint32_t Fnum, uint32_t Block)
@@ -136,7 +142,7 @@ namespace YM::OPL /* Yamaha - FM Operator Type-L */
 	};
 
 	/* Key scale level table */
-	static const uint32_t KeyScaleLevel[16][8] =
+	inline constexpr uint32_t KeyScaleLevel[16][8] =
 	{
 		{ KSL( 0,0), KSL( 0,1), KSL( 0,2), KSL( 0,3), KSL( 0,4), KSL( 0,5), KSL( 0,6), KSL( 0,7) },
 		{ KSL( 1,0), KSL( 1,1), KSL( 1,2), KSL( 1,3), KSL( 1,4), KSL( 1,5), KSL( 1,6), KSL( 1,7) },
@@ -157,7 +163,7 @@ namespace YM::OPL /* Yamaha - FM Operator Type-L */
 	};
 
 	/* Key scale shift table */
-	static const uint32_t KeyScaleShift[4] =
+	inline constexpr uint32_t KeyScaleShift[4] =
 	{
 		8, /* No damping  */
 		1, /* 3.0dB / oct */
@@ -168,13 +174,13 @@ namespace YM::OPL /* Yamaha - FM Operator Type-L */
 	};
 
 	/* Multiplication table */
-	static const uint32_t Multiply[16] =
+	inline constexpr uint32_t Multiply[16] =
 	{
 		1, 2, 4, 6, 8, 10, 12, 14, 16, 18, 20, 20, 24, 24, 30, 30
 	};
 
 	/* Envelope counter shift table */
-	static const uint32_t EgShift[64] =
+	inline constexpr uint32_t EgShift[64] =
 	{
 		12, 12, 12, 12,
 		11, 11, 11, 11,
@@ -194,8 +200,11 @@ namespace YM::OPL /* Yamaha - FM Operator Type-L */
 		0,  0,  0,  0
 	};
 
+	/* Envelope rate schedule (see GenerateEgSchedule) */
+	inline constexpr eg_schedule_t EgSchedule = GenerateEgSchedule(EgShift);
+
 	/* Envelope generator level adjust table */
-	static const uint32_t EgLevelAdjust[64][8] =
+	inline constexpr uint32_t EgLevelAdjust[64][8] =
 	{
 		/* EG timing calculations: https://github.com/michelgerritse/YM-research */
 		{0,0,0,0,0,0,0,0}, {0,0,0,0,0,0,0,0}, {0,0,0,0,0,0,0,0}, {0,0,0,0,0,0,0,0}, /* Rate 00 - 03 */
@@ -220,7 +229,7 @@ namespace YM::OPL /* Yamaha - FM Operator Type-L */
 	};
 
 	/* Rhythm phase input */
-	static const uint32_t PhaseIn[32] =
+	inline constexpr uint32_t PhaseIn[32] =
 	{
 		/*
 			Input:
@@ -241,7 +250,7 @@ namespace YM::OPL /* Yamaha - FM Operator Type-L */
 	};
 
 	/* Snare drum phase output */
-	static const uint32_t PhaseOutSD[4] =
+	inline constexpr uint32_t PhaseOutSD[4] =
 	{
 		/*
 			Input:
@@ -259,7 +268,7 @@ namespace YM::OPL /* Yamaha - FM Operator Type-L */
 	};
 
 	/* High hat phase output */
-	static const uint32_t PhaseOutHH[4] =
+	inline constexpr uint32_t PhaseOutHH[4] =
 	{
 		/*
 			Input:
@@ -276,55 +285,85 @@ namespace YM::OPL /* Yamaha - FM Operator Type-L */
 		0x2D0
 	};
 
-	/* Build all OPL related tables */
-	static void BuildTables()
+	/* Wave tables */
+	inline constexpr auto WaveTable = []
 	{
-		static bool Initialized = false;
+		std::array<std::array<uint16_t, 1024>, 8> Table{};
 
-		if (!Initialized)
+		for (uint32_t i = 0; i < 1024; i++)
 		{
-			/*
-				Build wave tables
-			*/
-			for (uint32_t i = 0; i < 1024; i++)
-			{
-				auto Zero = 0x1000;
-
-				/* Wave 0: Sine */
-				if ((i & 0x100) == 0)
-					WaveTable[0][i] = YM::GenerateSine(i & 0xFF, 256); /* 1st quarter */
-				else
-					WaveTable[0][i] = YM::GenerateSine((i & 0xFF) ^ 0xFF, 256); /* 2nd quarter */
-
-				/* Wave 1: Half-sine */
-				if ((i & 0x200) == 0)
-					WaveTable[1][i] = WaveTable[0][i]; /* 1st half */
-				else
-					WaveTable[1][i] = Zero; /* 2nd half */
-
-				/* Wave 2: Absolute-sine */
-				WaveTable[2][i] = WaveTable[0][i];
-
-				/* Wave 3: Quarter-sine */
-				if ((i & 0x100) == 0)
-					WaveTable[3][i] = WaveTable[0][i]; /* 1st quarter */
-				else
-					WaveTable[3][i] = Zero; /* 2nd quarter */
-			}
-
-			/*
-				Build exponent table:
-				1. Reverse the original table
-				2. Set the implicit bit10
-				3. Shift left by 1
-			*/
-			for (uint32_t i = 0; i < 256; i++)
-			{
-				ExpTable[i] = (YM::GenerateExponent(i ^ 0xFF) | 0x400) << 1;
-			}
-
-			Initialized = true;
+			auto Zero = 0x1000;
+
+			/* Wave 0: Sine */
+			if ((i & 0x100) == 0)
+				Table[0][i] = YM::GenerateSine(i & 0xFF); /* 1st quarter */
+			else
+				Table[0][i] = YM::GenerateSine((i & 0xFF) ^ 0xFF); /* 2nd quarter */
+
+			/* Wave 1: Half-sine */
+			if ((i & 0x200) == 0)
+				Table[1][i] = Table[0][i]; /* 1st half */
+			else
+				Table[1][i] = Zero; /* 2nd half */
+
+			/* Wave 2: Absolute-sine */
+			Table[2][i] = Table[0][i];
+
+			/* Wave 3: Quarter-sine */
+			if ((i & 0x100) == 0)
+				Table[3][i] = Table[0][i]; /* 1st quarter */
+			else
+				Table[3][i] = Zero; /* 2nd quarter */
+
+			/* Wave 4: Alternating sine (OPL3) */
+			if ((i & 0x200) == 0)
+				Table[4][i] = YM::GenerateSine((i & 0x80) ? (((i ^ 0xFF) << 1) & 0xFF) : ((i << 1) & 0xFF)); /* 1st half, double speed */
+			else
+				Table[4][i] = Zero; /* 2nd half */
+
+			/* Wave 5: Camel sine (OPL3) */
+			Table[5][i] = Table[4][i];
+
+			/* Wave 6: Square (OPL3) */
+			Table[6][i] = 0;
+
+			/* Wave 7: Logarithmic sawtooth (OPL3) */
+			if ((i & 0x200) == 0)
+				Table[7][i] = (i & 0x1FF) << 3; /* 1st half */
+			else
+				Table[7][i] = ((i & 0x1FF) ^ 0x1FF) << 3; /* 2nd half */
 		}
+
+		return Table;
+	}();
+
+	/* Exponent table */
+	inline constexpr auto ExpTable = []
+	{
+		std::array<uint16_t, 256> Table{};
+
+		/*
+			Build exponent table:
+			1. Reverse the original table
+			2. Set the implicit bit10
+			3. Shift left by 1
+		*/
+		for (uint32_t i = 0; i < 256; i++)
+		{
+			Table[i] = (YM::GenerateExponent(i ^ 0xFF) | 0x400) << 1;
+		}
+
+		return Table;
+	}();
+
+	/* A slot is released when it is keyed off (without pending key events) and its envelope
+	   reached maximum attenuation, the envelope update leaves a released slot unchanged.
+	   Note: the operator output of a silent slot still depends on its phase */
+	inline bool IsReleased(const operator_t& Slot, const channel_t& Chan)
+	{
+		if ((Slot.KeyState | Slot.CsmLatch | Slot.DrumLatch | Slot.PgReset | Chan.KeyLatch) != 0) return false;
+
+		return (Slot.EgLevel == MaxAttenuation) && (Slot.EgOutput == (MaxAttenuation << 3));
 	}
 }
 #endif // !_YM_OPL_H_
\ No newline at end of file
@@ -0,0 +1,1225 @@
+/*
+ _____    _ _            ___
+|_   _| _(_) |_ ___ _ _ / __|___ _ _ ___
+  | || '_| |  _/ _ \ ' \ (__/ _ \ '_/ -_)
+  |_||_| |_|\__\___/_||_\___\___/_| \___|
+
+Copyright  2024, Michel Gerritse
+All rights reserved.
+
+This source code is available under the BSD-3-Clause license.
+See LICENSE.txt in the root directory of this source tree.
+
+*/
+#ifndef _YM_OPL_ENGINE_H_
+#define _YM_OPL_ENGINE_H_
+
+#include "../../TritonCore.h"
+#include "YM_OPL.h"
+
+namespace YM::OPL
+{
+	/* Slot naming */
+	enum SlotName : uint32_t
+	{
+		S1 = 0,	/* Modulator */
+		S2		/* Carrier   */
+	};
+
+	/* Channel naming */
+	enum ChannelName : uint32_t
+	{
+		CH1 = 0, CH2, CH3, CH4, CH5, CH6, CH7, CH8, CH9
+	};
+
+	/* Envelope phases */
+	enum ADSR : uint32_t
+	{
+		Attack = 0,
+		Decay,
+		Sustain,
+		Release
+	};
+
+	/* Drum instruments */
+	enum Rhythm : uint32_t
+	{
+		BD1 = 12,	/* Bass drum 1 (CH7 - S1) */
+		BD2 = 13,	/* Bass drum 2 (CH7 - S2) */
+		HH  = 14,	/* High hat    (CH8 - S1) */
+		SD  = 15,	/* Snare drum  (CH8 - S2) */
+		TOM = 16,	/* Tom tom     (CH9 - S1) */
+		CYM = 17	/* Top cymbal  (CH9 - S2) */
+	};
+
+	/* Status register bits */
+	constexpr uint8_t FlagBRDY   = 0x08;	/* ADPCM-B bus ready */
+	constexpr uint8_t FlagEOS    = 0x10;	/* ADPCM-B end of sample */
+	constexpr uint8_t FlagTimer2 = 0x20;	/* Timer 2 overflow */
+	constexpr uint8_t FlagTimer1 = 0x40;	/* Timer 1 overflow */
+	constexpr uint8_t FlagIRQ    = 0x80;	/* Interrupt request */
+
+	/* FM unit of the OPL family (timers, LFO, noise, slots and the channel accumulator)
+
+	The devices own the register decoding of their other units (ADPCM-B, I/O ports)
+	and the final mix. The configuration is fixed at compile time:
+
+	- HasWaveSelect:	Wave select registers (0xE0 - 0xF5), enabled through the LSI test register
+	- HasADPCM:			The ADPCM-B flags (EOS, BRDY) take part in the flag mask and IRQ logic
+	- IsOPL3:			Second register array (18 channels, 36 slots), 4-operator channels, 8 waves
+						and stereo output. The device decodes the connection select (0x104) and
+						the NEW flag (0x105), the engine has no CSM mode
+
+	All data is plain, except for the wave table pointers which the devices
+	have to restore when loading a state
+	*/
+	template<
+		bool HasWaveSelect,
+		bool HasADPCM,
+		bool IsOPL3 = false
+	>
+	class Engine
+	{
+	public:
+		/* Status flags that can raise an IRQ */
+		static constexpr uint8_t IrqFlags = FlagTimer1 | FlagTimer2 | (HasADPCM ? (FlagEOS | FlagBRDY) : 0);
+
+		/* Channels and slots of all register arrays */
+		static constexpr uint32_t Channels = IsOPL3 ? 18 : 9;
+		static constexpr uint32_t Slots = Channels * 2;
+
+		YM::OPL::operator_t	Slot[Slots];
+		YM::OPL::channel_t	Channel[Channels];
+		YM::OPL::timer_t	Timer1;
+		YM::OPL::timer_t	Timer2;
+
+		uint32_t	Timer;			/* Global timer (13-bit) */
+		uint64_t	EgRates;		/* Envelope rates updated at the global timer (bit n = rate n) */
+		uint32_t	CSM;			/* CSM mode on/off flag */
+		uint32_t	NTS;			/* Note select flag */
+		uint32_t	RHY;			/* Rhythm mode on/off flag */
+		uint8_t		Status;			/* Status register (8-bit) */
+		uint8_t		StatusMask;		/* Status flag mask (8-bit) */
+		int32_t		Out;			/* Accumulator output */
+		int32_t		OutL;			/* Accumulator output left (OPL3) */
+		int32_t		OutR;			/* Accumulator output right (OPL3) */
+
+		uint32_t	NEW;			/* OPL3 mode flag */
+		uint32_t	FourOp;			/* 4-operator connection select (6-bit) */
+
+		uint32_t	LfoAmStep;		/* Current LFO-AM step */
+		uint32_t	LfoAmShift;		/* LFO-AM depth selector */
+		uint32_t	LfoAmLevel;		/* LFO-AM attn. level */
+
+		uint32_t	LfoPmStep;		/* Current LFO-PM step */
+		uint32_t	LfoPmShift;		/* LFO-PM depth selector */
+
+		uint32_t	WaveSelectEnable; /* Wave select enable flag */
+
+		uint32_t	NoiseLFSR;		/* Noise shift register (23-bit) */
+		uint32_t	NoiseOut;		/* Noise output (1-bit) */
+
+		uint8_t		PhaseHH8;		/* High hat phase bit (b8) */
+		uint8_t		PhaseHH;		/* High hat phase bits (b7, b3, b2) */
+		uint8_t		PhaseTC;		/* Top cymbal phase bits (b5, b3) */
+
+		uint32_t	LsiTest2;		/* LSI test bit 2 */
+
+		/* Reset to the power on state, the device sets up its flag mask defaults */
+		void Reset()
+		{
+			memset(this, 0, sizeof(*this));
+
+			LfoAmShift = 4; /* 1.0dB */
+			LfoPmShift = 1; /* 7 cents */
+
+			NoiseLFSR = 1 << 22;
+
+			/* A rate of 0 is never updated */
+			EgRates = YM::GetEgRates(YM::OPL::EgSchedule, Timer) & ~1ull;
+
+			/* All flags are unmasked */
+			SetStatusMask(0);
+
+			/* Default operator register state */
+			for (auto& Op : Slot)
+			{
+				Op.Multi = YM::OPL::Multiply[0]; /* x0.5 */
+
+				Op.EgPhase = ADSR::Release;
+				Op.EgLevel = YM::OPL::MaxAttenuation;
+				Op.EgOutput = YM::OPL::MaxAttenuation << 3; /* Released */
+				Op.EgType = 1; /* non-percussive sound */
+
+				Op.KeyScaling = 2;
+				Op.KeyScaleShift = YM::OPL::KeyScaleShift[0];
+
+				Op.WaveTable = &YM::OPL::WaveTable[0][0];
+				Op.WaveSign  = YM::OPL::WaveSign[0];
+			}
+
+			/* Both outputs are on until OPL3 mode selects them */
+			for (auto& Chan : Channel)
+			{
+				Chan.PanL = ~0;
+				Chan.PanR = ~0;
+			}
+		}
+
+		/* Write register array data, registers 0x05 - 0x07 and 0x09 - 0x1F are decoded by the device.
+		   The mode registers (0x00 - 0x0F, 0xBD) only exist in array 0 */
+		void Write(uint8_t Address, uint8_t Data, uint32_t Array = 0)
+		{
+			/* Address to slot mapping */
+			static constexpr int32_t SlotMap[32] =
+			{
+				 0,  2,  4,  1,  3,  5, -1, -1,
+				 6,  8, 10,  7,  9, 11, -1, -1,
+				12, 14, 16, 13, 15, 17, -1, -1,
+				-1, -1, -1, -1, -1, -1, -1, -1
+			};
+
+			/* Address to channel mapping */
+			static constexpr int32_t ChannelMap[16] =
+			{
+				 CH1, CH2, CH3, CH4, CH5, CH6, CH7, CH8,
+				 CH9,  -1,  -1,  -1,  -1,  -1,  -1,  -1
+			};
+
+			/* Slot and channel offset of the register array */
+			const int32_t SlotBase = Array * 18;
+			const int32_t ChannelBase = Array * 9;
+
+			switch (Address & 0xF0)
+			{
+			case 0x00: /* Mode data */
+				if (Array != 0) return;
+
+				switch (Address & 0x0F)
+				{
+				case 0x01: /* LSI test */
+					if constexpr (HasWaveSelect) WaveSelectEnable = (Data >> 5) & 0x01;
+					LsiTest2 = (Data >> 2) & 0x01; /* Phase generator reset */
+					break;
+
+				case 0x02: /* Timer 1 */
+					Timer1.Period = Data;
+					break;
+
+				case 0x03: /* Timer 2 */
+					Timer2.Period = Data;
+					break;
+
+				case 0x04: /* IRQ reset / Timer control */
+				{
+					if (Data & 0x80)
+					{
+						ClearStatusFlags(IrqFlags);
+						return;
+					}
+
+					SetStatusMask(Data & IrqFlags);
+
+					/* Timer 1 and 2 start / stop */
+					auto ST1 = (Data >> 0) & 0x01;
+					auto ST2 = (Data >> 1) & 0x01;
+
+					if (Timer1.Start ^ ST1)
+					{
+						Timer1.Start = ST1;
+						Timer1.Counter = 256 - Timer1.Period;
+					}
+
+					if (Timer2.Start ^ ST2)
+					{
+						Timer2.Start = ST2;
+						Timer2.Counter = 256 - Timer2.Period;
+					}
+					break;
+				}
+
+				case 0x08: /* CSM mode / Note select */
+					if constexpr (!IsOPL3) CSM = (Data >> 7) & 0x01;
+					NTS = (Data >> 6) & 0x01;
+					break;
+
+				default: /* Not used */
+					break;
+				}
+				break;
+
+			case 0x20:
+			case 0x30: /* AM / PM / EG-Type / KSR / Multiply */
+			{
+				int32_t SlotId = SlotMap[Address & 0x1F]; if (SlotId == -1) return;
+				SlotId += SlotBase;
+				auto& Op = Slot[SlotId];
+
+				Op.LfoAmOn = (Data & 0x80) ? ~0 : 0; /* Tremolo on / off mask */
+				Op.LfoPmOn = (Data & 0x40) ? ~0 : 0; /* Vibrato on / off mask */
+
+				Op.EgType     = (Data & 0x20) ? 0 : 1;
+				Op.KeyScaling = (Data & 0x10) ? 0 : 2;
+
+				Op.Multi = YM::OPL::Multiply[Data & 0x0F];
+
+				UpdateScaledRates(SlotId);
+				break;
+			}
+
+			case 0x40:
+			case 0x50: /* KSL / Total level */
+			{
+				int32_t SlotId = SlotMap[Address & 0x1F]; if (SlotId == -1) return;
+				SlotId += SlotBase;
+				auto& Op = Slot[SlotId];
+
+				Op.KeyScaleShift = YM::OPL::KeyScaleShift[(Data >> 6) & 0x03];
+				Op.TotalLevel = (Data >> 0) & 0x3F;
+				break;
+			}
+
+			case 0x60:
+			case 0x70: /* AR / DR */
+			{
+				int32_t SlotId = SlotMap[Address & 0x1F]; if (SlotId == -1) return;
+				SlotId += SlotBase;
+				auto& Op = Slot[SlotId];
+
+				Op.EgRate[ADSR::Attack] = (Data >> 4) & 0x0F;
+				Op.EgRate[ADSR::Decay]  = (Data >> 0) & 0x0F;
+
+				UpdateScaledRates(SlotId);
+				break;
+			}
+
+			case 0x80:
+			case 0x90: /* SL / RR */
+			{
+				int32_t SlotId = SlotMap[Address & 0x1F]; if (SlotId == -1) return;
+				SlotId += SlotBase;
+				auto& Op = Slot[SlotId];
+
+				Op.SustainLvl = (Data >> 4) & 0x0F;
+				Op.EgRate[ADSR::Release] = (Data >> 0) & 0x0F;
+
+				/* If all SL bits are set, SL is -93dB. See OPL4 manual page 47 */
+				Op.SustainLvl |= (Op.SustainLvl + 1) & 0x10;
+
+				UpdateScaledRates(SlotId);
+				break;
+			}
+
+			case 0xA0: /* F-Number (L) */
+			{
+				int32_t ChannelId = ChannelMap[Address & 0x0F]; if (ChannelId == -1) return;
+				ChannelId += ChannelBase;
+				auto& Chan = Channel[ChannelId];
+
+				/* The frequency of a 4-operator channel is set through its 1st channel */
+				if (IsFourOpSecondary(ChannelId)) return;
+
+				Chan.FNum &= 0x300;
+				Chan.FNum |= Data;
+
+				if (IsFourOp(ChannelId)) Channel[ChannelId + 3].FNum = Chan.FNum;
+				break;
+			}
+
+			case 0xB0: /* Key On / Block / F-Number (H) */
+			{
+				if (Address == 0xBD) /* AM, PM depth / Rhythm */
+				{
+					if (Array != 0) return;
+
+					LfoAmShift = (Data & 0x80) ? 2 : 4; /* Depth = 4.8 or 1.0dB */
+					LfoPmShift = (Data & 0x40) ? 0 : 1; /* Depth = 7 or 14 cents */
+					RHY = (Data >> 5) & 0x01;
+
+					if (RHY) /* Key on/off drum instruments */
+					{
+						Slot[Rhythm::BD1].DrumLatch = (Data >> 4) & 0x01;
+						Slot[Rhythm::BD2].DrumLatch = (Data >> 4) & 0x01;
+						Slot[Rhythm::SD ].DrumLatch = (Data >> 3) & 0x01;
+						Slot[Rhythm::TOM].DrumLatch = (Data >> 2) & 0x01;
+						Slot[Rhythm::CYM].DrumLatch = (Data >> 1) & 0x01;
+						Slot[Rhythm::HH ].DrumLatch = (Data >> 0) & 0x01;
+					}
+				}
+				else
+				{
+					int32_t ChannelId = ChannelMap[Address & 0x0F]; if (ChannelId == -1) return;
+					ChannelId += ChannelBase;
+					auto& Chan = Channel[ChannelId];
+
+					/* A 4-operator channel is keyed and set through its 1st channel */
+					if (IsFourOpSecondary(ChannelId)) return;
+
+					Chan.KeyLatch = (Data >> 5) & 0x01;
+					Chan.Block    = (Data >> 2) & 0x07;
+
+					Chan.FNum &= 0x0FF;
+					Chan.FNum |= (Data & 0x03) << 8;
+
+					/* Calculate keycode */
+					Chan.KeyCode = (Chan.Block << 1);
+					Chan.KeyCode |= (Chan.FNum >> (9 - NTS)) & 0x01; /* Select FNUM b9 or b8 */
+
+					/* The key scaled rates follow the key code */
+					UpdateScaledRates((ChannelId << 1) + S1);
+					UpdateScaledRates((ChannelId << 1) + S2);
+
+					if (IsFourOp(ChannelId)) CopyFrequency(ChannelId, ChannelId + 3);
+				}
+				break;
+			}
+
+			case 0xC0: /* Feedback / Connection */
+			{
+				int32_t ChannelId = ChannelMap[Address & 0x0F]; if (ChannelId == -1) return;
+				ChannelId += ChannelBase;
+				auto& Chan = Channel[ChannelId];
+
+				Chan.FB   = (Data >> 1) & 0x07;
+				Chan.Algo = (Data >> 0) & 0x01;
+
+				if constexpr (IsOPL3)
+				{
+					/* Output A (left) and B (right), both are on outside OPL3 mode */
+					Chan.PanL = (!NEW || (Data & 0x10)) ? ~0 : 0;
+					Chan.PanR = (!NEW || (Data & 0x20)) ? ~0 : 0;
+				}
+				break;
+			}
+
+			case 0xE0:
+			case 0xF0: /* Wave select */
+			{
+				if constexpr (HasWaveSelect)
+				{
+					/* OPL3 has no wave select enable */
+					if (IsOPL3 || WaveSelectEnable)
+					{
+						int32_t SlotId = SlotMap[Address & 0x1F]; if (SlotId == -1) return;
+						SlotId += SlotBase;
+						auto& Op = Slot[SlotId];
+
+						/* OPL3 mode adds waves 4 - 7 */
+						uint32_t Wave = Data & (NEW ? 0x07 : 0x03);
+
+						Op.WaveTable = &YM::OPL::WaveTable[Wave][0];
+						Op.WaveSign  = YM::OPL::WaveSign[Wave];
+					}
+				}
+				break;
+			}
+
+			default: /* Not used */
+				break;
+			}
+		}
+
+		/* Set the 4-operator connection select (OPL3 register 0x104), bit n pairs channel n with n + 3 (array 0: bits 0 - 2, array 1: bits 3 - 5) */
+		void SetConnection(uint8_t Data)
+		{
+			FourOp = Data & 0x3F;
+		}
+
+		/* Set the OPL3 mode flag (OPL3 register 0x105) */
+		void SetNew(uint32_t Enable)
+		{
+			NEW = Enable & 0x01;
+		}
+
+		/* True if the channel is the 1st channel of an enabled 4-operator pair */
+		inline bool IsFourOp(uint32_t ChannelId) const
+		{
+			if constexpr (IsOPL3)
+			{
+				uint32_t Pair = ChannelId % 9;
+				return NEW && (Pair < 3) && ((FourOp >> (Pair + (ChannelId / 9) * 3)) & 1);
+			}
+			else
+			{
+				return false;
+			}
+		}
+
+		/* True if the channel is the 2nd channel of an enabled 4-operator pair */
+		inline bool IsFourOpSecondary(uint32_t ChannelId) const
+		{
+			if constexpr (IsOPL3)
+			{
+				uint32_t Pair = ChannelId % 9;
+				return (Pair >= 3) && (Pair < 6) && IsFourOp(ChannelId - 3);
+			}
+			else
+			{
+				return false;
+			}
+		}
+
+		/* Set status flags, masked flags are ignored */
+		void SetStatusFlags(uint8_t Flags)
+		{
+			Status |= (Flags & StatusMask);
+
+			if (Status & IrqFlags)
+			{
+				/* Set IRQ flag */
+				Status |= FlagIRQ;
+			}
+		}
+
+		void ClearStatusFlags(uint8_t Flags)
+		{
+			Status &= ~Flags;
+
+			if ((Status & IrqFlags) == 0)
+			{
+				/* Reset IRQ */
+				Status &= ~FlagIRQ;
+			}
+		}
+
+		/* The /IRQ pin follows the IRQ flag (the device reports it) */
+		inline bool IsIrqAsserted() const
+		{
+			return (Status & FlagIRQ) != 0;
+		}
+
+		/* Samples until the next timer overflow that sets a status flag, 0 if none is pending */
+		uint32_t GetSamplesToTimerEvent() const
+		{
+			uint32_t Samples = UINT32_MAX;
+
+			if (Timer1.Start && (StatusMask & FlagTimer1)) Samples = std::min(Samples, TimerSamples(Timer1.Counter, YM::OPL::Timer1Mask));
+			if (Timer2.Start && (StatusMask & FlagTimer2)) Samples = std::min(Samples, TimerSamples(Timer2.Counter, YM::OPL::Timer2Mask));
+
+			return (Samples != UINT32_MAX) ? Samples : 0;
+		}
+
+		/* True if all slots are released and stay released without a register write (CSM mode keys on all slots) */
+		bool IsIdle() const
+		{
+			if (CSM && Timer1.Start) return false;
+
+			for (uint32_t SlotId = 0; SlotId < Slots; SlotId++)
+			{
+				if (!YM::OPL::IsReleased(Slot[SlotId], Channel[SlotId >> 1])) return false;
+			}
+
+			return true;
+		}
+
+		void SetStatusMask(uint8_t Mask)
+		{
+			StatusMask = ~Mask; /* Invert as 1: mask, 0: don't mask */
+		}
+
+		/* Samples until a timer with the given counter and global timer mask overflows,
+		   the counter decrements every time the masked global timer wraps to 0 */
+		inline uint32_t TimerSamples(uint32_t Counter, uint32_t Mask) const
+		{
+			return ((Mask + 1) - (Timer & Mask)) + (Counter - 1) * (Mask + 1);
+		}
+
+		/* Update the global timer, LFO and timer 1 / 2 (once per sample) */
+		void UpdateTimers()
+		{
+			/* Update global timer */
+			Timer++;
+
+			/* A rate of 0 is never updated */
+			EgRates = YM::GetEgRates(YM::OPL::EgSchedule, Timer) & ~1ull;
+
+			/* Update LFO-AM (tremolo) */
+			if ((Timer & YM::OPL::LfoAmPeriod) == 0)
+			{
+				LfoAmStep = (LfoAmStep + 1) % YM::OPL::LfoAmSteps;
+
+				if (LfoAmStep < (YM::OPL::LfoAmSteps / 2)) /* Increase */
+				{
+					LfoAmLevel = LfoAmStep >> LfoAmShift;
+				}
+				else /* Decrease */
+				{
+					LfoAmLevel = (YM::OPL::LfoAmSteps - LfoAmStep) >> LfoAmShift;
+				}
+			}
+
+			/* Update LFO-PM (vibrato) */
+			if ((Timer & YM::OPL::LfoPmPeriod) == 0)
+			{
+				LfoPmStep = (LfoPmStep + 1) & YM::OPL::LfoPmSteps;
+			}
+
+			/* Update timer 1 */
+			if (Timer1.Start)
+			{
+				if ((Timer & YM::OPL::Timer1Mask) == 0)
+				{
+					if (--Timer1.Counter == 0)
+					{
+						Timer1.Counter = 256 - Timer1.Period;
+						SetStatusFlags(FlagTimer1);
+
+						/* CSM Key On */
+						if (CSM)
+						{
+							for (auto& Op : Slot) Op.CsmLatch = 1;
+						}
+					}
+				}
+			}
+
+			/* Update timer 2 */
+			if (Timer2.Start)
+			{
+				if ((Timer & YM::OPL::Timer2Mask) == 0)
+				{
+					if (--Timer2.Counter == 0)
+					{
+						Timer2.Counter = 256 - Timer2.Period;
+						SetStatusFlags(FlagTimer2);
+					}
+				}
+			}
+		}
+
+		/* Update all slots (operators), the operator outputs are only calculated when rendering */
+		void UpdateSlots(bool Render, TC::DeviceStats& Stats)
+		{
+			static constexpr uint32_t SlotOrder[] =
+			{
+				 0,  2,  4,  1,  3,  5,
+				 6,  8, 10,  7,  9, 11,
+				12, 14, 16, 13, 15, 17
+			};
+
+			/* Channel kernels, selected by the connection register */
+			static constexpr void (Engine::*Kernels[2])(uint32_t, bool, TC::DeviceStats&) =
+			{
+				&Engine::UpdateChannel<0>, &Engine::UpdateChannel<1>
+			};
+
+			if constexpr (IsOPL3)
+			{
+				UpdateSlotsOPL3(Render, Stats);
+				return;
+			}
+
+			if (RHY == 0)
+			{
+				/* Without the drums the slots of a channel only depend on each other (the noise
+				   generator is only used by the drums), the channels are updated one by one */
+				for (uint32_t ChannelId = CH1; ChannelId <= CH9; ChannelId++) (this->*Kernels[Channel[ChannelId].Algo])(ChannelId, Render, Stats);
+
+				return;
+			}
+
+			/* The envelope of released slots is not updated */
+			for (auto SlotId : SlotOrder)
+			{
+				if (!YM::OPL::IsReleased(Slot[SlotId], Channel[SlotId >> 1])) UpdateEnvelopeGenerator(SlotId, Stats);
+				UpdatePhaseGenerator(SlotId);
+				if (Render) UpdateOperatorUnit(SlotId);
+				UpdateNoiseGenerator();
+			}
+		}
+
+		/* Clear the accumulator and mix all channels */
+		void UpdateAccumulator()
+		{
+			if constexpr (IsOPL3)
+			{
+				OutL = 0;
+				OutR = 0;
+
+				for (uint32_t ChannelId = 0; ChannelId < Channels; ChannelId++) AccumulateChannelOPL3(ChannelId);
+
+				return;
+			}
+
+			Out = 0;
+
+			for (uint32_t ChannelId = CH1; ChannelId <= CH9; ChannelId++) AccumulateChannel(ChannelId);
+		}
+
+	private:
+		/* OPL3 slot update: 2 and 4-operator channel kernels, the drums (array 0) in slot order */
+		void UpdateSlotsOPL3(bool Render, TC::DeviceStats& Stats)
+		{
+			static constexpr uint32_t DrumOrder[] =
+			{
+				BD1, HH, TOM, BD2, SD, CYM
+			};
+
+			static constexpr void (Engine::*Kernels[2])(uint32_t, bool, TC::DeviceStats&) =
+			{
+				&Engine::UpdateChannel<0>, &Engine::UpdateChannel<1>
+			};
+
+			/* 4-operator kernels, selected by the connection registers of both channels */
+			static constexpr void (Engine::*FourOpKernels[4])(uint32_t, bool, TC::DeviceStats&) =
+			{
+				&Engine::UpdateFourOpChannel<0>, &Engine::UpdateFourOpChannel<1>, &Engine::UpdateFourOpChannel<2>, &Engine::UpdateFourOpChannel<3>
+			};
+
+			for (uint32_t ChannelId = 0; ChannelId < Channels; ChannelId++)
+			{
+				/* The drums are updated after the channels */
+				if (RHY && (ChannelId >= CH7) && (ChannelId <= CH9)) continue;
+
+				if (IsFourOp(ChannelId))
+				{
+					uint32_t Algo = (Channel[ChannelId].Algo << 1) | Channel[ChannelId + 3].Algo;
+
+					(this->*FourOpKernels[Algo])(ChannelId, Render, Stats);
+				}
+				else if (!IsFourOpSecondary(ChannelId))
+				{
+					(this->*Kernels[Channel[ChannelId].Algo])(ChannelId, Render, Stats);
+				}
+			}
+
+			if (RHY == 0) return;
+
+			/* The envelope of released slots is not updated */
+			for (auto SlotId : DrumOrder)
+			{
+				if (!YM::OPL::IsReleased(Slot[SlotId], Channel[SlotId >> 1])) UpdateEnvelopeGenerator(SlotId, Stats);
+				UpdatePhaseGenerator(SlotId);
+				if (Render) UpdateOperatorUnit(SlotId);
+				UpdateNoiseGenerator();
+			}
+		}
+
+		/* 4-operator channel kernel, operators 1 + 2 are the slots of the 1st channel and 3 + 4 the ones of the 2nd channel (3 channels up).
+		   The algorithm is (1st connection << 1) | 2nd connection:
+		   0: 1 -> 2 -> 3 -> 4, 1: (1 -> 2) + (3 -> 4), 2: 1 + (2 -> 3 -> 4), 3: 1 + (2 -> 3) + 4 */
+		template<uint32_t Algo>
+		void UpdateFourOpChannel(uint32_t ChannelId, bool Render, TC::DeviceStats& Stats)
+		{
+			UpdateFourOpSlot<Algo, 0>(ChannelId << 1, Render, Stats);
+			UpdateFourOpSlot<Algo, 1>(ChannelId << 1, Render, Stats);
+			UpdateFourOpSlot<Algo, 2>(ChannelId << 1, Render, Stats);
+			UpdateFourOpSlot<Algo, 3>(ChannelId << 1, Render, Stats);
+		}
+
+		template<uint32_t Algo, uint32_t N>
+		inline void UpdateFourOpSlot(uint32_t Base, bool Render, TC::DeviceStats& Stats)
+		{
+			uint32_t SlotId = FourOpSlot(Base, N);
+
+			/* The envelope of released slots is not updated */
+			if (!YM::OPL::IsReleased(Slot[SlotId], Channel[SlotId >> 1])) UpdateEnvelopeGenerator(SlotId, Stats);
+			UpdatePhaseGenerator(SlotId);
+			if (Render) UpdateOperatorUnit(SlotId, FourOpModulation<Algo, N>(Base));
+			UpdateNoiseGenerator();
+		}
+
+		/* Slot of operator N (0 - 3) of a 4-operator channel, Base = 1st slot of the channel */
+		static constexpr uint32_t FourOpSlot(uint32_t Base, uint32_t N)
+		{
+			return Base + ((N >> 1) * 6) + (N & 1);
+		}
+
+		/* Phase modulation of operator N of a 4-operator channel */
+		template<uint32_t Algo, uint32_t N>
+		inline int16_t FourOpModulation(uint32_t Base) const
+		{
+			/* Operator N is modulated by operator N - 1 */
+			constexpr bool Chained = (N == 1) ? (Algo < 2) : (N == 2) ? (Algo != 1) : (Algo != 3);
+
+			if constexpr (N == 0)
+			{
+				/* Operator 1 self-feedback modulation (feedback of the 1st channel) */
+				return Modulation<0, S1>(Base);
+			}
+			else if constexpr (Chained)
+			{
+				return Slot[FourOpSlot(Base, N - 1)].Output[1]; /* Delayed by 1 sample */
+			}
+			else
+			{
+				/* Additive: no modulation */
+				return 0;
+			}
+		}
+
+		/* Sum of the carrier outputs of a 4-operator channel */
+		template<uint32_t Algo>
+		int16_t SumFourOpCarriers(uint32_t Base) const
+		{
+			int16_t Output = Slot[FourOpSlot(Base, 3)].Output[0];
+
+			/* Carriers before operator 4 are delayed by 1 sample */
+			if constexpr (Algo == 1) Output += Slot[FourOpSlot(Base, 1)].Output[1];
+			if constexpr (Algo >= 2) Output += Slot[FourOpSlot(Base, 0)].Output[1];
+			if constexpr (Algo == 3) Output += Slot[FourOpSlot(Base, 2)].Output[1];
+
+			return Output;
+		}
+
+		/* Copy the frequency and key state of the 1st channel of a 4-operator pair to the 2nd channel */
+		void CopyFrequency(uint32_t From, uint32_t To)
+		{
+			auto& Chan = Channel[To];
+
+			Chan.KeyLatch = Channel[From].KeyLatch;
+			Chan.FNum     = Channel[From].FNum;
+			Chan.Block    = Channel[From].Block;
+			Chan.KeyCode  = Channel[From].KeyCode;
+
+			UpdateScaledRates((To << 1) + S1);
+			UpdateScaledRates((To << 1) + S2);
+		}
+
+		/* Channel kernel of a connection mode, modulator and carrier with the connection resolved at compile time */
+		template<uint32_t Algo>
+		void UpdateChannel(uint32_t ChannelId, bool Render, TC::DeviceStats& Stats)
+		{
+			UpdateChannelSlot<Algo, S1>(ChannelId << 1, Render, Stats);
+			UpdateChannelSlot<Algo, S2>(ChannelId << 1, Render, Stats);
+		}
+
+		template<uint32_t Algo, uint32_t S>
+		inline void UpdateChannelSlot(uint32_t Base, bool Render, TC::DeviceStats& Stats)
+		{
+			uint32_t SlotId = Base + S;
+
+			/* The envelope of released slots is not updated */
+			if (!YM::OPL::IsReleased(Slot[SlotId], Channel[SlotId >> 1])) UpdateEnvelopeGenerator(SlotId, Stats);
+			UpdatePhaseGenerator(SlotId);
+			if (Render) UpdateOperatorUnit(SlotId, Modulation<Algo, S>(Base));
+			UpdateNoiseGenerator();
+		}
+
+		void UpdatePhaseGenerator(uint32_t SlotId)
+		{
+			auto& Chan = Channel[SlotId >> 1];
+			auto& Op = Slot[SlotId];
+
+			uint32_t FNum = Chan.FNum;
+
+			/* Reset phase counter */
+			if (Op.PgReset | LsiTest2) Op.PgPhase = 0;
+
+			/* Apply LFO-PM (vibrato) */
+			if (Op.LfoPmOn != 0)
+			{
+				/* LFO-PM shape (8 steps):
+
+				      2
+				     / \
+				    1   3
+				   /     \
+				--0-------4-------0--
+				           \     /
+				            5   7
+				             \ /
+				              6
+				*/
+
+				uint32_t Inc = FNum >> 7;
+
+				switch (LfoPmStep)
+				{
+				case 0:
+				case 4: /* Center */
+					break;
+
+				case 1:
+				case 3: /* Halfway - positive */
+					FNum += (Inc >> (1 + LfoPmShift));
+					break;
+
+				case 2: /* Top - positive */
+					FNum += (Inc >> LfoPmShift);
+					break;
+
+				case 5:
+				case 7: /* Halfway - negative */
+					FNum -= (Inc >> (1 + LfoPmShift));
+					break;
+
+				case 6: /* Top - negative */
+					FNum -= (Inc >> LfoPmShift);
+				}
+			}
+
+			/* Block shift (16-bit) */
+			uint32_t Inc = (FNum << Chan.Block) >> 1;
+
+			/* Multiply (19-bit) */
+			Inc = (Inc * Op.Multi) >> 1;
+
+			/* Update phase counter (19-bit: 10.9) */
+			Op.PgPhase += Inc;
+			Op.PgOutput = Op.PgPhase >> 9;
+
+			if (RHY)
+			{
+				switch (SlotId)
+				{
+				case Rhythm::HH:
+				{
+					/* Get high hat b8; map it to b1 of the result (b0 of the result is reserved for the noise bit) */
+					PhaseHH8 = (Op.PgOutput >> 7) & 0x02; /* b8 */
+
+					/* Get high hat b7, b3 and b2; map it to b4, b3, and b2 of the result */
+					PhaseHH  = (Op.PgOutput >> 3) & 0x10; /* b7 */
+					PhaseHH |= (Op.PgOutput >> 0) & 0x0C; /* b3 and b2 */
+
+					/* Lookup the phase input bit */
+					uint32_t PhaseIn = YM::OPL::PhaseIn[PhaseHH | PhaseTC];
+
+					/* Lookup the high hat phase output bits */
+					Op.PgOutput = YM::OPL::PhaseOutHH[(PhaseIn << 1) | NoiseOut];
+					break;
+				}
+
+				case Rhythm::SD:
+					/* Lookup the snare drum phase output bits */
+					Op.PgOutput = YM::OPL::PhaseOutSD[PhaseHH8 | NoiseOut];
+					break;
+
+				case Rhythm::CYM:
+				{
+					/* Get top cymbal b5 and b3; map it to b1 and b0 of the result */
+					PhaseTC  = (Op.PgOutput >> 4) & 0x02; /* b5 */
+					PhaseTC |= (Op.PgOutput >> 3) & 0x01; /* b3 */
+
+					/* Lookup the phase input bit */
+					uint32_t PhaseIn = YM::OPL::PhaseIn[PhaseHH | PhaseTC];
+
+					/* Calculate the top cymbal phase output bits */
+					Op.PgOutput = (PhaseIn << 9) | 0x80;
+					break;
+				}
+				}
+			}
+		}
+
+		/* Cache the key scaled rates of a slot, done when its rates, EG-Type or key code change */
+		void UpdateScaledRates(uint32_t SlotId)
+		{
+			auto& Chan = Channel[SlotId >> 1];
+			auto& Op = Slot[SlotId];
+
+			for (uint32_t Phase = ADSR::Attack; Phase <= ADSR::Release; Phase++)
+			{
+				/* Note: EG-Type selects sustain or release */
+				uint32_t Rate = Op.EgRate[(Phase == ADSR::Sustain) ? (ADSR::Sustain + Op.EgType) : Phase];
+
+				/* Scaled rate: (4 * rate) + scale value, a rate of 0 is not scaled */
+				Op.EgScaledRate[Phase] = (Rate != 0) ? std::min((Rate << 2) + (Chan.KeyCode >> Op.KeyScaling), 63u) : 0;
+			}
+
+			/* A held envelope might change at the new rate */
+			Op.EgHold = 0;
+		}
+
+		void UpdateEnvelopeGenerator(uint32_t SlotId, TC::DeviceStats& Stats)
+		{
+			auto& Chan = Channel[SlotId >> 1];
+			auto& Op = Slot[SlotId];
+
+			/*-------------------------------------*/
+			/* Step 1: Key On / Off event handling */
+			/*-------------------------------------*/
+			uint32_t NewKeyState = (Chan.KeyLatch | Op.CsmLatch | Op.DrumLatch);
+			uint32_t EnvelopeStart = 0;
+
+			/* Clear CSM key on flag */
+			Op.CsmLatch = 0;
+
+			switch ((NewKeyState << 1) | Op.KeyState)
+			{
+			case 0x00:
+			case 0x03: /* No key state changes */
+				Op.PgReset = 0;
+				break;
+
+			case 0x01: /* Key off state */
+				Op.EgPhase = ADSR::Release;
+				Op.EgHold = 0;
+				Op.PgReset = 0;
+				Op.KeyState = 0;
+				break;
+
+			case 0x02: /* Key on state */
+				Op.EgPhase = ADSR::Attack;
+				Op.EgHold = 0;
+				Op.PgReset = 1;
+				Op.KeyState = 1;
+				EnvelopeStart = 1;
+				Stats.KeyOn();
+				break;
+			}
+
+			/*-------------------------------*/
+			/* Step 2: Envelope update cycle */
+			/*-------------------------------*/
+			if (!Op.EgHold)
+			{
+				/* Get key scaled rate: (4 * rate) + scale value */
+				uint32_t ScaledRate = Op.EgScaledRate[Op.EgPhase];
+
+				if ((EgRates >> ScaledRate) & 1) /* Timer expired */
+				{
+					uint16_t Level = Op.EgLevel;
+
+					/* Get update cycle (8 cycles in total) */
+					uint32_t Cycle = (Timer >> YM::OPL::EgShift[ScaledRate]) & 0x07;
+
+					/* Lookup attenuation adjustment */
+					uint32_t AttnInc = YM::OPL::EgLevelAdjust[ScaledRate][Cycle];
+
+					switch (Op.EgPhase)
+					{
+					case ADSR::Attack:
+						if (ScaledRate >= 60)
+						{
+							/* Instant attack */
+							if (EnvelopeStart) Level = 0;
+						}
+						else
+						{
+							if (Level != 0) Level += ((~Level * AttnInc) >> 3);
+						}
+
+						if (Level == 0) Op.EgPhase = (Op.SustainLvl != 0) ? ADSR::Decay : ADSR::Sustain;
+						break;
+
+					case ADSR::Decay:
+						Level += AttnInc;
+						if ((Level >> 4) == Op.SustainLvl) Op.EgPhase = ADSR::Sustain;
+						break;
+
+					case ADSR::Sustain:
+					case ADSR::Release:
+						Level += AttnInc;
+						if (Level >= YM::OPL::MaxEgLevel) Level = YM::OPL::MaxAttenuation;
+						break;
+					}
+
+					Op.EgLevel = Level;
+				}
+
+				/* Sustain and release have no phase transitions, the level holds once it can no
+				   longer change (maximum attenuation or a rate of 0) */
+				Op.EgHold = (Op.EgPhase >= ADSR::Sustain) && ((Op.EgLevel == YM::OPL::MaxAttenuation) || (Op.EgScaledRate[Op.EgPhase] == 0));
+			}
+
+			/*-------------------------------------*/
+			/* Step 3: Envelope output calculation */
+			/*-------------------------------------*/
+			uint32_t Attn = Op.EgLevel + (Op.TotalLevel << 2);
+
+			/* Apply key scale level */
+			Attn += YM::OPL::KeyScaleLevel[Chan.FNum >> 6][Chan.Block] >> Op.KeyScaleShift; //TODO: Pre-calculate KSL
+
+			/* Apply LFO-AM (tremolo) */
+			Attn += LfoAmLevel & Op.LfoAmOn;
+
+			/* Limit and shift from 4.5 to 4.8 */
+			Op.EgOutput = std::min(Attn, YM::OPL::MaxAttenuation) << 3;
+		}
+
+		void UpdateOperatorUnit(uint32_t SlotId)
+		{
+			UpdateOperatorUnit(SlotId, GetModulation(SlotId));
+		}
+
+		void UpdateOperatorUnit(uint32_t SlotId, int16_t Modulation)
+		{
+			auto& Op = Slot[SlotId];
+
+			/* Phase modulation (10-bit) */
+			uint32_t Phase = Op.PgOutput + Modulation;
+
+			/* Attenuation (4.8 + 4.8 = 5.8 fixed point) */
+			uint32_t Level = Op.WaveTable[Phase & 0x3FF] + Op.EgOutput;
+
+			/* dB to linear conversion (12-bit) */
+			int16_t Output = YM::OPL::ExpTable[Level & 0xFF] >> (Level >> 8);
+
+			/* Inverse output (13-bit) */
+			if ((Op.WaveSign >> ((Phase >> 8) & 0x03)) & 1) Output = ~Output; /* Don't negate !*/
+
+			/* The last 2 generated samples are stored */
+			Op.Output[1] = Op.Output[0];
+			Op.Output[0] = Output;
+		}
+
+		void UpdateNoiseGenerator()
+		{
+			/* ! This needs validation ! */
+			NoiseOut = NoiseLFSR & 1;
+
+			uint32_t Seed = ((NoiseLFSR >> 14) ^ (NoiseLFSR >> 0)) & 1;
+			NoiseLFSR = (NoiseLFSR >> 1) | (Seed << 22);
+		}
+
+		void AccumulateChannel(uint32_t ChannelId)
+		{
+			/* ! This needs validation ! */
+			auto& Chan = Channel[ChannelId];
+
+			int16_t Output = 0;
+
+			if (RHY)
+			{
+				switch (ChannelId)
+				{
+				case CH7: /* Bass drum */
+					Output = Slot[BD2].Output[0];
+
+					/* Limit (13-bit) and mix channel output */
+					Out += std::clamp<int16_t>(Output, -4096, 4095) * 2;
+					return;
+
+				case CH8: /* High hat + Snare drum */
+					Output  = Slot[HH].Output[1]; /* Delayed by 1 sample ? */
+					Output += Slot[SD].Output[0];
+
+					/* Limit (13-bit) and mix channel output */
+					Out += std::clamp<int16_t>(Output, -4096, 4095) * 2;
+					return;
+
+				case CH9: /* Tom + Top cymbal */
+					Output  = Slot[TOM].Output[1]; /* Delayed by 1 sample ? */
+					Output += Slot[CYM].Output[0];
+
+					/* Limit (13-bit) and mix channel output */
+					Out += std::clamp<int16_t>(Output, -4096, 4095) * 2;
+					return;
+				}
+			}
+
+			static constexpr int16_t (Engine::*Kernels[2])(uint32_t) const =
+			{
+				&Engine::SumCarriers<0>, &Engine::SumCarriers<1>
+			};
+
+			Output = (this->*Kernels[Chan.Algo])(ChannelId << 1);
+
+			/* Limit (13-bit) and mix channel output */
+			Out += std::clamp<int16_t>(Output, -4096, 4095);
+		}
+
+		/* OPL3 channel output, the channel sums are not limited (the device limits the mix) */
+		void AccumulateChannelOPL3(uint32_t ChannelId)
+		{
+			auto& Chan = Channel[ChannelId];
+
+			int32_t Output = 0;
+
+			if (RHY && (ChannelId >= CH7) && (ChannelId <= CH9))
+			{
+				switch (ChannelId)
+				{
+				case CH7: /* Bass drum */
+					Output = Slot[BD2].Output[0] * 2;
+					break;
+
+				case CH8: /* High hat + Snare drum */
+					Output = (Slot[HH].Output[1] + Slot[SD].Output[0]) * 2;
+					break;
+
+				case CH9: /* Tom + Top cymbal */
+					Output = (Slot[TOM].Output[1] + Slot[CYM].Output[0]) * 2;
+					break;
+				}
+			}
+			else if (IsFourOp(ChannelId))
+			{
+				static constexpr int16_t (Engine::*FourOpKernels[4])(uint32_t) const =
+				{
+					&Engine::SumFourOpCarriers<0>, &Engine::SumFourOpCarriers<1>, &Engine::SumFourOpCarriers<2>, &Engine::SumFourOpCarriers<3>
+				};
+
+				/* The 1st channel selects the outputs */
+				Output = (this->*FourOpKernels[(Chan.Algo << 1) | Channel[ChannelId + 3].Algo])(ChannelId << 1);
+			}
+			else if (!IsFourOpSecondary(ChannelId))
+			{
+				static constexpr int16_t (Engine::*Kernels[2])(uint32_t) const =
+				{
+					&Engine::SumCarriers<0>, &Engine::SumCarriers<1>
+				};
+
+				Output = (this->*Kernels[Chan.Algo])(ChannelId << 1);
+			}
+
+			OutL += Output & (int32_t)Chan.PanL;
+			OutR += Output & (int32_t)Chan.PanR;
+		}
+
+		int16_t GetModulation(uint32_t SlotId)
+		{
+			auto& Chan = Channel[SlotId >> 1];
+
+			if (RHY)
+			{
+				/*
+					A special case is needed for the drum instruments that don't have modulation input.
+					The bass drum and tom can be processed normally.
+
+					High hat can still do self feedback ?
+				*/
+
+				switch (SlotId)
+				{
+				//case Rhythm::HH: return 0;
+				case Rhythm::SD: return 0;
+				case Rhythm::CYM: return 0;
+				}
+			}
+
+			static constexpr int16_t (Engine::*Kernels[4])(uint32_t) const =
+			{
+				&Engine::Modulation<0, S1>, &Engine::Modulation<0, S2>, &Engine::Modulation<1, S1>, &Engine::Modulation<1, S2>
+			};
+
+			return (this->*Kernels[(Chan.Algo << 1) | (SlotId & 1)])(SlotId & ~1);
+		}
+
+		/* Phase modulation of slot S, Base = modulator of the channel */
+		template<uint32_t Algo, uint32_t S>
+		inline int16_t Modulation(uint32_t Base) const
+		{
+			if constexpr (S == S1)
+			{
+				uint32_t FB = Channel[Base >> 1].FB;
+
+				/* Slot 1 self-feedback modulation */
+				return FB ? (Slot[Base].Output[0] + Slot[Base].Output[1]) >> (9 - FB) : 0;
+			}
+			else if constexpr (Algo == 0)
+			{
+				/* Carrier modulated by the modulator */
+				return Slot[Base + S1].Output[1]; /* Delayed by 1 sample */
+			}
+			else
+			{
+				/* Additive: no modulation */
+				return 0;
+			}
+		}
+
+		/* Sum of the carrier outputs of a channel, Base = modulator of the channel */
+		template<uint32_t Algo>
+		int16_t SumCarriers(uint32_t Base) const
+		{
+			if constexpr (Algo == 0)
+				return Slot[Base + S2].Output[0];
+			else
+				return Slot[Base + S1].Output[1] + Slot[Base + S2].Output[0]; /* Modulator delayed by 1 sample */
+		}
+	};
+}
+
+#endif // !_YM_OPL_ENGINE_H_
\ No newline at end of file
@@ -31,52 +31,56 @@ namespace YM::OPN /* Yamaha - FM Operator Type-N */
 		ADPCMB
 	};
 
-	/* Operator data type */
+	/* Operator data type
+	   The per-sample state comes first (phase, envelope, output history), followed by the
+	   register state. Fields are packed to their width, a slot takes 48 bytes */
 	struct operator_t
 	{
-		uint32_t	KeyState;		/* Key on/off state */
-		uint32_t	KeyLatch;		/* Latched key on/off flag */
-		uint32_t	CsmLatch;		/* Latched CSM key on/off flag */
-
-		uint32_t	FNum;			/* Frequency Nr. (11-bit) */
-		uint32_t	Block;			/* Block (3-bit) */
-		uint32_t	KeyCode;		/* Key code (5-bit) */
-
-		uint32_t	Detune;			/* Detune (3-bit) */
-		uint32_t	Multi;			/* Multiplier (4-bit) */
-		uint32_t	TotalLevel;		/* Total level (7-bit) */
-		uint32_t	KeyScale;		/* Key scale (2-bit) */
-		uint16_t	SustainLvl;		/* Sustain level (4-bit) */
-		uint32_t	AmOn;			/* LFO-AM on/off mask */
-
-		uint32_t	SsgEnable;		/* SSG-EG Enable flag */
-		uint32_t	SsgEgInv;		/* SSG-EG Inversion mode flag */
-		uint32_t	SsgEgAlt;		/* SSG-EG Alternate mode flag */
-		uint32_t	SsgEgHld;		/* SSG-EG Hold mode flag */
-		uint32_t	SsgEgInvOut;	/* SSG-EG Inverted output flag */
-
-		uint32_t	EgRate[4];		/* Envelope rates (5-bit) */
-		uint32_t	EgPhase;		/* Envelope phase */
+		/* Per-sample state */
+		uint32_t	PgPhase;		/* Phase counter (20-bit) */
+		uint32_t	PgIncrement;	/* Phase increment (20-bit), cached until the frequency changes */
 		uint16_t	EgLevel;		/* Envelope internal level (10-bit) */
 		uint16_t	EgOutput;		/* Envelope output (12-bit) */
-
-		uint32_t	PgPhase;		/* Phase counter (20-bit) */
-		uint32_t	PgOutput;		/* Phase output (10-bit) */
-		uint32_t	PgReset;		/* Phase reset flag */
-
 		int16_t		Output[2];		/* Operator output (14-bit) */
+
+		uint16_t	FNum;			/* Frequency Nr. (11-bit) */
+		uint8_t		Block;			/* Block (3-bit) */
+		uint8_t		KeyCode;		/* Key code (5-bit) */
+		uint8_t		PgLfoStep;		/* LFO PM step of the cached phase increment (5-bit) */
+
+		uint8_t		EgPhase;		/* Envelope phase */
+		uint8_t		KeyState;		/* Key on/off state */
+		uint8_t		KeyLatch;		/* Latched key on/off flag */
+		uint8_t		CsmLatch;		/* Latched CSM key on/off flag */
+		uint8_t		SsgEgInvOut;	/* SSG-EG Inverted output flag */
+		uint8_t		EgHold;			/* Envelope level holds until the next phase transition */
+
+		/* Register state */
+		uint8_t		Detune;			/* Detune (3-bit) */
+		uint8_t		Multi;			/* Multiplier (4-bit) */
+		uint8_t		KeyScale;		/* Key scale (2-bit) */
+		uint16_t	TotalLevel;		/* Total level (7-bit) */
+		uint16_t	SustainLvl;		/* Sustain level (4-bit) */
+		uint8_t		EgRate[4];		/* Envelope rates (5-bit) */
+		uint8_t		EgScaledRate[4];/* Key scaled envelope rates (6-bit), cached until the rates or key code change */
+		uint8_t		AmOn;			/* LFO-AM on/off mask */
+
+		uint8_t		SsgEnable;		/* SSG-EG Enable flag */
+		uint8_t		SsgEgInv;		/* SSG-EG Inversion mode flag */
+		uint8_t		SsgEgAlt;		/* SSG-EG Alternate mode flag */
+		uint8_t		SsgEgHld;		/* SSG-EG Hold mode flag */
 	};
 
 	/* Channel data type */
 	struct channel_t
 	{
-		uint32_t	FNum;			/* Frequency Nr. (11-bit) */
-		uint32_t	Block;			/* Block (3-bit) */
-		uint32_t	KeyCode;		/* Key code (5-bit) */
-		uint32_t	Algo;			/* Algorithm (3-bit) */
-		uint32_t	AMS;			/* LFO-AM sensitivity (2-bit) */
-		uint32_t	PMS;			/* LFO-PM sensitivity (3-bit) */
-		uint32_t	FB;				/* Feedback (3-bit) */
+		uint16_t	FNum;			/* Frequency Nr. (11-bit) */
+		uint8_t		Block;			/* Block (3-bit) */
+		uint8_t		KeyCode;		/* Key code (5-bit) */
+		uint8_t		Algo;			/* Algorithm (3-bit) */
+		uint8_t		AMS;			/* LFO-AM sensitivity (2-bit) */
+		uint8_t		PMS;			/* LFO-PM sensitivity (3-bit) */
+		uint8_t		FB;				/* Feedback (3-bit) */
 		uint32_t	MaskL;			/* Channel L output mask */
 		uint32_t	MaskR;			/* Channel R output mask */
 	};
@@ -99,13 +103,8 @@ namespace YM::OPN /* Yamaha - FM Operator Type-N */
 		uint32_t	Step;			/* Step counter (7-bit) */
 	};
 
-	static uint16_t ExpTable[256];
-	static uint16_t SineTable[512];
-	static uint32_t LfoAmTable[128][4];
-	static  int32_t LfoPmTable[128][32][8];
-
 	/* Note table */
-	static const uint32_t Note[16] =
+	inline constexpr uint32_t Note[16] =
 	{
 		/*
 		This table uses the upper 4 bits of FNUM(F11 - F8) to
@@ -126,7 +125,7 @@ namespace YM::OPN /* Yamaha - FM Operator Type-N */
 	};
 
 	/* Detune table */
-	static const int32_t Detune[32][8] =
+	inline constexpr int32_t Detune[32][8] =
 	{
 		/*
 		This table uses the 5-bit keycode and 3-bit detune
@@ -171,7 +170,7 @@ namespace YM::OPN /* Yamaha - FM Operator Type-N */
 	};
 
 	/* Envelope counter shift table */
-	static const uint32_t EgShift[64] =
+	inline constexpr uint32_t EgShift[64] =
 	{
 		11, 11, 11, 11,
 		10, 10, 10, 10,
@@ -191,8 +190,11 @@ namespace YM::OPN /* Yamaha - FM Operator Type-N */
 		0,  0,  0,  0
 	};
 
+	/* Envelope rate schedule (see GenerateEgSchedule) */
+	inline constexpr eg_schedule_t EgSchedule = GenerateEgSchedule(EgShift);
+
 	/* Envelope generator level adjust table */
-	static const uint32_t EgLevelAdjust[64][8] =
+	inline constexpr uint32_t EgLevelAdjust[64][8] =
 	{
 		/* EG timing calculations: https://github.com/michelgerritse/YM-research */
 		{0,0,0,0,0,0,0,0}, {0,0,0,0,0,0,0,0}, {0,1,0,1,0,1,0,1}, {0,1,0,1,0,1,0,1}, /* Rate 00 - 03 */
@@ -217,7 +219,7 @@ namespace YM::OPN /* Yamaha - FM Operator Type-N */
 	};
 
 	/* LFO period table */
-	static const uint32_t LfoPeriod[8] =
+	inline constexpr uint32_t LfoPeriod[8] =
 	{
 		/*
 			This table defines the period (in samples) of a given frequency
@@ -241,142 +243,184 @@ namespace YM::OPN /* Yamaha - FM Operator Type-N */
 		109, 78, 72, 68, 63, 45, 9, 6
 	};
 
-	/* Build all OPL related tables */
-	static void BuildTables()
+	/* LFO AM shift table */
+	inline constexpr uint32_t LfoAmShift[4] =
 	{
-		static bool Initialized = false;
+		/*
+			This table is used to calculate the LFO AM attenuation adjustment
+			The following values are valid (YM2608 manual page 33):
+			0 =    0 dB (valid bits: 0x00)
+			1 =  1.4 dB (valid bits: 0x0F)
+			2 =  5.9 dB (valid bits: 0x3F)
+			3 = 11.8 dB (valid bits: 0x7E)
 
-		if (!Initialized)
-		{
-			/*
-				Build sine & exponent tables
-			*/
-			for (uint32_t i = 0; i < 256; i++)
-			{
-				SineTable[i + 000] = YM::GenerateSine(i, 256);
-				SineTable[i + 256] = YM::GenerateSine(i ^ 0xFF, 256);
+			Weighting of each valid bit is:
+			6dB - 3dB - 1.5dB - 0.75dB - 0.375dB - 0.1875dB - 0.09375dB
 
-				ExpTable[i] = (GenerateExponent(i ^ 0xFF) | 0x400) << 2;
-			}
+			The AM wave runs from 126 -> 0 -> 126 (7-bit)
+			This creates an inverted triangular shaped wave.
 
-			/*
-				Build LFO-AM table
-			*/
+			At the maximum amplitude, the AM adjustment should be 0x7E.
 
-			/* LFO AM shift table */
-			const uint32_t LfoAmShift[4] =
-			{
-				/*
-					This table is used to calculate the LFO AM attenuation adjustment
-					The following values are valid (YM2608 manual page 33):
-					0 =    0 dB (valid bits: 0x00)
-					1 =  1.4 dB (valid bits: 0x0F)
-					2 =  5.9 dB (valid bits: 0x3F)
-					3 = 11.8 dB (valid bits: 0x7E)
+			The following function is used to calculate the AM adjustment
 
-					Weighting of each valid bit is:
-					6dB - 3dB - 1.5dB - 0.75dB - 0.375dB - 0.1875dB - 0.09375dB
+			VolumeAdjust(dB) = AM phase >> AM shift
 
-					The AM wave runs from 126 -> 0 -> 126 (7-bit)
-					This creates an inverted triangular shaped wave.
+			Since we know what the resulting value (dB) will be (see above),
+			we can now get the shift values used in the calculation
+		*/
 
-					At the maximum amplitude, the AM adjustment should be 0x7E.
+		7, 3, 1, 0
+	};
 
-					The following function is used to calculate the AM adjustment
+	/* LFO PM shift table 1 */
+	inline constexpr uint32_t LfoPmShift1[8][8] =
+	{
+		/*
+		Credits to nukeykt:
+		https://github.com/nukeykt/Nuked-OPN2
+		*/
+		{ 7, 7, 7, 7, 7, 7, 7, 7 },	/* PMS = 0 */
+		{ 7, 7, 7, 7, 7, 7, 7, 7 },	/* PMS = 1 */
+		{ 7, 7, 7, 7, 7, 7, 1, 1 },	/* PMS = 2 */
+		{ 7, 7, 7, 7, 1, 1, 1, 1 },	/* PMS = 3 */
+		{ 7, 7, 7, 1, 1, 1, 1, 0 },	/* PMS = 4 */
+		{ 7, 7, 1, 1, 0, 0, 0, 0 },	/* PMS = 5 */
+		{ 7, 7, 1, 1, 0, 0, 0, 0 },	/* PMS = 6 */
+		{ 7, 7, 1, 1, 0, 0, 0, 0 }	/* PMS = 7 */
+	};
 
-					VolumeAdjust(dB) = AM phase >> AM shift
+	/* LFO PM shift table 2 */
+	inline constexpr uint32_t LfoPmShift2[8][8] =
+	{
+		/*
+		Credits to nukeykt:
+		https://github.com/nukeykt/Nuked-OPN2
+		*/
+		{ 7, 7, 7, 7, 7, 7, 7, 7 },	/* PMS = 0 */
+		{ 7, 7, 7, 7, 2, 2, 2, 2 },	/* PMS = 1 */
+		{ 7, 7, 7, 2, 2, 2, 7, 7 },	/* PMS = 2 */
+		{ 7, 7, 2, 2, 7, 7, 2, 2 },	/* PMS = 3 */
+		{ 7, 7, 2, 7, 7, 7, 2, 7 },	/* PMS = 4 */
+		{ 7, 7, 7, 2, 7, 7, 2, 1 },	/* PMS = 5 */
+		{ 7, 7, 7, 2, 7, 7, 2, 1 },	/* PMS = 6 */
+		{ 7, 7, 7, 2, 7, 7, 2, 1 }	/* PMS = 7 */
+	};
 
-					Since we know what the resulting value (dB) will be (see above),
-					we can now get the shift values used in the calculation
-				*/
+	/* LFO PM shift table 3 */
+	inline constexpr uint32_t LfoPmShift3[8] =
+	{
+		2, 2, 2, 2, 2, 2, 1, 0
+	};
 
-				7, 3, 1, 0
-			};
+	/* Exponent table */
+	inline constexpr auto ExpTable = []
+	{
+		std::array<uint16_t, 256> Table{};
 
-			for (auto lfo = 0; lfo < 128; lfo++)
-			{
-				/*
-					The LFO AM waveform is an inverted triangle (128 steps)
-					It runs from 126 -> 0 -> 126 (adjusted 2 per step)
-				*/
-				uint32_t step;
+		/*
+			Build exponent table:
+			1. Reverse the original table
+			2. Set the implicit bit10
+			3. Shift left by 2
+		*/
+		for (uint32_t i = 0; i < 256; i++)
+		{
+			Table[i] = (YM::GenerateExponent(i ^ 0xFF) | 0x400) << 2;
+		}
 
-				if (lfo & 0x40) step = (lfo & 0x3F) << 1;
-				else step = (lfo ^ 0x3F) << 1;
+		return Table;
+	}();
 
-				for (auto ams = 0; ams < 4; ams++)
-				{
-					YM::OPN::LfoAmTable[lfo][ams] = step >> LfoAmShift[ams];
-				}
-			}
+	/* Sine table (1st and 2nd quarter) */
+	inline constexpr auto SineTable = []
+	{
+		std::array<uint16_t, 512> Table{};
+
+		for (uint32_t i = 0; i < 256; i++)
+		{
+			Table[i + 000] = YM::GenerateSine(i);
+			Table[i + 256] = YM::GenerateSine(i ^ 0xFF);
+		}
 
+		return Table;
+	}();
+
+	/* LFO-AM table */
+	inline constexpr auto LfoAmTable = []
+	{
+		std::array<std::array<uint8_t, 4>, 128> Table{};
+
+		for (auto lfo = 0; lfo < 128; lfo++)
+		{
 			/*
-				Build LFO-PM table
+				The LFO AM waveform is an inverted triangle (128 steps)
+				It runs from 126 -> 0 -> 126 (adjusted 2 per step)
 			*/
+			uint32_t step;
+
+			if (lfo & 0x40) step = (lfo & 0x3F) << 1;
+			else step = (lfo ^ 0x3F) << 1;
 
-			/* LFO PM shift table 1 */
-			const uint32_t LfoPmShift1[8][8] =
+			for (auto ams = 0; ams < 4; ams++)
 			{
-				/*
-				Credits to nukeykt:
-				https://github.com/nukeykt/Nuked-OPN2
-				*/
-				{ 7, 7, 7, 7, 7, 7, 7, 7 },	/* PMS = 0 */
-				{ 7, 7, 7, 7, 7, 7, 7, 7 },	/* PMS = 1 */
-				{ 7, 7, 7, 7, 7, 7, 1, 1 },	/* PMS = 2 */
-				{ 7, 7, 7, 7, 1, 1, 1, 1 },	/* PMS = 3 */
-				{ 7, 7, 7, 1, 1, 1, 1, 0 },	/* PMS = 4 */
-				{ 7, 7, 1, 1, 0, 0, 0, 0 },	/* PMS = 5 */
-				{ 7, 7, 1, 1, 0, 0, 0, 0 },	/* PMS = 6 */
-				{ 7, 7, 1, 1, 0, 0, 0, 0 }	/* PMS = 7 */
-			};
-
-			/* LFO PM shift table 2 */
-			const uint32_t LfoPmShift2[8][8] =
+				Table[lfo][ams] = step >> LfoAmShift[ams];
+			}
+		}
+
+		return Table;
+	}();
+
+	/* LFO-PM table (1st quarter of the waveform) */
+	inline constexpr auto LfoPmTable = []
+	{
+		std::array<std::array<std::array<uint8_t, 8>, 8>, 128> Table{};
+
+		for (auto fnum = 0; fnum < 128; fnum++)
+		{
+			for (auto step = 0; step < 8; step++)
 			{
 				/*
-				Credits to nukeykt:
-				https://github.com/nukeykt/Nuked-OPN2
-				*/
-				{ 7, 7, 7, 7, 7, 7, 7, 7 },	/* PMS = 0 */
-				{ 7, 7, 7, 7, 2, 2, 2, 2 },	/* PMS = 1 */
-				{ 7, 7, 7, 2, 2, 2, 7, 7 },	/* PMS = 2 */
-				{ 7, 7, 2, 2, 7, 7, 2, 2 },	/* PMS = 3 */
-				{ 7, 7, 2, 7, 7, 7, 2, 7 },	/* PMS = 4 */
-				{ 7, 7, 7, 2, 7, 7, 2, 1 },	/* PMS = 5 */
-				{ 7, 7, 7, 2, 7, 7, 2, 1 },	/* PMS = 6 */
-				{ 7, 7, 7, 2, 7, 7, 2, 1 }	/* PMS = 7 */
-			};
-
-			/* LFO PM shift table 3 */
-			const uint32_t LfoPmShift3[8] =
-			{
-				2, 2, 2, 2, 2, 2, 1, 0
-			};
+					The LFO PM waveform is a triangle (32 steps)
+					It runs from 0 -> 7 -> 0 -> -7 -> 0
 
-			for (auto fnum = 0; fnum < 128; fnum++)
-			{
-				for (auto lfo = 0; lfo < 32; lfo++)
+					The 2nd quarter mirrors the 1st one and the 2nd half is the negated 1st half,
+					only the 1st quarter is stored (see GetLfoPm)
+				*/
+				for (auto pms = 0; pms < 8; pms++)
 				{
-					/*
-						The LFO PM waveform is a triangle (32 steps)
-						It runs from 0 -> 7 -> 0 -> -7 -> 0
-					*/
-					uint32_t step = lfo & 0x0F;
-					if (lfo & 0x08) step = lfo ^ 0x0F;
-
-					for (auto pms = 0; pms < 8; pms++)
-					{
-						int32_t value = (fnum >> LfoPmShift1[pms][step]) + (fnum >> LfoPmShift2[pms][step]);
-						value >>= LfoPmShift3[pms];
-
-						YM::OPN::LfoPmTable[fnum][lfo][pms] = (lfo & 0x10) ? -value : value;
-					}
+					uint32_t value = (fnum >> LfoPmShift1[pms][step]) + (fnum >> LfoPmShift2[pms][step]);
+
+					Table[fnum][step][pms] = value >> LfoPmShift3[pms];
 				}
 			}
-
-			Initialized = true;
 		}
+
+		return Table;
+	}();
+
+	/* LFO-PM frequency adjustment, FNum = 7-bit (12-bit FNum >> 5), Step = LFO-PM step (5-bit) */
+	constexpr int32_t GetLfoPm(uint32_t FNum, uint32_t Step, uint32_t PMS)
+	{
+		/* Mirror the 2nd quarter */
+		uint32_t Index = Step & 0x07;
+		if (Step & 0x08) Index ^= 0x07;
+
+		int32_t Value = LfoPmTable[FNum][Index][PMS];
+
+		/* Negate the 2nd half */
+		return (Step & 0x10) ? -Value : Value;
+	}
+
+	/* A slot is idle when it is keyed off, fully released and its output history is silent.
+	   Envelope, phase and operator updates leave an idle slot unchanged (the phase counter
+	   is reset on key on) so they can be skipped until the next key event */
+	inline bool IsIdle(const operator_t& Slot)
+	{
+		if ((Slot.KeyState | Slot.KeyLatch | Slot.CsmLatch | Slot.SsgEgInvOut) != 0) return false;
+		if ((Slot.EgLevel != MaxAttenuation) || (Slot.EgOutput != (MaxAttenuation << 2))) return false;
+
+		return (Slot.Output[0] | Slot.Output[1]) == 0;
 	}
 }
 #endif // !_YM_OPN_H_
\ No newline at end of file
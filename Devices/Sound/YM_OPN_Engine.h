@@ -0,0 +1,1193 @@
+/*
+ _____    _ _            ___
+|_   _| _(_) |_ ___ _ _ / __|___ _ _ ___
+  | || '_| |  _/ _ \ ' \ (__/ _ \ '_/ -_)
+  |_||_| |_|\__\___/_||_\___\___/_| \___|
+
+Copyright  2024, Michel Gerritse
+All rights reserved.
+
+This source code is available under the BSD-3-Clause license.
+See LICENSE.txt in the root directory of this source tree.
+
+*/
+#ifndef _YM_OPN_ENGINE_H_
+#define _YM_OPN_ENGINE_H_
+
+#include "../../TritonCore.h"
+#include "YM_OPN.h"
+
+#define VGM_WORKAROUND /* Workaround for VGM files */
+
+namespace YM::OPN
+{
+	/* Slot naming */
+	enum SlotName : uint32_t
+	{
+		S1 = 0, S2, S3, S4
+	};
+
+	/* Envelope phases */
+	enum ADSR : uint32_t
+	{
+		Attack = 0,
+		Decay,
+		Sustain,
+		Release
+	};
+
+	/* Status register bits */
+	constexpr uint8_t FlagTimerA = 0x01;	/* Timer A overflow */
+	constexpr uint8_t FlagTimerB = 0x02;	/* Timer B overflow */
+
+	/* Channel (CH1 - CH6) to channel index, -1 if the channel is not present */
+	constexpr int32_t ChannelIndex(uint32_t ChannelMask, uint32_t Channel)
+	{
+		return ((ChannelMask >> Channel) & 1) ? std::popcount(ChannelMask & ((1u << Channel) - 1)) : -1;
+	}
+
+	/* DAC discontinuity table */
+	inline constexpr auto DacDiscontinuity = []
+	{
+		std::array<int16_t, 512> Table{};
+
+		for (uint16_t i = 0; i < 512; i++)
+		{
+			/*
+			TODO: This needs validation... will need real voltage measurements
+			https://docs.google.com/document/d/1ST9GbFfPnIjLT5loytFCm3pB0kWQ1Oe34DCBBV8saY8/pub
+			*/
+
+			int16_t DacOut = i & 0xFF;
+
+			if (i & 256) /* Negative output */
+			{
+				DacOut -= 256;
+				DacOut -= 3;
+			}
+			else /* Positive output */
+			{
+				/* Do we need to apply an offset on the positive side ? */
+				DacOut += 0;
+			}
+
+			Table[i] = DacOut << 5; /* Signed 9 to 14-bit */
+		}
+
+		return Table;
+	}();
+
+	/* Modulation input of an algorithm (slot output, Delay 1 = output of the previous sample) */
+	constexpr int8_t In(uint32_t SlotId, uint32_t Delay)
+	{
+		return (int8_t)((SlotId << 1) | Delay);
+	}
+
+	/* Algorithm connections: the modulation inputs of every slot (summed and halved), -1 = no input
+	   S1 always uses self feedback. The slots are updated in the order S1, S3, S2, S4, so an input
+	   updated later in the sample is taken from the previous sample */
+	inline constexpr int8_t Connections[8][4][2] =
+	{
+		{ { -1, -1 }, { In(S1, 0), -1 }, { In(S2, 0), -1 },        { In(S3, 0), -1 }        }, /* Algo: 0 - S1 > S2 > S3 > S4 */
+		{ { -1, -1 }, { -1, -1 },        { In(S1, 1), In(S2, 0) }, { In(S3, 0), -1 }        }, /* Algo: 1 - (S1 + S2) > S3 > S4 */
+		{ { -1, -1 }, { -1, -1 },        { In(S2, 0), -1 },        { In(S1, 0), In(S3, 0) } }, /* Algo: 2 - (S1 + (S2 > S3)) > S4 */
+		{ { -1, -1 }, { In(S1, 0), -1 }, { -1, -1 },               { In(S2, 1), In(S3, 0) } }, /* Algo: 3 - ((S1 > S2) + S3) > S4 */
+		{ { -1, -1 }, { In(S1, 0), -1 }, { -1, -1 },               { In(S3, 0), -1 }        }, /* Algo: 4 - (S1 > S2) + (S3 > S4) */
+		{ { -1, -1 }, { In(S1, 0), -1 }, { In(S1, 1), -1 },        { In(S1, 0), -1 }        }, /* Algo: 5 - S1 > (S2 + S3 + S4) */
+		{ { -1, -1 }, { In(S1, 0), -1 }, { -1, -1 },               { -1, -1 }               }, /* Algo: 6 - (S1 > S2) + S3 + S4 */
+		{ { -1, -1 }, { -1, -1 },        { -1, -1 },               { -1, -1 }               }  /* Algo: 7 - S1 + S2 + S3 + S4 */
+	};
+
+	/* Algorithm carriers: the slots summed into the channel output (bit n = slot n) */
+	inline constexpr uint32_t Carriers[8] =
+	{
+		0x08, 0x08, 0x08, 0x08, 0x0A, 0x0E, 0x0E, 0x0F
+	};
+
+	/* FM unit of the OPN family (timers, LFO, slots and the channel accumulator)
+
+	The devices own the register decoding of their other units (SSG, ADPCM), the
+	prescalers and the final mix. The configuration is fixed at compile time:
+
+	- ChannelMask:			Channels present (bit 0 = CH1 ... bit 5 = CH6), CH4 - CH6 are on port 1
+	- OutputBits:			Channel output resolution (14 = mono, 13 = stereo, 9 = DAC with ladder effect)
+	- HasLFO:				LFO unit and the PMS / AMS / Panning registers
+	- HasSCH:				SCH mode (CH4 - CH6 are only keyed and mixed in 6-channel mode)
+	- HasDAC:				CH6 can be replaced by the DAC data register
+	- EgCounterBug:			The EG counter overflows into bit 0, causing it to never reach 0
+	- EgClockPerChannel:	A channel updates its envelope on the EG clock cycle matching its index
+
+	All data is plain, the engine can be saved and restored as a whole
+	*/
+	template<
+		uint32_t ChannelMask,
+		uint32_t OutputBits,
+		bool HasLFO,
+		bool HasSCH,
+		bool HasDAC,
+		bool EgCounterBug,
+		bool EgClockPerChannel
+	>
+	class Engine
+	{
+	public:
+		static_assert((OutputBits == 9) || (OutputBits == 13) || (OutputBits == 14), "Unsupported output resolution");
+		static_assert((ChannelMask & 0x04) != 0, "CH3 is required for 3CH and CSM mode");
+
+		/* Number of channels */
+		static constexpr uint32_t Channels = std::popcount(ChannelMask);
+
+		/* Channel index of CH3 (3CH / CSM mode) */
+		static constexpr uint32_t CH3 = ChannelIndex(ChannelMask, 2);
+
+		YM::OPN::operator_t	Slot[Channels * 4];
+		YM::OPN::channel_t	Channel[Channels];
+		YM::OPN::timer_t	TimerA;
+		YM::OPN::timer_t	TimerB;
+		YM::OPN::lfo_t		LFO;
+
+		uint32_t	EgCounter;			/* EG counter (12-bit) */
+		uint32_t	EgClock;			/* EG clock (/3 divisor) */
+		uint64_t	EgRates;			/* Envelope rates updated at the EG counter (bit n = rate n) */
+		int32_t		OutL;				/* Accumulator output (L, mono devices use L only) */
+		int32_t		OutR;				/* Accumulator output (R) */
+		int16_t		DacData;			/* DAC Data (9-bit) */
+		uint8_t		DacSelect;			/* DAC Select flag */
+		uint8_t		Mode3CH;			/* 3CH Mode enable flag */
+		uint8_t		ModeCSM;			/* CSM Mode enable flag */
+		uint8_t		ModeSCH;			/* SCH Mode enable flag */
+		uint8_t		Status;				/* Status register (8-bit) */
+		uint8_t		FlagCtrl;			/* Flag control register (8-bit) */
+		uint8_t		IrqEnable;			/* IRQ enable flags */
+		uint32_t	PgDirty;			/* Slots with a stale frequency / phase increment (bit n = slot n) */
+
+		/* Register latches */
+		uint16_t	FnumLatch;			/* Fnum latch (3-bit) */
+		uint16_t	FnumLatch3CH;		/* Fnum latch 3CH (3-bit) */
+		uint8_t		BlockLatch;			/* Block latch (3-bit) */
+		uint8_t		BlockLatch3CH;		/* Block latch 3CH (3-bit) */
+		uint16_t	Fnum3CH[3];			/* 3CH Frequency Nr. (11-bit) */
+		uint8_t		Block3CH[3];		/* 3CH Block (3-bit) */
+		uint8_t		KeyCode3CH[3];		/* 3CH Key code (5-bit) */
+
+		/* Reset to the power on state, the device sets up its flag control / IRQ enable defaults */
+		void Reset()
+		{
+			memset(this, 0, sizeof(*this));
+
+			/* Default general register state */
+			LFO.Period = YM::OPN::LfoPeriod[0];
+			PgDirty = ~0;
+			EgRates = YM::GetEgRates(YM::OPN::EgSchedule, EgCounter);
+
+			/* Default operator register state */
+			for (auto& Op : Slot)
+			{
+				Op.Multi = 1; /* x0.5 */
+				Op.EgPhase = ADSR::Release;
+				Op.EgLevel = 0x3FF;
+			}
+
+			/* Default channel register state */
+			for (auto& Chan : Channel)
+			{
+				/* All channels are ON by default for OPN compatibility */
+				Chan.MaskL = ~0;
+				Chan.MaskR = ~0;
+			}
+		}
+
+		/* Write mode register data (0x20 - 0x2F) */
+		void WriteMode(uint8_t Address, uint8_t Data, TC::DeviceStats& Stats)
+		{
+			switch (Address)
+			{
+			case 0x21: /* LSI Test */
+				/* Not implemented */
+				break;
+
+			case 0x22: /* LFO Control */
+				if constexpr (HasLFO)
+				{
+					LFO.Enable = (Data & 0x08) ? ~0 : 0; /* Note: implemented as a mask */
+					LFO.Period = YM::OPN::LfoPeriod[Data & 0x07];
+				}
+				break;
+
+			case 0x24: /* Timer A [9:2] */
+				TimerA.Period &= 0x03;
+				TimerA.Period |= (Data << 2);
+				break;
+
+			case 0x25: /* Timer A [1:0] */
+				TimerA.Period &= 0x3FC;
+				TimerA.Period |= (Data & 0x03);
+				break;
+
+			case 0x26: /* Timer B */
+				TimerB.Period = Data;
+				break;
+
+			case 0x27: /* 3CH mode / Timer control */
+			{
+				/* Timer A and B start / stop */
+				auto StartA = (Data >> 0) & 0x01;
+				auto StartB = (Data >> 1) & 0x01;
+
+				if (TimerA.Load ^ StartA)
+				{
+					TimerA.Load = StartA;
+					TimerA.Counter = 1024 - TimerA.Period;
+				}
+
+				if (TimerB.Load ^ StartB)
+				{
+					TimerB.Load = StartB;
+					TimerB.Counter = (256 - TimerB.Period) << 4; /* Note: period x16 to sync with Timer A */
+				}
+
+				/* Timer A/B enable */
+				TimerA.Enable = (Data >> 2) & 0x01;
+				TimerB.Enable = (Data >> 3) & 0x01;
+
+				/* Timer A/B overflow flag reset */
+				if (Data & 0x10) ClearStatusFlags(FlagTimerA);
+				if (Data & 0x20) ClearStatusFlags(FlagTimerB);
+
+				/* 3CH / CSM mode, switching 3CH mode changes the frequency of CH3 slots S1 - S3 */
+				if (Mode3CH != (((Data & 0xC0) != 0x00) ? 1 : 0)) PgDirty |= 0x0Fu << (CH3 << 2);
+
+				Mode3CH = ((Data & 0xC0) != 0x00) ? 1 : 0;
+				ModeCSM = ((Data & 0xC0) == 0x80) ? 1 : 0;
+				break;
+			}
+
+			case 0x28: /* Key On/Off */
+			{
+				uint32_t Index = Data & 0x03;
+
+				if (Index == 0x03) break; /* Invalid channel */
+
+				if ((ChannelMask > 0x07) && (Data & 0x04)) /* Port 1 channels */
+				{
+					if constexpr (HasSCH)
+					{
+						if (ModeSCH == 0) break; /* We're in OPN compatibility mode */
+					}
+
+					Index += 3;
+				}
+
+				if (ChannelIndex(ChannelMask, Index) < 0) break; /* Channel not present */
+
+				uint32_t ChannelId = ChannelIndex(ChannelMask, Index) << 2;
+
+				Slot[ChannelId + S1].KeyLatch = (Data >> 4) & 0x01;
+				Slot[ChannelId + S2].KeyLatch = (Data >> 5) & 0x01;
+				Slot[ChannelId + S3].KeyLatch = (Data >> 6) & 0x01;
+				Slot[ChannelId + S4].KeyLatch = (Data >> 7) & 0x01;
+
+#ifdef VGM_WORKAROUND
+				/*	Note: This is a work-around as key events should not be procesed here.
+					Some VGM files write consecutive key-on / key-off data without a render update in between.
+					This causes latched key data, which has not yet been processed, to be overwritten
+				*/
+				ProcessKeyEvent(ChannelId + S1, Stats);
+				ProcessKeyEvent(ChannelId + S2, Stats);
+				ProcessKeyEvent(ChannelId + S3, Stats);
+				ProcessKeyEvent(ChannelId + S4, Stats);
+#endif // VGM_WORKAROUND
+				break;
+			}
+
+			case 0x29: /* SCH / IRQ Enable */
+				if constexpr (HasSCH)
+				{
+					ModeSCH   = (Data >> 7) & 0x01;
+					IrqEnable = (Data >> 0) & 0x1F;
+				}
+				break;
+
+			case 0x2A: /* DAC data */
+				if constexpr (HasDAC)
+				{
+					DacData &= 0x01;
+					DacData |= (Data << 1);
+				}
+				break;
+
+			case 0x2B: /* DAC select */
+				if constexpr (HasDAC)
+				{
+					DacSelect = Data >> 7;
+				}
+				break;
+
+			case 0x2C: /* LSI Test 2 */
+				if constexpr (HasDAC)
+				{
+					DacData &= ~0x01;
+					DacData |= ((Data >> 3) & 0x01);
+				}
+				break;
+
+			case 0x2D: /* Prescaler selection (/6) */
+			case 0x2E: /* Prescaler selection (/3) */
+			case 0x2F: /* Prescaler selection (/2) */
+				/* Note: the prescalers are owned by the device */
+				break;
+
+			default: /* Not used */
+				break;
+			}
+		}
+
+		/* Write slot / channel register data (0x30 - 0xB6) */
+		void WriteFM(uint8_t Address, uint8_t Port, uint8_t Data)
+		{
+			/* Slot address mapping: S1 - S3 - S2 - S4, -1 = no slot */
+			static constexpr auto SlotMap = []
+			{
+				constexpr uint32_t Order[4] = { S1, S3, S2, S4 };
+
+				std::array<int32_t, 32> Map{};
+
+				for (uint32_t i = 0; i < 32; i++)
+				{
+					uint32_t Index = ((i >> 4) * 3) + (i & 0x03);
+
+					if (((i & 0x03) == 0x03) || (ChannelIndex(ChannelMask, Index) < 0))
+						Map[i] = -1;
+					else
+						Map[i] = (ChannelIndex(ChannelMask, Index) << 2) + Order[(i >> 2) & 0x03];
+				}
+
+				return Map;
+			}();
+
+			int32_t SlotId = SlotMap[((Port & 0x01) << 4) | (Address & 0x0F)];
+			if (SlotId == -1) return;
+
+			if (Address < 0xA0) /* Slot register map (0x30 - 0x9F) */
+			{
+				auto& Op = Slot[SlotId];
+
+				switch (Address & 0xF0)
+				{
+				case 0x30: /* Detune / Multiply */
+					Op.Detune = (Data >> 4) & 0x07;
+					Op.Multi = (Data & 0x0F) << 1;
+					if (Op.Multi == 0) Op.Multi = 1;
+					PgDirty |= 1u << SlotId;
+					break;
+
+				case 0x40: /* Total Level */
+					Op.TotalLevel = (Data & 0x7F) << 3;
+					break;
+
+				case 0x50: /* Key Scale / Attack Rate */
+					Op.KeyScale = (Data >> 6);
+					Op.EgRate[ADSR::Attack] = Data & 0x1F;
+					UpdateScaledRates(SlotId);
+					break;
+
+				case 0x60: /* Decay Rate / AM On */
+					Op.AmOn = (Data & 0x80) ? ~0 : 0; /* Note: AM On/Off is implemented as a mask */
+					Op.EgRate[ADSR::Decay] = Data & 0x1F;
+					UpdateScaledRates(SlotId);
+					break;
+
+				case 0x70: /* Sustain Rate */
+					Op.EgRate[ADSR::Sustain] = Data & 0x1F;
+					UpdateScaledRates(SlotId);
+					break;
+
+				case 0x80: /* Sustain Level / Release Rate */
+					/* If all SL bits are set, SL is 93dB. See YM2608 manual page 28 */
+					Op.SustainLvl = (Data >> 4) & 0x0F;
+					Op.SustainLvl |= (Op.SustainLvl + 1) & 0x10;
+					Op.SustainLvl <<= 5;
+
+					/* Map RR from 4 to 5 bits, with LSB always set to 1 */
+					Op.EgRate[ADSR::Release] = ((Data & 0x0F) << 1) | 0x01;
+					UpdateScaledRates(SlotId);
+					break;
+
+				case 0x90: /* SSG-EG Envelope Control */
+					Op.SsgEnable = (Data >> 3) & 0x01;
+					Op.SsgEgInv = (Data >> 2) & 0x01;
+					Op.SsgEgAlt = (Data >> 1) & 0x01;
+					Op.SsgEgHld = (Data >> 0) & 0x01;
+					break;
+				}
+			}
+			else /* Channel register map (0xA0 - 0xB6) */
+			{
+				auto& Chan = Channel[SlotId >> 2];
+
+				switch (Address & 0xFC)
+				{
+				case 0xA0: /* F-Num 1 */
+					Chan.FNum = FnumLatch | Data;
+					Chan.Block = BlockLatch;
+					Chan.KeyCode = (Chan.Block << 2) | YM::OPN::Note[Chan.FNum >> 7];
+					PgDirty |= 0x0Fu << (SlotId & ~0x03);
+					break;
+
+				case 0xA4: /* F-Num 2 / Block Latch */
+					FnumLatch = (Data & 0x07) << 8;
+					BlockLatch = (Data >> 3) & 0x07;
+					break;
+
+				case 0xA8: /* 3 Ch-3 F-Num  */
+					if (Port == 0)
+					{
+						/* Slot order for 3CH mode */
+						if (Address == 0xA9)
+						{
+							Fnum3CH[S1] = FnumLatch3CH | Data;
+							Block3CH[S1] = BlockLatch3CH;
+							KeyCode3CH[S1] = (Block3CH[S1] << 2) | YM::OPN::Note[Fnum3CH[S1] >> 7];
+						}
+						else if (Address == 0xA8)
+						{
+							Fnum3CH[S3] = FnumLatch3CH | Data;
+							Block3CH[S3] = BlockLatch3CH;
+							KeyCode3CH[S3] = (Block3CH[S3] << 2) | YM::OPN::Note[Fnum3CH[S3] >> 7];
+						}
+						else /* 0xAA */
+						{
+							Fnum3CH[S2] = FnumLatch3CH | Data;
+							Block3CH[S2] = BlockLatch3CH;
+							KeyCode3CH[S2] = (Block3CH[S2] << 2) | YM::OPN::Note[Fnum3CH[S2] >> 7];
+						}
+
+						PgDirty |= 0x0Fu << (CH3 << 2);
+					}
+					break;
+
+				case 0xAC: /* 3 Ch-3 F-Num / Block Latch */
+					if (Port == 0)
+					{
+						FnumLatch3CH = (Data & 0x07) << 8;
+						BlockLatch3CH = (Data >> 3) & 0x07;
+					}
+					break;
+
+				case 0xB0: /* Feedback / Connection */
+					Chan.FB = (Data >> 3) & 0x07;
+					Chan.Algo = Data & 0x07;
+					break;
+
+				case 0xB4: /* PMS / AMS / Panning */
+					if constexpr (HasLFO)
+					{
+						Chan.MaskL = (Data & 0x80) ? ~0 : 0;
+						Chan.MaskR = (Data & 0x40) ? ~0 : 0;
+						Chan.AMS = (Data >> 4) & 0x03;
+						Chan.PMS = Data & 0x07;
+						PgDirty |= 0x0Fu << (SlotId & ~0x03);
+					}
+					break;
+				}
+			}
+		}
+
+		/* Restore a range of slot / channel registers (0x30 - 0xB6) from a register dump
+		   The F-Num 2 / Block latches (0xA4 - 0xA6, 0xAC - 0xAE) are written before their F-Num 1 register */
+		void WriteFMRange(uint32_t Address, uint8_t Port, const uint8_t* Data, size_t Count)
+		{
+			uint32_t End = (uint32_t)std::min<size_t>(Address + Count, 0x100);
+
+			for (uint32_t Reg = std::max<uint32_t>(Address, 0x30); Reg < End; Reg++)
+			{
+				if ((Reg & 0xF0) == 0xA0)
+				{
+					if (Reg & 0x04) /* Latch, already written if its F-Num 1 register is part of the range */
+					{
+						if ((Reg - 4) >= Address) continue;
+					}
+					else if ((Reg + 4) < End)
+					{
+						WriteFM(Reg + 4, Port, Data[Reg + 4 - Address]);
+					}
+				}
+
+				WriteFM(Reg, Port, Data[Reg - Address]);
+			}
+		}
+
+		void SetStatusFlags(uint8_t Flags)
+		{
+			Status |= Flags & ~FlagCtrl;
+		}
+
+		void ClearStatusFlags(uint8_t Flags)
+		{
+			Status &= ~Flags;
+		}
+
+		/* Interrupt output, active while an enabled status flag is set (the device reports it) */
+		inline bool IsIrqAsserted() const
+		{
+			return (Status & IrqEnable) != 0;
+		}
+
+		/* Samples until the next timer overflow that sets a status flag, 0 if none is pending */
+		uint32_t GetSamplesToTimerEvent() const
+		{
+			uint32_t Samples = UINT32_MAX;
+
+			if (TimerA.Load && TimerA.Enable) Samples = std::min(Samples, TimerA.Counter);
+			if (TimerB.Load && TimerB.Enable) Samples = std::min(Samples, TimerB.Counter);
+
+			return (Samples != UINT32_MAX) ? Samples : 0;
+		}
+
+		/* True if all slots are idle and stay idle without a register write (CSM mode keys on CH3) */
+		bool IsIdle() const
+		{
+			if (ModeCSM && TimerA.Load) return false;
+
+			for (auto& Op : Slot) if (!YM::OPN::IsIdle(Op)) return false;
+
+			return true;
+		}
+
+		/* Update Timer A, Timer B, LFO and the envelope counter (once per sample) */
+		void UpdateCounters()
+		{
+			UpdateTimers();
+			if constexpr (HasLFO) UpdateLFO();
+
+			/* Update envelope clock */
+			EgClock = (EgClock + 1) % 3;
+
+			/* Update envelope counter */
+			if constexpr (EgCounterBug)
+			{
+				EgCounter += (EgClock >> 1);
+				EgCounter += (EgCounter >> 12); /* Overflow bug in the OPN unit */
+				EgCounter &= 0xFFF;
+			}
+			else
+			{
+				EgCounter = (EgCounter + (EgClock >> 1)) & 0xFFF;
+			}
+
+			EgRates = YM::GetEgRates(YM::OPN::EgSchedule, EgCounter);
+		}
+
+		/* Update all slots (operators), idle slots are skipped. Returns the number of active slots */
+		/* Skip = muted channels (bit n = channel n), their operator units are not updated */
+		uint32_t UpdateSlots(bool Render, TC::DeviceStats& Stats, uint32_t Skip = 0)
+		{
+			/* Channel kernels, selected by the algorithm register */
+			static constexpr uint32_t (Engine::*Kernels[8])(uint32_t, bool, TC::DeviceStats&, uint32_t) =
+			{
+				&Engine::UpdateChannel<0>, &Engine::UpdateChannel<1>, &Engine::UpdateChannel<2>, &Engine::UpdateChannel<3>,
+				&Engine::UpdateChannel<4>, &Engine::UpdateChannel<5>, &Engine::UpdateChannel<6>, &Engine::UpdateChannel<7>
+			};
+
+			uint32_t Active = 0;
+
+			/* The slots of a channel only depend on each other, the channels are updated one by one */
+			for (uint32_t ChannelId = 0; ChannelId < Channels; ChannelId++)
+			{
+				Active += (this->*Kernels[Channel[ChannelId].Algo])(ChannelId, Render, Stats, Skip);
+			}
+
+			return Active;
+		}
+
+		/* Channel kernel of an algorithm, the 4 slots in slot order (S1, S3, S2, S4) with the connections
+		   resolved at compile time. Returns the number of active slots */
+		template<uint32_t Algo>
+		uint32_t UpdateChannel(uint32_t ChannelId, bool Render, TC::DeviceStats& Stats, uint32_t Skip)
+		{
+			uint32_t Active = 0;
+
+			Active += UpdateChannelSlot<Algo, S1>(ChannelId << 2, Render, Stats, Skip);
+			Active += UpdateChannelSlot<Algo, S3>(ChannelId << 2, Render, Stats, Skip);
+			Active += UpdateChannelSlot<Algo, S2>(ChannelId << 2, Render, Stats, Skip);
+			Active += UpdateChannelSlot<Algo, S4>(ChannelId << 2, Render, Stats, Skip);
+
+			return Active;
+		}
+
+		template<uint32_t Algo, uint32_t S>
+		inline uint32_t UpdateChannelSlot(uint32_t Base, bool Render, TC::DeviceStats& Stats, uint32_t Skip)
+		{
+			uint32_t SlotId = Base + S;
+
+			/* Note: key on writes use the prepared key code, also for idle slots */
+			PrepareSlot(SlotId);
+
+			if (YM::OPN::IsIdle(Slot[SlotId])) return 0;
+
+			UpdatePhaseGenerator(SlotId);
+			UpdateEnvelopeGenerator(SlotId, Stats);
+			if (Render && !IsSkipped(SlotId, Skip)) UpdateOperatorUnit(SlotId, Modulation<Algo, S>(Base));
+
+			return 1;
+		}
+
+		/* Approximate update of all slots for a render below the native rate (not bit exact)
+		   The phase generators advance Ticks samples at once and the operator units are updated once,
+		   the envelope generators are updated separately (see UpdateEnvelopes). Returns the number of active slots */
+		uint32_t UpdateSlotsFast(uint32_t Ticks, bool Render, uint32_t Skip = 0)
+		{
+			static constexpr uint32_t Order[4] = { S1, S3, S2, S4 };
+
+			uint32_t Active = 0;
+
+			for (auto& Op : Order)
+			{
+				for (uint32_t SlotId = Op; SlotId < (Channels * 4); SlotId += 4)
+				{
+					PrepareSlot(SlotId);
+
+					if (YM::OPN::IsIdle(Slot[SlotId])) continue;
+
+					Active++;
+					UpdatePhaseGenerator(SlotId, Ticks);
+					if (Render && !IsSkipped(SlotId, Skip)) UpdateOperatorUnit(SlotId);
+				}
+			}
+
+			return Active;
+		}
+
+		/* Approximate envelope update for a render below the native rate (not bit exact), call once
+		   per sample after UpdateCounters. The envelope generators only run on their EG clock cycle,
+		   key events and SSG-EG repeats are processed up to 2 samples late */
+		void UpdateEnvelopes(TC::DeviceStats& Stats)
+		{
+			if (!EgClockPerChannel && (EgClock != 2)) return;
+
+			for (uint32_t SlotId = 0; SlotId < (Channels * 4); SlotId++)
+			{
+				if (EgClock != (EgClockPerChannel ? (SlotId >> 2) : 2)) continue;
+
+				PrepareSlot(SlotId);
+
+				if (YM::OPN::IsIdle(Slot[SlotId])) continue;
+
+				UpdateEnvelopeGenerator(SlotId, Stats);
+			}
+		}
+
+		/* The operators of a muted channel are skipped, except S1 with feedback enabled (the feedback
+		   depends on all of its previous outputs). The other operators only use the outputs of the last
+		   2 samples, a channel is exact again after 2 samples when it is unmuted */
+		bool IsSkipped(uint32_t SlotId, uint32_t Skip) const
+		{
+			if (((Skip >> (SlotId >> 2)) & 1) == 0) return false;
+
+			return ((SlotId & 0x03) != S1) || (Channel[SlotId >> 2].FB == 0);
+		}
+
+		/* Sum the channel outputs, ChannelOut (optional) receives the output of every channel before panning
+		   Silent = muted channels (bit n = channel n), their output is 0 */
+		void UpdateAccumulator(uint32_t Active, int16_t* ChannelOut = nullptr, uint32_t Silent = 0)
+		{
+			OutL = 0;
+			OutR = 0;
+
+			if (ChannelOut != nullptr) std::fill_n(ChannelOut, Channels, int16_t(0));
+
+			/* Without active slots the accumulator stays silent */
+			if ((Active == 0) && !(HasDAC && DacSelect)) return;
+
+			for (uint32_t ChannelId = 0; ChannelId < Channels; ChannelId++)
+			{
+				if constexpr (HasSCH)
+				{
+					if ((ChannelId > CH3) && (ModeSCH == 0)) break; /* 6-channel mode disabled */
+				}
+
+				if ((Silent >> ChannelId) & 1) continue;
+
+				int16_t Output = AccumulateChannel(ChannelId);
+
+				if (ChannelOut != nullptr) ChannelOut[ChannelId] = Output;
+			}
+		}
+
+		/* Copy the frequency of a slot and cache its phase increment, only done after a register write
+		   changed it (see PgDirty) */
+		void PrepareSlot(uint32_t SlotId)
+		{
+			if (((PgDirty >> SlotId) & 1) == 0) return;
+
+			PgDirty &= ~(1u << SlotId);
+
+			uint32_t ChannelId = SlotId >> 2;
+			auto& Chan = Channel[ChannelId];
+			auto& Op = Slot[SlotId];
+
+			/* Copy some values for later processing */
+			Op.FNum = Chan.FNum;
+			Op.Block = Chan.Block;
+			Op.KeyCode = Chan.KeyCode;
+
+			if (Mode3CH)
+			{
+				auto i = SlotId & 3;
+
+				/* Get Block/FNum for channel 3: S1-S2-S3 */
+				if ((ChannelId == CH3) && (i != S4))
+				{
+					Op.FNum = Fnum3CH[i];
+					Op.Block = Block3CH[i];
+					Op.KeyCode = KeyCode3CH[i];
+				}
+			}
+
+			Op.PgIncrement = CalculateIncrement(SlotId);
+
+			/* The key scaled rates follow the key code */
+			UpdateScaledRates(SlotId);
+		}
+
+		/* Ticks = number of samples to advance (fast render) */
+		void UpdatePhaseGenerator(uint32_t SlotId, uint32_t Ticks = 1)
+		{
+			auto& Op = Slot[SlotId];
+
+			/* With vibrato the increment follows the LFO PM step (PMS = 0 has no frequency modulation) */
+			if constexpr (HasLFO)
+			{
+				if ((Channel[SlotId >> 2].PMS != 0) && (Op.PgLfoStep != (LFO.Step >> 2))) Op.PgIncrement = CalculateIncrement(SlotId);
+			}
+
+			/* Update phase counter (20-bit) */
+			Op.PgPhase = (Op.PgPhase + (Op.PgIncrement * Ticks)) & 0xFFFFF;
+		}
+
+		/* Phase increment of a slot (20-bit) at the current LFO PM step */
+		uint32_t CalculateIncrement(uint32_t SlotId)
+		{
+			auto& Chan = Channel[SlotId >> 2];
+			auto& Op = Slot[SlotId];
+
+			uint32_t FNum = Op.FNum << 1; /* 11 to 12-bit */
+
+			/* LFO frequency modulation (12-bit result) */
+			if constexpr (HasLFO)
+			{
+				Op.PgLfoStep = LFO.Step >> 2;
+				FNum = (FNum + YM::OPN::GetLfoPm(FNum >> 5, Op.PgLfoStep, Chan.PMS)) & 0xFFF;
+			}
+
+			/* Block shift (17-bit result) */
+			uint32_t Inc = (FNum << Op.Block) >> 2;
+
+			/* Detune (17-bit result, might overflow) */
+			Inc = (Inc + YM::OPN::Detune[Op.KeyCode][Op.Detune]) & 0x1FFFF;
+
+			/* Multiply (20-bit result) */
+			return (Inc * Op.Multi) >> 1;
+		}
+
+		void UpdateEnvelopeGenerator(uint32_t SlotId, TC::DeviceStats& Stats)
+		{
+			uint32_t ChannelId = SlotId >> 2;
+			auto& Chan = Channel[ChannelId];
+			auto& Op = Slot[SlotId];
+
+			/*-------------------------------------*/
+			/* Step 0: Key On / Off event handling */
+			/*-------------------------------------*/
+			ProcessKeyEvent(SlotId, Stats);
+
+			/*-----------------------------*/
+			/* Step 1: SSG-EG update cycle */
+			/*-----------------------------*/
+			if ((Op.EgLevel >> 9) & Op.SsgEnable)
+			{
+				if (Op.KeyState) /* Attack, decay or sustain phase */
+				{
+					if (Op.SsgEgHld) /* Hold mode */
+					{
+						/* Set output inversion to the hold state */
+						Op.SsgEgInvOut = Op.SsgEgInv ^ Op.SsgEgAlt;
+					}
+					else /* Repeating mode */
+					{
+						StartEnvelope(SlotId);
+
+						/* Flip output inversion flag (if alternating) */
+						Op.SsgEgInvOut ^= Op.SsgEgAlt;
+
+						/* Restart the phase counter when we are repeating normally (not alternating) */
+						//if (Op.SsgEgAlt == 0) Op.PgPhase = 0;
+						Op.PgPhase &= ~(Op.SsgEgAlt - 1);
+					}
+				}
+				else /* Release phase */
+				{
+					/* Force the EG attenuation to maximum when we hit 0x200 during release */
+					Op.EgLevel = 0x3FF;
+				}
+			}
+
+			/*-------------------------------*/
+			/* Step 2: Envelope update cycle */
+			/*-------------------------------*/
+			if ((EgClock == (EgClockPerChannel ? ChannelId : 2)) && !Op.EgHold)
+			{
+				/* When attacking, move to the decay phase when attenuation level is minimal */
+				if ((Op.EgPhase | Op.EgLevel) == 0)
+				{
+					Op.EgPhase = ADSR::Decay;
+				}
+
+				/* If we reached the sustain level, move to the sustain phase */
+				if ((Op.EgPhase == ADSR::Decay) && (Op.EgLevel >= Op.SustainLvl))
+				{
+					Op.EgPhase = ADSR::Sustain;
+				}
+
+				/* Get key scaled rate */
+				uint32_t Rate = Op.EgScaledRate[Op.EgPhase];
+
+				if ((EgRates >> Rate) & 1) /* Counter overflowed */
+				{
+					uint16_t Level = Op.EgLevel;
+
+					/* Get update cycle (8 cycles in total) */
+					uint32_t Cycle = (EgCounter >> YM::OPN::EgShift[Rate]) & 0x07;
+
+					/* Lookup attenuation adjustment */
+					uint32_t AttnInc = YM::OPN::EgLevelAdjust[Rate][Cycle];
+
+					if (Op.EgPhase == ADSR::Attack) /* Exponential attack */
+					{
+						if (Rate < 62)
+						{
+							Level += ((~Level * AttnInc) >> 4);
+						}
+					}
+					else /* Linear decay */
+					{
+						/* When SSG-EG is active, don't update once we hit 0x200 */
+						if (((Level >> 9) & Op.SsgEnable) == 0)
+						{
+							Level += AttnInc << (Op.SsgEnable << 1);
+
+							/* Limit to maximum attenuation */
+							if (Level > 0x3FF) Level = 0x3FF;
+						}
+					}
+
+					Op.EgLevel = Level;
+				}
+
+				/* Sustain and release have no phase transitions, the level holds once it can no
+				   longer change (maximum attenuation or a rate without level adjustments) */
+				Op.EgHold = (Op.EgPhase >= ADSR::Sustain) && ((Op.EgLevel == 0x3FF) || (Rate < 2));
+			}
+
+			/*-------------------------------------*/
+			/* Step 3: Envelope output calculation */
+			/*-------------------------------------*/
+			uint32_t Attn = Op.EgLevel;
+
+			/* Apply SGG-EG output inversion */
+			if (Op.SsgEgInvOut) Attn = (0x200 - Attn) & 0x3FF;
+
+			/* Apply total level */
+			Attn += Op.TotalLevel;
+
+			/* Apply AM LFO */
+			if constexpr (HasLFO) Attn += (YM::OPN::LfoAmTable[LFO.Step][Chan.AMS] & Op.AmOn);
+
+			/* Limit (10-bit = 4.6 fixed point) */
+			if (Attn > 0x3FF) Attn = 0x3FF;
+
+			/* Convert from 4.6 to 4.8 fixed point */
+			Op.EgOutput = Attn << 2;
+		}
+
+		void UpdateOperatorUnit(uint32_t SlotId)
+		{
+			UpdateOperatorUnit(SlotId, GetModulation(SlotId));
+		}
+
+		void UpdateOperatorUnit(uint32_t SlotId, int16_t Modulation)
+		{
+			auto& Op = Slot[SlotId];
+
+			/* Phase modulation (10-bit) */
+			uint32_t Phase = (Op.PgPhase >> 10) + Modulation;
+
+			/* Attenuation (4.8 + 4.8 = 5.8 fixed point) */
+			uint32_t Level = YM::OPN::SineTable[Phase & 0x1FF] + Op.EgOutput;
+
+			/* dB to linear conversion (13-bit) */
+			int16_t Output = YM::OPN::ExpTable[Level & 0xFF] >> (Level >> 8);
+
+			/* Negate output (14-bit) */
+			if (Phase & 0x200) Output = -Output;
+
+			/* The last 2 generated samples are stored */
+			Op.Output[1] = Op.Output[0];
+			Op.Output[0] = Output;
+		}
+
+		int16_t GetModulation(uint32_t Cycle)
+		{
+			static constexpr int16_t (Engine::*Kernels[8])(uint32_t) const =
+			{
+				&Engine::GetModulation<0>, &Engine::GetModulation<1>, &Engine::GetModulation<2>, &Engine::GetModulation<3>,
+				&Engine::GetModulation<4>, &Engine::GetModulation<5>, &Engine::GetModulation<6>, &Engine::GetModulation<7>
+			};
+
+			return (this->*Kernels[Channel[Cycle >> 2].Algo])(Cycle);
+		}
+
+		template<uint32_t Algo>
+		int16_t GetModulation(uint32_t Cycle) const
+		{
+			uint32_t ChanId = Cycle & ~0x03;
+
+			switch (Cycle & 0x03)
+			{
+			case S1: return Modulation<Algo, S1>(ChanId);
+			case S2: return Modulation<Algo, S2>(ChanId);
+			case S3: return Modulation<Algo, S3>(ChanId);
+			default: return Modulation<Algo, S4>(ChanId);
+			}
+		}
+
+		/* Phase modulation of slot S (10-bit), Base = S1 of the channel */
+		template<uint32_t Algo, uint32_t S>
+		inline int16_t Modulation(uint32_t Base) const
+		{
+			constexpr int8_t A = Connections[Algo][S][0];
+			constexpr int8_t B = Connections[Algo][S][1];
+
+			if constexpr (S == S1)
+			{
+				uint32_t FB = Channel[Base >> 2].FB;
+
+				/* Slot 1 self-feedback modulation (10-bit) */
+				return FB ? (Slot[Base].Output[0] + Slot[Base].Output[1]) >> (10 - FB) : 0;
+			}
+			else if constexpr (A < 0)
+			{
+				return 0;
+			}
+			else if constexpr (B < 0)
+			{
+				return Slot[Base + (A >> 1)].Output[A & 1] >> 1;
+			}
+			else
+			{
+				return (Slot[Base + (A >> 1)].Output[A & 1] + Slot[Base + (B >> 1)].Output[B & 1]) >> 1;
+			}
+		}
+
+	private:
+		int16_t AccumulateChannel(uint32_t ChannelId)
+		{
+			int16_t Output = 0;
+			uint32_t SlotId = ChannelId << 2;
+
+			if (HasDAC && (ChannelId == (Channels - 1)) && DacSelect)
+			{
+				Output = DacData - 0x100;
+			}
+			else
+			{
+				static constexpr int16_t (Engine::*Kernels[8])(uint32_t) const =
+				{
+					&Engine::SumCarriers<0>, &Engine::SumCarriers<1>, &Engine::SumCarriers<2>, &Engine::SumCarriers<3>,
+					&Engine::SumCarriers<4>, &Engine::SumCarriers<5>, &Engine::SumCarriers<6>, &Engine::SumCarriers<7>
+				};
+
+				/* Accumulate output */
+				Output = (this->*Kernels[Channel[ChannelId].Algo])(SlotId);
+			}
+
+			if constexpr (OutputBits == 9)
+			{
+				/* Limit (signed 9-bit) */
+				Output = std::clamp<int16_t>(Output, -256, 255);
+
+				/* Generate DAC output */
+				Output = DacDiscontinuity[Output & 0x1FF];
+			}
+			else
+			{
+				/* Limit (signed 14-bit) and reduce to the output resolution */
+				Output = std::clamp<int16_t>(Output, -8192, 8191) >> (14 - OutputBits);
+			}
+
+			/* Mix channel output */
+			OutL += Output & Channel[ChannelId].MaskL;
+			OutR += Output & Channel[ChannelId].MaskR;
+
+			return Output;
+		}
+
+		/* Sum of the carrier outputs of a channel, Base = S1 of the channel */
+		template<uint32_t Algo>
+		int16_t SumCarriers(uint32_t Base) const
+		{
+			/* Operator outputs are reduced to the DAC resolution before they are summed */
+			constexpr uint32_t Shift = (OutputBits == 9) ? 5 : 0;
+
+			int16_t Output = 0;
+
+			if constexpr (Carriers[Algo] & (1 << S1)) Output += Slot[Base + S1].Output[0] >> Shift;
+			if constexpr (Carriers[Algo] & (1 << S2)) Output += Slot[Base + S2].Output[0] >> Shift;
+			if constexpr (Carriers[Algo] & (1 << S3)) Output += Slot[Base + S3].Output[0] >> Shift;
+			if constexpr (Carriers[Algo] & (1 << S4)) Output += Slot[Base + S4].Output[0] >> Shift;
+
+			return Output;
+		}
+
+		/* Cache the key scaled rates of a slot, done when its rates or key code change */
+		void UpdateScaledRates(uint32_t SlotId)
+		{
+			auto& Op = Slot[SlotId];
+
+			for (uint32_t i = 0; i < 4; i++) Op.EgScaledRate[i] = CalculateRate(Op.EgRate[i], Op.KeyCode, Op.KeyScale);
+
+			/* A held envelope might change at the new rate */
+			Op.EgHold = 0;
+		}
+
+		uint8_t CalculateRate(uint8_t Rate, uint8_t KeyCode, uint8_t KeyScale)
+		{
+			uint8_t ScaledRate = 0;
+
+			/* YM2608 manual page 30 */
+			if (Rate != 0)
+			{
+				/* Calculate key scale value */
+				uint8_t KSV = KeyCode >> (3 - KeyScale);
+
+				/* Calculate key scaled rate */
+				ScaledRate = (Rate << 1) + KSV;
+
+				/* Limit to a max. of 63 */
+				if (ScaledRate > 63) ScaledRate = 63;
+			}
+
+			return ScaledRate;
+		}
+
+		void ProcessKeyEvent(uint32_t SlotId, TC::DeviceStats& Stats)
+		{
+			auto& Op = Slot[SlotId];
+
+			/* Get latched key on/off state */
+			uint32_t NewState = (Op.KeyLatch | Op.CsmLatch);
+
+			/* Clear CSM key on flag */
+			Op.CsmLatch = 0;
+
+			if (Op.KeyState ^ NewState)
+			{
+				Op.EgHold = 0;
+
+				if (NewState) /* Key On */
+				{
+					/* Start envelope */
+					StartEnvelope(SlotId);
+
+					/* Reset phase counter */
+					Op.PgPhase = 0;
+
+					/* Set SSG-EG inverted ouput flag to the initial state when we are in any SSG-EG inverted mode */
+					Op.SsgEgInvOut = Op.SsgEnable & Op.SsgEgInv;
+
+					Stats.KeyOn();
+				}
+				else /* Key Off */
+				{
+					/* Move envelope to release phase */
+					Op.EgPhase = ADSR::Release;
+
+					if (Op.SsgEgInvOut)
+					{
+						/* Allow the release phase to continue normally */
+						Op.EgLevel = (0x200 - Op.EgLevel) & 0x3FF;
+
+						/* Clear the SSG-EG inverted output flag */
+						Op.SsgEgInvOut = 0;
+					}
+				}
+
+				Op.KeyState = NewState;
+			}
+		}
+
+		void StartEnvelope(uint32_t SlotId)
+		{
+			auto& Op = Slot[SlotId];
+
+			/* Move envelope to attack phase */
+			Op.EgPhase = ADSR::Attack;
+			Op.EgHold = 0;
+
+			/* Instant attack */
+			if (Op.EgScaledRate[ADSR::Attack] >= 62)
+			{
+				/* Instant minimum attenuation */
+				Op.EgLevel = 0;
+			}
+		}
+
+		void UpdateLFO()
+		{
+			if (++LFO.Counter >= LFO.Period)
+			{
+				LFO.Counter = 0;
+				LFO.Step = (LFO.Step + 1) & 0x7F;
+			}
+
+			LFO.Step &= LFO.Enable;
+		}
+
+		void UpdateTimers()
+		{
+			if (TimerA.Load)
+			{
+				if (--TimerA.Counter == 0)
+				{
+					TimerA.Counter = 1024 - TimerA.Period;
+
+					/* Overflow flag enabled */
+					if (TimerA.Enable) SetStatusFlags(FlagTimerA);
+
+					/* CSM Key On */
+					if (ModeCSM)
+					{
+						/* CSM Key-On all channel 3 slots */
+						Slot[(CH3 << 2) + S1].CsmLatch = 1;
+						Slot[(CH3 << 2) + S2].CsmLatch = 1;
+						Slot[(CH3 << 2) + S3].CsmLatch = 1;
+						Slot[(CH3 << 2) + S4].CsmLatch = 1;
+					}
+				}
+			}
+
+			if (TimerB.Load)
+			{
+				if (--TimerB.Counter == 0)
+				{
+					TimerB.Counter = (256 - TimerB.Period) << 4;
+
+					/* Overflow flag enabled */
+					if (TimerB.Enable) SetStatusFlags(FlagTimerB);
+				}
+			}
+		}
+	};
+}
+
+#endif // !_YM_OPN_ENGINE_H_
\ No newline at end of file
@@ -0,0 +1,180 @@
+/*
+ _____    _ _            ___
+|_   _| _(_) |_ ___ _ _ / __|___ _ _ ___
+  | || '_| |  _/ _ \ ' \ (__/ _ \ '_/ -_)
+  |_||_| |_|\__\___/_||_\___\___/_| \___|
+
+Copyright  2024, Michel Gerritse
+All rights reserved.
+
+This source code is available under the BSD-3-Clause license.
+See LICENSE.txt in the root directory of this source tree.
+
+*/
+#include "YM_OPN_SIMD.h"
+#include "../../Core/Cpu.h"
+
+#if TC_OPN_SIMD && TC_CPU_X86
+#include <immintrin.h>
+#define OPN_SIMD_AVX2
+#endif
+
+/*
+	Vectorized OPN slot groups
+
+	Bit exact with the scalar phase generator and operator unit of the OPN cores.
+	The table lookups need gathers and the block / exponent shifts need per lane
+	shift counts, both of which are only available from AVX2 onwards. Without AVX2
+	the devices keep using their scalar path (IsSupported returns false).
+*/
+namespace YM::OPN::SIMD
+{
+#if defined(OPN_SIMD_AVX2)
+	/* 32-bit copies of the 16-bit tables (gathers load 32-bit elements) */
+	alignas(32) static constexpr auto SineTable32 = []
+	{
+		std::array<int32_t, 512> Table{};
+
+		for (uint32_t i = 0; i < 512; i++) Table[i] = SineTable[i];
+
+		return Table;
+	}();
+
+	alignas(32) static constexpr auto ExpTable32 = []
+	{
+		std::array<int32_t, 256> Table{};
+
+		for (uint32_t i = 0; i < 256; i++) Table[i] = ExpTable[i];
+
+		return Table;
+	}();
+
+	/* Byte copy of the LFO-PM table, padded for the 32-bit gathers of the last entries */
+	alignas(32) static constexpr auto LfoPmTable8 = []
+	{
+		std::array<uint8_t, (128 * 8 * 8) + 3> Table{};
+
+		for (uint32_t fnum = 0; fnum < 128; fnum++)
+		{
+			for (uint32_t step = 0; step < 8; step++)
+			{
+				for (uint32_t pms = 0; pms < 8; pms++) Table[(fnum << 6) | (step << 3) | pms] = LfoPmTable[fnum][step][pms];
+			}
+		}
+
+		return Table;
+	}();
+
+	bool IsSupported()
+	{
+		return TC::IsSupported(TC::CpuTier::AVX2);
+	}
+
+	/* LfoPmStep = LFO-PM step per lane (LfoStep >> 2) */
+	TC_TARGET_AVX2 static inline void UpdatePhaseGenerator(group_t& Group, __m256i LfoPmStep)
+	{
+		const int* LfoPm = (const int*)LfoPmTable8.data();
+		const int* Dt = &Detune[0][0];
+
+		__m256i FNum = _mm256_load_si256((const __m256i*)Group.FNum);
+		__m256i Block = _mm256_load_si256((const __m256i*)Group.Block);
+		__m256i KeyCode = _mm256_load_si256((const __m256i*)Group.KeyCode);
+		__m256i DtSel = _mm256_load_si256((const __m256i*)Group.Detune);
+		__m256i Multi = _mm256_load_si256((const __m256i*)Group.Multi);
+		__m256i PMS = _mm256_load_si256((const __m256i*)Group.PMS);
+		__m256i Phase = _mm256_load_si256((const __m256i*)Group.PgPhase);
+
+		/* 11 to 12-bit */
+		FNum = _mm256_slli_epi32(FNum, 1);
+
+		/* LFO frequency modulation (12-bit result): GetLfoPm(FNum >> 5, LfoStep >> 2, PMS) */
+		__m256i Quarter = _mm256_and_si256(LfoPmStep, _mm256_set1_epi32(0x07));
+		__m256i Mirror = _mm256_srai_epi32(_mm256_slli_epi32(LfoPmStep, 28), 31); /* Step bit 3 */
+		__m256i Negate = _mm256_srai_epi32(_mm256_slli_epi32(LfoPmStep, 27), 31); /* Step bit 4 */
+
+		Quarter = _mm256_xor_si256(Quarter, _mm256_and_si256(Mirror, _mm256_set1_epi32(0x07)));
+
+		__m256i Index = _mm256_slli_epi32(_mm256_srli_epi32(FNum, 5), 6);
+		Index = _mm256_add_epi32(Index, _mm256_slli_epi32(Quarter, 3));
+		Index = _mm256_add_epi32(Index, PMS);
+
+		__m256i Pm = _mm256_and_si256(_mm256_i32gather_epi32(LfoPm, Index, 1), _mm256_set1_epi32(0xFF));
+		Pm = _mm256_sub_epi32(_mm256_xor_si256(Pm, Negate), Negate);
+
+		FNum = _mm256_add_epi32(FNum, Pm);
+		FNum = _mm256_and_si256(FNum, _mm256_set1_epi32(0xFFF));
+
+		/* Block shift (17-bit result) */
+		__m256i Inc = _mm256_srli_epi32(_mm256_sllv_epi32(FNum, Block), 2);
+
+		/* Detune (17-bit result, might overflow) */
+		Index = _mm256_add_epi32(_mm256_slli_epi32(KeyCode, 3), DtSel);
+
+		Inc = _mm256_add_epi32(Inc, _mm256_i32gather_epi32(Dt, Index, 4));
+		Inc = _mm256_and_si256(Inc, _mm256_set1_epi32(0x1FFFF));
+
+		/* Multiply (20-bit result) */
+		Inc = _mm256_srli_epi32(_mm256_mullo_epi32(Inc, Multi), 1);
+
+		/* Update phase counter (20-bit) */
+		Phase = _mm256_and_si256(_mm256_add_epi32(Phase, Inc), _mm256_set1_epi32(0xFFFFF));
+
+		_mm256_store_si256((__m256i*)Group.PgPhase, Phase);
+	}
+
+	TC_TARGET_AVX2 void UpdatePhaseGenerator(group_t& Group, uint32_t LfoStep)
+	{
+		UpdatePhaseGenerator(Group, _mm256_set1_epi32(LfoStep >> 2));
+	}
+
+	TC_TARGET_AVX2 void UpdatePhaseGenerator(group_t& Group, const uint32_t (&LfoStep)[Lanes])
+	{
+		__m256i Step = _mm256_loadu_si256((const __m256i*)LfoStep);
+
+		UpdatePhaseGenerator(Group, _mm256_srli_epi32(Step, 2));
+	}
+
+	TC_TARGET_AVX2 void UpdateOperatorUnit(group_t& Group)
+	{
+		__m256i PgPhase = _mm256_load_si256((const __m256i*)Group.PgPhase);
+		__m256i Modulation = _mm256_load_si256((const __m256i*)Group.Modulation);
+		__m256i EgOutput = _mm256_load_si256((const __m256i*)Group.EgOutput);
+
+		/* Phase modulation (10-bit) */
+		__m256i Phase = _mm256_add_epi32(_mm256_srli_epi32(PgPhase, 10), Modulation);
+
+		/* Attenuation (4.8 + 4.8 = 5.8 fixed point) */
+		__m256i Index = _mm256_and_si256(Phase, _mm256_set1_epi32(0x1FF));
+		__m256i Level = _mm256_add_epi32(_mm256_i32gather_epi32(SineTable32.data(), Index, 4), EgOutput);
+
+		/* dB to linear conversion (13-bit) */
+		Index = _mm256_and_si256(Level, _mm256_set1_epi32(0xFF));
+		__m256i Output = _mm256_srlv_epi32(_mm256_i32gather_epi32(ExpTable32.data(), Index, 4), _mm256_srli_epi32(Level, 8));
+
+		/* Negate output (14-bit) */
+		__m256i Sign = _mm256_set1_epi32(0x200);
+		__m256i Negate = _mm256_cmpeq_epi32(_mm256_and_si256(Phase, Sign), Sign);
+
+		Output = _mm256_sub_epi32(_mm256_xor_si256(Output, Negate), Negate);
+
+		_mm256_store_si256((__m256i*)Group.Output, Output);
+	}
+#else
+	bool IsSupported()
+	{
+		return false;
+	}
+
+	void UpdatePhaseGenerator(group_t& Group, uint32_t LfoStep)
+	{
+	}
+
+	void UpdatePhaseGenerator(group_t& Group, const uint32_t (&LfoStep)[Lanes])
+	{
+	}
+
+	void UpdateOperatorUnit(group_t& Group)
+	{
+	}
+#endif
+}
\ No newline at end of file
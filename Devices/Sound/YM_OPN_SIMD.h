@@ -0,0 +1,73 @@
+/*
+ _____    _ _            ___
+|_   _| _(_) |_ ___ _ _ / __|___ _ _ ___
+  | || '_| |  _/ _ \ ' \ (__/ _ \ '_/ -_)
+  |_||_| |_|\__\___/_||_\___\___/_| \___|
+
+Copyright  2024, Michel Gerritse
+All rights reserved.
+
+This source code is available under the BSD-3-Clause license.
+See LICENSE.txt in the root directory of this source tree.
+
+*/
+#ifndef _YM_OPN_SIMD_H_
+#define _YM_OPN_SIMD_H_
+
+#include "../../TritonCore.h"
+#include "YM_OPN.h"
+
+/* Vectorized slot groups are compiled out unless TC_OPN_SIMD is set to 1
+   Note: the scalar slot loop is currently faster, the group packing (and the scalar
+   envelope generator) costs more than the vectorized phase / operator units save */
+#ifndef TC_OPN_SIMD
+#define TC_OPN_SIMD 0
+#endif
+
+namespace YM::OPN::SIMD
+{
+	/* Number of lanes in a slot group */
+	constexpr uint32_t Lanes = 8;
+
+	/* Slot group, structure of arrays
+
+	The slot order processes the same operator (S1, S3, S2, S4) of every channel
+	back to back. Modulation only crosses operators within a channel, so the slots
+	of a group don't depend on each other and their phase generator and operator
+	unit can be evaluated side by side. Unused lanes must hold valid (zero) data.
+	*/
+	struct alignas(32) group_t
+	{
+		/* Phase generator input */
+		uint32_t	FNum[Lanes];		/* Frequency Nr. (11-bit) */
+		uint32_t	Block[Lanes];		/* Block (3-bit) */
+		uint32_t	KeyCode[Lanes];		/* Key code (5-bit) */
+		uint32_t	Detune[Lanes];		/* Detune (3-bit) */
+		uint32_t	Multi[Lanes];		/* Multiplier */
+		uint32_t	PMS[Lanes];			/* LFO-PM sensitivity (3-bit) */
+
+		/* Phase generator state */
+		uint32_t	PgPhase[Lanes];		/* Phase counter (20-bit) */
+
+		/* Operator unit input */
+		int32_t		Modulation[Lanes];	/* Phase modulation (10-bit) */
+		uint32_t	EgOutput[Lanes];	/* Envelope output (12-bit) */
+
+		/* Operator unit output */
+		int32_t		Output[Lanes];		/* Operator output (14-bit) */
+	};
+
+	/* Returns true if the host CPU can run the vectorized slot groups (AVX2) */
+	bool IsSupported();
+
+	/* Update the phase counters of a slot group (LFO step: 7-bit) */
+	void UpdatePhaseGenerator(group_t& Group, uint32_t LfoStep);
+
+	/* Update the phase counters of a slot group, every lane with its own LFO step (slots of different chips) */
+	void UpdatePhaseGenerator(group_t& Group, const uint32_t (&LfoStep)[Lanes]);
+
+	/* Calculate the operator outputs of a slot group */
+	void UpdateOperatorUnit(group_t& Group);
+}
+
+#endif // !_YM_OPN_SIMD_H_
\ No newline at end of file
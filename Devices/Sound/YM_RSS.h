@@ -57,7 +57,7 @@ const uint16_t InstrumentOffsets[] =
 };
 
 /* RSS 8KB instrument ROM */
-static const uint8_t InstrumentROM[0x2000] =
+inline constexpr uint8_t InstrumentROM[0x2000] =
 {
 	/* Bass drum */
 	0x88, 0x08, 0x08, 0x08, 0x00, 0x88, 0x16, 0x76, 0x99, 0xB8, 0x22, 0x3A, 0x84, 0x3C, 0xB1, 0x54,
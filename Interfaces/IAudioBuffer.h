@@ -14,7 +14,11 @@ See LICENSE.txt in the root directory of this source tree.
 #ifndef _IAUDIO_BUFFER_H_
 #define _IAUDIO_BUFFER_H_
 
+#include <algorithm>
+#include <cstddef>
 #include <cstdint>
+#include <type_traits>
+#include <vector>
 
 enum AudioFormat : uint32_t
 {
@@ -29,6 +33,253 @@ struct __declspec(novtable) IAudioBuffer
 	virtual void WriteSampleS16(int16_t Sample) = 0;
 	virtual void WriteSampleS32(int32_t Sample) = 0;
 	virtual void WriteSampleF32(float Sample) = 0;
+
+	/* Block writes (interleaved samples, Count = frames x channels)
+	   The default implementation forwards each sample to the per-sample methods,
+	   hosts should override these to copy the whole block at once */
+	virtual void WriteSamplesS16(const int16_t* Samples, size_t Count)
+	{
+		for (size_t i = 0; i < Count; i++) WriteSampleS16(Samples[i]);
+	}
+
+	virtual void WriteSamplesS32(const int32_t* Samples, size_t Count)
+	{
+		for (size_t i = 0; i < Count; i++) WriteSampleS32(Samples[i]);
+	}
+
+	virtual void WriteSamplesF32(const float* Samples, size_t Count)
+	{
+		for (size_t i = 0; i < Count; i++) WriteSampleF32(Samples[i]);
+	}
+};
+
+/* Local sample block used by the sound devices
+   Samples are gathered on the stack and committed to the audio buffer in bulk,
+   either when the block is full or when the block goes out of scope.
+   A null audio buffer discards all samples */
+template<typename T, size_t Size = 1024>
+class AudioBlock
+{
+	static_assert(std::is_same_v<T, int16_t> || std::is_same_v<T, int32_t> || std::is_same_v<T, float>, "Unsupported sample type");
+
+public:
+	AudioBlock(IAudioBuffer* Buffer) :
+		m_Buffer(Buffer),
+		m_Count(0)
+	{
+	}
+
+	~AudioBlock()
+	{
+		Commit();
+	}
+
+	AudioBlock(const AudioBlock&) = delete;
+	AudioBlock& operator=(const AudioBlock&) = delete;
+
+	inline void Write(T Sample)
+	{
+		m_Samples[m_Count++] = Sample;
+
+		if (m_Count == Size) Commit();
+	}
+
+	void Commit()
+	{
+		if (m_Buffer == nullptr) m_Count = 0;
+		if (m_Count == 0) return;
+
+		if constexpr (std::is_same_v<T, int16_t>)
+			m_Buffer->WriteSamplesS16(m_Samples, m_Count);
+		else if constexpr (std::is_same_v<T, int32_t>)
+			m_Buffer->WriteSamplesS32(m_Samples, m_Count);
+		else
+			m_Buffer->WriteSamplesF32(m_Samples, m_Count);
+
+		m_Count = 0;
+	}
+
+private:
+	IAudioBuffer*	m_Buffer;
+	size_t			m_Count;
+	T				m_Samples[Size];
+};
+
+/* Compile time audio sink, any type with a Write(T) method for one sample at a time (eg. AudioBlock).
+   Devices with a static dispatch Update (see YM2612) write straight to the sink, so a host that knows
+   the device and sink types at compile time gets the sample writes inlined in the render loop */
+template<typename S, typename T>
+concept AudioSink = requires(S& Sink, T Sample)
+{
+	Sink.Write(Sample);
+};
+
+/* Local sample blocks for the per-voice outputs of a device (see ISoundDevice::SetChannelOutputs)
+   Every frame writes one mono 16-bit sample per voice, the blocks of voices without an
+   audio buffer are discarded */
+template<size_t Voices, size_t Size = 256>
+class AudioTaps
+{
+public:
+	/* The voice outputs are OutBuffer[First] ... OutBuffer[First + Voices - 1] */
+	AudioTaps(const std::vector<IAudioBuffer*>& OutBuffer, size_t First, bool Enable) :
+		m_Active(false),
+		m_Count(0)
+	{
+		for (size_t i = 0; i < Voices; i++)
+		{
+			m_Buffer[i] = (Enable && ((First + i) < OutBuffer.size())) ? OutBuffer[First + i] : nullptr;
+			m_Active |= (m_Buffer[i] != nullptr);
+		}
+	}
+
+	~AudioTaps()
+	{
+		Commit();
+	}
+
+	AudioTaps(const AudioTaps&) = delete;
+	AudioTaps& operator=(const AudioTaps&) = delete;
+
+	/* At least one voice output has an audio buffer */
+	inline bool IsActive() const
+	{
+		return m_Active;
+	}
+
+	/* Write one frame, Samples[n] = voice n */
+	inline void Write(const int16_t* Samples)
+	{
+		for (size_t i = 0; i < Voices; i++) m_Samples[i][m_Count] = Samples[i];
+
+		if (++m_Count == Size) Commit();
+	}
+
+	void Commit()
+	{
+		if (m_Count == 0) return;
+
+		for (size_t i = 0; i < Voices; i++)
+		{
+			if (m_Buffer[i] != nullptr) m_Buffer[i]->WriteSamplesS16(m_Samples[i], m_Count);
+		}
+
+		m_Count = 0;
+	}
+
+private:
+	IAudioBuffer*	m_Buffer[Voices];
+	bool			m_Active;
+	size_t			m_Count;
+	int16_t			m_Samples[Voices][Size];
+};
+
+/* Convert a device accumulator to an output sample (Bits = accumulator width, full scale = 1 << (Bits - 1))
+   S16 and S32 samples are limited to full scale, F32 samples are not limited (full scale = +/- 1.0) */
+template<typename T, uint32_t Bits = 16>
+inline T OutputSample(int32_t Sample)
+{
+	static_assert((Bits >= 16) && (Bits <= 32), "Unsupported accumulator width");
+
+	if constexpr (std::is_same_v<T, int16_t>)
+		return (int16_t)std::clamp(Sample >> (Bits - 16), -32768, 32767);
+	else if constexpr (std::is_same_v<T, int32_t>)
+		return (int32_t)std::clamp<int64_t>((int64_t)Sample * (1ll << (32 - Bits)), INT32_MIN, INT32_MAX);
+	else
+		return (float)Sample * (1.0f / (float)(1ull << (Bits - 1)));
+}
+
+/* Audio buffer that writes straight into host memory (eg. the buffer of an audio callback), used with
+   ISoundDevice::Render the device output lands in the host buffer without an intermediate copy.
+   Samples are stored interleaved in the order they are written (Count = frames x channels), samples
+   of another format are converted (full scale = full scale). Samples beyond the capacity are dropped */
+template<typename T>
+class SampleSpan : public IAudioBuffer
+{
+	static_assert(std::is_same_v<T, int16_t> || std::is_same_v<T, int32_t> || std::is_same_v<T, float>, "Unsupported sample type");
+
+public:
+	SampleSpan(T* Samples, size_t Count) :
+		m_Samples(Samples),
+		m_Capacity(Count),
+		m_Count(0)
+	{
+	}
+
+	/* Continue at the start of a new host buffer */
+	void Reset(T* Samples, size_t Count)
+	{
+		m_Samples = Samples;
+		m_Capacity = Count;
+		m_Count = 0;
+	}
+
+	/* Samples written */
+	size_t GetCount() const
+	{
+		return m_Count;
+	}
+
+	void WriteSampleS16(int16_t Sample)
+	{
+		if (m_Count < m_Capacity) m_Samples[m_Count++] = Convert(Sample);
+	}
+
+	void WriteSampleS32(int32_t Sample)
+	{
+		if (m_Count < m_Capacity) m_Samples[m_Count++] = Convert(Sample);
+	}
+
+	void WriteSampleF32(float Sample)
+	{
+		if (m_Count < m_Capacity) m_Samples[m_Count++] = Convert(Sample);
+	}
+
+	void WriteSamplesS16(const int16_t* Samples, size_t Count)
+	{
+		WriteSamples(Samples, Count);
+	}
+
+	void WriteSamplesS32(const int32_t* Samples, size_t Count)
+	{
+		WriteSamples(Samples, Count);
+	}
+
+	void WriteSamplesF32(const float* Samples, size_t Count)
+	{
+		WriteSamples(Samples, Count);
+	}
+
+private:
+	template<typename U>
+	static inline T Convert(U Sample)
+	{
+		if constexpr (std::is_same_v<T, U>)
+			return Sample;
+		else if constexpr (std::is_same_v<U, float>)
+			return OutputSample<T, 32>((int32_t)std::clamp(Sample * 2147483648.0f, -2147483648.0f, 2147483520.0f));
+		else if constexpr (std::is_same_v<U, int16_t>)
+			return OutputSample<T, 16>(Sample);
+		else
+			return OutputSample<T, 32>(Sample);
+	}
+
+	template<typename U>
+	void WriteSamples(const U* Samples, size_t Count)
+	{
+		Count = std::min(Count, m_Capacity - m_Count);
+
+		if constexpr (std::is_same_v<T, U>)
+			std::copy_n(Samples, Count, m_Samples + m_Count);
+		else
+			std::transform(Samples, Samples + Count, m_Samples + m_Count, [](U Sample) { return Convert(Sample); });
+
+		m_Count += Count;
+	}
+
+	T*		m_Samples;
+	size_t	m_Capacity;
+	size_t	m_Count;
 };
 
 #endif // !_IAUDIO_BUFFER_H_
\ No newline at end of file
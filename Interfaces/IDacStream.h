@@ -0,0 +1,193 @@
+/*
+ _____    _ _            ___
+|_   _| _(_) |_ ___ _ _ / __|___ _ _ ___
+  | || '_| |  _/ _ \ ' \ (__/ _ \ '_/ -_)
+  |_||_| |_|\__\___/_||_\___\___/_| \___|
+
+Copyright  2024, Michel Gerritse
+All rights reserved.
+
+This source code is available under the BSD-3-Clause license.
+See LICENSE.txt in the root directory of this source tree.
+
+*/
+#ifndef _IDAC_STREAM_H_
+#define _IDAC_STREAM_H_
+
+#include "TritonCore.h"
+
+/* DAC stream description */
+struct DAC_STREAM_DESC
+{
+	const uint8_t*	Data;		/* Host owned sample data, has to stay valid while the stream is active */
+	size_t			Size;		/* Data size in bytes */
+	uint32_t		Register;	/* Destination register (device specific) */
+	uint32_t		Frequency;	/* Samples per second */
+	uint32_t		Step;		/* Samples to advance after each sample (0 or 1 = every sample) */
+	uint32_t		Base;		/* First sample */
+	uint32_t		Length;		/* Samples to play (0 = up to the end of the data) */
+	bool			Loop;		/* Restart at the first sample after the last one */
+};
+
+/* Device side DAC stream
+   Samples are fetched from the device sample loop: Prepare once per update with the
+   device sample rate, then Tick once per device sample. Samples are little endian,
+   Width bytes each. When the stream runs faster than the device, the samples in between
+   are dropped (like the writes of a host would be) */
+class DacStream
+{
+public:
+	DacStream()
+	{
+		Stop();
+	}
+
+	/* Returns false if there is nothing to play */
+	bool Start(const DAC_STREAM_DESC& Desc, uint32_t Width)
+	{
+		Stop();
+
+		if ((Desc.Data == nullptr) || (Width == 0)) return false;
+
+		m_Data = Desc.Data;
+		m_Size = Desc.Size;
+		m_Width = Width;
+		m_Stride = (size_t)std::max(Desc.Step, 1u) * Width;
+		m_Base = (size_t)Desc.Base * Width;
+		m_Length = Desc.Length;
+		m_Loop = Desc.Loop;
+		m_Frequency = Desc.Frequency;
+
+		if ((m_Base + m_Width) > m_Size) return false;
+
+		Restart();
+
+		/* The first sample is due on the next device sample */
+		m_Phase = One;
+		m_Active = true;
+
+		return true;
+	}
+
+	void Stop()
+	{
+		m_Active = false;
+		m_Data = nullptr;
+		m_Size = 0;
+		m_Pos = 0;
+		m_Remaining = 0;
+		m_Phase = 0;
+		m_Increment = 0;
+	}
+
+	/* Takes effect on the next Prepare */
+	void SetFrequency(uint32_t Frequency)
+	{
+		m_Frequency = Frequency;
+	}
+
+	/* Device sample rate = ClockSpeed / Divider */
+	void Prepare(uint32_t ClockSpeed, uint32_t Divider)
+	{
+		if (ClockSpeed == 0) return;
+
+		/* 32.32 fixed point stream samples per device sample */
+		uint64_t Ratio = std::min<uint64_t>((uint64_t)m_Frequency * Divider, 0xFFFFFFFF);
+
+		m_Increment = (Ratio << 32) / ClockSpeed;
+	}
+
+	inline bool IsActive() const
+	{
+		return m_Active;
+	}
+
+	/* Advance by one device sample, returns true if a new sample is due */
+	inline bool Tick(uint32_t& Value)
+	{
+		uint64_t Due = m_Phase >> 32;
+
+		m_Phase = (m_Phase & (One - 1)) + m_Increment;
+
+		if (Due == 0) return false;
+
+		while (--Due != 0)
+		{
+			if (!Fetch(Value)) return false;
+		}
+
+		return Fetch(Value);
+	}
+
+private:
+	static constexpr uint64_t One = 1ull << 32;
+
+	void Restart()
+	{
+		m_Pos = m_Base;
+		m_Remaining = (m_Length != 0) ? m_Length : SIZE_MAX;
+	}
+
+	inline bool Fetch(uint32_t& Value)
+	{
+		if ((m_Remaining == 0) || ((m_Pos + m_Width) > m_Size))
+		{
+			if (!m_Loop)
+			{
+				Stop();
+				return false;
+			}
+
+			Restart();
+		}
+
+		Value = m_Data[m_Pos];
+
+		for (uint32_t i = 1; i < m_Width; i++) Value |= (uint32_t)m_Data[m_Pos + i] << (i * 8);
+
+		m_Pos += m_Stride;
+		m_Remaining--;
+
+		return true;
+	}
+
+	bool			m_Active;
+	const uint8_t*	m_Data;
+	size_t			m_Size;
+	size_t			m_Pos;			/* Offset of the next sample */
+	size_t			m_Base;			/* Offset of the first sample */
+	size_t			m_Stride;		/* Bytes between samples */
+	size_t			m_Length;		/* Samples per pass (0 = up to the end of the data) */
+	size_t			m_Remaining;	/* Samples left in this pass */
+	uint32_t		m_Width;		/* Bytes per sample */
+	uint32_t		m_Frequency;
+	uint64_t		m_Phase;		/* 32.32 fixed point, integer part = samples due */
+	uint64_t		m_Increment;
+	bool			m_Loop;
+};
+
+/* Abstract DAC stream interface */
+struct __declspec(novtable) IDacStream
+{
+	/*
+		This interface lets a host play sample data through a device register at a
+		fixed rate (eg. VGM stream control commands feeding the YM2612 DAC). Instead of
+		a register write and a short update for every sample, the host starts a stream
+		once and the device fetches the samples inside its own sample loop.
+
+		A device runs a single stream, starting a stream replaces the current one.
+		Streams are stopped by a device reset and are not part of the device state.
+	*/
+
+	/* Returns false if the register can't be streamed to or there is no data */
+	virtual bool StartDacStream(const DAC_STREAM_DESC& Desc) = 0;
+	virtual void StopDacStream() = 0;
+
+	/* Change the rate of the current stream */
+	virtual void SetDacStreamFrequency(uint32_t Frequency) = 0;
+
+	/* False after the last sample of a stream that doesn't loop */
+	virtual bool IsDacStreamActive() = 0;
+};
+
+#endif // !_IDAC_STREAM_H_
\ No newline at end of file
@@ -32,6 +32,15 @@ enum class ResetType : uint32_t
 /* Abstract base interface */
 struct __declspec(novtable) IDevice
 {
+	/*
+		Devices don't share any mutable state: lookup tables are either constexpr or
+		function-local statics (initialized once, thread-safe in C++11 and later) and
+		are read-only afterwards. Distinct device instances can therefore be created,
+		updated and destroyed concurrently on different threads without any locking.
+		A single instance is not thread-safe, calls on one device have to be serialized
+		by the host.
+	*/
+
 	/* Get device name from object */
 	virtual const wchar_t* GetDeviceName() = 0;
 
@@ -14,8 +14,153 @@ See LICENSE.txt in the root directory of this source tree.
 #ifndef _IMEMORY_ACCESS_H_
 #define _IMEMORY_ACCESS_H_
 
+#include <cstring>
+
 #include "TritonCore.h"
 
+/* Host uploaded device memory (sample ROM / RAM)
+   Storage is allocated on the first upload and only grows as far as the data
+   that was uploaded, reads outside of the uploaded data return the open bus value.
+   
+   Instead of uploading, the host can attach a read-only buffer it owns (eg. a memory
+   mapped ROM file shared by several devices). The device then reads from that buffer
+   directly. Any upload or device write afterwards first copies the attached data into
+   private storage (copy on write), the host buffer itself is never modified */
+class SampleMemory
+{
+public:
+	SampleMemory(size_t MaxSize, uint8_t OpenBus = 0x00) :
+		m_Base(nullptr),
+		m_Size(0),
+		m_Attached(false),
+		m_MaxSize(MaxSize),
+		m_OpenBus(OpenBus)
+	{
+	}
+
+	SampleMemory(const SampleMemory&) = delete;
+	SampleMemory& operator=(const SampleMemory&) = delete;
+
+	/* Forget all uploaded or attached data (the allocation is kept for the next upload) */
+	void Clear()
+	{
+		m_Data.clear();
+
+		m_Base = m_Data.data();
+		m_Size = 0;
+		m_Attached = false;
+	}
+
+	/* Read from a host owned buffer, it has to stay valid until the memory is cleared,
+	   re-attached or the device is destroyed. Data beyond the address space is ignored */
+	void Attach(const uint8_t* Data, size_t Size)
+	{
+		/* Release the private storage */
+		std::vector<uint8_t>().swap(m_Data);
+
+		m_Base = Data;
+		m_Size = (Data != nullptr) ? std::min(Size, m_MaxSize) : 0;
+		m_Attached = true;
+	}
+
+	/* Returns false if the data does not fit the device address space */
+	bool Upload(size_t Offset, const uint8_t* Data, size_t Size)
+	{
+		if ((Offset > m_MaxSize) || (Size > (m_MaxSize - Offset))) return false;
+
+		memcpy(Reserve(Offset + Size) + Offset, Data, Size);
+
+		return true;
+	}
+
+	/* Device write, addresses outside of the address space are ignored */
+	inline void Write(size_t Address, uint8_t Data)
+	{
+		if (Address >= m_MaxSize) return;
+
+		Reserve(Address + 1)[Address] = Data;
+	}
+
+	inline uint8_t Read(size_t Address) const
+	{
+		return (Address < m_Size) ? m_Base[Address] : m_OpenBus;
+	}
+
+	/* Make the memory private and at least Size bytes large (limited to the address space) */
+	uint8_t* Reserve(size_t Size)
+	{
+		Size = std::min(Size, m_MaxSize);
+
+		if (m_Attached)
+		{
+			m_Data.assign(m_Base, m_Base + m_Size);
+			m_Attached = false;
+		}
+
+		if (Size > m_Data.size()) m_Data.resize(Size, m_OpenBus);
+
+		m_Base = m_Data.data();
+		m_Size = m_Data.size();
+
+		return m_Data.data();
+	}
+
+	const uint8_t* Data() const
+	{
+		return m_Base;
+	}
+
+	/* Device address space size */
+	size_t MaxSize() const
+	{
+		return m_MaxSize;
+	}
+
+	/* Limit the address space (eg. to the memory fitted on the board), data beyond it is dropped */
+	void SetMaxSize(size_t MaxSize)
+	{
+		m_MaxSize = MaxSize;
+
+		if (m_Attached)
+		{
+			m_Size = std::min(m_Size, m_MaxSize);
+		}
+		else if (m_Data.size() > m_MaxSize)
+		{
+			m_Data.resize(m_MaxSize);
+			m_Data.shrink_to_fit();
+
+			m_Base = m_Data.data();
+			m_Size = m_Data.size();
+		}
+	}
+
+	/* Uploaded (or attached) size */
+	size_t Size() const
+	{
+		return m_Size;
+	}
+
+	bool IsAttached() const
+	{
+		return m_Attached;
+	}
+
+	/* Heap memory held by the private storage (an attached host buffer is not included) */
+	size_t GetResidentSize() const
+	{
+		return m_Data.capacity();
+	}
+
+private:
+	const uint8_t*			m_Base;		/* Private storage or attached host buffer */
+	size_t					m_Size;
+	bool					m_Attached;
+	std::vector<uint8_t>	m_Data;		/* Private storage */
+	size_t					m_MaxSize;	/* Address space, limited by SetMaxSize() */
+	uint8_t					m_OpenBus;
+};
+
 /* Abstract private device memory interface */
 struct __declspec(novtable) IMemoryAccess
 {
@@ -31,9 +176,47 @@ struct __declspec(novtable) IMemoryAccess
 	/* Copy data to memory, take any banking into account */
 	virtual void CopyToMemoryIndirect(uint32_t MemoryID, size_t Offset, uint8_t* Data, size_t Size) = 0;
 
+	/* Read memory directly from a host owned, read-only buffer instead of a private copy (no banking).
+	   The buffer has to stay valid until it is detached (Data = nullptr), the device is power-on reset
+	   or destroyed. Returns false if the device or memory does not support it, use CopyToMemory then */
+	virtual bool AttachMemory(uint32_t MemoryID, const uint8_t* Data, size_t Size)
+	{
+		return false;
+	}
+
+	/* Size of the memory in bytes: the address space, or the size set by SetMemorySize().
+	   Returns 0 for an unknown memory */
+	virtual size_t GetMemorySize(uint32_t MemoryID)
+	{
+		return 0;
+	}
+
+	/* Shrink the memory to what is actually fitted on the board (eg. a 1MB sample ROM on a chip with
+	   a 4MB address space). Size has to be a power of 2 and cannot exceed the address space, data beyond
+	   it is dropped. Accesses beyond Size mirror the memory or return the open bus value, depending on the
+	   device. Returns false if the device or memory does not support it */
+	virtual bool SetMemorySize(uint32_t MemoryID, size_t Size)
+	{
+		return false;
+	}
+
+	/* Undo the memory writes done by the device itself (eg. sample RAM written through its registers),
+	   the memories hold exactly the uploaded or attached host data again. Returns false if the device
+	   cannot tell its own writes apart (the host has to upload the data again). Devices that never
+	   write to their memories return true */
+	virtual bool RevertMemory()
+	{
+		return false;
+	}
+
+	/* Heap memory currently held by the device for its memories, sample caches and save state page
+	   baselines in bytes. The device object itself and attached host buffers are not included */
+	virtual size_t GetResidentSize()
+	{
+		return 0;
+	}
+
 	//TODO:
-	//virtual size_t GetMemorySize() = 0;
-	//virtual void SetMemorySize(size_t Size) = 0;
 	//virtual void WriteMemoryDirect(uint32_t Offset, uint8_t Data) = 0;
 	//virtual void WriteMemoryIndirect(uint32_t Offset, uint8_t Data) = 0;
 	//virtual uint8_t ReadMemoryDirect(uint32_t Offset) = 0;
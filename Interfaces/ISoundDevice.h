@@ -41,12 +41,42 @@ See LICENSE.txt in the root directory of this source tree.
 struct AUDIO_OUTPUT_DESC
 {
 	uint32_t		SampleRate;
-	uint32_t		SampleFormat; /* ignore for now */
+	uint32_t		SampleFormat; /* See AudioFormat */
 	uint32_t		Channels;
 	uint32_t		ChannelMask;
 	std::wstring	Description;
 };
 
+/* Register write, see ISoundDevice::WriteBatch */
+struct REGISTER_WRITE
+{
+	uint16_t		Register;
+	uint16_t		Data;
+};
+
+/* Register write at a frame of a rendered block, see ISoundDevice::RenderBlock */
+struct TIMED_REGISTER_WRITE
+{
+	uint32_t		Frame;		/* Frame offset in the block */
+	uint16_t		Port;		/* WriteBatch port */
+	uint16_t		Register;
+	uint16_t		Data;
+};
+
+/* Clock cycles a unit with the given clock divider has to advance to produce exactly Frames more
+   frames, CyclesToDo are the cycles left over from the previous update (see ISoundDevice::GetCyclesForFrames) */
+inline uint32_t CyclesForFrames(uint32_t Frames, uint32_t ClockDivider, uint32_t CyclesToDo)
+{
+	if (Frames == 0) return 0;
+
+	uint64_t Cycles = (uint64_t)Frames * ClockDivider;
+
+	/* A leftover of a full frame or more (eg. after a clock change) still advances one cycle */
+	Cycles -= std::min<uint64_t>(CyclesToDo, Cycles - 1);
+
+	return (uint32_t)std::min<uint64_t>(Cycles, UINT32_MAX);
+}
+
 /* Abstract sound device interface */
 struct __declspec(novtable) ISoundDevice : public IDevice
 {
@@ -55,6 +85,176 @@ struct __declspec(novtable) ISoundDevice : public IDevice
 	virtual uint32_t		GetClockSpeed() = 0;
 	virtual void			Write(uint32_t Address, uint32_t Data) = 0;
 	virtual void			Update(uint32_t ClockCycles, std::vector<IAudioBuffer*>& OutBuffer) = 0;
+
+	/* Advance the device state without generating audio (eg. seeking or scanning a stream)
+	   Update accepts null output buffers, devices skip the output stages for those */
+	virtual void			FastForward(uint32_t ClockCycles)
+	{
+		AUDIO_OUTPUT_DESC Desc;
+		uint32_t Outputs = 0;
+
+		while (EnumAudioOutputs(Outputs, Desc)) Outputs++;
+
+		std::vector<IAudioBuffer*> OutBuffer(Outputs, nullptr);
+
+		Update(ClockCycles, OutBuffer);
+	}
+
+	/* Pull style rendering (eg. from an audio callback that asks for a fixed number of frames)
+	   Returns the clock cycles Update has to advance for output OutputNr to produce exactly Frames
+	   frames at its native rate. The cycles left over from the previous update are taken into account,
+	   so no frames have to be buffered by the host. Other outputs of the device produce the frames
+	   that fall in the same time span
+	   Returns 0 if the device doesn't support this or the output is not rendered at its native rate
+	   (see SetOutputRate) */
+	virtual uint32_t		GetCyclesForFrames(uint32_t OutputNr, uint32_t Frames)
+	{
+		return 0;
+	}
+
+	/* Render exactly Frames frames of output OutputNr (see GetCyclesForFrames), the output buffers
+	   are the same as for Update. Returns false (nothing rendered) if the device doesn't support it */
+	virtual bool			Render(uint32_t OutputNr, uint32_t Frames, std::vector<IAudioBuffer*>& OutBuffer)
+	{
+		if (Frames == 0) return true;
+
+		uint32_t ClockCycles = GetCyclesForFrames(OutputNr, Frames);
+
+		if (ClockCycles == 0) return false;
+
+		Update(ClockCycles, OutBuffer);
+
+		return true;
+	}
+
+	/* Low latency rendering (eg. blocks of 16 - 64 frames for live playback): render exactly Frames frames
+	   of output OutputNr (see Render) and apply register writes frame accurate within the block. Writes[n]
+	   is applied right before frame Writes[n].Frame is rendered, the writes have to be sorted by frame
+	   (writes at or beyond Frames are applied after the last frame). Registers are the ones of WriteBatch
+	   Devices implementing this render the block with a fixed setup cost, without a clock cycle conversion
+	   or an Update call per write
+	   Returns false (nothing rendered or written) if the device doesn't support Render or WriteBatch */
+	virtual bool			RenderBlock(uint32_t OutputNr, uint32_t Frames, std::vector<IAudioBuffer*>& OutBuffer, const TIMED_REGISTER_WRITE* Writes, size_t Count)
+	{
+		if (GetCyclesForFrames(OutputNr, 1) == 0) return false;
+
+		for (size_t i = 0; i < Count; i++)
+		{
+			if (!WriteBatch(Writes[i].Port, nullptr, 0)) return false;
+		}
+
+		uint32_t Frame = 0;
+
+		for (size_t i = 0; i < Count; i++)
+		{
+			uint32_t Next = std::clamp(Writes[i].Frame, Frame, Frames);
+
+			Render(OutputNr, Next - Frame, OutBuffer);
+			Frame = Next;
+
+			REGISTER_WRITE Write = { Writes[i].Register, Writes[i].Data };
+			WriteBatch(Writes[i].Port, &Write, 1);
+		}
+
+		return Render(OutputNr, Frames - Frame, OutBuffer);
+	}
+
+	/* Clock cycles until the next timer overflow or interrupt of the device, so a host can update
+	   the device up to the event instead of polling the status register. The cycles left over from
+	   the previous update are taken into account. Events the host can't foresee (eg. register writes)
+	   are not included, the prediction has to be taken again after every write
+	   Returns 0 if no event is pending or the device doesn't support this */
+	virtual uint32_t		GetCyclesToNextEvent()
+	{
+		return 0;
+	}
+
+	/* True if the device is silent and stays silent until the next register write or data stream
+	   sample: all envelopes released at maximum attenuation, no PCM / ADPCM playback. The outputs
+	   can still hold a constant level (eg. a DAC value) or a decaying filter tail. Hosts use this
+	   to stop rendering early (eg. when scanning a stream for its duration)
+	   Returns false if the device is playing or doesn't support this */
+	virtual bool			IsSilent()
+	{
+		return false;
+	}
+
+	/* Call Callback whenever the interrupt output of the device changes (see Core/Irq.h)
+	   Returns false if the device has no interrupt output */
+	virtual bool			SetIrqCallback(TC::IrqCallback Callback)
+	{
+		return false;
+	}
+
+	/* Render an output at the given sample rate instead of the native device rate (0 = native rate)
+	   Returns false if the output doesn't support this, EnumAudioOutputs reports the resulting rate */
+	virtual bool			SetOutputRate(uint32_t OutputNr, uint32_t SampleRate)
+	{
+		return false;
+	}
+
+	/* Render an output in the given sample format (see AudioFormat) instead of 16-bit samples
+	   S32 and F32 outputs keep the full accumulator resolution, F32 outputs are not clipped
+	   Returns false if the output doesn't support this, EnumAudioOutputs reports the resulting format */
+	virtual bool			SetOutputFormat(uint32_t OutputNr, uint32_t SampleFormat)
+	{
+		return false;
+	}
+
+	/* Report one extra output per voice (FM channel, SSG tone, ADPCM channel, ...) after the regular
+	   outputs, so all stems of a song are rendered in a single pass. Voice outputs are mono 16-bit
+	   samples taken before panning, at the native rate of their unit. Update accepts null buffers
+	   for the voices that are not needed. Disabled by default
+	   Returns false if the device doesn't support this */
+	virtual bool			SetChannelOutputs(bool Enable)
+	{
+		return false;
+	}
+
+	/* Mix all units (eg. SSG + FM) into the main output in a single pass at its native rate, instead of
+	   rendering every unit to its own output. The outputs of the mixed units receive no samples, their
+	   voice outputs (see SetChannelOutputs) run at the rate of the main output. Disabled by default
+	   Returns false if the device doesn't support this */
+	virtual bool			SetMixedOutput(bool Enable)
+	{
+		return false;
+	}
+
+	/* Enable or mute voices, bit n = voice n in the order of the channel outputs (see SetChannelOutputs)
+	   Muted voices skip their output computation, their state is still advanced so they stay in sync
+	   with the chip (see Core/VoiceMask.h). All voices are enabled by default
+	   Returns false if the device doesn't support this */
+	virtual bool			SetChannelMask(uint64_t Enabled)
+	{
+		return false;
+	}
+
+	/* Write a sequence of registers to one port of the device, decoded without going through the
+	   address / data latches (one call instead of two Write calls per register). Register numbers
+	   are the ones used by SendExclusiveCommand without the port bit, the writes are applied in order
+	   Returns false if the device doesn't support this, the host has to fall back to Write */
+	virtual bool			WriteBatch(uint32_t Port, const REGISTER_WRITE* Writes, size_t Count)
+	{
+		return false;
+	}
+
+	/* Restore Count consecutive registers of one port from a register dump, Data[n] is the value
+	   of register Register + n. Registers that latch a value for another register (eg. the OPN
+	   F-Num 2 / Block latch) are written before the register that uses it, unlike WriteBatch
+	   Returns false if the device doesn't support this */
+	virtual bool			WriteRegisters(uint32_t Port, uint32_t Register, const uint8_t* Data, size_t Count)
+	{
+		return false;
+	}
+
+	/* Read the instrumentation counters (see Core/Stats.h), can be called from any thread
+	   Returns false if the device has no counters or TC_DEVICE_STATS is disabled */
+	virtual bool			GetStats(TC::StatsSnapshot& Stats)
+	{
+		Stats = {};
+
+		return false;
+	}
 };
 
 #endif // !_ISOUND_DEVICE_H_
\ No newline at end of file
@@ -0,0 +1,338 @@
+/*
+ _____    _ _            ___
+|_   _| _(_) |_ ___ _ _ / __|___ _ _ ___
+  | || '_| |  _/ _ \ ' \ (__/ _ \ '_/ -_)
+  |_||_| |_|\__\___/_||_\___\___/_| \___|
+
+Copyright  2024, Michel Gerritse
+All rights reserved.
+
+This source code is available under the BSD-3-Clause license.
+See LICENSE.txt in the root directory of this source tree.
+
+*/
+#ifndef _ISTATE_ACCESS_H_
+#define _ISTATE_ACCESS_H_
+
+#include <cstring>
+#include <type_traits>
+
+#include "TritonCore.h"
+
+/* Device state writer
+   A state is a sequence of chunks, one per device (or sub-unit). Each chunk starts
+   with a 4 character tag, a version number and the payload size */
+class StateWriter
+{
+public:
+	StateWriter(std::vector<uint8_t>& Data) :
+		m_Data(Data),
+		m_ChunkStart(0)
+	{
+	}
+
+	StateWriter(const StateWriter&) = delete;
+	StateWriter& operator=(const StateWriter&) = delete;
+
+	void BeginChunk(const char (&Tag)[5], uint32_t Version)
+	{
+		Write(Tag, 4);
+		Write(Version);
+		Write(uint32_t(0)); /* Payload size, set by EndChunk */
+
+		m_ChunkStart = m_Data.size();
+	}
+
+	void EndChunk()
+	{
+		uint32_t Size = (uint32_t)(m_Data.size() - m_ChunkStart);
+
+		memcpy(m_Data.data() + m_ChunkStart - sizeof(uint32_t), &Size, sizeof(uint32_t));
+	}
+
+	template<typename T>
+	void Write(const T& Value)
+	{
+		static_assert(std::is_trivially_copyable_v<T> && !std::is_pointer_v<T>, "State data must be plain data");
+
+		Write(&Value, sizeof(T));
+	}
+
+	void Write(const void* Data, size_t Size)
+	{
+		const uint8_t* p = static_cast<const uint8_t*>(Data);
+
+		m_Data.insert(m_Data.end(), p, p + Size);
+	}
+
+private:
+	std::vector<uint8_t>&	m_Data;
+	size_t					m_ChunkStart;
+};
+
+/* Device state reader
+   Any read past the end of the current chunk marks the state as failed,
+   the destination is left untouched in that case */
+class StateReader
+{
+public:
+	StateReader(const uint8_t* Data, size_t Size) :
+		m_Data(Data),
+		m_Size(Size),
+		m_Offset(0),
+		m_ChunkEnd(Size),
+		m_Failed(false)
+	{
+	}
+
+	StateReader(const std::vector<uint8_t>& Data) :
+		StateReader(Data.data(), Data.size())
+	{
+	}
+
+	StateReader(const StateReader&) = delete;
+	StateReader& operator=(const StateReader&) = delete;
+
+	/* Returns false if the next chunk does not match the tag / version or is truncated */
+	bool BeginChunk(const char (&Tag)[5], uint32_t Version)
+	{
+		char		ChunkTag[4];
+		uint32_t	ChunkVersion;
+		uint32_t	ChunkSize;
+
+		m_ChunkEnd = m_Size;
+
+		Read(ChunkTag, 4);
+		Read(ChunkVersion);
+		Read(ChunkSize);
+
+		if (m_Failed || memcmp(ChunkTag, Tag, 4) != 0 || ChunkVersion != Version || ChunkSize > (m_Size - m_Offset))
+		{
+			m_Failed = true;
+			return false;
+		}
+
+		m_ChunkEnd = m_Offset + ChunkSize;
+
+		return true;
+	}
+
+	/* Returns false if the chunk was not consumed exactly */
+	bool EndChunk()
+	{
+		if (m_Offset != m_ChunkEnd) m_Failed = true;
+
+		m_ChunkEnd = m_Size;
+
+		return !m_Failed;
+	}
+
+	template<typename T>
+	void Read(T& Value)
+	{
+		static_assert(std::is_trivially_copyable_v<T> && !std::is_pointer_v<T>, "State data must be plain data");
+
+		Read(&Value, sizeof(T));
+	}
+
+	void Read(void* Data, size_t Size)
+	{
+		if (m_Failed || Size > (m_ChunkEnd - m_Offset))
+		{
+			m_Failed = true;
+			return;
+		}
+
+		memcpy(Data, m_Data + m_Offset, Size);
+		m_Offset += Size;
+	}
+
+	bool Failed() const
+	{
+		return m_Failed;
+	}
+
+private:
+	const uint8_t*	m_Data;
+	size_t			m_Size;
+	size_t			m_Offset;
+	size_t			m_ChunkEnd;
+	bool			m_Failed;
+};
+
+/* Dirty page tracker for device writable memory
+   ROM or RAM uploaded by the host is not part of a device state (the host owns those
+   images and has to upload the same images before loading a state). Only the pages the
+   device itself has written to are saved, restoring a state first reverts those pages
+   to the content they had before the device modified them */
+class PageTracker
+{
+public:
+	static constexpr size_t PageShift = 12;
+	static constexpr size_t PageSize = 1 << PageShift;
+
+	/* Forget all device modifications (eg. after clearing the memory) */
+	void Clear()
+	{
+		m_Baseline.clear();
+	}
+
+	/* Heap memory held by the page baselines */
+	size_t GetResidentSize() const
+	{
+		size_t Size = m_Baseline.capacity() * sizeof(std::vector<uint8_t>);
+
+		for (auto& Baseline : m_Baseline) Size += Baseline.capacity();
+
+		return Size;
+	}
+
+	/* Call before the device writes to memory */
+	inline void Touch(const uint8_t* Memory, size_t MemorySize, size_t Offset)
+	{
+		size_t Page = Offset >> PageShift;
+
+		if ((Page < m_Baseline.size()) && !m_Baseline[Page].empty()) return;
+
+		StoreBaseline(Memory, MemorySize, Page);
+	}
+
+	/* Call after the host copied data to memory */
+	void Upload(const uint8_t* Memory, size_t Offset, size_t Size)
+	{
+		for (size_t Page = Offset >> PageShift; (Page < m_Baseline.size()) && ((Page << PageShift) < (Offset + Size)); Page++)
+		{
+			auto& Baseline = m_Baseline[Page];
+			if (Baseline.empty()) continue;
+
+			/* Host data becomes part of the baseline */
+			size_t Start = std::max(Offset, Page << PageShift);
+			size_t End = std::min(Offset + Size, (Page << PageShift) + Baseline.size());
+
+			if (Start < End) memcpy(Baseline.data() + (Start & (PageSize - 1)), Memory + Start, End - Start);
+		}
+	}
+
+	void Save(StateWriter& State, const uint8_t* Memory) const
+	{
+		uint32_t Count = 0;
+
+		for (auto& Baseline : m_Baseline) Count += Baseline.empty() ? 0 : 1;
+
+		State.Write(Count);
+
+		for (size_t Page = 0; Page < m_Baseline.size(); Page++)
+		{
+			if (m_Baseline[Page].empty()) continue;
+
+			State.Write((uint32_t)Page);
+			State.Write((uint32_t)m_Baseline[Page].size());
+			State.Write(Memory + (Page << PageShift), m_Baseline[Page].size());
+		}
+	}
+
+	/* True if the device modified the memory since the last clear */
+	bool IsDirty() const
+	{
+		for (auto& Baseline : m_Baseline) if (!Baseline.empty()) return true;
+
+		return false;
+	}
+
+	/* Undo the device modifications, the memory holds the host data again */
+	void Revert(uint8_t* Memory, size_t MemorySize)
+	{
+		Revert([&](size_t Size) { return (Size <= MemorySize) ? Memory : nullptr; });
+	}
+
+	template<typename F>
+	void Revert(F&& Reserve)
+	{
+		for (size_t Page = 0; Page < m_Baseline.size(); Page++)
+		{
+			auto& Baseline = m_Baseline[Page];
+			if (Baseline.empty()) continue;
+
+			uint8_t* Memory = Reserve((Page << PageShift) + Baseline.size());
+			if (Memory != nullptr) memcpy(Memory + (Page << PageShift), Baseline.data(), Baseline.size());
+		}
+
+		m_Baseline.clear();
+	}
+
+	bool Load(StateReader& State, uint8_t* Memory, size_t MemorySize)
+	{
+		return Load(State, [&](size_t Size) { return (Size <= MemorySize) ? Memory : nullptr; });
+	}
+
+	/* Load with lazily sized memory, Reserve(Size) returns the memory (at least Size bytes)
+	   or nullptr if Size exceeds the address space */
+	template<typename F>
+	bool Load(StateReader& State, F&& Reserve)
+	{
+		uint32_t Count = 0;
+		State.Read(Count);
+
+		if (State.Failed()) return false;
+
+		/* Revert the current device modifications */
+		Revert(Reserve);
+
+		/* Apply the saved modifications */
+		for (uint32_t i = 0; i < Count; i++)
+		{
+			uint32_t Page = 0;
+			uint32_t Size = 0;
+
+			State.Read(Page);
+			State.Read(Size);
+
+			size_t Offset = (size_t)Page << PageShift;
+
+			if (State.Failed() || (Size > PageSize)) return false;
+
+			uint8_t* Memory = Reserve(Offset + Size);
+			if (Memory == nullptr) return false;
+
+			StoreBaseline(Memory, Offset + Size, Page);
+			State.Read(Memory + Offset, Size);
+		}
+
+		return !State.Failed();
+	}
+
+private:
+	void StoreBaseline(const uint8_t* Memory, size_t MemorySize, size_t Page)
+	{
+		if (Page >= m_Baseline.size()) m_Baseline.resize(Page + 1);
+
+		size_t Offset = Page << PageShift;
+		size_t Size = std::min(PageSize, MemorySize - Offset);
+
+		m_Baseline[Page].assign(Memory + Offset, Memory + Offset + Size);
+	}
+
+	std::vector<std::vector<uint8_t>>	m_Baseline;	/* Page content before the first device write */
+};
+
+/* Abstract device state interface */
+struct __declspec(novtable) IStateAccess
+{
+	/*
+		This interface allows a host to take a snapshot of the internal state of a
+		device (registers, counters, latches, device written memory) and restore it
+		later on, eg. to seek within a stream without re-emulating it from the start.
+		Memory uploaded through IMemoryAccess is not included.
+
+		Loading a state that was saved by a different device (or version) fails,
+		the device state is undefined afterwards and the device should be reset.
+	*/
+
+	/* Append the device state */
+	virtual void SaveState(StateWriter& State) = 0;
+
+	/* Restore the device state, returns false on failure */
+	virtual bool LoadState(StateReader& State) = 0;
+};
+
+#endif // !_ISTATE_ACCESS_H_
\ No newline at end of file
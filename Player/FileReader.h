@@ -0,0 +1,144 @@
+/*
+ _____    _ _            ___
+|_   _| _(_) |_ ___ _ _ / __|___ _ _ ___
+  | || '_| |  _/ _ \ ' \ (__/ _ \ '_/ -_)
+  |_||_| |_|\__\___/_||_\___\___/_| \___|
+
+Copyright  2024, Michel Gerritse
+All rights reserved.
+
+This source code is available under the BSD-3-Clause license.
+See LICENSE.txt in the root directory of this source tree.
+
+*/
+#ifndef _PLAYER_FILE_READER_H_
+#define _PLAYER_FILE_READER_H_
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <vector>
+
+/* Buffered sequential file reader
+   Only a small window of the file is kept in memory, independent of the file size */
+class FileReader
+{
+public:
+	static constexpr size_t BufferSize = 0x10000;
+
+	FileReader() :
+		m_Pos(0),
+		m_End(0),
+		m_BufferOffset(0)
+	{
+	}
+
+	FileReader(const FileReader&) = delete;
+	FileReader& operator=(const FileReader&) = delete;
+
+	bool Open(const std::filesystem::path& FileName)
+	{
+		Close();
+
+		m_File.open(FileName, std::ios::binary);
+		if (!m_File.is_open()) return false;
+
+		m_Buffer.resize(BufferSize);
+
+		return true;
+	}
+
+	void Close()
+	{
+		if (m_File.is_open()) m_File.close();
+		m_File.clear();
+
+		m_Pos = 0;
+		m_End = 0;
+		m_BufferOffset = 0;
+	}
+
+	bool IsOpen() const
+	{
+		return m_File.is_open();
+	}
+
+	/* Returns false at the end of the file */
+	inline bool Read(uint8_t& Data)
+	{
+		if ((m_Pos == m_End) && !Refill()) return false;
+
+		Data = m_Buffer[m_Pos++];
+
+		return true;
+	}
+
+	/* Returns the number of bytes read */
+	size_t Read(void* Data, size_t Size)
+	{
+		uint8_t* p = static_cast<uint8_t*>(Data);
+		size_t Done = 0;
+
+		while (Done < Size)
+		{
+			if ((m_Pos == m_End) && !Refill()) break;
+
+			size_t Count = std::min(Size - Done, m_End - m_Pos);
+
+			memcpy(p + Done, m_Buffer.data() + m_Pos, Count);
+
+			m_Pos += Count;
+			Done += Count;
+		}
+
+		return Done;
+	}
+
+	void Seek(uint64_t Offset)
+	{
+		if ((Offset >= m_BufferOffset) && (Offset <= (m_BufferOffset + m_End)))
+		{
+			/* Within the buffer */
+			m_Pos = (size_t)(Offset - m_BufferOffset);
+			return;
+		}
+
+		m_File.clear();
+		m_File.seekg((std::streamoff)Offset);
+
+		m_Pos = 0;
+		m_End = 0;
+		m_BufferOffset = Offset;
+	}
+
+	/* Offset of the next byte */
+	uint64_t Tell() const
+	{
+		return m_BufferOffset + m_Pos;
+	}
+
+private:
+	bool Refill()
+	{
+		if (!m_File.is_open()) return false;
+
+		m_BufferOffset += m_End;
+
+		m_File.read(reinterpret_cast<char*>(m_Buffer.data()), m_Buffer.size());
+
+		m_Pos = 0;
+		m_End = (size_t)m_File.gcount();
+
+		return m_End != 0;
+	}
+
+	std::ifstream			m_File;
+	std::vector<uint8_t>	m_Buffer;
+	size_t					m_Pos;
+	size_t					m_End;
+	uint64_t				m_BufferOffset;	/* File offset of the buffer */
+};
+
+#endif // !_PLAYER_FILE_READER_H_
\ No newline at end of file
@@ -0,0 +1,511 @@
+/*
+ _____    _ _            ___
+|_   _| _(_) |_ ___ _ _ / __|___ _ _ ___
+  | || '_| |  _/ _ \ ' \ (__/ _ \ '_/ -_)
+  |_||_| |_|\__\___/_||_\___\___/_| \___|
+
+Copyright  2024, Michel Gerritse
+All rights reserved.
+
+This source code is available under the BSD-3-Clause license.
+See LICENSE.txt in the root directory of this source tree.
+
+*/
+#include "Inflate.h"
+
+/*
+	Streaming DEFLATE decoder
+
+	Decoded data is written into the 32KB history window first (matches refer back into
+	it) and copied to the caller from there, Decode never produces more than a window at
+	a time. The decoder can stop anywhere within a block: the remainder of a stored block
+	or a match is kept in the decoder state.
+
+	Huffman codes up to FastBits long are decoded with a single table lookup, longer codes
+	fall back to a canonical (bit by bit) decode as described in RFC 1951.
+*/
+
+namespace
+{
+	const uint16_t LengthBase[29] =
+	{
+		3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31,
+		35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258
+	};
+
+	const uint8_t LengthExtra[29] =
+	{
+		0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2,
+		3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0
+	};
+
+	const uint16_t DistanceBase[30] =
+	{
+		1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193,
+		257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577
+	};
+
+	const uint8_t DistanceExtra[30] =
+	{
+		0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6,
+		7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13
+	};
+
+	/* Code length code order */
+	const uint8_t CodeLengthOrder[19] =
+	{
+		16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15
+	};
+}
+
+Inflater::Inflater() :
+	m_Input(nullptr),
+	m_Window(WindowSize)
+{
+	Reset(nullptr);
+}
+
+void Inflater::Reset(FileReader* Input)
+{
+	m_Input = Input;
+	m_BitBuffer = 0;
+	m_BitCount = 0;
+	m_Padding = 0;
+
+	m_State = State::Header;
+	m_Last = false;
+	m_Stored = 0;
+	m_CopyLength = 0;
+	m_CopyDistance = 0;
+	m_Fixed = true;
+
+	m_WritePos = 0;
+	m_Total = 0;
+}
+
+size_t Inflater::Decode(uint8_t* Out, size_t Size)
+{
+	size_t Done = 0;
+
+	while (Done < Size)
+	{
+		size_t Count = DecodeBlock(std::min<size_t>(Size - Done, WindowSize));
+		if (Count == 0) break;
+
+		/* Copy the decoded data out of the window */
+		uint32_t Start = (m_WritePos - (uint32_t)Count) & (WindowSize - 1);
+		size_t First = std::min<size_t>(Count, WindowSize - Start);
+
+		memcpy(Out + Done, m_Window.data() + Start, First);
+		memcpy(Out + Done + First, m_Window.data(), Count - First);
+
+		Done += Count;
+	}
+
+	return Done;
+}
+
+bool Inflater::IsFinished() const
+{
+	return m_State == State::Done;
+}
+
+bool Inflater::Failed() const
+{
+	return m_State == State::Error;
+}
+
+uint64_t Inflater::GetInputOffset() const
+{
+	/* Bytes in the bit buffer are part of the state */
+	return (m_Input != nullptr) ? m_Input->Tell() : 0;
+}
+
+inline bool Inflater::Need(uint32_t Bits)
+{
+	while (m_BitCount < Bits)
+	{
+		uint8_t Data = 0;
+
+		/* Pad with zeroes at the end of the input, decoding fails if these are used up */
+		if ((m_Input == nullptr) || !m_Input->Read(Data)) m_Padding++;
+
+		m_BitBuffer |= (uint64_t)Data << m_BitCount;
+		m_BitCount += 8;
+	}
+
+	return m_Padding <= 4;
+}
+
+inline uint32_t Inflater::GetBits(uint32_t Bits)
+{
+	Need(Bits);
+
+	uint32_t Value = (uint32_t)(m_BitBuffer & ((1ull << Bits) - 1));
+
+	m_BitBuffer >>= Bits;
+	m_BitCount -= Bits;
+
+	return Value;
+}
+
+inline int32_t Inflater::DecodeSymbol(const huffman_t& Table)
+{
+	Need(MaxBits);
+
+	uint32_t Entry = Table.Fast[m_BitBuffer & ((1 << FastBits) - 1)];
+
+	if (Entry != 0)
+	{
+		m_BitBuffer >>= Entry & 0x0F;
+		m_BitCount -= Entry & 0x0F;
+
+		return Entry >> 4;
+	}
+
+	/* Canonical decode of the longer codes */
+	int32_t Code = 0;
+	int32_t First = 0;
+	int32_t Index = 0;
+
+	for (uint32_t Length = 1; Length <= MaxBits; Length++)
+	{
+		Code |= (m_BitBuffer >> (Length - 1)) & 0x01;
+
+		int32_t Count = Table.Count[Length];
+
+		if (Code < (First + Count))
+		{
+			m_BitBuffer >>= Length;
+			m_BitCount -= Length;
+
+			return Table.Symbol[Index + (Code - First)];
+		}
+
+		Index += Count;
+		First = (First + Count) << 1;
+		Code <<= 1;
+	}
+
+	return -1; /* Invalid (incomplete) code */
+}
+
+bool Inflater::Build(huffman_t& Table, const uint8_t* Length, uint32_t Count)
+{
+	memset(Table.Count, 0, sizeof(Table.Count));
+	memset(Table.Fast, 0, sizeof(Table.Fast));
+
+	for (uint32_t i = 0; i < Count; i++) Table.Count[Length[i]]++;
+
+	Table.Count[0] = 0;
+
+	/* Reject over-subscribed codes, incomplete codes fail when an unused code is decoded */
+	int32_t Left = 1;
+
+	for (uint32_t Bits = 1; Bits <= MaxBits; Bits++)
+	{
+		Left = (Left << 1) - Table.Count[Bits];
+		if (Left < 0) return false;
+	}
+
+	/* Symbols sorted by code length (canonical order) */
+	uint16_t Offset[MaxBits + 1];
+	uint16_t Next[MaxBits + 1];
+	uint32_t Code = 0;
+
+	Offset[0] = 0;
+	Offset[1] = 0;
+	Next[0] = 0;
+
+	for (uint32_t Bits = 1; Bits <= MaxBits; Bits++)
+	{
+		if (Bits < MaxBits) Offset[Bits + 1] = Offset[Bits] + Table.Count[Bits];
+
+		Code = (Code + Table.Count[Bits - 1]) << 1;
+		Next[Bits] = Code;
+	}
+
+	for (uint32_t Symbol = 0; Symbol < Count; Symbol++)
+	{
+		uint32_t Bits = Length[Symbol];
+		if (Bits == 0) continue;
+
+		Table.Symbol[Offset[Bits]++] = Symbol;
+
+		/* Codes are stored MSB first, the bit buffer is LSB first */
+		uint32_t Reversed = 0;
+
+		for (uint32_t i = 0, c = Next[Bits]++; i < Bits; i++, c >>= 1) Reversed = (Reversed << 1) | (c & 0x01);
+
+		if (Bits > FastBits) continue;
+
+		for (uint32_t i = Reversed; i < (1 << FastBits); i += (1 << Bits))
+		{
+			Table.Fast[i] = (Symbol << 4) | Bits;
+		}
+	}
+
+	return true;
+}
+
+const Inflater::huffman_t& Inflater::GetFixedLiteral()
+{
+	static const huffman_t Table = []
+	{
+		huffman_t Table;
+		uint8_t Length[288];
+
+		for (uint32_t i = 0; i < 288; i++) Length[i] = (i < 144) ? 8 : (i < 256) ? 9 : (i < 280) ? 7 : 8;
+
+		Build(Table, Length, 288);
+
+		return Table;
+	}();
+
+	return Table;
+}
+
+const Inflater::huffman_t& Inflater::GetFixedDistance()
+{
+	static const huffman_t Table = []
+	{
+		huffman_t Table;
+		uint8_t Length[30];
+
+		for (uint32_t i = 0; i < 30; i++) Length[i] = 5;
+
+		Build(Table, Length, 30);
+
+		return Table;
+	}();
+
+	return Table;
+}
+
+size_t Inflater::DecodeBlock(size_t Size)
+{
+	constexpr uint32_t Mask = WindowSize - 1;
+
+	uint8_t* Window = m_Window.data();
+	size_t Done = 0;
+
+	while (Done < Size)
+	{
+		/* Finish a pending match first */
+		if (m_CopyLength != 0)
+		{
+			uint32_t Count = (uint32_t)std::min<size_t>(m_CopyLength, Size - Done);
+			uint32_t From = m_WritePos - m_CopyDistance;
+
+			for (uint32_t i = 0; i < Count; i++) Window[(m_WritePos++) & Mask] = Window[(From++) & Mask];
+
+			m_CopyLength -= Count;
+			Done += Count;
+			continue;
+		}
+
+		switch (m_State)
+		{
+		case State::Header:
+			if (m_Last)
+			{
+				m_State = State::Done;
+			}
+			else if (!ReadHeader() || (m_Padding > 4))
+			{
+				m_State = State::Error;
+			}
+			break;
+
+		case State::Stored:
+		{
+			if (m_Stored == 0)
+			{
+				m_State = State::Header;
+				break;
+			}
+
+			uint32_t Count = (uint32_t)std::min<size_t>(m_Stored, Size - Done);
+
+			for (uint32_t i = 0; i < Count; i++) Window[(m_WritePos++) & Mask] = (uint8_t)GetBits(8);
+
+			m_Stored -= Count;
+			Done += Count;
+
+			if (m_Padding > 4) m_State = State::Error;
+			break;
+		}
+
+		case State::Huffman:
+		{
+			const huffman_t& Literal = m_Fixed ? GetFixedLiteral() : m_DynamicLiteral;
+			const huffman_t& Distance = m_Fixed ? GetFixedDistance() : m_DynamicDistance;
+
+			while ((Done < Size) && (m_State == State::Huffman))
+			{
+				int32_t Symbol = DecodeSymbol(Literal);
+
+				if ((Symbol < 0) || (m_Padding > 4))
+				{
+					m_State = State::Error;
+				}
+				else if (Symbol < 256) /* Literal */
+				{
+					Window[(m_WritePos++) & Mask] = (uint8_t)Symbol;
+					Done++;
+				}
+				else if (Symbol == 256) /* End of block */
+				{
+					m_State = State::Header;
+				}
+				else if ((Symbol -= 257) >= 29)
+				{
+					m_State = State::Error;
+				}
+				else /* Match */
+				{
+					uint32_t Length = LengthBase[Symbol] + GetBits(LengthExtra[Symbol]);
+
+					Symbol = DecodeSymbol(Distance);
+
+					if ((Symbol < 0) || (Symbol >= 30))
+					{
+						m_State = State::Error;
+						break;
+					}
+
+					uint32_t Offset = DistanceBase[Symbol] + GetBits(DistanceExtra[Symbol]);
+
+					/* Distance can't go back past the start of the stream */
+					if (Offset > std::min<uint64_t>(m_Total + Done, WindowSize))
+					{
+						m_State = State::Error;
+						break;
+					}
+
+					uint32_t Count = (uint32_t)std::min<size_t>(Length, Size - Done);
+					uint32_t From = m_WritePos - Offset;
+
+					for (uint32_t i = 0; i < Count; i++) Window[(m_WritePos++) & Mask] = Window[(From++) & Mask];
+
+					Done += Count;
+
+					m_CopyLength = Length - Count;
+					m_CopyDistance = Offset;
+
+					if (m_CopyLength != 0) break;
+				}
+			}
+			break;
+		}
+
+		default: /* Done or error */
+			m_Total += Done;
+			return Done;
+		}
+	}
+
+	m_Total += Done;
+
+	return Done;
+}
+
+bool Inflater::ReadHeader()
+{
+	m_Last = GetBits(1) != 0;
+
+	switch (GetBits(2))
+	{
+	case 0: /* Stored */
+	{
+		/* Skip to the next byte boundary */
+		GetBits(m_BitCount & 0x07);
+
+		uint32_t Length = GetBits(16);
+		uint32_t Complement = GetBits(16);
+
+		if (Length != (~Complement & 0xFFFF)) return false;
+
+		m_Stored = Length;
+		m_State = State::Stored;
+		return true;
+	}
+
+	case 1: /* Fixed Huffman codes */
+		m_Fixed = true;
+		m_State = State::Huffman;
+		return true;
+
+	case 2: /* Dynamic Huffman codes */
+		m_Fixed = false;
+		m_State = State::Huffman;
+		return ReadDynamicTables();
+
+	default: /* Reserved */
+		return false;
+	}
+}
+
+bool Inflater::ReadDynamicTables()
+{
+	uint32_t Literals = GetBits(5) + 257;
+	uint32_t Distances = GetBits(5) + 1;
+	uint32_t CodeLengths = GetBits(4) + 4;
+
+	if ((Literals > 286) || (Distances > 30)) return false;
+
+	/* Code length code */
+	uint8_t Length[286 + 30] = {};
+	huffman_t Table;
+
+	for (uint32_t i = 0; i < CodeLengths; i++) Length[CodeLengthOrder[i]] = (uint8_t)GetBits(3);
+
+	if (!Build(Table, Length, 19)) return false;
+
+	/* Literal / length and distance code lengths */
+	uint32_t Index = 0;
+
+	memset(Length, 0, sizeof(Length));
+
+	while (Index < (Literals + Distances))
+	{
+		int32_t Symbol = DecodeSymbol(Table);
+
+		if ((Symbol < 0) || (m_Padding > 4)) return false;
+
+		if (Symbol < 16)
+		{
+			Length[Index++] = (uint8_t)Symbol;
+			continue;
+		}
+
+		uint8_t Value = 0;
+		uint32_t Repeat = 0;
+
+		switch (Symbol)
+		{
+		case 16: /* Repeat the previous length */
+			if (Index == 0) return false;
+			Value = Length[Index - 1];
+			Repeat = 3 + GetBits(2);
+			break;
+
+		case 17: /* Zeroes */
+			Repeat = 3 + GetBits(3);
+			break;
+
+		default: /* More zeroes */
+			Repeat = 11 + GetBits(7);
+			break;
+		}
+
+		if ((Index + Repeat) > (Literals + Distances)) return false;
+
+		while (Repeat--) Length[Index++] = Value;
+	}
+
+	/* An end of block code is required */
+	if (Length[256] == 0) return false;
+
+	return Build(m_DynamicLiteral, Length, Literals) && Build(m_DynamicDistance, Length + Literals, Distances);
+}
\ No newline at end of file
@@ -0,0 +1,93 @@
+/*
+ _____    _ _            ___
+|_   _| _(_) |_ ___ _ _ / __|___ _ _ ___
+  | || '_| |  _/ _ \ ' \ (__/ _ \ '_/ -_)
+  |_||_| |_|\__\___/_||_\___\___/_| \___|
+
+Copyright  2024, Michel Gerritse
+All rights reserved.
+
+This source code is available under the BSD-3-Clause license.
+See LICENSE.txt in the root directory of this source tree.
+
+*/
+#ifndef _PLAYER_INFLATE_H_
+#define _PLAYER_INFLATE_H_
+
+#include "FileReader.h"
+
+/* Streaming DEFLATE (RFC 1951) decoder
+   The compressed data is pulled from a file reader, decoding stops as soon as the
+   requested amount of data is produced. Only the 32KB history window is kept in memory.
+   The decoder state can be copied to resume decoding from that point later on (the
+   file reader has to be positioned at the offset returned by GetInputOffset) */
+class Inflater
+{
+public:
+	Inflater();
+
+	/* Start decoding a new stream at the current file position */
+	void		Reset(FileReader* Input);
+
+	/* Returns the number of bytes decoded, less than Size at the end of the stream or on an error */
+	size_t		Decode(uint8_t* Out, size_t Size);
+
+	bool		IsFinished() const;
+	bool		Failed() const;
+
+	/* Offset of the first input byte that is not part of the decoder state */
+	uint64_t	GetInputOffset() const;
+
+private:
+	static constexpr uint32_t MaxBits = 15;			/* Maximum code length */
+	static constexpr uint32_t FastBits = 9;			/* Single lookup code lengths */
+	static constexpr uint32_t WindowSize = 0x8000;	/* History window (32KB) */
+
+	enum class State : uint32_t
+	{
+		Header = 0,	/* Block header */
+		Stored,		/* Uncompressed block */
+		Huffman,	/* Fixed or dynamic Huffman block */
+		Done,
+		Error
+	};
+
+	struct huffman_t
+	{
+		uint16_t	Fast[1 << FastBits];	/* Symbol << 4 | length, 0 = code is longer than FastBits */
+		uint16_t	Count[MaxBits + 1];		/* Number of codes per length */
+		uint16_t	Symbol[288];			/* Symbols ordered by code */
+	};
+
+	static bool					Build(huffman_t& Table, const uint8_t* Length, uint32_t Count);
+	static const huffman_t&		GetFixedLiteral();
+	static const huffman_t&		GetFixedDistance();
+
+	inline bool					Need(uint32_t Bits);
+	inline uint32_t				GetBits(uint32_t Bits);
+	inline int32_t				DecodeSymbol(const huffman_t& Table);
+
+	size_t						DecodeBlock(size_t Size);
+	bool						ReadHeader();
+	bool						ReadDynamicTables();
+
+	FileReader*					m_Input;
+	uint64_t					m_BitBuffer;
+	uint32_t					m_BitCount;
+	uint32_t					m_Padding;		/* Zero bytes added after the end of the input */
+
+	State						m_State;
+	bool						m_Last;			/* Final block */
+	uint32_t					m_Stored;		/* Remaining bytes of an uncompressed block */
+	uint32_t					m_CopyLength;	/* Remaining bytes of a match */
+	uint32_t					m_CopyDistance;
+	bool						m_Fixed;		/* Fixed or dynamic Huffman tables */
+	huffman_t					m_DynamicLiteral;
+	huffman_t					m_DynamicDistance;
+
+	std::vector<uint8_t>		m_Window;
+	uint32_t					m_WritePos;		/* Free running write position */
+	uint64_t					m_Total;		/* Total bytes decoded */
+};
+
+#endif // !_PLAYER_INFLATE_H_
\ No newline at end of file
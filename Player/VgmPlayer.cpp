@@ -0,0 +1,1028 @@
+/*
+ _____    _ _            ___
+|_   _| _(_) |_ ___ _ _ / __|___ _ _ ___
+  | || '_| |  _/ _ \ ' \ (__/ _ \ '_/ -_)
+  |_||_| |_|\__\___/_||_\___\___/_| \___|
+
+Copyright  2024, Michel Gerritse
+All rights reserved.
+
+This source code is available under the BSD-3-Clause license.
+See LICENSE.txt in the root directory of this source tree.
+
+*/
+#include <cmath>
+
+#include "VgmPlayer.h"
+#include "../Devices/Sound/AY8910.h"
+#include "../Devices/Sound/MSM6295.h"
+#include "../Devices/Sound/RF5C68.h"
+#include "../Devices/Sound/SegaPCM.h"
+#include "../Devices/Sound/SegaPWM.h"
+#include "../Devices/Sound/SN76489.h"
+#include "../Devices/Sound/Y8950.h"
+#include "../Devices/Sound/YM2149.h"
+#include "../Devices/Sound/YM2203.h"
+#include "../Devices/Sound/YM2608.h"
+#include "../Devices/Sound/YM2610.h"
+#include "../Devices/Sound/YM2610B.h"
+#include "../Devices/Sound/YM2612.h"
+#include "../Devices/Sound/YM3526.h"
+#include "../Devices/Sound/YM3812.h"
+#include "../Devices/Sound/YMF278B.h"
+#include "../Devices/Sound/YMW258F.h"
+#include "../Devices/Sound/YMZ280B.h"
+
+/*
+	Streaming VGM player
+
+	Commands are read from the stream up to the next wait, the devices are then rendered
+	(through the mixer) for the duration of the wait. Wait times are in 44.1 kHz ticks, the
+	total number of ticks is converted to output frames so no rounding errors build up.
+
+	Data blocks are passed on to the devices in small chunks while reading them, they are
+	never loaded as a whole. Only the PCM data banks (block types 0x00 - 0x3F) are kept, the
+	commands read from them at random.
+
+	The stream position of the loop point is marked when it is first passed, looping then
+	resumes decoding from there instead of decompressing the file from the start. Data blocks
+	in front of the stream position they were loaded up to (ROM images, PCM data) are not
+	loaded again, RAM writes are.
+
+	DAC stream control (0x90 - 0x95) is handed to the devices that implement IDacStream
+	(YM2612, RF5C68 / RF5C164 and PWM), they fetch the stream data from the data bank inside
+	their sample loop. Streams to other chips and reverse playback are not supported.
+
+	Not supported: chips without a device in this library, their commands are skipped.
+*/
+
+namespace
+{
+	/* Operand bytes of the commands without a dedicated handler */
+	uint32_t GetOperandSize(uint8_t Command)
+	{
+		switch (Command)
+		{
+		case 0x64: return 3;
+		default: break;
+		}
+
+		if (Command >= 0xE0) return 4;
+		if (Command >= 0xC0) return 3;
+		if (Command >= 0xA0) return 2;
+		if (Command >= 0x51 && Command <= 0x5F) return 2;
+		if (Command >= 0x40 && Command <= 0x4E) return 2;
+		if (Command >= 0x30 && Command <= 0x50) return 1;
+
+		return 0;
+	}
+}
+
+VgmPlayer::VgmPlayer(uint32_t SampleRate, uint32_t Threads, ResamplerQuality Quality) :
+	m_SampleRate(SampleRate),
+	m_Mixer(SampleRate, Threads, Quality),
+	m_Transfer(0x10000),
+	m_Loops(1)
+{
+	Close();
+}
+
+VgmPlayer::~VgmPlayer()
+{
+	/* Devices are owned by the player, they have to be removed from the mixer first */
+	m_Mixer.RemoveDevices();
+}
+
+bool VgmPlayer::Open(const std::filesystem::path& FileName)
+{
+	Close();
+
+	if (!m_Stream.Open(FileName) || !ReadHeader())
+	{
+		Close();
+		return false;
+	}
+
+	CreateDevices();
+
+	/* Skip to the first command */
+	m_Stream.Skip(m_Header.DataOffset - (size_t)m_Stream.Tell());
+
+	m_Finished = false;
+
+	return true;
+}
+
+void VgmPlayer::Close()
+{
+	m_Mixer.RemoveDevices();
+	m_Devices.clear();
+	m_States.clear();
+	m_Stream.Close();
+
+	memset(&m_Header, 0, sizeof(m_Header));
+	memset(m_Chip, 0, sizeof(m_Chip));
+
+	for (auto& Bank : m_DataBank) std::vector<uint8_t>().swap(Bank);
+	for (auto& Blocks : m_DataBlocks) Blocks.clear();
+
+	memset(m_DacStream, 0, sizeof(m_DacStream));
+
+	m_Batch.Device = nullptr;
+	m_Batch.Count = 0;
+
+	m_DataBankPos = 0;
+	m_Table.Values.clear();
+	m_DataBlockEnd = 0;
+
+	m_LoopsPlayed = 0;
+	m_Ticks = 0;
+	m_Frames = 0;
+	m_FrameTarget = 0;
+	m_Finished = true;
+}
+
+void VgmPlayer::SetLoopCount(uint32_t Loops)
+{
+	m_Loops = Loops;
+}
+
+size_t VgmPlayer::Render(float* Out, size_t Frames)
+{
+	size_t Done = 0;
+
+	while (Done < Frames)
+	{
+		if (m_Frames == m_FrameTarget)
+		{
+			if (m_Finished) break;
+
+			m_Ticks += ProcessCommands();
+			m_FrameTarget = (m_Ticks * m_SampleRate) / TickRate;
+			continue;
+		}
+
+		size_t Count = (size_t)std::min<uint64_t>(Frames - Done, m_FrameTarget - m_Frames);
+
+		m_Mixer.Render(Out + (Done * 2), Count);
+
+		m_Frames += Count;
+		Done += Count;
+	}
+
+	std::fill(Out + (Done * 2), Out + (Frames * 2), 0.0f);
+
+	return Done;
+}
+
+bool VgmPlayer::IsFinished() const
+{
+	return m_Finished && (m_Frames == m_FrameTarget);
+}
+
+uint32_t VgmPlayer::GetLoopsPlayed() const
+{
+	return m_LoopsPlayed;
+}
+
+uint64_t VgmPlayer::GetPosition() const
+{
+	return (m_Frames * TickRate) / m_SampleRate;
+}
+
+bool VgmPlayer::IsSilent() const
+{
+	return std::all_of(m_Devices.begin(), m_Devices.end(), [](auto& Device) { return Device->IsSilent(); });
+}
+
+uint64_t VgmPlayer::GetStateHash()
+{
+	m_StateHash.Clear();
+
+	for (auto State : m_States) m_StateHash.Add(*State);
+
+	return m_StateHash.Get();
+}
+
+uint32_t VgmPlayer::GetSampleRate() const
+{
+	return m_SampleRate;
+}
+
+const VGM_HEADER& VgmPlayer::GetHeader() const
+{
+	return m_Header;
+}
+
+uint32_t VgmPlayer::GetDeviceCount() const
+{
+	return (uint32_t)m_Devices.size();
+}
+
+ISoundDevice* VgmPlayer::GetDevice(uint32_t DeviceNr) const
+{
+	return (DeviceNr < m_Devices.size()) ? m_Devices[DeviceNr].get() : nullptr;
+}
+
+void VgmPlayer::SetOutputTap(uint32_t DeviceNr, uint32_t OutputNr, IAudioBuffer* Tap)
+{
+	/* Devices are added to the mixer in the same order */
+	m_Mixer.SetOutputTap(DeviceNr, OutputNr, Tap);
+}
+
+bool VgmPlayer::ReadHeader()
+{
+	uint8_t* Raw = m_Header.Raw;
+
+	/* Fixed part, up to the data offset */
+	if ((m_Stream.Read(Raw, 0x38) != 0x38) || (memcmp(Raw, "Vgm ", 4) != 0)) return false;
+
+	m_Header.Version = GetClock(0x08);
+	m_Header.DataOffset = ((m_Header.Version >= 0x150) && (GetClock(0x34) != 0)) ? 0x34 + GetClock(0x34) : 0x40;
+
+	if (m_Header.DataOffset < 0x38) return false;
+
+	/* Fields beyond the header size are zero */
+	uint32_t HeaderSize = std::min<uint32_t>(m_Header.DataOffset, sizeof(m_Header.Raw));
+
+	if (m_Stream.Read(Raw + 0x38, HeaderSize - 0x38) != (HeaderSize - 0x38)) return false;
+
+	m_Header.EndOfFile = (GetClock(0x04) != 0) ? 0x04 + GetClock(0x04) : 0;
+	m_Header.Gd3Offset = (GetClock(0x14) != 0) ? 0x14 + GetClock(0x14) : 0;
+	m_Header.TotalSamples = GetClock(0x18);
+	m_Header.LoopOffset = (GetClock(0x1C) != 0) ? 0x1C + GetClock(0x1C) : 0;
+	m_Header.LoopSamples = GetClock(0x20);
+	m_Header.Rate = GetClock(0x24);
+
+	return true;
+}
+
+uint32_t VgmPlayer::GetClock(uint32_t Offset) const
+{
+	const uint8_t* Raw = m_Header.Raw + Offset;
+
+	return Raw[0] | (Raw[1] << 8) | (Raw[2] << 16) | ((uint32_t)Raw[3] << 24);
+}
+
+void VgmPlayer::CreateDevices()
+{
+	const uint8_t* Raw = m_Header.Raw;
+
+	/* Volume modifier (2 ^ (Modifier / 32)) */
+	int32_t Modifier = (Raw[0x7C] > 0xC0) ? Raw[0x7C] - 0x100 : Raw[0x7C];
+	if (Modifier == -0x3F) Modifier = -0x40;
+
+	float Gain = std::pow(2.0f, Modifier / 32.0f);
+
+	/* SN76489 variant from the LFSR feedback pattern and width */
+	uint32_t Clock = GetClock(0x0C);
+
+	if (Clock != 0)
+	{
+		uint32_t Feedback = (m_Header.Version >= 0x110) ? (Raw[0x28] | (Raw[0x29] << 8)) : 0x0009;
+		uint32_t Width = (m_Header.Version >= 0x110) ? Raw[0x2A] : 16;
+		uint32_t Flags = Raw[0x2B];
+
+		if (Width == 15) AddDevice<SN76489>(ChipSN76489, Clock, Gain);
+		else if (Width == 17) AddDevice<SN76489A>(ChipSN76489, Clock, Gain);
+		else if (Feedback == 0x0022) AddDevice<NCR8496>(ChipSN76489, Clock, Gain);
+		else if (Flags & 0x08) AddDevice<SEGAPSG>(ChipSN76489, Clock, Gain); /* Game Gear stereo disabled */
+		else AddDevice<SEGAPSG2>(ChipSN76489, Clock, Gain);
+	}
+
+	AddDevice<YM2612>(ChipYM2612, GetClock(0x2C), Gain);
+	AddDevice<YM2203>(ChipYM2203, GetClock(0x44), Gain);
+	AddDevice<YM2608>(ChipYM2608, GetClock(0x48), Gain);
+
+	Clock = GetClock(0x4C);
+
+	if (Clock & 0x80000000) AddDevice<YM2610B>(ChipYM2610, Clock, Gain);
+	else AddDevice<YM2610>(ChipYM2610, Clock, Gain);
+
+	AddDevice<YM3812>(ChipYM3812, GetClock(0x50), Gain);
+	AddDevice<YM3526>(ChipYM3526, GetClock(0x54), Gain);
+	AddDevice<Y8950>(ChipY8950, GetClock(0x58), Gain);
+	AddDevice<YMF278B>(ChipYMF278B, GetClock(0x60), Gain);
+	AddDevice<YMZ280B>(ChipYMZ280B, GetClock(0x68), Gain);
+	AddDevice<RF5C68>(ChipRF5C68, GetClock(0x40) & 0x3FFFFFFF, Gain, RF5C68::MODEL_RF5C68);
+	AddDevice<RF5C68>(ChipRF5C164, GetClock(0x6C) & 0x3FFFFFFF, Gain, RF5C68::MODEL_RF5C164);
+	AddDevice<SEGAPWM>(ChipSegaPWM, GetClock(0x70) & 0x3FFFFFFF, Gain);
+	AddDevice<SegaPCM>(ChipSegaPCM, GetClock(0x38), Gain, GetClock(0x38) & 0x3FFFFFFF, GetClock(0x3C));
+	AddDevice<YMW258F>(ChipYMW258F, GetClock(0x88), Gain, GetClock(0x88) & 0x3FFFFFFF, false);
+
+	/* AY8910 family, YM2149 based types have a clock divider select pin */
+	Clock = GetClock(0x74);
+
+	if (Raw[0x78] & 0x10) AddDevice<YM2149>(ChipAY8910, Clock, Gain, Clock & 0x3FFFFFFF, (Raw[0x79] & 0x10) != 0);
+	else AddDevice<AY8910>(ChipAY8910, Clock, Gain);
+
+	/* Bit 31 = pin 7 (sample rate select) */
+	Clock = GetClock(0x98);
+
+	AddDevice<MSM6295>(ChipMSM6295, Clock, Gain, (Clock & 0x80000000) != 0);
+}
+
+template<typename T, typename... Args>
+void VgmPlayer::AddDevice(Chip Type, uint32_t Clock, float Gain, const Args&... Arguments)
+{
+	if ((Clock & 0x3FFFFFFF) == 0) return;
+
+	/* Bit 30 = dual chip */
+	uint32_t Instances = (Clock & 0x40000000) ? 2 : 1;
+
+	for (uint32_t i = 0; i < Instances; i++)
+	{
+		T* Device = new T(Arguments...);
+
+		m_Devices.emplace_back(Device, [](ISoundDevice* Pointer) { std::default_delete<T>()(static_cast<T*>(Pointer)); });
+
+		Device->SetClockSpeed(Clock & 0x3FFFFFFF);
+
+		m_Chip[Type][i].Device = Device;
+
+		if constexpr (std::is_base_of_v<IMemoryAccess, T>) m_Chip[Type][i].Memory = Device;
+		if constexpr (std::is_base_of_v<IDacStream, T>) m_Chip[Type][i].Stream = Device;
+		if constexpr (std::is_base_of_v<IStateAccess, T>) m_States.push_back(Device);
+
+		/* The output rates depend on the clock */
+		m_Mixer.AddDevice(Device, Gain);
+	}
+}
+
+uint32_t VgmPlayer::ProcessCommands()
+{
+	uint8_t Command = 0;
+	uint32_t Address = 0;
+	uint32_t Data = 0;
+
+	auto Byte = [&]()
+	{
+		uint8_t Value = 0;
+		m_Stream.Read(Value);
+		return (uint32_t)Value;
+	};
+
+	while (true)
+	{
+		if ((m_Header.LoopOffset != 0) && !m_Stream.HasMark() && (m_Stream.Tell() == m_Header.LoopOffset))
+		{
+			m_Stream.SetMark();
+		}
+
+		if (!m_Stream.Read(Command) || (Command == 0x66)) /* End of sound data */
+		{
+			FlushWrites();
+
+			if ((m_LoopsPlayed < m_Loops) && m_Stream.SeekMark())
+			{
+				m_LoopsPlayed++;
+				continue;
+			}
+
+			m_Finished = true;
+			return 0;
+		}
+
+		/* Pending register writes are sent before any other command (eg. a wait) is processed */
+		if (!(((Command >= 0x52) && (Command <= 0x5C)) || ((Command >= 0xA2) && (Command <= 0xAC)))) FlushWrites();
+
+		switch (Command)
+		{
+		case 0x30: /* SN76489 (2nd chip) */
+		case 0x50: /* SN76489 */
+			Write(ChipSN76489, (Command == 0x30) ? 1 : 0, 0, Byte());
+			break;
+
+		case 0x3F: /* Game Gear stereo (2nd chip) */
+		case 0x4F: /* Game Gear stereo */
+			Data = Byte();
+			if (auto Device = m_Chip[ChipSN76489][(Command == 0x3F) ? 1 : 0].Device) Device->SendExclusiveCommand(0x06, Data);
+			break;
+
+		case 0x52: case 0x53: case 0xA2: case 0xA3: /* YM2612 port 0 / 1 */
+			Address = Byte();
+			Data = Byte();
+			WriteRegister(ChipYM2612, Command >> 7, Command & 0x01, Address, Data);
+			break;
+
+		case 0x55: case 0xA5: /* YM2203 */
+			Address = Byte();
+			Data = Byte();
+			WriteRegister(ChipYM2203, Command >> 7, 0, Address, Data);
+			break;
+
+		case 0x56: case 0x57: case 0xA6: case 0xA7: /* YM2608 port 0 / 1 */
+			Address = Byte();
+			Data = Byte();
+			WriteRegister(ChipYM2608, Command >> 7, Command & 0x01, Address, Data);
+			break;
+
+		case 0x58: case 0x59: case 0xA8: case 0xA9: /* YM2610(B) port 0 / 1 */
+			Address = Byte();
+			Data = Byte();
+			WriteRegister(ChipYM2610, Command >> 7, Command & 0x01, Address, Data);
+			break;
+
+		case 0x5A: case 0xAA: /* YM3812 */
+			Address = Byte();
+			Data = Byte();
+			WriteRegister(ChipYM3812, Command >> 7, 0, Address, Data);
+			break;
+
+		case 0x5B: case 0xAB: /* YM3526 */
+			Address = Byte();
+			Data = Byte();
+			WriteRegister(ChipYM3526, Command >> 7, 0, Address, Data);
+			break;
+
+		case 0x5C: case 0xAC: /* Y8950 */
+			Address = Byte();
+			Data = Byte();
+			WriteRegister(ChipY8950, Command >> 7, 0, Address, Data);
+			break;
+
+		case 0x5D: case 0xAD: /* YMZ280B */
+			Address = Byte();
+			Data = Byte();
+			Write(ChipYMZ280B, Command >> 7, 0, Address);
+			Write(ChipYMZ280B, Command >> 7, 1, Data);
+			break;
+
+		case 0x61: /* Wait n samples */
+			m_Stream.Read(Data, 2);
+			if (Data != 0) return Data;
+			break;
+
+		case 0x62: /* Wait 1/60th of a second */
+			return 735;
+
+		case 0x63: /* Wait 1/50th of a second */
+			return 882;
+
+		case 0x67: /* Data block */
+			ReadDataBlock();
+			break;
+
+		case 0x68: /* PCM RAM write */
+			WriteBankToMemory();
+			break;
+
+		case 0x70: case 0x71: case 0x72: case 0x73: case 0x74: case 0x75: case 0x76: case 0x77:
+		case 0x78: case 0x79: case 0x7A: case 0x7B: case 0x7C: case 0x7D: case 0x7E: case 0x7F:
+			return (Command & 0x0F) + 1;
+
+		case 0x80: case 0x81: case 0x82: case 0x83: case 0x84: case 0x85: case 0x86: case 0x87:
+		case 0x88: case 0x89: case 0x8A: case 0x8B: case 0x8C: case 0x8D: case 0x8E: case 0x8F:
+		{
+			/* YM2612 DAC write from the PCM data bank + wait */
+			auto& Bank = m_DataBank[0x00];
+
+			if (m_DataBankPos < Bank.size())
+			{
+				Write(ChipYM2612, 0, 0, 0x2A);
+				Write(ChipYM2612, 0, 1, Bank[m_DataBankPos++]);
+			}
+
+			if (Command & 0x0F) return Command & 0x0F;
+			break;
+		}
+
+		case 0x90: case 0x91: case 0x92: case 0x93: case 0x94: case 0x95: /* DAC stream control */
+			ControlStream(Command);
+			break;
+
+		case 0xA0: /* AY8910, bit 7 selects the 2nd chip */
+			Address = Byte();
+			Data = Byte();
+			Write(ChipAY8910, Address >> 7, Address & 0x7F, Data);
+			break;
+
+		case 0xB0: /* RF5C68 register */
+			Address = Byte();
+			Data = Byte();
+			Write(ChipRF5C68, 0, Address, Data);
+			break;
+
+		case 0xB1: /* RF5C164 register */
+			Address = Byte();
+			Data = Byte();
+			Write(ChipRF5C164, 0, Address, Data);
+			break;
+
+		case 0xB2: /* PWM, 4-bit register + 12-bit data */
+			Address = Byte();
+			Data = Byte();
+			Write(ChipSegaPWM, 0, Address >> 4, ((Address & 0x0F) << 8) | Data);
+			break;
+
+		case 0xB5: /* MultiPCM */
+			Address = Byte();
+			Data = Byte();
+			Write(ChipYMW258F, Address >> 7, Address & 0x7F, Data);
+			break;
+
+		case 0xB8: /* OKIM6295, only the command register is a device register */
+			Address = Byte();
+			Data = Byte();
+			if ((Address & 0x7F) == 0x00) Write(ChipMSM6295, Address >> 7, 0, Data);
+			break;
+
+		case 0xC0: /* SegaPCM memory, bit 15 selects the 2nd chip */
+			m_Stream.Read(Address, 2);
+			Data = Byte();
+			Write(ChipSegaPCM, Address >> 15, Address & 0x7FFF, Data);
+			break;
+
+		case 0xC1: /* RF5C68 memory (current bank) */
+			m_Stream.Read(Address, 2);
+			Data = Byte();
+			Write(ChipRF5C68, 0, 0x1000 | (Address & 0x0FFF), Data);
+			break;
+
+		case 0xC2: /* RF5C164 memory (current bank) */
+			m_Stream.Read(Address, 2);
+			Data = Byte();
+			Write(ChipRF5C164, 0, 0x1000 | (Address & 0x0FFF), Data);
+			break;
+
+		case 0xC3: /* MultiPCM bank offset (bit 0 = left bank, bit 1 = right bank) */
+			Address = Byte();
+			m_Stream.Read(Data, 2);
+
+			if (auto Device = m_Chip[ChipYMW258F][Address >> 7].Device)
+			{
+				/* 512KB banks */
+				if (Address & 0x01) Device->SendExclusiveCommand(0x11, Data >> 3);
+				if (Address & 0x02) Device->SendExclusiveCommand(0x12, Data >> 3);
+			}
+			break;
+
+		case 0xD0: /* YMF278B, port + register + data */
+			Address = Byte();
+			m_Stream.Read(Data, 2);
+			Write(ChipYMF278B, Address >> 7, (Address & 0x03) << 1, Data & 0xFF);
+			Write(ChipYMF278B, Address >> 7, ((Address & 0x03) << 1) | 1, Data >> 8);
+			break;
+
+		case 0xE0: /* Seek in the PCM data bank */
+			m_Stream.Read(m_DataBankPos, 4);
+			break;
+
+		default: /* Unsupported */
+			m_Stream.Skip(GetOperandSize(Command));
+			break;
+		}
+	}
+}
+
+void VgmPlayer::FlushWrites()
+{
+	auto& Batch = m_Batch;
+
+	if (Batch.Count == 0) return;
+
+	if (!Batch.Device->WriteBatch(Batch.Port, Batch.Writes, Batch.Count))
+	{
+		/* Address / data writes */
+		for (size_t i = 0; i < Batch.Count; i++)
+		{
+			Batch.Device->Write(Batch.Port << 1, Batch.Writes[i].Register);
+			Batch.Device->Write((Batch.Port << 1) | 1, Batch.Writes[i].Data);
+		}
+	}
+
+	Batch.Count = 0;
+}
+
+void VgmPlayer::ReadDataBlock()
+{
+	uint32_t Compatibility = 0;
+	uint32_t Type = 0;
+	uint32_t Size = 0;
+
+	/* 0x67 0x66 tt ss ss ss ss */
+	m_Stream.Read(Compatibility, 1);
+	m_Stream.Read(Type, 1);
+	m_Stream.Read(Size, 4);
+
+	uint32_t Instance = Size >> 31;
+	Size &= 0x7FFFFFFF;
+
+	/* Blocks in front of this offset were loaded before the loop point was passed */
+	uint64_t Start = m_Stream.Tell();
+	bool Loaded = Start < m_DataBlockEnd;
+
+	m_DataBlockEnd = std::max(m_DataBlockEnd, Start + Size);
+
+	if (Type < 0x40) /* PCM data bank */
+	{
+		if (Loaded)
+		{
+			m_Stream.Skip(Size);
+			return;
+		}
+
+		auto& Bank = m_DataBank[Type];
+		size_t Offset = Bank.size();
+		const uint8_t* Data = Bank.data();
+
+		m_DataBlocks[Type].push_back((uint32_t)Offset);
+
+		Bank.resize(Offset + Size);
+		Bank.resize(Offset + m_Stream.Read(Bank.data() + Offset, Size));
+
+		if (Bank.data() != Data) ReleaseBank(Type);
+	}
+	else if (Type < 0x7F) /* Compressed PCM data bank */
+	{
+		if (Loaded)
+		{
+			m_Stream.Skip(Size);
+			return;
+		}
+
+		auto& Bank = m_DataBank[Type - 0x40];
+		const uint8_t* Data = Bank.data();
+
+		m_DataBlocks[Type - 0x40].push_back((uint32_t)Bank.size());
+
+		ReadCompressedBlock(Bank, Size);
+
+		if (Bank.data() != Data) ReleaseBank(Type - 0x40);
+	}
+	else if (Type == 0x7F) /* Decompression table */
+	{
+		ReadTable(Size);
+	}
+	else if (Type < 0xC0) /* ROM / RAM image: total size, start offset, data */
+	{
+		uint32_t RomSize = 0;
+		uint32_t Offset = 0;
+
+		m_Stream.Read(RomSize, 4);
+		m_Stream.Read(Offset, 4);
+
+		Size = (Size >= 8) ? Size - 8 : 0;
+
+		if (Loaded)
+		{
+			m_Stream.Skip(Size);
+			return;
+		}
+
+		switch (Type)
+		{
+		case 0x80: StreamToMemory(m_Chip[ChipSegaPCM][Instance], 0, Offset, Size, false); break;
+		case 0x81: StreamToMemory(m_Chip[ChipYM2608][Instance], YM::OPN::Memory::ADPCMB, Offset, Size, false); break;
+		case 0x82: StreamToMemory(m_Chip[ChipYM2610][Instance], YM::OPN::Memory::ADPCMA, Offset, Size, false); break;
+		case 0x83: StreamToMemory(m_Chip[ChipYM2610][Instance], YM::OPN::Memory::ADPCMB, Offset, Size, false); break;
+		case 0x84: StreamToMemory(m_Chip[ChipYMF278B][Instance], 0, Offset, Size, false); break;
+		case 0x86: StreamToMemory(m_Chip[ChipYMZ280B][Instance], 0, Offset, Size, false); break;
+		case 0x87: StreamToMemory(m_Chip[ChipYMF278B][Instance], 0, 0x200000 + Offset, Size, false); break; /* SRAM */
+		case 0x88: StreamToMemory(m_Chip[ChipY8950][Instance], 0, Offset, Size, false); break;
+		case 0x89: StreamToMemory(m_Chip[ChipYMW258F][Instance], 0, Offset, Size, false); break;
+		case 0x8B: StreamToMemory(m_Chip[ChipMSM6295][Instance], 0, Offset, Size, false); break;
+		default: m_Stream.Skip(Size); break;
+		}
+	}
+	else if (Type < 0xE0) /* RAM write, 16-bit start offset */
+	{
+		uint32_t Offset = 0;
+
+		m_Stream.Read(Offset, 2);
+
+		Size = (Size >= 2) ? Size - 2 : 0;
+
+		switch (Type)
+		{
+		case 0xC0: StreamToMemory(m_Chip[ChipRF5C68][Instance], 0, Offset, Size, true); break;
+		case 0xC1: StreamToMemory(m_Chip[ChipRF5C164][Instance], 0, Offset, Size, true); break;
+		default: m_Stream.Skip(Size); break;
+		}
+	}
+	else /* RAM write, 32-bit start offset */
+	{
+		m_Stream.Skip(Size);
+	}
+}
+
+void VgmPlayer::ReadCompressedBlock(std::vector<uint8_t>& Bank, uint32_t Size)
+{
+	uint32_t Type = 0;
+	uint32_t Length = 0;
+	uint32_t BitsDecompressed = 0;
+	uint32_t BitsCompressed = 0;
+	uint32_t SubType = 0;
+	uint32_t Value = 0;
+
+	/* Compression type, decompressed size, bits decompressed / compressed, sub type, add / start value */
+	m_Stream.Read(Type, 1);
+	m_Stream.Read(Length, 4);
+	m_Stream.Read(BitsDecompressed, 1);
+	m_Stream.Read(BitsCompressed, 1);
+	m_Stream.Read(SubType, 1);
+	m_Stream.Read(Value, 2);
+
+	uint32_t Remaining = (Size >= 10) ? Size - 10 : 0;
+
+	/* n-bit compression (type 0) or DPCM (type 1) */
+	bool UseTable = (Type == 0x01) || (SubType == 0x02);
+	bool Valid = (Type <= 0x01) && (BitsCompressed >= 1) && (BitsCompressed <= 16) && (BitsDecompressed >= BitsCompressed) && (BitsDecompressed <= 16);
+
+	if (UseTable && ((m_Table.Type != Type) || (m_Table.BitsDecompressed != BitsDecompressed) || (m_Table.BitsCompressed != BitsCompressed))) Valid = false;
+
+	if (!Valid)
+	{
+		m_Stream.Skip(Remaining);
+		return;
+	}
+
+	uint32_t Bytes = (BitsDecompressed + 7) / 8;
+	uint32_t Mask = (1 << BitsDecompressed) - 1;
+	uint32_t Accumulator = 0;
+	uint32_t AccumulatorBits = 0;
+
+	/* Compressed values are stored MSB first, values over 8 bits are read in 8 bit parts (low part first) */
+	auto ReadValue = [&](uint32_t& In)
+	{
+		In = 0;
+
+		for (uint32_t Bit = 0; Bit < BitsCompressed; Bit += 8)
+		{
+			uint32_t Count = std::min(8u, BitsCompressed - Bit);
+
+			while (AccumulatorBits < Count)
+			{
+				uint8_t Data = 0;
+
+				if ((Remaining == 0) || !m_Stream.Read(Data)) return false;
+
+				Remaining--;
+				Accumulator = (Accumulator << 8) | Data;
+				AccumulatorBits += 8;
+			}
+
+			AccumulatorBits -= Count;
+			In |= ((Accumulator >> AccumulatorBits) & ((1 << Count) - 1)) << Bit;
+		}
+
+		return true;
+	};
+
+	size_t End = Bank.size() + Length;
+	uint32_t In = 0;
+
+	Bank.reserve(End);
+
+	while (((Bank.size() + Bytes) <= End) && ReadValue(In))
+	{
+		uint32_t Out = 0;
+		uint32_t Entry = (In < m_Table.Values.size()) ? m_Table.Values[In] : 0;
+
+		if (Type == 0x01) /* DPCM */
+		{
+			Value = (Value + Entry) & Mask;
+			Out = Value;
+		}
+		else if (SubType == 0x00) /* Copy */
+		{
+			Out = In + Value;
+		}
+		else if (SubType == 0x01) /* Shift left */
+		{
+			Out = (In << (BitsDecompressed - BitsCompressed)) + Value;
+		}
+		else /* Table */
+		{
+			Out = Entry;
+		}
+
+		for (uint32_t i = 0; i < Bytes; i++) Bank.push_back((uint8_t)(Out >> (i * 8)));
+	}
+
+	m_Stream.Skip(Remaining);
+}
+
+void VgmPlayer::ReadTable(uint32_t Size)
+{
+	uint32_t Data = 0;
+	uint32_t Count = 0;
+
+	/* Compression type, sub type, bits decompressed / compressed, value count */
+	m_Stream.Read(Data, 1); m_Table.Type = (uint8_t)Data;
+	m_Stream.Read(Data, 1); m_Table.SubType = (uint8_t)Data;
+	m_Stream.Read(Data, 1); m_Table.BitsDecompressed = (uint8_t)Data;
+	m_Stream.Read(Data, 1); m_Table.BitsCompressed = (uint8_t)Data;
+	m_Stream.Read(Count, 2);
+
+	uint32_t Bytes = (m_Table.BitsDecompressed > 8) ? 2 : 1;
+	uint32_t Remaining = (Size >= 6) ? Size - 6 : 0;
+
+	m_Table.Values.clear();
+
+	for (uint32_t i = 0; (i < Count) && (Remaining >= Bytes); i++)
+	{
+		m_Stream.Read(Data, Bytes);
+		m_Table.Values.push_back((uint16_t)Data);
+
+		Remaining -= Bytes;
+	}
+
+	m_Stream.Skip(Remaining);
+}
+
+void VgmPlayer::StreamToMemory(chip_t& Target, uint32_t MemoryID, size_t Offset, size_t Size, bool Indirect)
+{
+	while (Size > 0)
+	{
+		size_t Count = m_Stream.Read(m_Transfer.data(), std::min(Size, m_Transfer.size()));
+		if (Count == 0) break;
+
+		if (Target.Memory != nullptr)
+		{
+			if (Indirect) Target.Memory->CopyToMemoryIndirect(MemoryID, Offset, m_Transfer.data(), Count);
+			else Target.Memory->CopyToMemory(MemoryID, Offset, m_Transfer.data(), Count);
+		}
+
+		Offset += Count;
+		Size -= Count;
+	}
+}
+
+void VgmPlayer::WriteBankToMemory()
+{
+	uint32_t Compatibility = 0;
+	uint32_t Type = 0;
+	uint32_t ReadOffset = 0;
+	uint32_t WriteOffset = 0;
+	uint32_t Size = 0;
+
+	/* 0x68 0x66 cc oo oo oo dd dd dd ss ss ss */
+	m_Stream.Read(Compatibility, 1);
+	m_Stream.Read(Type, 1);
+	m_Stream.Read(ReadOffset, 3);
+	m_Stream.Read(WriteOffset, 3);
+	m_Stream.Read(Size, 3);
+
+	if (Size == 0) Size = 0x1000000;
+
+	auto& Bank = m_DataBank[Type & 0x3F];
+	if (ReadOffset >= Bank.size()) return;
+
+	Size = std::min<uint32_t>(Size, (uint32_t)Bank.size() - ReadOffset);
+
+	IMemoryAccess* Memory = nullptr;
+
+	switch (Type)
+	{
+	case 0x01: Memory = m_Chip[ChipRF5C68][0].Memory; break;
+	case 0x02: Memory = m_Chip[ChipRF5C164][0].Memory; break;
+	default: break;
+	}
+
+	/* Offset within the current RAM bank */
+	if (Memory != nullptr) Memory->CopyToMemoryIndirect(0, WriteOffset, Bank.data() + ReadOffset, Size);
+}
+
+void VgmPlayer::ControlStream(uint8_t Command)
+{
+	uint32_t Id = 0;
+	uint32_t Value = 0;
+
+	m_Stream.Read(Id, 1);
+
+	if (Command == 0x94) /* Stop stream, 0xFF = all streams */
+	{
+		for (uint32_t i = 0; i < 0xFF; i++)
+		{
+			if (((Id == 0xFF) || (Id == i)) && (m_DacStream[i].Device != nullptr)) m_DacStream[i].Device->StopDacStream();
+		}
+
+		return;
+	}
+
+	/* Operands of an invalid stream id are still read */
+	stream_t Ignored = {};
+	stream_t& Stream = (Id < 0xFF) ? m_DacStream[Id] : Ignored;
+
+	switch (Command)
+	{
+	case 0x90: /* Setup: chip type (bit 7 = 2nd chip), port, register */
+	{
+		uint32_t Type = 0;
+		uint32_t Port = 0;
+		uint32_t Register = 0;
+
+		m_Stream.Read(Type, 1);
+		m_Stream.Read(Port, 1);
+		m_Stream.Read(Register, 1);
+
+		uint32_t Instance = Type >> 7;
+
+		/* Chip types follow the header clock order */
+		switch (Type & 0x7F)
+		{
+		case 0x02: Stream.Device = m_Chip[ChipYM2612][Instance].Stream; break;
+		case 0x05: Stream.Device = m_Chip[ChipRF5C68][Instance].Stream; break;
+		case 0x10: Stream.Device = m_Chip[ChipRF5C164][Instance].Stream; break;
+		case 0x11: Stream.Device = m_Chip[ChipSegaPWM][Instance].Stream; break;
+		default: Stream.Device = nullptr; break;
+		}
+
+		Stream.Register = (Port << 8) | Register;
+		break;
+	}
+
+	case 0x91: /* Data bank, step size, step base */
+		m_Stream.Read(Value, 1);
+		m_Stream.Read(Stream.Step, 1);
+		m_Stream.Read(Stream.Base, 1);
+
+		Stream.Bank = Value & 0x3F;
+		break;
+
+	case 0x92: /* Frequency */
+		m_Stream.Read(Stream.Frequency, 4);
+
+		if (Stream.Device != nullptr) Stream.Device->SetDacStreamFrequency(Stream.Frequency);
+		break;
+
+	case 0x93: /* Start: bank offset (0xFFFFFFFF = unchanged), length mode (bit 7 = loop), length */
+	{
+		uint32_t Offset = 0;
+		uint32_t Mode = 0;
+		uint32_t Length = 0;
+
+		m_Stream.Read(Offset, 4);
+		m_Stream.Read(Mode, 1);
+		m_Stream.Read(Length, 4);
+
+		if (Offset != 0xFFFFFFFF) Stream.Offset = Offset;
+
+		switch (Mode & 0x03)
+		{
+		case 0x01: Stream.Length = Length; break; /* Samples */
+		case 0x02: Stream.Length = (uint32_t)(((uint64_t)Length * Stream.Frequency) / 1000); break; /* Milliseconds */
+		case 0x03: Stream.Length = 0; break; /* Up to the end of the bank */
+		default: break; /* Unchanged */
+		}
+
+		auto& Bank = m_DataBank[Stream.Bank];
+
+		if (Stream.Offset < Bank.size()) StartStream(Stream, Stream.Offset, Bank.size() - Stream.Offset, Stream.Length, (Mode & 0x80) != 0);
+		break;
+	}
+
+	case 0x95: /* Start data block: block id, flags (bit 0 = loop) */
+	{
+		uint32_t Block = 0;
+		uint32_t Flags = 0;
+
+		m_Stream.Read(Block, 2);
+		m_Stream.Read(Flags, 1);
+
+		auto& Blocks = m_DataBlocks[Stream.Bank];
+		size_t BankSize = m_DataBank[Stream.Bank].size();
+
+		if (Block < Blocks.size())
+		{
+			size_t Start = Blocks[Block];
+			size_t End = ((Block + 1) < Blocks.size()) ? Blocks[Block + 1] : BankSize;
+
+			StartStream(Stream, Start, End - Start, 0, (Flags & 0x01) != 0);
+		}
+		break;
+	}
+
+	default:
+		break;
+	}
+}
+
+void VgmPlayer::StartStream(stream_t& Stream, size_t Offset, size_t Size, uint32_t Length, bool Loop)
+{
+	if (Stream.Device == nullptr) return;
+
+	DAC_STREAM_DESC Desc;
+
+	Desc.Data = m_DataBank[Stream.Bank].data() + Offset;
+	Desc.Size = Size;
+	Desc.Register = Stream.Register;
+	Desc.Frequency = Stream.Frequency;
+	Desc.Step = Stream.Step;
+	Desc.Base = Stream.Base;
+	Desc.Length = Length;
+	Desc.Loop = Loop;
+
+	/* A new stream always replaces the current one */
+	if (!Stream.Device->StartDacStream(Desc)) Stream.Device->StopDacStream();
+}
+
+void VgmPlayer::ReleaseBank(uint32_t Bank)
+{
+	/* The bank moved while growing, streams can't keep reading from it */
+	for (auto& Stream : m_DacStream)
+	{
+		if ((Stream.Device != nullptr) && (Stream.Bank == Bank)) Stream.Device->StopDacStream();
+	}
+}
\ No newline at end of file
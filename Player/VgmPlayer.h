@@ -0,0 +1,221 @@
+/*
+ _____    _ _            ___
+|_   _| _(_) |_ ___ _ _ / __|___ _ _ ___
+  | || '_| |  _/ _ \ ' \ (__/ _ \ '_/ -_)
+  |_||_| |_|\__\___/_||_\___\___/_| \___|
+
+Copyright  2024, Michel Gerritse
+All rights reserved.
+
+This source code is available under the BSD-3-Clause license.
+See LICENSE.txt in the root directory of this source tree.
+
+*/
+#ifndef _PLAYER_VGM_PLAYER_H_
+#define _PLAYER_VGM_PLAYER_H_
+
+#include <memory>
+
+#include "../Audio/Mixer.h"
+#include "../Core/StateHash.h"
+#include "../Interfaces/IDacStream.h"
+#include "../Interfaces/IMemoryAccess.h"
+#include "VgmStream.h"
+
+/* VGM file header */
+struct VGM_HEADER
+{
+	uint32_t	Version;		/* BCD, eg. 0x171 = 1.71 */
+	uint32_t	EndOfFile;		/* Absolute file offsets (0 = not present) */
+	uint32_t	Gd3Offset;
+	uint32_t	DataOffset;
+	uint32_t	LoopOffset;
+	uint32_t	TotalSamples;	/* 44.1 kHz samples */
+	uint32_t	LoopSamples;
+	uint32_t	Rate;			/* Recording rate (informational) */
+	uint8_t		Raw[0x100];		/* Header as stored in the file, zero beyond the header size */
+};
+
+/* Streaming VGM / VGZ player
+   Creates the devices listed in the header, feeds them the logged commands and
+   mixes them to stereo. The file is read (and decompressed) in small blocks while
+   playing, memory use does not depend on the size of the file */
+class VgmPlayer
+{
+public:
+	static constexpr uint32_t TickRate = 44100; /* VGM time base */
+
+	/* Threads = number of mixer worker threads (0 = render on the calling thread) */
+	VgmPlayer(uint32_t SampleRate, uint32_t Threads = 0, ResamplerQuality Quality = ResamplerQuality::Medium);
+	~VgmPlayer();
+
+	VgmPlayer(const VgmPlayer&) = delete;
+	VgmPlayer& operator=(const VgmPlayer&) = delete;
+
+	/* Returns false if the file can't be opened or is not a VGM file */
+	bool				Open(const std::filesystem::path& FileName);
+	void				Close();
+
+	/* Number of times the loop section is repeated (default 1) */
+	void				SetLoopCount(uint32_t Loops);
+
+	/* Render interleaved stereo frames, returns the number of frames rendered
+	   The remainder of the output is cleared at the end of the stream */
+	size_t				Render(float* Out, size_t Frames);
+
+	bool				IsFinished() const;
+	uint32_t			GetLoopsPlayed() const;
+	uint64_t			GetPosition() const; /* Ticks (44.1 kHz samples) played */
+
+	/* True if all devices are silent until their next register write (see ISoundDevice::IsSilent) */
+	bool				IsSilent() const;
+
+	/* Hash of the state of all devices (see Core/StateHash.h), eg. taken at the loop offset of two
+	   passes: equal hashes mean the loop is exact and repeating it renders the same output */
+	uint64_t			GetStateHash();
+	uint32_t			GetSampleRate() const;
+
+	const VGM_HEADER&	GetHeader() const;
+
+	uint32_t			GetDeviceCount() const;
+	ISoundDevice*		GetDevice(uint32_t DeviceNr) const;
+
+	/* Copy the native output of a device to Tap (see Mixer::SetOutputTap) */
+	void				SetOutputTap(uint32_t DeviceNr, uint32_t OutputNr, IAudioBuffer* Tap);
+
+private:
+	enum Chip : uint32_t
+	{
+		ChipSN76489 = 0,
+		ChipYM2612,
+		ChipYM2203,
+		ChipYM2608,
+		ChipYM2610,
+		ChipYM3812,
+		ChipYM3526,
+		ChipY8950,
+		ChipYMF278B,
+		ChipYMZ280B,
+		ChipRF5C68,
+		ChipRF5C164,
+		ChipSegaPWM,
+		ChipAY8910,
+		ChipSegaPCM,
+		ChipYMW258F,
+		ChipMSM6295,
+		ChipCount
+	};
+
+	struct chip_t
+	{
+		ISoundDevice*	Device;
+		IMemoryAccess*	Memory;
+		IDacStream*		Stream;
+	};
+
+	/* DAC stream control (commands 0x90 - 0x95), played by the device itself */
+	struct stream_t
+	{
+		IDacStream*	Device;		/* Not set up = nullptr */
+		uint32_t	Register;
+		uint32_t	Bank;		/* Data bank (block type 0x00 - 0x3F) */
+		uint32_t	Step;
+		uint32_t	Base;
+		uint32_t	Frequency;
+		uint32_t	Offset;		/* Data bank offset */
+		uint32_t	Length;		/* Samples (0 = up to the end of the bank) */
+	};
+
+	/* Decompression table (data block type 0x7F) */
+	struct table_t
+	{
+		uint8_t					Type;
+		uint8_t					SubType;
+		uint8_t					BitsDecompressed;
+		uint8_t					BitsCompressed;
+		std::vector<uint16_t>	Values;
+	};
+
+	/* Register writes to one device port, sent with a single WriteBatch call */
+	struct batch_t
+	{
+		ISoundDevice*	Device;
+		uint32_t		Port;
+		size_t			Count;
+		REGISTER_WRITE	Writes[256];
+	};
+
+	using device_ptr = std::unique_ptr<ISoundDevice, void(*)(ISoundDevice*)>;
+
+	bool				ReadHeader();
+	uint32_t			GetClock(uint32_t Offset) const;
+	void				CreateDevices();
+
+	template<typename T, typename... Args>
+	void				AddDevice(Chip Type, uint32_t Clock, float Gain, const Args&... Arguments);
+
+	uint32_t			ProcessCommands();
+	void				ReadDataBlock();
+	void				ReadCompressedBlock(std::vector<uint8_t>& Bank, uint32_t Size);
+	void				ReadTable(uint32_t Size);
+	void				StreamToMemory(chip_t& Target, uint32_t MemoryID, size_t Offset, size_t Size, bool Indirect);
+	void				WriteBankToMemory();
+	void				ControlStream(uint8_t Command);
+	void				StartStream(stream_t& Stream, size_t Offset, size_t Size, uint32_t Length, bool Loop);
+	void				ReleaseBank(uint32_t Bank);
+
+	inline void			Write(Chip Type, uint32_t Instance, uint32_t Address, uint32_t Data)
+	{
+		auto Device = m_Chip[Type][Instance & 0x01].Device;
+
+		if (Device != nullptr) Device->Write(Address, Data);
+	}
+
+	/* Queue a register write, consecutive writes to the same port are batched */
+	inline void			WriteRegister(Chip Type, uint32_t Instance, uint32_t Port, uint32_t Register, uint32_t Data)
+	{
+		auto Device = m_Chip[Type][Instance & 0x01].Device;
+
+		if (Device == nullptr) return;
+
+		if ((Device != m_Batch.Device) || (Port != m_Batch.Port) || (m_Batch.Count == std::size(m_Batch.Writes)))
+		{
+			FlushWrites();
+
+			m_Batch.Device = Device;
+			m_Batch.Port = Port;
+		}
+
+		m_Batch.Writes[m_Batch.Count++] = { (uint16_t)Register, (uint16_t)Data };
+	}
+
+	void				FlushWrites();
+
+	uint32_t				m_SampleRate;
+	Mixer					m_Mixer;
+	VgmStream				m_Stream;
+	VGM_HEADER				m_Header;
+
+	std::vector<device_ptr>	m_Devices;
+	std::vector<IStateAccess*>	m_States;		/* State access of the devices (for GetStateHash) */
+	TC::StateHash			m_StateHash;
+	chip_t					m_Chip[ChipCount][2];
+
+	std::vector<uint8_t>	m_DataBank[0x40];	/* Data blocks 0x00 - 0x3F (eg. YM2612 PCM data) */
+	std::vector<uint32_t>	m_DataBlocks[0x40];	/* Bank offset of each data block */
+	uint32_t				m_DataBankPos;		/* YM2612 PCM data position */
+	table_t					m_Table;
+	stream_t				m_DacStream[0xFF];
+	batch_t					m_Batch;			/* Pending register writes */
+	std::vector<uint8_t>	m_Transfer;			/* Data block transfer buffer */
+	uint64_t				m_DataBlockEnd;		/* Stream offset up to which data blocks are loaded */
+
+	uint32_t				m_Loops;
+	uint32_t				m_LoopsPlayed;
+	uint64_t				m_Ticks;			/* Ticks waited for */
+	uint64_t				m_Frames;			/* Frames rendered */
+	uint64_t				m_FrameTarget;		/* Frames to render before the next command */
+	bool					m_Finished;
+};
+
+#endif // !_PLAYER_VGM_PLAYER_H_
\ No newline at end of file
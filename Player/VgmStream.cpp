@@ -0,0 +1,214 @@
+/*
+ _____    _ _            ___
+|_   _| _(_) |_ ___ _ _ / __|___ _ _ ___
+  | || '_| |  _/ _ \ ' \ (__/ _ \ '_/ -_)
+  |_||_| |_|\__\___/_||_\___\___/_| \___|
+
+Copyright  2024, Michel Gerritse
+All rights reserved.
+
+This source code is available under the BSD-3-Clause license.
+See LICENSE.txt in the root directory of this source tree.
+
+*/
+#include "VgmStream.h"
+
+VgmStream::VgmStream() :
+	m_Compressed(false),
+	m_Pos(0),
+	m_End(0),
+	m_BufferOffset(0)
+{
+	m_Mark.Valid = false;
+}
+
+bool VgmStream::Open(const std::filesystem::path& FileName)
+{
+	Close();
+
+	if (!m_File.Open(FileName)) return false;
+
+	m_Buffer.resize(BufferSize);
+
+	/* Gzip (RFC 1952) magic */
+	uint8_t Magic[2] = {};
+
+	if ((m_File.Read(Magic, 2) == 2) && (Magic[0] == 0x1F) && (Magic[1] == 0x8B))
+	{
+		if (!ReadGzipHeader())
+		{
+			Close();
+			return false;
+		}
+
+		m_Compressed = true;
+		m_Inflater.Reset(&m_File);
+	}
+	else
+	{
+		m_File.Seek(0);
+	}
+
+	return true;
+}
+
+void VgmStream::Close()
+{
+	m_File.Close();
+	m_Inflater.Reset(nullptr);
+	m_Compressed = false;
+
+	m_Pos = 0;
+	m_End = 0;
+	m_BufferOffset = 0;
+
+	m_Mark.Valid = false;
+	std::vector<uint8_t>().swap(m_Mark.Pending);
+}
+
+size_t VgmStream::Read(void* Data, size_t Size)
+{
+	uint8_t* p = static_cast<uint8_t*>(Data);
+	size_t Done = 0;
+
+	while (Done < Size)
+	{
+		if ((m_Pos == m_End) && !Refill()) break;
+
+		size_t Count = std::min(Size - Done, m_End - m_Pos);
+
+		memcpy(p + Done, m_Buffer.data() + m_Pos, Count);
+
+		m_Pos += Count;
+		Done += Count;
+	}
+
+	return Done;
+}
+
+size_t VgmStream::Skip(size_t Size)
+{
+	size_t Done = 0;
+
+	while (Done < Size)
+	{
+		if ((m_Pos == m_End) && !Refill()) break;
+
+		size_t Count = std::min(Size - Done, m_End - m_Pos);
+
+		m_Pos += Count;
+		Done += Count;
+	}
+
+	return Done;
+}
+
+uint64_t VgmStream::Tell() const
+{
+	return m_BufferOffset + m_Pos;
+}
+
+void VgmStream::SetMark()
+{
+	m_Mark.Valid = true;
+	m_Mark.Offset = Tell();
+
+	if (m_Compressed)
+	{
+		/* Decoder state + the data it already produced */
+		m_Mark.Decoder = m_Inflater;
+		m_Mark.InputOffset = m_Inflater.GetInputOffset();
+		m_Mark.Pending.assign(m_Buffer.begin() + m_Pos, m_Buffer.begin() + m_End);
+	}
+}
+
+bool VgmStream::HasMark() const
+{
+	return m_Mark.Valid;
+}
+
+bool VgmStream::SeekMark()
+{
+	if (!m_Mark.Valid) return false;
+
+	if (m_Compressed)
+	{
+		m_File.Seek(m_Mark.InputOffset);
+		m_Inflater = m_Mark.Decoder;
+
+		std::copy(m_Mark.Pending.begin(), m_Mark.Pending.end(), m_Buffer.begin());
+
+		m_Pos = 0;
+		m_End = m_Mark.Pending.size();
+	}
+	else
+	{
+		m_File.Seek(m_Mark.Offset);
+
+		m_Pos = 0;
+		m_End = 0;
+	}
+
+	m_BufferOffset = m_Mark.Offset;
+
+	return true;
+}
+
+bool VgmStream::IsCompressed() const
+{
+	return m_Compressed;
+}
+
+bool VgmStream::Failed() const
+{
+	return m_Compressed && m_Inflater.Failed();
+}
+
+bool VgmStream::Refill()
+{
+	if (!m_File.IsOpen()) return false;
+
+	m_BufferOffset += m_End;
+
+	m_Pos = 0;
+	m_End = m_Compressed ? m_Inflater.Decode(m_Buffer.data(), m_Buffer.size()) : m_File.Read(m_Buffer.data(), m_Buffer.size());
+
+	return m_End != 0;
+}
+
+bool VgmStream::ReadGzipHeader()
+{
+	/* Compression method, flags, modification time, extra flags, OS */
+	uint8_t Header[8];
+	uint8_t Data = 0;
+
+	if ((m_File.Read(Header, 8) != 8) || (Header[0] != 0x08)) return false;
+
+	uint8_t Flags = Header[1];
+
+	if (Flags & 0x04) /* FEXTRA */
+	{
+		uint8_t Length[2];
+
+		if (m_File.Read(Length, 2) != 2) return false;
+
+		m_File.Seek(m_File.Tell() + (Length[0] | (Length[1] << 8)));
+	}
+
+	if (Flags & 0x08) /* FNAME */
+	{
+		do { if (!m_File.Read(Data)) return false; } while (Data != 0);
+	}
+
+	if (Flags & 0x10) /* FCOMMENT */
+	{
+		do { if (!m_File.Read(Data)) return false; } while (Data != 0);
+	}
+
+	if (Flags & 0x02) /* FHCRC */
+	{
+		m_File.Seek(m_File.Tell() + 2);
+	}
+
+	return true;
+}
\ No newline at end of file
@@ -0,0 +1,108 @@
+/*
+ _____    _ _            ___
+|_   _| _(_) |_ ___ _ _ / __|___ _ _ ___
+  | || '_| |  _/ _ \ ' \ (__/ _ \ '_/ -_)
+  |_||_| |_|\__\___/_||_\___\___/_| \___|
+
+Copyright  2024, Michel Gerritse
+All rights reserved.
+
+This source code is available under the BSD-3-Clause license.
+See LICENSE.txt in the root directory of this source tree.
+
+*/
+#ifndef _PLAYER_VGM_STREAM_H_
+#define _PLAYER_VGM_STREAM_H_
+
+#include "FileReader.h"
+#include "Inflate.h"
+
+/* Sequential VGM / VGZ data stream
+   Gzip compressed files are decompressed on the fly, only the read buffer and the
+   decompression window are kept in memory. A single position can be marked to return
+   to later on (the loop point) without decompressing the file from the start again */
+class VgmStream
+{
+public:
+	static constexpr size_t BufferSize = 0x10000;
+
+	VgmStream();
+
+	VgmStream(const VgmStream&) = delete;
+	VgmStream& operator=(const VgmStream&) = delete;
+
+	bool		Open(const std::filesystem::path& FileName);
+	void		Close();
+
+	/* Returns false at the end of the stream */
+	inline bool Read(uint8_t& Data)
+	{
+		if ((m_Pos == m_End) && !Refill()) return false;
+
+		Data = m_Buffer[m_Pos++];
+
+		return true;
+	}
+
+	/* Little endian value of Bytes bytes */
+	inline bool Read(uint32_t& Value, uint32_t Bytes)
+	{
+		uint8_t Data = 0;
+
+		Value = 0;
+
+		for (uint32_t i = 0; i < Bytes; i++)
+		{
+			if (!Read(Data)) return false;
+
+			Value |= (uint32_t)Data << (i * 8);
+		}
+
+		return true;
+	}
+
+	/* Returns the number of bytes read / skipped */
+	size_t		Read(void* Data, size_t Size);
+	size_t		Skip(size_t Size);
+
+	/* Stream offset of the next byte (uncompressed) */
+	uint64_t	Tell() const;
+
+	/* Remember the current position */
+	void		SetMark();
+	bool		HasMark() const;
+
+	/* Continue at the marked position, returns false if there is no mark */
+	bool		SeekMark();
+
+	bool		IsCompressed() const;
+
+	/* The compressed data is corrupt */
+	bool		Failed() const;
+
+private:
+	struct mark_t
+	{
+		bool					Valid;
+		uint64_t				Offset;
+		uint64_t				InputOffset;	/* Compressed file offset */
+		Inflater				Decoder;
+		std::vector<uint8_t>	Pending;		/* Buffered data after the mark */
+	};
+
+	bool					Refill();
+	bool					ReadGzipHeader();
+
+	FileReader				m_File;
+	Inflater				m_Inflater;
+	bool					m_Compressed;
+
+	std::vector<uint8_t>	m_Buffer;
+	size_t					m_Pos;
+	size_t					m_End;
+	uint64_t				m_BufferOffset;	/* Stream offset of the buffer */
+
+	mark_t					m_Mark;
+};
+
+#endif // !_PLAYER_VGM_STREAM_H_
\ No newline at end of file
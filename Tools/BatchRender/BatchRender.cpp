@@ -0,0 +1,264 @@
+/*
+ _____    _ _            ___
+|_   _| _(_) |_ ___ _ _ / __|___ _ _ ___
+  | || '_| |  _/ _ \ ' \ (__/ _ \ '_/ -_)
+  |_||_| |_|\__\___/_||_\___\___/_| \___|
+
+Copyright © 2024, Michel Gerritse
+All rights reserved.
+
+This source code is available under the BSD-3-Clause license.
+See LICENSE.txt in the root directory of this source tree.
+
+*/
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <mutex>
+#include <string>
+#include <thread>
+
+#include "../../TritonCore.h"
+#include "../../Audio/AudioFileSink.h"
+#include "../../Audio/WorkerPool.h"
+#include "../../Player/VgmPlayer.h"
+
+/*
+	TritonCore batch renderer
+
+	Renders VGM / VGZ files to WAV or FLAC files, many files at a time in a single process.
+	Every job creates its own player (and with it its own set of devices), the jobs are handed
+	out to the worker threads one by one, largest files first, so all threads stay busy until
+	the last jobs. Tables that don't depend on a device instance (resampler filters, decoded
+	ROMs) are built by the first job that needs them and shared by all later jobs.
+
+	Usage: BatchRender [options] FILE...
+
+	--list FILE    Also render the files listed in FILE (one per line)
+	--out DIR      Output directory (default: next to the input file)
+	--format F     wav or flac (default wav)
+	--rate N       Output sample rate (default 44100)
+	--loops N      Number of loops (default 1)
+	--threads N    Number of threads (default: all hardware threads)
+	--quality Q    Resampler quality: low, medium, high or best (default medium)
+*/
+
+struct options_t
+{
+	std::filesystem::path	OutDir;
+	bool					Flac = false;
+	uint32_t				SampleRate = 44100;
+	uint32_t				Loops = 1;
+	uint32_t				Threads = 0;
+	ResamplerQuality		Quality = ResamplerQuality::Medium;
+};
+
+struct job_t
+{
+	std::filesystem::path	Input;
+	std::filesystem::path	Output;
+	uintmax_t				FileSize;
+
+	bool					Done;
+	const char*				Error;
+	double					AudioSeconds;	/* Rendered audio */
+	double					Seconds;		/* Wall time */
+};
+
+static void RenderJob(job_t& Job, const options_t& Options)
+{
+	constexpr size_t Frames = 8192;
+
+	auto Start = std::chrono::steady_clock::now();
+
+	Job.Done = false;
+	Job.Error = nullptr;
+	Job.AudioSeconds = 0.0;
+
+	VgmPlayer Player(Options.SampleRate, 0, Options.Quality);
+	Player.SetLoopCount(Options.Loops);
+
+	/* 16-bit stereo files, the sink converts the float output of the player */
+	AUDIO_OUTPUT_DESC Desc = { Options.SampleRate, AudioFormat::AUDIO_FMT_S16, 2, SPEAKER_FRONT_LEFT | SPEAKER_FRONT_RIGHT, L"" };
+	AudioFileSink Sink;
+
+	if (!Player.Open(Job.Input)) Job.Error = "can't open file";
+	else if (!Sink.Open(Job.Output, Desc, Options.Flac ? AudioFileSink::FileType::Flac : AudioFileSink::FileType::Wav)) Job.Error = "can't create output file";
+	else
+	{
+		std::vector<float> Buffer(Frames * 2);
+		uint64_t Total = 0;
+
+		while (!Player.IsFinished())
+		{
+			size_t Count = Player.Render(Buffer.data(), Frames);
+
+			Sink.WriteSamplesF32(Buffer.data(), Count * 2);
+			Total += Count;
+		}
+
+		if (!Sink.Close()) Job.Error = "write error";
+
+		Job.AudioSeconds = (double)Total / Options.SampleRate;
+		Job.Done = (Job.Error == nullptr);
+	}
+
+	Job.Seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - Start).count();
+}
+
+static bool ReadList(const char* FileName, std::vector<std::filesystem::path>& Files)
+{
+	std::ifstream List(FileName);
+	std::string Line;
+
+	if (!List.is_open()) return false;
+
+	while (std::getline(List, Line))
+	{
+		while (!Line.empty() && ((Line.back() == '\r') || (Line.back() == ' '))) Line.pop_back();
+
+		if (!Line.empty()) Files.emplace_back(Line);
+	}
+
+	return true;
+}
+
+static int Usage(const char* Name)
+{
+	fprintf(stderr, "Usage: %s [--list FILE] [--out DIR] [--format wav|flac] [--rate N] [--loops N] [--threads N] [--quality low|medium|high|best] FILE...\n", Name);
+	return 1;
+}
+
+int main(int argc, char* argv[])
+{
+	options_t Options;
+	std::vector<std::filesystem::path> Files;
+
+	for (int i = 1; i < argc; i++)
+	{
+		bool HasValue = (i + 1 < argc);
+
+		if (!strcmp(argv[i], "--list") && HasValue)
+		{
+			if (!ReadList(argv[++i], Files))
+			{
+				fprintf(stderr, "Can't read %s\n", argv[i]);
+				return 1;
+			}
+		}
+		else if (!strcmp(argv[i], "--out") && HasValue)
+			Options.OutDir = argv[++i];
+		else if (!strcmp(argv[i], "--format") && HasValue)
+		{
+			const char* Format = argv[++i];
+
+			if (!strcmp(Format, "flac")) Options.Flac = true;
+			else if (strcmp(Format, "wav")) return Usage(argv[0]);
+		}
+		else if (!strcmp(argv[i], "--rate") && HasValue)
+			Options.SampleRate = std::clamp(atoi(argv[++i]), 8000, 384000);
+		else if (!strcmp(argv[i], "--loops") && HasValue)
+			Options.Loops = std::max(atoi(argv[++i]), 0);
+		else if (!strcmp(argv[i], "--threads") && HasValue)
+			Options.Threads = std::max(atoi(argv[++i]), 1);
+		else if (!strcmp(argv[i], "--quality") && HasValue)
+		{
+			const char* Quality = argv[++i];
+
+			if (!strcmp(Quality, "low")) Options.Quality = ResamplerQuality::Low;
+			else if (!strcmp(Quality, "medium")) Options.Quality = ResamplerQuality::Medium;
+			else if (!strcmp(Quality, "high")) Options.Quality = ResamplerQuality::High;
+			else if (!strcmp(Quality, "best")) Options.Quality = ResamplerQuality::Best;
+			else return Usage(argv[0]);
+		}
+		else if (argv[i][0] == '-')
+			return Usage(argv[0]);
+		else
+			Files.emplace_back(argv[i]);
+	}
+
+	if (Files.empty()) return Usage(argv[0]);
+
+	if (Options.Threads == 0) Options.Threads = std::max(std::thread::hardware_concurrency(), 1u);
+
+	std::error_code Error;
+
+	if (!Options.OutDir.empty()) std::filesystem::create_directories(Options.OutDir, Error);
+
+	/* Jobs */
+	std::vector<job_t> Jobs(Files.size());
+
+	for (size_t i = 0; i < Files.size(); i++)
+	{
+		auto& Job = Jobs[i];
+
+		Job.Input = Files[i];
+		Job.Output = Options.OutDir.empty() ? Files[i] : Options.OutDir / Files[i].filename();
+		Job.Output.replace_extension(Options.Flac ? ".flac" : ".wav");
+		Job.FileSize = std::filesystem::file_size(Files[i], Error);
+
+		if (Error) Job.FileSize = 0;
+	}
+
+	/* Largest files first, the small ones fill up the threads at the end */
+	std::stable_sort(Jobs.begin(), Jobs.end(), [](const job_t& a, const job_t& b) { return a.FileSize > b.FileSize; });
+
+	/* The calling thread is one of the workers */
+	WorkerPool Pool(Options.Threads - 1);
+	std::mutex PrintMutex;
+	size_t Completed = 0;
+
+	printf("Rendering %zu files on %u threads\n", Jobs.size(), Pool.GetThreadCount() + 1);
+
+	auto Start = std::chrono::steady_clock::now();
+
+	Pool.Run(Jobs.size(), [&](size_t Index)
+	{
+		auto& Job = Jobs[Index];
+
+		try
+		{
+			RenderJob(Job, Options);
+		}
+		catch (const std::exception&)
+		{
+			Job.Done = false;
+			Job.Error = "out of memory";
+		}
+
+		std::lock_guard<std::mutex> Lock(PrintMutex);
+
+		Completed++;
+
+		if (Job.Done)
+		{
+			printf("[%zu/%zu] %s: %.1f s in %.2f s (%.1fx realtime)\n", Completed, Jobs.size(), Job.Input.string().c_str(),
+				Job.AudioSeconds, Job.Seconds, (Job.Seconds > 0.0) ? Job.AudioSeconds / Job.Seconds : 0.0);
+		}
+		else
+		{
+			printf("[%zu/%zu] %s: %s\n", Completed, Jobs.size(), Job.Input.string().c_str(), Job.Error);
+		}
+
+		fflush(stdout);
+	});
+
+	double Seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - Start).count();
+	double AudioSeconds = 0.0;
+	double JobSeconds = 0.0;
+	size_t Failed = 0;
+
+	for (auto& Job : Jobs)
+	{
+		AudioSeconds += Job.AudioSeconds;
+		JobSeconds += Job.Seconds;
+		Failed += Job.Done ? 0 : 1;
+	}
+
+	printf("Done: %zu files, %zu failed, %.1f s of audio in %.2f s (%.1fx realtime, %.1fx per thread)\n", Jobs.size(), Failed,
+		AudioSeconds, Seconds, (Seconds > 0.0) ? AudioSeconds / Seconds : 0.0, (JobSeconds > 0.0) ? AudioSeconds / JobSeconds : 0.0);
+
+	return (Failed != 0) ? 1 : 0;
+}
\ No newline at end of file
@@ -0,0 +1,892 @@
+/*
+ _____    _ _            ___
+|_   _| _(_) |_ ___ _ _ / __|___ _ _ ___
+  | || '_| |  _/ _ \ ' \ (__/ _ \ '_/ -_)
+  |_||_| |_|\__\___/_||_\___\___/_| \___|
+
+Copyright  2024, Michel Gerritse
+All rights reserved.
+
+This source code is available under the BSD-3-Clause license.
+See LICENSE.txt in the root directory of this source tree.
+
+*/
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+#include <functional>
+#include <numbers>
+
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+#include <intrin.h>
+#define HAS_TSC 1
+#elif (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+#include <x86intrin.h>
+#define HAS_TSC 1
+#else
+#define HAS_TSC 0
+#endif
+
+#include "../../TritonCore.h"
+#include "../../Core/Trace.h"
+#include "../../Interfaces/IMemoryAccess.h"
+#include "../../Devices/Sound/AY8910.h"
+#include "../../Devices/Sound/MSM6295.h"
+#include "../../Devices/Sound/RF5C68.h"
+#include "../../Devices/Sound/SegaPCM.h"
+#include "../../Devices/Sound/SegaPWM.h"
+#include "../../Devices/Sound/SN76489.h"
+#include "../../Devices/Sound/Y8950.h"
+#include "../../Devices/Sound/YM2149.h"
+#include "../../Devices/Sound/YM2203.h"
+#include "../../Devices/Sound/YM2608.h"
+#include "../../Devices/Sound/YM2610.h"
+#include "../../Devices/Sound/YM2610B.h"
+#include "../../Devices/Sound/YM2612.h"
+#include "../../Devices/Sound/YM3526.h"
+#include "../../Devices/Sound/YM3812.h"
+#include "../../Devices/Sound/YMF278B.h"
+#include "../../Devices/Sound/YMF292F.h"
+#include "../../Devices/Sound/YMW258F.h"
+#include "../../Devices/Sound/YMZ280B.h"
+#include "../../Devices/Sound/YMZ284.h"
+
+/*
+	TritonCore device throughput benchmark
+
+	Every device is run in two scenarios:
+	- idle:  device reset to power on defaults, no register writes
+	- keyed: all channels programmed and keyed on (a representative worst case)
+
+	Usage: Benchmark [--seconds N] [--device NAME] [--json FILE] [--trace FILE]
+
+	--seconds N   Emulated seconds per scenario (default 5)
+	--device NAME Only run devices whose name contains NAME
+	--json FILE   Write the results to FILE (JSON)
+	--trace FILE  Replay a register write trace (see Core/Trace.h) instead of the scenarios,
+	              on the device the trace was recorded from
+*/
+
+/* Audio buffer that only counts the samples it receives */
+class CountingBuffer : public IAudioBuffer
+{
+public:
+	uint64_t Samples = 0;
+
+	void WriteSampleS16(int16_t Sample) { Samples++; }
+	void WriteSampleS32(int32_t Sample) { Samples++; }
+	void WriteSampleF32(float Sample) { Samples++; }
+
+	void WriteSamplesS16(const int16_t* pSamples, size_t Count) { Samples += Count; }
+	void WriteSamplesS32(const int32_t* pSamples, size_t Count) { Samples += Count; }
+	void WriteSamplesF32(const float* pSamples, size_t Count) { Samples += Count; }
+};
+
+struct result_t
+{
+	std::string	Device;
+	std::string	Scenario;
+	uint32_t	ClockSpeed;
+	uint32_t	SampleRate;		/* Sample rate of the first output */
+	uint64_t	Frames;			/* Frames generated on the first output */
+	double		Seconds;		/* Wall time */
+	double		FramesPerSecond;
+	double		NsPerFrame;
+	double		CyclesPerFrame;	/* Host CPU (TSC) cycles, 0 if not available */
+	double		Realtime;		/* Emulated time / wall time */
+};
+
+struct bench_t
+{
+	const char* Name;
+	std::function<std::unique_ptr<ISoundDevice>(bool Keyed)> Create;
+};
+
+/* Register write helpers */
+static void WriteReg(ISoundDevice* Device, uint32_t Port, uint8_t Register, uint8_t Data)
+{
+	Device->Write(Port + 0, Register);
+	Device->Write(Port + 1, Data);
+}
+
+static void Upload(ISoundDevice* Device, size_t Offset, std::vector<uint8_t>& Data)
+{
+	dynamic_cast<IMemoryAccess*>(Device)->CopyToMemory(0, Offset, Data.data(), Data.size());
+}
+
+/* Sample data */
+static std::vector<uint8_t> MakeSine8(size_t Size, bool Unsigned)
+{
+	std::vector<uint8_t> Data(Size);
+
+	for (size_t i = 0; i < Size; i++)
+	{
+		int32_t Sample = (int32_t)(std::sin(2.0 * std::numbers::pi * (double)i / 64.0) * 100.0);
+
+		Data[i] = (uint8_t)(Unsigned ? (Sample + 0x80) : Sample);
+	}
+
+	return Data;
+}
+
+static std::vector<uint8_t> MakeNoise(size_t Size)
+{
+	std::vector<uint8_t> Data(Size);
+	uint32_t LFSR = 0x12345678;
+
+	for (auto& Byte : Data)
+	{
+		LFSR ^= LFSR << 13;
+		LFSR ^= LFSR >> 17;
+		LFSR ^= LFSR << 5;
+
+		Byte = (uint8_t)LFSR;
+	}
+
+	return Data;
+}
+
+/* GEW wave table header (8-bit samples, 4KB looping wave at 0x1000) */
+static std::vector<uint8_t> MakeWaveHeader()
+{
+	std::vector<uint8_t> Header =
+	{
+		0x00, 0x10, 0x00,	/* Format (8-bit), start address */
+		0x00, 0x00,			/* Loop address */
+		0xF0, 0x00,			/* End address (0x10000 - length) */
+		0x00,				/* LFO / PM */
+		0xF0,				/* AR / DR */
+		0x00,				/* DL / SR */
+		0x0F,				/* RC / RR */
+		0x00				/* AM */
+	};
+
+	return Header;
+}
+
+/* Programs ch. 0..Count-1 of an OPN unit (port 0 = channels 1-3, port 1 = channels 4-6) */
+static void KeyOPN(ISoundDevice* Device, bool HasPort1, uint32_t Channels)
+{
+	/* The YM2610 has no channel 1 and 4 */
+	for (uint32_t Ch = 0; Ch < Channels; Ch++)
+	{
+		uint32_t Port = (Ch < 3) ? 0 : 2;
+		uint8_t Offset = Ch % 3;
+
+		if ((Port != 0) && !HasPort1) break;
+
+		for (uint8_t Op = 0; Op < 4; Op++)
+		{
+			uint8_t Slot = Offset + (Op * 4);
+
+			WriteReg(Device, Port, 0x30 + Slot, 0x71);					/* DT / MUL */
+			WriteReg(Device, Port, 0x40 + Slot, (Op == 3) ? 0x00 : 0x20);	/* TL */
+			WriteReg(Device, Port, 0x50 + Slot, 0x1F);					/* KS / AR */
+			WriteReg(Device, Port, 0x60 + Slot, 0x85);					/* AM / DR */
+			WriteReg(Device, Port, 0x70 + Slot, 0x02);					/* SR */
+			WriteReg(Device, Port, 0x80 + Slot, 0x13);					/* SL / RR */
+		}
+
+		WriteReg(Device, Port, 0xB0 + Offset, 0x32);	/* FB / Algorithm */
+		WriteReg(Device, Port, 0xB4 + Offset, 0xC0);	/* L / R */
+		WriteReg(Device, Port, 0xA4 + Offset, 0x22 + Ch);	/* Block / Fnum (H) */
+		WriteReg(Device, Port, 0xA0 + Offset, 0x69);	/* Fnum (L) */
+	}
+
+	/* LFO on, key on */
+	WriteReg(Device, 0, 0x22, 0x0B);
+
+	for (uint32_t Ch = 0; Ch < Channels; Ch++)
+	{
+		if ((Ch >= 3) && !HasPort1) break;
+
+		WriteReg(Device, 0, 0x28, 0xF0 | ((Ch < 3) ? Ch : (Ch + 1)));
+	}
+}
+
+/* Programs all tone channels of an SSG unit (port 0) */
+static void KeySSG(ISoundDevice* Device, uint32_t Port)
+{
+	for (uint8_t Ch = 0; Ch < 3; Ch++)
+	{
+		WriteReg(Device, Port, 0x00 + (Ch * 2), 0x80 + (Ch * 0x20));
+		WriteReg(Device, Port, 0x01 + (Ch * 2), 0x01);
+		WriteReg(Device, Port, 0x08 + Ch, 0x0F);
+	}
+
+	WriteReg(Device, Port, 0x06, 0x10);	/* Noise period */
+	WriteReg(Device, Port, 0x07, 0x30);	/* Tones on, noise on channel A - C */
+}
+
+/* Programs all melody channels of an OPL unit */
+static void KeyOPL(ISoundDevice* Device)
+{
+	static const uint8_t SlotOffset[9] = { 0x00, 0x01, 0x02, 0x08, 0x09, 0x0A, 0x10, 0x11, 0x12 };
+
+	WriteReg(Device, 0, 0x01, 0x20);	/* Wave select enable (OPL2) */
+	WriteReg(Device, 0, 0xBD, 0xC0);	/* AM / PM depth */
+
+	for (uint8_t Ch = 0; Ch < 9; Ch++)
+	{
+		for (uint8_t Op = 0; Op < 2; Op++)
+		{
+			uint8_t Slot = SlotOffset[Ch] + (Op * 3);
+
+			WriteReg(Device, 0, 0x20 + Slot, 0xE1);					/* AM / VIB / EG / MUL */
+			WriteReg(Device, 0, 0x40 + Slot, (Op == 1) ? 0x00 : 0x18);	/* KSL / TL */
+			WriteReg(Device, 0, 0x60 + Slot, 0xF4);					/* AR / DR */
+			WriteReg(Device, 0, 0x80 + Slot, 0x25);					/* SL / RR */
+			WriteReg(Device, 0, 0xE0 + Slot, Op);						/* Wave select (OPL2) */
+		}
+
+		WriteReg(Device, 0, 0xC0 + Ch, 0x0E);			/* FB / CON */
+		WriteReg(Device, 0, 0xA0 + Ch, 0x44 + Ch);		/* Fnum (L) */
+		WriteReg(Device, 0, 0xB0 + Ch, 0x32);			/* Key on / Block / Fnum (H) */
+	}
+}
+
+/* YM2610(B) ADPCM-A channels (port 1) */
+static void KeyADPCMA(ISoundDevice* Device)
+{
+	WriteReg(Device, 2, 0x01, 0x3F);	/* Total level */
+
+	for (uint8_t Ch = 0; Ch < 6; Ch++)
+	{
+		WriteReg(Device, 2, 0x08 + Ch, 0xDF);			/* L / R, level */
+		WriteReg(Device, 2, 0x10 + Ch, 0x00);			/* Start address (L) */
+		WriteReg(Device, 2, 0x18 + Ch, 0x00);			/* Start address (H) */
+		WriteReg(Device, 2, 0x20 + Ch, 0xFF);			/* End address (L) */
+		WriteReg(Device, 2, 0x28 + Ch, 0x0F);			/* End address (H) */
+	}
+
+	WriteReg(Device, 2, 0x00, 0x3F);	/* Key on */
+}
+
+static const bench_t s_Benchmarks[] =
+{
+	{ "AY8910", [](bool Keyed) -> std::unique_ptr<ISoundDevice>
+	{
+		auto Device = std::make_unique<AY8910>();
+		Device->Reset(ResetType::PowerOnDefaults);
+
+		if (Keyed)
+		{
+			/* The AY8910 is written directly by register number */
+			for (uint8_t Ch = 0; Ch < 3; Ch++)
+			{
+				Device->Write(0x00 + (Ch * 2), 0x80 + (Ch * 0x20));
+				Device->Write(0x01 + (Ch * 2), 0x01);
+				Device->Write(0x08 + Ch, 0x0F);
+			}
+
+			Device->Write(0x06, 0x10);
+			Device->Write(0x07, 0x30);
+		}
+
+		return Device;
+	}},
+
+	{ "YM2149", [](bool Keyed) -> std::unique_ptr<ISoundDevice>
+	{
+		auto Device = std::make_unique<YM2149>();
+		Device->Reset(ResetType::PowerOnDefaults);
+
+		if (Keyed)
+		{
+			for (uint8_t Ch = 0; Ch < 3; Ch++)
+			{
+				Device->Write(0x00 + (Ch * 2), 0x80 + (Ch * 0x20));
+				Device->Write(0x01 + (Ch * 2), 0x01);
+				Device->Write(0x08 + Ch, 0x0F);
+			}
+
+			Device->Write(0x06, 0x10);
+			Device->Write(0x07, 0x30);
+		}
+
+		return Device;
+	}},
+
+	{ "YMZ284", [](bool Keyed) -> std::unique_ptr<ISoundDevice>
+	{
+		auto Device = std::make_unique<YMZ284>();
+		Device->Reset(ResetType::PowerOnDefaults);
+
+		if (Keyed)
+		{
+			for (uint8_t Ch = 0; Ch < 3; Ch++)
+			{
+				Device->Write(0x00 + (Ch * 2), 0x80 + (Ch * 0x20));
+				Device->Write(0x01 + (Ch * 2), 0x01);
+				Device->Write(0x08 + Ch, 0x0F);
+			}
+
+			Device->Write(0x06, 0x10);
+			Device->Write(0x07, 0x30);
+		}
+
+		return Device;
+	}},
+
+	{ "SN76489 (Sega PSG)", [](bool Keyed) -> std::unique_ptr<ISoundDevice>
+	{
+		auto Device = std::make_unique<SEGAPSG>();
+		Device->SetClockSpeed(3'579'545);
+		Device->Reset(ResetType::PowerOnDefaults);
+
+		if (Keyed)
+		{
+			for (uint8_t Ch = 0; Ch < 3; Ch++)
+			{
+				Device->Write(0, 0x80 | (Ch << 5) | 0x0F);	/* Tone period (L) */
+				Device->Write(0, 0x04 + Ch);				/* Tone period (H) */
+				Device->Write(0, 0x90 | (Ch << 5));			/* Volume (max) */
+			}
+
+			Device->Write(0, 0xE4);	/* White noise */
+			Device->Write(0, 0xF0);	/* Noise volume (max) */
+		}
+
+		return Device;
+	}},
+
+	{ "MSM6295", [](bool Keyed) -> std::unique_ptr<ISoundDevice>
+	{
+		auto Device = std::make_unique<MSM6295>();
+		Device->SetClockSpeed(1'000'000);
+		Device->Reset(ResetType::PowerOnDefaults);
+
+		if (Keyed)
+		{
+			/* Phrase 1: 0x00400 - 0x3FFFF */
+			auto Rom = MakeNoise(0x40000);
+			uint8_t Phrase[6] = { 0x00, 0x04, 0x00, 0x03, 0xFF, 0xFF };
+			memcpy(Rom.data() + 8, Phrase, sizeof(Phrase));
+			Upload(Device.get(), 0, Rom);
+
+			for (uint8_t Ch = 0; Ch < 4; Ch++)
+			{
+				Device->Write(0, 0x81);
+				Device->Write(0, 0x10 << Ch);
+			}
+		}
+
+		return Device;
+	}},
+
+	{ "RF5C68", [](bool Keyed) -> std::unique_ptr<ISoundDevice>
+	{
+		auto Device = std::make_unique<RF5C68>();
+		Device->SetClockSpeed(12'500'000);
+		Device->Reset(ResetType::PowerOnDefaults);
+
+		if (Keyed)
+		{
+			/* 8-bit sign-magnitude samples, 0xFF is the loop marker */
+			auto Ram = MakeSine8(0x10000, false);
+			for (auto& Byte : Ram) Byte = (Byte & 0x80) ? (uint8_t)(-(int8_t)Byte) : (uint8_t)(Byte | 0x80);
+			Upload(Device.get(), 0, Ram);
+
+			for (uint8_t Ch = 0; Ch < 8; Ch++)
+			{
+				Device->Write(0x07, 0xC0 | Ch);		/* Select channel */
+				Device->Write(0x00, 0xFF);			/* Envelope */
+				Device->Write(0x01, 0xFF);			/* Pan */
+				Device->Write(0x02, 0x00);			/* Frequency delta */
+				Device->Write(0x03, 0x08 + Ch);
+				Device->Write(0x04, 0x00);			/* Loop start */
+				Device->Write(0x05, 0x00);
+				Device->Write(0x06, Ch * 0x10);		/* Start address */
+			}
+
+			Device->Write(0x08, 0x00);	/* All channels on */
+		}
+
+		return Device;
+	}},
+
+	{ "SegaPCM", [](bool Keyed) -> std::unique_ptr<ISoundDevice>
+	{
+		auto Device = std::make_unique<SegaPCM>();
+		Device->Reset(ResetType::PowerOnDefaults);
+
+		if (Keyed)
+		{
+			auto Rom = MakeSine8(0x10000, true);
+			Upload(Device.get(), 0, Rom);
+
+			for (uint8_t Ch = 0; Ch < 16; Ch++)
+			{
+				uint32_t Base = Ch << 3;
+
+				Device->Write(Base + 0x02, 0x7F);			/* Panpot (L) */
+				Device->Write(Base + 0x03, 0x7F);			/* Panpot (R) */
+				Device->Write(Base + 0x04, 0x00);			/* Loop address */
+				Device->Write(Base + 0x05, 0x00);
+				Device->Write(Base + 0x06, 0xFF);			/* End address */
+				Device->Write(Base + 0x07, 0x40 + Ch);		/* Frequency delta */
+				Device->Write(Base + 0x84, 0x00);			/* Current address */
+				Device->Write(Base + 0x85, 0x00);
+				Device->Write(Base + 0x86, 0x00);			/* Key on, loop */
+			}
+		}
+
+		return Device;
+	}},
+
+	{ "SEGAPWM", [](bool Keyed) -> std::unique_ptr<ISoundDevice>
+	{
+		auto Device = std::make_unique<SEGAPWM>();
+		Device->Reset(ResetType::PowerOnDefaults);
+
+		if (Keyed)
+		{
+			Device->Write(0x01, 1047);	/* Cycle register (~22kHz) */
+			Device->Write(0x00, 0x05);	/* L = L, R = R */
+			Device->Write(0x02, 0x200);
+			Device->Write(0x03, 0x200);
+		}
+
+		return Device;
+	}},
+
+	{ "YM2203", [](bool Keyed) -> std::unique_ptr<ISoundDevice>
+	{
+		auto Device = std::make_unique<YM2203>();
+		Device->Reset(ResetType::PowerOnDefaults);
+
+		if (Keyed)
+		{
+			KeySSG(Device.get(), 0);
+			KeyOPN(Device.get(), false, 3);
+		}
+
+		return Device;
+	}},
+
+	{ "YM2608", [](bool Keyed) -> std::unique_ptr<ISoundDevice>
+	{
+		auto Device = std::make_unique<YM2608>();
+		Device->Reset(ResetType::PowerOnDefaults);
+
+		if (Keyed)
+		{
+			WriteReg(Device.get(), 0, 0x29, 0x80);	/* 6-channel mode */
+
+			KeySSG(Device.get(), 0);
+			KeyOPN(Device.get(), true, 6);
+
+			/* Rhythm */
+			WriteReg(Device.get(), 0, 0x11, 0x3F);
+			for (uint8_t Ch = 0; Ch < 6; Ch++) WriteReg(Device.get(), 0, 0x18 + Ch, 0xDF);
+			WriteReg(Device.get(), 0, 0x10, 0x3F);
+		}
+
+		return Device;
+	}},
+
+	{ "YM2610", [](bool Keyed) -> std::unique_ptr<ISoundDevice>
+	{
+		auto Device = std::make_unique<YM2610>();
+		Device->Reset(ResetType::PowerOnDefaults);
+
+		if (Keyed)
+		{
+			auto Rom = MakeNoise(0x100000);
+			Upload(Device.get(), 0, Rom);
+
+			KeySSG(Device.get(), 0);
+			KeyOPN(Device.get(), true, 6);
+			KeyADPCMA(Device.get());
+		}
+
+		return Device;
+	}},
+
+	{ "YM2610B", [](bool Keyed) -> std::unique_ptr<ISoundDevice>
+	{
+		auto Device = std::make_unique<YM2610B>();
+		Device->Reset(ResetType::PowerOnDefaults);
+
+		if (Keyed)
+		{
+			auto Rom = MakeNoise(0x100000);
+			Upload(Device.get(), 0, Rom);
+
+			KeySSG(Device.get(), 0);
+			KeyOPN(Device.get(), true, 6);
+			KeyADPCMA(Device.get());
+		}
+
+		return Device;
+	}},
+
+	{ "YM2612", [](bool Keyed) -> std::unique_ptr<ISoundDevice>
+	{
+		auto Device = std::make_unique<YM2612>();
+		Device->Reset(ResetType::PowerOnDefaults);
+
+		if (Keyed) KeyOPN(Device.get(), true, 6);
+
+		return Device;
+	}},
+
+	{ "YM3526", [](bool Keyed) -> std::unique_ptr<ISoundDevice>
+	{
+		auto Device = std::make_unique<YM3526>();
+		Device->Reset(ResetType::PowerOnDefaults);
+
+		if (Keyed) KeyOPL(Device.get());
+
+		return Device;
+	}},
+
+	{ "YM3812", [](bool Keyed) -> std::unique_ptr<ISoundDevice>
+	{
+		auto Device = std::make_unique<YM3812>();
+		Device->Reset(ResetType::PowerOnDefaults);
+
+		if (Keyed) KeyOPL(Device.get());
+
+		return Device;
+	}},
+
+	{ "Y8950", [](bool Keyed) -> std::unique_ptr<ISoundDevice>
+	{
+		auto Device = std::make_unique<Y8950>();
+		Device->Reset(ResetType::PowerOnDefaults);
+
+		if (Keyed) KeyOPL(Device.get());
+
+		return Device;
+	}},
+
+	{ "YMZ280B", [](bool Keyed) -> std::unique_ptr<ISoundDevice>
+	{
+		auto Device = std::make_unique<YMZ280B>();
+		Device->Reset(ResetType::PowerOnDefaults);
+
+		if (Keyed)
+		{
+			auto Rom = MakeNoise(0x100000);
+			Upload(Device.get(), 0, Rom);
+
+			WriteReg(Device.get(), 0, 0xFF, 0xC0);	/* Key on enable, memory enable */
+
+			for (uint8_t Ch = 0; Ch < 8; Ch++)
+			{
+				uint8_t Base = Ch << 2;
+
+				WriteReg(Device.get(), 0, 0x00 + Base, 0xFF);	/* Pitch */
+				WriteReg(Device.get(), 0, 0x02 + Base, 0xFF);	/* Total level */
+				WriteReg(Device.get(), 0, 0x03 + Base, 0x08);	/* Panpot */
+				WriteReg(Device.get(), 0, 0x20 + Base, Ch);		/* Start address */
+				WriteReg(Device.get(), 0, 0x40 + Base, 0x00);
+				WriteReg(Device.get(), 0, 0x60 + Base, 0x00);
+				WriteReg(Device.get(), 0, 0x21 + Base, Ch);		/* Loop start address */
+				WriteReg(Device.get(), 0, 0x41 + Base, 0x00);
+				WriteReg(Device.get(), 0, 0x61 + Base, 0x00);
+				WriteReg(Device.get(), 0, 0x22 + Base, Ch);		/* Loop end address */
+				WriteReg(Device.get(), 0, 0x42 + Base, 0xFF);
+				WriteReg(Device.get(), 0, 0x62 + Base, 0xFF);
+				WriteReg(Device.get(), 0, 0x23 + Base, Ch);		/* End address */
+				WriteReg(Device.get(), 0, 0x43 + Base, 0xFF);
+				WriteReg(Device.get(), 0, 0x63 + Base, 0xFF);
+				WriteReg(Device.get(), 0, 0x01 + Base, 0xB0);	/* Key on, ADPCM, loop */
+			}
+		}
+
+		return Device;
+	}},
+
+	{ "YMW258F", [](bool Keyed) -> std::unique_ptr<ISoundDevice>
+	{
+		auto Device = std::make_unique<YMW258F>();
+		Device->Reset(ResetType::PowerOnDefaults);
+
+		if (Keyed)
+		{
+			auto Rom = MakeSine8(0x2000, false);
+			auto Header = MakeWaveHeader();
+			memcpy(Rom.data(), Header.data(), Header.size());
+			Upload(Device.get(), 0, Rom);
+
+			for (uint8_t Slot = 0; Slot < 32; Slot++)
+			{
+				if ((Slot & 0x07) == 0x07) continue; /* Unused slots */
+
+				Device->Write(0x01, Slot);
+				Device->Write(0x02, 0x00); Device->Write(0x00, 0x00);	/* Pan */
+				Device->Write(0x02, 0x01); Device->Write(0x00, 0x00);	/* Wave table number */
+				Device->Write(0x02, 0x02); Device->Write(0x00, Slot << 2);	/* Frequency */
+				Device->Write(0x02, 0x03); Device->Write(0x00, 0x00);	/* Octave */
+				Device->Write(0x02, 0x05); Device->Write(0x00, 0x01);	/* Total level (direct) */
+				Device->Write(0x02, 0x04); Device->Write(0x00, 0x80);	/* Key on */
+			}
+		}
+
+		return Device;
+	}},
+
+	{ "YMF278B", [](bool Keyed) -> std::unique_ptr<ISoundDevice>
+	{
+		auto Device = std::make_unique<YMF278B>();
+		Device->Reset(ResetType::PowerOnDefaults);
+
+		if (Keyed)
+		{
+			auto Rom = MakeSine8(0x2000, false);
+			auto Header = MakeWaveHeader();
+			memcpy(Rom.data(), Header.data(), Header.size());
+			Upload(Device.get(), 0, Rom);
+
+			WriteReg(Device.get(), 2, 0x05, 0x03);	/* OPL3 + OPL4 mode */
+
+			for (uint8_t Ch = 0; Ch < 24; Ch++)
+			{
+				WriteReg(Device.get(), 4, 0x08 + Ch, 0x00);		/* Wave table number */
+				WriteReg(Device.get(), 4, 0x20 + Ch, Ch << 3);	/* Frequency */
+				WriteReg(Device.get(), 4, 0x38 + Ch, 0x00);		/* Octave */
+				WriteReg(Device.get(), 4, 0x50 + Ch, 0x01);		/* Total level (direct) */
+				WriteReg(Device.get(), 4, 0x68 + Ch, 0x80);		/* Key on */
+			}
+		}
+
+		return Device;
+	}},
+
+	{ "YMF292F", [](bool Keyed) -> std::unique_ptr<ISoundDevice>
+	{
+		/* Work in progress core, there are no voices to key on yet */
+		auto Device = std::make_unique<YMF292F>();
+		Device->Reset(ResetType::PowerOnDefaults);
+
+		return Device;
+	}},
+};
+
+static uint64_t ReadTSC()
+{
+#if HAS_TSC
+	return __rdtsc();
+#else
+	return 0;
+#endif
+}
+
+static result_t Run(const bench_t& Bench, bool Keyed, double EmulatedSeconds)
+{
+	auto Device = Bench.Create(Keyed);
+
+	/* One counting buffer per device output */
+	AUDIO_OUTPUT_DESC Desc;
+	std::vector<CountingBuffer> Buffers;
+	std::vector<AUDIO_OUTPUT_DESC> Outputs;
+
+	for (uint32_t OutputNr = 0; Device->EnumAudioOutputs(OutputNr, Desc); OutputNr++) Outputs.push_back(Desc);
+
+	Buffers.resize(Outputs.size());
+
+	std::vector<IAudioBuffer*> OutBuffer;
+	for (auto& Buffer : Buffers) OutBuffer.push_back(&Buffer);
+
+	/* Update in 10ms slices, like a typical player would */
+	uint32_t ClockSpeed = Device->GetClockSpeed();
+	uint32_t Slice = std::max(ClockSpeed / 100, 1u);
+	uint64_t Slices = (uint64_t)(EmulatedSeconds * 100.0);
+
+	/* Warm up (fills caches and lets the envelopes attack) */
+	for (uint32_t i = 0; i < 10; i++) Device->Update(Slice, OutBuffer);
+
+	for (auto& Buffer : Buffers) Buffer.Samples = 0;
+
+	auto Start = std::chrono::steady_clock::now();
+	uint64_t StartTSC = ReadTSC();
+
+	for (uint64_t i = 0; i < Slices; i++) Device->Update(Slice, OutBuffer);
+
+	uint64_t EndTSC = ReadTSC();
+	auto End = std::chrono::steady_clock::now();
+
+	result_t Result;
+
+	Result.Device = Bench.Name;
+	Result.Scenario = Keyed ? "keyed" : "idle";
+	Result.ClockSpeed = ClockSpeed;
+	Result.SampleRate = Outputs.empty() ? 0 : Outputs[0].SampleRate;
+	Result.Frames = Outputs.empty() ? 0 : Buffers[0].Samples / std::max(Outputs[0].Channels, 1u);
+	Result.Seconds = std::chrono::duration<double>(End - Start).count();
+
+	double Frames = (double)std::max<uint64_t>(Result.Frames, 1);
+
+	Result.FramesPerSecond = (double)Result.Frames / Result.Seconds;
+	Result.NsPerFrame = (Result.Seconds * 1e9) / Frames;
+	Result.CyclesPerFrame = HAS_TSC ? (double)(EndTSC - StartTSC) / Frames : 0.0;
+	Result.Realtime = ((double)(Slice * Slices) / (double)std::max(ClockSpeed, 1u)) / Result.Seconds;
+
+	return Result;
+}
+
+/* Replay a trace on the benchmark device matching the recorded device name */
+static bool RunTrace(const TC::TraceLog& Log, result_t& Result)
+{
+	const bench_t* Bench = nullptr;
+	std::string Name;
+
+	for (wchar_t Char : Log.DeviceName) Name += (Char < 0x80) ? (char)Char : '?';
+
+	/* Longest match, eg. "YM2610B" before "YM2610" */
+	for (auto& Entry : s_Benchmarks)
+	{
+		if ((Name.find(Entry.Name) != std::string::npos) && ((Bench == nullptr) || (strlen(Entry.Name) > strlen(Bench->Name)))) Bench = &Entry;
+	}
+
+	if (Bench == nullptr) return false;
+
+	/* Sample memory holds the synthetic data of the benchmark, memory uploads are not traced */
+	auto Device = Bench->Create(false);
+
+	if (Log.ClockSpeed != 0) Device->SetClockSpeed(Log.ClockSpeed);
+
+	AUDIO_OUTPUT_DESC Desc;
+	std::vector<CountingBuffer> Buffers;
+	std::vector<AUDIO_OUTPUT_DESC> Outputs;
+
+	for (uint32_t OutputNr = 0; Device->EnumAudioOutputs(OutputNr, Desc); OutputNr++) Outputs.push_back(Desc);
+
+	Buffers.resize(Outputs.size());
+
+	std::vector<IAudioBuffer*> OutBuffer;
+	for (auto& Buffer : Buffers) OutBuffer.push_back(&Buffer);
+
+	uint32_t ClockSpeed = Device->GetClockSpeed();
+
+	auto Start = std::chrono::steady_clock::now();
+	uint64_t StartTSC = ReadTSC();
+
+	/* At most 10ms per Update call, like the scenarios */
+	uint64_t Cycles = Log.Replay(Device.get(), OutBuffer, std::max(ClockSpeed / 100, 1u));
+
+	uint64_t EndTSC = ReadTSC();
+	auto End = std::chrono::steady_clock::now();
+
+	Result.Device = Bench->Name;
+	Result.Scenario = "trace";
+	Result.ClockSpeed = ClockSpeed;
+	Result.SampleRate = Outputs.empty() ? 0 : Outputs[0].SampleRate;
+	Result.Frames = Outputs.empty() ? 0 : Buffers[0].Samples / std::max(Outputs[0].Channels, 1u);
+	Result.Seconds = std::max(std::chrono::duration<double>(End - Start).count(), 1e-9);
+
+	double Frames = (double)std::max<uint64_t>(Result.Frames, 1);
+
+	Result.FramesPerSecond = (double)Result.Frames / Result.Seconds;
+	Result.NsPerFrame = (Result.Seconds * 1e9) / Frames;
+	Result.CyclesPerFrame = HAS_TSC ? (double)(EndTSC - StartTSC) / Frames : 0.0;
+	Result.Realtime = ((double)Cycles / (double)std::max(ClockSpeed, 1u)) / Result.Seconds;
+
+	return true;
+}
+
+static void WriteJson(const char* FileName, const std::vector<result_t>& Results, double EmulatedSeconds)
+{
+	FILE* File = fopen(FileName, "w");
+
+	if (File == nullptr)
+	{
+		fprintf(stderr, "Unable to create %s\n", FileName);
+		return;
+	}
+
+	fprintf(File, "{\n");
+	fprintf(File, "  \"version\": \"%d.%d.%d\",\n", TC::VersionMajor, TC::VersionMinor, TC::VersionPatch);
+	fprintf(File, "  \"timestamp\": %lld,\n", (long long)time(nullptr));
+	fprintf(File, "  \"emulated_seconds\": %.3f,\n", EmulatedSeconds);
+	fprintf(File, "  \"results\": [\n");
+
+	for (size_t i = 0; i < Results.size(); i++)
+	{
+		auto& R = Results[i];
+
+		fprintf(File, "    { \"device\": \"%s\", \"scenario\": \"%s\", \"clock\": %u, \"sample_rate\": %u, \"frames\": %llu, "
+			"\"seconds\": %.6f, \"frames_per_second\": %.1f, \"ns_per_frame\": %.2f, \"cycles_per_frame\": %.1f, \"realtime\": %.2f }%s\n",
+			R.Device.c_str(), R.Scenario.c_str(), R.ClockSpeed, R.SampleRate, (unsigned long long)R.Frames,
+			R.Seconds, R.FramesPerSecond, R.NsPerFrame, R.CyclesPerFrame, R.Realtime, (i + 1 < Results.size()) ? "," : "");
+	}
+
+	fprintf(File, "  ]\n}\n");
+	fclose(File);
+}
+
+int main(int argc, char* argv[])
+{
+	double EmulatedSeconds = 5.0;
+	const char* Filter = nullptr;
+	const char* JsonFile = nullptr;
+	const char* TraceFile = nullptr;
+
+	for (int i = 1; i < argc; i++)
+	{
+		if (!strcmp(argv[i], "--seconds") && (i + 1 < argc))
+			EmulatedSeconds = std::max(atof(argv[++i]), 0.01);
+		else if (!strcmp(argv[i], "--device") && (i + 1 < argc))
+			Filter = argv[++i];
+		else if (!strcmp(argv[i], "--json") && (i + 1 < argc))
+			JsonFile = argv[++i];
+		else if (!strcmp(argv[i], "--trace") && (i + 1 < argc))
+			TraceFile = argv[++i];
+		else
+		{
+			fprintf(stderr, "Usage: %s [--seconds N] [--device NAME] [--json FILE] [--trace FILE]\n", argv[0]);
+			return 1;
+		}
+	}
+
+	std::vector<result_t> Results;
+
+	printf("%-20s %-6s %10s %14s %12s %14s %10s\n", "Device", "Mode", "Rate", "Frames/s", "ns/frame", "Cycles/frame", "Realtime");
+
+	if (TraceFile)
+	{
+		TC::TraceLog Log;
+		result_t Result;
+
+		if (!Log.Load(TraceFile))
+		{
+			fprintf(stderr, "Unable to read %s\n", TraceFile);
+			return 1;
+		}
+
+		if (!RunTrace(Log, Result))
+		{
+			fprintf(stderr, "No benchmark for device %ls\n", Log.DeviceName.c_str());
+			return 1;
+		}
+
+		printf("%-20s %-6s %10u %14.0f %12.2f %14.1f %9.1fx\n", Result.Device.c_str(), Result.Scenario.c_str(),
+			Result.SampleRate, Result.FramesPerSecond, Result.NsPerFrame, Result.CyclesPerFrame, Result.Realtime);
+
+		Results.push_back(Result);
+	}
+
+	for (auto& Bench : s_Benchmarks)
+	{
+		if (TraceFile) break;
+		if (Filter && !strstr(Bench.Name, Filter)) continue;
+
+		for (bool Keyed : { false, true })
+		{
+			auto Result = Run(Bench, Keyed, EmulatedSeconds);
+
+			printf("%-20s %-6s %10u %14.0f %12.2f %14.1f %9.1fx\n", Result.Device.c_str(), Result.Scenario.c_str(),
+				Result.SampleRate, Result.FramesPerSecond, Result.NsPerFrame, Result.CyclesPerFrame, Result.Realtime);
+
+			Results.push_back(Result);
+		}
+	}
+
+	if (JsonFile) WriteJson(JsonFile, Results, EmulatedSeconds);
+
+	return 0;
+}
\ No newline at end of file
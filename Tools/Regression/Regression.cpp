@@ -0,0 +1,351 @@
+/*
+ _____    _ _            ___
+|_   _| _(_) |_ ___ _ _ / __|___ _ _ ___
+  | || '_| |  _/ _ \ ' \ (__/ _ \ '_/ -_)
+  |_||_| |_|\__\___/_||_\___\___/_| \___|
+
+Copyright  2024, Michel Gerritse
+All rights reserved.
+
+This source code is available under the BSD-3-Clause license.
+See LICENSE.txt in the root directory of this source tree.
+
+*/
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <map>
+#include <sstream>
+#include <string>
+
+#include "../../TritonCore.h"
+#include "../../Player/VgmPlayer.h"
+
+/*
+	TritonCore golden output regression check
+
+	Plays VGM / VGZ files (register logs with timing) and hashes the native output of every
+	device, before resampling and mixing. The hashes are compared against a golden file made
+	by an earlier (trusted) build, so a change that is meant to be an optimization can be
+	checked to be bit exact. Every file is also timed and compared against the time stored in
+	the golden file, one run shows both "still exact" and "how much faster or slower".
+
+	Usage: Regression [options] FILE...
+
+	--golden FILE  Golden file (default golden.txt)
+	--update       Write the results to the golden file instead of checking them
+	--loops N      Number of loops (default 1)
+	--runs N       Time N runs per file and keep the fastest (default 1)
+
+	Golden file: one line per device output, tab separated:
+	file, device number, output number, device name, hash, samples, seconds
+
+	Use a single device per file (eg. the per-chip logs of a VGM pack) to get the timing of a
+	single device. Exit code: 0 = all exact, 1 = mismatch or missing golden entries.
+*/
+
+struct options_t
+{
+	std::string		Golden = "golden.txt";
+	bool			Update = false;
+	uint32_t		Loops = 1;
+	uint32_t		Runs = 1;
+};
+
+/* FNV-1a (64-bit) hash of the samples written to a device output
+   Samples are hashed in little endian byte order, F32 samples as their bit pattern */
+class HashBuffer : public IAudioBuffer
+{
+public:
+	uint64_t Hash = 0xCBF29CE484222325ull;
+	uint64_t Samples = 0;
+
+	void WriteSampleS16(int16_t Sample) { Add((uint16_t)Sample, 2); }
+	void WriteSampleS32(int32_t Sample) { Add((uint32_t)Sample, 4); }
+	void WriteSampleF32(float Sample) { uint32_t Bits; memcpy(&Bits, &Sample, 4); Add(Bits, 4); }
+
+	void WriteSamplesS16(const int16_t* pSamples, size_t Count)
+	{
+		for (size_t i = 0; i < Count; i++) Add((uint16_t)pSamples[i], 2);
+	}
+
+	void WriteSamplesS32(const int32_t* pSamples, size_t Count)
+	{
+		for (size_t i = 0; i < Count; i++) Add((uint32_t)pSamples[i], 4);
+	}
+
+	void WriteSamplesF32(const float* pSamples, size_t Count)
+	{
+		for (size_t i = 0; i < Count; i++) WriteSampleF32(pSamples[i]);
+	}
+
+private:
+	inline void Add(uint32_t Value, uint32_t Bytes)
+	{
+		for (uint32_t i = 0; i < Bytes; i++)
+		{
+			Hash = (Hash ^ ((Value >> (i * 8)) & 0xFF)) * 0x100000001B3ull;
+		}
+
+		Samples++;
+	}
+};
+
+struct result_t
+{
+	std::string		File;
+	uint32_t		DeviceNr;
+	uint32_t		OutputNr;
+	std::string		Name;
+	uint64_t		Hash;
+	uint64_t		Samples;
+	double			Seconds;	/* Whole file (all devices) */
+};
+
+static std::string Narrow(const wchar_t* Text)
+{
+	std::string Result;
+
+	/* Device names are plain ASCII */
+	for (; (Text != nullptr) && (*Text != 0); Text++) Result += (*Text < 0x80) ? (char)*Text : '?';
+
+	return Result;
+}
+
+static std::string Key(const std::string& File, uint32_t DeviceNr, uint32_t OutputNr)
+{
+	return File + "\t" + std::to_string(DeviceNr) + "\t" + std::to_string(OutputNr);
+}
+
+/* Play a file once, returns false if it can't be opened */
+static bool RunFile(const std::string& File, const options_t& Options, std::vector<result_t>& Results)
+{
+	constexpr size_t Frames = 8192;
+
+	VgmPlayer Player(VgmPlayer::TickRate);
+	Player.SetLoopCount(Options.Loops);
+
+	if (!Player.Open(File)) return false;
+
+	/* Taps on all device outputs */
+	std::vector<std::unique_ptr<HashBuffer>> Hashes;
+	std::vector<result_t> FileResults;
+
+	for (uint32_t DeviceNr = 0; DeviceNr < Player.GetDeviceCount(); DeviceNr++)
+	{
+		ISoundDevice* Device = Player.GetDevice(DeviceNr);
+		AUDIO_OUTPUT_DESC Desc;
+
+		for (uint32_t OutputNr = 0; Device->EnumAudioOutputs(OutputNr, Desc); OutputNr++)
+		{
+			auto& Hash = Hashes.emplace_back(std::make_unique<HashBuffer>());
+
+			Player.SetOutputTap(DeviceNr, OutputNr, Hash.get());
+			FileResults.push_back({ File, DeviceNr, OutputNr, Narrow(Device->GetDeviceName()), 0, 0, 0.0 });
+		}
+	}
+
+	std::vector<float> Buffer(Frames * 2);
+
+	auto Start = std::chrono::steady_clock::now();
+
+	while (!Player.IsFinished()) Player.Render(Buffer.data(), Frames);
+
+	double Seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - Start).count();
+
+	for (size_t i = 0; i < FileResults.size(); i++)
+	{
+		FileResults[i].Hash = Hashes[i]->Hash;
+		FileResults[i].Samples = Hashes[i]->Samples;
+		FileResults[i].Seconds = Seconds;
+	}
+
+	Results.insert(Results.end(), FileResults.begin(), FileResults.end());
+
+	return true;
+}
+
+static bool ReadGolden(const std::string& FileName, std::map<std::string, result_t>& Golden)
+{
+	std::ifstream Input(FileName);
+	std::string Line;
+
+	if (!Input.is_open()) return false;
+
+	while (std::getline(Input, Line))
+	{
+		if (Line.empty() || (Line[0] == '#')) continue;
+
+		std::istringstream Fields(Line);
+		result_t Result;
+		std::string DeviceNr, OutputNr, Hash, Samples, Seconds;
+
+		if (!std::getline(Fields, Result.File, '\t') || !std::getline(Fields, DeviceNr, '\t') || !std::getline(Fields, OutputNr, '\t') ||
+			!std::getline(Fields, Result.Name, '\t') || !std::getline(Fields, Hash, '\t') || !std::getline(Fields, Samples, '\t') ||
+			!std::getline(Fields, Seconds, '\t'))
+		{
+			continue;
+		}
+
+		Result.DeviceNr = (uint32_t)std::stoul(DeviceNr);
+		Result.OutputNr = (uint32_t)std::stoul(OutputNr);
+		Result.Hash = std::stoull(Hash, nullptr, 16);
+		Result.Samples = std::stoull(Samples);
+		Result.Seconds = std::stod(Seconds);
+
+		Golden[Key(Result.File, Result.DeviceNr, Result.OutputNr)] = Result;
+	}
+
+	return true;
+}
+
+static bool WriteGolden(const std::string& FileName, const std::vector<result_t>& Results)
+{
+	FILE* Output = fopen(FileName.c_str(), "w");
+
+	if (Output == nullptr) return false;
+
+	fprintf(Output, "# file\tdevice\toutput\tname\thash\tsamples\tseconds\n");
+
+	for (auto& Result : Results)
+	{
+		fprintf(Output, "%s\t%u\t%u\t%s\t%016llx\t%llu\t%.4f\n", Result.File.c_str(), Result.DeviceNr, Result.OutputNr, Result.Name.c_str(),
+			(unsigned long long)Result.Hash, (unsigned long long)Result.Samples, Result.Seconds);
+	}
+
+	return fclose(Output) == 0;
+}
+
+static int Usage(const char* Name)
+{
+	fprintf(stderr, "Usage: %s [--golden FILE] [--update] [--loops N] [--runs N] FILE...\n", Name);
+	return 1;
+}
+
+int main(int argc, char* argv[])
+{
+	options_t Options;
+	std::vector<std::string> Files;
+
+	for (int i = 1; i < argc; i++)
+	{
+		bool HasValue = (i + 1 < argc);
+
+		if (!strcmp(argv[i], "--golden") && HasValue)
+			Options.Golden = argv[++i];
+		else if (!strcmp(argv[i], "--update"))
+			Options.Update = true;
+		else if (!strcmp(argv[i], "--loops") && HasValue)
+			Options.Loops = std::max(atoi(argv[++i]), 0);
+		else if (!strcmp(argv[i], "--runs") && HasValue)
+			Options.Runs = std::max(atoi(argv[++i]), 1);
+		else if (argv[i][0] == '-')
+			return Usage(argv[0]);
+		else
+			Files.emplace_back(argv[i]);
+	}
+
+	if (Files.empty()) return Usage(argv[0]);
+
+	std::map<std::string, result_t> Golden;
+
+	if (!Options.Update && !ReadGolden(Options.Golden, Golden))
+	{
+		fprintf(stderr, "Can't read %s (run with --update to create it)\n", Options.Golden.c_str());
+		return 1;
+	}
+
+	std::vector<result_t> Results;
+	size_t Failed = 0;
+	double Seconds = 0.0;
+	double GoldenSeconds = 0.0;
+
+	for (auto& File : Files)
+	{
+		std::vector<result_t> FileResults;
+
+		/* Keep the fastest run, the hashes of all runs have to be equal */
+		for (uint32_t Run = 0; Run < Options.Runs; Run++)
+		{
+			std::vector<result_t> RunResults;
+
+			if (!RunFile(File, Options, RunResults))
+			{
+				printf("%s: can't open file\n", File.c_str());
+				Failed++;
+				break;
+			}
+
+			for (size_t i = 0; (Run != 0) && (i < RunResults.size()); i++)
+			{
+				if (RunResults[i].Hash != FileResults[i].Hash) printf("%s: device %u output %u is not deterministic\n", File.c_str(), RunResults[i].DeviceNr, RunResults[i].OutputNr);
+			}
+
+			if ((Run == 0) || (RunResults.front().Seconds < FileResults.front().Seconds)) FileResults = RunResults;
+		}
+
+		if (FileResults.empty()) continue;
+
+		Results.insert(Results.end(), FileResults.begin(), FileResults.end());
+
+		double FileSeconds = FileResults.front().Seconds;
+		Seconds += FileSeconds;
+
+		if (Options.Update)
+		{
+			printf("%s: %.3f s\n", File.c_str(), FileSeconds);
+			continue;
+		}
+
+		/* Compare device outputs */
+		double Reference = 0.0;
+
+		for (auto& Result : FileResults)
+		{
+			auto Entry = Golden.find(Key(Result.File, Result.DeviceNr, Result.OutputNr));
+
+			if (Entry == Golden.end())
+			{
+				printf("%s: %s (device %u output %u) MISSING\n", File.c_str(), Result.Name.c_str(), Result.DeviceNr, Result.OutputNr);
+				Failed++;
+				continue;
+			}
+
+			bool Exact = (Entry->second.Hash == Result.Hash) && (Entry->second.Samples == Result.Samples);
+
+			printf("%s: %s (device %u output %u) %s\n", File.c_str(), Result.Name.c_str(), Result.DeviceNr, Result.OutputNr, Exact ? "exact" : "MISMATCH");
+
+			Failed += Exact ? 0 : 1;
+			Reference = Entry->second.Seconds;
+		}
+
+		if (Reference > 0.0)
+		{
+			GoldenSeconds += Reference;
+
+			printf("%s: %.3f s (golden %.3f s, %+.1f%%)\n", File.c_str(), FileSeconds, Reference, (FileSeconds / Reference - 1.0) * 100.0);
+		}
+	}
+
+	if (Options.Update)
+	{
+		if (!WriteGolden(Options.Golden, Results))
+		{
+			fprintf(stderr, "Can't write %s\n", Options.Golden.c_str());
+			return 1;
+		}
+
+		printf("Written %zu device outputs to %s\n", Results.size(), Options.Golden.c_str());
+
+		return (Failed != 0) ? 1 : 0;
+	}
+
+	printf("Done: %zu device outputs, %zu failed, %.3f s", Results.size(), Failed, Seconds);
+
+	if (GoldenSeconds > 0.0) printf(" (golden %.3f s, %+.1f%%)", GoldenSeconds, (Seconds / GoldenSeconds - 1.0) * 100.0);
+
+	printf("\n");
+
+	return (Failed != 0) ? 1 : 0;
+}
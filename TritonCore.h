@@ -24,8 +24,12 @@ See LICENSE.txt in the root directory of this source tree.
 #include <vector>
 
 #include "Core/Bit.h"
+#include "Core/Irq.h"
+#include "Core/MemoryMap.h"
+#include "Core/Stats.h"
 #include "Core/Types.h"
 #include "Core/Version.h"
+#include "Core/VoiceMask.h"
 
 /// <summary>Current TritonCore API</summary>
 namespace TritonCore = TritonCore_v1;